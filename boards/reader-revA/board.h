@@ -109,6 +109,14 @@
 #define GPIOB_LED_G1                1U
 #define GPIOB_T_SWO                 3U
 
+/*
+ * Flash region of the offline access list (reader/acl.h), left out of the
+ * firmware by reader-revA.ld.
+ */
+#define BOARD_ACL_FLASH             ((const void *)0x08010000U)
+#define BOARD_ACL_FLASH_SIZE        (64U * 1024U)
+#define BOARD_ACL_FLASH_PAGE_SIZE   2048U
+
 /*
  * I/O ports initial setup, this configuration is established soon after reset
  * in the initialization code.
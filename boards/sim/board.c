@@ -0,0 +1,244 @@
+/**
+ * @file    board.c
+ * @brief   Simulated reader board.
+ * @details Puts the MFRC522 model of the host build on SPI1 behind
+ *          RFID_SS, with its NRSTPD input on RFID_RST and its IRQ output on
+ *          RFID_IRQ. Cards are loaded from the file named by @p SIM_CARDS,
+ *          one per line:
+ *
+ *          <tt>arrive_ms leave_ms uid [sak]</tt>
+ *
+ *          with @p leave_ms set to @p - for a card which never leaves, the
+ *          UID in hex (4, 7 or 10 bytes) and the SAK in hex, 08 by default.
+ *          Lines starting with @p # are comments.
+ *
+ *          The access list image (see @p host/acl_image.c) is loaded from
+ *          the file named by @p SIM_ACL into the flash region, which reads
+ *          as erased without it.
+ *
+ *          The chip statistics are printed when the simulation ends.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hal.h"
+
+#include "mfrc522_sim.h"
+#include "vclock.h"
+
+/**
+ * @brief   Most cards loaded from the card file.
+ */
+#define SIM_MAX_CARDS               64
+
+#if HAL_USE_PAL || defined(__DOXYGEN__)
+/**
+ * @brief   PAL setup.
+ * @details Digital I/O ports static configuration as defined in @p board.h.
+ *          This variable is used by the HAL when initializing the PAL driver.
+ */
+const PALConfig pal_default_config = {
+  {
+    PAL_PORT_BIT(GPIOA_RFID_SS) | PAL_PORT_BIT(GPIOA_RFID_RST),
+    {
+      [GPIOA_RFID_IRQ] = PAL_MODE_INPUT_PULLDOWN,
+      [GPIOA_RFID_SS] = PAL_MODE_OUTPUT_PUSHPULL,
+      [GPIOA_V_SENSE] = PAL_MODE_INPUT_ANALOG,
+      [GPIOA_RFID_RST] = PAL_MODE_OUTPUT_PUSHPULL,
+      [GPIOA_AUDIO_OUT] = PAL_MODE_INPUT_ANALOG,
+      [GPIOA_RFID_SCK] = PAL_MODE_ALTERNATE(0),
+      [GPIOA_RFID_MISO] = PAL_MODE_ALTERNATE(0),
+      [GPIOA_RFID_MOSI] = PAL_MODE_ALTERNATE(0),
+      [GPIOA_LED_G2] = PAL_MODE_OUTPUT_PUSHPULL,
+      [GPIOA_LED_R2] = PAL_MODE_OUTPUT_PUSHPULL,
+      [10] = PAL_MODE_UNCONNECTED,
+      [GPIOA_USB_DM] = PAL_MODE_ALTERNATE(2),
+      [GPIOA_USB_DP] = PAL_MODE_ALTERNATE(2),
+      [GPIOA_SWDIO] = PAL_MODE_ALTERNATE(0),
+      [GPIOA_SWCLK] = PAL_MODE_ALTERNATE(0),
+      [GPIOA_RDR_RXD] = PAL_MODE_ALTERNATE(1),
+    }
+  },
+  {
+    0,
+    {
+      [GPIOB_LED_R1] = PAL_MODE_OUTPUT_PUSHPULL,
+      [GPIOB_LED_G1] = PAL_MODE_OUTPUT_PUSHPULL,
+      [2] = PAL_MODE_UNCONNECTED,
+      [GPIOB_T_SWO] = PAL_MODE_ALTERNATE(0),
+      [4 ... 15] = PAL_MODE_UNCONNECTED,
+    }
+  },
+  {0, {[0 ... 15] = PAL_MODE_UNCONNECTED}},
+  {0, {[0 ... 15] = PAL_MODE_UNCONNECTED}},
+};
+#endif
+
+uint32_t simAclFlash[BOARD_ACL_FLASH_SIZE / 4];
+
+static MFRC522Sim chip;
+static PiccSim cards[SIM_MAX_CARDS];
+static bool irq_level;
+
+/*
+ * The host chip model keeps its time on the virtual clock of the simulator.
+ */
+uint64_t vclockNow(void) {
+  return simClockNow();
+}
+
+void vclockAdvance(uint64_t ns) {
+  simClockAdvance(ns);
+}
+
+static void chip_select(void *ctx, bool selected) {
+  mfrc522SimSelect(ctx, selected);
+}
+
+static uint16_t chip_exchange(void *ctx, uint16_t mosi) {
+  return mfrc522SimSpiExchange(ctx, (uint8_t)mosi);
+}
+
+static sim_spi_device_t chip_spi = {
+  GPIOA, GPIOA_RFID_SS, chip_select, chip_exchange, &chip, NULL
+};
+
+static uint64_t chip_next(void *ctx) {
+  return mfrc522SimNextEvent(ctx);
+}
+
+/**
+ * @brief   Mirrors the IRQ output of the chip on RFID_IRQ.
+ */
+static bool chip_service(void *ctx) {
+  bool level = mfrc522SimIrq(ctx);
+
+  if (level == irq_level) {
+    return false;
+  }
+  irq_level = level;
+  palSimDrive(GPIOA, GPIOA_RFID_IRQ, level);
+  return true;
+}
+
+static sim_peripheral_t chip_peripheral = {
+  chip_next, chip_service, NULL, &chip, NULL
+};
+
+static void pins_changed(ioportid_t port, ioportmask_t changed) {
+  if (port == GPIOA && (changed & PAL_PORT_BIT(GPIOA_RFID_RST)) != 0) {
+    mfrc522SimSetReset(&chip, palReadPad(GPIOA, GPIOA_RFID_RST) == PAL_LOW);
+  }
+}
+
+static int hex_bytes(const char *hex, uint8_t *out, size_t size) {
+  size_t n = strlen(hex);
+  size_t i;
+
+  if (n % 2 != 0 || n / 2 > size) {
+    return -1;
+  }
+  for (i = 0; i < n / 2; i++) {
+    unsigned byte;
+
+    if (sscanf(&hex[i * 2], "%2x", &byte) != 1) {
+      return -1;
+    }
+    out[i] = (uint8_t)byte;
+  }
+  return (int)(n / 2);
+}
+
+/**
+ * @brief   Loads the cards from the card file.
+ */
+static void load_cards(const char *path) {
+  FILE *f = fopen(path, "r");
+  char line[128];
+  unsigned lineno = 0;
+  size_t count = 0;
+
+  if (f == NULL) {
+    perror(path);
+    exit(1);
+  }
+  while (fgets(line, sizeof(line), f) != NULL) {
+    char leave[24], uidhex[24], sakhex[8] = "08";
+    unsigned long long arrive;
+    uint8_t uid[10], sak;
+    int uidlen, fields;
+
+    lineno++;
+    if (line[0] == '#' || strspn(line, " \t\r\n") == strlen(line)) {
+      continue;
+    }
+    fields = sscanf(line, "%llu %23s %23s %7s", &arrive, leave, uidhex, sakhex);
+    uidlen = fields >= 3 ? hex_bytes(uidhex, uid, sizeof(uid)) : -1;
+    if ((uidlen != 4 && uidlen != 7 && uidlen != 10) ||
+        hex_bytes(sakhex, &sak, 1) != 1 || count == SIM_MAX_CARDS) {
+      fprintf(stderr, "%s:%u: bad card\n", path, lineno);
+      exit(1);
+    }
+
+    piccSimInit(&cards[count], uid, (uint8_t)uidlen, sak);
+    cards[count].arriveNs = arrive * 1000000U;
+    cards[count].leaveNs = strcmp(leave, "-") == 0 ? 0 :
+                           strtoull(leave, NULL, 10) * 1000000U;
+    mfrc522SimAddCard(&chip, &cards[count]);
+    count++;
+  }
+  fclose(f);
+}
+
+/**
+ * @brief   Loads the access list image into the flash region.
+ */
+static void load_acl(const char *path) {
+  FILE *f = fopen(path, "rb");
+
+  if (f == NULL) {
+    perror(path);
+    exit(1);
+  }
+  if (fread(simAclFlash, 1, sizeof(simAclFlash), f) == 0 || !feof(f)) {
+    fprintf(stderr, "%s: empty or over %u bytes\n", path,
+            (unsigned)sizeof(simAclFlash));
+    exit(1);
+  }
+  fclose(f);
+}
+
+static void report(void) {
+  mfrc522SimSync(&chip);
+  fprintf(stderr,
+          "sim: %.3f s simulated, field on %.3f s, power-down %.3f s, "
+          "%u frames sent, %u received, %u collisions, %u RF errors\n",
+          (double)simClockNow() / 1e9, (double)chip.stats.fieldOnNs / 1e9,
+          (double)chip.stats.powerDownNs / 1e9,
+          (unsigned)chip.stats.framesSent, (unsigned)chip.stats.framesReceived,
+          (unsigned)chip.stats.collisions, (unsigned)chip.stats.rfErrors);
+}
+
+/**
+ * @brief   Board-specific initialization code.
+ */
+void boardInit(void) {
+  const char *path = getenv(SIM_ENV_CARDS);
+  const char *acl = getenv(SIM_ENV_ACL);
+
+  mfrc522SimInit(&chip, NULL);
+  if (path != NULL && *path != '\0') {
+    load_cards(path);
+  }
+  memset(simAclFlash, 0xFF, sizeof(simAclFlash));
+  if (acl != NULL && *acl != '\0') {
+    load_acl(acl);
+  }
+  mfrc522SimSetReset(&chip, palReadPad(GPIOA, GPIOA_RFID_RST) == PAL_LOW);
+  palSimSetHook(pins_changed);
+  spiSimAttach(&SPID1, &chip_spi);
+  simAddPeripheral(&chip_peripheral);
+  atexit(report);
+}
@@ -0,0 +1,66 @@
+/**
+ * @file    board.h
+ * @brief   Simulated reader board, the firmware as a Linux process.
+ * @details Same pin assignment as reader-revA. The ports are the virtual
+ *          ports of the simulator platform in @p boards/sim/platform.
+ */
+
+#ifndef _BOARD_H_
+#define _BOARD_H_
+
+/*
+ * Board identifier.
+ */
+#define BOARD_SVT_DEADLOCK_READER_SIM
+#define BOARD_NAME                  "SVT Deadlock Reader simulator"
+
+/*
+ * IO pins assignments.
+ */
+#define GPIOA_RFID_IRQ              0U
+#define GPIOA_RFID_SS               1U
+#define GPIOA_V_SENSE               2U
+#define GPIOA_RFID_RST              3U
+#define GPIOA_AUDIO_OUT             4U
+#define GPIOA_RFID_SCK              5U
+#define GPIOA_RFID_MISO             6U
+#define GPIOA_RFID_MOSI             7U
+#define GPIOA_LED_G2                8U
+#define GPIOA_LED_R2                9U
+#define GPIOA_USB_DM                11U
+#define GPIOA_USB_DP                12U
+#define GPIOA_SWDIO                 13U
+#define GPIOA_SWCLK                 14U
+#define GPIOA_RDR_TXD               14U
+#define GPIOA_RDR_RXD               15U
+
+#define GPIOB_LED_R1                0U
+#define GPIOB_LED_G1                1U
+#define GPIOB_T_SWO                 3U
+
+/*
+ * Environment variables the simulated board reads at start-up.
+ */
+#define SIM_ENV_CARDS               "SIM_CARDS"
+#define SIM_ENV_ACL                 "SIM_ACL"
+
+/*
+ * Flash region of the offline access list (reader/acl.h), loaded from the
+ * file named by SIM_ENV_ACL.
+ */
+#define BOARD_ACL_FLASH             ((const void *)simAclFlash)
+#define BOARD_ACL_FLASH_SIZE        (64U * 1024U)
+#define BOARD_ACL_FLASH_PAGE_SIZE   2048U
+
+#if !defined(_FROM_ASM_)
+#ifdef __cplusplus
+extern "C" {
+#endif
+  extern uint32_t simAclFlash[BOARD_ACL_FLASH_SIZE / 4];
+  void boardInit(void);
+#ifdef __cplusplus
+}
+#endif
+#endif /* _FROM_ASM_ */
+
+#endif /* _BOARD_H_ */
@@ -0,0 +1,8 @@
+# List of all the board related files.
+BOARDSRC = boards/sim/board.c \
+           host/mfrc522_sim.c \
+           host/picc_sim.c
+
+# Required include directories
+BOARDINC = boards/sim \
+           host
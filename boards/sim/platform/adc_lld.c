@@ -0,0 +1,160 @@
+/**
+ * @file    adc_lld.c
+ * @brief   Simulator platform ADC driver code.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "hal.h"
+
+#if HAL_USE_ADC || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+#if SIM_ADC_USE_ADC1 || defined(__DOXYGEN__)
+/** @brief ADC1 driver identifier.*/
+ADCDriver ADCD1;
+#endif
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static adcsample_t next_sample(ADCDriver *adcp) {
+  FILE *f = adcp->source;
+  unsigned value;
+
+  if (f == NULL) {
+    return SIM_ADC_DEFAULT_SAMPLE;
+  }
+  if (fscanf(f, "%u", &value) != 1) {
+    rewind(f);
+    if (fscanf(f, "%u", &value) != 1) {
+      return SIM_ADC_DEFAULT_SAMPLE;
+    }
+  }
+  return (adcsample_t)value;
+}
+
+/**
+ * @brief   Samples of one half of the buffer, or of all of it for a linear
+ *          buffer of depth 1.
+ */
+static size_t half_samples(ADCDriver *adcp) {
+  size_t depth = adcp->depth > 1 ? adcp->depth / 2 : adcp->depth;
+
+  return depth * adcp->grpp->num_channels;
+}
+
+static void schedule(ADCDriver *adcp) {
+  adcp->nextAt = simClockNow() + (uint64_t)half_samples(adcp) * SIM_ADC_SAMPLE_NS;
+}
+
+/**
+ * @brief   Fills one half of the buffer with fresh samples.
+ */
+static void convert(ADCDriver *adcp, adcsample_t *buf, size_t n) {
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    buf[i] = next_sample(adcp);
+  }
+}
+
+static uint64_t adc_next(void *ctx) {
+  ADCDriver *adcp = ctx;
+
+  return adcp->nextAt;
+}
+
+static bool adc_service(void *ctx) {
+  ADCDriver *adcp = ctx;
+  size_t n;
+
+  if (adcp->nextAt == 0 || simClockNow() < adcp->nextAt) {
+    return false;
+  }
+
+  n = half_samples(adcp);
+  OSAL_IRQ_PROLOGUE();
+  if (adcp->depth > 1 && !adcp->half) {
+    convert(adcp, adcp->samples, n);
+    adcp->half = true;
+    schedule(adcp);
+    _adc_isr_half_code(adcp);
+  } else {
+    convert(adcp, adcp->samples + (adcp->depth > 1 ? n : 0), n);
+    adcp->half = false;
+    if (adcp->grpp->circular) {
+      schedule(adcp);
+    } else {
+      adcp->nextAt = 0;
+    }
+    _adc_isr_full_code(adcp);
+  }
+  OSAL_IRQ_EPILOGUE();
+  return true;
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Low level ADC driver initialization.
+ */
+void adc_lld_init(void) {
+#if SIM_ADC_USE_ADC1
+  adcObjectInit(&ADCD1);
+  ADCD1.sim.next = adc_next;
+  ADCD1.sim.service = adc_service;
+  ADCD1.sim.fd = NULL;
+  ADCD1.sim.ctx = &ADCD1;
+  simAddPeripheral(&ADCD1.sim);
+#endif
+}
+
+/**
+ * @brief   Configures and activates the ADC peripheral.
+ */
+void adc_lld_start(ADCDriver *adcp) {
+  const char *path = getenv("SIM_ADC1");
+
+  if (adcp->state == ADC_STOP && path != NULL && *path != '\0') {
+    adcp->source = fopen(path, "r");
+    if (adcp->source == NULL) {
+      perror(path);
+      exit(1);
+    }
+  }
+}
+
+/**
+ * @brief   Deactivates the ADC peripheral.
+ */
+void adc_lld_stop(ADCDriver *adcp) {
+  if (adcp->source != NULL) {
+    fclose(adcp->source);
+    adcp->source = NULL;
+  }
+}
+
+/**
+ * @brief   Starts an ADC conversion.
+ */
+void adc_lld_start_conversion(ADCDriver *adcp) {
+  adcp->half = false;
+  schedule(adcp);
+}
+
+/**
+ * @brief   Stops an ongoing conversion.
+ */
+void adc_lld_stop_conversion(ADCDriver *adcp) {
+  adcp->nextAt = 0;
+}
+
+#endif /* HAL_USE_ADC */
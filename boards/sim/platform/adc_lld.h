@@ -0,0 +1,197 @@
+/**
+ * @file    adc_lld.h
+ * @brief   Simulator platform ADC driver header.
+ * @details Samples are read from the text file named by @p SIM_ADC1, a
+ *          stream of whitespace separated values consumed in conversion
+ *          order and rewound at its end. Without it every sample reads
+ *          @p SIM_ADC_DEFAULT_SAMPLE. The conversion group fields mirror the
+ *          STM32F0 ADC so the board code builds unchanged, the channel
+ *          selection only sets the number of samples per conversion.
+ */
+
+#ifndef _ADC_LLD_H_
+#define _ADC_LLD_H_
+
+#if HAL_USE_ADC || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   ADC1 driver enable switch.
+ */
+#if !defined(SIM_ADC_USE_ADC1) || defined(__DOXYGEN__)
+#define SIM_ADC_USE_ADC1            TRUE
+#endif
+
+/**
+ * @brief   Time of one sample in ns.
+ */
+#if !defined(SIM_ADC_SAMPLE_NS) || defined(__DOXYGEN__)
+#define SIM_ADC_SAMPLE_NS           1000U
+#endif
+
+/**
+ * @brief   Sample value without a sample file.
+ */
+#if !defined(SIM_ADC_DEFAULT_SAMPLE) || defined(__DOXYGEN__)
+#define SIM_ADC_DEFAULT_SAMPLE      2048U
+#endif
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   ADC sample data type.
+ */
+typedef uint16_t adcsample_t;
+
+/**
+ * @brief   Channels number in a conversion group.
+ */
+typedef uint16_t adc_channels_num_t;
+
+/**
+ * @brief   Possible ADC failure causes.
+ */
+typedef enum {
+  ADC_ERR_DMAFAILURE = 0,                   /**< DMA operations failure.    */
+  ADC_ERR_OVERFLOW = 1,                     /**< ADC overflow condition.    */
+  ADC_ERR_AWD = 2                           /**< Analog watchdog triggered. */
+} adcerror_t;
+
+/**
+ * @brief   Type of a structure representing an ADC driver.
+ */
+typedef struct ADCDriver ADCDriver;
+
+/**
+ * @brief   ADC notification callback type.
+ */
+typedef void (*adccallback_t)(ADCDriver *adcp, adcsample_t *buffer, size_t n);
+
+/**
+ * @brief   ADC error callback type.
+ */
+typedef void (*adcerrorcallback_t)(ADCDriver *adcp, adcerror_t err);
+
+/**
+ * @brief   Conversion group configuration structure.
+ */
+typedef struct {
+  /**
+   * @brief   Enables the circular buffer mode for the group.
+   */
+  bool                      circular;
+  /**
+   * @brief   Number of the analog channels belonging to the conversion group.
+   */
+  adc_channels_num_t        num_channels;
+  /**
+   * @brief   Callback function associated to the group or @p NULL.
+   */
+  adccallback_t             end_cb;
+  /**
+   * @brief   Error callback or @p NULL.
+   */
+  adcerrorcallback_t        error_cb;
+  /* End of the mandatory fields.*/
+  /**
+   * @brief   ADC CFGR1 register initialization data, unused.
+   */
+  uint32_t                  cfgr1;
+  /**
+   * @brief   ADC TR register initialization data, unused.
+   */
+  uint32_t                  tr;
+  /**
+   * @brief   ADC SMPR register initialization data, unused.
+   */
+  uint32_t                  smpr;
+  /**
+   * @brief   ADC CHSELR register initialization data, unused.
+   */
+  uint32_t                  chselr;
+} ADCConversionGroup;
+
+/**
+ * @brief   Driver configuration structure.
+ */
+typedef struct {
+  uint32_t                  dummy;
+} ADCConfig;
+
+/**
+ * @brief   Structure representing an ADC driver.
+ */
+struct ADCDriver {
+  /**
+   * @brief Driver state.
+   */
+  adcstate_t                state;
+  /**
+   * @brief Current configuration data.
+   */
+  const ADCConfig           *config;
+  /**
+   * @brief Current samples buffer pointer or @p NULL.
+   */
+  adcsample_t               *samples;
+  /**
+   * @brief Current samples buffer depth or @p 0.
+   */
+  size_t                    depth;
+  /**
+   * @brief Current conversion group pointer or @p NULL.
+   */
+  const ADCConversionGroup  *grpp;
+#if ADC_USE_WAIT || defined(__DOXYGEN__)
+  /**
+   * @brief Waiting thread.
+   */
+  thread_reference_t        thread;
+#endif
+#if ADC_USE_MUTUAL_EXCLUSION || defined(__DOXYGEN__)
+  /**
+   * @brief Mutex protecting the peripheral.
+   */
+  mutex_t                   mutex;
+#endif /* ADC_USE_MUTUAL_EXCLUSION */
+#if defined(ADC_DRIVER_EXT_FIELDS)
+  ADC_DRIVER_EXT_FIELDS
+#endif
+  /* End of the mandatory fields.*/
+  void                      *source;
+  /**
+   * @brief   Completion time of the next half of the buffer, 0 if idle.
+   */
+  uint64_t                  nextAt;
+  bool                      half;
+  sim_peripheral_t          sim;
+};
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#if SIM_ADC_USE_ADC1 && !defined(__DOXYGEN__)
+extern ADCDriver ADCD1;
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void adc_lld_init(void);
+  void adc_lld_start(ADCDriver *adcp);
+  void adc_lld_stop(ADCDriver *adcp);
+  void adc_lld_start_conversion(ADCDriver *adcp);
+  void adc_lld_stop_conversion(ADCDriver *adcp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_USE_ADC */
+
+#endif /* _ADC_LLD_H_ */
@@ -0,0 +1,155 @@
+/**
+ * @file    dac_lld.c
+ * @brief   Simulator platform DAC driver code.
+ */
+
+#include <stdlib.h>
+
+#include "hal.h"
+#include "sim_io.h"
+
+#if HAL_USE_DAC || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+#if SIM_DAC_USE_DAC1 || defined(__DOXYGEN__)
+/** @brief DAC1 driver identifier.*/
+DACDriver DACD1;
+#endif
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static size_t half_samples(DACDriver *dacp) {
+  size_t depth = dacp->depth > 1 ? dacp->depth / 2 : dacp->depth;
+
+  return depth * dacp->grpp->num_channels;
+}
+
+static void schedule(DACDriver *dacp) {
+  dacp->nextAt = simClockNow() + (uint64_t)(half_samples(dacp) /
+                 dacp->grpp->num_channels) * dacp->sampleNs;
+}
+
+/**
+ * @brief   Writes converted samples to the output file.
+ */
+static void output(DACDriver *dacp, const dacsample_t *buf, size_t n) {
+  uint8_t bytes[256];
+  size_t i, len = 0;
+
+  for (i = 0; i < n; i++) {
+    bytes[len++] = (uint8_t)buf[i];
+    bytes[len++] = (uint8_t)(buf[i] >> 8);
+    if (len == sizeof(bytes) || i + 1 == n) {
+      if (dacp->fd >= 0) {
+        simIoWrite(dacp->fd, bytes, len);
+      }
+      len = 0;
+    }
+  }
+  if (n > 0) {
+    dacp->output = buf[n - 1];
+  }
+}
+
+static uint64_t dac_next(void *ctx) {
+  DACDriver *dacp = ctx;
+
+  return dacp->nextAt;
+}
+
+static bool dac_service(void *ctx) {
+  DACDriver *dacp = ctx;
+  size_t n;
+
+  if (dacp->nextAt == 0 || simClockNow() < dacp->nextAt) {
+    return false;
+  }
+
+  n = half_samples(dacp);
+  OSAL_IRQ_PROLOGUE();
+  if (dacp->depth > 1 && !dacp->half) {
+    output(dacp, dacp->samples, n);
+    dacp->half = true;
+    schedule(dacp);
+    _dac_isr_half_code(dacp);
+  } else {
+    output(dacp, dacp->samples + (dacp->depth > 1 ? n : 0), n);
+    dacp->half = false;
+    schedule(dacp);
+    _dac_isr_full_code(dacp);
+  }
+  OSAL_IRQ_EPILOGUE();
+  return true;
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Low level DAC driver initialization.
+ */
+void dac_lld_init(void) {
+#if SIM_DAC_USE_DAC1
+  dacObjectInit(&DACD1);
+  DACD1.fd = -1;
+  DACD1.sim.next = dac_next;
+  DACD1.sim.service = dac_service;
+  DACD1.sim.fd = NULL;
+  DACD1.sim.ctx = &DACD1;
+  simAddPeripheral(&DACD1.sim);
+#endif
+}
+
+/**
+ * @brief   Configures and activates the DAC peripheral.
+ * @details The output file is created on the first start.
+ */
+void dac_lld_start(DACDriver *dacp) {
+  const char *path = getenv("SIM_DAC1");
+
+  if (dacp->fd < 0 && path != NULL && *path != '\0') {
+    dacp->fd = simIoCreate(path);
+  }
+  dacp->sampleNs = 1000000000U / simEnvUint("SIM_DAC1_RATE", SIM_DAC_SAMPLE_RATE);
+  dacp->output = dacp->config->init;
+}
+
+/**
+ * @brief   Deactivates the DAC peripheral.
+ */
+void dac_lld_stop(DACDriver *dacp) {
+  dacp->nextAt = 0;
+}
+
+/**
+ * @brief   Outputs a value directly on a DAC channel.
+ * @note    Only conversions are written to the output file.
+ */
+void dac_lld_put_channel(DACDriver *dacp, dacchannel_t channel,
+                         dacsample_t sample) {
+  (void)channel;
+  dacp->output = sample;
+}
+
+/**
+ * @brief   Starts a DAC conversion.
+ */
+void dac_lld_start_conversion(DACDriver *dacp) {
+  dacp->half = false;
+  schedule(dacp);
+}
+
+/**
+ * @brief   Stops an ongoing conversion.
+ */
+void dac_lld_stop_conversion(DACDriver *dacp) {
+  dacp->nextAt = 0;
+}
+
+#endif /* HAL_USE_DAC */
@@ -0,0 +1,200 @@
+/**
+ * @file    dac_lld.h
+ * @brief   Simulator platform DAC driver header.
+ * @details Converted samples are appended to the file named by
+ *          @p SIM_DAC1 as raw little endian 16 bit words, interleaved per
+ *          channel, one half buffer at a time. The trigger timer is not
+ *          modelled, conversions run at @p SIM_DAC1_RATE samples per second
+ *          (@p SIM_DAC_SAMPLE_RATE by default).
+ */
+
+#ifndef _DAC_LLD_H_
+#define _DAC_LLD_H_
+
+#if HAL_USE_DAC || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   DAC1 driver enable switch.
+ */
+#if !defined(SIM_DAC_USE_DAC1) || defined(__DOXYGEN__)
+#define SIM_DAC_USE_DAC1            TRUE
+#endif
+
+/**
+ * @brief   Default conversion rate in Hz.
+ */
+#if !defined(SIM_DAC_SAMPLE_RATE) || defined(__DOXYGEN__)
+#define SIM_DAC_SAMPLE_RATE         16000U
+#endif
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Type of a DAC channel index.
+ */
+typedef uint32_t dacchannel_t;
+
+/**
+ * @brief   Type representing a DAC sample.
+ */
+typedef uint16_t dacsample_t;
+
+/**
+ * @brief   Possible DAC failure causes.
+ */
+typedef enum {
+  DAC_ERR_DMAFAILURE = 0,                   /**< DMA operations failure.    */
+  DAC_ERR_UNDERFLOW = 1                     /**< DAC overflow condition.    */
+} dacerror_t;
+
+/**
+ * @brief   DAC output data alignment, only right aligned 12 bit is
+ *          modelled.
+ */
+typedef enum {
+  DAC_DHRM_12BIT_RIGHT = 0,
+  DAC_DHRM_12BIT_LEFT = 1,
+  DAC_DHRM_8BIT_RIGHT = 2
+} dacdhrmode_t;
+
+/**
+ * @brief   Type of a structure representing an DAC driver.
+ */
+typedef struct DACDriver DACDriver;
+
+/**
+ * @brief   DAC notification callback type.
+ */
+typedef void (*daccallback_t)(DACDriver *dacp, const dacsample_t *buffer,
+                              size_t n);
+
+/**
+ * @brief   ADC error callback type.
+ */
+typedef void (*dacerrorcallback_t)(DACDriver *dacp, dacerror_t err);
+
+/**
+ * @brief   DAC Conversion group structure.
+ */
+typedef struct {
+  /**
+   * @brief   Number of DAC channels.
+   */
+  uint32_t                  num_channels;
+  /**
+   * @brief   Operation complete callback or @p NULL.
+   */
+  daccallback_t             end_cb;
+  /**
+   * @brief   Error handling callback or @p NULL.
+   */
+  dacerrorcallback_t        error_cb;
+  /* End of the mandatory fields.*/
+  /**
+   * @brief   DAC initialization data, unused.
+   */
+  uint32_t                  trigger;
+} DACConversionGroup;
+
+/**
+ * @brief   Driver configuration structure.
+ */
+typedef struct {
+  /**
+   * @brief   Initial output on DAC channels.
+   */
+  dacsample_t               init;
+  /**
+   * @brief   DAC data holding register mode.
+   */
+  dacdhrmode_t              datamode;
+} DACConfig;
+
+/**
+ * @brief   Structure representing a DAC driver.
+ */
+struct DACDriver {
+  /**
+   * @brief   Driver state.
+   */
+  dacstate_t                state;
+  /**
+   * @brief   Conversion group.
+   */
+  const DACConversionGroup  *grpp;
+  /**
+   * @brief   Samples buffer pointer.
+   */
+  const dacsample_t         *samples;
+  /**
+   * @brief   Samples buffer size.
+   */
+  size_t                    depth;
+  /**
+   * @brief   Current configuration data.
+   */
+  const DACConfig           *config;
+#if DAC_USE_WAIT || defined(__DOXYGEN__)
+  /**
+   * @brief   Waiting thread.
+   */
+  thread_reference_t        thread;
+#endif /* DAC_USE_WAIT */
+#if DAC_USE_MUTUAL_EXCLUSION || defined(__DOXYGEN__)
+  /**
+   * @brief   Mutex protecting the bus.
+   */
+  mutex_t                   mutex;
+#endif /* DAC_USE_MUTUAL_EXCLUSION */
+#if defined(DAC_DRIVER_EXT_FIELDS)
+  DAC_DRIVER_EXT_FIELDS
+#endif
+  /* End of the mandatory fields.*/
+  int                       fd;
+  /**
+   * @brief   Conversion period in ns.
+   */
+  uint32_t                  sampleNs;
+  /**
+   * @brief   Completion time of the next half of the buffer, 0 if idle.
+   */
+  uint64_t                  nextAt;
+  bool                      half;
+  /**
+   * @brief   Last value written to the output.
+   */
+  dacsample_t               output;
+  sim_peripheral_t          sim;
+};
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#if SIM_DAC_USE_DAC1 && !defined(__DOXYGEN__)
+extern DACDriver DACD1;
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void dac_lld_init(void);
+  void dac_lld_start(DACDriver *dacp);
+  void dac_lld_stop(DACDriver *dacp);
+  void dac_lld_put_channel(DACDriver *dacp, dacchannel_t channel,
+                           dacsample_t sample);
+  void dac_lld_start_conversion(DACDriver *dacp);
+  void dac_lld_stop_conversion(DACDriver *dacp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_USE_DAC */
+
+#endif /* _DAC_LLD_H_ */
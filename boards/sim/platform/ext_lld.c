@@ -0,0 +1,138 @@
+/**
+ * @file    ext_lld.c
+ * @brief   Simulator platform EXT driver code.
+ */
+
+#include "hal.h"
+
+#if HAL_USE_EXT || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   EXTD1 driver identifier.
+ */
+EXTDriver EXTD1;
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static const ioportid_t ports[] = {GPIOA, GPIOB, GPIOC, GPIOD};
+
+static bool channel_level(EXTDriver *extp, expchannel_t channel) {
+  uint32_t mode = extp->config->channels[channel].mode;
+  ioportid_t port = ports[(mode & EXT_MODE_GPIO_MASK) >> EXT_MODE_GPIO_OFF];
+
+  return palReadPad(port, channel) != PAL_LOW;
+}
+
+static uint32_t sample(EXTDriver *extp) {
+  uint32_t levels = 0;
+  expchannel_t channel;
+
+  for (channel = 0; channel < EXT_MAX_CHANNELS; channel++) {
+    if ((extp->enabled & (1U << channel)) != 0 &&
+        channel_level(extp, channel)) {
+      levels |= 1U << channel;
+    }
+  }
+  return levels;
+}
+
+static uint64_t ext_next(void *ctx) {
+  (void)ctx;
+  return 0;
+}
+
+static bool ext_service(void *ctx) {
+  EXTDriver *extp = ctx;
+  uint32_t levels, changed;
+  expchannel_t channel;
+  bool fired = false;
+
+  if (extp->state != EXT_ACTIVE) {
+    return false;
+  }
+  levels = sample(extp);
+  changed = levels ^ extp->levels;
+  extp->levels = levels;
+
+  for (channel = 0; channel < EXT_MAX_CHANNELS; channel++) {
+    const EXTChannelConfig *ccp = &extp->config->channels[channel];
+    uint32_t bit = 1U << channel;
+
+    if ((changed & bit) == 0 || ccp->cb == NULL) {
+      continue;
+    }
+    if (((levels & bit) != 0 && (ccp->mode & EXT_CH_MODE_RISING_EDGE) != 0) ||
+        ((levels & bit) == 0 && (ccp->mode & EXT_CH_MODE_FALLING_EDGE) != 0)) {
+      OSAL_IRQ_PROLOGUE();
+      ccp->cb(extp, channel);
+      OSAL_IRQ_EPILOGUE();
+      fired = true;
+    }
+  }
+  return fired;
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Low level EXT driver initialization.
+ */
+void ext_lld_init(void) {
+  extObjectInit(&EXTD1);
+  EXTD1.sim.next = ext_next;
+  EXTD1.sim.service = ext_service;
+  EXTD1.sim.fd = NULL;
+  EXTD1.sim.ctx = &EXTD1;
+  simAddPeripheral(&EXTD1.sim);
+}
+
+/**
+ * @brief   Configures and activates the EXT peripheral.
+ */
+void ext_lld_start(EXTDriver *extp) {
+  expchannel_t channel;
+
+  extp->enabled = 0;
+  for (channel = 0; channel < EXT_MAX_CHANNELS; channel++) {
+    if ((extp->config->channels[channel].mode & EXT_CH_MODE_AUTOSTART) != 0) {
+      extp->enabled |= 1U << channel;
+    }
+  }
+  extp->levels = sample(extp);
+}
+
+/**
+ * @brief   Deactivates the EXT peripheral.
+ */
+void ext_lld_stop(EXTDriver *extp) {
+  extp->enabled = 0;
+}
+
+/**
+ * @brief   Enables an EXT channel.
+ */
+void ext_lld_channel_enable(EXTDriver *extp, expchannel_t channel) {
+  extp->enabled |= 1U << channel;
+  if (channel_level(extp, channel)) {
+    extp->levels |= 1U << channel;
+  } else {
+    extp->levels &= ~(1U << channel);
+  }
+}
+
+/**
+ * @brief   Disables an EXT channel.
+ */
+void ext_lld_channel_disable(EXTDriver *extp, expchannel_t channel) {
+  extp->enabled &= ~(1U << channel);
+}
+
+#endif /* HAL_USE_EXT */
@@ -0,0 +1,125 @@
+/**
+ * @file    ext_lld.h
+ * @brief   Simulator platform EXT driver header.
+ * @details Channel n watches pad n of the port selected in its mode, like
+ *          the EXTI lines of the STM32. Edges are detected on the pin levels
+ *          of the virtual ports.
+ */
+
+#ifndef _EXT_LLD_H_
+#define _EXT_LLD_H_
+
+#if HAL_USE_EXT || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Available number of EXT channels.
+ */
+#define EXT_MAX_CHANNELS            16
+
+/**
+ * @brief   Mask of the available channels.
+ */
+#define EXT_CHANNELS_MASK           ((1U << EXT_MAX_CHANNELS) - 1U)
+
+/**
+ * @name    EXT channel modes
+ * @{
+ */
+#define EXT_MODE_GPIO_MASK          0xF0U   /**< Port field mask.           */
+#define EXT_MODE_GPIO_OFF           4U      /**< Port field offset.         */
+
+#define EXT_MODE_GPIOA              0x00U   /**< GPIOA identifier.          */
+#define EXT_MODE_GPIOB              0x10U   /**< GPIOB identifier.          */
+#define EXT_MODE_GPIOC              0x20U   /**< GPIOC identifier.          */
+#define EXT_MODE_GPIOD              0x30U   /**< GPIOD identifier.          */
+/** @} */
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   EXT channel identifier.
+ */
+typedef uint32_t expchannel_t;
+
+/**
+ * @brief   Type of an EXT generic notification callback.
+ */
+typedef void (*extcallback_t)(EXTDriver *extp, expchannel_t channel);
+
+/**
+ * @brief   Channel configuration structure.
+ */
+typedef struct {
+  /**
+   * @brief Channel mode.
+   */
+  uint32_t              mode;
+  /**
+   * @brief Channel callback.
+   */
+  extcallback_t         cb;
+} EXTChannelConfig;
+
+/**
+ * @brief   Driver configuration structure.
+ */
+typedef struct {
+  /**
+   * @brief Channel configurations.
+   */
+  EXTChannelConfig      channels[EXT_MAX_CHANNELS];
+} EXTConfig;
+
+/**
+ * @brief   Structure representing an EXT driver.
+ */
+struct EXTDriver {
+  /**
+   * @brief Driver state.
+   */
+  extstate_t                state;
+  /**
+   * @brief Current configuration data.
+   */
+  const EXTConfig           *config;
+  /* End of the mandatory fields.*/
+  /**
+   * @brief Enabled channels.
+   */
+  uint32_t                  enabled;
+  /**
+   * @brief Channel levels seen last time.
+   */
+  uint32_t                  levels;
+  sim_peripheral_t          sim;
+};
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#if !defined(__DOXYGEN__)
+extern EXTDriver EXTD1;
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void ext_lld_init(void);
+  void ext_lld_start(EXTDriver *extp);
+  void ext_lld_stop(EXTDriver *extp);
+  void ext_lld_channel_enable(EXTDriver *extp, expchannel_t channel);
+  void ext_lld_channel_disable(EXTDriver *extp, expchannel_t channel);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_USE_EXT */
+
+#endif /* _EXT_LLD_H_ */
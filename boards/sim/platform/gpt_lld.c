@@ -0,0 +1,146 @@
+/**
+ * @file    gpt_lld.c
+ * @brief   Simulator platform GPT driver code.
+ */
+
+#include "hal.h"
+
+#if HAL_USE_GPT || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+#if SIM_GPT_USE_TIM3 || defined(__DOXYGEN__)
+/** @brief GPTD3 driver identifier.*/
+GPTDriver GPTD3;
+#endif
+
+#if SIM_GPT_USE_TIM14 || defined(__DOXYGEN__)
+/** @brief GPTD14 driver identifier.*/
+GPTDriver GPTD14;
+#endif
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static uint64_t period_end(GPTDriver *gptp) {
+  return gptp->startAt + (uint64_t)gptp->interval * gptp->countNs;
+}
+
+static uint64_t gpt_next(void *ctx) {
+  GPTDriver *gptp = ctx;
+
+  return gptp->running ? period_end(gptp) : 0;
+}
+
+static bool gpt_service(void *ctx) {
+  GPTDriver *gptp = ctx;
+
+  if (!gptp->running || simClockNow() < period_end(gptp)) {
+    return false;
+  }
+
+  OSAL_IRQ_PROLOGUE();
+  gptp->startAt = period_end(gptp);
+  if (gptp->state == GPT_ONESHOT) {
+    gptp->state = GPT_READY;
+    gpt_lld_stop_timer(gptp);
+  }
+  if (gptp->config->callback != NULL) {
+    gptp->config->callback(gptp);
+  }
+  OSAL_IRQ_EPILOGUE();
+  return true;
+}
+
+static void object_init(GPTDriver *gptp) {
+  gptObjectInit(gptp);
+  gptp->running = false;
+  gptp->sim.next = gpt_next;
+  gptp->sim.service = gpt_service;
+  gptp->sim.fd = NULL;
+  gptp->sim.ctx = gptp;
+  simAddPeripheral(&gptp->sim);
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Low level GPT driver initialization.
+ */
+void gpt_lld_init(void) {
+#if SIM_GPT_USE_TIM3
+  object_init(&GPTD3);
+#endif
+#if SIM_GPT_USE_TIM14
+  object_init(&GPTD14);
+#endif
+}
+
+/**
+ * @brief   Configures and activates the GPT peripheral.
+ */
+void gpt_lld_start(GPTDriver *gptp) {
+  osalDbgAssert(SIM_GPT_CLOCK % gptp->config->frequency == 0 &&
+                1000000000U % gptp->config->frequency == 0,
+                "invalid frequency");
+  gptp->countNs = 1000000000U / gptp->config->frequency;
+}
+
+/**
+ * @brief   Deactivates the GPT peripheral.
+ */
+void gpt_lld_stop(GPTDriver *gptp) {
+  gptp->running = false;
+}
+
+/**
+ * @brief   Starts the timer in continuous or one-shot mode.
+ * @details As on the STM32, where ARR is loaded with @p interval - 1 and
+ *          the counter is blocked while ARR is 0, an interval below 2 never
+ *          ends.
+ */
+void gpt_lld_start_timer(GPTDriver *gptp, gptcnt_t interval) {
+  osalDbgAssert(interval >= 2, "counter blocked");
+  gptp->interval = interval;
+  gptp->startAt = simClockNow();
+  gptp->running = interval >= 2;
+}
+
+/**
+ * @brief   Stops the timer.
+ */
+void gpt_lld_stop_timer(GPTDriver *gptp) {
+  gptp->running = false;
+}
+
+/**
+ * @brief   Starts the timer in one-shot mode and waits for its end.
+ * @details The CPU is busy for the whole interval.
+ */
+void gpt_lld_polled_delay(GPTDriver *gptp, gptcnt_t interval) {
+  simClockAdvance((uint64_t)interval * gptp->countNs);
+}
+
+/**
+ * @brief   Current counter value.
+ */
+gptcnt_t gpt_lld_counter(GPTDriver *gptp) {
+  uint64_t count;
+
+  if (!gptp->running) {
+    return 0;
+  }
+  /* The period may have ended while the ISR could not run. */
+  count = (simClockNow() - gptp->startAt) / gptp->countNs;
+  if (count >= gptp->interval) {
+    count = gptp->state == GPT_CONTINUOUS ? count % gptp->interval : 0;
+  }
+  return (gptcnt_t)count;
+}
+
+#endif /* HAL_USE_GPT */
@@ -0,0 +1,155 @@
+/**
+ * @file    gpt_lld.h
+ * @brief   Simulator platform GPT driver header.
+ * @details 16 bit up-counting timers clocked at the configured frequency,
+ *          derived from the virtual clock. The instances carry the names of
+ *          the STM32F0 timers the firmware uses.
+ */
+
+#ifndef _GPT_LLD_H_
+#define _GPT_LLD_H_
+
+#if HAL_USE_GPT || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   GPTD3 driver enable switch.
+ */
+#if !defined(SIM_GPT_USE_TIM3) || defined(__DOXYGEN__)
+#define SIM_GPT_USE_TIM3            TRUE
+#endif
+
+/**
+ * @brief   GPTD14 driver enable switch.
+ */
+#if !defined(SIM_GPT_USE_TIM14) || defined(__DOXYGEN__)
+#define SIM_GPT_USE_TIM14           TRUE
+#endif
+
+/**
+ * @brief   Timer input clock in Hz, the frequency must divide it.
+ */
+#define SIM_GPT_CLOCK               48000000U
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   GPT frequency type.
+ */
+typedef uint32_t gptfreq_t;
+
+/**
+ * @brief   GPT counter type.
+ */
+typedef uint16_t gptcnt_t;
+
+/**
+ * @brief   Driver configuration structure.
+ */
+typedef struct {
+  /**
+   * @brief   Timer clock in Hz.
+   */
+  gptfreq_t                 frequency;
+  /**
+   * @brief   Timer callback pointer.
+   * @note    This callback is invoked on GPT counter events.
+   */
+  gptcallback_t             callback;
+  /* End of the mandatory fields.*/
+  /**
+   * @brief   TIM CR2 register initialization data, unused.
+   */
+  uint32_t                  cr2;
+  /**
+   * @brief   TIM DIER register initialization data, unused.
+   */
+  uint32_t                  dier;
+} GPTConfig;
+
+/**
+ * @brief   Structure representing a GPT driver.
+ */
+struct GPTDriver {
+  /**
+   * @brief   Driver state.
+   */
+  gptstate_t                state;
+  /**
+   * @brief   Current configuration data.
+   */
+  const GPTConfig           *config;
+#if defined(GPT_DRIVER_EXT_FIELDS)
+  GPT_DRIVER_EXT_FIELDS
+#endif
+  /* End of the mandatory fields.*/
+  /**
+   * @brief   Counts per period.
+   */
+  gptcnt_t                  interval;
+  /**
+   * @brief   One count in ns.
+   */
+  uint32_t                  countNs;
+  /**
+   * @brief   Virtual time of the counter at zero.
+   */
+  uint64_t                  startAt;
+  bool                      running;
+  sim_peripheral_t          sim;
+};
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/**
+ * @brief   Changes the interval of GPT peripheral.
+ * @details Takes effect at the next period, like a preloaded ARR.
+ */
+#define gpt_lld_change_interval(gptp, n) ((gptp)->interval = (gptcnt_t)(n))
+
+/**
+ * @brief   Returns the interval of GPT peripheral.
+ */
+#define gpt_lld_get_interval(gptp) ((gptcnt_t)(gptp)->interval)
+
+/**
+ * @brief   Returns the counter value of GPT peripheral.
+ */
+#define gpt_lld_get_counter(gptp) gpt_lld_counter(gptp)
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#if SIM_GPT_USE_TIM3 && !defined(__DOXYGEN__)
+extern GPTDriver GPTD3;
+#endif
+
+#if SIM_GPT_USE_TIM14 && !defined(__DOXYGEN__)
+extern GPTDriver GPTD14;
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void gpt_lld_init(void);
+  void gpt_lld_start(GPTDriver *gptp);
+  void gpt_lld_stop(GPTDriver *gptp);
+  void gpt_lld_start_timer(GPTDriver *gptp, gptcnt_t interval);
+  void gpt_lld_stop_timer(GPTDriver *gptp);
+  void gpt_lld_polled_delay(GPTDriver *gptp, gptcnt_t interval);
+  gptcnt_t gpt_lld_counter(GPTDriver *gptp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_USE_GPT */
+
+#endif /* _GPT_LLD_H_ */
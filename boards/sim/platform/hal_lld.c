@@ -0,0 +1,234 @@
+/**
+ * @file    hal_lld.c
+ * @brief   Simulator platform HAL subsystem low level driver code.
+ */
+
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "hal.h"
+
+/*===========================================================================*/
+/* Driver local definitions.                                                 */
+/*===========================================================================*/
+
+/**
+ * @brief   Most file descriptors waited on at once.
+ */
+#define SIM_MAX_FDS                 8
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+static sim_peripheral_t *peripherals;
+static uint64_t now_ns;
+
+/**
+ * @brief   Virtual time at which the simulation ends, 0 to run forever.
+ */
+static uint64_t end_ns;
+
+/**
+ * @brief   Virtual to real time ratio, 0 for unpaced.
+ */
+static uint32_t speed;
+static uint64_t pace_real_ns;
+static uint64_t pace_virtual_ns;
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static uint64_t real_now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief   Real time at which the virtual clock reaches @p t when paced.
+ */
+static uint64_t real_deadline(uint64_t t) {
+  return pace_real_ns + (t - pace_virtual_ns) / speed;
+}
+
+/**
+ * @brief   Services the peripherals until none of them has anything left
+ *          to do at the current time.
+ */
+static bool service_all(void) {
+  bool any = false;
+  bool again;
+
+  do {
+    sim_peripheral_t *p;
+
+    again = false;
+    for (p = peripherals; p != NULL; p = p->link) {
+      if (p->service(p->ctx)) {
+        again = true;
+      }
+    }
+    any |= again;
+  } while (again);
+  return any;
+}
+
+/**
+ * @brief   Lets time pass until the next peripheral event or external input.
+ */
+static void idle(void) {
+  struct pollfd fds[SIM_MAX_FDS];
+  nfds_t nfds = 0;
+  uint64_t target = 0;
+  bool last = false;
+  sim_peripheral_t *p;
+
+  for (p = peripherals; p != NULL; p = p->link) {
+    uint64_t t = p->next(p->ctx);
+
+    if (t != 0 && (target == 0 || t < target)) {
+      target = t;
+    }
+    if (p->fd != NULL && nfds < SIM_MAX_FDS) {
+      int fd = p->fd(p->ctx);
+
+      if (fd >= 0) {
+        fds[nfds].fd = fd;
+        fds[nfds].events = POLLIN;
+        nfds++;
+      }
+    }
+  }
+  if (target != 0 && target < now_ns) {
+    target = now_ns;
+  }
+  if (end_ns != 0 && (target == 0 || target >= end_ns)) {
+    target = end_ns;
+    last = true;
+  }
+  if (target == 0 && nfds == 0) {
+    fprintf(stderr, "sim: nothing left to happen at %llu ms\n",
+            (unsigned long long)(now_ns / 1000000U));
+    exit(0);
+  }
+
+  if (nfds > 0) {
+    int timeout = -1;
+
+    if (target != 0) {
+      timeout = 0;
+      if (speed != 0) {
+        uint64_t real = real_now();
+        uint64_t deadline = real_deadline(target);
+
+        timeout = deadline > real ? (int)((deadline - real + 999999U) / 1000000U) : 0;
+      }
+    }
+    if (poll(fds, nfds, timeout) > 0) {
+      /* Input arrived first, it happens now. */
+      if (speed != 0) {
+        uint64_t t = pace_virtual_ns + (real_now() - pace_real_ns) * speed;
+
+        if (t > now_ns) {
+          now_ns = target != 0 && t > target ? target : t;
+        }
+      }
+      return;
+    }
+  } else if (speed != 0) {
+    uint64_t real = real_now();
+    uint64_t deadline = real_deadline(target);
+
+    if (deadline > real) {
+      struct timespec ts;
+
+      ts.tv_sec = (time_t)((deadline - real) / 1000000000U);
+      ts.tv_nsec = (long)((deadline - real) % 1000000000U);
+      nanosleep(&ts, NULL);
+    }
+  }
+
+  now_ns = target;
+  if (last) {
+    exit(0);
+  }
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Low level HAL driver initialization.
+ */
+void hal_lld_init(void) {
+  /* A peer closing its socket must not kill the simulation.*/
+  signal(SIGPIPE, SIG_IGN);
+  end_ns = (uint64_t)simEnvUint(SIM_ENV_DURATION, 0) * 1000000U;
+  speed = simEnvUint(SIM_ENV_SPEED, 0);
+  pace_real_ns = real_now();
+  pace_virtual_ns = now_ns;
+}
+
+/**
+ * @brief   Runs the due peripheral events, or lets time pass if there are
+ *          none.
+ * @details Called by @p port_wait_for_interrupt() from the idle loop.
+ */
+void _sim_check_for_interrupts(void) {
+  bool ran = service_all();
+
+  if (!ran) {
+    idle();
+    ran = service_all();
+  }
+  if (ran) {
+    _dbg_check_lock();
+    if (chSchIsPreemptionRequired()) {
+      chSchDoReschedule();
+    }
+    _dbg_check_unlock();
+  }
+}
+
+/**
+ * @brief   Registers a peripheral with the simulator.
+ */
+void simAddPeripheral(sim_peripheral_t *p) {
+  p->link = peripherals;
+  peripherals = p;
+}
+
+/**
+ * @brief   Virtual time in ns since the start of the simulation.
+ */
+uint64_t simClockNow(void) {
+  return now_ns;
+}
+
+/**
+ * @brief   Accounts @p ns of virtual time to the running code.
+ * @details Used for operations which keep the CPU busy, such as polled bus
+ *          transfers.
+ */
+void simClockAdvance(uint64_t ns) {
+  now_ns += ns;
+}
+
+/**
+ * @brief   Reads a numeric environment variable.
+ */
+uint32_t simEnvUint(const char *name, uint32_t dflt) {
+  const char *value = getenv(name);
+
+  if (value == NULL || *value == '\0') {
+    return dflt;
+  }
+  return (uint32_t)strtoul(value, NULL, 0);
+}
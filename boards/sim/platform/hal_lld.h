@@ -0,0 +1,104 @@
+/**
+ * @file    hal_lld.h
+ * @brief   Simulator platform HAL subsystem low level driver header.
+ * @details The firmware runs as a Linux process on the SIMIA32 port of the
+ *          kernel. Peripherals are modelled on a discrete-event virtual
+ *          clock: code running on the CPU takes no virtual time, only bus
+ *          transfers, conversions and timers do. Whenever the firmware
+ *          idles (see @p port_wait_for_interrupt()) the clock jumps straight
+ *          to the next pending peripheral event, so a simulated hour passes
+ *          in about the time it takes to execute the firmware code that runs
+ *          in it.
+ *
+ *          Every peripheral registers a @p sim_peripheral_t which reports
+ *          its next event and services the events which are due, running
+ *          the driver ISR code. Peripherals talking to the outside world
+ *          (UART sockets and pipes) also report a file descriptor, the
+ *          simulator waits on it while nothing else is pending.
+ *
+ *          Run time behaviour is set through environment variables:
+ *          - @p SIM_DURATION_MS: exit after this much virtual time.
+ *          - @p SIM_SPEED: pace the virtual clock to this multiple of real
+ *            time, unset or 0 runs as fast as possible.
+ */
+
+#ifndef _HAL_LLD_H_
+#define _HAL_LLD_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Defines the support for realtime counters in the HAL.
+ */
+#define HAL_IMPLEMENTS_COUNTERS     FALSE
+
+/**
+ * @name    Platform identification
+ * @{
+ */
+#define PLATFORM_NAME               "Linux simulator"
+/** @} */
+
+/**
+ * @brief   Environment variables of the simulator core.
+ * @{
+ */
+#define SIM_ENV_DURATION            "SIM_DURATION_MS"
+#define SIM_ENV_SPEED               "SIM_SPEED"
+/** @} */
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   A simulated peripheral.
+ */
+typedef struct sim_peripheral sim_peripheral_t;
+
+struct sim_peripheral {
+  /**
+   * @brief   Virtual time of the next event in ns, 0 if none is pending.
+   */
+  uint64_t (*next)(void *ctx);
+  /**
+   * @brief   Applies the events which are due.
+   * @details Called with the kernel unlocked, the peripheral runs its ISR
+   *          code framed by @p OSAL_IRQ_PROLOGUE() / @p OSAL_IRQ_EPILOGUE().
+   * @return  @p true if anything happened (ISR run, pin changed), the
+   *          simulator then services all peripherals once more before it
+   *          lets the clock move.
+   */
+  bool (*service)(void *ctx);
+  /**
+   * @brief   File descriptor to wait on for input, -1 if none.
+   * @note    Optional, may be @p NULL.
+   */
+  int (*fd)(void *ctx);
+  void *ctx;
+  sim_peripheral_t *link;
+};
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void hal_lld_init(void);
+  void _sim_check_for_interrupts(void);
+  void simAddPeripheral(sim_peripheral_t *p);
+  uint64_t simClockNow(void);
+  void simClockAdvance(uint64_t ns);
+  uint32_t simEnvUint(const char *name, uint32_t dflt);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _HAL_LLD_H_ */
@@ -0,0 +1,172 @@
+/**
+ * @file    pal_lld.c
+ * @brief   Simulator platform PAL driver code.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "hal.h"
+
+#if HAL_USE_PAL || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+sim_gpio_t _sim_gpioa = {.name = 'A'};
+sim_gpio_t _sim_gpiob = {.name = 'B'};
+sim_gpio_t _sim_gpioc = {.name = 'C'};
+sim_gpio_t _sim_gpiod = {.name = 'D'};
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+static palsimhook_t hook;
+static FILE *trace;
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static bool pad_level(ioportid_t port, unsigned pad) {
+  ioportmask_t bit = PAL_PORT_BIT(pad);
+
+  switch (port->mode[pad]) {
+  case PAL_MODE_OUTPUT_PUSHPULL:
+    return (port->latch & bit) != 0;
+  case PAL_MODE_OUTPUT_OPENDRAIN:
+    if ((port->latch & bit) == 0) {
+      return false;
+    }
+    break;
+  default:
+    break;
+  }
+  if ((port->driven & bit) != 0) {
+    return (port->inputs & bit) != 0;
+  }
+  return port->mode[pad] == PAL_MODE_INPUT_PULLUP;
+}
+
+/**
+ * @brief   Recomputes the pin levels and reports the changes.
+ */
+static void update(ioportid_t port) {
+  ioportmask_t levels = 0;
+  ioportmask_t changed;
+  unsigned pad;
+
+  for (pad = 0; pad < PAL_IOPORTS_WIDTH; pad++) {
+    if (pad_level(port, pad)) {
+      levels |= PAL_PORT_BIT(pad);
+    }
+  }
+  changed = levels ^ port->levels;
+  port->levels = levels;
+  if (changed == 0) {
+    return;
+  }
+
+  if (trace != NULL) {
+    for (pad = 0; pad < PAL_IOPORTS_WIDTH; pad++) {
+      if ((changed & PAL_PORT_BIT(pad)) != 0) {
+        fprintf(trace, "%llu %c %u %u\n", (unsigned long long)simClockNow(),
+                port->name, pad, (unsigned)((levels >> pad) & 1U));
+      }
+    }
+  }
+  if (hook != NULL) {
+    hook(port, changed);
+  }
+}
+
+static void setup(ioportid_t port, const sim_gpio_setup_t *config) {
+  unsigned pad;
+
+  port->latch = config->latch;
+  for (pad = 0; pad < PAL_IOPORTS_WIDTH; pad++) {
+    port->mode[pad] = config->mode[pad];
+  }
+  update(port);
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Virtual ports initialization.
+ */
+void _pal_lld_init(const PALConfig *config) {
+  const char *path = getenv(SIM_ENV_PAL_TRACE);
+
+  if (path != NULL && *path != '\0') {
+    trace = fopen(path, "w");
+    if (trace == NULL) {
+      perror(path);
+      exit(1);
+    }
+    setvbuf(trace, NULL, _IOLBF, 0);
+  }
+
+  setup(GPIOA, &config->PAData);
+  setup(GPIOB, &config->PBData);
+  setup(GPIOC, &config->PCData);
+  setup(GPIOD, &config->PDData);
+}
+
+/**
+ * @brief   Writes the output latch of a port.
+ */
+void _pal_lld_writeport(ioportid_t port, ioportmask_t bits) {
+  port->latch = bits & PAL_WHOLE_PORT;
+  update(port);
+}
+
+/**
+ * @brief   Pads mode setup.
+ */
+void _pal_lld_setgroupmode(ioportid_t port, ioportmask_t mask, iomode_t mode) {
+  unsigned pad;
+
+  for (pad = 0; pad < PAL_IOPORTS_WIDTH; pad++) {
+    if ((mask & PAL_PORT_BIT(pad)) != 0) {
+      port->mode[pad] = mode;
+    }
+  }
+  update(port);
+}
+
+/**
+ * @brief   Drives a pin from outside the MCU.
+ * @note    An output configured as push-pull keeps its own level.
+ */
+void palSimDrive(ioportid_t port, unsigned pad, bool level) {
+  port->driven |= PAL_PORT_BIT(pad);
+  if (level) {
+    port->inputs |= PAL_PORT_BIT(pad);
+  } else {
+    port->inputs &= ~PAL_PORT_BIT(pad);
+  }
+  update(port);
+}
+
+/**
+ * @brief   Stops driving a pin from outside, it floats or follows its pull
+ *          resistor.
+ */
+void palSimRelease(ioportid_t port, unsigned pad) {
+  port->driven &= ~PAL_PORT_BIT(pad);
+  update(port);
+}
+
+/**
+ * @brief   Sets the function called on pin level changes.
+ */
+void palSimSetHook(palsimhook_t fn) {
+  hook = fn;
+}
+
+#endif /* HAL_USE_PAL */
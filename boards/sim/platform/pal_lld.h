@@ -0,0 +1,179 @@
+/**
+ * @file    pal_lld.h
+ * @brief   Simulator platform PAL driver header.
+ * @details Virtual 16 bit ports. A pin reads its output latch when
+ *          configured as push-pull output, otherwise the level driven on it
+ *          from outside (@p palSimDrive()) or, if nothing drives it, the
+ *          level given by its pull resistor. Level changes can be traced to
+ *          the file named by @p SIM_PAL_TRACE, one line per change:
+ *          <tt>time_ns port pad level</tt>.
+ */
+
+#ifndef _PAL_LLD_H_
+#define _PAL_LLD_H_
+
+#if HAL_USE_PAL || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Unsupported modes and specific modes                                      */
+/*===========================================================================*/
+
+#undef PAL_MODE_RESET
+#undef PAL_MODE_UNCONNECTED
+
+/**
+ * @brief   Reset state, all pins are floating inputs.
+ */
+#define PAL_MODE_RESET              PAL_MODE_INPUT
+
+/**
+ * @brief   Unconnected pins are pulled down.
+ */
+#define PAL_MODE_UNCONNECTED        PAL_MODE_INPUT_PULLDOWN
+
+/**
+ * @brief   Pin handed over to a peripheral, it is then driven by the
+ *          peripheral model and reads as a floating input.
+ */
+#define PAL_MODE_ALTERNATE(n)       (16U | ((n) << 8))
+
+/*===========================================================================*/
+/* I/O Ports Types and constants.                                            */
+/*===========================================================================*/
+
+/**
+ * @brief   Environment variable naming the pin trace file.
+ */
+#define SIM_ENV_PAL_TRACE           "SIM_PAL_TRACE"
+
+/**
+ * @brief   Width, in bits, of an I/O port.
+ */
+#define PAL_IOPORTS_WIDTH           16
+
+/**
+ * @brief   Whole port mask.
+ */
+#define PAL_WHOLE_PORT              ((ioportmask_t)0xFFFF)
+
+/**
+ * @name    Line handling macros
+ * @{
+ */
+#define PAL_LINE(port, pad)                                                 \
+  ((ioline_t)((uint32_t)(uintptr_t)(port)) | ((uint32_t)(pad)))
+#define PAL_PORT(line)                                                      \
+  ((ioportid_t)(uintptr_t)(((uint32_t)(line)) & 0xFFFFFFF0U))
+#define PAL_PAD(line)                                                       \
+  ((uint32_t)((uint32_t)(line) & 0x0000000FU))
+#define PAL_NOLINE                  0U
+/** @} */
+
+/**
+ * @brief   Digital I/O port sized unsigned type.
+ */
+typedef uint32_t ioportmask_t;
+
+/**
+ * @brief   Digital I/O modes.
+ */
+typedef uint32_t iomode_t;
+
+/**
+ * @brief   Type of an I/O line.
+ */
+typedef uint32_t ioline_t;
+
+/**
+ * @brief   A virtual port.
+ */
+typedef struct {
+  ioportmask_t latch;               /**< Output latch.                      */
+  ioportmask_t driven;              /**< Pins driven from outside.          */
+  ioportmask_t inputs;              /**< Levels driven from outside.        */
+  ioportmask_t levels;              /**< Current pin levels.                */
+  iomode_t mode[PAL_IOPORTS_WIDTH];
+  char name;
+} __attribute__((aligned(16))) sim_gpio_t;
+
+/**
+ * @brief   Port Identifier.
+ */
+typedef sim_gpio_t *ioportid_t;
+
+/**
+ * @brief   Initial set-up of a port.
+ */
+typedef struct {
+  ioportmask_t latch;
+  iomode_t mode[PAL_IOPORTS_WIDTH];
+} sim_gpio_setup_t;
+
+/**
+ * @brief   PAL initialization structure.
+ */
+typedef struct {
+  sim_gpio_setup_t PAData;
+  sim_gpio_setup_t PBData;
+  sim_gpio_setup_t PCData;
+  sim_gpio_setup_t PDData;
+} PALConfig;
+
+/**
+ * @brief   Called after pin levels of a port changed.
+ *
+ * @param[in] changed   Pins whose level changed.
+ */
+typedef void (*palsimhook_t)(ioportid_t port, ioportmask_t changed);
+
+/*===========================================================================*/
+/* I/O Ports Identifiers.                                                    */
+/*===========================================================================*/
+
+#define GPIOA                       (&_sim_gpioa)
+#define GPIOB                       (&_sim_gpiob)
+#define GPIOC                       (&_sim_gpioc)
+#define GPIOD                       (&_sim_gpiod)
+
+#define IOPORT1                     GPIOA
+#define IOPORT2                     GPIOB
+#define IOPORT3                     GPIOC
+#define IOPORT4                     GPIOD
+
+/*===========================================================================*/
+/* Implementation, some of the following macros could be implemented as      */
+/* functions, if so please put them in pal_lld.c.                            */
+/*===========================================================================*/
+
+#define pal_lld_init(config)        _pal_lld_init(config)
+
+#define pal_lld_readport(port)      ((port)->levels)
+
+#define pal_lld_readlatch(port)     ((port)->latch)
+
+#define pal_lld_writeport(port, bits) _pal_lld_writeport(port, bits)
+
+#define pal_lld_setgroupmode(port, mask, offset, mode)                      \
+  _pal_lld_setgroupmode(port, (mask) << (offset), mode)
+
+#if !defined(__DOXYGEN__)
+extern sim_gpio_t _sim_gpioa, _sim_gpiob, _sim_gpioc, _sim_gpiod;
+extern const PALConfig pal_default_config;
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void _pal_lld_init(const PALConfig *config);
+  void _pal_lld_writeport(ioportid_t port, ioportmask_t bits);
+  void _pal_lld_setgroupmode(ioportid_t port, ioportmask_t mask, iomode_t mode);
+  void palSimDrive(ioportid_t port, unsigned pad, bool level);
+  void palSimRelease(ioportid_t port, unsigned pad);
+  void palSimSetHook(palsimhook_t hook);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_USE_PAL */
+
+#endif /* _PAL_LLD_H_ */
@@ -0,0 +1,16 @@
+# Simulated HAL platform of the sim board: the ChibiOS HAL drivers on a
+# discrete-event virtual clock, running as a Linux process.
+SIMPLATFORMDIR = boards/sim/platform
+
+PLATFORMSRC = $(SIMPLATFORMDIR)/hal_lld.c \
+              $(SIMPLATFORMDIR)/sim_io.c \
+              $(SIMPLATFORMDIR)/st_lld.c \
+              $(SIMPLATFORMDIR)/pal_lld.c \
+              $(SIMPLATFORMDIR)/ext_lld.c \
+              $(SIMPLATFORMDIR)/gpt_lld.c \
+              $(SIMPLATFORMDIR)/spi_lld.c \
+              $(SIMPLATFORMDIR)/uart_lld.c \
+              $(SIMPLATFORMDIR)/adc_lld.c \
+              $(SIMPLATFORMDIR)/dac_lld.c
+
+PLATFORMINC = $(SIMPLATFORMDIR)
@@ -0,0 +1,152 @@
+/**
+ * @file    sim_io.c
+ * @brief   Outside world connections of the simulated peripherals.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "sim_io.h"
+
+static void fail(const char *spec) {
+  fprintf(stderr, "sim: %s: %s\n", spec, strerror(errno));
+  exit(1);
+}
+
+static int unix_socket(const char *path, struct sockaddr_un *addr) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  strncpy(addr->sun_path, path, sizeof(addr->sun_path) - 1);
+  return fd;
+}
+
+static int tcp_connect(const char *hostport) {
+  struct addrinfo hints, *res, *ai;
+  char host[256];
+  const char *colon = strrchr(hostport, ':');
+  int fd = -1;
+
+  if (colon == NULL || (size_t)(colon - hostport) >= sizeof(host)) {
+    errno = EINVAL;
+    return -1;
+  }
+  memcpy(host, hostport, (size_t)(colon - hostport));
+  host[colon - hostport] = '\0';
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(host, colon + 1, &hints, &res) != 0) {
+    errno = EHOSTUNREACH;
+    return -1;
+  }
+  for (ai = res; ai != NULL; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+      break;
+    }
+    if (fd >= 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(res);
+  return fd;
+}
+
+/**
+ * @brief   Opens a connection, exits on failure.
+ * @return  Non-blocking file descriptor.
+ */
+int simIoOpen(const char *spec) {
+  struct sockaddr_un addr;
+  int fd;
+
+  if (strncmp(spec, "tcp:", 4) == 0) {
+    fd = tcp_connect(spec + 4);
+  } else if (strncmp(spec, "unix:", 5) == 0) {
+    fd = unix_socket(spec + 5, &addr);
+    if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+      close(fd);
+      fd = -1;
+    }
+  } else if (strncmp(spec, "listen:", 7) == 0) {
+    int server = unix_socket(spec + 7, &addr);
+
+    unlink(spec + 7);
+    if (server < 0 || bind(server, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(server, 1) != 0) {
+      fail(spec);
+    }
+    fprintf(stderr, "sim: waiting for a peer on %s\n", spec + 7);
+    fd = accept(server, NULL, NULL);
+    close(server);
+  } else {
+    fd = open(spec, O_RDWR | O_CREAT | O_NOCTTY, 0644);
+  }
+  if (fd < 0) {
+    fail(spec);
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  return fd;
+}
+
+/**
+ * @brief   Opens the connection named by an environment variable.
+ * @return  File descriptor, -1 if the variable is not set.
+ */
+int simIoOpenEnv(const char *name) {
+  const char *spec = getenv(name);
+
+  if (spec == NULL || *spec == '\0') {
+    return -1;
+  }
+  return simIoOpen(spec);
+}
+
+/**
+ * @brief   Creates or truncates an output file, exits on failure.
+ */
+int simIoCreate(const char *path) {
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+  if (fd < 0) {
+    fail(path);
+  }
+  return fd;
+}
+
+/**
+ * @brief   Writes the whole buffer, waiting for the peer if need be.
+ * @details A peer which went away is ignored, the data is dropped.
+ */
+void simIoWrite(int fd, const void *buf, size_t n) {
+  const uint8_t *p = buf;
+
+  while (n > 0) {
+    ssize_t done = write(fd, p, n);
+
+    if (done < 0) {
+      struct pollfd pfd = {fd, POLLOUT, 0};
+
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        poll(&pfd, 1, -1);
+        continue;
+      }
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    p += done;
+    n -= (size_t)done;
+  }
+}
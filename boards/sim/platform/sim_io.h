@@ -0,0 +1,31 @@
+/**
+ * @file    sim_io.h
+ * @brief   Outside world connections of the simulated peripherals.
+ * @details A connection is named by a spec string, usually taken from an
+ *          environment variable:
+ *          - @p tcp:HOST:PORT connects to a TCP server.
+ *          - @p unix:PATH connects to a UNIX socket.
+ *          - @p listen:PATH listens on a UNIX socket and waits for the
+ *            first peer at start-up.
+ *          - anything else is a path opened read/write, e.g. a FIFO, a pty
+ *            or a plain file.
+ */
+
+#ifndef _SIM_IO_H_
+#define _SIM_IO_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  int simIoOpen(const char *spec);
+  int simIoOpenEnv(const char *name);
+  int simIoCreate(const char *path);
+  void simIoWrite(int fd, const void *buf, size_t n);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SIM_IO_H_ */
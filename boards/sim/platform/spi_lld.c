@@ -0,0 +1,206 @@
+/**
+ * @file    spi_lld.c
+ * @brief   Simulator platform SPI driver code.
+ */
+
+#include "hal.h"
+
+#if HAL_USE_SPI || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+#if SIM_SPI_USE_SPI1 || defined(__DOXYGEN__)
+/** @brief SPI1 driver identifier.*/
+SPIDriver SPID1;
+#endif
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static bool wide_frames(SPIDriver *spip) {
+  return (spip->config->cr2 & SPI_CR2_DS) > (SPI_CR2_DS_2 | SPI_CR2_DS_1 |
+                                              SPI_CR2_DS_0);
+}
+
+/**
+ * @brief   Clocks one frame through the selected device.
+ * @details With nothing selected MISO floats, it reads as all ones.
+ */
+static uint16_t clock_frame(SPIDriver *spip, uint16_t mosi) {
+  if (spip->selected == NULL) {
+    return 0xFFFF;
+  }
+  return spip->selected->exchange(spip->selected->ctx, mosi);
+}
+
+/**
+ * @brief   Exchanges the frames of a DMA transfer and schedules its end.
+ */
+static void start_transfer(SPIDriver *spip, size_t n, const void *txbuf,
+                           void *rxbuf) {
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    uint16_t mosi = 0xFFFF;
+    uint16_t miso;
+
+    if (txbuf != NULL) {
+      mosi = wide_frames(spip) ? ((const uint16_t *)txbuf)[i]
+                               : ((const uint8_t *)txbuf)[i];
+    }
+    miso = clock_frame(spip, mosi);
+    if (rxbuf != NULL) {
+      if (wide_frames(spip)) {
+        ((uint16_t *)rxbuf)[i] = miso;
+      } else {
+        ((uint8_t *)rxbuf)[i] = (uint8_t)miso;
+      }
+    }
+  }
+  spip->doneAt = simClockNow() + (uint64_t)n * spip->frameNs;
+}
+
+static uint64_t spi_next(void *ctx) {
+  SPIDriver *spip = ctx;
+
+  return spip->doneAt;
+}
+
+static bool spi_service(void *ctx) {
+  SPIDriver *spip = ctx;
+
+  if (spip->doneAt == 0 || simClockNow() < spip->doneAt) {
+    return false;
+  }
+  spip->doneAt = 0;
+
+  OSAL_IRQ_PROLOGUE();
+  _spi_isr_code(spip);
+  OSAL_IRQ_EPILOGUE();
+  return true;
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Low level SPI driver initialization.
+ */
+void spi_lld_init(void) {
+#if SIM_SPI_USE_SPI1
+  spiObjectInit(&SPID1);
+  SPID1.devices = NULL;
+  SPID1.selected = NULL;
+  SPID1.doneAt = 0;
+  SPID1.sim.next = spi_next;
+  SPID1.sim.service = spi_service;
+  SPID1.sim.fd = NULL;
+  SPID1.sim.ctx = &SPID1;
+  simAddPeripheral(&SPID1.sim);
+#endif
+}
+
+/**
+ * @brief   Configures and activates the SPI peripheral.
+ * @details The frame time follows from the baud rate prescaler and the
+ *          data size.
+ */
+void spi_lld_start(SPIDriver *spip) {
+  uint32_t baud = SIM_SPI_PCLK >> (((spip->config->cr1 & SPI_CR1_BR) >> 3) + 1);
+  uint32_t bits = ((spip->config->cr2 & SPI_CR2_DS) >> 8) + 1;
+
+  if (bits < 4) {
+    bits = 8;
+  }
+  spip->frameNs = (uint32_t)((uint64_t)bits * 1000000000U / baud);
+}
+
+/**
+ * @brief   Deactivates the SPI peripheral.
+ */
+void spi_lld_stop(SPIDriver *spip) {
+  spip->doneAt = 0;
+}
+
+/**
+ * @brief   Asserts the slave select signal and prepares for transfers.
+ */
+void spi_lld_select(SPIDriver *spip) {
+  sim_spi_device_t *dev;
+
+  palClearPad(spip->config->ssport, spip->config->sspad);
+  for (dev = spip->devices; dev != NULL; dev = dev->link) {
+    if (dev->ssport == spip->config->ssport &&
+        dev->sspad == spip->config->sspad) {
+      break;
+    }
+  }
+  spip->selected = dev;
+  if (dev != NULL && dev->select != NULL) {
+    dev->select(dev->ctx, true);
+  }
+}
+
+/**
+ * @brief   Deasserts the slave select signal.
+ */
+void spi_lld_unselect(SPIDriver *spip) {
+  sim_spi_device_t *dev = spip->selected;
+
+  spip->selected = NULL;
+  if (dev != NULL && dev->select != NULL) {
+    dev->select(dev->ctx, false);
+  }
+  palSetPad(spip->config->ssport, spip->config->sspad);
+}
+
+/**
+ * @brief   Ignores data on the SPI bus.
+ */
+void spi_lld_ignore(SPIDriver *spip, size_t n) {
+  start_transfer(spip, n, NULL, NULL);
+}
+
+/**
+ * @brief   Exchanges data on the SPI bus.
+ */
+void spi_lld_exchange(SPIDriver *spip, size_t n,
+                      const void *txbuf, void *rxbuf) {
+  start_transfer(spip, n, txbuf, rxbuf);
+}
+
+/**
+ * @brief   Sends data over the SPI bus.
+ */
+void spi_lld_send(SPIDriver *spip, size_t n, const void *txbuf) {
+  start_transfer(spip, n, txbuf, NULL);
+}
+
+/**
+ * @brief   Receives data from the SPI bus.
+ */
+void spi_lld_receive(SPIDriver *spip, size_t n, void *rxbuf) {
+  start_transfer(spip, n, NULL, rxbuf);
+}
+
+/**
+ * @brief   Exchanges one frame using a polled wait.
+ */
+uint16_t spi_lld_polled_exchange(SPIDriver *spip, uint16_t frame) {
+  simClockAdvance(spip->frameNs);
+  return clock_frame(spip, frame);
+}
+
+/**
+ * @brief   Attaches a device to the bus.
+ */
+void spiSimAttach(SPIDriver *spip, sim_spi_device_t *dev) {
+  dev->link = spip->devices;
+  spip->devices = dev;
+}
+
+#endif /* HAL_USE_SPI */
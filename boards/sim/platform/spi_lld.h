@@ -0,0 +1,195 @@
+/**
+ * @file    spi_lld.h
+ * @brief   Simulator platform SPI driver header.
+ * @details The configuration mirrors the STM32 SPIv2 one (CR1/CR2 values,
+ *          slave select pad), so drivers written for the board build
+ *          unchanged. Devices are attached to the bus with
+ *          @p spiSimAttach() and selected by their slave select pad.
+ *
+ *          Polled exchanges keep the CPU busy for the frame time. Other
+ *          transfers model DMA: the data is exchanged at once and the
+ *          transfer completes, with its callback and the waiting thread
+ *          woken up, after the bus time of all the frames.
+ */
+
+#ifndef _SPI_LLD_H_
+#define _SPI_LLD_H_
+
+#if HAL_USE_SPI || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/**
+ * @name    CR1 and CR2 bits used by the model
+ * @{
+ */
+#define SPI_CR1_CPHA                0x0001U
+#define SPI_CR1_CPOL                0x0002U
+#define SPI_CR1_BR_0                0x0008U
+#define SPI_CR1_BR_1                0x0010U
+#define SPI_CR1_BR_2                0x0020U
+#define SPI_CR1_BR                  0x0038U
+#define SPI_CR1_LSBFIRST            0x0080U
+
+#define SPI_CR2_DS_0                0x0100U
+#define SPI_CR2_DS_1                0x0200U
+#define SPI_CR2_DS_2                0x0400U
+#define SPI_CR2_DS_3                0x0800U
+#define SPI_CR2_DS                  0x0F00U
+/** @} */
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   SPI1 driver enable switch.
+ */
+#if !defined(SIM_SPI_USE_SPI1) || defined(__DOXYGEN__)
+#define SIM_SPI_USE_SPI1            TRUE
+#endif
+
+/**
+ * @brief   Peripheral clock the baud rate prescaler divides.
+ */
+#if !defined(SIM_SPI_PCLK) || defined(__DOXYGEN__)
+#define SIM_SPI_PCLK                48000000U
+#endif
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Type of a structure representing an SPI driver.
+ */
+typedef struct SPIDriver SPIDriver;
+
+/**
+ * @brief   SPI notification callback type.
+ */
+typedef void (*spicallback_t)(SPIDriver *spip);
+
+/**
+ * @brief   Driver configuration structure.
+ */
+typedef struct {
+  /**
+   * @brief Operation complete callback or @p NULL.
+   */
+  spicallback_t             end_cb;
+  /* End of the mandatory fields.*/
+  /**
+   * @brief The chip select line port.
+   */
+  ioportid_t                ssport;
+  /**
+   * @brief The chip select line pad number.
+   */
+  uint16_t                  sspad;
+  /**
+   * @brief SPI CR1 register initialization data.
+   */
+  uint16_t                  cr1;
+  /**
+   * @brief SPI CR2 register initialization data.
+   */
+  uint16_t                  cr2;
+} SPIConfig;
+
+/**
+ * @brief   A device on a simulated bus.
+ */
+typedef struct sim_spi_device sim_spi_device_t;
+
+struct sim_spi_device {
+  ioportid_t                ssport;
+  uint16_t                  sspad;
+  void                      (*select)(void *ctx, bool selected);
+  /**
+   * @brief Exchanges one frame, returns the MISO data.
+   */
+  uint16_t                  (*exchange)(void *ctx, uint16_t mosi);
+  void                      *ctx;
+  sim_spi_device_t          *link;
+};
+
+/**
+ * @brief   Structure representing an SPI driver.
+ */
+struct SPIDriver {
+  /**
+   * @brief Driver state.
+   */
+  spistate_t                state;
+  /**
+   * @brief Current configuration data.
+   */
+  const SPIConfig           *config;
+#if SPI_USE_WAIT || defined(__DOXYGEN__)
+  /**
+   * @brief   Waiting thread.
+   */
+  thread_reference_t        thread;
+#endif /* SPI_USE_WAIT */
+#if SPI_USE_MUTUAL_EXCLUSION || defined(__DOXYGEN__)
+  /**
+   * @brief   Mutex protecting the peripheral.
+   */
+  mutex_t                   mutex;
+#endif /* SPI_USE_MUTUAL_EXCLUSION */
+#if defined(SPI_DRIVER_EXT_FIELDS)
+  SPI_DRIVER_EXT_FIELDS
+#endif
+  /* End of the mandatory fields.*/
+  /**
+   * @brief Attached devices.
+   */
+  sim_spi_device_t          *devices;
+  /**
+   * @brief Selected device, @p NULL if none.
+   */
+  sim_spi_device_t          *selected;
+  /**
+   * @brief Bus time of one frame in ns.
+   */
+  uint32_t                  frameNs;
+  /**
+   * @brief Completion time of the transfer in flight, 0 if none.
+   */
+  uint64_t                  doneAt;
+  sim_peripheral_t          sim;
+};
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#if SIM_SPI_USE_SPI1 && !defined(__DOXYGEN__)
+extern SPIDriver SPID1;
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void spi_lld_init(void);
+  void spi_lld_start(SPIDriver *spip);
+  void spi_lld_stop(SPIDriver *spip);
+  void spi_lld_select(SPIDriver *spip);
+  void spi_lld_unselect(SPIDriver *spip);
+  void spi_lld_ignore(SPIDriver *spip, size_t n);
+  void spi_lld_exchange(SPIDriver *spip, size_t n,
+                        const void *txbuf, void *rxbuf);
+  void spi_lld_send(SPIDriver *spip, size_t n, const void *txbuf);
+  void spi_lld_receive(SPIDriver *spip, size_t n, void *rxbuf);
+  uint16_t spi_lld_polled_exchange(SPIDriver *spip, uint16_t frame);
+  void spiSimAttach(SPIDriver *spip, sim_spi_device_t *dev);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_USE_SPI */
+
+#endif /* _SPI_LLD_H_ */
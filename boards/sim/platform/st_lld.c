@@ -0,0 +1,96 @@
+/**
+ * @file    st_lld.c
+ * @brief   Simulator platform ST driver code.
+ */
+
+#include "hal.h"
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+static systime_t alarm_time;
+static bool alarm_active;
+static sim_peripheral_t st_peripheral;
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+/**
+ * @brief   Ticks since the start of the simulation.
+ */
+static uint64_t ticks(void) {
+  return simClockNow() / 1000U * OSAL_ST_FREQUENCY / 1000000U;
+}
+
+static uint64_t st_next(void *ctx) {
+  uint64_t now = ticks();
+  systime_t delta;
+
+  (void)ctx;
+  if (!alarm_active) {
+    return 0;
+  }
+  delta = (systime_t)(alarm_time - (systime_t)now);
+  return ((now + delta) * 1000000U + OSAL_ST_FREQUENCY - 1) /
+         OSAL_ST_FREQUENCY * 1000U;
+}
+
+static bool st_service(void *ctx) {
+  systime_t elapsed;
+
+  (void)ctx;
+  elapsed = (systime_t)((systime_t)ticks() - alarm_time);
+  if (!alarm_active || elapsed >= (systime_t)1 << 31) {
+    return false;
+  }
+
+  OSAL_IRQ_PROLOGUE();
+  osalSysLockFromISR();
+  osalOsTimerHandlerI();
+  osalSysUnlockFromISR();
+  OSAL_IRQ_EPILOGUE();
+  return true;
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Low level ST driver initialization.
+ */
+void st_lld_init(void) {
+  alarm_active = false;
+  st_peripheral.next = st_next;
+  st_peripheral.service = st_service;
+  st_peripheral.fd = NULL;
+  st_peripheral.ctx = NULL;
+  simAddPeripheral(&st_peripheral);
+}
+
+systime_t st_lld_get_counter(void) {
+  return (systime_t)ticks();
+}
+
+void st_lld_start_alarm(systime_t abstime) {
+  alarm_time = abstime;
+  alarm_active = true;
+}
+
+void st_lld_stop_alarm(void) {
+  alarm_active = false;
+}
+
+void st_lld_set_alarm(systime_t abstime) {
+  alarm_time = abstime;
+}
+
+systime_t st_lld_get_alarm(void) {
+  return alarm_time;
+}
+
+bool st_lld_is_alarm_active(void) {
+  return alarm_active;
+}
@@ -0,0 +1,41 @@
+/**
+ * @file    st_lld.h
+ * @brief   Simulator platform ST driver header.
+ * @details Free running system timer at @p OSAL_ST_FREQUENCY derived from the
+ *          virtual clock, with one alarm.
+ */
+
+#ifndef _ST_LLD_H_
+#define _ST_LLD_H_
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+#if OSAL_ST_MODE != OSAL_ST_MODE_FREERUNNING
+#error "the simulator platform only supports the free running ST mode"
+#endif
+
+#if OSAL_ST_RESOLUTION != 32
+#error "the simulator platform only supports a 32 bit system timer"
+#endif
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void st_lld_init(void);
+  systime_t st_lld_get_counter(void);
+  void st_lld_start_alarm(systime_t abstime);
+  void st_lld_stop_alarm(void);
+  void st_lld_set_alarm(systime_t abstime);
+  systime_t st_lld_get_alarm(void);
+  bool st_lld_is_alarm_active(void);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ST_LLD_H_ */
@@ -0,0 +1,224 @@
+/**
+ * @file    uart_lld.c
+ * @brief   Simulator platform UART driver code.
+ */
+
+#include <errno.h>
+#include <unistd.h>
+
+#include "hal.h"
+#include "sim_io.h"
+
+#if HAL_USE_UART || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+#if SIM_UART_USE_USART1 || defined(__DOXYGEN__)
+/** @brief USART1 UART driver identifier.*/
+UARTDriver UARTD1;
+#endif
+
+#if SIM_UART_USE_USART2 || defined(__DOXYGEN__)
+/** @brief USART2 UART driver identifier.*/
+UARTDriver UARTD2;
+#endif
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+/**
+ * @brief   Moves the bytes waiting on the connection into the queue.
+ */
+static void fill_queue(UARTDriver *uartp) {
+  while (uartp->fd >= 0 && !uartp->rxeof && uartp->qlen < SIM_UART_QUEUE_SIZE) {
+    size_t tail = (uartp->qhead + uartp->qlen) % SIM_UART_QUEUE_SIZE;
+    size_t room = SIM_UART_QUEUE_SIZE - uartp->qlen;
+    ssize_t n;
+
+    if (room > SIM_UART_QUEUE_SIZE - tail) {
+      room = SIM_UART_QUEUE_SIZE - tail;
+    }
+    n = read(uartp->fd, &uartp->queue[tail], room);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+      break;
+    }
+    if (n <= 0) {
+      uartp->rxeof = true;
+      break;
+    }
+    if (uartp->qlen == 0 && uartp->rxNextAt == 0) {
+      uartp->rxNextAt = simClockNow() + uartp->charNs;
+    }
+    uartp->qlen += (size_t)n;
+  }
+}
+
+static void receive_char(UARTDriver *uartp, uint8_t c) {
+  if (uartp->rxstate == UART_RX_ACTIVE) {
+    uartp->rxbuf[uartp->rxn++] = c;
+    if (uartp->rxn == uartp->rxsize) {
+      uartp->rxbuf = NULL;
+      _uart_rx_complete_isr_code(uartp);
+    }
+  } else if (uartp->config->rxchar_cb != NULL) {
+    uartp->config->rxchar_cb(uartp, c);
+  }
+}
+
+static uint64_t uart_next(void *ctx) {
+  UARTDriver *uartp = ctx;
+  uint64_t next = uartp->txDoneAt;
+
+  if (uartp->qlen > 0 && (next == 0 || uartp->rxNextAt < next)) {
+    next = uartp->rxNextAt;
+  }
+  return next;
+}
+
+static bool uart_service(void *ctx) {
+  UARTDriver *uartp = ctx;
+  uint64_t now = simClockNow();
+  bool ran = false;
+
+  if (uartp->state != UART_READY) {
+    return false;
+  }
+
+  fill_queue(uartp);
+  while (uartp->qlen > 0 && uartp->rxNextAt <= now) {
+    uint8_t c = uartp->queue[uartp->qhead];
+
+    uartp->qhead = (uartp->qhead + 1) % SIM_UART_QUEUE_SIZE;
+    uartp->qlen--;
+    uartp->rxNextAt = uartp->qlen > 0 ? uartp->rxNextAt + uartp->charNs : 0;
+
+    OSAL_IRQ_PROLOGUE();
+    receive_char(uartp, c);
+    OSAL_IRQ_EPILOGUE();
+    ran = true;
+  }
+
+  if (uartp->txDoneAt != 0 && uartp->txDoneAt <= now) {
+    uartp->txDoneAt = 0;
+    OSAL_IRQ_PROLOGUE();
+    _uart_tx1_isr_code(uartp);
+    _uart_tx2_isr_code(uartp);
+    OSAL_IRQ_EPILOGUE();
+    ran = true;
+  }
+  return ran;
+}
+
+static int uart_fd(void *ctx) {
+  UARTDriver *uartp = ctx;
+
+  if (uartp->state != UART_READY || uartp->rxeof ||
+      uartp->qlen == SIM_UART_QUEUE_SIZE) {
+    return -1;
+  }
+  return uartp->fd;
+}
+
+static void object_init(UARTDriver *uartp, const char *env) {
+  uartObjectInit(uartp);
+  uartp->env = env;
+  uartp->fd = -1;
+  uartp->sim.next = uart_next;
+  uartp->sim.service = uart_service;
+  uartp->sim.fd = uart_fd;
+  uartp->sim.ctx = uartp;
+  simAddPeripheral(&uartp->sim);
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Low level UART driver initialization.
+ */
+void uart_lld_init(void) {
+#if SIM_UART_USE_USART1
+  object_init(&UARTD1, "SIM_USART1");
+#endif
+#if SIM_UART_USE_USART2
+  object_init(&UARTD2, "SIM_USART2");
+#endif
+}
+
+/**
+ * @brief   Configures and activates the UART peripheral.
+ * @details The connection is opened on the first start.
+ */
+void uart_lld_start(UARTDriver *uartp) {
+  if (uartp->state == UART_STOP && uartp->fd < 0 && !uartp->rxeof) {
+    uartp->fd = simIoOpenEnv(uartp->env);
+    uartp->rxeof = uartp->fd < 0;
+  }
+  uartp->charNs = (uint32_t)(10000000000ULL / uartp->config->speed);
+  uartp->txDoneAt = 0;
+  uartp->rxbuf = NULL;
+}
+
+/**
+ * @brief   Deactivates the UART peripheral.
+ * @details The connection stays open, data arriving in the meantime waits
+ *          in the queue.
+ */
+void uart_lld_stop(UARTDriver *uartp) {
+  uartp->txDoneAt = 0;
+  uartp->rxbuf = NULL;
+}
+
+/**
+ * @brief   Starts a transmission on the UART peripheral.
+ */
+void uart_lld_start_send(UARTDriver *uartp, size_t n, const void *txbuf) {
+  if (uartp->fd >= 0) {
+    simIoWrite(uartp->fd, txbuf, n);
+  }
+  uartp->txn = n;
+  uartp->txStartAt = simClockNow();
+  uartp->txDoneAt = uartp->txStartAt + (uint64_t)n * uartp->charNs;
+}
+
+/**
+ * @brief   Stops any ongoing transmission.
+ *
+ * @return  The number of data frames not transmitted.
+ */
+size_t uart_lld_stop_send(UARTDriver *uartp) {
+  uint64_t sent = (simClockNow() - uartp->txStartAt) / uartp->charNs;
+
+  if (uartp->txDoneAt == 0) {
+    return 0;
+  }
+  uartp->txDoneAt = 0;
+  return sent >= uartp->txn ? 0 : uartp->txn - (size_t)sent;
+}
+
+/**
+ * @brief   Starts a receive operation on the UART peripheral.
+ */
+void uart_lld_start_receive(UARTDriver *uartp, size_t n, void *rxbuf) {
+  uartp->rxbuf = rxbuf;
+  uartp->rxsize = n;
+  uartp->rxn = 0;
+}
+
+/**
+ * @brief   Stops any ongoing receive operation.
+ *
+ * @return  The number of data frames not received.
+ */
+size_t uart_lld_stop_receive(UARTDriver *uartp) {
+  size_t left = uartp->rxbuf != NULL ? uartp->rxsize - uartp->rxn : 0;
+
+  uartp->rxbuf = NULL;
+  return left;
+}
+
+#endif /* HAL_USE_UART */
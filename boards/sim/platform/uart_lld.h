@@ -0,0 +1,218 @@
+/**
+ * @file    uart_lld.h
+ * @brief   Simulator platform UART driver header.
+ * @details USARTn is connected to the file, pipe or socket named by the
+ *          @p SIM_USARTn environment variable (see @p sim_io.h), without it
+ *          the transmitted data is dropped and nothing is received.
+ *
+ *          Characters take ten bit times at the configured speed on the
+ *          line. Transmission completes after the line time of the buffer.
+ *          Received characters are delivered one per character time, to the
+ *          receive buffer or to @p rxchar_cb when no buffer is set. The
+ *          configuration has the layout of the STM32 driver of ChibiOS 16.1,
+ *          which has no idle line callback either.
+ */
+
+#ifndef _UART_LLD_H_
+#define _UART_LLD_H_
+
+#if HAL_USE_UART || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Size of the receive queue between the outside world and the
+ *          simulated line.
+ */
+#define SIM_UART_QUEUE_SIZE         1024
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   USART1 driver enable switch.
+ */
+#if !defined(SIM_UART_USE_USART1) || defined(__DOXYGEN__)
+#define SIM_UART_USE_USART1         TRUE
+#endif
+
+/**
+ * @brief   USART2 driver enable switch.
+ */
+#if !defined(SIM_UART_USE_USART2) || defined(__DOXYGEN__)
+#define SIM_UART_USE_USART2         TRUE
+#endif
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   UART driver condition flags type.
+ */
+typedef uint32_t uartflags_t;
+
+/**
+ * @brief   Structure representing an UART driver.
+ */
+typedef struct UARTDriver UARTDriver;
+
+/**
+ * @brief   Generic UART notification callback type.
+ */
+typedef void (*uartcb_t)(UARTDriver *uartp);
+
+/**
+ * @brief   Character received UART notification callback type.
+ */
+typedef void (*uartccb_t)(UARTDriver *uartp, uint16_t c);
+
+/**
+ * @brief   Receive error UART notification callback type.
+ */
+typedef void (*uartecb_t)(UARTDriver *uartp, uartflags_t e);
+
+/**
+ * @brief   Driver configuration structure.
+ */
+typedef struct {
+  /**
+   * @brief End of transmission buffer callback.
+   */
+  uartcb_t                  txend1_cb;
+  /**
+   * @brief Physical end of transmission callback.
+   */
+  uartcb_t                  txend2_cb;
+  /**
+   * @brief Receive buffer filled callback.
+   */
+  uartcb_t                  rxend_cb;
+  /**
+   * @brief Character received while out if the @p UART_RECEIVE state.
+   */
+  uartccb_t                 rxchar_cb;
+  /**
+   * @brief Receive error callback.
+   */
+  uartecb_t                 rxerr_cb;
+  /* End of the mandatory fields.*/
+  /**
+   * @brief Bit rate.
+   */
+  uint32_t                  speed;
+  /**
+   * @brief Initialization value for the CR1 register, unused.
+   */
+  uint16_t                  cr1;
+  /**
+   * @brief Initialization value for the CR2 register, unused.
+   */
+  uint16_t                  cr2;
+  /**
+   * @brief Initialization value for the CR3 register, unused.
+   */
+  uint16_t                  cr3;
+} UARTConfig;
+
+/**
+ * @brief   Structure representing an UART driver.
+ */
+struct UARTDriver {
+  /**
+   * @brief Driver state.
+   */
+  uartstate_t               state;
+  /**
+   * @brief Transmitter state.
+   */
+  uarttxstate_t             txstate;
+  /**
+   * @brief Receiver state.
+   */
+  uartrxstate_t             rxstate;
+  /**
+   * @brief Current configuration data.
+   */
+  const UARTConfig          *config;
+#if UART_USE_WAIT || defined(__DOXYGEN__)
+  /**
+   * @brief   Synchronization flag for transmit operations.
+   */
+  bool                      early;
+  /**
+   * @brief   Waiting thread on RX.
+   */
+  thread_reference_t        threadrx;
+  /**
+   * @brief   Waiting thread on TX.
+   */
+  thread_reference_t        threadtx;
+#endif /* UART_USE_WAIT */
+#if UART_USE_MUTUAL_EXCLUSION || defined(__DOXYGEN__)
+  /**
+   * @brief   Mutex protecting the peripheral.
+   */
+  mutex_t                   mutex;
+#endif /* UART_USE_MUTUAL_EXCLUSION */
+#if defined(UART_DRIVER_EXT_FIELDS)
+  UART_DRIVER_EXT_FIELDS
+#endif
+  /* End of the mandatory fields.*/
+  /**
+   * @brief Environment variable naming the connection.
+   */
+  const char                *env;
+  int                       fd;
+  bool                      rxeof;
+  /**
+   * @brief Line time of one character in ns.
+   */
+  uint32_t                  charNs;
+  /* Transmission in flight. */
+  uint64_t                  txStartAt;
+  uint64_t                  txDoneAt;
+  size_t                    txn;
+  /* Reception. */
+  uint8_t                   *rxbuf;
+  size_t                    rxsize;
+  size_t                    rxn;
+  uint8_t                   queue[SIM_UART_QUEUE_SIZE];
+  size_t                    qhead;
+  size_t                    qlen;
+  uint64_t                  rxNextAt;
+  sim_peripheral_t          sim;
+};
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#if SIM_UART_USE_USART1 && !defined(__DOXYGEN__)
+extern UARTDriver UARTD1;
+#endif
+
+#if SIM_UART_USE_USART2 && !defined(__DOXYGEN__)
+extern UARTDriver UARTD2;
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void uart_lld_init(void);
+  void uart_lld_start(UARTDriver *uartp);
+  void uart_lld_stop(UARTDriver *uartp);
+  void uart_lld_start_send(UARTDriver *uartp, size_t n, const void *txbuf);
+  size_t uart_lld_stop_send(UARTDriver *uartp);
+  void uart_lld_start_receive(UARTDriver *uartp, size_t n, void *rxbuf);
+  size_t uart_lld_stop_receive(UARTDriver *uartp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_USE_UART */
+
+#endif /* _UART_LLD_H_ */
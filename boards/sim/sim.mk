@@ -0,0 +1,66 @@
+##############################################################################
+# Build rules of the sim board: the firmware as a 32 bit Linux process on the
+# SIMIA32 port of the kernel, with the simulated HAL platform of
+# boards/sim/platform. Included by the main Makefile for BOARD = sim.
+#
+
+# Imported source files and paths
+include $(CHIBIOS)/os/hal/hal.mk
+include $(BOARD_FOLDER)/platform/platform.mk
+include $(BOARD_FOLDER)/board.mk
+include $(CHIBIOS)/os/hal/osal/rt/osal.mk
+include $(CHIBIOS)/os/rt/rt.mk
+include $(CHIBIOS)/os/rt/ports/SIMIA32/compilers/GCC/port.mk
+
+SIMSRC = $(KERNSRC) \
+         $(PORTSRC) \
+         $(OSALSRC) \
+         $(HALSRC) \
+         $(PLATFORMSRC) \
+         $(BOARDSRC) \
+         $(shell find src/ -type f -name '*.c')
+
+SIMINC = $(KERNINC) $(PORTINC) $(OSALINC) \
+         $(HALINC) $(PLATFORMINC) $(BOARDINC) \
+         $(CHIBIOS)/os/various \
+         $(UINCDIR)
+
+# Compiler settings, the SIMIA32 port is 32 bit only.
+SIMCC     = gcc
+SIMOPT    = -m32 -O2 -ggdb -fno-stack-protector
+SIMCFLAGS = $(SIMOPT) $(CWARN) -DSIMULATOR $(UDEFS) \
+            $(addprefix -I,$(SIMINC)) -MD -MP
+SIMLDFLAGS = -m32
+
+SIMBUILDDIR = build/sim
+SIMOBJDIR   = $(SIMBUILDDIR)/obj
+SIMOBJS     = $(addprefix $(SIMOBJDIR)/,$(notdir $(SIMSRC:.c=.o)))
+SIMELF      = $(SIMBUILDDIR)/$(PROJECT)
+
+vpath %.c $(sort $(dir $(SIMSRC)))
+
+all: $(SIMELF)
+
+$(SIMOBJDIR):
+	mkdir -p $@
+
+$(SIMOBJDIR)/%.o: %.c | $(SIMOBJDIR)
+	$(SIMCC) -c $(SIMCFLAGS) $< -o $@
+
+$(SIMELF): $(SIMOBJS)
+	$(SIMCC) $(SIMLDFLAGS) $^ -o $@ $(ULIBS)
+
+# Runs the simulated reader, see README.md for the SIM_* variables.
+run: $(SIMELF)
+	./$(SIMELF)
+
+clean:
+	rm -rf $(SIMBUILDDIR)
+
+.PHONY: all run clean
+
+-include $(wildcard $(SIMOBJDIR)/*.d)
+
+#
+# Build rules of the sim board
+##############################################################################
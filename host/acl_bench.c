@@ -0,0 +1,229 @@
+/**
+ * @file    acl_bench.c
+ * @brief   Lookup time and flash footprint of the offline access list.
+ * @details Builds lists of 1000, 10000 and 50000 random cards, mostly
+ *          double size UIDs, with plain keys without and with the Bloom
+ *          filter and with keys in Rice coded blocks of 64, 128 and 256
+ *          bytes, and looks up cards on the list and cards which are not.
+ *          Reports the image size and the cards per kB, whether it fits in
+ *          the flash region of reader-revA on the F072 and in a region of
+ *          16 kB, as left on an F052, the median lookup time in cycles of
+ *          the build machine (see @p platformCycles()), the keys compared
+ *          per search, the keys decoded per search and the share of the
+ *          absent cards the filter lets through to the search.
+ *
+ *          Fails if a card on the list is not found, a card not on it is,
+ *          or a damaged or erased image is taken for a list.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "reader/acl.h"
+
+#define RUNS                        10001
+
+/* BOARD_ACL_FLASH_SIZE of reader-revA. */
+#define REGION_SIZE                 (64 * 1024)
+
+/* What is left for the list of the 64 kB of an STM32F052. */
+#define SMALL_REGION_SIZE           (16 * 1024)
+
+static const size_t sizes[] = {1000, 10000, 50000};
+
+static uint32_t seed = 1;
+static uint32_t samples[RUNS];
+static bool failed;
+
+/* Xorshift, the low bytes of an LCG repeat too soon for 50000 UIDs. */
+static uint32_t next_random(void) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+/**
+ * @brief   A random card: 90% double, 8% single and 2% triple size UIDs.
+ */
+static void random_card(Iso14443aCard *card) {
+    uint32_t kind = next_random() % 100;
+    uint8_t i;
+
+    memset(card, 0, sizeof(*card));
+    card->uidlen = kind < 90 ? 7 : kind < 98 ? 4 : 10;
+    for (i = 0; i < card->uidlen; i++) {
+        card->uid[i] = (uint8_t)next_random();
+    }
+    if (card->uidlen != 4) {
+        card->uid[0] = 0x04;
+    }
+}
+
+static int compare_keys(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static int compare(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static uint32_t median(void) {
+    qsort(samples, RUNS, sizeof(samples[0]), compare);
+    return samples[RUNS / 2];
+}
+
+/**
+ * @brief   Median cycles of looking up @p cards.
+ */
+static uint32_t time_lookups(ReaderAcl *acl, const Iso14443aCard *cards,
+                             size_t n, bool expected) {
+    size_t i;
+
+    for (i = 0; i < RUNS; i++) {
+        const Iso14443aCard *card = &cards[next_random() % n];
+        uint32_t start = platformCycles();
+        bool found = readerAclLookup(acl, card);
+
+        samples[i] = platformElapsedCycles(start);
+        if (found != expected) {
+            failed = true;
+        }
+    }
+    return median();
+}
+
+static void check_damage(void *image, size_t len) {
+    uint8_t *bytes = image;
+    ReaderAcl acl;
+
+    bytes[len / 2] ^= 0x10;
+    if (readerAclInit(&acl, image, len)) {
+        fprintf(stderr, "acl-bench: damaged image accepted\n");
+        failed = true;
+    }
+    bytes[len / 2] ^= 0x10;
+    if (readerAclInit(&acl, image, len - 1)) {
+        fprintf(stderr, "acl-bench: truncated image accepted\n");
+        failed = true;
+    }
+    memset(image, 0xFF, len);
+    if (readerAclInit(&acl, image, len)) {
+        fprintf(stderr, "acl-bench: erased region accepted\n");
+        failed = true;
+    }
+}
+
+static void run(size_t n, const Iso14443aCard *members, const uint64_t *keys,
+                const Iso14443aCard *absent, unsigned bits,
+                unsigned blockSize) {
+    uint32_t words = readerAclBloomWords(n, bits);
+    size_t size = READER_ACL_IMAGE_SIZE(n, words);
+    void *image = malloc(size);
+    uint32_t hit, miss, searched;
+    ReaderAcl acl;
+    size_t len, i;
+    char format[16], filter[16];
+
+    len = readerAclBuild(image, size, keys, n, bits, blockSize, 1);
+    if (len == 0 || (blockSize == 0 && len != size) ||
+        !readerAclInit(&acl, image, len)) {
+        fprintf(stderr, "acl-bench: image of %zu cards not built\n", n);
+        failed = true;
+        free(image);
+        return;
+    }
+
+    for (i = 0; i < n; i++) {
+        if (!readerAclLookup(&acl, &members[i]) ||
+            readerAclLookup(&acl, &absent[i])) {
+            failed = true;
+        }
+    }
+    memset(&acl.stats, 0, sizeof(acl.stats));
+    hit = time_lookups(&acl, members, n, true);
+    memset(&acl.stats, 0, sizeof(acl.stats));
+    miss = time_lookups(&acl, absent, n, false);
+
+    if (blockSize == 0) {
+        snprintf(format, sizeof(format), "plain");
+    } else {
+        snprintf(format, sizeof(format), "%u B", blockSize);
+    }
+    if (bits == 0) {
+        snprintf(filter, sizeof(filter), "none");
+    } else {
+        snprintf(filter, sizeof(filter), "%u bits", bits);
+    }
+    searched = acl.stats.lookups - acl.stats.filtered;
+    printf("  %6zu %6s %8s %8zu %6.2f %7.0f %6s %6s %7u %7u %6.1f %7.1f "
+           "%6.2f%%\n", n, format, filter, len, (double)len / n,
+           1024.0 * n / len, len <= REGION_SIZE ? "fits" : "over",
+           len <= SMALL_REGION_SIZE ? "fits" : "over",
+           (unsigned)hit, (unsigned)miss,
+           searched != 0 ? (double)acl.stats.probes / searched : 0.0,
+           searched != 0 ? (double)acl.stats.decoded / searched : 0.0,
+           100.0 * searched / acl.stats.lookups);
+    check_damage(image, len);
+    free(image);
+}
+
+int main(void) {
+    size_t s;
+
+    printf("acl-bench (region %u kB, cycles of the build machine, median of "
+           "%u lookups)\n", REGION_SIZE / 1024, RUNS);
+    printf("  %6s %6s %8s %8s %6s %7s %6s %6s %7s %7s %6s %7s %7s\n",
+           "cards", "keys", "filter", "bytes", "B/card", "card/kB", "region",
+           "16 kB", "on", "absent", "probes", "decoded", "passed");
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t n = sizes[s];
+        Iso14443aCard *members = malloc(n * sizeof(*members));
+        Iso14443aCard *absent = malloc(n * sizeof(*absent));
+        uint64_t *keys = malloc(n * sizeof(*keys));
+        size_t i;
+
+        for (i = 0; i < n; i++) {
+            random_card(&members[i]);
+            keys[i] = readerAclKey(&members[i]);
+        }
+        qsort(keys, n, sizeof(keys[0]), compare_keys);
+        for (i = 1; i < n; i++) {
+            if (keys[i] == keys[i - 1]) {
+                fprintf(stderr, "acl-bench: duplicate card drawn\n");
+                return EXIT_FAILURE;
+            }
+        }
+        for (i = 0; i < n; i++) {
+            uint64_t key;
+
+            do {
+                random_card(&absent[i]);
+                key = readerAclKey(&absent[i]);
+            } while (bsearch(&key, keys, n, sizeof(keys[0]),
+                             compare_keys) != NULL);
+        }
+
+        run(n, members, keys, absent, 0, 0);
+        run(n, members, keys, absent, READER_ACL_BLOOM_BITS, 0);
+        run(n, members, keys, absent, 0, READER_ACL_BLOCK_SIZE);
+        run(n, members, keys, absent, READER_ACL_BLOOM_BITS, 64);
+        run(n, members, keys, absent, READER_ACL_BLOOM_BITS, 128);
+        run(n, members, keys, absent, READER_ACL_BLOOM_BITS, 256);
+        free(members);
+        free(absent);
+        free(keys);
+    }
+    if (failed) {
+        fprintf(stderr, "acl-bench: wrong lookup\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,152 @@
+/**
+ * @file    acl_image.c
+ * @brief   Builds the flash image of an access list.
+ * @details <tt>acl-image [-b bits] [-s blocksize] [-g generation] uids.txt
+ *          acl.bin</tt>
+ *
+ *          Reads one UID in hex per line (4, 7 or 10 bytes, @p # starts a
+ *          comment) and writes the image of @p reader/acl.h with a Bloom
+ *          filter of @p bits per card, @p READER_ACL_BLOOM_BITS by default,
+ *          and the keys in Rice coded blocks of @p blocksize bytes,
+ *          @p READER_ACL_BLOCK_SIZE by default, 0 for plain keys. Cards
+ *          listed twice are kept once. The image goes to the flash
+ *          region with <tt>make flash-acl</tt>, or to the simulator with
+ *          @p SIM_ACL.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "reader/acl.h"
+
+static int compare(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static int parse_uid(const char *line, Iso14443aCard *card) {
+    size_t n = strspn(line, "0123456789abcdefABCDEF");
+    size_t i;
+
+    if (line[n] != '\0' && strchr(" \t\r\n#", line[n]) == NULL) {
+        return -1;
+    }
+    if (n != 8 && n != 14 && n != 20) {
+        return -1;
+    }
+    memset(card, 0, sizeof(*card));
+    card->uidlen = (uint8_t)(n / 2);
+    for (i = 0; i < card->uidlen; i++) {
+        unsigned byte;
+
+        if (sscanf(&line[2 * i], "%2x", &byte) != 1) {
+            return -1;
+        }
+        card->uid[i] = (uint8_t)byte;
+    }
+    return 0;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: acl-image [-b bits] [-s blocksize] [-g generation] "
+            "uids.txt acl.bin\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv) {
+    unsigned bits = READER_ACL_BLOOM_BITS;
+    unsigned blockSize = READER_ACL_BLOCK_SIZE;
+    uint32_t generation = 0;
+    uint64_t *keys = NULL;
+    size_t count = 0, capacity = 0, unique, size, len, i;
+    unsigned lineno = 0;
+    char line[128];
+    void *image;
+    FILE *f;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:s:g:")) != -1) {
+        switch (opt) {
+        case 'b':
+            bits = (unsigned)strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            blockSize = (unsigned)strtoul(optarg, NULL, 0);
+            break;
+        case 'g':
+            generation = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        default:
+            usage();
+        }
+    }
+    if (argc - optind != 2) {
+        usage();
+    }
+
+    f = fopen(argv[optind], "r");
+    if (f == NULL) {
+        perror(argv[optind]);
+        return EXIT_FAILURE;
+    }
+    while (fgets(line, sizeof(line), f) != NULL) {
+        const char *p = line + strspn(line, " \t");
+        Iso14443aCard card;
+
+        lineno++;
+        if (*p == '#' || strspn(p, "\r\n") == strlen(p)) {
+            continue;
+        }
+        if (parse_uid(p, &card) != 0) {
+            fprintf(stderr, "%s:%u: bad UID\n", argv[optind], lineno);
+            return EXIT_FAILURE;
+        }
+        if (count == capacity) {
+            capacity = capacity != 0 ? 2 * capacity : 1024;
+            keys = realloc(keys, capacity * sizeof(keys[0]));
+            if (keys == NULL) {
+                perror("acl-image");
+                return EXIT_FAILURE;
+            }
+        }
+        keys[count++] = readerAclKey(&card);
+    }
+    fclose(f);
+
+    qsort(keys, count, sizeof(keys[0]), compare);
+    for (unique = 0, i = 0; i < count; i++) {
+        if (unique == 0 || keys[i] != keys[unique - 1]) {
+            keys[unique++] = keys[i];
+        }
+    }
+    /* Blocks of a few keys spread far apart may take more than plain keys. */
+    size = READER_ACL_IMAGE_SIZE(unique, readerAclBloomWords(unique, bits)) +
+           READER_ACL_IMAGE_SIZE(unique, 0) + blockSize;
+    image = malloc(size);
+    if (image == NULL) {
+        perror("acl-image");
+        return EXIT_FAILURE;
+    }
+    len = readerAclBuild(image, size, keys, unique, bits, blockSize,
+                         generation);
+    if (len == 0) {
+        fprintf(stderr, "acl-image: bad block size %u\n", blockSize);
+        return EXIT_FAILURE;
+    }
+
+    f = fopen(argv[optind + 1], "wb");
+    if (f == NULL || fwrite(image, 1, len, f) != len || fclose(f) != 0) {
+        perror(argv[optind + 1]);
+        return EXIT_FAILURE;
+    }
+    printf("%zu cards, %zu bytes, generation %u\n", unique, len,
+           (unsigned)generation);
+    free(image);
+    free(keys);
+    return EXIT_SUCCESS;
+}
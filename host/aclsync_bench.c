@@ -0,0 +1,603 @@
+/**
+ * @file    aclsync_bench.c
+ * @brief   Keeping the access list in step with the controller by deltas.
+ * @details The controller stand-in is a set of cards. It sends its changes
+ *          to the store as deltas of one message each, and the bench counts
+ *          the frames it takes: a full load of @p sizes cards against a
+ *          month of daily churn of 1% of them, in link bytes and seconds at
+ *          38400 and 115200 bit/s on a sealed session. A refused delta is
+ *          sent again once the compaction under way is over. The store is
+ *          compared with the set after each day: every card, the count and
+ *          the chunk checksums.
+ *
+ *          Also reports the compactions and flash erases, the longest
+ *          compaction step in cycles of the build machine and in flash time
+ *          by the F072 datasheet maximums, and the median lookup time
+ *          against the records in the log.
+ *
+ *          Then cuts the power at random points of deltas and compactions:
+ *          mounted again, the store must hold the list of the generation
+ *          before or the one after, nothing in between. Last, the checksums
+ *          must point at the one chunk of a card missing on the reader.
+ *
+ *          Fails on any difference.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "link/proto.h"
+#include "reader/aclstore.h"
+#include "flash_sim.h"
+
+#define RUNS                        10001
+#define DAYS                        30
+#define CUTS                        3000
+
+/* Flash of the region of reader-revA. */
+#define REGION_SIZE                 (64 * 1024)
+#define PAGE_SIZE                   2048
+
+/* STM32F072 datasheet maximums. */
+#define ERASE_US                    40000
+#define PROGRAM_US                  70
+
+/* Cards at each end of the fuzzed list. */
+#define CUT_CARDS                   300
+
+/* Frame bytes around a payload: header, tag, COBS code and delimiter. */
+#define FRAME_BYTES(payload)        (PROTO_OVERHEAD + PROTO_TAG_SIZE +      \
+                                     (payload) + 2)
+
+static const size_t sizes[] = {1000, 2500};
+static const uint32_t bitrates[] = {38400, 115200};
+
+typedef struct {
+    uint8_t op;
+    Iso14443aCard card;
+} Op;
+
+typedef struct {
+    uint64_t *keys;
+    size_t count;
+    size_t capacity;
+} CardSet;
+
+typedef struct {
+    uint32_t messages;
+    uint32_t bytes;
+    uint32_t retries;
+} Traffic;
+
+static uint32_t region[REGION_SIZE / 4];
+static FlashSim flash;
+static ReaderAclFlash config;
+static ReaderAclStore store;
+static CardSet controller;
+static uint32_t generation;
+static uint32_t samples[RUNS];
+static uint32_t maxStepCycles;
+static uint32_t maxStepUs;
+static uint32_t seed = 1;
+static bool failed;
+
+static uint32_t next_random(void) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+static void random_card(Iso14443aCard *card) {
+    uint8_t i;
+
+    memset(card, 0, sizeof(*card));
+    card->uidlen = 7;
+    card->uid[0] = 0x04;
+    for (i = 1; i < card->uidlen; i++) {
+        card->uid[i] = (uint8_t)next_random();
+    }
+}
+
+static int compare_keys(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static int compare(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/*===========================================================================*/
+/* Controller stand-in.                                                      */
+/*===========================================================================*/
+
+static size_t set_index(const CardSet *set, uint64_t key) {
+    size_t i;
+
+    for (i = 0; i < set->count && set->keys[i] != key; i++) {
+    }
+    return i;
+}
+
+static void set_apply(CardSet *set, const Op *op) {
+    uint64_t key = readerAclKey(&op->card);
+    size_t i;
+
+    if (op->op == READER_ACL_OP_CLEAR) {
+        set->count = 0;
+        return;
+    }
+    i = set_index(set, key);
+    if (op->op == READER_ACL_OP_ADD && i == set->count) {
+        if (set->count == set->capacity) {
+            set->capacity = set->capacity != 0 ? 2 * set->capacity : 1024;
+            set->keys = realloc(set->keys, set->capacity * sizeof(uint64_t));
+        }
+        set->keys[set->count++] = key;
+    } else if (op->op == READER_ACL_OP_REMOVE && i < set->count) {
+        set->keys[i] = set->keys[--set->count];
+    }
+}
+
+static void set_sums(const CardSet *set, uint32_t *sums) {
+    size_t i;
+
+    memset(sums, 0, READER_ACL_CHUNKS * sizeof(uint32_t));
+    for (i = 0; i < set->count; i++) {
+        unsigned chunk;
+        uint32_t sum = readerAclChecksum(set->keys[i], &chunk);
+
+        sums[chunk] += sum;
+    }
+}
+
+/**
+ * @brief   Runs the compaction under way to its end, timing the steps.
+ */
+static void service(void) {
+    bool more = true;
+
+    while (more) {
+        uint32_t erases = flash.erases, programs = flash.programs;
+        uint32_t start = platformCycles();
+        uint32_t cycles, us;
+
+        more = readerAclStoreService(&store);
+        cycles = platformElapsedCycles(start);
+        us = (flash.erases - erases) * ERASE_US +
+             (flash.programs - programs) * PROGRAM_US;
+        if (cycles > maxStepCycles) {
+            maxStepCycles = cycles;
+        }
+        if (us > maxStepUs) {
+            maxStepUs = us;
+        }
+    }
+}
+
+/**
+ * @brief   Encodes the delta of @p n operations to the next generation.
+ */
+static size_t encode(uint8_t *buf, const Op *ops, size_t n) {
+    size_t len = 8, i;
+
+    buf[0] = (uint8_t)(generation >> 24);
+    buf[1] = (uint8_t)(generation >> 16);
+    buf[2] = (uint8_t)(generation >> 8);
+    buf[3] = (uint8_t)generation;
+    buf[4] = (uint8_t)((generation + 1) >> 24);
+    buf[5] = (uint8_t)((generation + 1) >> 16);
+    buf[6] = (uint8_t)((generation + 1) >> 8);
+    buf[7] = (uint8_t)(generation + 1);
+    for (i = 0; i < n; i++) {
+        buf[len++] = ops[i].op;
+        if (ops[i].op != READER_ACL_OP_CLEAR) {
+            buf[len++] = ops[i].card.uidlen;
+            memcpy(&buf[len], ops[i].card.uid, ops[i].card.uidlen);
+            len += ops[i].card.uidlen;
+        }
+    }
+    return len;
+}
+
+static size_t op_size(const Op *op) {
+    return op->op == READER_ACL_OP_CLEAR ? 1 : 2 + op->card.uidlen;
+}
+
+/**
+ * @brief   Sends @p n operations in as few deltas as fit the payload.
+ */
+static void send_ops(const Op *ops, size_t n, Traffic *traffic) {
+    uint8_t buf[PROTO_PAYLOAD_MAX];
+    size_t first = 0;
+
+    while (first < n) {
+        size_t last = first, size = 8, len, i;
+        readeraclresult_t result;
+
+        while (last < n && size + op_size(&ops[last]) <= sizeof(buf)) {
+            size += op_size(&ops[last++]);
+        }
+        len = encode(buf, &ops[first], last - first);
+        traffic->messages++;
+        traffic->bytes += FRAME_BYTES(len);
+        result = readerAclStoreApply(&store, buf, len);
+        if (result == READER_ACL_BUSY) {
+            traffic->retries++;
+            service();
+            continue;
+        }
+        if (result != READER_ACL_OK) {
+            fprintf(stderr, "aclsync-bench: delta refused, %d\n", result);
+            failed = true;
+            return;
+        }
+        generation++;
+        for (i = first; i < last; i++) {
+            set_apply(&controller, &ops[i]);
+        }
+        first = last;
+
+        /* The reader services the store between the messages. */
+        (void)readerAclStoreService(&store);
+    }
+
+    /* The query and the status closing the sync. */
+    traffic->messages += 2;
+    traffic->bytes += FRAME_BYTES(0) + FRAME_BYTES(READER_ACL_STATUS_SIZE);
+}
+
+/**
+ * @brief   Whether the store holds the list of @p set at @p gen.
+ */
+static bool same(const CardSet *set, uint32_t gen) {
+    uint32_t sums[READER_ACL_CHUNKS];
+    size_t i;
+
+    set_sums(set, sums);
+    if (store.generation != gen || store.count != set->count ||
+        memcmp(store.sums, sums, sizeof(sums)) != 0) {
+        return false;
+    }
+    for (i = 0; i < set->count; i++) {
+        if (!readerAclStoreFind(&store, set->keys[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void mount(void) {
+    flashSimConfig(&flash, &config);
+    if (!readerAclStoreInit(&store, &config)) {
+        fprintf(stderr, "aclsync-bench: store not mounted\n");
+        failed = true;
+    }
+}
+
+static void reset(void) {
+    flashSimInit(&flash, (uint8_t *)region, sizeof(region), PAGE_SIZE);
+    mount();
+    controller.count = 0;
+    generation = 0;
+}
+
+static void print_traffic(const char *what, const Traffic *t, unsigned days) {
+    size_t i;
+
+    printf("  %-22s %8.1f %9.0f %6u", what, (double)t->messages / days,
+           (double)t->bytes / days, (unsigned)t->retries);
+    for (i = 0; i < sizeof(bitrates) / sizeof(bitrates[0]); i++) {
+        printf(" %9.2f", 10.0 * t->bytes / bitrates[i] / days);
+    }
+    printf("\n");
+}
+
+/*===========================================================================*/
+/* Runs.                                                                     */
+/*===========================================================================*/
+
+static void run_sync(size_t n) {
+    Op *ops = malloc(2 * n * sizeof(*ops));
+    Traffic load = {0, 0, 0}, churn = {0, 0, 0};
+    uint32_t erases, compactions;
+    unsigned day;
+    size_t i;
+
+    reset();
+    ops[0].op = READER_ACL_OP_CLEAR;
+    for (i = 1; i <= n; i++) {
+        ops[i].op = READER_ACL_OP_ADD;
+        random_card(&ops[i].card);
+    }
+    maxStepCycles = maxStepUs = 0;
+    send_ops(ops, n + 1, &load);
+    service();
+    if (!same(&controller, generation)) {
+        fprintf(stderr, "aclsync-bench: full load of %zu differs\n", n);
+        failed = true;
+    }
+
+    erases = store.stats.erases;
+    compactions = store.stats.compactions;
+    for (day = 0; day < DAYS; day++) {
+        size_t changes = n / 100;
+
+        /* Leavers first, then newcomers. */
+        for (i = 0; i < changes; i++) {
+            ops[i].op = READER_ACL_OP_REMOVE;
+            memset(&ops[i].card, 0, sizeof(ops[i].card));
+            ops[i].card.uidlen = 7;
+        }
+        for (i = 0; i < changes; i++) {
+            uint64_t key = controller.keys[next_random() % controller.count];
+            uint8_t b;
+
+            for (b = 0; b < 7; b++) {
+                ops[i].card.uid[b] = (uint8_t)(key >> (8 * (6 - b)));
+            }
+        }
+        for (i = changes; i < 2 * changes; i++) {
+            ops[i].op = READER_ACL_OP_ADD;
+            random_card(&ops[i].card);
+        }
+        send_ops(ops, 2 * changes, &churn);
+        if (!same(&controller, generation)) {
+            fprintf(stderr, "aclsync-bench: day %u of %zu differs\n", day, n);
+            failed = true;
+        }
+    }
+
+    printf("%zu cards, %u cards/day churn, bank of %zu bytes", n,
+           (unsigned)(n / 100), store.bankSize);
+    if (store.image.header != NULL) {
+        const ReaderAclHeader *header = store.image.header;
+        size_t len = header->blockSize == 0
+                         ? READER_ACL_IMAGE_SIZE(header->count,
+                                                 header->bloomWords)
+                         : READER_ACL_BLOCK_IMAGE_SIZE(header->blocks,
+                                                       header->blockSize,
+                                                       header->bloomWords);
+
+        printf(", image of %.2f B/card", (double)len / header->count);
+    }
+    printf("\n");
+    printf("  %-22s %8s %9s %6s %9s %9s\n", "", "messages", "bytes", "busy",
+           "s@38400", "s@115200");
+    print_traffic("full load", &load, 1);
+    print_traffic("churn, a day", &churn, DAYS);
+    printf("  month of churn: %u compactions, %u erases, %u records, "
+           "%u unchanged\n", (unsigned)(store.stats.compactions - compactions),
+           (unsigned)(store.stats.erases - erases),
+           (unsigned)store.stats.records, (unsigned)store.stats.unchanged);
+    printf("  longest compaction step: %u cycles, %u us of flash\n",
+           (unsigned)maxStepCycles, (unsigned)maxStepUs);
+    free(ops);
+}
+
+/**
+ * @brief   Median lookup cycles with @p records in the log.
+ */
+static void run_lookups(void) {
+    static const unsigned steps[] = {0, 100, 250, 500};
+    size_t n = 1000, members = 0, i, s;
+    uint64_t *keys = malloc(n * sizeof(*keys));
+    Iso14443aCard *cards = malloc((n + 600) * sizeof(*cards));
+    Traffic traffic = {0, 0, 0};
+
+    /* An image flashed in bank 0, as by make flash-acl. */
+    flashSimInit(&flash, (uint8_t *)region, sizeof(region), PAGE_SIZE);
+    for (i = 0; i < n; i++) {
+        random_card(&cards[i]);
+        keys[i] = readerAclKey(&cards[i]);
+    }
+    qsort(keys, n, sizeof(keys[0]), compare_keys);
+    (void)readerAclBuild(region, sizeof(region) / 2, keys, n,
+                         READER_ACL_BLOOM_BITS, READER_ACL_BLOCK_SIZE, 1);
+    mount();
+    generation = 1;
+    members = n;
+
+    printf("lookups of 1000 cards against the log (median cycles)\n");
+    printf("  %8s %8s %8s %8s\n", "records", "on", "absent", "scanned");
+    for (s = 0; s < sizeof(steps) / sizeof(steps[0]); s++) {
+        uint32_t on, absent, scanned;
+        Iso14443aCard other;
+        Op ops[6];
+
+        /* Adds of six cards a delta, no compaction steps. */
+        while (store.live < steps[s]) {
+            for (i = 0; i < 6; i++) {
+                ops[i].op = READER_ACL_OP_ADD;
+                random_card(&ops[i].card);
+                cards[members++] = ops[i].card;
+            }
+            send_ops(ops, 6, &traffic);
+        }
+        for (i = 0; i < RUNS; i++) {
+            const Iso14443aCard *card = &cards[next_random() % members];
+            uint32_t start = platformCycles();
+            bool found = readerAclStoreLookup(&store, card);
+
+            samples[i] = platformElapsedCycles(start);
+            failed |= !found;
+        }
+        qsort(samples, RUNS, sizeof(samples[0]), compare);
+        on = samples[RUNS / 2];
+        scanned = store.stats.scanned;
+        for (i = 0; i < RUNS; i++) {
+            uint32_t start = platformCycles();
+            bool found;
+
+            random_card(&other);
+            found = readerAclStoreLookup(&store, &other);
+            samples[i] = platformElapsedCycles(start);
+            failed |= found;
+        }
+        qsort(samples, RUNS, sizeof(samples[0]), compare);
+        absent = samples[RUNS / 2];
+        scanned = store.stats.scanned - scanned;
+        printf("  %8u %8u %8u %8.1f\n", (unsigned)store.live, (unsigned)on,
+               (unsigned)absent, (double)scanned / RUNS);
+    }
+    free(cards);
+    free(keys);
+}
+
+/**
+ * @brief   Power cuts at random points of deltas and compactions.
+ */
+static void run_cuts(void) {
+    Traffic traffic = {0, 0, 0};
+    unsigned cut, torn = 0, kept = 0, rolled = 0, compactions = 0, voided = 0;
+    Op ops[6];
+    size_t i;
+
+    reset();
+    ops[0].op = READER_ACL_OP_CLEAR;
+    send_ops(ops, 1, &traffic);
+    for (cut = 0; cut < CUTS && !failed; cut++) {
+        uint8_t buf[PROTO_PAYLOAD_MAX];
+        size_t n = 1 + next_random() % 6, len;
+        readeraclresult_t result;
+        bool cutShort;
+
+        for (i = 0; i < n; i++) {
+            if (controller.count > CUT_CARDS ||
+                (controller.count > 0 && next_random() % 2 == 0)) {
+                uint64_t key = controller.keys[next_random() %
+                                               controller.count];
+                uint8_t b;
+
+                ops[i].op = READER_ACL_OP_REMOVE;
+                memset(&ops[i].card, 0, sizeof(ops[i].card));
+                ops[i].card.uidlen = 7;
+                for (b = 0; b < 7; b++) {
+                    ops[i].card.uid[b] = (uint8_t)(key >> (8 * (6 - b)));
+                }
+            } else {
+                ops[i].op = READER_ACL_OP_ADD;
+                random_card(&ops[i].card);
+            }
+        }
+        len = encode(buf, ops, n);
+
+        /* Within the delta or within the compaction steps after it. */
+        flashSimCutAfter(&flash, (long)(next_random() %
+                                        (next_random() % 2 == 0 ? 80 : 6000)));
+        result = readerAclStoreApply(&store, buf, len);
+        for (i = next_random() % 60; i > 0; i--) {
+            (void)readerAclStoreService(&store);
+        }
+        cutShort = flash.cut;
+        flashSimCutAfter(&flash, -1);
+        if (cutShort) {
+            torn++;
+            compactions += store.stats.compactions;
+            mount();
+            voided += store.stats.voided;
+        }
+
+        if (store.generation == generation + 1) {
+            for (i = 0; i < n; i++) {
+                set_apply(&controller, &ops[i]);
+            }
+            generation++;
+            kept++;
+        } else if (result == READER_ACL_OK) {
+            fprintf(stderr, "aclsync-bench: applied delta lost\n");
+            failed = true;
+        } else {
+            rolled++;
+        }
+        if (!same(&controller, generation)) {
+            fprintf(stderr, "aclsync-bench: torn state after cut %u\n", cut);
+            failed = true;
+        }
+        if (flash.violations != 0) {
+            fprintf(stderr, "aclsync-bench: programmed unerased flash\n");
+            failed = true;
+        }
+    }
+    printf("power cuts: %u deltas, %u cut short, %u applied, %u rolled back, "
+           "%u compactions, %u records voided\n", cut, torn, kept, rolled,
+           compactions + (unsigned)store.stats.compactions, voided);
+}
+
+/**
+ * @brief   A card lost on the reader shows in one chunk only.
+ */
+static void run_divergence(void) {
+    uint32_t sums[READER_ACL_CHUNKS];
+    Traffic traffic = {0, 0, 0};
+    unsigned chunk, differ = 0, i;
+    Op ops[1];
+    uint32_t sum;
+
+    reset();
+    for (i = 0; i < 200; i++) {
+        ops[0].op = READER_ACL_OP_ADD;
+        random_card(&ops[0].card);
+        send_ops(ops, 1, &traffic);
+    }
+
+    /* The controller adds a card the reader never gets. */
+    random_card(&ops[0].card);
+    set_apply(&controller, &ops[0]);
+    set_sums(&controller, sums);
+    sum = readerAclChecksum(readerAclKey(&ops[0].card), &chunk);
+    for (i = 0; i < READER_ACL_CHUNKS; i++) {
+        if (store.sums[i] != sums[i]) {
+            differ++;
+        }
+    }
+    if (differ != 1 || sums[chunk] - store.sums[chunk] != sum ||
+        store.count + 1 != controller.count) {
+        fprintf(stderr, "aclsync-bench: divergence not located\n");
+        failed = true;
+    }
+
+    /* And a delta not following the reader's generation is refused. */
+    {
+        uint8_t buf[PROTO_PAYLOAD_MAX];
+        size_t len;
+
+        generation++;
+        len = encode(buf, ops, 1);
+        generation--;
+        if (readerAclStoreApply(&store, buf, len) != READER_ACL_OUT_OF_STEP ||
+            readerAclStoreFind(&store, readerAclKey(&ops[0].card))) {
+            fprintf(stderr, "aclsync-bench: delta out of step applied\n");
+            failed = true;
+        }
+    }
+    printf("divergence: %u of %u chunks differ with one card missing\n",
+           differ, READER_ACL_CHUNKS);
+}
+
+int main(void) {
+    size_t s;
+
+    printf("aclsync-bench (region %u kB, %u log pages, deltas of one "
+           "message, sealed frames)\n", REGION_SIZE / 1024,
+           READER_ACL_LOG_PAGES);
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        run_sync(sizes[s]);
+    }
+    run_lookups();
+    run_cuts();
+    run_divergence();
+    free(controller.keys);
+    if (failed) {
+        fprintf(stderr, "aclsync-bench: store out of step\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,309 @@
+/**
+ * @file    adpcm_bench.c
+ * @brief   IMA ADPCM sounds: size, quality and decoding cycles.
+ * @details Encodes a decision beep, a sweep, a fading chord and noise of a
+ *          second each in blocks of 64, 256 and 1024 bytes, and decodes
+ *          them with @p adpcmSource() in chunks of every length up to a
+ *          block of the sound output, and through the engine as it plays
+ *          them. Both must give, sample for sample, what a plain decoder
+ *          written after the IMA reference gives, also on damaged sounds.
+ *
+ *          Each sound reports its bytes, the ratio against 16 bit PCM, the
+ *          signal to noise ratio of the decoding against the original and
+ *          the decoding cycles per sample, median of @p RUNS runs in
+ *          cycles of the build machine, against the @p CPU_HZ budget of a
+ *          sample at @p AUDIO_RATE.
+ *
+ *          Fails if a decoding differs from the reference, a sound takes
+ *          other than @p adpcmSize() bytes, or comes out noisier than IMA
+ *          ADPCM does.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio/adpcm.h"
+
+#define SAMPLES                     AUDIO_RATE
+#define RUNS                        51
+#define CPU_HZ                      48000000U
+#define DAMAGED                     200
+
+#define PI                          3.14159265358979323846
+
+static const size_t blockSizes[] = {64, 256, 1024};
+
+/* The least signal to noise ratio of IMA ADPCM on each, hard edges and
+   noise do worst. */
+static const struct {
+    const char *name;
+    double minSnr;
+} sounds[] = {
+    {"beep", 15.0},
+    {"sweep", 18.0},
+    {"chord", 18.0},
+    {"noise", 12.0},
+};
+
+static int16_t pcm[SAMPLES];
+static int16_t reference[SAMPLES];
+static int16_t decoded[SAMPLES];
+static uint8_t data[2 * SAMPLES];
+static uint32_t cycles[RUNS];
+static uint32_t seed = 1;
+static bool failed;
+
+static uint32_t random_below(uint32_t n) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % n;
+}
+
+/*===========================================================================*/
+/* Reference.                                                                */
+/*===========================================================================*/
+
+/*
+ * Decodes as the IMA ADPCM reference does, one nibble at a time.
+ */
+static void reference_decode(const uint8_t *in, size_t samples,
+                             size_t blockSize, int16_t *out) {
+    static const int indexTable[16] = {
+        -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8
+    };
+    static const int stepTable[89] = {
+        7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34,
+        37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157,
+        173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544,
+        598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707,
+        1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871,
+        5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635,
+        13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+        32767
+    };
+    size_t perBlock = ADPCM_BLOCK_SAMPLES(blockSize);
+    size_t i;
+
+    for (i = 0; i < samples; i++) {
+        const uint8_t *block = &in[i / perBlock * blockSize];
+        size_t k = i % perBlock, j;
+        int valpred, index;
+
+        if (k != 0) {
+            continue;
+        }
+        valpred = (int16_t)(block[0] | block[1] << 8);
+        index = block[2] > 88 ? 88 : block[2];
+        out[i] = (int16_t)valpred;
+        for (j = 1; j < perBlock && i + j < samples; j++) {
+            uint8_t byte = block[ADPCM_HEADER_SIZE + (j - 1) / 2];
+            int delta = (j - 1) % 2 == 0 ? byte & 0x0F : byte >> 4;
+            int step = stepTable[index];
+            int vpdiff = step >> 3;
+
+            if (delta & 4) {
+                vpdiff += step;
+            }
+            if (delta & 2) {
+                vpdiff += step >> 1;
+            }
+            if (delta & 1) {
+                vpdiff += step >> 2;
+            }
+            valpred += delta & 8 ? -vpdiff : vpdiff;
+            if (valpred > 32767) {
+                valpred = 32767;
+            } else if (valpred < -32768) {
+                valpred = -32768;
+            }
+            index += indexTable[delta];
+            if (index < 0) {
+                index = 0;
+            } else if (index > 88) {
+                index = 88;
+            }
+            out[i + j] = (int16_t)valpred;
+        }
+    }
+}
+
+/*===========================================================================*/
+/* Sounds.                                                                   */
+/*===========================================================================*/
+
+static void make(size_t s) {
+    AudioBeep beep;
+    size_t i;
+
+    switch (s) {
+    case 0:
+        audioBeepInit(&beep, 2000, SAMPLES * 1000U / AUDIO_RATE, 16000);
+        (void)audioBeepSource(&beep, pcm, SAMPLES);
+        break;
+    case 1:
+        for (i = 0; i < SAMPLES; i++) {
+            double t = (double)i / AUDIO_RATE;
+
+            /* 300 Hz to 4 kHz over the second. */
+            pcm[i] = (int16_t)(20000.0 *
+                               sin(2 * PI * (300.0 * t + 1850.0 * t * t)));
+        }
+        break;
+    case 2:
+        for (i = 0; i < SAMPLES; i++) {
+            double t = (double)i / AUDIO_RATE;
+
+            pcm[i] = (int16_t)(9000.0 * exp(-3.0 * t) *
+                               (sin(2 * PI * 523.25 * t) +
+                                sin(2 * PI * 659.25 * t) +
+                                sin(2 * PI * 783.99 * t)));
+        }
+        break;
+    default:
+        for (i = 0; i < SAMPLES; i++) {
+            pcm[i] = (int16_t)((int32_t)random_below(16384) - 8192);
+        }
+        break;
+    }
+}
+
+static double snr(void) {
+    double signal = 0, noise = 0;
+    size_t i;
+
+    for (i = 0; i < SAMPLES; i++) {
+        double d = (double)pcm[i] - reference[i];
+
+        signal += (double)pcm[i] * pcm[i];
+        noise += d * d;
+    }
+    return noise != 0 ? 10.0 * log10(signal / noise) : 99.0;
+}
+
+/*===========================================================================*/
+/* Decoding.                                                                 */
+/*===========================================================================*/
+
+/*
+ * Decodes in chunks of 1 to AUDIO_BLOCK samples, every length in turn.
+ */
+static bool decode_chunks(const AdpcmSound *sound) {
+    AdpcmDecoder decoder;
+    size_t at = 0, chunk = 1, n;
+
+    adpcmDecoderInit(&decoder, sound);
+    while ((n = adpcmSource(&decoder, &decoded[at], chunk)) != 0) {
+        at += n;
+        chunk = chunk % AUDIO_BLOCK + 1;
+    }
+    return at == sound->samples &&
+           memcmp(decoded, reference, at * sizeof(decoded[0])) == 0;
+}
+
+/*
+ * Plays the sound through the engine, block by block as the DMA would
+ * have it.
+ */
+static bool decode_engine(const AdpcmSound *sound) {
+    AudioEngine engine;
+    AdpcmDecoder decoder;
+    uint16_t block[AUDIO_BLOCK];
+    size_t at = 0, i;
+    bool ok = true;
+
+    audioInit(&engine);
+    adpcmDecoderInit(&decoder, sound);
+    audioPlay(&engine, adpcmSource, &decoder);
+    while (audioRefill(&engine, block)) {
+        for (i = 0; i < AUDIO_BLOCK; i++, at++) {
+            uint16_t code = at < sound->samples
+                                ? (uint16_t)((uint16_t)(reference[at] + 32768)
+                                             >> 4)
+                                : AUDIO_DAC_ZERO;
+
+            if (block[i] != code) {
+                ok = false;
+            }
+        }
+    }
+    return ok && at >= sound->samples;
+}
+
+static int compare(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static uint32_t decode_cycles(const AdpcmSound *sound) {
+    AdpcmDecoder decoder;
+    size_t r, at;
+
+    for (r = 0; r < RUNS; r++) {
+        uint32_t start = platformCycles();
+
+        adpcmDecoderInit(&decoder, sound);
+        for (at = 0; at < sound->samples; at += AUDIO_BLOCK) {
+            (void)adpcmSource(&decoder, &decoded[at], AUDIO_BLOCK);
+        }
+        cycles[r] = platformElapsedCycles(start);
+    }
+    qsort(cycles, RUNS, sizeof(cycles[0]), compare);
+    return cycles[RUNS / 2];
+}
+
+static void run(size_t s, size_t blockSize) {
+    AdpcmSound sound = {data, SAMPLES, (uint16_t)blockSize};
+    size_t len, i;
+    double perSample;
+    bool ok;
+
+    make(s);
+    len = adpcmEncode(pcm, SAMPLES, blockSize, data);
+    reference_decode(data, SAMPLES, blockSize, reference);
+    ok = len == adpcmSize(SAMPLES, blockSize) && decode_chunks(&sound) &&
+         decode_engine(&sound);
+    perSample = (double)decode_cycles(&sound) / SAMPLES;
+    if (!ok || snr() < sounds[s].minSnr) {
+        failed = true;
+    }
+    printf("  %-6s %5u %6u %6.2f:1 %7.1f %9.1f %7.2f%% %s\n", sounds[s].name,
+           (unsigned)blockSize, (unsigned)len, 2.0 * SAMPLES / len, snr(),
+           perSample, 100.0 * perSample * AUDIO_RATE / CPU_HZ,
+           ok ? "ok" : "FAILED");
+
+    /* Damaged bytes, headers included, decode as the reference does. */
+    for (i = 0; i < DAMAGED; i++) {
+        data[random_below((uint32_t)len)] = (uint8_t)random_below(256);
+    }
+    reference_decode(data, SAMPLES, blockSize, reference);
+    if (!decode_chunks(&sound) || !decode_engine(&sound)) {
+        fprintf(stderr, "adpcm-bench: %s damaged, decoding differs\n",
+                sounds[s].name);
+        failed = true;
+    }
+}
+
+int main(void) {
+    size_t s, b;
+
+    printf("adpcm-bench (%u samples at %u samples/s, cycles of the build "
+           "machine, median of %u runs)\n", SAMPLES, AUDIO_RATE, RUNS);
+    printf("  %-6s %5s %6s %8s %7s %9s %8s\n", "sound", "block", "bytes",
+           "ratio", "snr dB", "cyc/smp", "budget");
+    for (s = 0; s < sizeof(sounds) / sizeof(sounds[0]); s++) {
+        for (b = 0; b < sizeof(blockSizes) / sizeof(blockSizes[0]); b++) {
+            run(s, blockSizes[b]);
+        }
+    }
+    printf("budget: share of a %u MHz core at %u samples/s\n",
+           CPU_HZ / 1000000U, AUDIO_RATE);
+    if (failed) {
+        fprintf(stderr, "adpcm-bench: decoding differs from the reference "
+                        "or is too noisy\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+/**
+ * @file    adpcm_encode.c
+ * @brief   Builds a sound of @p audio/adpcm.h from a WAV file.
+ * @details <tt>adpcm-encode [-s blocksize] [-n name] sound.wav sound.c</tt>
+ *
+ *          Reads a 16 bit PCM file, mixes its channels down to one,
+ *          resamples it linearly to @p AUDIO_RATE and writes it as IMA
+ *          ADPCM in blocks of @p blocksize bytes, @p BLOCK_SIZE by default,
+ *          as a C file defining the @p AdpcmSound @p name, @p sound by
+ *          default, to build into the firmware and play with
+ *          @p audioHwSound().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "audio/adpcm.h"
+#include "wav.h"
+
+/* Up to 2 ms of a sound lost to a damaged byte, 4 bytes of header in 256. */
+#define BLOCK_SIZE                  256
+
+#define BLOCK_SIZE_MAX              4096
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: adpcm-encode [-s blocksize] [-n name] sound.wav "
+            "sound.c\n");
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief   Resamples @p n samples from @p rate to @p AUDIO_RATE, linearly.
+ */
+static int16_t *resample(const int16_t *in, size_t n, uint32_t rate,
+                         size_t *out) {
+    int16_t *pcm;
+    size_t i;
+
+    *out = (size_t)((uint64_t)n * AUDIO_RATE / rate);
+    pcm = malloc(*out * sizeof(*pcm) + 1);
+    if (pcm == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < *out; i++) {
+        uint64_t at = (uint64_t)i * rate;
+        size_t k = (size_t)(at / AUDIO_RATE);
+        int32_t frac = (int32_t)(at % AUDIO_RATE);
+        int32_t a = in[k];
+        int32_t b = k + 1 < n ? in[k + 1] : a;
+
+        pcm[i] = (int16_t)(a + (b - a) * frac / (int32_t)AUDIO_RATE);
+    }
+    return pcm;
+}
+
+int main(int argc, char **argv) {
+    unsigned blockSize = BLOCK_SIZE;
+    const char *name = "sound";
+    int16_t *in, *pcm;
+    uint8_t *data;
+    uint32_t rate;
+    size_t n, samples, len, i;
+    FILE *f;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:n:")) != -1) {
+        switch (opt) {
+        case 's':
+            blockSize = (unsigned)strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            name = optarg;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (argc - optind != 2) {
+        usage();
+    }
+    if (blockSize <= ADPCM_HEADER_SIZE || blockSize % 2 != 0 ||
+        blockSize > BLOCK_SIZE_MAX) {
+        fprintf(stderr, "adpcm-encode: bad block size %u\n", blockSize);
+        return EXIT_FAILURE;
+    }
+
+    in = wavRead(argv[optind], &rate, &n);
+    if (in == NULL || rate == 0) {
+        fprintf(stderr, "%s: not a 16 bit PCM WAV file\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+    pcm = rate == AUDIO_RATE ? in : resample(in, n, rate, &samples);
+    if (rate == AUDIO_RATE) {
+        samples = n;
+    }
+    data = malloc(adpcmSize(samples, blockSize) + 1);
+    if (pcm == NULL || data == NULL) {
+        perror("adpcm-encode");
+        return EXIT_FAILURE;
+    }
+    len = adpcmEncode(pcm, samples, blockSize, data);
+
+    f = fopen(argv[optind + 1], "w");
+    if (f == NULL) {
+        perror(argv[optind + 1]);
+        return EXIT_FAILURE;
+    }
+    fprintf(f, "/* %s, %zu samples, built by adpcm-encode. */\n\n",
+            argv[optind], samples);
+    fprintf(f, "#include \"audio/adpcm.h\"\n\n");
+    fprintf(f, "static const uint8_t data[%zu] = {", len);
+    for (i = 0; i < len; i++) {
+        fprintf(f, "%s0x%02x,", i % 12 == 0 ? "\n    " : " ", data[i]);
+    }
+    fprintf(f, "\n};\n\n");
+    fprintf(f, "const AdpcmSound %s = {data, %zuU, %uU};\n", name, samples,
+            blockSize);
+    if (fclose(f) != 0) {
+        perror(argv[optind + 1]);
+        return EXIT_FAILURE;
+    }
+    printf("%zu samples, %zu bytes, %.2f:1 against 16 bit PCM\n", samples,
+           len, len != 0 ? 2.0 * samples / len : 0.0);
+    if (pcm != in) {
+        free(pcm);
+    }
+    free(in);
+    free(data);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,280 @@
+/**
+ * @file    audio_bench.c
+ * @brief   Decision beeps through the DMA double buffer.
+ * @details @p TAPS taps @p TAP_GAP_MIN_US to @p TAP_GAP_MAX_US apart beep
+ *          a grant or a denial as the reader does, some of them a second
+ *          tap cutting the beep before short. Meanwhile the access list
+ *          compacts in bursts of @p ERASES page erases, each stalling the
+ *          CPU and its interrupts for @p ERASE_US, @p STEP_US apart; the
+ *          reader holds them back while a sound plays.
+ *
+ *          Every sample the DAC converts is compared with the beeps
+ *          rendered on their own: a sound starts at once when the output
+ *          is stopped and with the block after the next refill otherwise,
+ *          and plays to its end or to the next sound without a sample
+ *          missing or repeated. Without the erases held back the
+ *          conversions go on over stale blocks, which shows as late blocks
+ *          and wrong samples.
+ *
+ *          Each run reports the blocks rendered, the late ones, the wrong
+ *          samples, the longest wait for a sound to start, and the render
+ *          cycles per block, in cycles of the build machine, with the load
+ *          they would be on a 48 MHz core. With @p --wav FILE the output of
+ *          the first run is also written to a WAV file.
+ *
+ *          Fails if a sample differs where the erases are held back, a
+ *          sound starts later than two blocks, the output does not stop
+ *          after two silent blocks, or the stall goes unnoticed where they
+ *          are not.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio_sim.h"
+#include "vclock.h"
+#include "wav.h"
+
+#define TAPS                        40
+#define TAP_GAP_MIN_US              50000
+#define TAP_GAP_MAX_US              1500000
+#define RETAP_PERCENT               15
+#define RETAP_MAX_US                200000
+#define GRANT_PERCENT               85
+
+/* The beeps of main.c, at the level of drivers/audio_hw.h. */
+#define GRANT_HZ                    2000
+#define GRANT_MS                    120
+#define DENY_HZ                     500
+#define DENY_MS                     400
+#define LEVEL                       16000
+
+#define COMPACTIONS                 8
+#define ERASES                      6
+#define ERASE_US                    40000
+#define STEP_US                     20000
+
+#define TICK_US                     1000
+#define CPU_HZ                      48000000U
+
+#define TRACE_SIZE                  (AUDIO_RATE * 80U)
+
+typedef struct {
+    uint64_t played;                /**< Sample converted next.             */
+    uint64_t start;
+    bool granted;
+} Beep;
+
+static const struct {
+    const char *name;
+    bool compact;
+    bool gated;
+} runs[] = {
+    {"quiet", false, false},
+    {"erases held", true, true},
+    {"erases", true, false},
+};
+
+static AudioEngine engine;
+static AudioSim sim;
+static AudioBeep slots[2];
+static Beep beeps[TAPS];
+static uint16_t trace[TRACE_SIZE];
+static uint16_t expected[TRACE_SIZE];
+static uint32_t seed;
+static bool failed;
+
+static uint32_t random_below(uint32_t n) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % n;
+}
+
+/**
+ * @brief   Beeps a decision as @p audioHwBeep() and notes where it must
+ *          start.
+ */
+static void beep(size_t n, bool granted) {
+    AudioBeep *bp;
+    Beep *b = &beeps[n];
+    bool idle;
+
+    audioSimSync(&sim);
+    idle = !sim.running;
+    b->played = sim.samples;
+    b->granted = granted;
+    if (idle) {
+        b->start = b->played;
+    } else {
+        /* Taken by the refill of the next half transfer, which the DMA
+           converts after the block it is in. */
+        b->start = sim.startedAt +
+                   ((b->played - sim.startedAt) / AUDIO_BLOCK + 2) *
+                       AUDIO_BLOCK;
+    }
+    bp = engine.source == audioBeepSource && engine.arg == &slots[0]
+             ? &slots[1]
+             : &slots[0];
+    audioBeepInit(bp, granted ? GRANT_HZ : DENY_HZ,
+                  granted ? GRANT_MS : DENY_MS, LEVEL);
+    audioSimPlay(&sim, audioBeepSource, bp);
+}
+
+/**
+ * @brief   What the DAC should have converted, each beep rendered on its
+ *          own up to the next one.
+ */
+static void expect(size_t samples) {
+    int16_t block[AUDIO_BLOCK];
+    size_t i;
+
+    for (i = 0; i < samples; i++) {
+        expected[i] = AUDIO_DAC_ZERO;
+    }
+    for (i = 0; i < TAPS; i++) {
+        uint64_t at = beeps[i].start;
+        uint64_t end = i + 1 < TAPS ? beeps[i + 1].start : samples;
+        AudioBeep bp;
+        size_t n, j;
+
+        audioBeepInit(&bp, beeps[i].granted ? GRANT_HZ : DENY_HZ,
+                      beeps[i].granted ? GRANT_MS : DENY_MS, LEVEL);
+        do {
+            n = audioBeepSource(&bp, block, AUDIO_BLOCK);
+            for (j = 0; j < n && at < end && at < samples; j++, at++) {
+                expected[at] = (uint16_t)((uint16_t)(block[j] + 32768) >> 4);
+            }
+        } while (n == AUDIO_BLOCK && at < end && at < samples);
+    }
+}
+
+static void run(size_t r, FILE *wav) {
+    const AudioStats *stats = &engine.stats;
+    uint32_t tapAt[TAPS];
+    uint32_t now = 0, at = 0, compactAt, wrong = 0, waitMax = 0, stalls = 0;
+    unsigned compactions = 0, erasesLeft = 0;
+    size_t tap = 0, samples, i;
+
+    seed = 1;
+    for (i = 0; i < TAPS; i++) {
+        if (i > 0 && random_below(100) < RETAP_PERCENT) {
+            at += 1 + random_below(RETAP_MAX_US);
+        } else {
+            at += TAP_GAP_MIN_US +
+                  random_below(TAP_GAP_MAX_US - TAP_GAP_MIN_US);
+        }
+        tapAt[i] = at;
+    }
+    compactAt = random_below(TAP_GAP_MAX_US);
+    audioSimInit(&sim, &engine, trace, TRACE_SIZE, wav);
+
+    while (tap < TAPS || erasesLeft > 0 || audioSimPlaying(&sim)) {
+        if (tap < TAPS && now >= tapAt[tap]) {
+            beep(tap, random_below(100) < GRANT_PERCENT);
+            tap++;
+        }
+        if (runs[r].compact && now >= compactAt) {
+            if (erasesLeft == 0 && compactions < COMPACTIONS) {
+                erasesLeft = ERASES;
+                compactions++;
+            }
+            if (erasesLeft == 0) {
+                compactAt = UINT32_MAX;
+            } else if (runs[r].gated && audioSimPlaying(&sim)) {
+                compactAt = now + STEP_US;
+            } else {
+                audioSimStall(&sim, ERASE_US);
+                now += ERASE_US;
+                stalls++;
+                if (--erasesLeft == 0) {
+                    compactAt = now + TAP_GAP_MAX_US +
+                                random_below(4 * TAP_GAP_MAX_US);
+                } else {
+                    compactAt = now + STEP_US;
+                }
+            }
+        }
+        vclockAdvance(TICK_US * 1000U);
+        now += TICK_US;
+        audioSimSync(&sim);
+    }
+
+    samples = sim.samples < TRACE_SIZE ? (size_t)sim.samples : TRACE_SIZE;
+    expect(samples);
+    for (i = 0; i < samples; i++) {
+        if (trace[i] != expected[i]) {
+            wrong++;
+        }
+    }
+    for (i = 0; i < TAPS; i++) {
+        uint32_t wait = (uint32_t)(beeps[i].start - beeps[i].played);
+
+        if (wait > waitMax) {
+            waitMax = wait;
+        }
+    }
+    if (sim.samples > TRACE_SIZE || waitMax > 2 * AUDIO_BLOCK ||
+        stats->silent < 2 * sim.stops || stats->silent > 2 * sim.starts ||
+        sim.starts != sim.stops) {
+        failed = true;
+    }
+    if (runs[r].gated || !runs[r].compact) {
+        if (wrong != 0 || stats->late != 0) {
+            failed = true;
+        }
+    } else if (stalls == 0 || stats->late == 0) {
+        failed = true;
+    }
+
+    printf("  %-12s %6u %6u %6u %6u %5u %7u %8.1f %7.1f %7u %6.1f\n",
+           runs[r].name, (unsigned)stats->sounds, (unsigned)sim.starts,
+           (unsigned)stats->blocks, (unsigned)stats->silent,
+           (unsigned)stats->late, (unsigned)wrong,
+           waitMax * 1000.0 / AUDIO_RATE,
+           stats->blocks != 0 ? (double)stats->cycles / stats->blocks : 0.0,
+           (unsigned)stats->maxCycles, audioLoad(&engine, CPU_HZ) / 10.0);
+}
+
+int main(int argc, char **argv) {
+    const char *path = NULL;
+    FILE *wav = NULL;
+    size_t r;
+
+    if (argc == 3 && strcmp(argv[1], "--wav") == 0) {
+        path = argv[2];
+    } else if (argc != 1) {
+        fprintf(stderr, "usage: %s [--wav FILE]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("audio-bench (%u taps, %u samples/s in blocks of %u, %u us; "
+           "erases of %u ms)\n", TAPS, AUDIO_RATE, AUDIO_BLOCK,
+           AUDIO_BLOCK_US, ERASE_US / 1000);
+    printf("  %-12s %6s %6s %6s %6s %5s %7s %8s %7s %7s %6s\n", "run",
+           "sounds", "starts", "blocks", "silent", "late", "wrong",
+           "wait ms", "cyc/blk", "max", "load%");
+    for (r = 0; r < sizeof(runs) / sizeof(runs[0]); r++) {
+        if (r == 0 && path != NULL) {
+            wav = wavCreate(path, AUDIO_RATE);
+            if (wav == NULL) {
+                perror(path);
+                return EXIT_FAILURE;
+            }
+        }
+        run(r, wav);
+        if (wav != NULL) {
+            if (!wavClose(wav)) {
+                perror(path);
+                return EXIT_FAILURE;
+            }
+            wav = NULL;
+        }
+    }
+    printf("cycles of the build machine, load on a %u MHz core\n",
+           CPU_HZ / 1000000U);
+    if (failed) {
+        fprintf(stderr, "audio-bench: output not as rendered\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
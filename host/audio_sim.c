@@ -0,0 +1,127 @@
+/**
+ * @file    audio_sim.c
+ * @brief   DMA and DAC of the sound output on the virtual clock.
+ */
+
+#include <string.h>
+
+#include "audio_sim.h"
+#include "vclock.h"
+#include "wav.h"
+
+#define SAMPLE_NS                   (1000000000U / AUDIO_RATE)
+
+/*
+ * The transfer interrupt on block @p block, the DMA being at pos.
+ */
+static void refill(AudioSim *sp, size_t block) {
+    if (!audioRefill(sp->engine, &sp->buffer[block * AUDIO_BLOCK])) {
+        sp->running = false;
+        sp->out = AUDIO_DAC_ZERO;
+        sp->stops++;
+        return;
+    }
+    if (sp->pos / AUDIO_BLOCK == block) {
+        sp->engine->stats.late++;
+    }
+}
+
+static void convert(AudioSim *sp) {
+    if (sp->running) {
+        sp->out = sp->buffer[sp->pos++];
+    }
+    if (sp->samples < sp->traceSize) {
+        sp->trace[sp->samples] = sp->out;
+    }
+    if (sp->wav != NULL) {
+        int16_t s = (int16_t)((sp->out - AUDIO_DAC_ZERO) << 4);
+
+        wavWrite(sp->wav, &s, 1);
+    }
+    sp->samples++;
+    sp->nextNs += SAMPLE_NS;
+
+    if (sp->running && sp->pos % AUDIO_BLOCK == 0) {
+        size_t block = sp->pos / AUDIO_BLOCK - 1;
+
+        sp->pos %= 2 * AUDIO_BLOCK;
+        if (sp->stalled) {
+            sp->pending |= (uint8_t)(1U << block);
+        } else {
+            refill(sp, block);
+        }
+    }
+}
+
+/**
+ * @brief   Starts the model stopped, the DAC holding a zero sample.
+ * @details @p trace and @p wav may be @p NULL.
+ */
+void audioSimInit(AudioSim *sp, AudioEngine *ap, uint16_t *trace,
+                  size_t traceSize, FILE *wav) {
+    memset(sp, 0, sizeof(*sp));
+    sp->engine = ap;
+    sp->out = AUDIO_DAC_ZERO;
+    sp->nextNs = vclockNow();
+    sp->trace = trace;
+    sp->traceSize = trace != NULL ? traceSize : 0;
+    sp->wav = wav;
+    audioInit(ap);
+}
+
+/**
+ * @brief   Converts the samples due by the virtual clock.
+ */
+void audioSimSync(AudioSim *sp) {
+    uint64_t now = vclockNow();
+
+    while (sp->nextNs <= now) {
+        convert(sp);
+    }
+}
+
+/**
+ * @brief   Plays @p source, as @p audioHwPlay().
+ */
+void audioSimPlay(AudioSim *sp, audiosourcecb_t source, void *arg) {
+    audioSimSync(sp);
+    audioPlayI(sp->engine, source, arg);
+    if (!sp->running && source != NULL) {
+        (void)audioRefill(sp->engine, sp->buffer);
+        (void)audioRefill(sp->engine, &sp->buffer[AUDIO_BLOCK]);
+        sp->running = true;
+        sp->pos = 0;
+        sp->startedAt = sp->samples;
+        sp->starts++;
+    }
+}
+
+/**
+ * @brief   Holds the interrupts back for @p us of virtual time.
+ */
+void audioSimStall(AudioSim *sp, uint32_t us) {
+    size_t block;
+
+    audioSimSync(sp);
+    sp->stalled = true;
+    vclockAdvance((uint64_t)us * 1000U);
+    audioSimSync(sp);
+    sp->stalled = false;
+    /* The block finished first, then the one the DMA is in. */
+    block = sp->pos / AUDIO_BLOCK;
+    if ((sp->pending & (1U << (block ^ 1))) != 0 && sp->running) {
+        refill(sp, block ^ 1);
+    }
+    if ((sp->pending & (1U << block)) != 0 && sp->running) {
+        refill(sp, block);
+    }
+    sp->pending = 0;
+}
+
+/**
+ * @brief   Whether converting or a sound is about to play, as
+ *          @p audioHwPlaying().
+ */
+bool audioSimPlaying(const AudioSim *sp) {
+    return sp->running || audioPlaying(sp->engine);
+}
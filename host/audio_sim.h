@@ -0,0 +1,55 @@
+/**
+ * @file    audio_sim.h
+ * @brief   DMA and DAC of the sound output on the virtual clock, the host
+ *          counterpart of @p drivers/audio_hw.h.
+ * @details A sample is converted every @p AUDIO_RATE period of the virtual
+ *          clock from the double buffer, in a circle, and the block the DMA
+ *          is done with is refilled at once as by the transfer interrupt.
+ *          A stall holds the interrupts back the way a flash erase does,
+ *          the DMA going on: the refills run when it ends, and a block the
+ *          DMA reached before is counted late, as the board driver does.
+ *
+ *          Every converted sample, the held output while stopped included,
+ *          goes to the trace and to the WAV file if there are.
+ */
+
+#ifndef _AUDIO_SIM_H_
+#define _AUDIO_SIM_H_
+
+#include <stdio.h>
+
+#include "audio/audio.h"
+
+typedef struct {
+    AudioEngine *engine;
+    uint16_t buffer[2 * AUDIO_BLOCK];
+    size_t pos;                     /**< Next sample the DMA converts.      */
+    bool running;
+    bool stalled;
+    uint8_t pending;                /**< Blocks to refill after the stall.  */
+    uint16_t out;                   /**< Held by the DAC.                   */
+    uint64_t nextNs;                /**< Virtual time of the next sample.   */
+    uint64_t samples;               /**< Converted.                         */
+    uint64_t startedAt;             /**< Sample the last start converted
+                                         first.                             */
+    uint32_t starts;
+    uint32_t stops;
+    uint16_t *trace;
+    size_t traceSize;
+    FILE *wav;
+} AudioSim;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void audioSimInit(AudioSim *sp, AudioEngine *ap, uint16_t *trace,
+                    size_t traceSize, FILE *wav);
+  void audioSimSync(AudioSim *sp);
+  void audioSimPlay(AudioSim *sp, audiosourcecb_t source, void *arg);
+  void audioSimStall(AudioSim *sp, uint32_t us);
+  bool audioSimPlaying(const AudioSim *sp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _AUDIO_SIM_H_ */
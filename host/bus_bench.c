@@ -0,0 +1,305 @@
+/**
+ * @file    bus_bench.c
+ * @brief   Event latency of readers sharing one controller bus.
+ * @details N reader instances, each running the link driver and the
+ *          protocol in its own thread on its own simulated USART, share a
+ *          half-duplex bus with the controller stand-in, which passes the
+ *          token to them in turn. Every reader sees cards at random times,
+ *          @p EVENT_GAP_US apart on average, and the controller polls the
+ *          status of each once a second. The latency runs from a card event
+ *          to its feedback command back at the reader, as N grows.
+ *
+ *          The bench fails on a collision, a token not handed back, or an
+ *          event or feedback lost, duplicated or reordered.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "link/proto.h"
+#include "reader/event.h"
+#include "bus_sim.h"
+#include "controller_sim.h"
+#include "sim_thread.h"
+#include "uart_sim.h"
+#include "vclock.h"
+
+#define EVENTS                      20
+#define EVENT_GAP_US                200000
+#define POLL_US                     1000000
+#define TURNAROUND_US               500
+#define UID_LEN                     7
+
+/* Free line the controller leaves after a reader's last stop bit. */
+#define GUARD_US                    10
+
+/* Gives up this long after the last event is due. */
+#define DRAIN_US                    2000000
+
+typedef struct {
+    UartSim uart;
+    LinkDriver link;
+    LinkConfig linkConfig;
+    Proto proto;
+    ProtoConfig config;
+    SimThread thread;
+    uint32_t seed;
+    uint32_t due;                   /**< Of the next event.                 */
+    uint32_t sent;
+    uint32_t feedbacks;
+    uint32_t statusRequests;
+    uint32_t statusSent;
+    uint32_t sentAt[EVENTS];
+} Reader;
+
+static const size_t counts[] = {1, 2, 4, 8, 16, 32, 64};
+static const uint32_t bitrates[] = {115200, 921600};
+
+static BusSim bus;
+static ControllerSim controller;
+static Reader readers[BUS_SIM_READERS_MAX];
+static SimThread threads[BUS_SIM_READERS_MAX];
+static size_t readerCount;
+static uint64_t latency[BUS_SIM_READERS_MAX * EVENTS];
+static size_t latencies;
+static uint32_t lastDue;
+static bool failed;
+
+static uint32_t until(uint32_t at) {
+    int32_t left = (int32_t)(at - platformNowUs());
+
+    return left > 0 ? (uint32_t)left : 0;
+}
+
+static uint32_t next_gap(Reader *rp) {
+    rp->seed = rp->seed * 1103515245 + 12345;
+    return (rp->seed >> 8) % (2 * EVENT_GAP_US);
+}
+
+static void reader_send(void *arg, const uint8_t *frame, size_t len) {
+    Reader *rp = arg;
+
+    linkSend(&rp->link, frame, len);
+}
+
+static void reader_receive(void *arg, uint8_t type, const uint8_t *payload,
+                           size_t len) {
+    Reader *rp = arg;
+    uint32_t n;
+
+    if (type == PROTO_MSG_STATUS_REQUEST) {
+        rp->statusRequests++;
+        return;
+    }
+    if (type != PROTO_MSG_FEEDBACK || len != 1 + UID_LEN ||
+        payload[0] != UID_LEN) {
+        failed = true;
+        return;
+    }
+    n = (uint32_t)payload[1] << 24 | (uint32_t)payload[2] << 16 |
+        (uint32_t)payload[3] << 8 | payload[4];
+    if (n != rp->feedbacks || n >= rp->sent) {
+        failed = true;
+        return;
+    }
+    rp->feedbacks++;
+    latency[latencies++] = platformElapsedUs(rp->sentAt[n]);
+}
+
+/**
+ * @brief   Queues the events due and the status answers for the next turn.
+ */
+static uint32_t reader_service(void *arg) {
+    static const uint8_t status[] = {0x00};
+    Reader *rp = arg;
+
+    while (rp->statusSent < rp->statusRequests &&
+           protoSend(&rp->proto, PROTO_MSG_STATUS, status, sizeof(status)) ==
+               PROTO_OK) {
+        rp->statusSent++;
+    }
+    while (rp->sent < EVENTS && until(rp->due) == 0) {
+        ReaderEvent event;
+        uint8_t payload[READER_EVENT_MAX_SIZE];
+        size_t len;
+        uint32_t n = rp->sent;
+
+        memset(&event, 0, sizeof(event));
+        event.type = READER_EVENT_CARD;
+        event.card.uidlen = UID_LEN;
+        event.card.uid[0] = (uint8_t)(n >> 24);
+        event.card.uid[1] = (uint8_t)(n >> 16);
+        event.card.uid[2] = (uint8_t)(n >> 8);
+        event.card.uid[3] = (uint8_t)n;
+        event.card.uid[4] = (uint8_t)(rp - readers);
+        event.card.sak = 0x08;
+        event.card.atqa[0] = 0x44;
+        len = readerEventEncode(&event, payload, sizeof(payload));
+        if (protoSend(&rp->proto, PROTO_MSG_EVENT, payload, len) !=
+                PROTO_OK) {
+            break;
+        }
+        rp->sentAt[n] = rp->due;
+        rp->sent++;
+        rp->due += next_gap(rp);
+    }
+    /* Only ever served at a turn. */
+    return LINK_WAIT_FOREVER;
+}
+
+static bool finished(void) {
+    size_t i;
+
+    if ((int32_t)(platformNowUs() - lastDue) > DRAIN_US) {
+        return true;
+    }
+    for (i = 0; i < readerCount; i++) {
+        if (readers[i].feedbacks < EVENTS) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief   The firmware of one reader: serves the bus until the run ends.
+ */
+static void reader_thread(void *arg) {
+    Reader *rp = arg;
+
+    while (!finished()) {
+        uint32_t wait = 10000;
+
+        if (rp->sent < EVENTS &&
+            protoInFlight(&rp->proto) < rp->config.window &&
+            until(rp->due) < wait) {
+            wait = until(rp->due);
+        }
+        protoRun(&rp->proto, &rp->link, wait);
+    }
+    /* The readers leave the bus one by one, their turns end here. */
+    controllerSimStop(&controller);
+    linkStop(&rp->link);
+}
+
+static void reader_init(Reader *rp, size_t i, uint32_t bitrate) {
+    memset(rp, 0, sizeof(*rp));
+    uartSimInit(&rp->uart, bitrate, &rp->link);
+    busSimAttach(&bus, &rp->uart);
+    rp->linkConfig.transport = &uartSimTransport;
+    rp->linkConfig.ctx = &rp->uart;
+    linkObjectInit(&rp->link);
+    linkStart(&rp->link, &rp->linkConfig);
+
+    rp->config.send = reader_send;
+    rp->config.receive = reader_receive;
+    rp->config.service = reader_service;
+    rp->config.arg = rp;
+    rp->config.window = PROTO_WINDOW_MAX;
+    rp->config.address = (uint8_t)(i + 1);
+    protoInit(&rp->proto, &rp->config);
+    /* As the firmware does at start-up, in the first turn. */
+    protoReset(&rp->proto);
+
+    rp->seed = (uint32_t)i * 7919 + 1;
+    rp->due = platformNowUs() + next_gap(rp);
+    simThreadCreate(&threads[i], reader_thread, rp);
+}
+
+static int compare(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void run(size_t count, uint32_t bitrate) {
+    uint32_t charUs = (10000000 + bitrate - 1) / bitrate;
+    uint32_t start = platformNowUs();
+    uint32_t sent = 0, feedbacks = 0, statuses = 0;
+    uint32_t elapsed;
+    size_t i;
+
+    busSimInit(&bus, bitrate);
+    readerCount = count;
+    latencies = 0;
+    lastDue = start;
+    for (i = 0; i < count; i++) {
+        reader_init(&readers[i], i, bitrate);
+    }
+    controllerSimInitBus(&controller, &bus, count, PROTO_WINDOW_MAX);
+    controller.turnaround = TURNAROUND_US;
+    controller.guard = GUARD_US;
+    /* The idle line interrupt and a full window of the longest frames. */
+    controller.slotTime = (2 + PROTO_WINDOW_MAX * PROTO_FRAME_MAX) * charUs;
+    controllerSimPoll(&controller, POLL_US);
+    for (i = 0; i < count; i++) {
+        uint32_t due = readers[i].due;
+        Reader probe = readers[i];
+        unsigned n;
+
+        /* The last event of each reader, for the drain time. */
+        for (n = 1; n < EVENTS; n++) {
+            due += next_gap(&probe);
+        }
+        if ((int32_t)(due - lastDue) > 0) {
+            lastDue = due;
+        }
+    }
+
+    simThreadRun(threads, count);
+    elapsed = platformElapsedUs(start);
+    for (i = 0; i < count; i++) {
+        uartSimRun(&readers[i].uart);
+    }
+
+    for (i = 0; i < count; i++) {
+        sent += readers[i].sent;
+        feedbacks += readers[i].feedbacks;
+        statuses += readers[i].statusSent;
+        if (readers[i].statusSent != readers[i].statusRequests) {
+            failed = true;
+        }
+    }
+    if (sent != count * EVENTS || feedbacks != sent ||
+        controller.stats.events != sent || controller.stats.misordered != 0 ||
+        bus.collisions != 0 || controller.stats.timeouts != 0) {
+        failed = true;
+    }
+
+    qsort(latency, latencies, sizeof(latency[0]), compare);
+    printf("  %7u %4u  %7.2f", (unsigned)bitrate, (unsigned)count,
+           elapsed / 1000.0 * count / controller.stats.turns);
+    if (latencies > 0) {
+        printf("  %6.2f %6.2f %6.2f", latency[(latencies - 1) / 2] / 1000.0,
+               latency[(latencies * 99 + 99) / 100 - 1] / 1000.0,
+               latency[latencies - 1] / 1000.0);
+    } else {
+        printf("       -      -      -");
+    }
+    printf("  %5u %4u %4u %5u\n", (unsigned)feedbacks,
+           (unsigned)controller.stats.timeouts, (unsigned)bus.collisions,
+           (unsigned)statuses);
+}
+
+int main(void) {
+    size_t i, j;
+
+    printf("bus-bench (%u events per reader, %u ms apart on average, "
+           "window %u)\n", EVENTS, EVENT_GAP_US / 1000, PROTO_WINDOW_MAX);
+    printf("    bit/s    N round ms  -- event to feedback ms --  "
+           "  done  t/o coll  stat\n");
+    printf("                            p50    p99    max\n");
+    for (i = 0; i < sizeof(bitrates) / sizeof(bitrates[0]); i++) {
+        for (j = 0; j < sizeof(counts) / sizeof(counts[0]); j++) {
+            run(counts[j], bitrates[i]);
+        }
+    }
+    if (failed) {
+        fprintf(stderr, "bus-bench: collisions, lost turns or messages lost, "
+                        "duplicated or reordered\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,93 @@
+/**
+ * @file    bus_sim.c
+ * @brief   Half-duplex multi-drop line joining the controller and several
+ *          simulated reader UARTs.
+ */
+
+#include <string.h>
+
+#include "bus_sim.h"
+#include "vclock.h"
+
+/**
+ * @brief   Puts @p n bytes of @p end on the line, checking that no one else
+ *          drives it. The bytes of one end queue up behind each other.
+ */
+static void drive(BusSim *bus, const void *end, size_t n) {
+    uint64_t start = vclockNow();
+
+    if (start < bus->busyUntil) {
+        if (bus->driver != end) {
+            bus->collisions++;
+        } else {
+            start = bus->busyUntil;
+        }
+    }
+    if (start + n * bus->charNs > bus->busyUntil) {
+        bus->busyUntil = start + n * bus->charNs;
+    }
+    bus->driver = end;
+}
+
+/**
+ * @brief   A reader starts transmitting, the other readers hear it.
+ */
+static void reader_tx(UartSim *sim, const uint8_t *buf, size_t n) {
+    BusSim *bus = sim->peer;
+    size_t i;
+
+    drive(bus, sim, n);
+    for (i = 0; i < bus->count; i++) {
+        if (bus->readers[i] != sim) {
+            uartSimPeerSend(bus->readers[i], buf, n);
+        }
+    }
+}
+
+/**
+ * @brief   A reader is done transmitting, the controller gets the bytes.
+ */
+static void reader_done(UartSim *sim) {
+    BusSim *bus = sim->peer;
+    uint8_t buf[256];
+    size_t n;
+
+    while ((n = uartSimPeerReceive(sim, buf, sizeof(buf))) > 0) {
+        if (bus->rx != NULL) {
+            bus->rx(bus->arg, buf, n);
+        }
+    }
+}
+
+/**
+ * @brief   Sets up an idle line at @p bitrate with no one on it.
+ */
+void busSimInit(BusSim *bus, uint32_t bitrate) {
+    memset(bus, 0, sizeof(*bus));
+    bus->charNs = 10000000000ULL / bitrate;
+}
+
+/**
+ * @brief   Connects a reader UART, set up for the bit rate of the bus.
+ */
+void busSimAttach(BusSim *bus, UartSim *sim) {
+    if (bus->count == BUS_SIM_READERS_MAX) {
+        return;
+    }
+    bus->readers[bus->count++] = sim;
+    sim->peer = bus;
+    sim->txstart = reader_tx;
+    sim->peerrx = reader_done;
+}
+
+/**
+ * @brief   The controller transmits @p n bytes, right now.
+ */
+void busSimSend(BusSim *bus, const uint8_t *buf, size_t n) {
+    size_t i;
+
+    drive(bus, bus, n);
+    for (i = 0; i < bus->count; i++) {
+        uartSimPeerSend(bus->readers[i], buf, n);
+    }
+}
@@ -0,0 +1,51 @@
+/**
+ * @file    bus_sim.h
+ * @brief   Half-duplex multi-drop line joining the controller and several
+ *          simulated reader UARTs.
+ * @details What one end transmits reaches all the others at the line rate:
+ *          the readers get the controller's bytes and each other's in their
+ *          @p UartSim, the controller gets a reader's frame from its
+ *          callback once the last stop bit is through. Two ends driving the
+ *          line at the same time is a collision; the bytes still arrive, the
+ *          collision is only counted, as the protocol must never cause one.
+ *          A reader does not hear itself, as with the receiver of its
+ *          transceiver disabled while it drives the line.
+ */
+
+#ifndef _BUS_SIM_H_
+#define _BUS_SIM_H_
+
+#include "uart_sim.h"
+
+/**
+ * @brief   Readers on one bus.
+ */
+#define BUS_SIM_READERS_MAX         64
+
+/**
+ * @brief   Receives the bytes a reader transmitted.
+ */
+typedef void (*bussimrxcb_t)(void *arg, const uint8_t *data, size_t n);
+
+typedef struct {
+    uint64_t charNs;
+    UartSim *readers[BUS_SIM_READERS_MAX];
+    size_t count;
+    uint64_t busyUntil;             /**< End of the last transmission, ns.  */
+    const void *driver;             /**< End which sent it.                 */
+    uint32_t collisions;
+    bussimrxcb_t rx;                /**< Controller.                        */
+    void *arg;
+} BusSim;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void busSimInit(BusSim *bus, uint32_t bitrate);
+  void busSimAttach(BusSim *bus, UartSim *sim);
+  void busSimSend(BusSim *bus, const uint8_t *buf, size_t n);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _BUS_SIM_H_ */
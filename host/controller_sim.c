@@ -0,0 +1,434 @@
+/**
+ * @file    controller_sim.c
+ * @brief   Controller stand-in at the far end of a simulated UART or bus.
+ */
+
+#include <string.h>
+
+#include "controller_sim.h"
+#include "reader/event.h"
+#include "vclock.h"
+
+static void service(ControllerSim *csp);
+static void bus_next(void *arg);
+
+static uint32_t event_number(const uint8_t *uid) {
+    return (uint32_t)uid[0] << 24 | (uint32_t)uid[1] << 16 |
+           (uint32_t)uid[2] << 8 | uid[3];
+}
+
+static uint32_t until(uint32_t at) {
+    int32_t left = (int32_t)(at - platformNowUs());
+
+    return left > 0 ? (uint32_t)left : 0;
+}
+
+static void controller_send(void *arg, const uint8_t *frame, size_t len) {
+    ControllerSimReader *rp = arg;
+
+    if (rp->csp->bus != NULL) {
+        busSimSend(rp->csp->bus, frame, len);
+    } else {
+        uartSimPeerSend(rp->csp->uart, frame, len);
+    }
+}
+
+/**
+ * @brief   Takes one event of @p rp, a card arrival queues its feedback.
+ */
+static void event(ControllerSimReader *rp, const uint8_t *payload,
+                  size_t len) {
+    ControllerSim *csp = rp->csp;
+    size_t i = (rp->pendHead + rp->pendLen) % CONTROLLER_SIM_PENDING;
+
+    if (csp->event != NULL) {
+        csp->event(csp, (size_t)(rp - csp->reader), payload, len);
+    }
+    if (payload[0] != READER_EVENT_CARD) {
+        rp->stats.telemetry++;
+        csp->stats.telemetry++;
+        return;
+    }
+    if (len < 3 + 4 || payload[2] < 4 || payload[2] > ISO14443A_UID_MAX ||
+        len < 3 + (size_t)payload[2]) {
+        return;
+    }
+    rp->stats.events++;
+    csp->stats.events++;
+    if (event_number(&payload[3]) != rp->nextEvent) {
+        rp->stats.misordered++;
+        csp->stats.misordered++;
+    }
+    rp->nextEvent = event_number(&payload[3]) + 1;
+    if (rp->pendLen == CONTROLLER_SIM_PENDING) {
+        return;
+    }
+    rp->dueAt[i] = platformNowUs() + csp->turnaround;
+    rp->uidlen[i] = payload[2];
+    memcpy(rp->uid[i], &payload[3], payload[2]);
+    rp->pendLen++;
+}
+
+static void controller_receive(void *arg, uint8_t type,
+                               const uint8_t *payload, size_t len) {
+    ControllerSimReader *rp = arg;
+    ControllerSim *csp = rp->csp;
+
+    if (csp->rate.config != NULL &&
+        linkRateReceive(&csp->rate, type, payload, len)) {
+        return;
+    }
+    if (type == PROTO_MSG_STATUS) {
+        rp->stats.statuses++;
+        csp->stats.statuses++;
+    } else if (type == PROTO_MSG_EVENT && len > 0) {
+        rp->stats.eventFrames++;
+        csp->stats.eventFrames++;
+        event(rp, payload, len);
+    } else if (type == PROTO_MSG_EVENTS) {
+        size_t i = 0;
+
+        rp->stats.eventFrames++;
+        csp->stats.eventFrames++;
+        while (i < len && payload[i] > 0 && payload[i] < len - i) {
+            event(rp, &payload[i + 1], payload[i]);
+            i += 1 + (size_t)payload[i];
+        }
+    }
+}
+
+/**
+ * @brief   Hands the commands due for @p rp to its protocol end.
+ */
+static void queue_commands(ControllerSimReader *rp) {
+    ControllerSim *csp = rp->csp;
+
+    if (rp->proto.session != NULL) {
+        (void)linkSessionService(&rp->session);
+    }
+    while (rp->pendLen > 0 && until(rp->dueAt[rp->pendHead]) == 0) {
+        uint8_t payload[1 + ISO14443A_UID_MAX];
+        size_t i = rp->pendHead;
+
+        payload[0] = rp->uidlen[i];
+        memcpy(&payload[1], rp->uid[i], rp->uidlen[i]);
+        if (protoSend(&rp->proto, PROTO_MSG_FEEDBACK, payload,
+                      1 + rp->uidlen[i]) != PROTO_OK) {
+            /* Window full, waits for an acknowledgement. */
+            break;
+        }
+        rp->stats.feedbacks++;
+        csp->stats.feedbacks++;
+        rp->pendHead = (rp->pendHead + 1) % CONTROLLER_SIM_PENDING;
+        rp->pendLen--;
+    }
+    if (csp->pollInterval != 0 && until(rp->nextPoll) == 0 &&
+        protoSend(&rp->proto, PROTO_MSG_STATUS_REQUEST, NULL, 0) ==
+            PROTO_OK) {
+        rp->stats.polls++;
+        csp->stats.polls++;
+        rp->nextPoll += csp->pollInterval;
+    }
+}
+
+/**
+ * @brief   Takes the frames a reader transmitted on the point-to-point
+ *          line.
+ */
+static void peer_rx(UartSim *sim) {
+    ControllerSim *csp = sim->peer;
+    uint8_t buf[64];
+    size_t n;
+
+    while ((n = uartSimPeerReceive(sim, buf, sizeof(buf))) > 0) {
+        size_t i = 0;
+
+        /* Up to the delimiter of each frame lost. */
+        while (csp->drop > 0 && i < n) {
+            if (buf[i++] == 0) {
+                csp->drop--;
+            }
+        }
+        protoInput(&csp->reader[0].proto, &buf[i], n - i);
+    }
+    service(csp);
+}
+
+static void timer_cb(void *arg) {
+    service(arg);
+}
+
+/**
+ * @brief   Sends the commands due and arms the timer on the next one.
+ */
+static void service(ControllerSim *csp) {
+    ControllerSimReader *rp = &csp->reader[0];
+    uint32_t wait;
+
+    queue_commands(rp);
+    wait = protoPoll(&rp->proto);
+    if (csp->rate.config != NULL) {
+        uint32_t rate = linkRateService(&csp->rate);
+
+        if (rate < wait) {
+            wait = rate;
+        }
+    }
+    if (rp->pendLen > 0 &&
+        protoInFlight(&rp->proto) < rp->config.window &&
+        until(rp->dueAt[rp->pendHead]) < wait) {
+        wait = until(rp->dueAt[rp->pendHead]);
+    }
+    if (csp->pollInterval != 0 && until(rp->nextPoll) < wait) {
+        wait = until(rp->nextPoll);
+    }
+    if (wait == LINK_WAIT_FOREVER) {
+        platformTimerStopI(&csp->timer);
+    } else {
+        /* At least a microsecond, so the clock moves on. */
+        platformTimerStartI(&csp->timer, wait > 0 ? wait : 1, timer_cb, csp);
+    }
+}
+
+/**
+ * @brief   Microseconds until the bus is free.
+ */
+static uint32_t bus_free(const ControllerSim *csp) {
+    uint64_t now = vclockNow();
+
+    return csp->bus->busyUntil > now ?
+           (uint32_t)((csp->bus->busyUntil - now + 999) / 1000) : 0;
+}
+
+/**
+ * @brief   The reader with the token did not hand it back.
+ */
+static void bus_timeout(void *arg) {
+    ControllerSim *csp = arg;
+
+    csp->waiting = false;
+    csp->stats.timeouts++;
+    csp->reader[csp->turn].stats.timeouts++;
+    bus_next(csp);
+}
+
+/**
+ * @brief   Passes the token to the next reader.
+ */
+static void bus_next(void *arg) {
+    ControllerSim *csp = arg;
+    ControllerSimReader *rp;
+
+    csp->turn = (csp->turn + 1) % csp->readers;
+    rp = &csp->reader[csp->turn];
+    queue_commands(rp);
+    protoPassToken(&rp->proto);
+    rp->stats.turns++;
+    csp->stats.turns++;
+    csp->waiting = true;
+    platformTimerStartI(&csp->timer, bus_free(csp) + csp->slotTime,
+                        bus_timeout, csp);
+}
+
+/**
+ * @brief   Takes the bytes a reader transmitted on the bus.
+ */
+static void bus_rx(void *arg, const uint8_t *data, size_t n) {
+    ControllerSim *csp = arg;
+    size_t i;
+
+    for (i = 0; i < csp->readers; i++) {
+        protoInput(&csp->reader[i].proto, data, n);
+    }
+    if (csp->waiting && csp->reader[csp->turn].proto.token) {
+        csp->waiting = false;
+        platformTimerStartI(&csp->timer, bus_free(csp) + csp->guard,
+                            bus_next, csp);
+    }
+}
+
+static void reader_init(ControllerSim *csp, ControllerSimReader *rp,
+                        uint8_t address, uint8_t window,
+                        uint32_t retransmit) {
+    rp->csp = csp;
+    rp->config.send = controller_send;
+    rp->config.receive = controller_receive;
+    rp->config.arg = rp;
+    rp->config.window = window;
+    rp->config.retransmit = retransmit;
+    rp->config.address = address;
+    rp->config.primary = true;
+    protoInit(&rp->proto, &rp->config);
+}
+
+/**
+ * @brief   Connects the controller to the peer end of @p uart and starts
+ *          it.
+ * @details @p turnaround may be set in the structure right after.
+ */
+void controllerSimInit(ControllerSim *csp, UartSim *uart, uint8_t window,
+                       uint32_t retransmit) {
+    memset(csp, 0, sizeof(*csp));
+    csp->uart = uart;
+    csp->readers = 1;
+    reader_init(csp, &csp->reader[0], PROTO_ADDRESS_P2P, window,
+                retransmit);
+    uart->peerrx = peer_rx;
+    uart->peer = csp;
+}
+
+/**
+ * @brief   Makes the controller the primary of @p bus, with @p readers
+ *          readers at addresses 1 up, and passes the token to the first.
+ * @details @p turnaround, @p slotTime and @p guard are to be set in the
+ *          structure right after, the first token goes out once the clock
+ *          moves.
+ */
+void controllerSimInitBus(ControllerSim *csp, BusSim *bus, size_t readers,
+                          uint8_t window) {
+    size_t i;
+
+    memset(csp, 0, sizeof(*csp));
+    csp->bus = bus;
+    csp->readers = readers;
+    for (i = 0; i < readers; i++) {
+        reader_init(csp, &csp->reader[i], (uint8_t)(i + 1), window, 0);
+    }
+    bus->rx = bus_rx;
+    bus->arg = csp;
+    csp->turn = readers - 1;
+    platformTimerStart(&csp->timer, 0, bus_next, csp);
+}
+
+static bool set_bitrate(void *arg, uint32_t bitrate) {
+    ControllerSim *csp = arg;
+
+    uartSimPeerBitrate(csp->uart, bitrate);
+    return true;
+}
+
+/**
+ * @brief   Negotiates a faster rate of the point-to-point line, from
+ *          @p base up to the fastest of @p rates the line carries.
+ * @details The result is in @p rate.stats once @p rate.state is back to
+ *          @p LINK_RATE_IDLE.
+ */
+void controllerSimNegotiate(ControllerSim *csp, uint32_t base,
+                            const uint32_t *rates, size_t count) {
+    platformLock();
+    csp->rateConfig.rates = rates;
+    csp->rateConfig.count = count;
+    csp->rateConfig.base = base;
+    csp->rateConfig.set = set_bitrate;
+    csp->rateConfig.arg = csp;
+    linkRateInit(&csp->rate, &csp->rateConfig, &csp->reader[0].proto);
+    linkRateStart(&csp->rate);
+    service(csp);
+    platformUnlock();
+}
+
+/**
+ * @brief   Starts a session with every reader under the shared @p key.
+ * @details Messages other than the handshake wait for it, see
+ *          @p link/session.h. The nonces are drawn from a fixed seed.
+ */
+void controllerSimSecure(ControllerSim *csp, const uint8_t *key) {
+    static const uint8_t seed[] = "controller-sim";
+    size_t i;
+
+    platformLock();
+    for (i = 0; i < csp->readers; i++) {
+        ControllerSimReader *rp = &csp->reader[i];
+
+        linkSessionInit(&rp->session, &rp->proto, key);
+        linkSessionSeed(&rp->session, seed, sizeof(seed));
+        linkSessionSeed(&rp->session, &rp->config.address, 1);
+        linkSessionStart(&rp->session);
+    }
+    if (csp->bus == NULL) {
+        service(csp);
+    }
+    platformUnlock();
+}
+
+/**
+ * @brief   Starts a new handshake with every reader, over the sessions
+ *          running.
+ * @details The protocol resets first and the messages in flight either way
+ *          go again under the new key, see @p linkSessionStart().
+ */
+void controllerSimRekey(ControllerSim *csp) {
+    size_t i;
+
+    platformLock();
+    for (i = 0; i < csp->readers; i++) {
+        linkSessionStart(&csp->reader[i].session);
+    }
+    if (csp->bus == NULL) {
+        service(csp);
+    }
+    platformUnlock();
+}
+
+/**
+ * @brief   Starts the status polls, @p pollInterval microseconds apart.
+ */
+void controllerSimPoll(ControllerSim *csp, uint32_t pollInterval) {
+    size_t i;
+
+    platformLock();
+    csp->pollInterval = pollInterval;
+    for (i = 0; i < csp->readers; i++) {
+        csp->reader[i].nextPoll = platformNowUs() + pollInterval;
+    }
+    if (csp->bus == NULL) {
+        service(csp);
+    }
+    platformUnlock();
+}
+
+/**
+ * @brief   Restarts the controller as after a power cycle.
+ * @details The protocol ends start afresh and reset the connection to each
+ *          reader, see @p protoReset(), the sessions start a handshake. The
+ *          commands waiting for their turnaround are lost, the counters are
+ *          kept.
+ */
+void controllerSimRestart(ControllerSim *csp) {
+    static const uint8_t restartSeed[] = "controller-sim restarted";
+    size_t i;
+
+    platformLock();
+    for (i = 0; i < csp->readers; i++) {
+        ControllerSimReader *rp = &csp->reader[i];
+        bool secure = rp->proto.session != NULL;
+
+        protoInit(&rp->proto, &rp->config);
+        protoReset(&rp->proto);
+        rp->pendLen = 0;
+        if (secure) {
+            /* A new seed, so a nonce is not drawn twice. */
+            linkSessionInit(&rp->session, &rp->proto, rp->session.key);
+            linkSessionSeed(&rp->session, restartSeed, sizeof(restartSeed));
+            linkSessionSeed(&rp->session, &rp->config.address, 1);
+            linkSessionStart(&rp->session);
+        }
+    }
+    if (csp->bus == NULL) {
+        service(csp);
+    }
+    platformUnlock();
+}
+
+/**
+ * @brief   Disconnects the controller.
+ */
+void controllerSimStop(ControllerSim *csp) {
+    platformTimerStop(&csp->timer);
+    if (csp->bus != NULL) {
+        csp->bus->rx = NULL;
+    } else {
+        csp->uart->peerrx = NULL;
+        csp->uart->peer = NULL;
+    }
+}
@@ -0,0 +1,132 @@
+/**
+ * @file    controller_sim.h
+ * @brief   Controller stand-in at the far end of a simulated UART or bus.
+ * @details Runs the reader-controller protocol of @p link/proto.h on the
+ *          peer side of a @p UartSim, or as the primary of a @p BusSim with
+ *          one protocol end per reader, from the virtual clock: it answers
+ *          every card event with a feedback command after a turnaround
+ *          time, polls the reader status at a fixed interval and checks
+ *          that the card events of each reader arrive in order, each
+ *          exactly once. Events may come one per message or several in a
+ *          @p PROTO_MSG_EVENTS message.
+ *
+ *          On a point-to-point line it may negotiate a faster bit rate with
+ *          the reader, see @p link/rate.h. The link to each reader may be
+ *          encrypted, see @p link/session.h.
+ *
+ *          On the bus the readers get the token in turn, at bus addresses
+ *          from 1 up. A reader which does not hand it back within the slot
+ *          time loses its turn. Commands wait for the reader's next turn.
+ *
+ *          The card events of a benchmark carry a running number in the
+ *          first four UID bytes, the feedback command echoes the UID.
+ */
+
+#ifndef _CONTROLLER_SIM_H_
+#define _CONTROLLER_SIM_H_
+
+#include "link/proto.h"
+#include "link/rate.h"
+#include "link/session.h"
+#include "rfid/iso14443a.h"
+#include "bus_sim.h"
+#include "uart_sim.h"
+
+/**
+ * @brief   Feedback commands waiting for their turnaround time, per reader.
+ */
+#define CONTROLLER_SIM_PENDING      64
+
+/**
+ * @brief   Readers on a bus.
+ */
+#define CONTROLLER_SIM_READERS      BUS_SIM_READERS_MAX
+
+/**
+ * @brief   Controller counters.
+ */
+typedef struct {
+    uint32_t events;                /**< Card events received.              */
+    uint32_t telemetry;             /**< Other events received.             */
+    uint32_t eventFrames;           /**< Messages carrying events.          */
+    uint32_t misordered;            /**< Events with an unexpected number.  */
+    uint32_t feedbacks;             /**< Feedback commands sent.            */
+    uint32_t polls;                 /**< Status requests sent.              */
+    uint32_t statuses;              /**< Status answers received.           */
+    uint32_t turns;                 /**< Bus: tokens passed.                */
+    uint32_t timeouts;              /**< Bus: tokens not handed back.       */
+} ControllerSimStats;
+
+typedef struct controller_sim ControllerSim;
+
+/**
+ * @brief   Told of every event received from reader @p reader, before it is
+ *          handled.
+ */
+typedef void (*controllersimeventcb_t)(ControllerSim *csp, size_t reader,
+                                       const uint8_t *event, size_t len);
+
+/**
+ * @brief   Controller side of one reader.
+ */
+typedef struct {
+    ControllerSim *csp;
+    Proto proto;
+    ProtoConfig config;
+    LinkSession session;            /**< See @p controllerSimSecure().      */
+    ControllerSimStats stats;
+    uint32_t nextPoll;
+    uint32_t nextEvent;             /**< Number expected in the next event. */
+    /* Feedback commands due, oldest first. */
+    uint32_t dueAt[CONTROLLER_SIM_PENDING];
+    uint8_t uid[CONTROLLER_SIM_PENDING][ISO14443A_UID_MAX];
+    uint8_t uidlen[CONTROLLER_SIM_PENDING];
+    size_t pendHead;
+    size_t pendLen;
+} ControllerSimReader;
+
+struct controller_sim {
+    UartSim *uart;                  /**< Point-to-point line, or            */
+    BusSim *bus;                    /**< the bus.                           */
+    uint32_t turnaround;            /**< Event to feedback, microseconds.   */
+    uint32_t pollInterval;          /**< Status polls, microseconds, 0 for
+                                         none, see @p controllerSimPoll().  */
+    uint32_t slotTime;              /**< Bus: longest wait for the token
+                                         once the line is free, us.         */
+    uint32_t guard;                 /**< Bus: free line before passing the
+                                         token to the next reader, us.      */
+    ControllerSimStats stats;       /**< All readers.                       */
+    controllersimeventcb_t event;   /**< Optional.                          */
+    uint32_t drop;                  /**< Point-to-point: frames of the
+                                         reader to lose on the line, from
+                                         the bytes arriving next.           */
+    LinkRate rate;                  /**< Point-to-point: bit rate
+                                         negotiation, see
+                                         @p controllerSimNegotiate().       */
+    LinkRateConfig rateConfig;
+    PlatformTimer timer;
+    size_t readers;
+    size_t turn;                    /**< Bus: reader with the token.        */
+    bool waiting;                   /**< Bus: for the token to come back.   */
+    ControllerSimReader reader[CONTROLLER_SIM_READERS];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void controllerSimInit(ControllerSim *csp, UartSim *uart, uint8_t window,
+                         uint32_t retransmit);
+  void controllerSimInitBus(ControllerSim *csp, BusSim *bus, size_t readers,
+                            uint8_t window);
+  void controllerSimNegotiate(ControllerSim *csp, uint32_t base,
+                              const uint32_t *rates, size_t count);
+  void controllerSimSecure(ControllerSim *csp, const uint8_t *key);
+  void controllerSimRekey(ControllerSim *csp);
+  void controllerSimPoll(ControllerSim *csp, uint32_t pollInterval);
+  void controllerSimRestart(ControllerSim *csp);
+  void controllerSimStop(ControllerSim *csp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CONTROLLER_SIM_H_ */
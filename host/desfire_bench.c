@@ -0,0 +1,402 @@
+/**
+ * @file    desfire_bench.c
+ * @brief   Cost of the DESFire AES authentication.
+ * @details Checks AES-128 against FIPS-197 and NIST SP 800-38A and CMAC
+ *          against RFC 4493, then times a key expansion, the encryption and
+ *          decryption of a block and a one block CMAC in cycles of the
+ *          build machine, see @p platformCycles(): the median of @p RUNS
+ *          runs. On the reader @p DesfireStats counts the cycles.
+ *
+ *          Then a card from @p desfire_sim.h rests on the reader. Each tap
+ *          activates it, selects the application, authenticates and reads
+ *          @p READ_SIZE bytes with a MAC. The bench reports the RF time of
+ *          each step, which is what the authentication adds to a tap, and
+ *          the AES blocks and cycles the reader spent on it.
+ *
+ *          The bench fails on a wrong test vector, if a tap fails without
+ *          RF errors, if data read is wrong, or if a wrong key or MAC is
+ *          not detected.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "drivers/mfrc522.h"
+#include "rfid/desfire.h"
+#include "rfid/isodep.h"
+#include "desfire_sim.h"
+#include "mfrc522_sim_hw.h"
+#include "vclock.h"
+
+#define RUNS                        10001
+#define TAPS                        200
+#define READ_SIZE                   16
+#define KEYNO                       1
+
+/* The reader waits this long after switching the field on. */
+#define FIELD_GUARD_US              5000
+
+typedef struct {
+    const char *name;
+    uint8_t bitrate;
+    uint16_t faultPermille;
+    bool wrongKey;
+    bool corruptMac;
+} Scenario;
+
+static const Scenario scenarios[] = {
+    {"106 kbit/s", MFRC522_BITRATE_106, 0, false, false},
+    {"848 kbit/s", MFRC522_BITRATE_848, 0, false, false},
+    {"848 kbit/s, 2% CRC errors", MFRC522_BITRATE_848, 20, false, false},
+    {"848 kbit/s, wrong key", MFRC522_BITRATE_848, 0, true, false},
+    {"848 kbit/s, forged MAC", MFRC522_BITRATE_848, 0, false, true},
+};
+
+static const uint8_t uid[] = {0x04, 0x51, 0x7A, 0x92, 0x3C, 0x5D, 0x80};
+static const uint8_t aid[DESFIRE_AID_SIZE] = {0x44, 0x4C, 0x01};
+
+static MFRC522Sim chip;
+static MFRC522SimBus bus = {&chip, {0, 0, 0, 0}};
+static MFRC522Driver rfid;
+
+static const MFRC522Config config = {
+    &mfrc522SimTransport,
+    &bus
+};
+
+static PiccSim card;
+static DesfireSim app;
+static IsoDep isodep;
+static Desfire desfire;
+static bool failed;
+
+/*===========================================================================*/
+/* Test vectors.                                                             */
+/*===========================================================================*/
+
+static bool check(const char *name, const uint8_t *got, const uint8_t *want,
+                  size_t len) {
+    if (memcmp(got, want, len) != 0) {
+        fprintf(stderr, "desfire-bench: %s does not match\n", name);
+        failed = true;
+        return false;
+    }
+    return true;
+}
+
+static void known_answers(void) {
+    /* FIPS-197 C.1. */
+    static const uint8_t fipsPlain[] = {
+        0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB,
+        0xCC, 0xDD, 0xEE, 0xFF
+    };
+    static const uint8_t fipsCipher[] = {
+        0x69, 0xC4, 0xE0, 0xD8, 0x6A, 0x7B, 0x04, 0x30, 0xD8, 0xCD, 0xB7, 0x80,
+        0x70, 0xB4, 0xC5, 0x5A
+    };
+    /* SP 800-38A F.1.1, F.2.1 and RFC 4493 share key and plaintext. */
+    static const uint8_t key[] = {
+        0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88,
+        0x09, 0xCF, 0x4F, 0x3C
+    };
+    static const uint8_t plain[] = {
+        0x6B, 0xC1, 0xBE, 0xE2, 0x2E, 0x40, 0x9F, 0x96, 0xE9, 0x3D, 0x7E, 0x11,
+        0x73, 0x93, 0x17, 0x2A, 0xAE, 0x2D, 0x8A, 0x57, 0x1E, 0x03, 0xAC, 0x9C,
+        0x9E, 0xB7, 0x6F, 0xAC, 0x45, 0xAF, 0x8E, 0x51, 0x30, 0xC8, 0x1C, 0x46,
+        0xA3, 0x5C, 0xE4, 0x11, 0xE5, 0xFB, 0xC1, 0x19, 0x1A, 0x0A, 0x52, 0xEF,
+        0xF6, 0x9F, 0x24, 0x45, 0xDF, 0x4F, 0x9B, 0x17, 0xAD, 0x2B, 0x41, 0x7B,
+        0xE6, 0x6C, 0x37, 0x10
+    };
+    static const uint8_t ecb[] = {
+        0x3A, 0xD7, 0x7B, 0xB4, 0x0D, 0x7A, 0x36, 0x60, 0xA8, 0x9E, 0xCA, 0xF3,
+        0x24, 0x66, 0xEF, 0x97, 0xF5, 0xD3, 0xD5, 0x85, 0x03, 0xB9, 0x69, 0x9D,
+        0xE7, 0x85, 0x89, 0x5A, 0x96, 0xFD, 0xBA, 0xAF, 0x43, 0xB1, 0xCD, 0x7F,
+        0x59, 0x8E, 0xCE, 0x23, 0x88, 0x1B, 0x00, 0xE3, 0xED, 0x03, 0x06, 0x88,
+        0x7B, 0x0C, 0x78, 0x5E, 0x27, 0xE8, 0xAD, 0x3F, 0x82, 0x23, 0x20, 0x71,
+        0x04, 0x72, 0x5D, 0xD4
+    };
+    static const uint8_t cbc[] = {
+        0x76, 0x49, 0xAB, 0xAC, 0x81, 0x19, 0xB2, 0x46, 0xCE, 0xE9, 0x8E, 0x9B,
+        0x12, 0xE9, 0x19, 0x7D, 0x50, 0x86, 0xCB, 0x9B, 0x50, 0x72, 0x19, 0xEE,
+        0x95, 0xDB, 0x11, 0x3A, 0x91, 0x76, 0x78, 0xB2, 0x73, 0xBE, 0xD6, 0xB8,
+        0xE3, 0xC1, 0x74, 0x3B, 0x71, 0x16, 0xE6, 0x9E, 0x22, 0x22, 0x95, 0x16,
+        0x3F, 0xF1, 0xCA, 0xA1, 0x68, 0x1F, 0xAC, 0x09, 0x12, 0x0E, 0xCA, 0x30,
+        0x75, 0x86, 0xE1, 0xA7
+    };
+    static const uint8_t k1[] = {
+        0xFB, 0xEE, 0xD6, 0x18, 0x35, 0x71, 0x33, 0x66, 0x7C, 0x85, 0xE0, 0x8F,
+        0x72, 0x36, 0xA8, 0xDE
+    };
+    static const uint8_t k2[] = {
+        0xF7, 0xDD, 0xAC, 0x30, 0x6A, 0xE2, 0x66, 0xCC, 0xF9, 0x0B, 0xC1, 0x1E,
+        0xE4, 0x6D, 0x51, 0x3B
+    };
+    static const struct {
+        size_t len;
+        uint8_t mac[CMAC_SIZE];
+    } macs[] = {
+        {0, {0xBB, 0x1D, 0x69, 0x29, 0xE9, 0x59, 0x37, 0x28, 0x7F, 0xA3, 0x7D,
+             0x12, 0x9B, 0x75, 0x67, 0x46}},
+        {16, {0x07, 0x0A, 0x16, 0xB4, 0x6B, 0x4D, 0x41, 0x44, 0xF7, 0x9B, 0xDD,
+              0x9D, 0xD0, 0x4A, 0x28, 0x7C}},
+        {40, {0xDF, 0xA6, 0x67, 0x47, 0xDE, 0x9A, 0xE6, 0x30, 0x30, 0xCA, 0x32,
+              0x61, 0x14, 0x97, 0xC8, 0x27}},
+        {64, {0x51, 0xF0, 0xBE, 0xBF, 0x7E, 0x3B, 0x9D, 0x92, 0xFC, 0x49, 0x74,
+              0x17, 0x79, 0x36, 0x3C, 0xFE}},
+    };
+    uint8_t seq[AES_KEY_SIZE];
+    uint8_t out[sizeof(plain)];
+    uint8_t iv[AES_BLOCK_SIZE];
+    uint8_t mac[CMAC_SIZE];
+    AesKey aes;
+    CmacKey cmacKey;
+    Cmac cmac;
+    size_t i;
+
+    for (i = 0; i < sizeof(seq); i++) {
+        seq[i] = (uint8_t)i;
+    }
+    aesInit(&aes, seq);
+    aesEncrypt(&aes, fipsPlain, out);
+    check("FIPS-197 encryption", out, fipsCipher, sizeof(fipsCipher));
+    aesDecrypt(&aes, out, out);
+    check("FIPS-197 decryption", out, fipsPlain, sizeof(fipsPlain));
+
+    aesInit(&aes, key);
+    for (i = 0; i < sizeof(plain); i += AES_BLOCK_SIZE) {
+        aesEncrypt(&aes, &plain[i], &out[i]);
+    }
+    check("ECB encryption", out, ecb, sizeof(ecb));
+    for (i = 0; i < sizeof(plain); i += AES_BLOCK_SIZE) {
+        aesDecrypt(&aes, &ecb[i], &out[i]);
+    }
+    check("ECB decryption", out, plain, sizeof(plain));
+    for (i = 0; i < sizeof(iv); i++) {
+        iv[i] = (uint8_t)i;
+    }
+    aesCbcEncrypt(&aes, iv, plain, out, sizeof(plain));
+    check("CBC encryption", out, cbc, sizeof(cbc));
+    for (i = 0; i < sizeof(iv); i++) {
+        iv[i] = (uint8_t)i;
+    }
+    aesCbcDecrypt(&aes, iv, out, out, sizeof(out));
+    check("CBC decryption", out, plain, sizeof(plain));
+
+    cmacKeyInit(&cmacKey, key);
+    check("CMAC K1", cmacKey.k1, k1, sizeof(k1));
+    check("CMAC K2", cmacKey.k2, k2, sizeof(k2));
+    for (i = 0; i < sizeof(macs) / sizeof(macs[0]); i++) {
+        size_t split = macs[i].len / 3;
+
+        /* In two pieces, across a block boundary where there is one. */
+        cmacInit(&cmac, &cmacKey, NULL);
+        cmacUpdate(&cmac, plain, split);
+        cmacUpdate(&cmac, &plain[split], macs[i].len - split);
+        cmacFinish(&cmac, mac);
+        check("CMAC", mac, macs[i].mac, sizeof(mac));
+    }
+    printf("test vectors: %s\n", failed ? "FAILED" : "ok");
+}
+
+/*===========================================================================*/
+/* Cycles.                                                                   */
+/*===========================================================================*/
+
+static uint32_t samples[RUNS];
+
+static int compare(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static uint32_t median(void) {
+    qsort(samples, RUNS, sizeof(samples[0]), compare);
+    return samples[RUNS / 2];
+}
+
+static void cycles(void) {
+    uint8_t block[AES_BLOCK_SIZE] = {0};
+    uint8_t key[AES_KEY_SIZE] = {0};
+    CmacKey cmacKey;
+    Cmac cmac;
+    size_t i;
+
+    printf("cycles of the build machine, median of %u runs:\n", RUNS);
+    for (i = 0; i < RUNS; i++) {
+        uint32_t start = platformCycles();
+
+        key[0] = (uint8_t)i;
+        aesInit(&cmacKey.aes, key);
+        samples[i] = platformElapsedCycles(start);
+    }
+    printf("  key expansion                  %6u\n", (unsigned)median());
+    for (i = 0; i < RUNS; i++) {
+        uint32_t start = platformCycles();
+
+        aesEncrypt(&cmacKey.aes, block, block);
+        samples[i] = platformElapsedCycles(start);
+    }
+    printf("  encryption (16 B)              %6u\n", (unsigned)median());
+    for (i = 0; i < RUNS; i++) {
+        uint32_t start = platformCycles();
+
+        aesDecrypt(&cmacKey.aes, block, block);
+        samples[i] = platformElapsedCycles(start);
+    }
+    printf("  decryption (16 B)              %6u\n", (unsigned)median());
+    cmacKeyInit(&cmacKey, key);
+    for (i = 0; i < RUNS; i++) {
+        uint32_t start = platformCycles();
+
+        cmacInit(&cmac, &cmacKey, block);
+        cmacUpdate(&cmac, block, sizeof(block));
+        cmacFinish(&cmac, block);
+        samples[i] = platformElapsedCycles(start);
+    }
+    printf("  CMAC (16 B)                    %6u\n", (unsigned)median());
+}
+
+/*===========================================================================*/
+/* Taps.                                                                     */
+/*===========================================================================*/
+
+static void reset_field(void) {
+    mfrc522SetField(&rfid, false);
+    platformDelayUs(ISO14443A_RESET_US);
+    mfrc522SetField(&rfid, true);
+    platformDelayUs(FIELD_GUARD_US);
+}
+
+static mfrc522result_t activate(const Scenario *s) {
+    Iso14443aCard found;
+    mfrc522result_t result;
+
+    result = iso14443aActivate(&rfid, &found);
+    if (result == MFRC522_OK) {
+        result = isoDepActivate(&isodep, &rfid, ISODEP_FSDI, s->bitrate);
+    }
+    return result;
+}
+
+static void run_scenario(const Scenario *s) {
+    /* Activation, select, authentication, read. */
+    uint64_t spent[4] = {0, 0, 0, 0};
+    uint8_t key[DESFIRE_KEY_SIZE];
+    uint8_t rnda[DESFIRE_RANDOM_SIZE];
+    uint8_t command[7] = {0x00, 0, 0, 0, READ_SIZE, 0, 0};
+    uint8_t data[READ_SIZE];
+    unsigned tap, done = 0, rejected = 0, errors = 0;
+    uint64_t blocks = 0, cycles = 0;
+    size_t i;
+
+    mfrc522SimInit(&chip, NULL);
+    mfrc522ObjectInit(&rfid);
+    if (mfrc522Start(&rfid, &config) != MFRC522_OK) {
+        fprintf(stderr, "desfire-bench: chip did not start\n");
+        exit(EXIT_FAILURE);
+    }
+    piccSimInit(&card, uid, sizeof(uid), 0x20);
+    desfireSimInit(&app, &card);
+    app.corruptMac = s->corruptMac;
+    card.arriveNs = vclockNow();
+    card.faultPermille = s->faultPermille;
+    card.randomFault = PICC_SIM_FAULT_CRC;
+    mfrc522SimAddCard(&chip, &card);
+    memcpy(key, app.keys[KEYNO], sizeof(key));
+    if (s->wrongKey) {
+        key[0] ^= 0x01;
+    }
+
+    for (tap = 0; tap < TAPS; tap++) {
+        uint64_t at[5];
+        mfrc522result_t result;
+        size_t rlen;
+
+        for (i = 0; i < sizeof(rnda); i++) {
+            rnda[i] = (uint8_t)(tap * 31 + i);
+        }
+        /* The activation is timed from the first frame. */
+        reset_field();
+        at[0] = vclockNow();
+        result = activate(s);
+        if (result != MFRC522_OK) {
+            errors++;
+            continue;
+        }
+        desfireInit(&desfire, &isodep);
+        at[1] = vclockNow();
+        result = desfireSelectApplication(&desfire, aid);
+        at[2] = vclockNow();
+        if (result == MFRC522_OK) {
+            result = desfireAuthenticate(&desfire, KEYNO, key, rnda);
+        }
+        at[3] = vclockNow();
+        if (result == MFRC522_OK) {
+            result = desfireCommand(&desfire, DESFIRE_CMD_READ_DATA, command,
+                                    sizeof(command), data, sizeof(data),
+                                    &rlen);
+            if (result == MFRC522_OK &&
+                (rlen != READ_SIZE || memcmp(data, app.file, READ_SIZE) != 0)) {
+                failed = true;
+            }
+        }
+        at[4] = vclockNow();
+        isoDepDeselect(&isodep);
+        blocks += desfire.stats.blocks;
+        cycles += desfire.stats.cycles;
+
+        if (result == MFRC522_AUTH_ERROR) {
+            rejected++;
+        } else if (result != MFRC522_OK) {
+            errors++;
+        } else {
+            for (i = 0; i < 4; i++) {
+                spent[i] += at[i + 1] - at[i];
+            }
+            done++;
+        }
+    }
+    mfrc522SimRemoveCard(&chip, &card);
+
+    printf("%s:\n", s->name);
+    if (done > 0) {
+        printf("  activation       %8.2f ms\n", spent[0] / 1e6 / done);
+        printf("  select           %8.2f ms\n", spent[1] / 1e6 / done);
+        printf("  authentication   %8.2f ms\n", spent[2] / 1e6 / done);
+        printf("  MACed read       %8.2f ms\n", spent[3] / 1e6 / done);
+    }
+    printf("  AES blocks       %8.1f per tap\n", (double)blocks / TAPS);
+    printf("  crypto cycles    %8.0f per tap\n", (double)cycles / TAPS);
+    printf("  taps             %8u ok, %u rejected, %u RF errors\n", done,
+           rejected, errors);
+
+    if (s->wrongKey || s->corruptMac) {
+        /* Every tap not lost to an RF error must be caught. */
+        if (done != 0 || rejected + errors != TAPS) {
+            failed = true;
+        }
+    } else if (rejected != 0 || (errors > 0 && s->faultPermille == 0)) {
+        failed = true;
+    }
+}
+
+int main(void) {
+    size_t i;
+
+    printf("desfire-bench (%s AES-128, %u taps of SELECT APPLICATION, "
+           "AES authentication, READ DATA %u B)\n",
+           AES_BITSLICED ? "bitsliced" : "T-table", TAPS, READ_SIZE);
+    known_answers();
+    cycles();
+    for (i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        run_scenario(&scenarios[i]);
+    }
+    if (failed) {
+        fprintf(stderr, "desfire-bench: wrong test vector, data or tap\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
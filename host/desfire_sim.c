@@ -0,0 +1,186 @@
+/**
+ * @file    desfire_sim.c
+ * @brief   MIFARE DESFire EV1 application for the ISO-DEP card model.
+ */
+
+#include <string.h>
+
+#include "desfire_sim.h"
+
+#define SW1_NATIVE                  0x91
+#define ILLEGAL_COMMAND             0x1C
+#define BOUNDARY_ERROR              0xBE
+
+static size_t status(uint8_t *response, size_t len, uint8_t code) {
+    response[len] = SW1_NATIVE;
+    response[len + 1] = code;
+    return len + 2;
+}
+
+static uint32_t get24(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16;
+}
+
+/**
+ * @brief   Runs @p a and @p b through the CMAC chain of the session.
+ */
+static void chain(DesfireSim *sim, const uint8_t *a, size_t alen,
+                  const uint8_t *b, size_t blen) {
+    Cmac cmac;
+
+    cmacInit(&cmac, &sim->session, sim->iv);
+    cmacUpdate(&cmac, a, alen);
+    cmacUpdate(&cmac, b, blen);
+    cmacFinish(&cmac, sim->iv);
+}
+
+static size_t authenticate(DesfireSim *sim, const uint8_t *data, size_t len,
+                           uint8_t *response) {
+    size_t i;
+
+    if (len != 1 || data[0] >= DESFIRE_SIM_KEYS) {
+        return status(response, 0, DESFIRE_LENGTH_ERROR);
+    }
+    for (i = 0; i < DESFIRE_RANDOM_SIZE; i++) {
+        sim->seed = sim->seed * 1103515245 + 12345;
+        sim->rndb[i] = (uint8_t)(sim->seed >> 16);
+    }
+    aesInit(&sim->key, sim->keys[data[0]]);
+    memset(sim->iv, 0, sizeof(sim->iv));
+    aesCbcEncrypt(&sim->key, sim->iv, sim->rndb, response,
+                  DESFIRE_RANDOM_SIZE);
+    sim->authenticating = true;
+    return status(response, DESFIRE_RANDOM_SIZE, DESFIRE_ADDITIONAL_FRAME);
+}
+
+static size_t authenticate_reader(DesfireSim *sim, const uint8_t *data,
+                                  size_t len, uint8_t *response) {
+    uint8_t msg[2 * DESFIRE_RANDOM_SIZE];
+    uint8_t key[DESFIRE_KEY_SIZE];
+
+    sim->authenticating = false;
+    if (len != sizeof(msg)) {
+        return status(response, 0, DESFIRE_LENGTH_ERROR);
+    }
+    aesCbcDecrypt(&sim->key, sim->iv, data, msg, sizeof(msg));
+    if (memcmp(&msg[DESFIRE_RANDOM_SIZE], &sim->rndb[1],
+               DESFIRE_RANDOM_SIZE - 1) != 0 ||
+        msg[sizeof(msg) - 1] != sim->rndb[0]) {
+        sim->stats.rejected++;
+        return status(response, 0, DESFIRE_AUTHENTICATION_ERROR);
+    }
+
+    /* RndA rotated. */
+    memcpy(response, &msg[1], DESFIRE_RANDOM_SIZE - 1);
+    response[DESFIRE_RANDOM_SIZE - 1] = msg[0];
+    aesCbcEncrypt(&sim->key, sim->iv, response, response,
+                  DESFIRE_RANDOM_SIZE);
+
+    memcpy(&key[0], &msg[0], 4);
+    memcpy(&key[4], &sim->rndb[0], 4);
+    memcpy(&key[8], &msg[12], 4);
+    memcpy(&key[12], &sim->rndb[12], 4);
+    cmacKeyInit(&sim->session, key);
+    memset(sim->iv, 0, sizeof(sim->iv));
+    sim->authenticated = true;
+    sim->stats.authentications++;
+    return status(response, DESFIRE_RANDOM_SIZE, DESFIRE_OPERATION_OK);
+}
+
+static size_t read_data(DesfireSim *sim, uint8_t cmd, const uint8_t *data,
+                        size_t len, uint8_t *response) {
+    static const uint8_t ok = DESFIRE_OPERATION_OK;
+    uint32_t offset, n;
+
+    if (!sim->authenticated) {
+        return status(response, 0, DESFIRE_PERMISSION_DENIED);
+    }
+    if (len != 7) {
+        return status(response, 0, DESFIRE_LENGTH_ERROR);
+    }
+    chain(sim, &cmd, 1, data, len);
+    offset = get24(&data[1]);
+    n = get24(&data[4]);
+    if (offset + n > DESFIRE_SIM_FILE_SIZE) {
+        return status(response, 0, BOUNDARY_ERROR);
+    }
+    sim->stats.reads++;
+    memcpy(response, &sim->file[offset], n);
+    chain(sim, response, n, &ok, 1);
+    memcpy(&response[n], sim->iv, DESFIRE_MAC_SIZE);
+    if (sim->corruptMac) {
+        response[n] ^= 0x01;
+    }
+    return status(response, n + DESFIRE_MAC_SIZE, DESFIRE_OPERATION_OK);
+}
+
+static size_t execute(void *arg, const uint8_t *apdu, size_t len,
+                      uint8_t *response) {
+    DesfireSim *sim = arg;
+    const uint8_t *data = &apdu[5];
+    size_t datalen = len > 5 ? apdu[4] : 0;
+    bool authenticating = sim->authenticating;
+    size_t rlen;
+
+    if (sim->rats != sim->iso.stats.rats) {
+        sim->rats = sim->iso.stats.rats;
+        sim->authenticated = false;
+        authenticating = false;
+    }
+    sim->authenticating = false;
+    if (apdu[0] != 0x90 || len < 5 || (len > 5 && len != 6 + datalen)) {
+        sim->authenticated = false;
+        return status(response, 0, DESFIRE_LENGTH_ERROR);
+    }
+
+    switch (apdu[1]) {
+    case DESFIRE_CMD_SELECT_APPLICATION:
+        sim->authenticated = false;
+        rlen = status(response, 0, datalen == DESFIRE_AID_SIZE
+                                       ? DESFIRE_OPERATION_OK
+                                       : DESFIRE_LENGTH_ERROR);
+        break;
+    case DESFIRE_CMD_AUTHENTICATE_AES:
+        sim->authenticated = false;
+        rlen = authenticate(sim, data, datalen, response);
+        break;
+    case DESFIRE_CMD_ADDITIONAL_FRAME:
+        rlen = authenticating
+                   ? authenticate_reader(sim, data, datalen, response)
+                   : status(response, 0, ILLEGAL_COMMAND);
+        break;
+    case DESFIRE_CMD_READ_DATA:
+        rlen = read_data(sim, apdu[1], data, datalen, response);
+        break;
+    default:
+        rlen = status(response, 0, ILLEGAL_COMMAND);
+        break;
+    }
+    /* An error ends the session. */
+    if (response[rlen - 1] != DESFIRE_OPERATION_OK &&
+        response[rlen - 1] != DESFIRE_ADDITIONAL_FRAME) {
+        sim->authenticated = false;
+    }
+    return rlen;
+}
+
+/**
+ * @brief   Makes @p card a DESFire EV1 card.
+ * @details Key n is 16 bytes of n, the file holds a counting pattern.
+ *          Call after piccSimInit().
+ */
+void desfireSimInit(DesfireSim *sim, PiccSim *card) {
+    size_t i;
+
+    memset(sim, 0, sizeof(*sim));
+    isoDepSimInit(&sim->iso, card);
+    for (i = 0; i < DESFIRE_SIM_KEYS; i++) {
+        memset(sim->keys[i], (int)i, DESFIRE_KEY_SIZE);
+    }
+    for (i = 0; i < DESFIRE_SIM_FILE_SIZE; i++) {
+        sim->file[i] = (uint8_t)(0xA0 + i);
+    }
+    sim->seed = 1;
+    sim->iso.apdu = execute;
+    sim->iso.apduArg = sim;
+}
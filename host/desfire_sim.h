@@ -0,0 +1,53 @@
+/**
+ * @file    desfire_sim.h
+ * @brief   MIFARE DESFire EV1 application for the ISO-DEP card model.
+ * @details Answers the native commands wrapped in APDUs that
+ *          @p rfid/desfire.h sends: SELECT APPLICATION of any
+ *          application, the AES authentication with one of
+ *          @p DESFIRE_SIM_KEYS keys and READ DATA of one file in MACed
+ *          communication, which needs a session.
+ */
+
+#ifndef _DESFIRE_SIM_H_
+#define _DESFIRE_SIM_H_
+
+#include "rfid/desfire.h"
+#include "isodep_sim.h"
+
+#define DESFIRE_SIM_KEYS            4
+#define DESFIRE_SIM_FILE_SIZE       32
+
+typedef struct {
+    uint32_t authentications;
+    uint32_t rejected;              /**< Authentications with a wrong key.  */
+    uint32_t reads;
+} DesfireSimStats;
+
+typedef struct {
+    IsoDepSim iso;
+    /* Configuration, see desfireSimInit(). */
+    uint8_t keys[DESFIRE_SIM_KEYS][DESFIRE_KEY_SIZE];
+    uint8_t file[DESFIRE_SIM_FILE_SIZE];
+    bool corruptMac;                /**< Flips a bit of every MAC sent.     */
+    uint32_t seed;                  /**< Of RndB.                           */
+    DesfireSimStats stats;
+
+    /* State. */
+    uint32_t rats;                  /**< A new RATS ends the session.       */
+    bool authenticating;
+    bool authenticated;
+    AesKey key;
+    uint8_t rndb[DESFIRE_RANDOM_SIZE];
+    uint8_t iv[AES_BLOCK_SIZE];
+    CmacKey session;
+} DesfireSim;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void desfireSimInit(DesfireSim *sim, PiccSim *card);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DESFIRE_SIM_H_ */
@@ -0,0 +1,285 @@
+/**
+ * @file    feedback_bench.c
+ * @brief   Speculative feedback against waiting for the controller.
+ * @details A door of @p CARDS cards, most of them on the controller's list,
+ *          sees @p TAPS taps @p TAP_GAP_MIN_US to @p TAP_GAP_MAX_US apart,
+ *          some of them a second tap of the same card before the answer.
+ *          The controller answers each after the link round trip and its
+ *          own decision time, and loses a few answers. The reader's list
+ *          is behind the controller's on a share of the cards, the churn
+ *          not yet synced.
+ *
+ *          The reader guesses from its list at once and reconciles with
+ *          each feedback under every correction policy of
+ *          @p reader/feedback.h. Every run reports the share of right
+ *          guesses, the wrong ones by kind, the corrections, the wait for
+ *          the controller saved and the time wrong guesses showed, per tap,
+ *          against the wait of a reader without speculation.
+ *
+ *          Fails if a feedback is not reconciled as its policy says, a wrong
+ *          decision stays shown where the policy corrects it, or the
+ *          counters do not add up.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "reader/feedback.h"
+#include "vclock.h"
+
+#define CARDS                       2000
+#define TAPS                        20000
+#define ON_LIST_PERCENT             85
+
+#define TAP_GAP_MIN_US              50000
+#define TAP_GAP_MAX_US              3000000
+#define RETAP_PERCENT               5
+#define RETAP_MAX_US                400000
+
+/* Event and feedback frames at 115200 bit/s with the turnarounds, then the
+   controller looking the card up in its database. */
+#define LINK_US                     3000
+#define DECIDE_MIN_US               5000
+#define DECIDE_MAX_US               200000
+#define LOST_PER_MILLE              5
+
+#define ANSWERS_MAX                 64
+
+typedef struct {
+    uint32_t due;
+    uint32_t latency;
+    uint32_t tap;
+} Answer;
+
+static const unsigned stale[] = {0, 10, 50};
+
+static const struct {
+    readerfeedbackcorrection_t correction;
+    const char *name;
+} policies[] = {
+    {READER_FEEDBACK_KEEP, "keep"},
+    {READER_FEEDBACK_REVOKE, "revoke"},
+    {READER_FEEDBACK_FOLLOW, "follow"},
+};
+
+static ReaderFeedback feedback;
+static Iso14443aCard cards[CARDS];
+static bool controllerList[CARDS];
+static bool readerList[CARDS];
+static uint32_t tapCard[TAPS];
+static bool shown[TAPS];
+static Answer answers[ANSWERS_MAX];
+static size_t answerCount;
+static uint32_t now;
+static uint64_t expectedSavedUs;
+static uint32_t late;
+static uint64_t waitUs;
+static uint32_t waited;
+static uint32_t seed;
+static bool failed;
+
+static uint32_t random_below(uint32_t n) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % n;
+}
+
+static void advance_to(uint32_t at) {
+    vclockAdvance((uint64_t)(at - now) * 1000U);
+    now = at;
+}
+
+/**
+ * @brief   Hands the feedback on tap @p a to the reader.
+ */
+static void deliver(const Answer *a) {
+    uint32_t card = tapCard[a->tap];
+    bool granted = controllerList[card];
+    bool guess = readerList[card];
+    readerfeedbackcorrection_t correction = feedback.correction;
+    readerfeedbackresult_t expected, result;
+    uint8_t payload[2 + ISO14443A_UID_MAX];
+    Iso14443aCard decoded;
+    bool decision;
+
+    advance_to(a->due);
+    payload[0] = cards[card].uidlen;
+    memcpy(&payload[1], cards[card].uid, cards[card].uidlen);
+    payload[1 + cards[card].uidlen] = granted ? READER_FEEDBACK_GRANTED : 0;
+    if (!readerFeedbackDecode(payload, 2 + cards[card].uidlen, &decoded,
+                              &decision) ||
+        decision != granted) {
+        failed = true;
+        return;
+    }
+
+    if (guess == granted) {
+        expected = READER_FEEDBACK_AGREED;
+    } else if (correction == READER_FEEDBACK_FOLLOW ||
+               (correction == READER_FEEDBACK_REVOKE && !granted)) {
+        expected = READER_FEEDBACK_CORRECT;
+    } else {
+        expected = READER_FEEDBACK_KEPT;
+    }
+    result = readerFeedbackConfirm(&feedback, &decoded, decision);
+    if (result == READER_FEEDBACK_SHOW) {
+        /* The guess was dropped. */
+        late++;
+    } else if (result != expected) {
+        failed = true;
+    }
+    /* An answer lost leaves a guess on the card the next answer on it is
+       taken for, saving more than its latency. */
+    if (result == READER_FEEDBACK_AGREED) {
+        expectedSavedUs += a->latency;
+    }
+    if (result == READER_FEEDBACK_SHOW || result == READER_FEEDBACK_CORRECT) {
+        shown[a->tap] = granted;
+    }
+    waitUs += a->latency;
+    waited++;
+}
+
+/**
+ * @brief   Delivers the answers due by @p until, in order.
+ */
+static void deliver_until(uint32_t until) {
+    while (answerCount > 0) {
+        size_t first = 0, i;
+        Answer a;
+
+        for (i = 1; i < answerCount; i++) {
+            if (answers[i].due - now < answers[first].due - now) {
+                first = i;
+            }
+        }
+        if (answers[first].due - now > until - now) {
+            return;
+        }
+        a = answers[first];
+        answers[first] = answers[--answerCount];
+        deliver(&a);
+    }
+}
+
+static void run(unsigned perMille, size_t p) {
+    const ReaderFeedbackStats *stats = &feedback.stats;
+    uint32_t wrongShown = 0, answered = 0;
+    uint32_t at = now;
+    bool answeredTap[TAPS];
+    size_t i;
+
+    seed = 1;
+    for (i = 0; i < CARDS; i++) {
+        readerList[i] = controllerList[i];
+        if (random_below(1000) < perMille) {
+            readerList[i] = !readerList[i];
+        }
+    }
+    readerFeedbackInit(&feedback, policies[p].correction);
+    expectedSavedUs = 0;
+    late = 0;
+    waitUs = 0;
+    waited = 0;
+
+    for (i = 0; i < TAPS; i++) {
+        uint32_t latency = LINK_US + DECIDE_MIN_US +
+                           random_below(DECIDE_MAX_US - DECIDE_MIN_US);
+
+        if (i > 0 && random_below(100) < RETAP_PERCENT) {
+            tapCard[i] = tapCard[i - 1];
+            at += 1 + random_below(RETAP_MAX_US);
+        } else {
+            tapCard[i] = random_below(CARDS);
+            at += TAP_GAP_MIN_US +
+                  random_below(TAP_GAP_MAX_US - TAP_GAP_MIN_US);
+        }
+        deliver_until(at);
+        advance_to(at);
+
+        shown[i] = readerList[tapCard[i]];
+        readerFeedbackGuess(&feedback, &cards[tapCard[i]], shown[i]);
+        answeredTap[i] = random_below(1000) >= LOST_PER_MILLE;
+        if (answeredTap[i] && answerCount < ANSWERS_MAX) {
+            Answer *a = &answers[answerCount++];
+
+            a->due = at + latency;
+            a->latency = latency;
+            a->tap = (uint32_t)i;
+        } else {
+            answeredTap[i] = false;
+        }
+    }
+    deliver_until(at + READER_FEEDBACK_TIMEOUT_US);
+    advance_to(at + READER_FEEDBACK_TIMEOUT_US);
+
+    for (i = 0; i < TAPS; i++) {
+        bool granted = controllerList[tapCard[i]];
+
+        if (!answeredTap[i]) {
+            continue;
+        }
+        answered++;
+        if (shown[i] != granted) {
+            wrongShown++;
+            if (policies[p].correction == READER_FEEDBACK_FOLLOW ||
+                (policies[p].correction == READER_FEEDBACK_REVOKE &&
+                 shown[i])) {
+                failed = true;
+            }
+        }
+    }
+    if (stats->guesses != TAPS ||
+        stats->right + stats->falseGrants + stats->falseDenies + late !=
+            answered ||
+        stats->savedUs < expectedSavedUs ||
+        stats->savedUs > expectedSavedUs + (uint64_t)stats->unanswered *
+                                               READER_FEEDBACK_TIMEOUT_US ||
+        late > stats->unanswered ||
+        stats->unexpected != late) {
+        failed = true;
+    }
+
+    printf("  %5.1f%% %7s %7.2f%% %6u %6u %9u %6u %10.1f %10.2f %8u\n",
+           perMille / 10.0, policies[p].name, 100.0 * stats->right / answered,
+           (unsigned)stats->falseGrants, (unsigned)stats->falseDenies,
+           (unsigned)stats->corrected, (unsigned)wrongShown,
+           (double)stats->savedUs / 1000.0 / TAPS,
+           (double)stats->wrongUs / 1000.0 / TAPS,
+           (unsigned)stats->unanswered);
+}
+
+int main(void) {
+    size_t s, p, i;
+
+    seed = 12345;
+    for (i = 0; i < CARDS; i++) {
+        cards[i].uidlen = 7;
+        cards[i].uid[0] = 0x04;
+        cards[i].uid[1] = (uint8_t)(i >> 8);
+        cards[i].uid[2] = (uint8_t)i;
+        cards[i].uid[3] = (uint8_t)random_below(256);
+        controllerList[i] = random_below(100) < ON_LIST_PERCENT;
+    }
+
+    printf("feedback-bench (%u taps on %u cards, controller answers in %u to "
+           "%u ms, %u per mille lost)\n", TAPS, CARDS,
+           (LINK_US + DECIDE_MIN_US) / 1000, (LINK_US + DECIDE_MAX_US) / 1000,
+           LOST_PER_MILLE);
+    printf("  %6s %7s %8s %6s %6s %9s %6s %10s %10s %8s\n", "stale", "policy",
+           "right", "false+", "false-", "corrected", "stays", "saved ms",
+           "wrong ms", "dropped");
+    for (s = 0; s < sizeof(stale) / sizeof(stale[0]); s++) {
+        for (p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+            run(stale[s], p);
+        }
+    }
+    printf("without speculation every tap waits %.1f ms for the controller\n",
+           (double)waitUs / 1000.0 / waited);
+    if (failed) {
+        fprintf(stderr, "feedback-bench: feedback not reconciled as the "
+                        "policy says\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file    flash_sim.c
+ * @brief   NOR flash of the STM32F0, for the access list store.
+ */
+
+#include <string.h>
+
+#include "flash_sim.h"
+
+/**
+ * @brief   Spends one unit of the cut budget.
+ *
+ * @return  @p false once power is lost.
+ */
+static bool spend(FlashSim *fp) {
+    if (fp->cut) {
+        return false;
+    }
+    if (fp->budget == 0) {
+        fp->cut = true;
+        return false;
+    }
+    if (fp->budget > 0) {
+        fp->budget--;
+    }
+    return true;
+}
+
+static bool erase(void *arg, size_t offset) {
+    FlashSim *fp = arg;
+    size_t keep;
+
+    if (offset % fp->pageSize != 0 || offset >= fp->size) {
+        return false;
+    }
+    if (fp->budget == 0 && !fp->cut) {
+        /* Cut short, the page erased from the start up to some point. */
+        fp->seed = fp->seed * 1103515245 + 12345;
+        keep = (fp->seed >> 8) % fp->pageSize;
+        memset(&fp->mem[offset], 0xFF, keep);
+    }
+    if (!spend(fp)) {
+        return false;
+    }
+    memset(&fp->mem[offset], 0xFF, fp->pageSize);
+    fp->erases++;
+    return true;
+}
+
+static bool program(void *arg, size_t offset, const void *data, size_t len) {
+    FlashSim *fp = arg;
+    const uint8_t *p = data;
+    size_t i;
+
+    if (offset % 2 != 0 || len % 2 != 0 || offset + len > fp->size) {
+        return false;
+    }
+    for (i = 0; i < len; i += 2) {
+        uint8_t *q = &fp->mem[offset + i];
+        uint16_t old = (uint16_t)(q[0] | q[1] << 8);
+        uint16_t value = (uint16_t)(p[i] | p[i + 1] << 8);
+
+        if (!spend(fp)) {
+            return false;
+        }
+        if (old != 0xFFFF && value != 0x0000) {
+            fp->violations++;
+            return false;
+        }
+        q[0] = p[i];
+        q[1] = p[i + 1];
+        fp->programs++;
+    }
+    return true;
+}
+
+/*===========================================================================*/
+/* Exported functions.                                                       */
+/*===========================================================================*/
+
+/**
+ * @brief   A flash of erased pages in @p mem, aligned on 4 bytes.
+ */
+void flashSimInit(FlashSim *fp, uint8_t *mem, size_t size, size_t pageSize) {
+    memset(fp, 0, sizeof(*fp));
+    fp->mem = mem;
+    fp->size = size;
+    fp->pageSize = pageSize;
+    fp->budget = -1;
+    fp->seed = 1;
+    memset(mem, 0xFF, size);
+}
+
+/**
+ * @brief   The region of the store over the whole flash.
+ */
+void flashSimConfig(FlashSim *fp, ReaderAclFlash *config) {
+    config->base = fp->mem;
+    config->size = fp->size;
+    config->pageSize = fp->pageSize;
+    config->erase = erase;
+    config->program = program;
+    config->arg = fp;
+}
+
+/**
+ * @brief   Loses power after @p budget more halfwords and erases, restores
+ *          it with a negative budget.
+ */
+void flashSimCutAfter(FlashSim *fp, long budget) {
+    fp->budget = budget;
+    fp->cut = false;
+}
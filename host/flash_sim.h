@@ -0,0 +1,41 @@
+/**
+ * @file    flash_sim.h
+ * @brief   NOR flash of the STM32F0, for the access list store.
+ * @details Pages erase to 0xFF and halfwords program as on the F0: a
+ *          halfword takes any value once after an erase, and 0x0000 at any
+ *          time; anything else fails and leaves the flash as it is. A cut
+ *          budget simulates losing power: once it is spent, the operation
+ *          under way stops where it is, a program after the last halfword
+ *          written and an erase with part of the page left, and every later
+ *          operation fails until the budget is reset.
+ */
+
+#ifndef _FLASH_SIM_H_
+#define _FLASH_SIM_H_
+
+#include "reader/aclstore.h"
+
+typedef struct {
+    uint8_t *mem;
+    size_t size;
+    size_t pageSize;
+    uint32_t erases;
+    uint32_t programs;              /**< Halfwords.                         */
+    uint32_t violations;            /**< Programs over unerased halfwords.  */
+    long budget;                    /**< Halfwords and erases left before
+                                         the cut, negative for none.        */
+    bool cut;
+    uint32_t seed;
+} FlashSim;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void flashSimInit(FlashSim *fp, uint8_t *mem, size_t size, size_t pageSize);
+  void flashSimConfig(FlashSim *fp, ReaderAclFlash *config);
+  void flashSimCutAfter(FlashSim *fp, long budget);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FLASH_SIM_H_ */
@@ -0,0 +1,226 @@
+/**
+ * @file    isodep_bench.c
+ * @brief   Chained APDU throughput of the ISO-DEP layer on the chip model.
+ * @details A card from @p isodep_sim.h rests on the reader. Each round
+ *          selects the application, reads 256 bytes of its file and writes
+ *          200 bytes back, so both the command and the response chains are
+ *          exercised. The scenarios compare the frame size and bit rate
+ *          negotiation and add RF errors and waiting time extensions.
+ *
+ *          Data read and written is checked against the card, the bench
+ *          fails if it differs or if an exchange fails without RF errors.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "drivers/mfrc522.h"
+#include "rfid/isodep.h"
+#include "isodep_sim.h"
+#include "mfrc522_sim_hw.h"
+#include "vclock.h"
+
+#define ROUNDS                      200
+
+/* The reader waits this long after switching the field on. */
+#define FIELD_GUARD_US              5000
+
+#define READ_SIZE                   256
+#define UPDATE_SIZE                 200
+
+typedef struct {
+    const char *name;
+    uint8_t fsdi;
+    uint8_t bitrate;
+    uint16_t faultPermille;
+    uint32_t wtxEvery;
+} Scenario;
+
+static const Scenario scenarios[] = {
+    {"106 kbit/s, FSD 16", 0, MFRC522_BITRATE_106, 0, 0},
+    {"106 kbit/s, FSD 64", 5, MFRC522_BITRATE_106, 0, 0},
+    {"212 kbit/s, FSD 64", 5, MFRC522_BITRATE_212, 0, 0},
+    {"424 kbit/s, FSD 64", 5, MFRC522_BITRATE_424, 0, 0},
+    {"848 kbit/s, FSD 64", 5, MFRC522_BITRATE_848, 0, 0},
+    {"848 kbit/s, 2% CRC errors", 5, MFRC522_BITRATE_848, 20, 0},
+    {"848 kbit/s, WTX per APDU", 5, MFRC522_BITRATE_848, 0, 1},
+};
+
+static const uint8_t uid[] = {0x04, 0x51, 0x7A, 0x92, 0x3C, 0x5D, 0x80};
+
+static const uint8_t select_aid[] = {0x00, 0xA4, 0x04, 0x00, 0x07, 0xF0,
+                                     0x44, 0x4C, 0x4F, 0x43, 0x4B, 0x01};
+
+static MFRC522Sim chip;
+static MFRC522SimBus bus = {&chip, {0, 0, 0, 0}};
+static MFRC522Driver rfid;
+
+static const MFRC522Config config = {
+    &mfrc522SimTransport,
+    &bus
+};
+
+static PiccSim card;
+static IsoDepSim app;
+static IsoDep isodep;
+static bool failed;
+
+/**
+ * @brief   Resets the card with the field and activates it.
+ */
+static mfrc522result_t activate(const Scenario *s) {
+    Iso14443aCard found;
+    mfrc522result_t result;
+
+    mfrc522SetField(&rfid, false);
+    platformDelayUs(ISO14443A_RESET_US);
+    mfrc522SetField(&rfid, true);
+    platformDelayUs(FIELD_GUARD_US);
+    result = iso14443aActivate(&rfid, &found);
+    if (result == MFRC522_OK) {
+        result = isoDepActivate(&isodep, &rfid, s->fsdi, s->bitrate);
+    }
+    return result;
+}
+
+static bool check_sw(const uint8_t *response, size_t len) {
+    return len >= 2 && response[len - 2] == 0x90 && response[len - 1] == 0x00;
+}
+
+/**
+ * @brief   Runs one round.
+ *
+ * @return  Payload bytes exchanged, 0 if an exchange failed.
+ */
+static size_t run_round(unsigned round) {
+    uint8_t command[5 + UPDATE_SIZE];
+    uint8_t response[READ_SIZE + 2];
+    size_t offset = (round * 16) % (ISODEP_SIM_FILE_SIZE - READ_SIZE);
+    size_t rlen, bytes = 0, i;
+
+    if (isoDepExchange(&isodep, select_aid, sizeof(select_aid), response,
+                       sizeof(response), &rlen) != MFRC522_OK) {
+        return 0;
+    }
+    if (!check_sw(response, rlen)) {
+        failed = true;
+    }
+    bytes += sizeof(select_aid) + rlen;
+
+    command[0] = 0x00;
+    command[1] = 0xB0;
+    command[2] = (uint8_t)(offset >> 8);
+    command[3] = (uint8_t)offset;
+    command[4] = 0x00;
+    if (isoDepExchange(&isodep, command, 5, response, sizeof(response),
+                       &rlen) != MFRC522_OK) {
+        return 0;
+    }
+    if (rlen != READ_SIZE + 2 || !check_sw(response, rlen) ||
+        memcmp(response, &app.file[offset], READ_SIZE) != 0) {
+        failed = true;
+    }
+    bytes += 5 + rlen;
+
+    command[1] = 0xD6;
+    command[4] = UPDATE_SIZE;
+    for (i = 0; i < UPDATE_SIZE; i++) {
+        command[5 + i] = (uint8_t)(round + i);
+    }
+    if (isoDepExchange(&isodep, command, sizeof(command), response,
+                       sizeof(response), &rlen) != MFRC522_OK) {
+        return 0;
+    }
+    if (!check_sw(response, rlen) ||
+        memcmp(&app.file[offset], &command[5], UPDATE_SIZE) != 0) {
+        failed = true;
+    }
+    return bytes + sizeof(command) + rlen;
+}
+
+static void add_stats(IsoDepStats *total, const IsoDepStats *stats) {
+    total->frames += stats->frames;
+    total->chained += stats->chained;
+    total->retransmissions += stats->retransmissions;
+    total->wtx += stats->wtx;
+}
+
+static void run_scenario(const Scenario *s) {
+    uint64_t start, elapsed, activation;
+    uint64_t bytes = 0;
+    IsoDepStats total = {0, 0, 0, 0};
+    unsigned round, failures = 0;
+
+    mfrc522SimInit(&chip, NULL);
+    mfrc522ObjectInit(&rfid);
+    if (mfrc522Start(&rfid, &config) != MFRC522_OK) {
+        fprintf(stderr, "isodep-bench: chip did not start\n");
+        exit(EXIT_FAILURE);
+    }
+    piccSimInit(&card, uid, sizeof(uid), 0x20);
+    isoDepSimInit(&app, &card);
+    app.wtxEvery = s->wtxEvery;
+    card.arriveNs = vclockNow();
+    mfrc522SimAddCard(&chip, &card);
+
+    start = vclockNow();
+    if (activate(s) != MFRC522_OK) {
+        fprintf(stderr, "isodep-bench: %s: activation failed\n", s->name);
+        exit(EXIT_FAILURE);
+    }
+    activation = vclockNow() - start -
+                 (ISO14443A_RESET_US + FIELD_GUARD_US) * 1000ULL;
+    card.faultPermille = s->faultPermille;
+    card.randomFault = PICC_SIM_FAULT_CRC;
+
+    memset(&isodep.stats, 0, sizeof(isodep.stats));
+    start = vclockNow();
+    for (round = 0; round < ROUNDS; round++) {
+        size_t n = run_round(round);
+
+        if (n == 0) {
+            failures++;
+            add_stats(&total, &isodep.stats);
+            while (activate(s) != MFRC522_OK) {
+            }
+            memset(&isodep.stats, 0, sizeof(isodep.stats));
+        }
+        bytes += n;
+    }
+    elapsed = vclockNow() - start;
+    add_stats(&total, &isodep.stats);
+    isoDepDeselect(&isodep);
+    mfrc522SimRemoveCard(&chip, &card);
+
+    printf("%s:\n", s->name);
+    printf("  activation       %8.1f us (FSC %u, FSD %u, DR %u, DS %u)\n",
+           activation / 1000.0, (unsigned)isodep.fsc, (unsigned)isodep.fsd,
+           106U << isodep.dr, 106U << isodep.ds);
+    printf("  round            %8.2f ms\n", elapsed / 1e6 / ROUNDS);
+    printf("  APDUs            %8.1f /s\n", 3 * ROUNDS / (elapsed / 1e9));
+    printf("  payload          %8.0f B/s\n", bytes / (elapsed / 1e9));
+    printf("  frames           %8.1f per APDU\n",
+           total.frames / (3.0 * ROUNDS));
+    printf("  retransmissions  %8u\n", (unsigned)total.retransmissions);
+    printf("  WTX              %8u\n", (unsigned)total.wtx);
+    printf("  failed rounds    %8u\n", failures);
+    if (failures > 0 && s->faultPermille == 0) {
+        failed = true;
+    }
+}
+
+int main(void) {
+    size_t i;
+
+    printf("isodep-bench (%u rounds of SELECT, READ BINARY %u B, "
+           "UPDATE BINARY %u B)\n", ROUNDS, READ_SIZE, UPDATE_SIZE);
+    for (i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        run_scenario(&scenarios[i]);
+    }
+    if (failed) {
+        fprintf(stderr, "isodep-bench: data or exchange check failed\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
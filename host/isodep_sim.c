@@ -0,0 +1,235 @@
+/**
+ * @file    isodep_sim.c
+ * @brief   ISO/IEC 14443-4 card application for the card model.
+ */
+
+#include <string.h>
+
+#include "isodep_sim.h"
+
+#define CMD_RATS                    0xE0
+#define PCB_I                       0x02
+#define PCB_R                       0xA2
+#define PCB_CHAIN                   0x10
+#define PCB_NAK                     0x10
+#define PCB_BN                      0x01
+#define S_DESELECT                  0xC2
+#define S_WTX                       0xF2
+
+#define INS_SELECT                  0xA4
+#define INS_READ_BINARY             0xB0
+#define INS_UPDATE_BINARY           0xD6
+
+static const uint16_t frame_sizes[] = {16, 24, 32, 40, 48, 64, 96, 128, 256};
+
+static size_t status(IsoDepSim *sim, size_t len, uint16_t sw) {
+    sim->response[len] = (uint8_t)(sw >> 8);
+    sim->response[len + 1] = (uint8_t)sw;
+    return len + 2;
+}
+
+/**
+ * @brief   Runs the command APDU and leaves the response APDU.
+ */
+static void execute(IsoDepSim *sim) {
+    const uint8_t *apdu = sim->command;
+    size_t len = sim->commandlen;
+    size_t offset, n;
+
+    sim->stats.apdus++;
+    sim->responseoff = 0;
+    if (len < 4) {
+        sim->responselen = status(sim, 0, 0x6700);
+        return;
+    }
+    offset = ((size_t)apdu[2] << 8) | apdu[3];
+    switch (apdu[1]) {
+    case INS_SELECT:
+        sim->responselen = status(sim, 0, 0x9000);
+        break;
+    case INS_READ_BINARY:
+        n = len > 4 && apdu[4] != 0 ? apdu[4] : 256;
+        if (offset + n > ISODEP_SIM_FILE_SIZE) {
+            sim->responselen = status(sim, 0, 0x6B00);
+            break;
+        }
+        memcpy(sim->response, &sim->file[offset], n);
+        sim->responselen = status(sim, n, 0x9000);
+        break;
+    case INS_UPDATE_BINARY:
+        n = len > 4 ? apdu[4] : 0;
+        if (len != 5 + n) {
+            sim->responselen = status(sim, 0, 0x6700);
+        } else if (offset + n > ISODEP_SIM_FILE_SIZE) {
+            sim->responselen = status(sim, 0, 0x6B00);
+        } else {
+            memcpy(&sim->file[offset], &apdu[5], n);
+            sim->responselen = status(sim, 0, 0x9000);
+        }
+        break;
+    default:
+        if (sim->apdu != NULL) {
+            sim->responselen = sim->apdu(sim->apduArg, apdu, len,
+                                         sim->response);
+        } else {
+            sim->responselen = status(sim, 0, 0x6D00);
+        }
+        break;
+    }
+}
+
+/**
+ * @brief   Puts the next block of the response APDU in @p sim->last.
+ */
+static void next_block(IsoDepSim *sim) {
+    size_t frame = sim->fsd - 2u < sizeof(sim->last) ? sim->fsd - 2u
+                                                     : sizeof(sim->last);
+    size_t n = sim->responselen - sim->responseoff;
+    bool chain = n > frame - 1;
+
+    n = chain ? frame - 1 : n;
+    sim->last[0] = (uint8_t)(PCB_I | sim->bn | (chain ? PCB_CHAIN : 0));
+    memcpy(&sim->last[1], &sim->response[sim->responseoff], n);
+    sim->responseoff += n;
+    sim->lastlen = n + 1;
+}
+
+static size_t activate(IsoDepSim *sim, const uint8_t *frame,
+                       uint8_t *response) {
+    uint8_t fsdi = frame[1] >> 4;
+
+    sim->stats.rats++;
+    sim->active = true;
+    sim->ppsAllowed = true;
+    sim->wtxPending = false;
+    sim->bn = 1;
+    sim->fsd = frame_sizes[fsdi < 8 ? fsdi : 8];
+    sim->commandlen = 0;
+    sim->responselen = 0;
+    sim->responseoff = 0;
+    sim->lastlen = 0;
+
+    response[0] = 5;
+    response[1] = (uint8_t)(0x70 | sim->fsci);
+    response[2] = sim->ta;
+    response[3] = (uint8_t)((sim->fwi << 4) | sim->sfgi);
+    response[4] = 0x02;
+    return 5;
+}
+
+/**
+ * @brief   Accepts the PPS if the card supports the bit rates asked for.
+ */
+static size_t pps(IsoDepSim *sim, const uint8_t *frame, uint8_t *response) {
+    uint8_t dsi = (frame[2] >> 2) & 0x03;
+    uint8_t dri = frame[2] & 0x03;
+
+    if ((frame[1] & 0x10) == 0 ||
+        (dsi != 0 && (sim->ta & (0x08 << dsi)) == 0) ||
+        (dri != 0 && (sim->ta & (0x01 << (dri - 1))) == 0) ||
+        ((sim->ta & 0x80) != 0 && dsi != dri)) {
+        return 0;
+    }
+    sim->stats.pps++;
+    response[0] = frame[0];
+    return 1;
+}
+
+static size_t handle(PiccSim *card, const uint8_t *frame, size_t len,
+                     uint8_t *response) {
+    IsoDepSim *sim = card->app;
+    uint8_t pcb = frame[0];
+
+    if (sim->session != card->session) {
+        sim->session = card->session;
+        sim->active = false;
+    }
+    if (!sim->active) {
+        return len == 2 && pcb == CMD_RATS ? activate(sim, frame, response) : 0;
+    }
+    if (sim->ppsAllowed) {
+        sim->ppsAllowed = false;
+        if ((pcb & 0xF0) == 0xD0 && len == 3) {
+            return pps(sim, frame, response);
+        }
+    }
+
+    if (pcb == S_DESELECT && len == 1) {
+        sim->active = false;
+        card->state = PICC_SIM_HALT;
+        response[0] = S_DESELECT;
+        return 1;
+    }
+    if ((pcb & 0xEE) == PCB_I) {
+        size_t n = len - 1;
+
+        /* Rule D. */
+        sim->bn ^= PCB_BN;
+        if (sim->commandlen + n > sizeof(sim->command)) {
+            n = sizeof(sim->command) - sim->commandlen;
+        }
+        memcpy(&sim->command[sim->commandlen], &frame[1], n);
+        sim->commandlen += n;
+        if ((pcb & PCB_CHAIN) != 0) {
+            sim->last[0] = PCB_R | sim->bn;
+            sim->lastlen = 1;
+        } else {
+            execute(sim);
+            sim->commandlen = 0;
+            if (sim->wtxEvery > 0 && sim->stats.apdus % sim->wtxEvery == 0) {
+                sim->stats.wtx++;
+                sim->wtxPending = true;
+                sim->last[0] = S_WTX;
+                sim->last[1] = sim->wtxm;
+                sim->lastlen = 2;
+            } else {
+                next_block(sim);
+            }
+        }
+    } else if ((pcb & 0xE6) == PCB_R && len == 1) {
+        if ((pcb & PCB_BN) == sim->bn) {
+            /* Rule 10. */
+            sim->stats.retransmissions++;
+        } else if ((pcb & PCB_NAK) != 0) {
+            /* Rule 11. */
+            sim->last[0] = PCB_R | sim->bn;
+            sim->lastlen = 1;
+        } else if (sim->responseoff < sim->responselen) {
+            /* Rules E and 12. */
+            sim->bn ^= PCB_BN;
+            next_block(sim);
+        } else {
+            return 0;
+        }
+    } else if (pcb == S_WTX && len == 2 && sim->wtxPending) {
+        sim->wtxPending = false;
+        next_block(sim);
+    } else {
+        /* Rule 13. */
+        return 0;
+    }
+    memcpy(response, sim->last, sim->lastlen);
+    return sim->lastlen;
+}
+
+/**
+ * @brief   Makes @p card an ISO/IEC 14443-4 card.
+ * @details The card supports all bit rates in both directions, frames of
+ *          256 bytes and FWI 7, the file holds a counting pattern.
+ *          Call after piccSimInit().
+ */
+void isoDepSimInit(IsoDepSim *sim, PiccSim *card) {
+    size_t i;
+
+    memset(sim, 0, sizeof(*sim));
+    sim->fsci = 8;
+    sim->ta = 0x77;
+    sim->fwi = 7;
+    sim->wtxm = 1;
+    for (i = 0; i < sizeof(sim->file); i++) {
+        sim->file[i] = (uint8_t)i;
+    }
+    card->sak = 0x20;
+    card->handler = handle;
+    card->app = sim;
+}
@@ -0,0 +1,86 @@
+/**
+ * @file    isodep_sim.h
+ * @brief   ISO/IEC 14443-4 card application for the card model.
+ * @details Installed as the handler of a @p PiccSim, it answers RATS and
+ *          PPS and runs the PICC side of the block transmission protocol:
+ *          chaining both ways, S(WTX) and the block numbering rules which
+ *          recover lost and corrupted blocks.
+ *
+ *          On top of it sits a minimal file system of one transparent file
+ *          with SELECT, READ BINARY and UPDATE BINARY; other commands may
+ *          be handed to an application, see @p isodepsimapducb_t. The time
+ *          the card takes to process a command is not modelled, a waiting
+ *          time extension only costs the frames.
+ */
+
+#ifndef _ISODEP_SIM_H_
+#define _ISODEP_SIM_H_
+
+#include "picc_sim.h"
+
+/**
+ * @brief   Size of the transparent file.
+ */
+#define ISODEP_SIM_FILE_SIZE        1024
+
+/**
+ * @brief   Longest command and response APDU.
+ */
+#define ISODEP_SIM_APDU_SIZE        (5 + 256 + 2)
+
+/**
+ * @brief   Runs a command APDU the file system does not know.
+ *
+ * @return  Length of the response APDU left in @p response, status word
+ *          included, at most @p ISODEP_SIM_APDU_SIZE.
+ */
+typedef size_t (*isodepsimapducb_t)(void *arg, const uint8_t *apdu,
+                                    size_t len, uint8_t *response);
+
+typedef struct {
+    uint32_t rats;
+    uint32_t pps;
+    uint32_t apdus;
+    uint32_t wtx;                   /**< S(WTX) requests sent.              */
+    uint32_t retransmissions;       /**< Blocks sent again.                 */
+} IsoDepSimStats;
+
+typedef struct {
+    /* Configuration, see isoDepSimInit(). */
+    uint8_t fsci;
+    uint8_t ta;                     /**< Bit rates announced in the ATS.    */
+    uint8_t fwi;
+    uint8_t sfgi;
+    uint32_t wtxEvery;              /**< Ask for a waiting time extension
+                                         every n-th APDU, 0 for never.      */
+    uint8_t wtxm;
+    isodepsimapducb_t apdu;         /**< Optional.                          */
+    void *apduArg;
+    IsoDepSimStats stats;
+    uint8_t file[ISODEP_SIM_FILE_SIZE];
+
+    /* State. */
+    uint64_t session;
+    bool active;                    /**< RATS received.                     */
+    bool ppsAllowed;
+    bool wtxPending;
+    uint8_t bn;
+    uint16_t fsd;
+    uint8_t last[PICC_SIM_FRAME_SIZE - 2];
+    size_t lastlen;
+    uint8_t command[ISODEP_SIM_APDU_SIZE];
+    size_t commandlen;
+    uint8_t response[ISODEP_SIM_APDU_SIZE];
+    size_t responselen;
+    size_t responseoff;
+} IsoDepSim;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void isoDepSimInit(IsoDepSim *sim, PiccSim *card);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ISODEP_SIM_H_ */
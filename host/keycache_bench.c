@@ -0,0 +1,235 @@
+/**
+ * @file    keycache_bench.c
+ * @brief   Hit rate of the diversified key cache.
+ * @details Checks the key diversification against the example of NXP
+ *          AN10922 and times a derivation and a cache hit in cycles of the
+ *          build machine, see @p platformCycles().
+ *
+ *          Then replays @p DAYS days of taps at doors of different crowds:
+ *          regular users tapping several times a day and visitors tapping
+ *          once, in random order within the day. The master key rotates at
+ *          the start of day @p ROTATE_DAY. The bench reports the hit rate
+ *          of @p READER_KEY_CACHE_SIZE entries and the derivation cycles
+ *          left per tap, and fails if a key handed out differs from the one
+ *          derived from the current master key.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "reader/keycache.h"
+
+#define RUNS                        10001
+#define DAYS                        5
+#define ROTATE_DAY                  2
+#define KEYNO                       1
+
+/* Taps of one day, the largest crowd. */
+#define DAY_TAPS_MAX                2000
+
+typedef struct {
+    const char *name;
+    unsigned regulars;
+    unsigned tapsPerDay;            /* Of each regular. */
+    unsigned visitors;              /* A day, one tap each. */
+} Scenario;
+
+static const Scenario scenarios[] = {
+    {"lab, 10 regulars", 10, 12, 2},
+    {"team, 25 regulars", 25, 8, 5},
+    {"office, 40 regulars", 40, 6, 10},
+    {"lobby, 400 regulars", 400, 2, 50},
+};
+
+static const uint8_t aid[DESFIRE_AID_SIZE] = {0x44, 0x4C, 0x01};
+static const uint8_t systemId[] = "door";
+
+static ReaderKeyCache cache;
+static uint32_t day[DAY_TAPS_MAX];
+static uint32_t seed = 1;
+static bool failed;
+
+static uint32_t next_random(void) {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static void make_card(Iso14443aCard *card, uint32_t user) {
+    memset(card, 0, sizeof(*card));
+    card->uidlen = 7;
+    card->uid[0] = 0x04;
+    card->uid[1] = (uint8_t)(user >> 24);
+    card->uid[2] = (uint8_t)(user >> 16);
+    card->uid[3] = (uint8_t)(user >> 8);
+    card->uid[4] = (uint8_t)user;
+    card->uid[5] = 0x5D;
+    card->uid[6] = 0x80;
+}
+
+static void master_key(uint8_t *key, unsigned version) {
+    size_t i;
+
+    for (i = 0; i < DESFIRE_KEY_SIZE; i++) {
+        key[i] = (uint8_t)(0x30 + 7 * version + i);
+    }
+}
+
+/*===========================================================================*/
+/* Test vector and cycles.                                                   */
+/*===========================================================================*/
+
+static uint32_t samples[RUNS];
+
+static int compare(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static uint32_t median(void) {
+    qsort(samples, RUNS, sizeof(samples[0]), compare);
+    return samples[RUNS / 2];
+}
+
+static void known_answer(void) {
+    /* AN10922 2.2.1: UID, AID and system identifier "NXP Abu". */
+    static const uint8_t master[] = {
+        0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB,
+        0xCC, 0xDD, 0xEE, 0xFF
+    };
+    static const uint8_t input[] = {
+        0x04, 0x78, 0x2E, 0x21, 0x80, 0x1D, 0x80, 0x30, 0x42, 0xF5, 0x4E, 0x58,
+        0x50, 0x20, 0x41, 0x62, 0x75
+    };
+    static const uint8_t diversified[] = {
+        0xA8, 0xDD, 0x63, 0xA3, 0xB8, 0x9D, 0x54, 0xB3, 0x7C, 0xA8, 0x02, 0x47,
+        0x3F, 0xDA, 0x91, 0x75
+    };
+    CmacKey key;
+    uint8_t out[DESFIRE_KEY_SIZE];
+
+    cmacKeyInit(&key, master);
+    desfireDiversifyKey(&key, input, sizeof(input), out);
+    if (memcmp(out, diversified, sizeof(out)) != 0) {
+        fprintf(stderr, "keycache-bench: AN10922 example does not match\n");
+        failed = true;
+    }
+    printf("test vector: %s\n", failed ? "FAILED" : "ok");
+}
+
+static void cycles(void) {
+    uint8_t key[DESFIRE_KEY_SIZE];
+    Iso14443aCard card;
+    size_t i;
+
+    readerKeyCacheInit(&cache, systemId, sizeof(systemId) - 1);
+    master_key(key, 0);
+    readerKeyCacheSetMaster(&cache, aid, KEYNO, key);
+    printf("cycles of the build machine, median of %u runs:\n", RUNS);
+    for (i = 0; i < RUNS; i++) {
+        uint32_t start;
+
+        make_card(&card, (uint32_t)i);
+        readerKeyCacheFlush(&cache);
+        start = platformCycles();
+        readerKeyCacheGet(&cache, &card, aid, KEYNO, key);
+        samples[i] = platformElapsedCycles(start);
+    }
+    printf("  miss, derived                  %6u\n", (unsigned)median());
+    for (i = 0; i < RUNS; i++) {
+        uint32_t start;
+
+        /* The last of a full cache, the longest search. */
+        make_card(&card, (uint32_t)(i % READER_KEY_CACHE_SIZE));
+        readerKeyCacheGet(&cache, &card, aid, KEYNO, key);
+        start = platformCycles();
+        readerKeyCacheGet(&cache, &card, aid, KEYNO, key);
+        samples[i] = platformElapsedCycles(start);
+    }
+    printf("  hit                            %6u\n", (unsigned)median());
+}
+
+/*===========================================================================*/
+/* Crowds.                                                                   */
+/*===========================================================================*/
+
+static void run_scenario(const Scenario *s) {
+    uint8_t master[DESFIRE_KEY_SIZE];
+    uint8_t key[DESFIRE_KEY_SIZE];
+    uint8_t want[DESFIRE_KEY_SIZE];
+    uint8_t input[DESFIRE_DIVERSIFY_MAX];
+    CmacKey reference;
+    Iso14443aCard card;
+    uint64_t taps = 0;
+    unsigned d;
+    size_t i, n;
+
+    readerKeyCacheInit(&cache, systemId, sizeof(systemId) - 1);
+    for (d = 0; d < DAYS; d++) {
+        if (d == 0 || d == ROTATE_DAY) {
+            master_key(master, d);
+            readerKeyCacheSetMaster(&cache, aid, KEYNO, master);
+            cmacKeyInit(&reference, master);
+        }
+
+        n = 0;
+        for (i = 0; i < s->regulars * s->tapsPerDay; i++) {
+            day[n++] = (uint32_t)(i % s->regulars);
+        }
+        for (i = 0; i < s->visitors; i++) {
+            day[n++] = 100000U + d * 1000U + (uint32_t)i;
+        }
+        for (i = n - 1; i > 0; i--) {
+            size_t j = next_random() % (i + 1);
+            uint32_t t = day[i];
+
+            day[i] = day[j];
+            day[j] = t;
+        }
+
+        for (i = 0; i < n; i++) {
+            make_card(&card, day[i]);
+            if (!readerKeyCacheGet(&cache, &card, aid, KEYNO, key)) {
+                failed = true;
+                continue;
+            }
+            memcpy(input, card.uid, card.uidlen);
+            memcpy(&input[card.uidlen], aid, DESFIRE_AID_SIZE);
+            memcpy(&input[card.uidlen + DESFIRE_AID_SIZE], systemId,
+                   sizeof(systemId) - 1);
+            desfireDiversifyKey(&reference, input,
+                                card.uidlen + DESFIRE_AID_SIZE +
+                                    sizeof(systemId) - 1, want);
+            if (memcmp(key, want, sizeof(key)) != 0) {
+                failed = true;
+            }
+        }
+        taps += n;
+    }
+
+    printf("  %-22s %7.1f%% %9u %9u %11.0f\n", s->name,
+           100.0 * cache.stats.hits / taps, (unsigned)cache.stats.evictions,
+           (unsigned)cache.stats.invalidations,
+           (double)cache.stats.cycles / taps);
+}
+
+int main(void) {
+    size_t i;
+
+    printf("keycache-bench (%u entries, %u days, master rotated on day %u)\n",
+           READER_KEY_CACHE_SIZE, DAYS, ROTATE_DAY + 1);
+    known_answer();
+    cycles();
+    printf("  %-22s %8s %9s %9s %11s\n", "", "hits", "evicted",
+           "rotated", "cycles/tap");
+    for (i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        run_scenario(&scenarios[i]);
+    }
+    if (failed) {
+        fprintf(stderr, "keycache-bench: wrong key handed out\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,268 @@
+/**
+ * @file    link_bench.c
+ * @brief   CPU cost and losses of the controller link at line rate.
+ * @details The controller stand-in sends numbered bytes to the reader,
+ *          either as 32 byte frames with three idle character times between
+ *          them or as one continuous stream. The reader thread reads them in
+ *          place from the link ring, checks them and answers every frame
+ *          with 8 bytes sent straight from a constant buffer.
+ *
+ *          The same traffic is also fed to a model of the byte per
+ *          interrupt serial driver: every byte interrupts, goes through the
+ *          input queue and wakes the reading thread, every answer byte takes
+ *          a transmit interrupt. A byte is lost when the CPU is still busy
+ *          with the ones before once the next one has arrived, as the USART
+ *          only holds one.
+ *
+ *          The bench fails if the link loses, corrupts or duplicates a byte
+ *          or an answer.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "link/link.h"
+#include "uart_sim.h"
+#include "vclock.h"
+
+#define RUN_BYTES                   16384
+#define FRAME_BYTES                 32
+#define GAP_CHARS                   3
+#define ANSWER_BYTES                8
+
+/* Serial driver input queue put and flags. */
+#define SERIAL_QUEUE_NS             300
+/* Switch to the thread waiting in the input queue. */
+#define SERIAL_WAKEUP_NS            3000
+/* Interrupt entry and exit and the driver handler, as SIM_UART_IRQ_NS. */
+#define SERIAL_IRQ_NS               1000
+
+static const uint32_t bitrates[] = {38400, 115200, 460800, 921600, 3000000};
+
+typedef struct {
+    uint32_t interrupts;
+    uint64_t cpuNs;
+    uint32_t lost;
+    uint64_t elapsedNs;
+    uint32_t received;
+} Result;
+
+static UartSim sim;
+static LinkDriver link;
+static const LinkConfig config = {&uartSimTransport, &sim};
+
+static const uint8_t answer[ANSWER_BYTES] = {
+    0xA5, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x5A
+};
+
+/* Controller stand-in. */
+static PlatformTimer feeder;
+static bool stream;
+static uint64_t feedStart;
+static uint64_t framePeriodNs;
+static unsigned framesSent;
+
+/* Byte per interrupt model. */
+static uint64_t busyUntil;
+static uint32_t serialLost;
+static uint64_t serialCpuNs;
+static uint32_t serialReceived;
+static uint32_t serialInterrupts;
+
+static bool failed;
+
+static uint8_t pattern(uint32_t i) {
+    return (uint8_t)(i ^ (i >> 8));
+}
+
+/**
+ * @brief   Sends the frames due, a stream is kept two frames ahead.
+ */
+static void feed(void *arg) {
+    uint64_t now = vclockNow();
+    unsigned due = (unsigned)((now - feedStart) / framePeriodNs) + 1;
+    uint8_t frame[FRAME_BYTES];
+    uint64_t next;
+
+    (void)arg;
+
+    if (stream) {
+        due++;
+    }
+    while (framesSent < due && framesSent < RUN_BYTES / FRAME_BYTES) {
+        uint32_t base = framesSent * FRAME_BYTES;
+        unsigned i;
+
+        for (i = 0; i < FRAME_BYTES; i++) {
+            frame[i] = pattern(base + i);
+        }
+        if (uartSimPeerSend(&sim, frame, FRAME_BYTES) != FRAME_BYTES) {
+            break;
+        }
+        framesSent++;
+    }
+    if (framesSent < RUN_BYTES / FRAME_BYTES) {
+        next = feedStart + (due - (stream ? 1 : 0)) * framePeriodNs;
+        platformTimerStart(&feeder,
+                           (uint32_t)((next + 999) / 1000 - now / 1000),
+                           feed, NULL);
+    }
+}
+
+static void feed_start(uint32_t bitrate) {
+    uint64_t charNs = 10000000000ULL / bitrate;
+
+    framePeriodNs = (FRAME_BYTES + (stream ? 0 : GAP_CHARS)) * charNs;
+    framesSent = 0;
+    feedStart = vclockNow();
+    feed(NULL);
+}
+
+static void serial_char(UartSim *s, uint8_t c, uint64_t at) {
+    uint64_t start = at > busyUntil ? at : busyUntil;
+
+    (void)c;
+
+    if (start >= at + s->charNs) {
+        /* The next byte overran the USART before this one was read. */
+        busyUntil = start + SERIAL_IRQ_NS;
+        serialLost++;
+        return;
+    }
+    busyUntil = start + SERIAL_IRQ_NS + SERIAL_QUEUE_NS + SERIAL_WAKEUP_NS;
+    serialCpuNs += SERIAL_QUEUE_NS + SERIAL_WAKEUP_NS;
+    serialReceived++;
+    if (serialReceived % FRAME_BYTES == 0) {
+        /* The answer goes out one transmit interrupt per byte. */
+        busyUntil += ANSWER_BYTES * (SERIAL_IRQ_NS + SERIAL_QUEUE_NS);
+        serialCpuNs += ANSWER_BYTES * (SERIAL_IRQ_NS + SERIAL_QUEUE_NS);
+        serialInterrupts += ANSWER_BYTES;
+    }
+}
+
+static void run_serial(uint32_t bitrate, Result *r) {
+    uint64_t start;
+
+    uartSimInit(&sim, bitrate, NULL);
+    sim.rxchar = serial_char;
+    busyUntil = 0;
+    serialLost = 0;
+    serialCpuNs = 0;
+    serialReceived = 0;
+    serialInterrupts = 0;
+
+    start = vclockNow();
+    feed_start(bitrate);
+    while (framesSent < RUN_BYTES / FRAME_BYTES || sim.timerNs != 0) {
+        vclockAdvance(framePeriodNs);
+    }
+    r->elapsedNs = (busyUntil > vclockNow() ? busyUntil : vclockNow()) - start;
+    r->interrupts = sim.stats.interrupts + serialInterrupts;
+    r->cpuNs = sim.stats.cpuNs + serialCpuNs;
+    r->lost = serialLost;
+    r->received = serialReceived;
+}
+
+static void run_link(uint32_t bitrate, Result *r) {
+    uint8_t sent[UART_SIM_SENT_SIZE];
+    uint32_t received = 0;
+    unsigned answers = 0;
+    uint64_t start;
+    size_t n;
+
+    uartSimInit(&sim, bitrate, &link);
+    linkObjectInit(&link);
+    linkStart(&link, &config);
+
+    start = vclockNow();
+    feed_start(bitrate);
+    while (received < RUN_BYTES) {
+        const uint8_t *data;
+        size_t i;
+
+        n = linkReceive(&link, &data, 100000);
+        if (n == 0) {
+            break;
+        }
+        for (i = 0; i < n; i++) {
+            if (data[i] != pattern(received + (uint32_t)i)) {
+                failed = true;
+            }
+        }
+        linkRelease(&link, n);
+        received += (uint32_t)n;
+        while (answers < received / FRAME_BYTES) {
+            linkStartSend(&link, answer, sizeof(answer));
+            answers++;
+        }
+    }
+    linkWaitSend(&link);
+    r->elapsedNs = vclockNow() - start;
+    linkStop(&link);
+    uartSimRun(&sim);
+
+    r->interrupts = sim.stats.interrupts;
+    r->cpuNs = sim.stats.cpuNs;
+    r->lost = RUN_BYTES - received;
+    r->received = received;
+    if (received != RUN_BYTES || link.stats.overruns != 0) {
+        failed = true;
+    }
+    while ((n = uartSimPeerReceive(&sim, sent, sizeof(sent))) > 0) {
+        size_t i;
+
+        for (i = 0; i < n; i++) {
+            if (sent[i] != answer[i % ANSWER_BYTES]) {
+                failed = true;
+            }
+        }
+        answers -= (unsigned)(n / ANSWER_BYTES);
+    }
+    if (answers != 0) {
+        failed = true;
+    }
+}
+
+static void report(uint32_t bitrate, const Result *l, const Result *s) {
+    printf("  %7u %8.0f  %7.1f %6.2f %5u   %7.1f %6.2f %5u\n",
+           (unsigned)bitrate, l->received / (l->elapsedNs / 1e9),
+           l->interrupts * 1024.0 / RUN_BYTES,
+           100.0 * l->cpuNs / l->elapsedNs, (unsigned)l->lost,
+           s->interrupts * 1024.0 / RUN_BYTES,
+           100.0 * s->cpuNs / s->elapsedNs, (unsigned)s->lost);
+}
+
+int main(void) {
+    unsigned t;
+
+    printf("link-bench (ring %u B, %u B per run, answers of %u B)\n",
+           (unsigned)LINK_RX_RING_SIZE, RUN_BYTES, ANSWER_BYTES);
+    for (t = 0; t < 2; t++) {
+        size_t i;
+
+        stream = t == 1;
+        if (stream) {
+            printf("continuous stream:\n");
+        } else {
+            printf("%u B frames, %u idle characters apart:\n", FRAME_BYTES,
+                   GAP_CHARS);
+        }
+        printf("                      ---- DMA ring ----   "
+               "-- byte per IRQ --\n");
+        printf("    bit/s     B/s   IRQ/KiB  CPU %%  lost   "
+               "IRQ/KiB  CPU %%  lost\n");
+        for (i = 0; i < sizeof(bitrates) / sizeof(bitrates[0]); i++) {
+            Result l, s;
+
+            run_link(bitrates[i], &l);
+            run_serial(bitrates[i], &s);
+            report(bitrates[i], &l, &s);
+        }
+    }
+    if (failed) {
+        fprintf(stderr, "link-bench: bytes or answers lost or corrupted\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,902 @@
+/**
+ * @file    mfrc522_sim.c
+ * @brief   Register level model of the NXP MFRC522 for the host build.
+ */
+
+#include <string.h>
+
+#include "mfrc522_sim.h"
+#include "vclock.h"
+
+#define MfRxReg_ParityDisable       0x10
+#define Status2Reg_Writable         0xC0
+
+/*
+ * Modem states reported in Status2Reg.
+ */
+#define MODEM_IDLE                  0
+#define MODEM_WAIT_START_SEND       1
+#define MODEM_TRANSMITTING          3
+#define MODEM_WAIT_DATA             5
+#define MODEM_RECEIVING             6
+
+const MFRC522SimTiming mfrc522SimDefaultTiming = {
+    38000,                          /* 512 periods of the 13.56 MHz crystal
+                                       plus the regulator.                  */
+    9439,                           /* 128 / fc.                            */
+    86430,                          /* 1172 / fc, last bit sent was 1.      */
+    2000000,                        /* ISO/IEC 14443-3 allows up to 5 ms.   */
+    600,
+    100000,
+    1500000                         /* Three pass authentication.           */
+};
+
+static const uint8_t reset_values[MFRC522_REGISTER_COUNT] = {
+    [MFRC522_CommandReg] = 0x20,
+    [MFRC522_ComIEnReg] = 0x80,
+    [MFRC522_ComIrqReg] = 0x14,
+    [MFRC522_Status1Reg] = 0x21,
+    [MFRC522_WaterLevelReg] = 0x08,
+    [MFRC522_ControlReg] = 0x10,
+    [MFRC522_CollReg] = 0xA0,
+    [MFRC522_ModeReg] = 0x3F,
+    [MFRC522_TxControlReg] = 0x80,
+    [MFRC522_TxSelReg] = 0x10,
+    [MFRC522_RxSelReg] = 0x84,
+    [MFRC522_RxThresholdReg] = 0x84,
+    [MFRC522_DemodReg] = 0x4D,
+    [MFRC522_MfTxReg] = 0x62,
+    [MFRC522_SerialSpeedReg] = 0xEB,
+    [MFRC522_CRCResultRegH] = 0xFF,
+    [MFRC522_CRCResultRegL] = 0xFF,
+    [MFRC522_ModWidthReg] = 0x26,
+    [MFRC522_RFCfgReg] = 0x48,
+    [MFRC522_GsNReg] = 0x88,
+    [MFRC522_CWGsPReg] = 0x20,
+    [MFRC522_ModGsPReg] = 0x20,
+    [MFRC522_TestPinEnReg] = 0x80,
+    [MFRC522_AutoTestReg] = 0x40,
+    [MFRC522_VersionReg] = 0x92,
+};
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+static uint8_t command(const MFRC522Sim *sim) {
+    return sim->regs[MFRC522_CommandReg] & MFRC522_CMD_MASK;
+}
+
+static bool powered_down(const MFRC522Sim *sim) {
+    return sim->reset ||
+           (sim->regs[MFRC522_CommandReg] & MFRC522_CommandReg_PowerDown) != 0;
+}
+
+static uint64_t bit_ns(const MFRC522Sim *sim, uint8_t modereg) {
+    return sim->timing.bitNs >> ((sim->regs[modereg] >> 4) & 0x03);
+}
+
+/**
+ * @brief   Air time of a frame: a parity bit per byte, SOF and EOF.
+ */
+static uint64_t air_time(const MFRC522Sim *sim, size_t bits, uint8_t modereg) {
+    return (bits + bits / 8 + 2) * bit_ns(sim, modereg);
+}
+
+static uint16_t crc_preset(const MFRC522Sim *sim) {
+    static const uint16_t presets[] = {0x0000, 0x6363, 0xA671, 0xFFFF};
+
+    return presets[sim->regs[MFRC522_ModeReg] & 0x03];
+}
+
+static uint64_t timer_period(const MFRC522Sim *sim) {
+    uint32_t prescaler = ((sim->regs[MFRC522_TModeReg] & MFRC522_TModeReg_TPrescalerHi) << 8) |
+                         sim->regs[MFRC522_TPrescalerReg];
+    uint32_t reload = (sim->regs[MFRC522_TReloadRegH] << 8) |
+                      sim->regs[MFRC522_TReloadRegL];
+
+    return (uint64_t)(reload + 1) * (2 * prescaler + 1) * 1000000 /
+           MFRC522_FC_KHZ;
+}
+
+static uint16_t timer_counter(const MFRC522Sim *sim) {
+    uint32_t prescaler = ((sim->regs[MFRC522_TModeReg] & MFRC522_TModeReg_TPrescalerHi) << 8) |
+                         sim->regs[MFRC522_TPrescalerReg];
+    uint32_t reload = (sim->regs[MFRC522_TReloadRegH] << 8) |
+                      sim->regs[MFRC522_TReloadRegL];
+    uint64_t ticks;
+
+    if (sim->timerStartAt == 0) {
+        return sim->timerValue;
+    }
+    ticks = (vclockNow() - sim->timerStartAt) * MFRC522_FC_KHZ /
+            (1000000 * (uint64_t)(2 * prescaler + 1));
+    return ticks >= reload ? 0 : (uint16_t)(reload - ticks);
+}
+
+static uint64_t timer_underflow_at(const MFRC522Sim *sim) {
+    return sim->timerStartAt != 0 ? sim->timerStartAt + timer_period(sim) : 0;
+}
+
+static void timer_start(MFRC522Sim *sim, uint64_t at) {
+    sim->timerStartAt = at != 0 ? at : 1;
+}
+
+static void timer_stop(MFRC522Sim *sim) {
+    sim->timerValue = timer_counter(sim);
+    sim->timerStartAt = 0;
+}
+
+/**
+ * @brief   Updates the FIFO alert flags and their interrupts.
+ */
+static void fifo_alerts(MFRC522Sim *sim) {
+    size_t water = sim->regs[MFRC522_WaterLevelReg] & 0x3F;
+
+    if (MFRC522_FIFO_SIZE - sim->fifolen <= water) {
+        sim->regs[MFRC522_ComIrqReg] |= MFRC522_ComIrqReg_HiAlertIRq;
+    }
+    if (sim->fifolen <= water) {
+        sim->regs[MFRC522_ComIrqReg] |= MFRC522_ComIrqReg_LoAlertIRq;
+    }
+}
+
+static void fifo_push(MFRC522Sim *sim, uint8_t value) {
+    if (sim->fifolen < MFRC522_FIFO_SIZE) {
+        sim->fifo[sim->fifolen++] = value;
+    } else {
+        sim->regs[MFRC522_ErrorReg] |= MFRC522_ErrorReg_BufferOvfl;
+        sim->regs[MFRC522_ComIrqReg] |= MFRC522_ComIrqReg_ErrIRq;
+    }
+    fifo_alerts(sim);
+}
+
+static uint8_t fifo_pop(MFRC522Sim *sim) {
+    uint8_t value = 0;
+
+    if (sim->fifolen > 0) {
+        value = sim->fifo[0];
+        memmove(sim->fifo, sim->fifo + 1, --sim->fifolen);
+    }
+    fifo_alerts(sim);
+    return value;
+}
+
+static void fifo_flush(MFRC522Sim *sim) {
+    sim->fifolen = 0;
+    sim->regs[MFRC522_ErrorReg] &= ~MFRC522_ErrorReg_BufferOvfl;
+    fifo_alerts(sim);
+}
+
+static void set_irq(MFRC522Sim *sim, uint8_t bits) {
+    sim->regs[MFRC522_ComIrqReg] |= bits;
+}
+
+static void go_idle(MFRC522Sim *sim) {
+    sim->regs[MFRC522_CommandReg] &= ~MFRC522_CMD_MASK;
+    set_irq(sim, MFRC522_ComIrqReg_IdleIRq);
+}
+
+static void cancel_events(MFRC522Sim *sim) {
+    sim->txEndAt = 0;
+    sim->rxStartAt = 0;
+    sim->rxEndAt = 0;
+    sim->cmdDoneAt = 0;
+}
+
+/**
+ * @brief   Brings the statistics up to the current time.
+ */
+static void account(MFRC522Sim *sim) {
+    uint64_t now = vclockNow();
+    uint64_t dt = now - sim->accountedAt;
+
+    if (sim->field) {
+        sim->stats.fieldOnNs += dt;
+    }
+    if (powered_down(sim)) {
+        sim->stats.powerDownNs += dt;
+    } else if (sim->readyAt > sim->accountedAt) {
+        sim->stats.powerDownNs += (sim->readyAt < now ? sim->readyAt : now) -
+                                  sim->accountedAt;
+    }
+    sim->accountedAt = now;
+}
+
+/**
+ * @brief   Switches the RF field according to TxControlReg and the power
+ *          state. Cards lose their state when the field goes off.
+ */
+static void field_update(MFRC522Sim *sim) {
+    bool on = !powered_down(sim) &&
+              (sim->regs[MFRC522_TxControlReg] &
+               (MFRC522_TxControlReg_Tx1RFEn | MFRC522_TxControlReg_Tx2RFEn)) != 0;
+
+    if (on && !sim->field) {
+        sim->fieldOnAt = vclockNow();
+    }
+    sim->field = on;
+}
+
+static void power_on_reset(MFRC522Sim *sim) {
+    memcpy(sim->regs, reset_values, sizeof(sim->regs));
+    sim->fifolen = 0;
+    sim->timerStartAt = 0;
+    sim->timerValue = 0;
+    cancel_events(sim);
+    field_update(sim);
+}
+
+/*===========================================================================*/
+/* RF.                                                                       */
+/*===========================================================================*/
+
+/**
+ * @brief   Session of a card at time @p t, 0 if it is not powered.
+ */
+static uint64_t card_session(const MFRC522Sim *sim, const PiccSim *card,
+                             uint64_t t) {
+    uint64_t since;
+
+    if (!sim->field || t < card->arriveNs ||
+        (card->leaveNs != 0 && t >= card->leaveNs)) {
+        return 0;
+    }
+    since = card->arriveNs > sim->fieldOnAt ? card->arriveNs : sim->fieldOnAt;
+    if (t < since + sim->timing.piccReadyNs) {
+        return 0;
+    }
+    return since + 1;
+}
+
+/**
+ * @brief   Superposes the responses of all cards, the first differing bit
+ *          is a collision.
+ */
+static void collect_responses(MFRC522Sim *sim, uint64_t t) {
+    PiccSim *card;
+
+    memset(&sim->rx, 0, sizeof(sim->rx));
+    sim->rxcollision = 0;
+    for (card = sim->cards; card != NULL; card = card->next) {
+        uint64_t session = card_session(sim, card, t);
+        PiccSimResponse r;
+        size_t i, common;
+
+        if (session == 0) {
+            continue;
+        }
+        piccSimPowerUp(card, session);
+        piccSimRespond(card, sim->tx, sim->txbits, &r);
+        if (r.bits == 0) {
+            continue;
+        }
+        if (sim->rx.bits == 0) {
+            sim->rx = r;
+            continue;
+        }
+        common = r.bits < sim->rx.bits ? r.bits : sim->rx.bits;
+        for (i = 0; i < common; i++) {
+            if (((sim->rx.data[i / 8] ^ r.data[i / 8]) >> (i % 8)) & 1) {
+                if (sim->rxcollision == 0 || i + 1 < sim->rxcollision) {
+                    sim->rxcollision = (uint8_t)(i + 1 > 255 ? 255 : i + 1);
+                }
+                break;
+            }
+        }
+        for (i = 0; i < (r.bits + 7) / 8; i++) {
+            sim->rx.data[i] |= r.data[i];
+        }
+        if (r.bits > sim->rx.bits) {
+            sim->rx.bits = r.bits;
+        }
+        if (sim->rx.fault == PICC_SIM_FAULT_NONE) {
+            sim->rx.fault = r.fault;
+        }
+    }
+}
+
+/**
+ * @brief   Starts sending the FIFO content.
+ */
+static void start_transmit(MFRC522Sim *sim) {
+    uint8_t lastbits = sim->regs[MFRC522_BitFramingReg] & MFRC522_BitFramingReg_TxLastBits;
+    size_t len = sim->fifolen;
+
+    if (len == 0) {
+        return;
+    }
+    memcpy(sim->tx, sim->fifo, len);
+    fifo_flush(sim);
+    sim->txbits = lastbits != 0 ? (len - 1) * 8 + lastbits : len * 8;
+    if (lastbits == 0 &&
+        (sim->regs[MFRC522_TxModeReg] & MFRC522_TxModeReg_TxCRCEn) != 0) {
+        uint16_t crc = piccSimCrcA(sim->tx, len, crc_preset(sim));
+
+        sim->tx[len] = (uint8_t)crc;
+        sim->tx[len + 1] = (uint8_t)(crc >> 8);
+        sim->txbits += 16;
+    }
+    sim->rxStartAt = 0;
+    sim->rxEndAt = 0;
+    sim->txEndAt = vclockNow() + air_time(sim, sim->txbits, MFRC522_TxModeReg);
+    if (sim->onTransmit != NULL) {
+        sim->onTransmit(sim->hookCtx, sim->tx, sim->txbits);
+    }
+}
+
+static void transmit_done(MFRC522Sim *sim, uint64_t t) {
+    sim->stats.framesSent++;
+    set_irq(sim, MFRC522_ComIrqReg_TxIRq);
+    if ((sim->regs[MFRC522_TModeReg] & MFRC522_TModeReg_TAuto) != 0) {
+        timer_start(sim, t);
+    }
+    if (command(sim) == MFRC522_CMD_TRANSMIT) {
+        go_idle(sim);
+        return;
+    }
+
+    collect_responses(sim, t);
+    if (sim->rx.bits > 0) {
+        uint64_t start = t + sim->timing.fdtNs;
+
+        /* The timer stops once a start bit and 4 data bits came in. */
+        sim->rxStartAt = start + 5 * bit_ns(sim, MFRC522_RxModeReg);
+        sim->rxEndAt = start + air_time(sim, sim->rx.bits, MFRC522_RxModeReg);
+    }
+}
+
+/**
+ * @brief   Stores the received frame in the FIFO and flags the errors.
+ */
+static void receive_done(MFRC522Sim *sim) {
+    uint8_t rxalign = (sim->regs[MFRC522_BitFramingReg] >> 4) & 0x07;
+    uint8_t frame[PICC_SIM_FRAME_SIZE + 1];
+    uint8_t errors = 0;
+    size_t total = rxalign + sim->rx.bits;
+    size_t bytes = (total + 7) / 8;
+    size_t i;
+
+    sim->stats.framesReceived++;
+    sim->regs[MFRC522_ErrorReg] &= MFRC522_ErrorReg_BufferOvfl;
+    sim->regs[MFRC522_CollReg] = (sim->regs[MFRC522_CollReg] &
+                                  MFRC522_CollReg_ValuesAfterColl) |
+                                 MFRC522_CollReg_CollPosNotValid;
+
+    if (sim->rx.fault == PICC_SIM_FAULT_SOF) {
+        errors |= MFRC522_ErrorReg_ProtocolErr;
+        bytes = 0;
+        total = 0;
+    }
+
+    memset(frame, 0, sizeof(frame));
+    for (i = 0; i < sim->rx.bits && bytes > 0; i++) {
+        size_t pos = rxalign + i;
+
+        if (sim->rxcollision != 0 && i + 1 >= sim->rxcollision &&
+            (sim->regs[MFRC522_CollReg] & MFRC522_CollReg_ValuesAfterColl) == 0) {
+            break;
+        }
+        if ((sim->rx.data[i / 8] >> (i % 8)) & 1) {
+            frame[pos / 8] |= (uint8_t)(1 << (pos % 8));
+        }
+    }
+
+    if (sim->rxcollision != 0 && bytes > 0) {
+        size_t pos = rxalign + sim->rxcollision;
+
+        errors |= MFRC522_ErrorReg_CollErr;
+        if (pos <= 32) {
+            sim->regs[MFRC522_CollReg] = (uint8_t)((sim->regs[MFRC522_CollReg] &
+                                                    MFRC522_CollReg_ValuesAfterColl) |
+                                                   (pos & MFRC522_CollReg_CollPos));
+        }
+        sim->stats.collisions++;
+    } else if (bytes > 0) {
+        if (sim->rx.fault == PICC_SIM_FAULT_PARITY &&
+            (sim->regs[MFRC522_MfRxReg] & MfRxReg_ParityDisable) == 0) {
+            errors |= MFRC522_ErrorReg_ParityErr;
+        }
+        if ((sim->regs[MFRC522_RxModeReg] & MFRC522_RxModeReg_RxCRCEn) != 0) {
+            /* The CRC is checked and not stored in the FIFO. */
+            bool ok = false;
+
+            if (rxalign == 0 && total % 8 == 0 && bytes >= 2) {
+                uint16_t crc = piccSimCrcA(frame, bytes - 2, crc_preset(sim));
+
+                ok = frame[bytes - 2] == (uint8_t)crc &&
+                     frame[bytes - 1] == (uint8_t)(crc >> 8);
+                bytes -= 2;
+                total -= 16;
+            }
+            if (!ok) {
+                errors |= MFRC522_ErrorReg_CRCErr;
+            }
+            sim->regs[MFRC522_Status1Reg] = (uint8_t)((sim->regs[MFRC522_Status1Reg] &
+                                                       ~MFRC522_Status1Reg_CRCOk) |
+                                                      (ok ? MFRC522_Status1Reg_CRCOk : 0));
+        }
+    }
+    if ((errors & ~MFRC522_ErrorReg_CollErr) != 0) {
+        sim->stats.rfErrors++;
+    }
+
+    for (i = 0; i < bytes; i++) {
+        fifo_push(sim, frame[i]);
+    }
+    sim->regs[MFRC522_ControlReg] = (uint8_t)((sim->regs[MFRC522_ControlReg] &
+                                               ~MFRC522_ControlReg_RxLastBits) |
+                                              (total % 8));
+    sim->regs[MFRC522_ErrorReg] |= errors;
+    set_irq(sim, MFRC522_ComIrqReg_RxIRq | (errors != 0 ? MFRC522_ComIrqReg_ErrIRq : 0));
+    if (command(sim) == MFRC522_CMD_RECEIVE) {
+        go_idle(sim);
+    }
+}
+
+/*===========================================================================*/
+/* Commands.                                                                 */
+/*===========================================================================*/
+
+/**
+ * @brief   Feeds the FIFO content to the CRC coprocessor.
+ */
+static void calc_crc(MFRC522Sim *sim) {
+    size_t n = sim->fifolen;
+
+    sim->crc = piccSimCrcA(sim->fifo, n, sim->crc);
+    fifo_flush(sim);
+    sim->regs[MFRC522_CRCResultRegH] = (uint8_t)(sim->crc >> 8);
+    sim->regs[MFRC522_CRCResultRegL] = (uint8_t)sim->crc;
+    sim->regs[MFRC522_Status1Reg] &= ~MFRC522_Status1Reg_CRCReady;
+    sim->cmdDoneAt = vclockNow() + n * sim->timing.crcByteNs;
+}
+
+/**
+ * @brief   Checks an authentication request in the FIFO against the cards:
+ *          command, block, 6 key bytes and 4 UID bytes.
+ */
+static bool authenticate(MFRC522Sim *sim) {
+    uint8_t request[12];
+    PiccSim *card;
+
+    if (sim->fifolen < sizeof(request)) {
+        fifo_flush(sim);
+        return false;
+    }
+    memcpy(request, sim->fifo, sizeof(request));
+    fifo_flush(sim);
+    for (card = sim->cards; card != NULL; card = card->next) {
+        if (card->state == PICC_SIM_ACTIVE &&
+            card_session(sim, card, vclockNow()) == card->session &&
+            memcmp(&request[2], card->key, 6) == 0 &&
+            memcmp(&request[8], card->uid, 4) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void start_command(MFRC522Sim *sim, uint8_t value) {
+    uint8_t previous = command(sim);
+    uint8_t cmd = value & MFRC522_CMD_MASK;
+    uint64_t now = vclockNow();
+
+    if (cmd == MFRC522_CMD_NO_CMD_CHANGE) {
+        cmd = previous;
+    }
+    if (powered_down(sim) && (value & MFRC522_CommandReg_PowerDown) == 0) {
+        sim->readyAt = now + sim->timing.startupNs;
+    }
+    sim->regs[MFRC522_CommandReg] = (uint8_t)((value & (MFRC522_CommandReg_RcvOff |
+                                                        MFRC522_CommandReg_PowerDown)) |
+                                              cmd);
+    if ((value & MFRC522_CommandReg_PowerDown) != 0) {
+        cancel_events(sim);
+        field_update(sim);
+        return;
+    }
+    if (cmd == previous && (value & MFRC522_CMD_MASK) == MFRC522_CMD_NO_CMD_CHANGE) {
+        field_update(sim);
+        return;
+    }
+
+    cancel_events(sim);
+    switch (cmd) {
+    case MFRC522_CMD_MEM:
+        if (sim->fifolen >= sizeof(sim->mem)) {
+            memcpy(sim->mem, sim->fifo, sizeof(sim->mem));
+            fifo_flush(sim);
+        } else if (sim->fifolen == 0) {
+            size_t i;
+
+            for (i = 0; i < sizeof(sim->mem); i++) {
+                fifo_push(sim, sim->mem[i]);
+            }
+        }
+        sim->cmdDoneAt = now;
+        break;
+    case MFRC522_CMD_GENERATE_RANDOM: {
+        size_t i;
+
+        for (i = 0; i < 10; i++) {
+            sim->seed = sim->seed * 1103515245 + 12345;
+            sim->mem[i] = (uint8_t)(sim->seed >> 16);
+        }
+        sim->cmdDoneAt = now + sim->timing.randomNs;
+        break;
+    }
+    case MFRC522_CMD_CALC_CRC:
+        sim->crc = crc_preset(sim);
+        calc_crc(sim);
+        break;
+    case MFRC522_CMD_TRANSMIT:
+        start_transmit(sim);
+        break;
+    case MFRC522_CMD_MF_AUTHENT:
+        sim->authOk = authenticate(sim);
+        sim->cmdDoneAt = now + sim->timing.authNs;
+        break;
+    case MFRC522_CMD_SOFT_RESET:
+        power_on_reset(sim);
+        sim->regs[MFRC522_CommandReg] = MFRC522_CMD_SOFT_RESET;
+        sim->readyAt = now + sim->timing.startupNs;
+        sim->cmdDoneAt = sim->readyAt;
+        break;
+    default:
+        /* Idle, Receive and Transceive wait for the RF side. */
+        break;
+    }
+    field_update(sim);
+}
+
+static void command_done(MFRC522Sim *sim) {
+    switch (command(sim)) {
+    case MFRC522_CMD_CALC_CRC:
+        /* Runs on until stopped, further FIFO data is added to the CRC. */
+        sim->regs[MFRC522_Status1Reg] |= MFRC522_Status1Reg_CRCReady;
+        sim->regs[MFRC522_DivIrqReg] |= MFRC522_DivIrqReg_CRCIRq;
+        break;
+    case MFRC522_CMD_MF_AUTHENT:
+        if (sim->authOk) {
+            sim->regs[MFRC522_Status2Reg] |= MFRC522_Status2Reg_MFCrypto1On;
+        } else {
+            sim->regs[MFRC522_ComIrqReg] |= MFRC522_ComIrqReg_ErrIRq;
+        }
+        go_idle(sim);
+        break;
+    case MFRC522_CMD_SOFT_RESET:
+        sim->regs[MFRC522_CommandReg] = 0x20;
+        break;
+    default:
+        go_idle(sim);
+        break;
+    }
+}
+
+/*===========================================================================*/
+/* Register access.                                                          */
+/*===========================================================================*/
+
+static uint8_t modem_state(const MFRC522Sim *sim) {
+    uint64_t now = vclockNow();
+
+    if (sim->txEndAt != 0) {
+        return MODEM_TRANSMITTING;
+    }
+    if (sim->rxEndAt != 0) {
+        return now + 5 * bit_ns(sim, MFRC522_RxModeReg) >= sim->rxStartAt ?
+               MODEM_RECEIVING : MODEM_WAIT_DATA;
+    }
+    switch (command(sim)) {
+    case MFRC522_CMD_TRANSCEIVE:
+        return MODEM_WAIT_START_SEND;
+    case MFRC522_CMD_RECEIVE:
+        return MODEM_WAIT_DATA;
+    default:
+        return MODEM_IDLE;
+    }
+}
+
+static bool irq_active(const MFRC522Sim *sim) {
+    return (sim->regs[MFRC522_ComIrqReg] & sim->regs[MFRC522_ComIEnReg] & 0x7F) != 0 ||
+           (sim->regs[MFRC522_DivIrqReg] & sim->regs[MFRC522_DivIEnReg] &
+            (MFRC522_DivIrqReg_MfinActIRq | MFRC522_DivIrqReg_CRCIRq)) != 0;
+}
+
+static uint8_t read_reg(MFRC522Sim *sim, uint8_t reg) {
+    size_t water = sim->regs[MFRC522_WaterLevelReg] & 0x3F;
+    uint8_t value;
+
+    switch (reg) {
+    case MFRC522_CommandReg:
+        value = sim->regs[reg];
+        if (vclockNow() < sim->readyAt) {
+            value |= MFRC522_CommandReg_PowerDown;
+        }
+        return value;
+    case MFRC522_ComIrqReg:
+    case MFRC522_DivIrqReg:
+        return sim->regs[reg] & 0x7F;
+    case MFRC522_Status1Reg:
+        value = sim->regs[reg] & (MFRC522_Status1Reg_CRCOk | MFRC522_Status1Reg_CRCReady);
+        if (irq_active(sim)) {
+            value |= MFRC522_Status1Reg_IRq;
+        }
+        if (sim->timerStartAt != 0) {
+            value |= MFRC522_Status1Reg_TRunning;
+        }
+        if (MFRC522_FIFO_SIZE - sim->fifolen <= water) {
+            value |= MFRC522_Status1Reg_HiAlert;
+        }
+        if (sim->fifolen <= water) {
+            value |= MFRC522_Status1Reg_LoAlert;
+        }
+        return value;
+    case MFRC522_Status2Reg:
+        return (uint8_t)((sim->regs[reg] & ~MFRC522_Status2Reg_ModemState) |
+                         modem_state(sim));
+    case MFRC522_FIFODataReg:
+        return fifo_pop(sim);
+    case MFRC522_FIFOLevelReg:
+        return (uint8_t)sim->fifolen;
+    case MFRC522_ControlReg:
+        return sim->regs[reg] & MFRC522_ControlReg_RxLastBits;
+    case MFRC522_TCounterValRegH:
+        return (uint8_t)(timer_counter(sim) >> 8);
+    case MFRC522_TCounterValRegL:
+        return (uint8_t)timer_counter(sim);
+    default:
+        return sim->regs[reg];
+    }
+}
+
+static void write_reg(MFRC522Sim *sim, uint8_t reg, uint8_t value) {
+    switch (reg) {
+    case MFRC522_CommandReg:
+        start_command(sim, value);
+        break;
+    case MFRC522_ComIrqReg:
+    case MFRC522_DivIrqReg:
+        if ((value & 0x80) != 0) {
+            sim->regs[reg] |= value & 0x7F;
+        } else {
+            sim->regs[reg] &= ~value;
+        }
+        break;
+    case MFRC522_Status2Reg:
+        sim->regs[reg] = (uint8_t)((sim->regs[reg] & ~Status2Reg_Writable &
+                                    (value | ~MFRC522_Status2Reg_MFCrypto1On)) |
+                                   (value & Status2Reg_Writable));
+        break;
+    case MFRC522_FIFODataReg:
+        fifo_push(sim, value);
+        if (command(sim) == MFRC522_CMD_CALC_CRC) {
+            calc_crc(sim);
+        }
+        break;
+    case MFRC522_FIFOLevelReg:
+        if ((value & MFRC522_FIFOLevelReg_FlushBuffer) != 0) {
+            fifo_flush(sim);
+        }
+        break;
+    case MFRC522_ControlReg:
+        if ((value & MFRC522_ControlReg_TStopNow) != 0) {
+            timer_stop(sim);
+        } else if ((value & MFRC522_ControlReg_TStartNow) != 0) {
+            timer_start(sim, vclockNow());
+        }
+        break;
+    case MFRC522_BitFramingReg:
+        sim->regs[reg] = value & (uint8_t)~MFRC522_BitFramingReg_StartSend;
+        if ((value & MFRC522_BitFramingReg_StartSend) != 0 &&
+            command(sim) == MFRC522_CMD_TRANSCEIVE) {
+            start_transmit(sim);
+        }
+        break;
+    case MFRC522_CollReg:
+        sim->regs[reg] = (uint8_t)((sim->regs[reg] & ~MFRC522_CollReg_ValuesAfterColl) |
+                                   (value & MFRC522_CollReg_ValuesAfterColl));
+        break;
+    case MFRC522_TxControlReg:
+        sim->regs[reg] = value;
+        field_update(sim);
+        break;
+    case MFRC522_ErrorReg:
+    case MFRC522_Status1Reg:
+    case MFRC522_TCounterValRegH:
+    case MFRC522_TCounterValRegL:
+    case MFRC522_VersionReg:
+        break;
+    default:
+        sim->regs[reg] = value;
+        break;
+    }
+}
+
+/*===========================================================================*/
+/* Exported functions.                                                       */
+/*===========================================================================*/
+
+/**
+ * @brief   Sets up a chip with NRSTPD held low and no cards.
+ *
+ * @param[in] timing    Timing model, @p NULL for the default.
+ */
+void mfrc522SimInit(MFRC522Sim *sim, const MFRC522SimTiming *timing) {
+    memset(sim, 0, sizeof(*sim));
+    sim->timing = timing != NULL ? *timing : mfrc522SimDefaultTiming;
+    sim->reset = true;
+    sim->seed = 1;
+    sim->accountedAt = vclockNow();
+    memcpy(sim->regs, reset_values, sizeof(sim->regs));
+}
+
+/**
+ * @brief   Puts a card in the list of cards which can enter the field.
+ * @details When it is in the field is set by @p card->arriveNs and
+ *          @p card->leaveNs.
+ */
+void mfrc522SimAddCard(MFRC522Sim *sim, PiccSim *card) {
+    card->next = sim->cards;
+    sim->cards = card;
+}
+
+void mfrc522SimRemoveCard(MFRC522Sim *sim, PiccSim *card) {
+    PiccSim **p;
+
+    for (p = &sim->cards; *p != NULL; p = &(*p)->next) {
+        if (*p == card) {
+            *p = card->next;
+            card->next = NULL;
+            return;
+        }
+    }
+}
+
+/**
+ * @brief   Applies the events which are due.
+ */
+void mfrc522SimSync(MFRC522Sim *sim) {
+    uint64_t now = vclockNow();
+
+    account(sim);
+    while (true) {
+        uint64_t underflow = timer_underflow_at(sim);
+        uint64_t t = 0;
+
+        if (sim->txEndAt != 0) {
+            t = sim->txEndAt;
+        }
+        if (sim->rxStartAt != 0 && (t == 0 || sim->rxStartAt < t)) {
+            t = sim->rxStartAt;
+        }
+        if (sim->rxEndAt != 0 && (t == 0 || sim->rxEndAt < t)) {
+            t = sim->rxEndAt;
+        }
+        if (sim->cmdDoneAt != 0 && (t == 0 || sim->cmdDoneAt < t)) {
+            t = sim->cmdDoneAt;
+        }
+        if (underflow != 0 && (t == 0 || underflow < t)) {
+            t = underflow;
+        }
+        if (t == 0 || t > now) {
+            break;
+        }
+
+        if (t == sim->txEndAt) {
+            sim->txEndAt = 0;
+            transmit_done(sim, t);
+        } else if (t == sim->rxStartAt) {
+            sim->rxStartAt = 0;
+            if ((sim->regs[MFRC522_TModeReg] & MFRC522_TModeReg_TAuto) != 0 &&
+                sim->timerStartAt != 0) {
+                timer_stop(sim);
+            }
+        } else if (t == sim->rxEndAt) {
+            sim->rxEndAt = 0;
+            receive_done(sim);
+        } else if (t == sim->cmdDoneAt) {
+            sim->cmdDoneAt = 0;
+            command_done(sim);
+        } else {
+            set_irq(sim, MFRC522_ComIrqReg_TimerIRq);
+            if ((sim->regs[MFRC522_TModeReg] & MFRC522_TModeReg_TAutoRestart) != 0) {
+                uint64_t period = timer_period(sim);
+
+                sim->timerStartAt += (now - sim->timerStartAt) / period * period;
+            } else {
+                sim->timerStartAt = 0;
+                sim->timerValue = 0;
+            }
+        }
+    }
+}
+
+/**
+ * @brief   Time of the next pending event, 0 if there is none.
+ * @details Nothing changes on the chip until then unless it is accessed.
+ */
+uint64_t mfrc522SimNextEvent(MFRC522Sim *sim) {
+    uint64_t events[] = {
+        sim->txEndAt, sim->rxStartAt, sim->rxEndAt, sim->cmdDoneAt,
+        timer_underflow_at(sim)
+    };
+    uint64_t t = 0;
+    size_t i;
+
+    mfrc522SimSync(sim);
+    for (i = 0; i < sizeof(events) / sizeof(events[0]); i++) {
+        if (events[i] != 0 && (t == 0 || events[i] < t)) {
+            t = events[i];
+        }
+    }
+    return t;
+}
+
+/**
+ * @brief   Drives the NRSTPD input, low is hard power-down.
+ */
+void mfrc522SimSetReset(MFRC522Sim *sim, bool asserted) {
+    mfrc522SimSync(sim);
+    if (asserted && !sim->reset) {
+        sim->reset = true;
+        cancel_events(sim);
+        field_update(sim);
+    } else if (!asserted && sim->reset) {
+        sim->reset = false;
+        power_on_reset(sim);
+        sim->readyAt = vclockNow() + sim->timing.startupNs;
+    }
+}
+
+/**
+ * @brief   Drives the NSS input, @p true starts an SPI frame.
+ */
+void mfrc522SimSelect(MFRC522Sim *sim, bool selected) {
+    mfrc522SimSync(sim);
+    sim->selected = selected;
+    sim->first = true;
+}
+
+/**
+ * @brief   Clocks one byte over SPI.
+ * @details The first byte of a frame is the address. In a read frame every
+ *          following byte is the next address and the data of the previous
+ *          one is returned, in a write frame all data bytes go to the
+ *          addressed register.
+ */
+uint8_t mfrc522SimSpiExchange(MFRC522Sim *sim, uint8_t mosi) {
+    uint8_t miso = 0;
+
+    mfrc522SimSync(sim);
+    if (!sim->selected || sim->reset) {
+        return 0;
+    }
+    if (sim->first) {
+        sim->first = false;
+    } else if ((sim->addr & MFRC522_SPI_READ) != 0) {
+        miso = read_reg(sim, MFRC522_SPI_REG(sim->addr));
+    } else {
+        write_reg(sim, MFRC522_SPI_REG(sim->addr), mosi);
+        return 0;
+    }
+    sim->addr = mosi;
+    return miso;
+}
+
+/**
+ * @brief   Level of the IRQ output as seen with the pull-down of the reader
+ *          board, the open drain output never drives it high.
+ */
+bool mfrc522SimIrq(MFRC522Sim *sim) {
+    bool level;
+
+    mfrc522SimSync(sim);
+    if (sim->reset) {
+        return false;
+    }
+    level = irq_active(sim) !=
+            ((sim->regs[MFRC522_ComIEnReg] & MFRC522_ComIEnReg_IRqInv) != 0);
+    return (sim->regs[MFRC522_DivIEnReg] & MFRC522_DivIEnReg_IRQPushPull) != 0 && level;
+}
@@ -0,0 +1,124 @@
+/**
+ * @file    mfrc522_sim.h
+ * @brief   Register level model of the NXP MFRC522 for the host build.
+ * @details The model is driven through the same pins as the chip on the
+ *          board: the SPI bus framed by RFID_SS, the RFID_RST (NRSTPD) input
+ *          and the RFID_IRQ output. It covers the register file with its
+ *          reset values, the FIFO with the water level alerts, the timer,
+ *          the CRC coprocessor, the command set and the 14443A framing
+ *          (CRC, bit oriented frames, bit collisions) at all four bit rates.
+ *          Virtual cards from @p picc_sim.h sit in the field.
+ *
+ *          All behaviour is timed on the virtual clock. The model is lazy:
+ *          pending events (end of transmission, response, timer underflow,
+ *          command completion) are applied when the chip is next accessed,
+ *          and @p mfrc522SimNextEvent() tells a waiting caller how far the
+ *          clock may jump.
+ *
+ *          MFAuthent checks the key against the card but Crypto1 itself is
+ *          not modelled, traffic after authentication stays in plain.
+ */
+
+#ifndef _MFRC522_SIM_H_
+#define _MFRC522_SIM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "drivers/mfrc522_regs.h"
+#include "picc_sim.h"
+
+/**
+ * @brief   Timing model of the chip and the cards.
+ */
+typedef struct {
+    uint32_t startupNs;             /**< Oscillator start after power-down. */
+    uint32_t bitNs;                 /**< One bit at 106 kbit/s, halved per
+                                         higher bit rate.                   */
+    uint32_t fdtNs;                 /**< Card frame delay time.             */
+    uint32_t piccReadyNs;           /**< Card power-up in the field.        */
+    uint32_t crcByteNs;             /**< CalcCRC per byte.                  */
+    uint32_t randomNs;              /**< GenerateRandomID.                  */
+    uint32_t authNs;                /**< MFAuthent.                         */
+} MFRC522SimTiming;
+
+/**
+ * @brief   Activity counters.
+ */
+typedef struct {
+    uint64_t fieldOnNs;             /**< Time with the RF field on.         */
+    uint64_t powerDownNs;           /**< Time in soft or hard power-down.   */
+    uint32_t framesSent;
+    uint32_t framesReceived;
+    uint32_t collisions;
+    uint32_t rfErrors;              /**< Parity, CRC and SOF errors.        */
+} MFRC522SimStats;
+
+/**
+ * @brief   One chip.
+ * @note    Only the configuration and @p stats are meant to be accessed
+ *          directly.
+ */
+typedef struct {
+    MFRC522SimTiming timing;
+    MFRC522SimStats stats;
+    PiccSim *cards;                 /**< Cards which can enter the field.   */
+    /**
+     * @brief   Called when a frame goes on air, for tracing. Optional.
+     */
+    void (*onTransmit)(void *ctx, const uint8_t *frame, size_t bits);
+    void *hookCtx;
+
+    uint8_t regs[MFRC522_REGISTER_COUNT];
+    uint8_t fifo[MFRC522_FIFO_SIZE];
+    size_t fifolen;
+    uint8_t mem[25];                /**< Internal buffer of the Mem command. */
+    bool reset;                     /**< NRSTPD held low.                   */
+    uint64_t readyAt;               /**< Oscillator running from then on.   */
+    uint64_t accountedAt;           /**< Stats updated up to this time.     */
+    bool field;
+    uint64_t fieldOnAt;
+    uint32_t seed;
+
+    /* SPI frame in progress. */
+    bool selected;
+    bool first;
+    uint8_t addr;
+
+    /* Pending events, 0 if none. */
+    uint64_t txEndAt;
+    uint64_t rxStartAt;
+    uint64_t rxEndAt;
+    uint64_t cmdDoneAt;
+    uint64_t timerStartAt;          /**< Timer (re)loaded, 0 if stopped.    */
+    uint16_t timerValue;            /**< Counter value while stopped.       */
+    uint16_t crc;                   /**< Running CalcCRC value.             */
+    bool authOk;                    /**< Outcome of the running MFAuthent.  */
+    uint8_t tx[PICC_SIM_FRAME_SIZE];
+    size_t txbits;
+    PiccSimResponse rx;
+    uint8_t rxcollision;            /**< 1-based, 0 without a collision.    */
+} MFRC522Sim;
+
+/**
+ * @brief   Default timing: 13.56 MHz carrier, MIFARE like cards.
+ */
+extern const MFRC522SimTiming mfrc522SimDefaultTiming;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void mfrc522SimInit(MFRC522Sim *sim, const MFRC522SimTiming *timing);
+  void mfrc522SimAddCard(MFRC522Sim *sim, PiccSim *card);
+  void mfrc522SimRemoveCard(MFRC522Sim *sim, PiccSim *card);
+  void mfrc522SimSetReset(MFRC522Sim *sim, bool asserted);
+  void mfrc522SimSelect(MFRC522Sim *sim, bool selected);
+  uint8_t mfrc522SimSpiExchange(MFRC522Sim *sim, uint8_t mosi);
+  bool mfrc522SimIrq(MFRC522Sim *sim);
+  uint64_t mfrc522SimNextEvent(MFRC522Sim *sim);
+  void mfrc522SimSync(MFRC522Sim *sim);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _MFRC522_SIM_H_ */
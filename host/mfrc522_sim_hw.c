@@ -0,0 +1,124 @@
+/**
+ * @file    mfrc522_sim_hw.c
+ * @brief   MFRC522 transport onto the chip model.
+ * @details Mirrors the board transport: transfers of up to
+ *          @p MFRC522_SHORT_TRANSFER bytes are clocked by the CPU, longer
+ *          ones by DMA while the thread sleeps, and the thread sleeps on the
+ *          IRQ line. The costs below are charged to the virtual clock.
+ */
+
+#include "mfrc522_sim_hw.h"
+#include "vclock.h"
+
+/* SPI at 6 MHz. */
+#if !defined(SIM_SPI_BYTE_NS)
+#define SIM_SPI_BYTE_NS             1333
+#endif
+/* Taking and releasing the bus mutex. */
+#if !defined(SIM_SPI_ACQUIRE_NS)
+#define SIM_SPI_ACQUIRE_NS          500
+#endif
+/* Toggling the chip select around a transfer. */
+#if !defined(SIM_SPI_SELECT_NS)
+#define SIM_SPI_SELECT_NS           250
+#endif
+/* DMA set-up, completion interrupt and switch back to the thread. */
+#if !defined(SIM_SPI_DMA_NS)
+#define SIM_SPI_DMA_NS              4000
+#endif
+/* EXT interrupt and switch to the waiting thread. */
+#if !defined(SIM_IRQ_WAKEUP_NS)
+#define SIM_IRQ_WAKEUP_NS           3000
+#endif
+
+static void charge_cpu(MFRC522SimBus *bus, uint64_t ns) {
+    bus->stats.cpuNs += ns;
+    vclockAdvance(ns);
+}
+
+/**
+ * @brief   One chip-select framed transfer, clocked a byte at a time so the
+ *          chip sees the bytes at the right moments.
+ */
+static void transfer(MFRC522SimBus *bus, size_t n, const uint8_t *txbuf,
+                     uint8_t *rxbuf) {
+    bool dma = n > MFRC522_SHORT_TRANSFER;
+    size_t i;
+
+    charge_cpu(bus, SIM_SPI_SELECT_NS);
+    mfrc522SimSelect(bus->chip, true);
+    for (i = 0; i < n; i++) {
+        uint8_t miso = mfrc522SimSpiExchange(bus->chip, txbuf[i]);
+
+        if (rxbuf != NULL) {
+            rxbuf[i] = miso;
+        }
+        bus->stats.busNs += SIM_SPI_BYTE_NS;
+        if (dma) {
+            vclockAdvance(SIM_SPI_BYTE_NS);
+        } else {
+            charge_cpu(bus, SIM_SPI_BYTE_NS);
+        }
+    }
+    mfrc522SimSelect(bus->chip, false);
+    if (dma) {
+        charge_cpu(bus, SIM_SPI_DMA_NS);
+    }
+}
+
+static void sim_exchange(void *ctx, size_t n, const uint8_t *txbuf,
+                         uint8_t *rxbuf) {
+    MFRC522SimBus *bus = ctx;
+
+    charge_cpu(bus, SIM_SPI_ACQUIRE_NS);
+    transfer(bus, n, txbuf, rxbuf);
+}
+
+static void sim_exchange_sequence(void *ctx, const uint8_t *seq) {
+    MFRC522SimBus *bus = ctx;
+
+    charge_cpu(bus, SIM_SPI_ACQUIRE_NS);
+    for (; *seq != MFRC522_SEQ_END; seq += *seq + 1) {
+        transfer(bus, *seq, seq + 1, NULL);
+    }
+}
+
+/**
+ * @brief   Sleeps until the IRQ line goes high, jumping from one chip event
+ *          to the next.
+ */
+static bool sim_wait_irq(void *ctx, uint32_t timeout) {
+    MFRC522SimBus *bus = ctx;
+    uint64_t start = vclockNow();
+    uint64_t deadline = start + (uint64_t)timeout * 1000;
+
+    while (!mfrc522SimIrq(bus->chip)) {
+        uint64_t next = mfrc522SimNextEvent(bus->chip);
+
+        if (next == 0 || next > deadline) {
+            bus->stats.sleepNs += deadline - vclockNow();
+            vclockAdvance(deadline - vclockNow());
+            return mfrc522SimIrq(bus->chip);
+        }
+        bus->stats.sleepNs += next - vclockNow();
+        vclockAdvance(next - vclockNow());
+    }
+    if (vclockNow() > start) {
+        bus->stats.irqWakeups++;
+        charge_cpu(bus, SIM_IRQ_WAKEUP_NS);
+    }
+    return true;
+}
+
+static void sim_set_reset(void *ctx, bool asserted) {
+    MFRC522SimBus *bus = ctx;
+
+    mfrc522SimSetReset(bus->chip, asserted);
+}
+
+const MFRC522Transport mfrc522SimTransport = {
+    sim_exchange,
+    sim_exchange_sequence,
+    sim_wait_irq,
+    sim_set_reset
+};
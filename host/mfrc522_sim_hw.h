@@ -0,0 +1,33 @@
+/**
+ * @file    mfrc522_sim_hw.h
+ * @brief   MFRC522 transport onto the chip model, the host counterpart of
+ *          @p drivers/mfrc522_hw.h.
+ */
+
+#ifndef _MFRC522_SIM_HW_H_
+#define _MFRC522_SIM_HW_H_
+
+#include "drivers/mfrc522.h"
+#include "mfrc522_sim.h"
+
+/**
+ * @brief   Where the virtual time went.
+ */
+typedef struct {
+    uint64_t busNs;                 /**< SPI clocking.                      */
+    uint64_t cpuNs;                 /**< CPU busy with transfers and wake-ups. */
+    uint64_t sleepNs;               /**< Thread asleep waiting on the IRQ.  */
+    uint32_t irqWakeups;
+} MFRC522SimBusStats;
+
+/**
+ * @brief   Transport context: the chip and the bus accounting.
+ */
+typedef struct {
+    MFRC522Sim *chip;
+    MFRC522SimBusStats stats;
+} MFRC522SimBus;
+
+extern const MFRC522Transport mfrc522SimTransport;
+
+#endif /* _MFRC522_SIM_HW_H_ */
@@ -0,0 +1,398 @@
+/**
+ * @file    outbox_bench.c
+ * @brief   Frames and bytes spent on events with and without coalescing.
+ * @details The reader runs the protocol over the DMA link on the simulated
+ *          USART with its events going through the outbox, the controller
+ *          stand-in answers every card arrival with a feedback command.
+ *
+ *          One card at a time is presented, 0 to @p CARD_GAP_US after the
+ *          previous one left, and leaves @p HOLD_MIN_US to
+ *          @p HOLD_MAX_US later. Each feedback is acknowledged with a
+ *          feedback done event and the door strike pulls the supply down
+ *          for a burst of @p SAG_EVENTS supply warnings. A marginal power
+ *          supply and a loose tamper switch add a warning every 0 to
+ *          @p NOISE_GAP_US.
+ *
+ *          Every run reports the frames per second and the line bytes per
+ *          event the reader sends, and the latency of the card arrivals and
+ *          of the telemetry. It fails if an event is lost, duplicated or
+ *          reordered.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "link/proto.h"
+#include "reader/event.h"
+#include "reader/outbox.h"
+#include "controller_sim.h"
+#include "uart_sim.h"
+#include "vclock.h"
+
+#define BITRATE                     115200
+#define TURNAROUND_US               500
+#define WINDOW                      4
+#define DURATION_US                 120000000
+#define UID_LEN                     7
+
+#define CARD_GAP_US                 1000000
+#define HOLD_MIN_US                 300000
+#define HOLD_MAX_US                 800000
+#define SAG_EVENTS                  6
+#define SAG_GAP_US                  3000
+#define NOISE_GAP_US                100000
+
+/* Gives up on the missing events after this long. */
+#define DRAIN_US                    2000000
+
+#define CARDS_MAX                   (DURATION_US / HOLD_MIN_US + 1)
+#define TELEMETRY_MAX               (CARDS_MAX * SAG_EVENTS +               \
+                                     DURATION_US / NOISE_GAP_US * 8 + 64)
+#define LATENCIES_MAX               (3 * CARDS_MAX + TELEMETRY_MAX)
+
+static const uint32_t coalesce[] = {0, 2000, 10000, 20000, 50000};
+
+static UartSim sim;
+static LinkDriver link;
+static const LinkConfig linkConfig = {&uartSimTransport, &sim};
+static ControllerSim controller;
+
+/* Reader. */
+static Proto proto;
+static ProtoConfig config;
+static ReaderOutbox outbox;
+static uint32_t seed;
+static uint32_t frames;
+static uint32_t bytes;
+
+/* Events generated, and when. */
+static uint32_t cards;
+static uint32_t cardDue;
+static uint32_t goneDue;
+static bool present;
+static uint32_t cardAt[CARDS_MAX];
+static uint32_t goneAt[CARDS_MAX];
+static uint32_t doneAt[CARDS_MAX];
+static uint32_t dones;
+static uint32_t telemetry;
+static uint32_t telemetryAt[TELEMETRY_MAX];
+static uint32_t noiseDue;
+static uint32_t sagDue;
+static uint32_t sagLeft;
+
+/* Events received by the controller. */
+static uint32_t arrivals;
+static uint32_t departures;
+static uint32_t doneReceived;
+static uint32_t telemetryReceived;
+static uint64_t urgent[CARDS_MAX];
+static uint64_t background[LATENCIES_MAX];
+static uint32_t backgroundCount;
+
+static bool failed;
+
+static uint32_t random_below(uint32_t n) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % n;
+}
+
+static bool due(uint32_t at) {
+    return (int32_t)(at - platformNowUs()) <= 0;
+}
+
+static uint32_t number(const uint8_t *uid) {
+    return (uint32_t)uid[0] << 24 | (uint32_t)uid[1] << 16 |
+           (uint32_t)uid[2] << 8 | uid[3];
+}
+
+static void put(uint8_t type, uint32_t n) {
+    ReaderEvent event;
+    uint8_t payload[READER_EVENT_MAX_SIZE];
+    size_t len;
+
+    memset(&event, 0, sizeof(event));
+    event.type = type;
+    event.value = (uint16_t)n;
+    event.card.uidlen = UID_LEN;
+    event.card.uid[0] = (uint8_t)(n >> 24);
+    event.card.uid[1] = (uint8_t)(n >> 16);
+    event.card.uid[2] = (uint8_t)(n >> 8);
+    event.card.uid[3] = (uint8_t)n;
+    event.card.uid[4] = 0x5A;
+    event.card.sak = 0x08;
+    event.card.atqa[0] = 0x44;
+    len = readerEventEncode(&event, payload, sizeof(payload));
+    if (!readerOutboxPut(&outbox, payload, len,
+                         readerOutboxPriority(type))) {
+        failed = true;
+    }
+}
+
+static void put_telemetry(void) {
+    if (telemetry == TELEMETRY_MAX) {
+        return;
+    }
+    telemetryAt[telemetry] = platformNowUs();
+    put(telemetry % 5 == 4 ? READER_EVENT_TAMPER : READER_EVENT_SUPPLY,
+        telemetry);
+    telemetry++;
+}
+
+static void reader_send(void *arg, const uint8_t *frame, size_t len) {
+    frames++;
+    bytes += (uint32_t)len;
+    linkSend(arg, frame, len);
+}
+
+static void reader_receive(void *arg, uint8_t type, const uint8_t *payload,
+                           size_t len) {
+    uint32_t n;
+
+    (void)arg;
+
+    if (type != PROTO_MSG_FEEDBACK || len != 1 + UID_LEN ||
+        payload[0] != UID_LEN) {
+        failed = true;
+        return;
+    }
+    n = number(&payload[1]);
+    if (n != dones) {
+        failed = true;
+        return;
+    }
+    doneAt[dones++] = platformNowUs();
+    put(READER_EVENT_FEEDBACK_DONE, n);
+    sagLeft = SAG_EVENTS;
+    sagDue = platformNowUs();
+}
+
+static uint32_t reader_service(void *arg) {
+    (void)arg;
+
+    return readerOutboxService(&outbox);
+}
+
+/**
+ * @brief   Puts the events due.
+ * @return  Microseconds until the next one.
+ */
+static uint32_t generate(bool more) {
+    uint32_t now = platformNowUs();
+    uint32_t next = NOISE_GAP_US;
+
+    if (more && !present && due(cardDue) && cards < CARDS_MAX) {
+        cardAt[cards] = now;
+        put(READER_EVENT_CARD, cards);
+        goneDue = now + HOLD_MIN_US +
+                  random_below(HOLD_MAX_US - HOLD_MIN_US);
+        present = true;
+    }
+    if (present && due(goneDue)) {
+        goneAt[cards] = now;
+        put(READER_EVENT_CARD_GONE, cards);
+        cards++;
+        cardDue = now + random_below(CARD_GAP_US);
+        present = false;
+    }
+    while (sagLeft > 0 && due(sagDue)) {
+        put_telemetry();
+        sagLeft--;
+        sagDue += SAG_GAP_US;
+    }
+    if (more && due(noiseDue)) {
+        put_telemetry();
+        noiseDue = now + random_below(NOISE_GAP_US);
+    }
+
+    if (more && !present && cardDue - now < next) {
+        next = cardDue - now;
+    }
+    if (present && goneDue - now < next) {
+        next = goneDue - now;
+    }
+    if (sagLeft > 0 && sagDue - now < next) {
+        next = sagDue - now;
+    }
+    if (more && noiseDue - now < next) {
+        next = noiseDue - now;
+    }
+    return next;
+}
+
+/**
+ * @brief   Time to run the protocol for before generating events again, a
+ *          feedback received meanwhile starts a supply sag.
+ */
+static uint32_t run_for(uint32_t next) {
+    return next < SAG_GAP_US ? next : SAG_GAP_US;
+}
+
+static void controller_event(ControllerSim *csp, size_t reader,
+                             const uint8_t *event, size_t len) {
+    uint32_t now = platformNowUs();
+    uint32_t n;
+
+    (void)csp;
+    (void)reader;
+
+    if (event[0] == READER_EVENT_TAMPER || event[0] == READER_EVENT_SUPPLY) {
+        n = len == 4 ? (uint32_t)event[2] << 8 | event[3] : UINT32_MAX;
+        if (n != telemetryReceived || n >= telemetry) {
+            failed = true;
+            return;
+        }
+        telemetryReceived++;
+        background[backgroundCount++] = now - telemetryAt[n];
+        return;
+    }
+    if (len < 3 + 4 || event[2] != UID_LEN) {
+        failed = true;
+        return;
+    }
+    n = number(&event[3]);
+    switch (event[0]) {
+    case READER_EVENT_CARD:
+        if (n != arrivals) {
+            failed = true;
+            return;
+        }
+        urgent[arrivals++] = now - cardAt[n];
+        break;
+    case READER_EVENT_CARD_GONE:
+        if (n != departures || n >= cards) {
+            failed = true;
+            return;
+        }
+        departures++;
+        background[backgroundCount++] = now - goneAt[n];
+        break;
+    case READER_EVENT_FEEDBACK_DONE:
+        if (n != doneReceived || n >= dones) {
+            failed = true;
+            return;
+        }
+        doneReceived++;
+        background[backgroundCount++] = now - doneAt[n];
+        break;
+    default:
+        failed = true;
+    }
+}
+
+static void setup(uint32_t window) {
+    uartSimInit(&sim, BITRATE, &link);
+    linkObjectInit(&link);
+    linkStart(&link, &linkConfig);
+
+    memset(&config, 0, sizeof(config));
+    config.send = reader_send;
+    config.receive = reader_receive;
+    config.service = reader_service;
+    config.arg = &link;
+    config.window = WINDOW;
+    config.retransmit = PROTO_RETRANSMIT_US;
+    protoInit(&proto, &config);
+    readerOutboxInit(&outbox, &proto, NULL, NULL);
+    outbox.coalesce = window;
+
+    controllerSimInit(&controller, &sim, WINDOW, PROTO_RETRANSMIT_US);
+    controller.turnaround = TURNAROUND_US;
+    controller.event = controller_event;
+
+    seed = 1;
+    frames = 0;
+    bytes = 0;
+    cards = 0;
+    dones = 0;
+    telemetry = 0;
+    present = false;
+    sagLeft = 0;
+    arrivals = 0;
+    departures = 0;
+    doneReceived = 0;
+    telemetryReceived = 0;
+    backgroundCount = 0;
+    cardDue = platformNowUs();
+    noiseDue = platformNowUs();
+}
+
+static int compare(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void report_latency(uint64_t *latency, uint32_t n) {
+    if (n == 0) {
+        printf("     -      -");
+        return;
+    }
+    qsort(latency, n, sizeof(latency[0]), compare);
+    printf("  %5.1f  %5.1f", latency[(n * 99 + 99) / 100 - 1] / 1000.0,
+           latency[n - 1] / 1000.0);
+}
+
+static void run(uint32_t window) {
+    uint32_t start;
+    uint32_t events;
+    uint32_t elapsed;
+
+    setup(window);
+    start = platformNowUs();
+    while (platformElapsedUs(start) < DURATION_US) {
+        protoRun(&proto, &link, run_for(generate(true)));
+    }
+    elapsed = platformElapsedUs(start);
+    /* The card on the reader leaves, the last burst ends. */
+    while ((present || sagLeft > 0 || outbox.count > 0 ||
+            protoInFlight(&proto) > 0 || doneReceived < dones) &&
+           platformElapsedUs(start) - elapsed < DRAIN_US) {
+        protoRun(&proto, &link, run_for(generate(false)));
+    }
+    controllerSimStop(&controller);
+    linkStop(&link);
+    uartSimRun(&sim);
+
+    events = outbox.stats.events;
+    if (arrivals != cards || departures != cards || dones != cards ||
+        doneReceived != dones || telemetryReceived != telemetry ||
+        controller.stats.misordered != 0 || outbox.stats.dropped != 0 ||
+        events != 3 * cards + telemetry) {
+        failed = true;
+    }
+
+    if (window == 0) {
+        printf("      off");
+    } else {
+        printf("  %4u ms", (unsigned)(window / 1000));
+    }
+    printf("  %8.1f  %7.1f  %6.2f  %5.2f", frames / (elapsed / 1e6),
+           (double)bytes / events,
+           (double)events / controller.stats.eventFrames,
+           proto.stats.acks / (elapsed / 1e6));
+    report_latency(urgent, arrivals);
+    report_latency(background, backgroundCount);
+    printf("\n");
+}
+
+int main(void) {
+    size_t i;
+
+    printf("outbox-bench (%u s of a busy door, %u bit/s, window %u)\n",
+           DURATION_US / 1000000, BITRATE, WINDOW);
+    printf("                                          "
+           "- arrival ms -  - telemetry ms -\n");
+    printf("  coalesce  frames/s  B/event  ev/msg  acks/s"
+           "    p99    max     p99    max\n");
+    for (i = 0; i < sizeof(coalesce) / sizeof(coalesce[0]); i++) {
+        run(coalesce[i]);
+    }
+    if (failed) {
+        fprintf(stderr, "outbox-bench: events lost, duplicated, reordered "
+                        "or dropped\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,246 @@
+/**
+ * @file    picc_sim.c
+ * @brief   Scripted ISO/IEC 14443 type A cards for the MFRC522 model.
+ */
+
+#include <string.h>
+
+#include "picc_sim.h"
+
+#define CMD_REQA                    0x26
+#define CMD_WUPA                    0x52
+#define CMD_HLTA                    0x50
+#define CASCADE_TAG                 0x88
+#define NVB_SELECT                  0x70
+#define SAK_CASCADE                 0x04
+
+static const uint8_t sel_codes[] = {0x93, 0x95, 0x97};
+
+static unsigned levels(const PiccSim *card) {
+    return card->uidlen == 4 ? 1 : card->uidlen == 7 ? 2 : 3;
+}
+
+/**
+ * @brief   UID bytes of a cascade level followed by the BCC.
+ */
+static void level_bytes(const PiccSim *card, unsigned level, uint8_t *out) {
+    if (level + 1 == levels(card)) {
+        memcpy(out, &card->uid[level * 3], 4);
+    } else {
+        out[0] = CASCADE_TAG;
+        memcpy(&out[1], &card->uid[level * 3], 3);
+    }
+    out[4] = out[0] ^ out[1] ^ out[2] ^ out[3];
+}
+
+static bool crc_ok(const uint8_t *frame, size_t len) {
+    uint16_t crc;
+
+    if (len < 2) {
+        return false;
+    }
+    crc = piccSimCrcA(frame, len - 2, 0x6363);
+    return frame[len - 2] == (uint8_t)crc && frame[len - 1] == (uint8_t)(crc >> 8);
+}
+
+static void respond_bytes(PiccSimResponse *response, const uint8_t *data,
+                          size_t len, bool crc) {
+    memcpy(response->data, data, len);
+    if (crc) {
+        uint16_t value = piccSimCrcA(data, len, 0x6363);
+
+        response->data[len] = (uint8_t)value;
+        response->data[len + 1] = (uint8_t)(value >> 8);
+        len += 2;
+    }
+    response->bits = len * 8;
+}
+
+/**
+ * @brief   Invalid frames send the card back to IDLE, or to HALT if it was
+ *          woken up from there.
+ */
+static void abort_session(PiccSim *card) {
+    card->state = card->halted ? PICC_SIM_HALT : PICC_SIM_IDLE;
+    card->level = 0;
+}
+
+static void anticollision(PiccSim *card, const uint8_t *frame, size_t bits,
+                          PiccSimResponse *response) {
+    uint8_t level[5];
+    uint8_t nvb = frame[1];
+    size_t known = ((size_t)(nvb >> 4) - 2) * 8 + (nvb & 0x07);
+    size_t i;
+
+    level_bytes(card, card->level, level);
+
+    if (nvb == NVB_SELECT) {
+        if (bits != 9 * 8 || !crc_ok(frame, 9) ||
+            memcmp(&frame[2], level, 5) != 0) {
+            /* Addressed to another card. */
+            return;
+        }
+        if (card->level + 1U < levels(card)) {
+            uint8_t sak = SAK_CASCADE;
+
+            card->level++;
+            respond_bytes(response, &sak, 1, true);
+        } else {
+            card->state = PICC_SIM_ACTIVE;
+            respond_bytes(response, &card->sak, 1, true);
+        }
+        return;
+    }
+
+    if ((nvb >> 4) < 2 || known >= 40 || bits != 16 + known) {
+        abort_session(card);
+        return;
+    }
+    for (i = 0; i < known; i++) {
+        if (((frame[2 + i / 8] ^ level[i / 8]) >> (i % 8)) & 1) {
+            return;
+        }
+    }
+    /* The remaining bits of the level, starting mid-byte if need be. */
+    memset(response->data, 0, sizeof(response->data));
+    for (i = known; i < 40; i++) {
+        size_t bit = i - known;
+
+        if ((level[i / 8] >> (i % 8)) & 1) {
+            response->data[bit / 8] |= (uint8_t)(1 << (bit % 8));
+        }
+    }
+    response->bits = 40 - known;
+}
+
+static void apply_fault(PiccSim *card, PiccSimResponse *response) {
+    piccsimfault_t fault = PICC_SIM_FAULT_NONE;
+
+    if (card->responses < card->scriptLen) {
+        fault = card->script[card->responses];
+    }
+    card->responses++;
+    if (fault == PICC_SIM_FAULT_NONE && card->faultPermille > 0) {
+        card->seed = card->seed * 1103515245 + 12345;
+        if ((card->seed >> 16) % 1000 < card->faultPermille) {
+            fault = card->randomFault;
+        }
+    }
+
+    response->fault = fault;
+    switch (fault) {
+    case PICC_SIM_FAULT_SILENT:
+        response->bits = 0;
+        break;
+    case PICC_SIM_FAULT_CRC:
+        response->data[response->bits >= 8 ? response->bits / 8 - 1 : 0] ^= 0x01;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief   Sets up a card.
+ * @details The ATQA announces the UID size, the card is present from time 0
+ *          on, accepts the transport key FF..FF and does not inject faults.
+ */
+void piccSimInit(PiccSim *card, const uint8_t *uid, uint8_t uidlen,
+                 uint8_t sak) {
+    size_t i;
+
+    memset(card, 0, sizeof(*card));
+    memcpy(card->uid, uid, uidlen);
+    card->uidlen = uidlen;
+    card->atqa[0] = (uint8_t)(((levels(card) - 1) << 6) | 0x04);
+    card->atqa[1] = 0x00;
+    card->sak = sak;
+    memset(card->key, 0xFF, sizeof(card->key));
+    card->seed = 1;
+    for (i = 0; i < uidlen; i++) {
+        card->seed = card->seed * 31 + uid[i];
+    }
+}
+
+/**
+ * @brief   Powers the card up in IDLE.
+ *
+ * @param[in] session   Identifies the power-up, the card keeps its state as
+ *                      long as it is called with the same value.
+ */
+void piccSimPowerUp(PiccSim *card, uint64_t session) {
+    if (card->session != session) {
+        card->session = session;
+        card->state = PICC_SIM_IDLE;
+        card->halted = false;
+        card->level = 0;
+    }
+}
+
+/**
+ * @brief   Runs a frame received from the PCD through the card.
+ *
+ * @param[in] frame     Frame as sent, including the CRC if any.
+ * @param[in] bits      Length of @p frame in bits.
+ */
+void piccSimRespond(PiccSim *card, const uint8_t *frame, size_t bits,
+                    PiccSimResponse *response) {
+    size_t len = bits / 8;
+
+    memset(response, 0, sizeof(*response));
+
+    if (bits == 7) {
+        uint8_t cmd = frame[0] & 0x7F;
+
+        if ((cmd == CMD_REQA && card->state == PICC_SIM_IDLE) ||
+            (cmd == CMD_WUPA && (card->state == PICC_SIM_IDLE ||
+                                 card->state == PICC_SIM_HALT))) {
+            card->halted = card->state == PICC_SIM_HALT;
+            card->state = PICC_SIM_READY;
+            card->level = 0;
+            respond_bytes(response, card->atqa, 2, false);
+        } else if (card->state != PICC_SIM_HALT && card->state != PICC_SIM_IDLE) {
+            abort_session(card);
+        }
+    } else if (card->state == PICC_SIM_READY) {
+        if (bits >= 16 && frame[0] == sel_codes[card->level]) {
+            anticollision(card, frame, bits, response);
+        } else {
+            abort_session(card);
+        }
+    } else if (card->state == PICC_SIM_ACTIVE) {
+        if (bits == 4 * 8 && frame[0] == CMD_HLTA && frame[1] == 0x00 &&
+            crc_ok(frame, 4)) {
+            card->state = PICC_SIM_HALT;
+        } else if (bits % 8 == 0 && card->handler != NULL && crc_ok(frame, len)) {
+            uint8_t data[PICC_SIM_FRAME_SIZE];
+            size_t n = card->handler(card, frame, len - 2, data);
+
+            if (n > 0) {
+                respond_bytes(response, data, n, true);
+            }
+        } else {
+            abort_session(card);
+        }
+    }
+
+    if (response->bits > 0) {
+        apply_fault(card, response);
+    }
+}
+
+/**
+ * @brief   CRC_A of ISO/IEC 14443-3, transmitted low byte first.
+ */
+uint16_t piccSimCrcA(const uint8_t *data, size_t len, uint16_t preset) {
+    uint16_t crc = preset;
+
+    while (len-- > 0) {
+        uint8_t ch = (uint8_t)(*data++ ^ (uint8_t)crc);
+
+        ch ^= (uint8_t)(ch << 4);
+        crc = (uint16_t)((crc >> 8) ^ ((uint16_t)ch << 8) ^
+                         ((uint16_t)ch << 3) ^ (ch >> 4));
+    }
+    return crc;
+}
@@ -0,0 +1,112 @@
+/**
+ * @file    picc_sim.h
+ * @brief   Scripted ISO/IEC 14443 type A cards for the MFRC522 model.
+ * @details A card implements the ISO/IEC 14443-3 state machine (IDLE,
+ *          READY, ACTIVE, HALT) with single, double and triple size UIDs.
+ *          Frames sent to an active card other than HLTA are passed to an
+ *          optional application handler, which is where higher protocol
+ *          layers are modelled.
+ *
+ *          Each card is present in the field during a window of virtual
+ *          time and can be scripted to corrupt or drop its responses.
+ */
+
+#ifndef _PICC_SIM_H_
+#define _PICC_SIM_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief   Longest frame a card sends or receives, including the CRC.
+ */
+#define PICC_SIM_FRAME_SIZE         (64 + 2)
+
+/**
+ * @brief   Faults a card can inject into its response.
+ */
+typedef enum {
+    PICC_SIM_FAULT_NONE = 0,        /**< Correct response.                  */
+    PICC_SIM_FAULT_SILENT = 1,      /**< No response at all.                */
+    PICC_SIM_FAULT_PARITY = 2,      /**< Parity error in the first byte.    */
+    PICC_SIM_FAULT_CRC = 3,         /**< Flipped bit in the last byte.      */
+    PICC_SIM_FAULT_SOF = 4,         /**< Malformed start of frame.          */
+} piccsimfault_t;
+
+typedef enum {
+    PICC_SIM_IDLE = 0,
+    PICC_SIM_READY = 1,
+    PICC_SIM_ACTIVE = 2,
+    PICC_SIM_HALT = 3,
+} piccsimstate_t;
+
+/**
+ * @brief   Response of a card to one frame, LSB first as on air.
+ */
+typedef struct {
+    uint8_t data[PICC_SIM_FRAME_SIZE];
+    size_t bits;                    /**< 0 if the card stays silent.        */
+    piccsimfault_t fault;
+} PiccSimResponse;
+
+typedef struct PiccSim PiccSim;
+
+/**
+ * @brief   Handles a frame sent to an active card.
+ *
+ * @param[in] frame     Frame without its CRC, which has been checked.
+ * @param[out] response Response without CRC, the card appends it. Holds up
+ *                      to @p PICC_SIM_FRAME_SIZE - 2 bytes.
+ * @return  Length of @p response in bytes, 0 to stay silent.
+ */
+typedef size_t (*piccsimhandler_t)(PiccSim *card, const uint8_t *frame,
+                                   size_t len, uint8_t *response);
+
+struct PiccSim {
+    /* Configuration, see piccSimInit(). */
+    uint8_t uid[10];
+    uint8_t uidlen;                 /**< 4, 7 or 10.                        */
+    uint8_t atqa[2];
+    uint8_t sak;                    /**< SAK of the last cascade level.     */
+    uint8_t key[6];                 /**< MIFARE key accepted by MFAuthent.  */
+    uint64_t arriveNs;              /**< Enters the field at this time.     */
+    uint64_t leaveNs;               /**< Leaves the field, 0 for never.     */
+    /**
+     * @brief   Faults applied to the responses in order, the first response
+     *          of the card gets @p script[0].
+     */
+    const piccsimfault_t *script;
+    size_t scriptLen;
+    /**
+     * @brief   Probability of @p randomFault per response, in per mille.
+     */
+    uint16_t faultPermille;
+    piccsimfault_t randomFault;
+    piccsimhandler_t handler;
+    void *app;                      /**< Free for the handler.              */
+
+    /* State. */
+    piccsimstate_t state;
+    bool halted;                    /**< READY entered from HALT.           */
+    uint8_t level;                  /**< Cascade level being selected.      */
+    uint64_t session;               /**< Power-up time of the current state. */
+    uint32_t responses;
+    uint32_t seed;
+    PiccSim *next;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void piccSimInit(PiccSim *card, const uint8_t *uid, uint8_t uidlen,
+                   uint8_t sak);
+  void piccSimPowerUp(PiccSim *card, uint64_t session);
+  void piccSimRespond(PiccSim *card, const uint8_t *frame, size_t bits,
+                      PiccSimResponse *response);
+  uint16_t piccSimCrcA(const uint8_t *data, size_t len, uint16_t preset);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _PICC_SIM_H_ */
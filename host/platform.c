@@ -0,0 +1,171 @@
+/**
+ * @file    platform.c
+ * @brief   Host implementation of the platform services on the virtual clock.
+ * @details Delays shorter than @p PLATFORM_TICK_DELAY_US end on the
+ *          microsecond as on the firmware with its GPT timers, longer ones
+ *          are rounded the way the kernel rounds them, so settings such as
+ *          @p CH_CFG_ST_FREQUENCY show in the host benchmarks. Built with
+ *          @p HAL_USE_GPT set to @p FALSE, all delays and the clock have the
+ *          system tick resolution, as the firmware had before the GPT
+ *          timers.
+ *
+ *          One-shot timers expire while the virtual clock moves past them.
+ *          @p platformCycles() is not virtual, it counts the cycles of the
+ *          build machine, or its nanoseconds if it has no cycle counter.
+ */
+
+#include <time.h>
+
+#include "chconf.h"
+#include "halconf.h"
+#include "platform.h"
+#include "vclock.h"
+
+#define US_PER_TICK                 (1000000U / CH_CFG_ST_FREQUENCY)
+#define NS_PER_TICK                 (US_PER_TICK * 1000U)
+
+#if !defined(PLATFORM_TICK_DELAY_US)
+#define PLATFORM_TICK_DELAY_US      20000
+#endif
+
+static uint64_t now_ns;
+
+/**
+ * @brief   Armed timers, the first one expires first.
+ */
+static PlatformTimer *armed;
+
+/**
+ * @brief   Deadline of @p tp in ns, deadlines are on the microsecond clock.
+ */
+static uint64_t deadline_ns(const PlatformTimer *tp) {
+    uint32_t left = tp->deadline - (uint32_t)(now_ns / 1000U);
+
+    return (now_ns / 1000U + left) * 1000U;
+}
+
+uint64_t vclockNow(void) {
+    return now_ns;
+}
+
+/**
+ * @brief   Moves the clock, expiring the timers on the way.
+ */
+void vclockAdvance(uint64_t ns) {
+    uint64_t end = now_ns + ns;
+
+    while (armed != NULL && deadline_ns(armed) <= end) {
+        PlatformTimer *tp = armed;
+
+        if (deadline_ns(tp) > now_ns) {
+            now_ns = deadline_ns(tp);
+        }
+        armed = tp->next;
+        tp->next = NULL;
+        tp->callback(tp->arg);
+    }
+    now_ns = end;
+}
+
+/**
+ * @brief   When the first armed timer expires, @p UINT64_MAX if none is.
+ */
+uint64_t vclockNext(void) {
+    return armed != NULL ? deadline_ns(armed) : UINT64_MAX;
+}
+
+void platformInit(void) {
+}
+
+/*
+ * Simulated interrupts only run while the clock advances, there is nothing
+ * to hold off.
+ */
+void platformLock(void) {
+}
+
+void platformUnlock(void) {
+}
+
+uint32_t platformNowUs(void) {
+#if HAL_USE_GPT
+    return (uint32_t)(now_ns / 1000U);
+#else
+    return (uint32_t)(now_ns / NS_PER_TICK) * US_PER_TICK;
+#endif
+}
+
+uint32_t platformCycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return (uint32_t)__builtin_ia32_rdtsc() & PLATFORM_CYCLES_MASK;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec) &
+           PLATFORM_CYCLES_MASK;
+#endif
+}
+
+/**
+ * @brief   Sleeps like @p chThdSleep() on the rounded up number of ticks,
+ *          or exactly for short delays.
+ * @details A tick sleep ends on a tick boundary and, in tickless mode, lasts
+ *          at least @p CH_CFG_ST_TIMEDELTA ticks.
+ */
+void platformDelayUs(uint32_t us) {
+    uint64_t ticks = (us + US_PER_TICK - 1) / US_PER_TICK;
+
+    if (us == 0) {
+        return;
+    }
+#if HAL_USE_GPT
+    if (us < PLATFORM_TICK_DELAY_US) {
+        vclockAdvance((uint64_t)us * 1000U);
+        return;
+    }
+#endif
+#if CH_CFG_ST_TIMEDELTA > 0
+    if (ticks < CH_CFG_ST_TIMEDELTA) {
+        ticks = CH_CFG_ST_TIMEDELTA;
+    }
+#endif
+    vclockAdvance((now_ns / NS_PER_TICK + ticks) * NS_PER_TICK - now_ns);
+}
+
+void platformTimerStartI(PlatformTimer *tp, uint32_t us,
+                         platformtimercb_t callback, void *arg) {
+    uint32_t now = (uint32_t)(now_ns / 1000U);
+    PlatformTimer **pp = &armed;
+
+    platformTimerStopI(tp);
+    tp->deadline = now + us;
+    tp->callback = callback;
+    tp->arg = arg;
+    while (*pp != NULL && (int32_t)((*pp)->deadline - now) <= (int32_t)us) {
+        pp = &(*pp)->next;
+    }
+    tp->next = *pp;
+    *pp = tp;
+}
+
+void platformTimerStart(PlatformTimer *tp, uint32_t us,
+                        platformtimercb_t callback, void *arg) {
+    platformTimerStartI(tp, us, callback, arg);
+}
+
+void platformTimerStopI(PlatformTimer *tp) {
+    PlatformTimer **pp = &armed;
+
+    while (*pp != NULL && *pp != tp) {
+        pp = &(*pp)->next;
+    }
+    if (*pp != NULL) {
+        *pp = tp->next;
+        tp->next = NULL;
+    }
+}
+
+void platformTimerStop(PlatformTimer *tp) {
+    platformTimerStopI(tp);
+}
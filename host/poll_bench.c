@@ -0,0 +1,174 @@
+/**
+ * @file    poll_bench.c
+ * @brief   Standby cost against time to first detect of the poll policies.
+ * @details Cards are presented one at a time at random intervals while the
+ *          poll scheduler runs the reader. For each policy the bench reports
+ *          the share of time with the RF field on and with the front-end in
+ *          power-down, and the latency from a card entering the field to
+ *          its arrival being reported.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "drivers/mfrc522.h"
+#include "reader/poll.h"
+#include "mfrc522_sim_hw.h"
+#include "vclock.h"
+
+/* Virtual time simulated per policy. */
+#define RUN_NS                      (600ULL * 1000000000U)
+
+/* Gap between two cards, uniform up to this. */
+#define GAP_MAX_US                  10000000
+
+/* A card stays on the reader from 0.5 s up to this. */
+#define DWELL_MAX_US                2000000
+
+#define CARDS_MAX                   1000
+
+typedef struct {
+    const char *name;
+    ReaderPollPolicy policy;
+} Policy;
+
+static const Policy policies[] = {
+    {"fixed 20 ms", {20000, 20000, 0, ISO14443A_POWER_UP_US}},
+    {"default", {20000, 500000, 2000000, ISO14443A_POWER_UP_US}},
+    {"power save", {50000, 1000000, 1000000, 2500}},
+    {"fast detect", {10000, 100000, 5000000, 2500}},
+};
+
+static MFRC522Sim chip;
+static MFRC522SimBus bus = {&chip, {0, 0, 0, 0}};
+static MFRC522Driver rfid;
+static ReaderPresence presence;
+static ReaderPoll scheduler;
+
+static const MFRC522Config config = {
+    &mfrc522SimTransport,
+    &bus
+};
+
+static PiccSim card;
+static bool detected;
+static uint64_t latencies[CARDS_MAX];
+static uint64_t sorted[CARDS_MAX];
+static unsigned presented;
+static uint32_t seed = 1;
+
+static uint32_t random_next(void) {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static void on_presence(void *ctx, const Iso14443aCard *found, bool arrived) {
+    (void)ctx;
+    (void)found;
+
+    if (arrived && !detected && presented > 0) {
+        detected = true;
+        latencies[presented - 1] = vclockNow() - card.arriveNs;
+    }
+}
+
+/**
+ * @brief   Puts the next card in the queue.
+ */
+static void present_card(void) {
+    uint8_t uid[4];
+    size_t i;
+
+    for (i = 0; i < sizeof(uid); i++) {
+        uid[i] = (uint8_t)random_next();
+    }
+    uid[0] = uid[0] == 0x88 ? 0x08 : uid[0];
+    piccSimInit(&card, uid, sizeof(uid), 0x08);
+    card.arriveNs = vclockNow() + (uint64_t)(random_next() % GAP_MAX_US) * 1000U;
+    card.leaveNs = card.arriveNs + 500000000U +
+                   (uint64_t)(random_next() % (DWELL_MAX_US - 500000)) * 1000U;
+    mfrc522SimAddCard(&chip, &card);
+    detected = false;
+    presented++;
+}
+
+static int compare(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void run_policy(const Policy *p) {
+    uint64_t start, end, elapsed, field_ns, pd_ns;
+    unsigned missed = 0, n = 0, i;
+
+    mfrc522SimInit(&chip, NULL);
+    mfrc522ObjectInit(&rfid);
+    if (mfrc522Start(&rfid, &config) != MFRC522_OK) {
+        fprintf(stderr, "poll-bench: chip did not start\n");
+        exit(EXIT_FAILURE);
+    }
+    readerPresenceInit(&presence, on_presence, NULL);
+    readerPollInit(&scheduler, &rfid, &presence);
+    readerPollSetPolicy(&scheduler, &p->policy);
+
+    presented = 0;
+    start = vclockNow();
+    field_ns = chip.stats.fieldOnNs;
+    pd_ns = chip.stats.powerDownNs;
+    end = start + RUN_NS;
+    present_card();
+    while (vclockNow() < end) {
+        platformDelayUs(readerPollRun(&scheduler));
+        if (vclockNow() >= card.leaveNs) {
+            mfrc522SimRemoveCard(&chip, &card);
+            if (!detected) {
+                missed++;
+            }
+            if (presented == CARDS_MAX) {
+                break;
+            }
+            present_card();
+        }
+    }
+    mfrc522SimRemoveCard(&chip, &card);
+    mfrc522SimSync(&chip);
+    elapsed = vclockNow() - start;
+
+    for (i = 0; i < presented; i++) {
+        if (latencies[i] != 0) {
+            sorted[n++] = latencies[i];
+        }
+    }
+    qsort(sorted, n, sizeof(sorted[0]), compare);
+
+    printf("%s: fast %u us, slow %u us, hold %u us, guard %u us\n", p->name,
+           (unsigned)p->policy.fastInterval, (unsigned)p->policy.slowInterval,
+           (unsigned)p->policy.activeHold, (unsigned)p->policy.fieldGuard);
+    printf("  field on         %8.2f %%\n",
+           100.0 * (double)(chip.stats.fieldOnNs - field_ns) / (double)elapsed);
+    printf("  power-down       %8.2f %%\n",
+           100.0 * (double)(chip.stats.powerDownNs - pd_ns) / (double)elapsed);
+    printf("  polls            %8.1f /s\n",
+           scheduler.stats.polls / (elapsed / 1e9));
+    if (n > 0) {
+        printf("  detect p50       %8.1f ms\n", sorted[(n - 1) / 2] / 1e6);
+        printf("  detect p99       %8.1f ms\n",
+               sorted[(n * 99 + 99) / 100 - 1] / 1e6);
+        printf("  detect max       %8.1f ms\n", sorted[n - 1] / 1e6);
+    }
+    printf("  cards            %8u (%u missed)\n", presented, missed);
+    memset(latencies, 0, sizeof(latencies));
+}
+
+int main(void) {
+    size_t i;
+
+    printf("poll-bench (%.0f s per policy)\n", RUN_NS / 1e9);
+    for (i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+        run_policy(&policies[i]);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,406 @@
+/**
+ * @file    proto_bench.c
+ * @brief   Throughput and latency of the reader-controller protocol.
+ * @details The reader runs the protocol over the DMA link on the simulated
+ *          USART, the controller stand-in at the other end answers every
+ *          card event with a feedback command after @p TURNAROUND_US.
+ *
+ *          The throughput runs send @p EVENTS card events back to back and
+ *          compare stop-and-wait with wider windows. The busy door runs
+ *          send them at random times while the controller polls the reader
+ *          status, with and without bytes corrupted on the line, and report
+ *          the latency from an event to its feedback.
+ *
+ *          The restart runs send them the same way and restart the reader,
+ *          or the controller, halfway through: its protocol end starts
+ *          afresh and resets the connection. They report the events and
+ *          feedback commands the restart took with it, or delivered twice,
+ *          and the time from the restart to the first feedback on an event
+ *          sent after it.
+ *
+ *          The bench fails if an event or feedback is lost, duplicated,
+ *          reordered or corrupted, or if a status poll goes unanswered. Over
+ *          a restart, if more than a window of them is, or any sent after
+ *          it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "link/proto.h"
+#include "reader/event.h"
+#include "controller_sim.h"
+#include "uart_sim.h"
+#include "vclock.h"
+
+#define EVENTS                      1000
+#define BITRATE                     115200
+#define TURNAROUND_US               500
+#define UID_LEN                     7
+
+/* Busy door: events 0 to twice this apart, status polls, retransmissions. */
+#define DOOR_GAP_US                 6000
+#define DOOR_POLL_US                50000
+#define DOOR_RETRANSMIT_US          20000
+
+/* Gives up on the missing feedback after this long. */
+#define DRAIN_US                    2000000
+
+typedef struct {
+    uint32_t elapsedUs;
+    uint32_t feedbacks;
+    uint64_t latency[EVENTS];
+} Result;
+
+static UartSim sim;
+static LinkDriver link;
+static const LinkConfig linkConfig = {&uartSimTransport, &sim};
+static ControllerSim controller;
+
+/* Reader. */
+static Proto proto;
+static ProtoConfig config;
+static uint32_t sentAt[EVENTS];
+static uint32_t feedbacks;
+static uint8_t feedbackGot[EVENTS];
+static uint32_t feedbackAt[EVENTS];
+static uint8_t eventGot[EVENTS];
+static uint32_t restartAt;
+static uint32_t statusRequests;
+static uint32_t statusSent;
+static Result result;
+
+static bool failed;
+
+static void reader_send(void *arg, const uint8_t *frame, size_t len) {
+    linkSend(arg, frame, len);
+}
+
+static void reader_receive(void *arg, uint8_t type, const uint8_t *payload,
+                           size_t len) {
+    (void)arg;
+
+    if (type == PROTO_MSG_STATUS_REQUEST) {
+        statusRequests++;
+    } else if (type == PROTO_MSG_FEEDBACK) {
+        uint32_t n;
+
+        if (len != 1 + UID_LEN || payload[0] != UID_LEN) {
+            failed = true;
+            return;
+        }
+        n = (uint32_t)payload[1] << 24 | (uint32_t)payload[2] << 16 |
+            (uint32_t)payload[3] << 8 | payload[4];
+        /* Over a restart the feedback on an earlier event may be lost or
+           come twice, see run_restart(). */
+        if (n >= EVENTS || (restartAt == EVENTS && n != feedbacks)) {
+            failed = true;
+            return;
+        }
+        feedbackGot[n]++;
+        feedbackAt[n] = platformNowUs();
+        if (feedbacks < EVENTS) {
+            result.latency[feedbacks++] = platformElapsedUs(sentAt[n]);
+        }
+    } else {
+        failed = true;
+    }
+}
+
+/**
+ * @brief   Answers the status polls, as far as the window allows.
+ */
+static void answer_status(void) {
+    static const uint8_t status[] = {0x00};
+
+    while (statusSent < statusRequests &&
+           protoSend(&proto, PROTO_MSG_STATUS, status, sizeof(status)) ==
+               PROTO_OK) {
+        statusSent++;
+    }
+}
+
+/**
+ * @brief   Sends event @p n, running the protocol while the window is full.
+ * @details Gives up after @p DRAIN_US, the window stuck.
+ */
+static void send_event(uint32_t n) {
+    ReaderEvent event;
+    uint8_t payload[READER_EVENT_MAX_SIZE];
+    uint32_t start = platformNowUs();
+    size_t len;
+
+    memset(&event, 0, sizeof(event));
+    event.type = READER_EVENT_CARD;
+    event.card.uidlen = UID_LEN;
+    event.card.uid[0] = (uint8_t)(n >> 24);
+    event.card.uid[1] = (uint8_t)(n >> 16);
+    event.card.uid[2] = (uint8_t)(n >> 8);
+    event.card.uid[3] = (uint8_t)n;
+    event.card.uid[4] = 0x5A;
+    event.card.sak = 0x08;
+    event.card.atqa[0] = 0x44;
+    len = readerEventEncode(&event, payload, sizeof(payload));
+
+    answer_status();
+    while (protoSend(&proto, PROTO_MSG_EVENT, payload, len) == PROTO_BUSY) {
+        if (platformElapsedUs(start) >= DRAIN_US) {
+            failed = true;
+            return;
+        }
+        protoRun(&proto, &link, 100);
+        answer_status();
+    }
+}
+
+static void drain(void) {
+    uint32_t start = platformNowUs();
+
+    while ((feedbacks < EVENTS || protoInFlight(&proto) > 0 ||
+            controller.stats.statuses != controller.stats.polls) &&
+           platformElapsedUs(start) < DRAIN_US) {
+        protoRun(&proto, &link, 1000);
+        answer_status();
+    }
+}
+
+static void setup(uint8_t window, uint32_t retransmit, uint32_t errorPpm) {
+    uartSimInit(&sim, BITRATE, &link);
+    sim.errorPpm = errorPpm;
+    sim.seed = 12345;
+    linkObjectInit(&link);
+    linkStart(&link, &linkConfig);
+
+    config.send = reader_send;
+    config.receive = reader_receive;
+    config.arg = &link;
+    config.window = window;
+    config.retransmit = retransmit;
+    protoInit(&proto, &config);
+    feedbacks = 0;
+    memset(feedbackGot, 0, sizeof(feedbackGot));
+    memset(eventGot, 0, sizeof(eventGot));
+    restartAt = EVENTS;
+    statusRequests = 0;
+    statusSent = 0;
+
+    controllerSimInit(&controller, &sim, window, retransmit);
+    controller.turnaround = TURNAROUND_US;
+}
+
+static void finish(uint32_t start) {
+    result.elapsedUs = platformElapsedUs(start);
+    result.feedbacks = feedbacks;
+    controllerSimStop(&controller);
+    linkStop(&link);
+    uartSimRun(&sim);
+
+    if (feedbacks != EVENTS || controller.stats.events != EVENTS ||
+        controller.stats.misordered != 0 ||
+        controller.stats.feedbacks != EVENTS ||
+        controller.stats.statuses != controller.stats.polls ||
+        statusSent != statusRequests) {
+        failed = true;
+    }
+}
+
+static int compare(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void report_latency(void) {
+    uint32_t n = result.feedbacks;
+
+    if (n == 0) {
+        printf("     -      -      -");
+        return;
+    }
+    qsort(result.latency, n, sizeof(result.latency[0]), compare);
+    printf("  %5.2f  %5.2f  %5.2f", result.latency[(n - 1) / 2] / 1000.0,
+           result.latency[(n * 99 + 99) / 100 - 1] / 1000.0,
+           result.latency[n - 1] / 1000.0);
+}
+
+static void run_throughput(uint8_t window) {
+    uint32_t start;
+    uint32_t n;
+
+    setup(window, PROTO_RETRANSMIT_US, 0);
+    start = platformNowUs();
+    for (n = 0; n < EVENTS; n++) {
+        sentAt[n] = platformNowUs();
+        send_event(n);
+    }
+    drain();
+    finish(start);
+
+    printf("  %6u  %9.1f", (unsigned)window,
+           EVENTS / (result.elapsedUs / 1e6));
+    report_latency();
+    printf("  %6u\n", (unsigned)proto.stats.acks);
+}
+
+static void run_door(uint8_t window, uint32_t errorPpm) {
+    uint32_t seed = 1;
+    uint32_t start;
+    uint32_t due;
+    uint32_t n;
+
+    setup(window, DOOR_RETRANSMIT_US, errorPpm);
+    controllerSimPoll(&controller, DOOR_POLL_US);
+    start = platformNowUs();
+    due = start;
+    for (n = 0; n < EVENTS; n++) {
+        int32_t wait;
+
+        seed = seed * 1103515245 + 12345;
+        due += (seed >> 8) % (2 * DOOR_GAP_US);
+        while ((wait = (int32_t)(due - platformNowUs())) > 0) {
+            protoRun(&proto, &link, (uint32_t)wait);
+            answer_status();
+        }
+        sentAt[n] = due;
+        send_event(n);
+    }
+    drain();
+    finish(start);
+
+    printf("  %6u  %5u", (unsigned)window, (unsigned)errorPpm);
+    report_latency();
+    printf("  %6u %6u %6u %5u\n", (unsigned)sim.corrupted,
+           (unsigned)(proto.stats.retransmissions +
+                      controller.reader[0].proto.stats.retransmissions),
+           (unsigned)(proto.stats.crcErrors + proto.stats.framingErrors +
+                      controller.reader[0].proto.stats.crcErrors +
+                      controller.reader[0].proto.stats.framingErrors),
+           (unsigned)controller.stats.polls);
+}
+
+static void count_event(ControllerSim *csp, size_t reader,
+                        const uint8_t *event, size_t len) {
+    uint32_t n;
+
+    (void)csp;
+    (void)reader;
+
+    if (len < 3 + UID_LEN || event[0] != READER_EVENT_CARD) {
+        return;
+    }
+    n = (uint32_t)event[3] << 24 | (uint32_t)event[4] << 16 |
+        (uint32_t)event[5] << 8 | event[6];
+    if (n < EVENTS) {
+        eventGot[n]++;
+    }
+}
+
+static void run_restart(uint8_t window, bool controllerEnd) {
+    uint32_t seed = 1;
+    uint32_t due;
+    uint32_t restartedAt = 0;
+    uint32_t recovery = 0;
+    uint32_t lost = 0, again = 0, feedbackLost = 0, feedbackAgain = 0;
+    uint32_t late = 0;
+    uint32_t n;
+
+    setup(window, DOOR_RETRANSMIT_US, 0);
+    controller.event = count_event;
+    due = platformNowUs();
+    for (n = 0; n < EVENTS; n++) {
+        int32_t wait;
+
+        seed = seed * 1103515245 + 12345;
+        due += (seed >> 8) % (2 * DOOR_GAP_US);
+        while ((wait = (int32_t)(due - platformNowUs())) > 0) {
+            protoRun(&proto, &link, (uint32_t)wait);
+        }
+        if (n == EVENTS / 2) {
+            restartAt = n;
+            restartedAt = platformNowUs();
+            if (controllerEnd) {
+                controllerSimRestart(&controller);
+            } else {
+                protoInit(&proto, &config);
+                protoReset(&proto);
+            }
+        }
+        sentAt[n] = due;
+        send_event(n);
+    }
+    due = platformNowUs();
+    while ((feedbackGot[EVENTS - 1] == 0 || protoInFlight(&proto) > 0) &&
+           platformElapsedUs(due) < DRAIN_US) {
+        protoRun(&proto, &link, 1000);
+    }
+    controllerSimStop(&controller);
+    linkStop(&link);
+    uartSimRun(&sim);
+
+    for (n = 0; n < EVENTS; n++) {
+        if (n >= restartAt) {
+            if (eventGot[n] != 1 || feedbackGot[n] != 1) {
+                late++;
+            }
+            if (recovery == 0 && feedbackGot[n] != 0) {
+                recovery = feedbackAt[n] - restartedAt;
+            }
+            continue;
+        }
+        lost += eventGot[n] == 0;
+        again += eventGot[n] > 1;
+        feedbackLost += feedbackGot[n] == 0;
+        feedbackAgain += feedbackGot[n] > 1;
+    }
+    if (late != 0 || lost > window || again > window ||
+        feedbackLost > 2U * window || feedbackAgain > 2U * window) {
+        failed = true;
+    }
+
+    printf("  %6u  %-10s %5u %5u %5u %5u %9.2f %6u\n", (unsigned)window,
+           controllerEnd ? "controller" : "reader", (unsigned)lost,
+           (unsigned)again, (unsigned)feedbackLost, (unsigned)feedbackAgain,
+           recovery / 1000.0, (unsigned)late);
+}
+
+int main(void) {
+    static const uint8_t windows[] = {1, 2, 4};
+    static const uint32_t errors[] = {0, 100, 1000};
+    size_t i, j;
+
+    printf("proto-bench (%u events, %u bit/s, %u us turnaround)\n",
+           EVENTS, BITRATE, TURNAROUND_US);
+    printf("back to back:\n");
+    printf("  window   events/s  ---- latency ms ----    acks\n");
+    printf("                        p50    p99    max\n");
+    for (i = 0; i < sizeof(windows); i++) {
+        run_throughput(windows[i]);
+    }
+
+    printf("busy door, events 0-%u ms apart, status poll every %u ms:\n",
+           2 * DOOR_GAP_US / 1000, DOOR_POLL_US / 1000);
+    printf("  window  err/M  ---- latency ms ----  "
+           "corrupt resent    bad polls\n");
+    printf("                   p50    p99    max\n");
+    for (i = 0; i < sizeof(windows); i++) {
+        for (j = 0; j < sizeof(errors) / sizeof(errors[0]); j++) {
+            run_door(windows[i], errors[j]);
+        }
+    }
+
+    printf("restart halfway, events 0-%u ms apart:\n", 2 * DOOR_GAP_US / 1000);
+    printf("  window  restarted  -- events -- - feedback -  recovery  after\n");
+    printf("                      lost again  lost again        ms  wrong\n");
+    for (i = 0; i < sizeof(windows); i++) {
+        run_restart(windows[i], false);
+        run_restart(windows[i], true);
+    }
+    if (failed) {
+        fprintf(stderr, "proto-bench: messages lost, duplicated, reordered "
+                        "or unanswered\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,258 @@
+/**
+ * @file    rate_bench.c
+ * @brief   Bit rate negotiation of the controller link over various cables.
+ * @details The reader runs the protocol over the DMA link on the simulated
+ *          USART, the controller stand-in negotiates the bit rate from
+ *          @p BASE_BITRATE up. Cables carry every rate cleanly up to their
+ *          maximum and corrupt bytes often above it; some also corrupt a
+ *          byte now and then at any rate. One reader only runs up to
+ *          921600 bit/s.
+ *
+ *          Every run reports the time the negotiation took, the rate both
+ *          ends settled on, the rates tried, refused and failed, the
+ *          throughput the probes measured, and the payload throughput of a
+ *          bulk transfer from the reader at the base and at the negotiated
+ *          rate. A last run resets the controller to the base rate behind
+ *          the reader's back and times how long the reader takes to follow.
+ *
+ *          The bench fails if the ends settle on different rates, on a rate
+ *          above the cable's maximum, or if the bulk transfer loses data.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "link/proto.h"
+#include "link/rate.h"
+#include "controller_sim.h"
+#include "uart_sim.h"
+#include "vclock.h"
+
+#define BASE_BITRATE                38400
+#define WINDOW                      4
+#define BULK_BYTES                  16384
+
+/* Gives up on the negotiation or a transfer after this long. */
+#define RUN_LIMIT_US                20000000
+
+typedef struct {
+    const char *name;
+    uint32_t maxBitrate;            /* 0 for any. */
+    uint32_t errorPpm;
+    bool oldReader;
+} Cable;
+
+static const uint32_t rates[] = {
+    57600, 115200, 230400, 460800, 921600, 1000000, 1500000, 2000000,
+    3000000
+};
+
+static const Cable cables[] = {
+    {"short",                 0,    0, false},
+    {"up to 1 Mbit/s",  1000000,    0, false},
+    {"up to 250 kbit/s", 250000,    0, false},
+    {"up to 100 kbit/s", 100000,    0, false},
+    {"old reader",            0,    0, true},
+    {"noisy, 100/M",    1000000,  100, false},
+};
+
+static UartSim sim;
+static LinkDriver link;
+static const LinkConfig linkConfig = {&uartSimTransport, &sim};
+static ControllerSim controller;
+
+/* Reader. */
+static Proto proto;
+static ProtoConfig config;
+static LinkRate rate;
+static LinkRateConfig rateConfig;
+
+static uint32_t statusRequests;
+static bool failed;
+
+static void reader_send(void *arg, const uint8_t *frame, size_t len) {
+    linkSend(arg, frame, len);
+}
+
+static void reader_receive(void *arg, uint8_t type, const uint8_t *payload,
+                           size_t len) {
+    (void)arg;
+
+    if (type == PROTO_MSG_STATUS_REQUEST) {
+        statusRequests++;
+    } else if (!linkRateReceive(&rate, type, payload, len)) {
+        failed = true;
+    }
+}
+
+static uint32_t reader_service(void *arg) {
+    (void)arg;
+
+    return linkRateService(&rate);
+}
+
+static bool reader_set_bitrate(void *arg, uint32_t bitrate) {
+    return linkSetBitrate(arg, bitrate);
+}
+
+static void setup(const Cable *cable) {
+    uartSimInit(&sim, BASE_BITRATE, &link);
+    sim.maxBitrate = cable->maxBitrate;
+    sim.errorPpm = cable->errorPpm;
+    sim.seed = 12345;
+    linkObjectInit(&link);
+    linkStart(&link, &linkConfig);
+
+    memset(&config, 0, sizeof(config));
+    config.send = reader_send;
+    config.receive = reader_receive;
+    config.service = reader_service;
+    config.arg = &link;
+    config.window = WINDOW;
+    config.retransmit = PROTO_RETRANSMIT_US;
+    protoInit(&proto, &config);
+
+    rateConfig.rates = rates;
+    rateConfig.count = cable->oldReader ? 5 : sizeof(rates) / sizeof(rates[0]);
+    rateConfig.base = BASE_BITRATE;
+    rateConfig.set = reader_set_bitrate;
+    rateConfig.arg = &link;
+    linkRateInit(&rate, &rateConfig, &proto);
+
+    controllerSimInit(&controller, &sim, WINDOW, PROTO_RETRANSMIT_US);
+}
+
+static void finish(void) {
+    controllerSimStop(&controller);
+    linkStop(&link);
+    uartSimRun(&sim);
+}
+
+/**
+ * @brief   Runs the reader until both ends are done negotiating.
+ * @return  Microseconds it took.
+ */
+static uint32_t negotiate(void) {
+    uint32_t start = platformNowUs();
+
+    controllerSimNegotiate(&controller, BASE_BITRATE, rates,
+                           sizeof(rates) / sizeof(rates[0]));
+    while ((controller.rate.state != LINK_RATE_IDLE ||
+            rate.state != LINK_RATE_IDLE) &&
+           platformElapsedUs(start) < RUN_LIMIT_US) {
+        protoRun(&proto, &link, 1000);
+    }
+    return platformElapsedUs(start);
+}
+
+/**
+ * @brief   Sends @p BULK_BYTES of test frames to the controller.
+ * @return  Payload bytes per second, 0 if not all arrived in time.
+ */
+static uint32_t bulk(void) {
+    uint8_t payload[PROTO_PAYLOAD_MAX];
+    uint32_t start = platformNowUs();
+    uint32_t received = controller.reader[0].proto.stats.received;
+    uint32_t frames = BULK_BYTES / PROTO_PAYLOAD_MAX;
+    uint32_t sent = 0;
+    uint32_t elapsed;
+
+    memset(payload, 0xA5, sizeof(payload));
+    while (platformElapsedUs(start) < RUN_LIMIT_US &&
+           (sent < frames || protoInFlight(&proto) > 0)) {
+        while (sent < frames &&
+               protoSend(&proto, PROTO_MSG_PROBE, payload,
+                         sizeof(payload)) == PROTO_OK) {
+            sent++;
+        }
+        protoRun(&proto, &link, 100);
+    }
+    elapsed = platformElapsedUs(start);
+    if (controller.reader[0].proto.stats.received - received != frames) {
+        failed = true;
+        return 0;
+    }
+    return (uint32_t)((uint64_t)BULK_BYTES * 1000000 / elapsed);
+}
+
+static void check(const Cable *cable) {
+    if (rate.stats.bitrate != controller.rate.stats.bitrate ||
+        sim.charNs != sim.peerCharNs ||
+        (cable->maxBitrate != 0 && rate.stats.bitrate > cable->maxBitrate)) {
+        failed = true;
+    }
+}
+
+static void run(const Cable *cable) {
+    uint32_t before;
+    uint32_t after;
+    uint32_t elapsed;
+    const LinkRateStats *stats = &controller.rate.stats;
+
+    setup(cable);
+    before = bulk();
+    elapsed = negotiate();
+    check(cable);
+    after = bulk();
+    finish();
+
+    printf("  %-17s %6.0f %8u %3u %3u %3u %8.1f %8.1f %8.1f\n", cable->name,
+           elapsed / 1000.0, (unsigned)stats->bitrate,
+           (unsigned)stats->trials, (unsigned)stats->refused,
+           (unsigned)stats->failed, stats->throughput / 1000.0,
+           before / 1000.0, after / 1000.0);
+}
+
+/**
+ * @brief   The controller drops to the base rate, e.g. after a restart, and
+ *          the reader has to notice the silence.
+ */
+static void run_reset(void) {
+    uint32_t start;
+
+    setup(&cables[0]);
+    (void)negotiate();
+    controllerSimNegotiate(&controller, BASE_BITRATE, rates, 0);
+    uartSimPeerBitrate(&sim, BASE_BITRATE);
+    controllerSimPoll(&controller, 100000);
+
+    start = platformNowUs();
+    statusRequests = 0;
+    while (rate.stats.bitrate != BASE_BITRATE &&
+           platformElapsedUs(start) < RUN_LIMIT_US) {
+        protoRun(&proto, &link, 1000);
+    }
+    printf("controller reset at %u bit/s: reader back at %u bit/s "
+           "after %.0f ms, %u silence\n", (unsigned)rates[8],
+           (unsigned)rate.stats.bitrate, platformElapsedUs(start) / 1000.0,
+           (unsigned)rate.stats.silences);
+    if (rate.stats.bitrate != BASE_BITRATE || statusRequests != 0) {
+        failed = true;
+    }
+    if (bulk() == 0) {
+        failed = true;
+    }
+    finish();
+}
+
+int main(void) {
+    size_t i;
+
+    printf("rate-bench (from %u bit/s, %u probes of %u B, %u B bulk)\n",
+           BASE_BITRATE, LINK_RATE_PROBES, PROTO_PAYLOAD_MAX, BULK_BYTES);
+    printf("                                          "
+           "        --- payload kB/s ---\n");
+    printf("  cable                 ms    bit/s try ref bad   probes"
+           "     base   result\n");
+    for (i = 0; i < sizeof(cables) / sizeof(cables[0]); i++) {
+        run(&cables[i]);
+    }
+    run_reset();
+    if (failed) {
+        fprintf(stderr, "rate-bench: ends disagree, rate over the cable's "
+                        "maximum or data lost\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,287 @@
+/**
+ * @file    rfid_bench.c
+ * @brief   Times the MFRC522 driver and card activation on the chip model.
+ * @details With @p --no-sequences the transport handles every register
+ *          write as a separate bus acquisition, as it did before register
+ *          sequences were introduced.
+ *
+ *          The inventory benchmarks fail if an inventory without RF errors
+ *          takes more frames than @p ISO14443A_INVENTORY_FRAMES() allows.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "drivers/mfrc522.h"
+#include "rfid/iso14443a.h"
+#include "mfrc522_sim_hw.h"
+#include "vclock.h"
+
+#define ROUNDS                      1000
+
+/* The reader waits this long after switching the field on. */
+#define FIELD_GUARD_US              5000
+
+static MFRC522Sim chip;
+static MFRC522SimBus bus = {&chip, {0, 0, 0, 0}};
+static MFRC522Driver rfid;
+static MFRC522Transport transport;
+
+static const MFRC522Config config = {
+    &transport,
+    &bus
+};
+
+static const uint8_t uid4[] = {0xDE, 0xAD, 0xBE, 0xEF};
+static const uint8_t uid4b[] = {0xDE, 0xAD, 0xBE, 0xE0};
+static const uint8_t uid7[] = {0x04, 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC};
+static const uint8_t uid10[] = {0x08, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66,
+                                0x77, 0x88, 0x99};
+
+static PiccSim cards[2];
+static PiccSim wallet[5];
+static uint32_t seed = 1;
+static bool bound_exceeded;
+
+/**
+ * @brief   Counters at the start of the measured part.
+ */
+static struct {
+    MFRC522Stats bus;
+    MFRC522SimBusStats cost;
+    uint64_t ns;
+    unsigned failures;
+} mark;
+
+static void measure_start(void) {
+    mark.bus = rfid.stats;
+    mark.cost = bus.stats;
+    mark.ns = vclockNow();
+    mark.failures = 0;
+}
+
+/**
+ * @brief   Leaves what happened since @p from out of the measurement.
+ */
+static void measure_exclude(const MFRC522Stats *from,
+                            const MFRC522SimBusStats *cost, uint64_t ns) {
+    mark.bus.transactions += rfid.stats.transactions - from->transactions;
+    mark.bus.bytes += rfid.stats.bytes - from->bytes;
+    mark.bus.acquisitions += rfid.stats.acquisitions - from->acquisitions;
+    mark.cost.cpuNs += bus.stats.cpuNs - cost->cpuNs;
+    mark.cost.sleepNs += bus.stats.sleepNs - cost->sleepNs;
+    mark.ns += vclockNow() - ns;
+}
+
+static void measure_report(const char *what) {
+    printf("%s, per operation:\n", what);
+    printf("  latency          %8.1f us\n",
+           (vclockNow() - mark.ns) / 1000.0 / ROUNDS);
+    printf("  spi transactions %8.1f\n",
+           (double)(rfid.stats.transactions - mark.bus.transactions) / ROUNDS);
+    printf("  spi bytes        %8.1f\n",
+           (double)(rfid.stats.bytes - mark.bus.bytes) / ROUNDS);
+    printf("  bus acquisitions %8.1f\n",
+           (double)(rfid.stats.acquisitions - mark.bus.acquisitions) / ROUNDS);
+    printf("  cpu busy         %8.1f us\n",
+           (bus.stats.cpuNs - mark.cost.cpuNs) / 1000.0 / ROUNDS);
+    printf("  asleep on irq    %8.1f us\n",
+           (bus.stats.sleepNs - mark.cost.sleepNs) / 1000.0 / ROUNDS);
+    if (mark.failures > 0) {
+        printf("  failed           %8u\n", mark.failures);
+    }
+}
+
+/**
+ * @brief   Starts the chip with the cards in the field.
+ */
+static void setup(PiccSim *in_field, size_t n) {
+    size_t i;
+
+    mfrc522SimInit(&chip, NULL);
+    for (i = 0; i < n; i++) {
+        mfrc522SimAddCard(&chip, &in_field[i]);
+    }
+    mfrc522ObjectInit(&rfid);
+    if (mfrc522Start(&rfid, &config) != MFRC522_OK) {
+        fprintf(stderr, "rfid-bench: chip did not start\n");
+        exit(EXIT_FAILURE);
+    }
+    mfrc522SetField(&rfid, true);
+    platformDelayUs(FIELD_GUARD_US);
+}
+
+/**
+ * @brief   Wakes a halted card up. The selection and HLTA which put it back
+ *          to HALT are not measured.
+ */
+static void bench_wupa(void) {
+    uint8_t atqa[2];
+    Iso14443aCard card;
+    int i;
+
+    piccSimInit(&cards[0], uid4, sizeof(uid4), 0x08);
+    setup(cards, 1);
+
+    measure_start();
+    for (i = 0; i < ROUNDS; i++) {
+        MFRC522Stats from;
+        MFRC522SimBusStats cost;
+        uint64_t ns;
+
+        if (iso14443aRequest(&rfid, true, atqa) != MFRC522_OK) {
+            mark.failures++;
+        }
+        from = rfid.stats;
+        cost = bus.stats;
+        ns = vclockNow();
+        iso14443aSelect(&rfid, &card);
+        iso14443aHalt(&rfid);
+        measure_exclude(&from, &cost, ns);
+    }
+    measure_report("WUPA");
+}
+
+/**
+ * @brief   Wakes the cards up with WUPA, then selects one and halts it.
+ *          Only the selection and the HLTA are measured.
+ */
+static void bench_read(const char *what, PiccSim *in_field, size_t n) {
+    uint8_t atqa[2];
+    Iso14443aCard card;
+    int i;
+
+    setup(in_field, n);
+
+    measure_start();
+    for (i = 0; i < ROUNDS; i++) {
+        MFRC522Stats from = rfid.stats;
+        MFRC522SimBusStats cost = bus.stats;
+        uint64_t ns = vclockNow();
+        mfrc522result_t result = iso14443aRequest(&rfid, true, atqa);
+
+        measure_exclude(&from, &cost, ns);
+        if ((result != MFRC522_OK && result != MFRC522_COLLISION) ||
+            iso14443aSelect(&rfid, &card) != MFRC522_OK ||
+            iso14443aHalt(&rfid) != MFRC522_OK) {
+            mark.failures++;
+        }
+    }
+    measure_report(what);
+}
+
+static uint32_t random_next(void) {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+/**
+ * @brief   Reads all cards of a wallet tapped on the reader, each round with
+ *          new random UIDs.
+ *
+ * @param[in] sizes     UID size of each card.
+ */
+static void bench_inventory(const char *what, const uint8_t *sizes, size_t n,
+                            uint16_t fault_permille) {
+    Iso14443aCard found[sizeof(wallet) / sizeof(wallet[0]) + 1];
+    Iso14443aInventory inv = {found, sizeof(found) / sizeof(found[0]), 0,
+                              0, 0, 0, 0};
+    uint64_t worst = 0;
+    uint32_t frames = 0, bound = 0;
+    size_t i;
+    int round;
+
+    setup(NULL, 0);
+    for (i = 0; i < n; i++) {
+        uint32_t levels = sizes[i] == 4 ? 1 : sizes[i] == 7 ? 2 : 3;
+
+        bound = bound > levels ? bound : levels;
+    }
+    bound = ISO14443A_INVENTORY_FRAMES((uint32_t)n, bound);
+
+    measure_start();
+    for (round = 0; round < ROUNDS; round++) {
+        uint64_t ns;
+
+        for (i = 0; i < n; i++) {
+            uint8_t uid[ISO14443A_UID_MAX];
+            size_t j;
+
+            mfrc522SimRemoveCard(&chip, &wallet[i]);
+            for (j = 0; j < sizes[i]; j++) {
+                uid[j] = (uint8_t)random_next();
+            }
+            uid[0] = uid[0] == 0x88 ? 0x08 : uid[0];
+            piccSimInit(&wallet[i], uid, sizes[i], 0x08);
+            wallet[i].faultPermille = fault_permille;
+            wallet[i].randomFault = PICC_SIM_FAULT_CRC;
+            mfrc522SimAddCard(&chip, &wallet[i]);
+        }
+
+        ns = vclockNow();
+        if (iso14443aInventory(&rfid, &inv) != MFRC522_OK || inv.count != n) {
+            mark.failures++;
+        }
+        ns = vclockNow() - ns;
+        worst = ns > worst ? ns : worst;
+        if (inv.errors == 0 && inv.frames > frames) {
+            frames = inv.frames;
+        }
+    }
+    for (i = 0; i < n; i++) {
+        mfrc522SimRemoveCard(&chip, &wallet[i]);
+    }
+
+    measure_report(what);
+    printf("  worst case       %8.1f us\n", worst / 1000.0);
+    printf("  frames, worst    %8u (bound %u)\n", (unsigned)frames,
+           (unsigned)bound);
+    if (frames > bound) {
+        printf("  FAILED: inventory exceeds its frame bound\n");
+        bound_exceeded = true;
+    }
+}
+
+int main(int argc, char **argv) {
+    static const uint8_t sizes_4b[] = {4, 4, 4, 4, 4};
+    static const uint8_t sizes_mixed[] = {4, 7, 10};
+
+    transport = mfrc522SimTransport;
+    if (argc > 1 && strcmp(argv[1], "--no-sequences") == 0) {
+        transport.exchangeSequence = NULL;
+    }
+
+    printf("rfid-bench (%s, %s)\n", MFRC522_USE_IRQ ? "irq" : "polled",
+           transport.exchangeSequence != NULL ? "sequences" : "no sequences");
+
+    bench_wupa();
+
+    piccSimInit(&cards[0], uid4, sizeof(uid4), 0x08);
+    bench_read("card read, 4 byte UID (anticollision, select, halt)", cards, 1);
+
+    piccSimInit(&cards[0], uid7, sizeof(uid7), 0x00);
+    bench_read("card read, 7 byte UID", cards, 1);
+
+    piccSimInit(&cards[0], uid10, sizeof(uid10), 0x20);
+    bench_read("card read, 10 byte UID", cards, 1);
+
+    piccSimInit(&cards[0], uid4, sizeof(uid4), 0x08);
+    piccSimInit(&cards[1], uid4b, sizeof(uid4b), 0x08);
+    bench_read("card read, 2 cards colliding in the last UID byte", cards, 2);
+
+    piccSimInit(&cards[0], uid4, sizeof(uid4), 0x08);
+    cards[0].faultPermille = 20;
+    cards[0].randomFault = PICC_SIM_FAULT_CRC;
+    bench_read("card read, 2% of the responses corrupted", cards, 1);
+
+    bench_inventory("inventory, 1 card", sizes_4b, 1, 0);
+    bench_inventory("inventory, 2 cards", sizes_4b, 2, 0);
+    bench_inventory("inventory, 3 cards", sizes_4b, 3, 0);
+    bench_inventory("inventory, 5 cards", sizes_4b, 5, 0);
+    bench_inventory("inventory, 4, 7 and 10 byte UIDs", sizes_mixed, 3, 0);
+    bench_inventory("inventory, 3 cards, 2% of the responses corrupted",
+                    sizes_4b, 3, 20);
+
+    return bound_exceeded ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,458 @@
+/**
+ * @file    session_bench.c
+ * @brief   Cost of the encrypted controller link.
+ * @details Checks ChaCha20, HChaCha20, Poly1305 and ChaCha20-Poly1305
+ *          against the test vectors of RFC 8439 and of the XChaCha20 draft,
+ *          and that a message with a flipped bit fails to open.
+ *
+ *          Then times the primitives, the sealing and opening of a message
+ *          of @p PROTO_PAYLOAD_MAX bytes and the handshake in cycles of the
+ *          build machine, see @p platformCycles(): the median of
+ *          @p RUNS runs. On the reader the session counts its own cycles in
+ *          @p LinkSessionStats.
+ *
+ *          Last, the reader runs the protocol over the simulated USART at
+ *          @p BITRATE against the controller stand-in, in the clear and
+ *          with a session, with and without corrupted bytes. Each run sends
+ *          @p EVENTS card events and reports the handshake time, the line
+ *          bytes per event and the latency from an event to its feedback.
+ *          The rekeyed run has the controller start a new handshake halfway,
+ *          with events and feedback commands in flight and an event lost on
+ *          the line, and reports the time of that handshake instead.
+ *
+ *          The bench fails on a wrong test vector, a forgery opened, an
+ *          event or feedback lost, duplicated or corrupted, a message
+ *          rejected on a clean line, or a handshake not done.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "crypto/chachapoly.h"
+#include "link/proto.h"
+#include "link/session.h"
+#include "reader/event.h"
+#include "controller_sim.h"
+#include "uart_sim.h"
+#include "vclock.h"
+
+#define RUNS                        10001
+#define EVENTS                      500
+#define BITRATE                     115200
+#define TURNAROUND_US               500
+#define UID_LEN                     7
+#define ERROR_PPM                   500
+
+/* Gives up on the handshake or the missing feedback after this long. */
+#define DRAIN_US                    2000000
+
+/* Rekeyed run: events sent back to back before and after one is lost. */
+#define REKEY_BURST                 2
+
+static const uint8_t key[LINK_SESSION_KEY_SIZE] = {
+    0x1F, 0x8B, 0x3C, 0x55, 0xA0, 0x6E, 0x21, 0xD4,
+    0x97, 0x0A, 0xEE, 0x43, 0x18, 0xB6, 0x7D, 0x02,
+    0xC9, 0x34, 0x5F, 0xE1, 0x80, 0x2B, 0x66, 0x9D,
+    0x4A, 0xF7, 0x13, 0xB8, 0x0C, 0xD5, 0x72, 0x3E
+};
+
+static UartSim sim;
+static LinkDriver link;
+static const LinkConfig linkConfig = {&uartSimTransport, &sim};
+static ControllerSim controller;
+
+/* Reader. */
+static Proto proto;
+static ProtoConfig config;
+static LinkSession session;
+static uint32_t sentAt[EVENTS];
+static uint32_t latency[EVENTS];
+static uint32_t feedbacks;
+
+static bool failed;
+
+/*===========================================================================*/
+/* Test vectors.                                                             */
+/*===========================================================================*/
+
+static bool check(const char *name, const uint8_t *got, const uint8_t *want,
+                  size_t len) {
+    if (memcmp(got, want, len) != 0) {
+        fprintf(stderr, "session-bench: %s does not match\n", name);
+        failed = true;
+        return false;
+    }
+    return true;
+}
+
+static void known_answers(void) {
+    /* RFC 8439 2.3.2. */
+    static const uint8_t blockNonce[] = {
+        0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x4A, 0x00, 0x00, 0x00, 0x00
+    };
+    static const uint8_t block[] = {
+        0x10, 0xF1, 0xE7, 0xE4, 0xD1, 0x3B, 0x59, 0x15, 0x50, 0x0F, 0xDD, 0x1F,
+        0xA3, 0x20, 0x71, 0xC4, 0xC7, 0xD1, 0xF4, 0xC7, 0x33, 0xC0, 0x68, 0x03,
+        0x04, 0x22, 0xAA, 0x9A, 0xC3, 0xD4, 0x6C, 0x4E, 0xD2, 0x82, 0x64, 0x46,
+        0x07, 0x9F, 0xAA, 0x09, 0x14, 0xC2, 0xD7, 0x05, 0xD9, 0x8B, 0x02, 0xA2,
+        0xB5, 0x12, 0x9C, 0xD1, 0xDE, 0x16, 0x4E, 0xB9, 0xCB, 0xD0, 0x83, 0xE8,
+        0xA2, 0x50, 0x3C, 0x4E
+    };
+    /* XChaCha20 draft 2.2.1. */
+    static const uint8_t deriveInput[] = {
+        0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x4A, 0x00, 0x00, 0x00, 0x00,
+        0x31, 0x41, 0x59, 0x27
+    };
+    static const uint8_t derived[] = {
+        0x82, 0x41, 0x3B, 0x42, 0x27, 0xB2, 0x7B, 0xFE, 0xD3, 0x0E, 0x42, 0x50,
+        0x8A, 0x87, 0x7D, 0x73, 0xA0, 0xF9, 0xE4, 0xD5, 0x8A, 0x74, 0xA8, 0x53,
+        0xC1, 0x2E, 0xC4, 0x13, 0x26, 0xD3, 0xEC, 0xDC
+    };
+    /* RFC 8439 2.5.2. */
+    static const uint8_t polyKey[] = {
+        0x85, 0xD6, 0xBE, 0x78, 0x57, 0x55, 0x6D, 0x33, 0x7F, 0x44, 0x52, 0xFE,
+        0x42, 0xD5, 0x06, 0xA8, 0x01, 0x03, 0x80, 0x8A, 0xFB, 0x0D, 0xB2, 0xFD,
+        0x4A, 0xBF, 0xF6, 0xAF, 0x41, 0x49, 0xF5, 0x1B
+    };
+    static const char polyMessage[] = "Cryptographic Forum Research Group";
+    static const uint8_t polyTag[] = {
+        0xA8, 0x06, 0x1D, 0xC1, 0x30, 0x51, 0x36, 0xC6, 0xC2, 0x2B, 0x8B, 0xAF,
+        0x0C, 0x01, 0x27, 0xA9
+    };
+    /* RFC 8439 2.8.2. */
+    static const char aeadPlain[] =
+        "Ladies and Gentlemen of the class of '99: If I could offer you only "
+        "one tip for the future, sunscreen would be it.";
+    static const uint8_t aeadNonce[] = {
+        0x07, 0x00, 0x00, 0x00, 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47
+    };
+    static const uint8_t aeadAad[] = {
+        0x50, 0x51, 0x52, 0x53, 0xC0, 0xC1, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7
+    };
+    static const uint8_t aeadStart[] = {
+        0xD3, 0x1A, 0x8D, 0x34, 0x64, 0x8E, 0x60, 0xDB, 0x7B, 0x86, 0xAF, 0xBC,
+        0x53, 0xEF, 0x7E, 0xC2
+    };
+    static const uint8_t aeadTag[] = {
+        0x1A, 0xE1, 0x0B, 0x59, 0x4F, 0x09, 0xE2, 0x6A, 0x7E, 0x90, 0x2E, 0xCB,
+        0xD0, 0x60, 0x06, 0x91
+    };
+    uint8_t seq[CHACHA20_KEY_SIZE];
+    uint8_t aeadKey[CHACHA20_KEY_SIZE];
+    uint8_t out[CHACHA20_BLOCK_SIZE];
+    uint8_t sealed[sizeof(aeadPlain) + CHACHAPOLY_TAG_SIZE];
+    uint8_t opened[sizeof(aeadPlain)];
+    size_t len = sizeof(aeadPlain) - 1;
+    Poly1305 poly;
+    size_t i;
+
+    for (i = 0; i < sizeof(seq); i++) {
+        seq[i] = (uint8_t)i;
+        aeadKey[i] = (uint8_t)(0x80 + i);
+    }
+    chacha20Block(seq, blockNonce, 1, out);
+    check("ChaCha20 block", out, block, sizeof(block));
+    chacha20Derive(seq, deriveInput, out);
+    check("HChaCha20", out, derived, sizeof(derived));
+    poly1305Init(&poly, polyKey);
+    poly1305Update(&poly, (const uint8_t *)polyMessage,
+                   sizeof(polyMessage) - 1);
+    poly1305Finish(&poly, out);
+    check("Poly1305", out, polyTag, sizeof(polyTag));
+
+    chachaPolySeal(aeadKey, aeadNonce, aeadAad, sizeof(aeadAad),
+                   (const uint8_t *)aeadPlain, len, sealed);
+    check("ChaCha20-Poly1305 ciphertext", sealed, aeadStart,
+          sizeof(aeadStart));
+    check("ChaCha20-Poly1305 tag", &sealed[len], aeadTag, sizeof(aeadTag));
+    if (!chachaPolyOpen(aeadKey, aeadNonce, aeadAad, sizeof(aeadAad), sealed,
+                        len + CHACHAPOLY_TAG_SIZE, opened) ||
+        !check("ChaCha20-Poly1305 opened", opened,
+               (const uint8_t *)aeadPlain, len)) {
+        failed = true;
+    }
+    sealed[len / 2] ^= 0x01;
+    if (chachaPolyOpen(aeadKey, aeadNonce, aeadAad, sizeof(aeadAad), sealed,
+                       len + CHACHAPOLY_TAG_SIZE, opened)) {
+        fprintf(stderr, "session-bench: forgery opened\n");
+        failed = true;
+    }
+    printf("test vectors: %s\n", failed ? "FAILED" : "ok");
+}
+
+/*===========================================================================*/
+/* Cycles.                                                                   */
+/*===========================================================================*/
+
+static uint32_t samples[RUNS];
+
+static int compare(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static uint32_t median(void) {
+    qsort(samples, RUNS, sizeof(samples[0]), compare);
+    return samples[RUNS / 2];
+}
+
+static void cycles(void) {
+    static const uint8_t nonce[CHACHAPOLY_NONCE_SIZE] = {0};
+    static const uint8_t aad[2] = {PROTO_ADDRESS_P2P, PROTO_MSG_EVENT};
+    uint8_t message[PROTO_PAYLOAD_MAX];
+    uint8_t sealed[PROTO_PAYLOAD_MAX + CHACHAPOLY_TAG_SIZE];
+    uint8_t block[CHACHA20_BLOCK_SIZE];
+    uint8_t tag[POLY1305_TAG_SIZE];
+    uint8_t input[CHACHA20_DERIVE_INPUT_SIZE] = {0};
+    Poly1305 poly;
+    size_t i;
+
+    memset(message, 0x5A, sizeof(message));
+    printf("cycles of the build machine, median of %u runs, %u B message:\n",
+           RUNS, PROTO_PAYLOAD_MAX);
+
+    for (i = 0; i < RUNS; i++) {
+        uint32_t start = platformCycles();
+
+        chacha20Block(key, nonce, (uint32_t)i, block);
+        samples[i] = platformElapsedCycles(start);
+    }
+    printf("  ChaCha20 block (64 B)          %6u\n", (unsigned)median());
+    for (i = 0; i < RUNS; i++) {
+        uint32_t start = platformCycles();
+
+        poly1305Init(&poly, key);
+        poly1305Update(&poly, message, sizeof(message));
+        poly1305Finish(&poly, tag);
+        samples[i] = platformElapsedCycles(start);
+    }
+    printf("  Poly1305 (%u B)                %6u\n", PROTO_PAYLOAD_MAX,
+           (unsigned)median());
+    for (i = 0; i < RUNS; i++) {
+        uint32_t start = platformCycles();
+
+        chachaPolySeal(key, nonce, aad, sizeof(aad), message,
+                       sizeof(message), sealed);
+        samples[i] = platformElapsedCycles(start);
+    }
+    printf("  seal                           %6u\n", (unsigned)median());
+    for (i = 0; i < RUNS; i++) {
+        uint32_t start = platformCycles();
+
+        if (!chachaPolyOpen(key, nonce, aad, sizeof(aad), sealed,
+                            sizeof(sealed), message)) {
+            failed = true;
+        }
+        samples[i] = platformElapsedCycles(start);
+    }
+    printf("  open                           %6u\n", (unsigned)median());
+    for (i = 0; i < RUNS; i++) {
+        uint32_t start = platformCycles();
+
+        /* Session key and one handshake tag, what each end computes. */
+        input[0] = (uint8_t)i;
+        chacha20Derive(key, input, block);
+        chachaPolySeal(block, nonce, input, sizeof(input), NULL, 0, tag);
+        samples[i] = platformElapsedCycles(start);
+    }
+    printf("  handshake                      %6u\n", (unsigned)median());
+}
+
+/*===========================================================================*/
+/* Link.                                                                     */
+/*===========================================================================*/
+
+static void reader_send(void *arg, const uint8_t *frame, size_t len) {
+    linkSend(arg, frame, len);
+}
+
+static void reader_receive(void *arg, uint8_t type, const uint8_t *payload,
+                           size_t len) {
+    uint32_t n;
+
+    (void)arg;
+
+    if (type != PROTO_MSG_FEEDBACK || len != 1 + UID_LEN ||
+        payload[0] != UID_LEN) {
+        failed = true;
+        return;
+    }
+    n = (uint32_t)payload[1] << 24 | (uint32_t)payload[2] << 16 |
+        (uint32_t)payload[3] << 8 | payload[4];
+    if (n != feedbacks) {
+        failed = true;
+        return;
+    }
+    latency[feedbacks++] = platformElapsedUs(sentAt[n]);
+}
+
+static uint32_t reader_service(void *arg) {
+    (void)arg;
+
+    return proto.session != NULL ? linkSessionService(&session)
+                                 : LINK_WAIT_FOREVER;
+}
+
+static void send_event(uint32_t n) {
+    ReaderEvent event;
+    uint8_t payload[READER_EVENT_MAX_SIZE];
+    size_t len;
+
+    memset(&event, 0, sizeof(event));
+    event.type = READER_EVENT_CARD;
+    event.card.uidlen = UID_LEN;
+    event.card.uid[0] = (uint8_t)(n >> 24);
+    event.card.uid[1] = (uint8_t)(n >> 16);
+    event.card.uid[2] = (uint8_t)(n >> 8);
+    event.card.uid[3] = (uint8_t)n;
+    event.card.uid[4] = 0x5A;
+    event.card.sak = 0x08;
+    event.card.atqa[0] = 0x44;
+    len = readerEventEncode(&event, payload, sizeof(payload));
+
+    sentAt[n] = platformNowUs();
+    while (protoSend(&proto, PROTO_MSG_EVENT, payload, len) != PROTO_OK) {
+        /* The window stuck, or the session not coming up again. */
+        if (platformElapsedUs(sentAt[n]) >= DRAIN_US) {
+            failed = true;
+            return;
+        }
+        protoRun(&proto, &link, 100);
+    }
+    sentAt[n] = platformNowUs();
+}
+
+/*
+ * Sends events back to back, lets the controller start on their feedback,
+ * loses the next event on the line and starts a new handshake with the
+ * events after it in flight.
+ */
+static uint32_t rekey(uint32_t i) {
+    uint32_t k;
+
+    for (k = 0; k < REKEY_BURST; k++) {
+        send_event(i++);
+    }
+    while (controller.stats.feedbacks < i && platformElapsedUs(sentAt[i - 1]) <
+                                                 DRAIN_US) {
+        protoRun(&proto, &link, 100);
+    }
+    controller.drop = 1;
+    for (k = 0; k < REKEY_BURST; k++) {
+        send_event(i++);
+    }
+    controllerSimRekey(&controller);
+    return i;
+}
+
+static void run(const char *name, bool secure, bool rekeyed,
+                uint32_t errorPpm) {
+    static const uint8_t entropy[] = "reader-entropy";
+    uint32_t start;
+    uint32_t rekeyedAt = 0;
+    uint32_t handshake = 0;
+    uint64_t bytes;
+    uint64_t sum = 0;
+    uint32_t i;
+
+    uartSimInit(&sim, BITRATE, &link);
+    sim.errorPpm = errorPpm;
+    sim.seed = 2024;
+    linkObjectInit(&link);
+    linkStart(&link, &linkConfig);
+    memset(&config, 0, sizeof(config));
+    config.send = reader_send;
+    config.receive = reader_receive;
+    config.service = reader_service;
+    config.arg = &link;
+    config.window = PROTO_WINDOW_MAX;
+    config.retransmit = PROTO_RETRANSMIT_US;
+    protoInit(&proto, &config);
+    controllerSimInit(&controller, &sim, PROTO_WINDOW_MAX,
+                      PROTO_RETRANSMIT_US);
+    controller.turnaround = TURNAROUND_US;
+    feedbacks = 0;
+
+    start = platformNowUs();
+    if (secure) {
+        linkSessionInit(&session, &proto, key);
+        linkSessionSeed(&session, entropy, sizeof(entropy));
+        controllerSimSecure(&controller, key);
+        while (session.state != LINK_SESSION_READY &&
+               platformElapsedUs(start) < DRAIN_US) {
+            protoRun(&proto, &link, 1000);
+        }
+        handshake = platformElapsedUs(start);
+        start = platformNowUs();
+    }
+    bytes = link.stats.txBytes + link.stats.rxBytes;
+
+    for (i = 0; i < EVENTS; i++) {
+        if (rekeyed && i == EVENTS / 2) {
+            rekeyedAt = platformNowUs();
+            handshake = 0;
+            i = rekey(i);
+        }
+        send_event(i);
+        /* One card at a time, the next taps after the feedback. */
+        while (feedbacks <= i && platformElapsedUs(sentAt[i]) < DRAIN_US) {
+            protoRun(&proto, &link, 1000);
+            if (rekeyedAt != 0 && handshake == 0 &&
+                session.stats.handshakes == 2) {
+                handshake = platformElapsedUs(rekeyedAt);
+            }
+        }
+    }
+    while (protoInFlight(&proto) > 0 && platformElapsedUs(start) < DRAIN_US) {
+        protoRun(&proto, &link, 1000);
+    }
+    bytes = link.stats.txBytes + link.stats.rxBytes - bytes;
+    controllerSimStop(&controller);
+    linkStop(&link);
+    uartSimRun(&sim);
+
+    if (feedbacks != EVENTS || controller.stats.events != EVENTS ||
+        controller.stats.misordered != 0) {
+        failed = true;
+    }
+    if (secure && (errorPpm == 0 && (session.stats.rejected != 0 ||
+        controller.reader[0].session.stats.rejected != 0))) {
+        failed = true;
+    }
+    if (secure && (session.stats.handshakes != (rekeyed ? 2U : 1U) ||
+                   controller.reader[0].session.stats.handshakes !=
+                       session.stats.handshakes)) {
+        failed = true;
+    }
+    for (i = 0; i < feedbacks; i++) {
+        sum += latency[i];
+    }
+    qsort(latency, feedbacks, sizeof(latency[0]), compare);
+    printf("  %-16s %9.1f %7.1f %8.0f %8u %8u\n", name, handshake / 1000.0,
+           (double)bytes / EVENTS,
+           feedbacks > 0 ? (double)sum / feedbacks : 0.0,
+           feedbacks > 0 ? (unsigned)latency[feedbacks * 99 / 100] : 0,
+           (unsigned)(secure ? session.stats.rejected : 0));
+}
+
+int main(void) {
+    printf("session-bench (ChaCha20-Poly1305)\n");
+    known_answers();
+    cycles();
+    printf("link at %u bit/s, %u events one at a time:\n", BITRATE, EVENTS);
+    printf("  %-16s %9s %7s %8s %8s %8s\n", "", "hello ms", "B/event",
+           "mean us", "p99 us", "rejected");
+    run("clear", false, false, 0);
+    run("sealed", true, false, 0);
+    run("sealed, noisy", true, false, ERROR_PPM);
+    run("sealed, rekeyed", true, true, 0);
+    if (failed) {
+        fprintf(stderr, "session-bench: wrong test vector, forgery opened or "
+                        "events lost\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
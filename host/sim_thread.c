@@ -0,0 +1,102 @@
+/**
+ * @file    sim_thread.c
+ * @brief   Cooperative threads on the virtual clock.
+ */
+
+#include <string.h>
+
+#include "sim_thread.h"
+#include "vclock.h"
+
+static ucontext_t scheduler;
+static SimThread *current;
+
+static void entry(void) {
+    SimThread *tp = current;
+
+    tp->fn(tp->arg);
+    tp->done = true;
+}
+
+static bool ready(const SimThread *tp) {
+    return (tp->waiting != NULL && !*tp->waiting) ||
+           vclockNow() >= tp->deadline;
+}
+
+/**
+ * @brief   Sets up a thread running @p fn, started by @p simThreadRun().
+ */
+void simThreadCreate(SimThread *tp, simthreadfn_t fn, void *arg) {
+    memset(tp, 0, sizeof(*tp));
+    tp->fn = fn;
+    tp->arg = arg;
+    getcontext(&tp->context);
+    tp->context.uc_stack.ss_sp = tp->stack;
+    tp->context.uc_stack.ss_size = sizeof(tp->stack);
+    tp->context.uc_link = &scheduler;
+    makecontext(&tp->context, entry, 0);
+}
+
+/**
+ * @brief   Runs the threads until they all returned, or until they all wait
+ *          and nothing is left to wake them.
+ */
+void simThreadRun(SimThread *threads, size_t n) {
+    while (true) {
+        uint64_t next = vclockNext();
+        bool alive = false;
+        bool ran = false;
+        size_t i;
+
+        for (i = 0; i < n; i++) {
+            SimThread *tp = &threads[i];
+
+            if (tp->done) {
+                continue;
+            }
+            alive = true;
+            if (ready(tp)) {
+                current = tp;
+                swapcontext(&scheduler, &tp->context);
+                current = NULL;
+                ran = true;
+            }
+        }
+        if (!alive) {
+            return;
+        }
+        if (ran) {
+            continue;
+        }
+        for (i = 0; i < n; i++) {
+            if (!threads[i].done && threads[i].deadline < next) {
+                next = threads[i].deadline;
+            }
+        }
+        if (next == UINT64_MAX) {
+            return;
+        }
+        vclockAdvance(next > vclockNow() ? next - vclockNow() : 0);
+    }
+}
+
+/**
+ * @brief   Whether the caller runs in a thread of @p simThreadRun().
+ */
+bool simThreadActive(void) {
+    return current != NULL;
+}
+
+/**
+ * @brief   Sleeps until @p *waiting is cleared, by a simulated interrupt,
+ *          or until @p deadline in ns, @p UINT64_MAX for none.
+ */
+void simThreadWait(const bool *waiting, uint64_t deadline) {
+    SimThread *tp = current;
+
+    tp->waiting = waiting;
+    tp->deadline = deadline;
+    swapcontext(&tp->context, &scheduler);
+    tp->waiting = NULL;
+    tp->deadline = 0;
+}
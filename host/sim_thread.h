@@ -0,0 +1,47 @@
+/**
+ * @file    sim_thread.h
+ * @brief   Cooperative threads on the virtual clock.
+ * @details Lets a host program run several firmware instances side by side,
+ *          each in its own thread, e.g. readers sharing a bus. A thread
+ *          runs until it waits in @p simThreadWait(), which the simulated
+ *          transports call in place of advancing the clock themselves. Once
+ *          every thread waits, @p simThreadRun() moves the clock to the next
+ *          timer or deadline.
+ */
+
+#ifndef _SIM_THREAD_H_
+#define _SIM_THREAD_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <ucontext.h>
+
+/**
+ * @brief   Stack of a thread.
+ */
+#define SIM_THREAD_STACK_SIZE       65536
+
+typedef void (*simthreadfn_t)(void *arg);
+
+typedef struct {
+    ucontext_t context;
+    simthreadfn_t fn;
+    void *arg;
+    const bool *waiting;            /**< Woken once cleared, if not NULL.   */
+    uint64_t deadline;              /**< Woken then anyway, in ns.          */
+    bool done;
+    uint8_t stack[SIM_THREAD_STACK_SIZE];
+} SimThread;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void simThreadCreate(SimThread *tp, simthreadfn_t fn, void *arg);
+  void simThreadRun(SimThread *threads, size_t n);
+  bool simThreadActive(void);
+  void simThreadWait(const bool *waiting, uint64_t deadline);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SIM_THREAD_H_ */
@@ -0,0 +1,266 @@
+/**
+ * @file    synth_bench.c
+ * @brief   Wavetable tunes: accuracy and render cycles per block.
+ * @details Checks the wavetables built by the compiler against the C
+ *          library and the note phase increments against equal
+ *          temperament, then plays each tune of the reader through the
+ *          engine, block by block as the DMA has them, the alarm for
+ *          @p ALARM_BLOCKS blocks before it is stopped.
+ *
+ *          Each tune is compared with the same notes rendered in double
+ *          precision, with the exact waves and envelopes, and reports its
+ *          length, signal to noise ratio, and render cycles per block,
+ *          average and longest, in cycles of the build machine, with the
+ *          load they would be on a 48 MHz core. With @p --wav FILE the
+ *          tunes are also written to a WAV file.
+ *
+ *          Fails if a table is off by more than a step, a note by more than
+ *          @p MAX_CENTS, a tune plays other than its length or comes out
+ *          noisier than @p MIN_SNR_DB, or the alarm goes on once stopped.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio/synth.h"
+#include "wav.h"
+
+#define ALARM_BLOCKS                200
+#define MAX_CENTS                   0.01
+#define MIN_SNR_DB                  25.0
+#define CPU_HZ                      48000000U
+#define GAP_SAMPLES                 (AUDIO_RATE / 5U)
+
+#define OUT_SIZE                    ((ALARM_BLOCKS + 4) * AUDIO_BLOCK)
+
+#define PI                          3.14159265358979323846
+
+static const struct {
+    const char *name;
+    const SynthTune *tune;
+    uint32_t samples;               /**< 0 for until stopped.               */
+} tunes[] = {
+    {"grant", &synthGrant, 22 * SYNTH_TICK_MS * AUDIO_RATE / 1000},
+    {"deny", &synthDeny, 35 * SYNTH_TICK_MS * AUDIO_RATE / 1000},
+    {"alarm", &synthAlarm, 0},
+};
+
+static int16_t out[OUT_SIZE];
+static double reference[OUT_SIZE];
+static bool failed;
+
+/*===========================================================================*/
+/* Tables.                                                                   */
+/*===========================================================================*/
+
+static double wave(unsigned w, double x) {
+    double v = 0;
+    unsigned k;
+
+    switch (w) {
+    case SYNTH_WAVE_SINE:
+        return sin(2 * PI * x);
+    case SYNTH_WAVE_SQUARE:
+        for (k = 1; k <= 7; k += 2) {
+            v += sin(2 * PI * k * x) / k;
+        }
+        return 1.07 * v;
+    default:
+        for (k = 1; k <= 6; k++) {
+            v += sin(2 * PI * k * x) / k;
+        }
+        return 0.61 * v;
+    }
+}
+
+static void tables(void) {
+    double worst = 0, worstCents = 0;
+    unsigned w, i;
+
+    for (w = 0; w < SYNTH_WAVES; w++) {
+        for (i = 0; i < SYNTH_TABLE_SIZE; i++) {
+            double v = 32767.0 * wave(w, (double)i / SYNTH_TABLE_SIZE);
+            double d = fabs(synthTables[w][i] - v);
+
+            if (d > worst) {
+                worst = d;
+            }
+        }
+    }
+    for (i = 21; i <= 108; i++) {
+        double hz = 440.0 * pow(2.0, ((int)i - 69) / 12.0);
+        double got = synthNoteStep((uint8_t)i) * (double)AUDIO_RATE /
+                     4294967296.0;
+        double cents = fabs(1200.0 * log2(got / hz));
+
+        if (cents > worstCents) {
+            worstCents = cents;
+        }
+    }
+    printf("  tables within %.2f steps of the C library, notes A0 to C8 "
+           "within %.4f cents\n", worst, worstCents);
+    if (worst > 1.0 || worstCents > MAX_CENTS) {
+        failed = true;
+    }
+}
+
+/*===========================================================================*/
+/* Reference.                                                                */
+/*===========================================================================*/
+
+/*
+ * Adds a track in double precision, its phase as the synthesizer steps it.
+ */
+static void reference_track(const SynthTrack *tp, size_t total) {
+    const SynthInstrument *ip = tp->instrument;
+    double peak = (32767 / SYNTH_VOICES) * ip->level / 255.0;
+    double hold = peak * ip->sustain / 255.0;
+    const SynthNote *np = tp->notes;
+    uint32_t phase = 0;
+    size_t at = 0;
+
+    while (at < total) {
+        uint32_t len, a, d, r, s, j;
+
+        if (np->note == SYNTH_LOOP) {
+            np = tp->notes;
+        }
+        if (np->note == SYNTH_END) {
+            return;
+        }
+        len = np->ticks * SYNTH_TICK_MS * AUDIO_RATE / 1000U;
+        if (np->note == SYNTH_REST) {
+            at += len;
+            np++;
+            continue;
+        }
+        a = ip->attack < len ? ip->attack : len;
+        d = ip->decay < len - a ? ip->decay : len - a;
+        r = ip->release < len - a - d ? ip->release : len - a - d;
+        s = len - a - d - r;
+        for (j = 0; j < len && at < total; j++, at++) {
+            double env;
+
+            if (j < a) {
+                env = peak * (j + 1) / a;
+            } else if (j < a + d) {
+                env = peak + (hold - peak) * (j - a + 1) / d;
+            } else if (j < a + d + s) {
+                env = hold;
+            } else {
+                env = hold * (1.0 - (double)(j - a - d - s + 1) / r);
+            }
+            reference[at] += env * wave(ip->wave, phase / 4294967296.0);
+            phase += synthNoteStep(np->note);
+        }
+        np++;
+    }
+}
+
+/*===========================================================================*/
+/* Tunes.                                                                    */
+/*===========================================================================*/
+
+static void run(size_t t, FILE *wav) {
+    static const int16_t gap[GAP_SAMPLES];
+    AudioEngine engine;
+    SynthPlayer player;
+    uint16_t block[AUDIO_BLOCK];
+    size_t at = 0, length = 0, blocks = 0, i;
+    double signal = 0, noise = 0, snr;
+
+    audioInit(&engine);
+    synthInit(&player, tunes[t].tune);
+    audioPlay(&engine, synthSource, &player);
+    while (audioRefill(&engine, block)) {
+        for (i = 0; i < AUDIO_BLOCK && at < OUT_SIZE; i++, at++) {
+            out[at] = (int16_t)((block[i] << 4) - 32768);
+            if (block[i] != AUDIO_DAC_ZERO) {
+                length = at + 1;
+            }
+        }
+        if (++blocks == ALARM_BLOCKS && tunes[t].samples == 0) {
+            audioPlay(&engine, NULL, NULL);
+        }
+        if (blocks > ALARM_BLOCKS + 3) {
+            /* Not stopped. */
+            failed = true;
+            break;
+        }
+    }
+
+    /* The DAC keeps 12 bits, so does the reference. */
+    memset(reference, 0, sizeof(reference));
+    for (i = 0; i < SYNTH_VOICES; i++) {
+        if (tunes[t].tune->tracks[i].notes != NULL) {
+            reference_track(&tunes[t].tune->tracks[i],
+                            tunes[t].samples != 0 ? tunes[t].samples
+                                                  : ALARM_BLOCKS *
+                                                        AUDIO_BLOCK);
+        }
+    }
+    for (i = 0; i < at; i++) {
+        double d = out[i] - floor((reference[i] + 32768.0) / 16.0) * 16.0 +
+                   32768.0;
+
+        signal += reference[i] * reference[i];
+        noise += d * d;
+    }
+    snr = noise != 0 ? 10.0 * log10(signal / noise) : 99.0;
+    if (snr < MIN_SNR_DB ||
+        (tunes[t].samples != 0 && (length > tunes[t].samples ||
+                                   length + AUDIO_BLOCK < tunes[t].samples)) ||
+        (tunes[t].samples == 0 && length != ALARM_BLOCKS * AUDIO_BLOCK)) {
+        failed = true;
+    }
+
+    printf("  %-6s %7.3f %6.1f %7u %9.1f %7u %6.2f%%\n", tunes[t].name,
+           (double)length / AUDIO_RATE, snr, (unsigned)engine.stats.blocks,
+           (double)engine.stats.cycles / engine.stats.blocks,
+           (unsigned)engine.stats.maxCycles,
+           audioLoad(&engine, CPU_HZ) / 10.0);
+    if (wav != NULL) {
+        wavWrite(wav, out, at);
+        wavWrite(wav, gap, GAP_SAMPLES);
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *path = NULL;
+    FILE *wav = NULL;
+    size_t t;
+
+    if (argc == 3 && strcmp(argv[1], "--wav") == 0) {
+        path = argv[2];
+        wav = wavCreate(path, AUDIO_RATE);
+        if (wav == NULL) {
+            perror(path);
+            return EXIT_FAILURE;
+        }
+    } else if (argc != 1) {
+        fprintf(stderr, "usage: %s [--wav FILE]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("synth-bench (%u voices, tables of %u samples, blocks of %u, "
+           "cycles of the build machine)\n", SYNTH_VOICES, SYNTH_TABLE_SIZE,
+           AUDIO_BLOCK);
+    tables();
+    printf("  %-6s %7s %6s %7s %9s %7s %7s\n", "tune", "s", "snr dB",
+           "blocks", "cyc/blk", "max", "load");
+    for (t = 0; t < sizeof(tunes) / sizeof(tunes[0]); t++) {
+        run(t, wav);
+    }
+    printf("load on a %u MHz core\n", CPU_HZ / 1000000U);
+    if (wav != NULL && !wavClose(wav)) {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+    if (failed) {
+        fprintf(stderr, "synth-bench: tune not as composed\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
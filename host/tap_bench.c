@@ -0,0 +1,627 @@
+/**
+ * @file    tap_bench.c
+ * @brief   Tap-to-decision latency of the reader on the chip model.
+ * @details Cards enter the field at scripted times while the reader polls
+ *          with REQA. Each tap goes through the stages
+ *          - detect: from the card entering the field to its ATQA,
+ *          - anticollision and select, for every cascade level,
+ *          - auth: MIFARE authentication to sector 1,
+ *          - encode: the card event put into the outbox, in cycles of the
+ *            build machine charged at @p CPU_HZ,
+ *          - link TX: from the outbox to the event received by the
+ *            controller stand-in, through the protocol and the DMA link on
+ *            the simulated USART at @p SERIAL_DEFAULT_BITRATE of
+ *            @p halconf.h,
+ *          - feedback: from there to the feedback command received by the
+ *            reader, @p TURNAROUND_US of it spent by the controller,
+ *
+ *          and ends with the feedback, the decision shown to the holder. A
+ *          stage starts with its first frame on air, so the driver work
+ *          between two frames is charged to the stage before it. Failed
+ *          attempts are retried from the next poll and charged to the
+ *          stages they happen in. The link is serviced while the reader
+ *          waits for the next poll, as the link thread does.
+ *
+ *          The dwell scenarios leave a card on the reader for
+ *          @p DWELL_US and compare re-reading it on every poll with the
+ *          presence tracker, in RF time, frames and line bytes sent by the
+ *          reader per second of dwell.
+ *
+ *          With @p --json FILE the results are also written as JSON, to be
+ *          compared between builds.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chconf.h"
+#include "halconf.h"
+
+#include "drivers/mfrc522.h"
+#include "link/proto.h"
+#include "reader/event.h"
+#include "reader/outbox.h"
+#include "reader/presence.h"
+#include "rfid/iso14443a.h"
+#include "controller_sim.h"
+#include "mfrc522_sim_hw.h"
+#include "uart_sim.h"
+#include "vclock.h"
+
+#define TAPS                        1000
+
+/* The reader sends REQA this often while no card is being read. */
+#if !defined(TAP_POLL_PERIOD_US)
+#define TAP_POLL_PERIOD_US          20000
+#endif
+
+/* A card stays in the field this long. */
+#define TAP_DWELL_US                300000
+
+/* The reader waits this long after switching the field on. */
+#define FIELD_GUARD_US              5000
+
+#define AUTH_BLOCK                  4
+
+/* A card rests on the reader this long in the dwell scenarios. */
+#define DWELL_US                    10000000
+
+/* The controller decides on a card event this long after receiving it. */
+#define TURNAROUND_US               500
+
+#define WINDOW                      4
+
+/* Clock of the target core the encode cycles are charged at. */
+#define CPU_HZ                      48000000U
+
+/* Gives up on the feedback after this long. */
+#define FEEDBACK_WAIT_US            1000000
+
+enum {
+    STAGE_DETECT,
+    STAGE_ANTICOLLISION,
+    STAGE_SELECT,
+    STAGE_AUTH,
+    STAGE_ENCODE,
+    STAGE_LINK,
+    STAGE_FEEDBACK,
+    STAGE_COUNT,
+    STAGE_NONE = STAGE_COUNT
+};
+
+static const char *const stage_names[STAGE_COUNT] = {
+    "detect", "anticollision", "select", "auth", "encode", "link_tx",
+    "feedback"
+};
+
+typedef struct {
+    const char *name;
+    uint8_t uidlen;
+    uint16_t faultPermille;
+    /**
+     * @brief   The next card arrives as soon as the previous one has been
+     *          read, instead of at a random point of the poll period.
+     */
+    bool load;
+} Scenario;
+
+static const Scenario scenarios[] = {
+    {"tap_4b", 4, 0, false},
+    {"tap_7b", 7, 0, false},
+    {"tap_4b_rf_errors", 4, 20, false},
+    {"load_4b", 4, 0, true},
+};
+
+typedef struct {
+    uint64_t p50, p99, max, mean;
+} Percentiles;
+
+/**
+ * @brief   Cost per second of dwell.
+ */
+typedef struct {
+    double rfUs;                    /**< Time spent on the RF side.         */
+    double frames;
+    double linkBytes;               /**< Line bytes sent by the reader.     */
+    unsigned events;                /**< Events sent in total.              */
+} DwellResult;
+
+typedef struct {
+    unsigned taps;
+    unsigned failed;
+    double readsPerS;
+    Percentiles total;
+    Percentiles stages[STAGE_COUNT];
+} Result;
+
+static MFRC522Sim chip;
+static MFRC522SimBus bus = {&chip, {0, 0, 0, 0}};
+static MFRC522Driver rfid;
+
+static const MFRC522Config config = {
+    &mfrc522SimTransport,
+    &bus
+};
+
+static const uint8_t key[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+static UartSim sim;
+static LinkDriver link;
+static const LinkConfig linkConfig = {&uartSimTransport, &sim};
+static ControllerSim controller;
+static Proto proto;
+static ProtoConfig protoConfig;
+static ReaderOutbox outbox;
+
+/**
+ * @brief   Stage accounting of the tap in progress.
+ */
+static struct {
+    int current;
+    uint64_t since;
+    uint64_t ns[STAGE_COUNT];
+    uint64_t decidedAt;             /**< Feedback received, 0 if not yet.   */
+} tap;
+
+static uint64_t samples[STAGE_COUNT + 1][TAPS];
+static uint32_t link_bytes;
+static unsigned link_events;
+static uint32_t seed = 1;
+
+static uint32_t random_next(void) {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static void stage_enter(int stage) {
+    uint64_t now = vclockNow();
+
+    if (tap.current != STAGE_NONE && now > tap.since) {
+        tap.ns[tap.current] += now - tap.since;
+        tap.since = now;
+    }
+    tap.current = stage;
+}
+
+/**
+ * @brief   Moves the tap to the stage of the frame going on air.
+ */
+static void on_transmit(void *ctx, const uint8_t *frame, size_t bits) {
+    (void)ctx;
+
+    if (tap.current == STAGE_NONE || vclockNow() < tap.since) {
+        return;
+    }
+    if (bits == 7) {
+        stage_enter(STAGE_DETECT);
+    } else if (bits >= 16 && (frame[0] == 0x93 || frame[0] == 0x95 ||
+                              frame[0] == 0x97)) {
+        stage_enter(frame[1] == 0x70 ? STAGE_SELECT : STAGE_ANTICOLLISION);
+    }
+}
+
+static void reader_send(void *arg, const uint8_t *frame, size_t len) {
+    link_bytes += (uint32_t)len;
+    linkSend(arg, frame, len);
+}
+
+static void reader_receive(void *arg, uint8_t type, const uint8_t *payload,
+                           size_t len) {
+    (void)arg;
+    (void)payload;
+    (void)len;
+
+    if (type == PROTO_MSG_FEEDBACK && tap.current == STAGE_FEEDBACK) {
+        stage_enter(STAGE_NONE);
+        tap.decidedAt = vclockNow();
+    }
+}
+
+static uint32_t reader_service(void *arg) {
+    (void)arg;
+
+    return readerOutboxService(&outbox);
+}
+
+static void controller_event(ControllerSim *csp, size_t reader,
+                             const uint8_t *event, size_t len) {
+    (void)csp;
+    (void)reader;
+    (void)event;
+    (void)len;
+
+    if (tap.current == STAGE_LINK) {
+        stage_enter(STAGE_FEEDBACK);
+    }
+}
+
+/**
+ * @brief   Puts the event into the outbox for the link to send.
+ */
+static void link_send(const uint8_t *buf, size_t len) {
+    if (!readerOutboxPut(&outbox, buf, len, readerOutboxPriority(buf[0]))) {
+        fprintf(stderr, "tap-bench: outbox full\n");
+        exit(EXIT_FAILURE);
+    }
+    link_events++;
+}
+
+/**
+ * @brief   Waits @p us for the next poll, running the link meanwhile.
+ */
+static void wait_us(uint32_t us) {
+    protoRun(&proto, &link, us);
+}
+
+/**
+ * @brief   Reads the card once it answers, up to the event sent.
+ */
+static bool read_card(void) {
+    ReaderEvent event;
+    uint8_t buf[READER_EVENT_MAX_SIZE];
+    size_t len;
+    mfrc522result_t result;
+    uint32_t start;
+    uint64_t sent;
+
+    result = iso14443aRequest(&rfid, false, event.card.atqa);
+    if (result != MFRC522_OK && result != MFRC522_COLLISION) {
+        return false;
+    }
+    if (iso14443aSelect(&rfid, &event.card) != MFRC522_OK) {
+        return false;
+    }
+
+    stage_enter(STAGE_AUTH);
+    result = mfrc522Authenticate(&rfid, MFRC522_MF_AUTH_KEY_A, AUTH_BLOCK, key,
+                                 event.card.uid);
+    mfrc522StopCrypto(&rfid);
+    if (result != MFRC522_OK) {
+        return false;
+    }
+    event.type = READER_EVENT_CARD;
+    event.flags = READER_EVENT_FLAG_AUTH;
+
+    stage_enter(STAGE_ENCODE);
+    start = platformCycles();
+    len = readerEventEncode(&event, buf, sizeof(buf));
+    link_send(buf, len);
+    vclockAdvance((uint64_t)platformElapsedCycles(start) * 1000000000U /
+                  CPU_HZ);
+
+    stage_enter(STAGE_LINK);
+    iso14443aHalt(&rfid);
+    sent = vclockNow();
+    while (tap.decidedAt == 0 &&
+           vclockNow() - sent < FEEDBACK_WAIT_US * 1000ULL) {
+        wait_us(1000);
+    }
+    if (tap.decidedAt == 0) {
+        stage_enter(STAGE_NONE);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief   Polls until the card has been read or has left the field.
+ *
+ * @return  Tap-to-decision latency in ns, 0 if the card was not read.
+ */
+static uint64_t run_tap(PiccSim *card) {
+    uint64_t next_poll = vclockNow();
+
+    memset(&tap, 0, sizeof(tap));
+    tap.current = STAGE_DETECT;
+    tap.since = card->arriveNs;
+
+    while (vclockNow() < card->leaveNs) {
+        uint64_t now;
+
+        if (read_card()) {
+            return tap.decidedAt - card->arriveNs;
+        }
+        next_poll += TAP_POLL_PERIOD_US * 1000U;
+        now = vclockNow();
+        if (next_poll > now) {
+            wait_us((uint32_t)((next_poll - now + 999) / 1000));
+        } else {
+            next_poll = now;
+        }
+    }
+    tap.current = STAGE_NONE;
+    return 0;
+}
+
+static int compare(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static Percentiles percentiles(uint64_t *values, unsigned n) {
+    Percentiles p = {0, 0, 0, 0};
+    uint64_t sum = 0;
+    unsigned i;
+
+    if (n == 0) {
+        return p;
+    }
+    qsort(values, n, sizeof(values[0]), compare);
+    for (i = 0; i < n; i++) {
+        sum += values[i];
+    }
+    p.p50 = values[(n - 1) / 2];
+    p.p99 = values[(n * 99 + 99) / 100 - 1];
+    p.max = values[n - 1];
+    p.mean = sum / n;
+    return p;
+}
+
+static void start_chip(void) {
+    mfrc522SimInit(&chip, NULL);
+    chip.onTransmit = on_transmit;
+    tap.current = STAGE_NONE;
+    mfrc522ObjectInit(&rfid);
+    if (mfrc522Start(&rfid, &config) != MFRC522_OK) {
+        fprintf(stderr, "tap-bench: chip did not start\n");
+        exit(EXIT_FAILURE);
+    }
+    mfrc522SetField(&rfid, true);
+    platformDelayUs(FIELD_GUARD_US);
+}
+
+static void start_link(void) {
+    uartSimInit(&sim, SERIAL_DEFAULT_BITRATE, &link);
+    linkObjectInit(&link);
+    linkStart(&link, &linkConfig);
+
+    memset(&protoConfig, 0, sizeof(protoConfig));
+    protoConfig.send = reader_send;
+    protoConfig.receive = reader_receive;
+    protoConfig.service = reader_service;
+    protoConfig.arg = &link;
+    protoConfig.window = WINDOW;
+    protoConfig.retransmit = PROTO_RETRANSMIT_US;
+    protoInit(&proto, &protoConfig);
+    readerOutboxInit(&outbox, &proto, NULL, NULL);
+
+    controllerSimInit(&controller, &sim, WINDOW, PROTO_RETRANSMIT_US);
+    controller.turnaround = TURNAROUND_US;
+    controller.event = controller_event;
+}
+
+static void stop_link(void) {
+    controllerSimStop(&controller);
+    linkStop(&link);
+    uartSimRun(&sim);
+}
+
+static void run_scenario(const Scenario *s, Result *r) {
+    static PiccSim card;
+    uint64_t start;
+    unsigned i, ok = 0;
+    int stage;
+
+    start_chip();
+    start_link();
+
+    memset(r, 0, sizeof(*r));
+    start = vclockNow();
+    for (i = 0; i < TAPS; i++) {
+        uint8_t uid[10];
+        uint64_t latency;
+        size_t j;
+
+        for (j = 0; j < s->uidlen; j++) {
+            uid[j] = (uint8_t)random_next();
+        }
+        uid[0] = uid[0] == 0x88 ? 0x08 : uid[0];
+        piccSimInit(&card, uid, s->uidlen, 0x08);
+        card.faultPermille = s->faultPermille;
+        card.randomFault = PICC_SIM_FAULT_CRC;
+        card.arriveNs = vclockNow();
+        if (!s->load) {
+            card.arriveNs += 1000000U + (uint64_t)(random_next() %
+                                                   TAP_POLL_PERIOD_US) * 1000U;
+        }
+        card.leaveNs = card.arriveNs + TAP_DWELL_US * 1000U;
+        mfrc522SimAddCard(&chip, &card);
+
+        latency = run_tap(&card);
+        if (latency == 0) {
+            r->failed++;
+        } else {
+            samples[STAGE_COUNT][ok] = latency;
+            for (stage = 0; stage < STAGE_COUNT; stage++) {
+                samples[stage][ok] = tap.ns[stage];
+            }
+            ok++;
+        }
+        mfrc522SimRemoveCard(&chip, &card);
+    }
+    stop_link();
+
+    r->taps = ok;
+    r->readsPerS = (double)ok * 1e9 / (double)(vclockNow() - start);
+    r->total = percentiles(samples[STAGE_COUNT], ok);
+    for (stage = 0; stage < STAGE_COUNT; stage++) {
+        r->stages[stage] = percentiles(samples[stage], ok);
+    }
+}
+
+static void send_presence(void *ctx, const Iso14443aCard *card, bool arrived) {
+    ReaderEvent event;
+    uint8_t buf[READER_EVENT_MAX_SIZE];
+
+    (void)ctx;
+    event.type = arrived ? READER_EVENT_CARD : READER_EVENT_CARD_GONE;
+    event.card = *card;
+    event.flags = 0;
+    link_send(buf, readerEventEncode(&event, buf, sizeof(buf)));
+}
+
+/**
+ * @brief   A card resting on the reader, reported on every poll or through
+ *          the presence tracker.
+ */
+static void run_dwell(bool tracked, DwellResult *r) {
+    static const uint8_t uid[] = {0x04, 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC};
+    static PiccSim card;
+    static ReaderPresence presence;
+    uint64_t rf_ns = 0, next_poll, end;
+    uint32_t frames;
+
+    start_chip();
+    start_link();
+    piccSimInit(&card, uid, sizeof(uid), 0x08);
+    card.arriveNs = vclockNow();
+    card.leaveNs = card.arriveNs + (uint64_t)DWELL_US * 1000U;
+    mfrc522SimAddCard(&chip, &card);
+    readerPresenceInit(&presence, send_presence, NULL);
+
+    link_bytes = 0;
+    link_events = 0;
+    frames = rfid.stats.frames;
+    next_poll = vclockNow();
+    end = card.leaveNs + READER_PRESENCE_HOLDOFF_US * 1000U +
+          TAP_POLL_PERIOD_US * 1000U;
+    while (vclockNow() < end) {
+        uint64_t t = vclockNow();
+
+        if (tracked) {
+            readerPresencePoll(&presence, &rfid);
+        } else {
+            ReaderEvent event;
+            uint8_t buf[READER_EVENT_MAX_SIZE];
+
+            if (iso14443aRequest(&rfid, true, event.card.atqa) == MFRC522_OK &&
+                iso14443aSelect(&rfid, &event.card) == MFRC522_OK) {
+                iso14443aHalt(&rfid);
+                event.type = READER_EVENT_CARD;
+                event.flags = 0;
+                link_send(buf, readerEventEncode(&event, buf, sizeof(buf)));
+            }
+        }
+        rf_ns += vclockNow() - t;
+
+        next_poll += TAP_POLL_PERIOD_US * 1000U;
+        if (next_poll > vclockNow()) {
+            wait_us((uint32_t)((next_poll - vclockNow() + 999) / 1000));
+        }
+    }
+    mfrc522SimRemoveCard(&chip, &card);
+    stop_link();
+
+    r->rfUs = rf_ns / 1000.0 / (DWELL_US / 1e6);
+    r->frames = (rfid.stats.frames - frames) / (DWELL_US / 1e6);
+    r->linkBytes = link_bytes / (DWELL_US / 1e6);
+    r->events = link_events;
+}
+
+static void print_dwell(const char *name, const DwellResult *r) {
+    printf("%s: per second of dwell %.0f us RF, %.1f frames, %.1f link bytes, "
+           "%u events\n", name, r->rfUs, r->frames, r->linkBytes, r->events);
+}
+
+static void print_result(const Scenario *s, const Result *r) {
+    int stage;
+
+    printf("%s: %u taps, %u failed, %.1f reads/s\n", s->name, r->taps,
+           r->failed, r->readsPerS);
+    printf("  %-14s %9s %9s %9s %9s\n", "us", "mean", "p50", "p99", "max");
+    for (stage = 0; stage <= STAGE_COUNT; stage++) {
+        const Percentiles *p = stage < STAGE_COUNT ? &r->stages[stage] : &r->total;
+
+        printf("  %-14s %9.1f %9.1f %9.1f %9.1f\n",
+               stage < STAGE_COUNT ? stage_names[stage] : "tap to decision",
+               p->mean / 1000.0, p->p50 / 1000.0, p->p99 / 1000.0,
+               p->max / 1000.0);
+    }
+}
+
+static void json_percentiles(FILE *f, const Percentiles *p) {
+    fprintf(f, "{\"mean\": %.1f, \"p50\": %.1f, \"p99\": %.1f, \"max\": %.1f}",
+            p->mean / 1000.0, p->p50 / 1000.0, p->p99 / 1000.0, p->max / 1000.0);
+}
+
+static void json_dwell(FILE *f, const char *name, const DwellResult *r) {
+    fprintf(f, "\"%s\": {\"rf_us_per_s\": %.1f, \"frames_per_s\": %.2f, "
+            "\"link_bytes_per_s\": %.2f, \"events\": %u}", name, r->rfUs,
+            r->frames, r->linkBytes, r->events);
+}
+
+static void write_json(const char *path, const Result *results, size_t n,
+                       const DwellResult *dwell) {
+    FILE *f = fopen(path, "w");
+    size_t i;
+    int stage;
+
+    if (f == NULL) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    fprintf(f, "{\n  \"bench\": \"tap\",\n  \"config\": {\"irq\": %s, "
+            "\"poll_period_us\": %u, \"link_bitrate\": %u, "
+            "\"st_frequency\": %u, \"turnaround_us\": %u, \"cpu_hz\": %u, "
+            "\"taps\": %u},\n  \"scenarios\": [\n",
+            MFRC522_USE_IRQ ? "true" : "false", TAP_POLL_PERIOD_US,
+            (unsigned)SERIAL_DEFAULT_BITRATE, (unsigned)CH_CFG_ST_FREQUENCY,
+            TURNAROUND_US, CPU_HZ, TAPS);
+    for (i = 0; i < n; i++) {
+        const Result *r = &results[i];
+
+        fprintf(f, "    {\"name\": \"%s\", \"taps\": %u, \"failed\": %u, "
+                "\"reads_per_s\": %.2f,\n     \"latency_us\": ",
+                scenarios[i].name, r->taps, r->failed, r->readsPerS);
+        json_percentiles(f, &r->total);
+        fprintf(f, ",\n     \"stages_us\": {");
+        for (stage = 0; stage < STAGE_COUNT; stage++) {
+            fprintf(f, "%s\n       \"%s\": ", stage > 0 ? "," : "",
+                    stage_names[stage]);
+            json_percentiles(f, &r->stages[stage]);
+        }
+        fprintf(f, "}}%s\n", i + 1 < n ? "," : "");
+    }
+    fprintf(f, "  ],\n  \"dwell\": {");
+    json_dwell(f, "naive", &dwell[0]);
+    fprintf(f, ", ");
+    json_dwell(f, "presence", &dwell[1]);
+    fprintf(f, "}\n}\n");
+    fclose(f);
+}
+
+int main(int argc, char **argv) {
+    Result results[sizeof(scenarios) / sizeof(scenarios[0])];
+    DwellResult dwell[2];
+    const char *json = NULL;
+    size_t i;
+
+    if (argc == 3 && strcmp(argv[1], "--json") == 0) {
+        json = argv[2];
+    } else if (argc != 1) {
+        fprintf(stderr, "usage: %s [--json FILE]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("tap-bench (%s, poll every %u us, link at %u bit/s, controller "
+           "turnaround %u us, encode at %u MHz)\n",
+           MFRC522_USE_IRQ ? "irq" : "polled", TAP_POLL_PERIOD_US,
+           (unsigned)SERIAL_DEFAULT_BITRATE, TURNAROUND_US,
+           CPU_HZ / 1000000U);
+    for (i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        run_scenario(&scenarios[i], &results[i]);
+        print_result(&scenarios[i], &results[i]);
+    }
+    run_dwell(false, &dwell[0]);
+    print_dwell("dwell_naive", &dwell[0]);
+    run_dwell(true, &dwell[1]);
+    print_dwell("dwell_presence", &dwell[1]);
+    if (json != NULL) {
+        write_json(json, results, sizeof(scenarios) / sizeof(scenarios[0]),
+                   dwell);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,198 @@
+/**
+ * @file    timer_bench.c
+ * @brief   Time the reader spends in delays and timeouts per transaction.
+ * @details Runs the transactions whose length depends on the resolution of
+ *          the platform delays: the chip start, a poll of an empty field, a
+ *          poll reading a new card, ISO-DEP activations with a start-up frame
+ *          guard time and a card reset by the field. Every transaction starts
+ *          at a random phase of the system tick.
+ *
+ *          Built twice: @p timer-bench with the microsecond GPT timers,
+ *          @p timer-bench-ticks with @p HAL_USE_GPT set to @p FALSE, where
+ *          every delay is rounded to system ticks. The difference of the two
+ *          is the time the timers save. A sleep on ticks may also end up to a
+ *          tick early, so guard times there are shorter than their setting.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chconf.h"
+#include "halconf.h"
+
+#include "drivers/mfrc522.h"
+#include "reader/poll.h"
+#include "rfid/isodep.h"
+#include "isodep_sim.h"
+#include "mfrc522_sim_hw.h"
+#include "vclock.h"
+
+#define ROUNDS                      1000
+
+#define US_PER_TICK                 (1000000U / CH_CFG_ST_FREQUENCY)
+
+static MFRC522Sim chip;
+static MFRC522SimBus bus = {&chip, {0, 0, 0, 0}};
+static MFRC522Driver rfid;
+static ReaderPresence presence;
+static ReaderPoll scheduler;
+
+static const MFRC522Config config = {
+    &mfrc522SimTransport,
+    &bus
+};
+
+static PiccSim card;
+static IsoDepSim app;
+static IsoDep isodep;
+static uint32_t seed = 1;
+static bool failed;
+
+static uint32_t random_next(void) {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+/**
+ * @brief   Moves to a random phase of the system tick.
+ */
+static void jitter(void) {
+    vclockAdvance((uint64_t)(random_next() % (US_PER_TICK * 1000U)));
+}
+
+static void start_chip(void) {
+    mfrc522SimInit(&chip, NULL);
+    mfrc522ObjectInit(&rfid);
+    if (mfrc522Start(&rfid, &config) != MFRC522_OK) {
+        fprintf(stderr, "timer-bench: chip did not start\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void report(const char *what, uint64_t ns) {
+    printf("  %-36s %8.1f us\n", what, ns / 1000.0 / ROUNDS);
+}
+
+static void bench_start(void) {
+    uint64_t total = 0;
+    unsigned i;
+
+    for (i = 0; i < ROUNDS; i++) {
+        uint64_t start;
+
+        jitter();
+        start = vclockNow();
+        start_chip();
+        total += vclockNow() - start;
+    }
+    report("chip start", total);
+}
+
+/**
+ * @brief   Polls from a powered down front-end, with or without a new card.
+ */
+static void bench_poll(bool with_card) {
+    static const uint8_t uid[] = {0xDE, 0xAD, 0xBE, 0xEF};
+    uint64_t total = 0;
+    unsigned i;
+
+    start_chip();
+    for (i = 0; i < ROUNDS; i++) {
+        uint64_t start;
+
+        readerPresenceInit(&presence, NULL, NULL);
+        readerPollInit(&scheduler, &rfid, &presence);
+        if (with_card) {
+            piccSimInit(&card, uid, sizeof(uid), 0x08);
+            card.arriveNs = vclockNow();
+            mfrc522SimAddCard(&chip, &card);
+        }
+        jitter();
+        start = vclockNow();
+        readerPollRun(&scheduler);
+        total += vclockNow() - start;
+        if (with_card) {
+            if (presence.stats.arrivals != 1) {
+                failed = true;
+            }
+            mfrc522SimRemoveCard(&chip, &card);
+        }
+        mfrc522SetField(&rfid, false);
+        mfrc522SetPowerDown(&rfid, true);
+        platformDelayUs(ISO14443A_RESET_US);
+    }
+    report(with_card ? "poll, new card" : "poll, empty field", total);
+}
+
+/**
+ * @brief   ISO-DEP activation of a card asking for @p sfgi, after the
+ *          field reset and the ISO 14443-3 activation when @p reset.
+ */
+static void bench_isodep(uint8_t sfgi, bool reset) {
+    static const uint8_t uid[] = {0x04, 0x51, 0x7A, 0x92, 0x3C, 0x5D, 0x80};
+    char what[40];
+    uint64_t total = 0;
+    unsigned i;
+
+    start_chip();
+    piccSimInit(&card, uid, sizeof(uid), 0x20);
+    isoDepSimInit(&app, &card);
+    app.sfgi = sfgi;
+    card.arriveNs = vclockNow();
+    mfrc522SimAddCard(&chip, &card);
+    mfrc522SetField(&rfid, true);
+    platformDelayUs(ISO14443A_POWER_UP_US);
+
+    for (i = 0; i < ROUNDS; i++) {
+        Iso14443aCard found;
+        uint64_t start;
+
+        if (!reset) {
+            mfrc522SetField(&rfid, false);
+            platformDelayUs(ISO14443A_RESET_US);
+            mfrc522SetField(&rfid, true);
+            platformDelayUs(ISO14443A_POWER_UP_US);
+            if (iso14443aActivate(&rfid, &found) != MFRC522_OK) {
+                failed = true;
+            }
+        }
+        jitter();
+        start = vclockNow();
+        if (reset) {
+            mfrc522SetField(&rfid, false);
+            platformDelayUs(ISO14443A_RESET_US);
+            mfrc522SetField(&rfid, true);
+            platformDelayUs(ISO14443A_POWER_UP_US);
+            if (iso14443aActivate(&rfid, &found) != MFRC522_OK) {
+                failed = true;
+            }
+        }
+        if (isoDepActivate(&isodep, &rfid, ISODEP_FSDI,
+                           ISODEP_BITRATE_MAX) != MFRC522_OK) {
+            failed = true;
+        }
+        total += vclockNow() - start;
+    }
+    mfrc522SimRemoveCard(&chip, &card);
+    snprintf(what, sizeof(what), "%sISO-DEP activation, SFGI %u",
+             reset ? "reset + " : "", (unsigned)sfgi);
+    report(what, total);
+}
+
+int main(void) {
+    printf("timer-bench (%s delays, %u us system tick)\n",
+           HAL_USE_GPT ? "microsecond" : "system tick", US_PER_TICK);
+    bench_start();
+    bench_poll(false);
+    bench_poll(true);
+    bench_isodep(0, false);
+    bench_isodep(2, false);
+    bench_isodep(4, false);
+    bench_isodep(0, true);
+    if (failed) {
+        fprintf(stderr, "timer-bench: a transaction failed\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
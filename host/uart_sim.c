@@ -0,0 +1,369 @@
+/**
+ * @file    uart_sim.c
+ * @brief   USART with receive and transmit DMA on the virtual clock.
+ */
+
+#include <string.h>
+
+#include "drivers/link_hw.h"
+#include "sim_thread.h"
+#include "uart_sim.h"
+#include "vclock.h"
+
+/* Interrupt entry and exit and the driver handler calling back. */
+#if !defined(SIM_UART_IRQ_NS)
+#define SIM_UART_IRQ_NS             1000
+#endif
+/* Programming a DMA stream, or stopping it and reading what is left. */
+#if !defined(SIM_UART_DMA_NS)
+#define SIM_UART_DMA_NS             1000
+#endif
+/* Switch to the thread resumed by an interrupt. */
+#if !defined(SIM_UART_WAKEUP_NS)
+#define SIM_UART_WAKEUP_NS          3000
+#endif
+/* Bytes corrupted per million above the cable's maximum rate. */
+#if !defined(SIM_UART_OVER_PPM)
+#define SIM_UART_OVER_PPM           50000
+#endif
+
+static void interrupt(UartSim *sim) {
+    sim->stats.interrupts++;
+    sim->stats.cpuNs += SIM_UART_IRQ_NS;
+}
+
+static void event(void *arg);
+
+/**
+ * @brief   Flips a bit of @p c now and then, more often above the cable's
+ *          maximum rate. Garbles it if the ends run at different rates.
+ */
+static uint8_t line(UartSim *sim, uint8_t c) {
+    uint32_t ppm = sim->errorPpm;
+
+    if (sim->peerCharNs != sim->charNs) {
+        sim->seed = sim->seed * 1103515245 + 12345;
+        sim->corrupted++;
+        return (uint8_t)(sim->seed >> 16);
+    }
+    if (sim->maxBitrate != 0 &&
+        10000000000ULL / sim->charNs > sim->maxBitrate) {
+        ppm += SIM_UART_OVER_PPM;
+    }
+    if (ppm == 0) {
+        return c;
+    }
+    sim->seed = sim->seed * 1103515245 + 12345;
+    if ((sim->seed >> 8) % 1000000 < ppm) {
+        sim->corrupted++;
+        c ^= (uint8_t)(1U << (sim->seed >> 28 & 7));
+    }
+    return c;
+}
+
+/**
+ * @brief   Time between two looks at the receive DMA.
+ */
+static uint64_t poll_ns(UartSim *sim) {
+    return LINK_HW_IDLE_CHARS * sim->charNs;
+}
+
+/**
+ * @brief   Arms the timer on the next event, on the microsecond after it.
+ * @details Bytes going into the DMA buffer need no CPU, they are taken
+ *          together when the buffer fills or at the next look.
+ */
+static void schedule(UartSim *sim) {
+    uint64_t next = sim->txDoneNs;
+    uint64_t now = vclockNow();
+
+    if (sim->qlen > 0) {
+        uint64_t rx = sim->rxNextNs;
+
+        if (sim->rxdma) {
+            size_t n = sim->rxsize - sim->rxn;
+
+            rx += ((n < sim->qlen ? n : sim->qlen) - 1) * sim->peerCharNs;
+        }
+        if (next == 0 || rx < next) {
+            next = rx;
+        }
+    }
+    if (sim->idleNs != 0 && (next == 0 || sim->idleNs < next)) {
+        next = sim->idleNs;
+    }
+    if (next == 0) {
+        platformTimerStopI(&sim->timer);
+        sim->timerNs = 0;
+        return;
+    }
+    if (next < now) {
+        next = now;
+    }
+    next = (next + 999) / 1000 * 1000;
+    if (next == sim->timerNs) {
+        return;
+    }
+    platformTimerStartI(&sim->timer, (uint32_t)(next / 1000 - now / 1000),
+                        event, sim);
+    sim->timerNs = next;
+}
+
+static void receive(UartSim *sim) {
+    uint8_t c = line(sim, sim->queue[sim->qhead]);
+    uint64_t at = sim->rxNextNs;
+
+    sim->qhead = (sim->qhead + 1) % UART_SIM_QUEUE_SIZE;
+    sim->qlen--;
+    sim->rxNextNs += sim->peerCharNs;
+
+    if (sim->rxdma) {
+        sim->rxbuf[sim->rxn++] = c;
+        sim->rxmoved = true;
+        if (sim->rxn == sim->rxsize) {
+            sim->rxbuf = NULL;
+            sim->rxdma = false;
+            sim->idleNs = 0;
+            interrupt(sim);
+            linkRxEndI(sim->link);
+        }
+    } else if (sim->rxbuf != NULL) {
+        /* The first byte of a burst, the DMA takes the rest. */
+        interrupt(sim);
+        sim->rxbuf[sim->rxn++] = c;
+        if (sim->rxn == sim->rxsize) {
+            sim->rxbuf = NULL;
+            linkRxEndI(sim->link);
+        } else {
+            sim->stats.cpuNs += SIM_UART_DMA_NS;
+            sim->rxdma = true;
+            sim->rxmoved = false;
+            sim->idleNs = at + poll_ns(sim);
+        }
+    } else if (sim->rxchar != NULL) {
+        interrupt(sim);
+        sim->rxchar(sim, c, at);
+    } else if (sim->link != NULL) {
+        interrupt(sim);
+        linkRxCharI(sim->link);
+    }
+}
+
+/**
+ * @brief   Runs the events due, in the order they happen on the line.
+ */
+static void event(void *arg) {
+    UartSim *sim = arg;
+    uint64_t now = vclockNow();
+
+    sim->timerNs = 0;
+    while (true) {
+        bool rx = sim->qlen > 0 && sim->rxNextNs <= now;
+        bool idle = sim->idleNs != 0 && sim->idleNs <= now &&
+                    !(rx && sim->rxNextNs <= sim->idleNs);
+        bool tx = sim->txDoneNs != 0 && sim->txDoneNs <= now &&
+                  !(rx && sim->rxNextNs < sim->txDoneNs) &&
+                  !(idle && sim->idleNs < sim->txDoneNs);
+
+        if (tx) {
+            size_t n = sim->txlen;
+            size_t i;
+
+            /* The DMA has read the caller's buffer by now. */
+            if (n > UART_SIM_SENT_SIZE - sim->sentlen) {
+                n = UART_SIM_SENT_SIZE - sim->sentlen;
+            }
+            for (i = 0; i < n; i++) {
+                sim->sent[sim->sentlen++] = line(sim, sim->txbuf[i]);
+            }
+            sim->txDoneNs = 0;
+            interrupt(sim);
+            linkTxEndI(sim->link);
+            if (sim->peerrx != NULL) {
+                sim->peerrx(sim);
+            }
+        } else if (rx && !(idle && sim->idleNs < sim->rxNextNs)) {
+            receive(sim);
+        } else if (idle) {
+            interrupt(sim);
+            if (sim->rxmoved) {
+                sim->rxmoved = false;
+                sim->idleNs += poll_ns(sim);
+            } else {
+                sim->idleNs = 0;
+                linkRxIdleI(sim->link);
+            }
+        } else {
+            break;
+        }
+    }
+    schedule(sim);
+}
+
+static void sim_start_send(void *ctx, const uint8_t *buf, size_t n) {
+    UartSim *sim = ctx;
+
+    sim->stats.cpuNs += SIM_UART_DMA_NS;
+    sim->txbuf = buf;
+    sim->txlen = n;
+    sim->txDoneNs = vclockNow() + n * sim->charNs;
+    schedule(sim);
+    if (sim->txstart != NULL) {
+        sim->txstart(sim, buf, n);
+    }
+}
+
+/*
+ * The DMA starts on the first byte, see receive().
+ */
+static void sim_start_receive(void *ctx, uint8_t *buf, size_t n) {
+    UartSim *sim = ctx;
+
+    sim->rxbuf = buf;
+    sim->rxsize = n;
+    sim->rxn = 0;
+    sim->rxdma = false;
+    schedule(sim);
+}
+
+static size_t sim_stop_receive(void *ctx) {
+    UartSim *sim = ctx;
+    size_t left;
+
+    /* The bytes the DMA has written by now, short of filling the buffer. */
+    while (sim->rxdma && sim->qlen > 0 &&
+           sim->rxNextNs <= vclockNow() && sim->rxn + 1 < sim->rxsize) {
+        receive(sim);
+    }
+    left = sim->rxbuf != NULL ? sim->rxsize - sim->rxn : 0;
+
+    if (sim->rxdma) {
+        sim->stats.cpuNs += SIM_UART_DMA_NS;
+    }
+    sim->rxbuf = NULL;
+    sim->rxdma = false;
+    sim->idleNs = 0;
+    schedule(sim);
+    return left;
+}
+
+/**
+ * @brief   Sleeps until woken, jumping from one line event to the next.
+ * @details In a thread of @p simThreadRun() the clock is left to the
+ *          scheduler.
+ */
+static bool sim_wait(void *ctx, unsigned waiter, uint32_t timeout) {
+    UartSim *sim = ctx;
+    uint64_t deadline = timeout == LINK_WAIT_FOREVER ?
+                        UINT64_MAX : vclockNow() + (uint64_t)timeout * 1000;
+
+    sim->waiting[waiter] = true;
+    if (simThreadActive()) {
+        simThreadWait(&sim->waiting[waiter], deadline);
+    }
+    while (sim->waiting[waiter] && !simThreadActive()) {
+        uint64_t next = sim->timerNs;
+
+        if (next == 0 || next > deadline) {
+            if (deadline == UINT64_MAX) {
+                /* Nothing will ever come. */
+                break;
+            }
+            vclockAdvance(deadline - vclockNow());
+            break;
+        }
+        vclockAdvance(next > vclockNow() ? next - vclockNow() : 0);
+    }
+    if (sim->waiting[waiter]) {
+        sim->waiting[waiter] = false;
+        return false;
+    }
+    sim->stats.wakeups++;
+    sim->stats.cpuNs += SIM_UART_WAKEUP_NS;
+    return true;
+}
+
+static void sim_wakeup(void *ctx, unsigned waiter) {
+    UartSim *sim = ctx;
+
+    sim->waiting[waiter] = false;
+}
+
+static bool sim_set_bitrate(void *ctx, uint32_t bitrate) {
+    UartSim *sim = ctx;
+
+    sim->charNs = 10000000000ULL / bitrate;
+    return true;
+}
+
+const LinkTransport uartSimTransport = {
+    sim_start_send,
+    sim_start_receive,
+    sim_stop_receive,
+    sim_wait,
+    sim_wakeup,
+    sim_set_bitrate
+};
+
+/**
+ * @brief   Sets up an idle 8N1 line at @p bitrate.
+ * @param[in] link  driver receiving the interrupts, @p NULL if the bytes go
+ *                  to @p rxchar only
+ */
+void uartSimInit(UartSim *sim, uint32_t bitrate, LinkDriver *link) {
+    memset(sim, 0, sizeof(*sim));
+    sim->link = link;
+    sim->charNs = 10000000000ULL / bitrate;
+    sim->peerCharNs = sim->charNs;
+}
+
+/**
+ * @brief   Switches the peer's end of the line to @p bitrate.
+ */
+void uartSimPeerBitrate(UartSim *sim, uint32_t bitrate) {
+    sim->peerCharNs = 10000000000ULL / bitrate;
+}
+
+/**
+ * @brief   Queues bytes from the peer, sent right after the ones queued
+ *          before.
+ * @return  Bytes queued, less than @p n if the queue is full.
+ */
+size_t uartSimPeerSend(UartSim *sim, const uint8_t *buf, size_t n) {
+    size_t i;
+
+    if (n > UART_SIM_QUEUE_SIZE - sim->qlen) {
+        n = UART_SIM_QUEUE_SIZE - sim->qlen;
+    }
+    if (n > 0 && sim->qlen == 0) {
+        sim->rxNextNs = vclockNow() + sim->peerCharNs;
+    }
+    for (i = 0; i < n; i++) {
+        sim->queue[(sim->qhead + sim->qlen + i) % UART_SIM_QUEUE_SIZE] = buf[i];
+    }
+    sim->qlen += n;
+    schedule(sim);
+    return n;
+}
+
+/**
+ * @brief   Takes the bytes transmitted by the reader.
+ */
+size_t uartSimPeerReceive(UartSim *sim, uint8_t *buf, size_t size) {
+    size_t n = sim->sentlen < size ? sim->sentlen : size;
+
+    memcpy(buf, sim->sent, n);
+    memmove(sim->sent, &sim->sent[n], sim->sentlen - n);
+    sim->sentlen -= n;
+    return n;
+}
+
+/**
+ * @brief   Advances the clock until the line has nothing more to do.
+ */
+void uartSimRun(UartSim *sim) {
+    while (sim->timerNs != 0) {
+        vclockAdvance(sim->timerNs > vclockNow() ? sim->timerNs - vclockNow()
+                                                 : 0);
+    }
+}
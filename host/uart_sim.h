@@ -0,0 +1,119 @@
+/**
+ * @file    uart_sim.h
+ * @brief   USART with receive and transmit DMA on the virtual clock, the
+ *          host counterpart of @p drivers/link_hw.h.
+ * @details The peer (the controller stand-in of a benchmark) queues bytes
+ *          with @p uartSimPeerSend(), they arrive back to back at ten bit
+ *          times each. As in @p drivers/link_hw.c, the first byte of a burst
+ *          interrupts the CPU and starts the DMA on the rest of the armed
+ *          segment, and a timer looks at the DMA every
+ *          @p LINK_HW_IDLE_CHARS character times, reporting the idle line
+ *          to the link driver once no byte came since the last look.
+ *          Without a segment armed each byte interrupts the CPU. The bytes the reader transmits are
+ *          read from its buffer once the DMA is done and kept for
+ *          @p uartSimPeerReceive(). A byte may be corrupted on the way, in
+ *          either direction, to exercise the error handling above. Each end
+ *          has its own bit rate, bytes sent while they differ arrive
+ *          garbled, and a cable may be too long for the faster rates.
+ *
+ *          Events run from a platform timer, so they happen whenever the
+ *          virtual clock advances. The CPU time of the interrupts and
+ *          wake-ups is only accounted, not charged to the clock.
+ */
+
+#ifndef _UART_SIM_H_
+#define _UART_SIM_H_
+
+#include "link/link.h"
+
+/**
+ * @brief   Bytes the peer can queue.
+ */
+#define UART_SIM_QUEUE_SIZE         4096
+
+/**
+ * @brief   Bytes transmitted by the reader kept for the peer.
+ */
+#define UART_SIM_SENT_SIZE          4096
+
+typedef struct uart_sim UartSim;
+
+/**
+ * @brief   Receives a byte arriving with no DMA buffer armed, in place of
+ *          the link driver.
+ * @param[in] at    end of the stop bit in ns
+ */
+typedef void (*uartsimcharcb_t)(UartSim *sim, uint8_t c, uint64_t at);
+
+/**
+ * @brief   Told that bytes transmitted by the reader reached the peer.
+ */
+typedef void (*uartsimpeercb_t)(UartSim *sim);
+
+/**
+ * @brief   Told that the reader starts transmitting @p n bytes from @p buf,
+ *          the first one is on the line one character time later.
+ */
+typedef void (*uartsimtxcb_t)(UartSim *sim, const uint8_t *buf, size_t n);
+
+/**
+ * @brief   Where the CPU time went.
+ */
+typedef struct {
+    uint32_t interrupts;            /**< UART, DMA and timer interrupts.    */
+    uint32_t wakeups;               /**< Threads resumed by an interrupt.   */
+    uint64_t cpuNs;                 /**< Interrupts, wake-ups, DMA set-ups. */
+} UartSimStats;
+
+struct uart_sim {
+    LinkDriver *link;               /**< Interrupts are reported to it.     */
+    uartsimcharcb_t rxchar;         /**< Optional, see @p uartsimcharcb_t.  */
+    uartsimpeercb_t peerrx;         /**< Optional.                          */
+    uartsimtxcb_t txstart;          /**< Optional.                          */
+    void *peer;                     /**< Free for the peer.                 */
+    uint32_t errorPpm;              /**< Bytes corrupted per million, both
+                                         ways.                              */
+    uint32_t maxBitrate;            /**< Fastest rate the cable carries
+                                         cleanly, 0 for any.                */
+    uint32_t seed;
+    uint32_t corrupted;
+    uint64_t charNs;                /**< Reader's character time.           */
+    uint64_t peerCharNs;            /**< Peer's character time.             */
+    UartSimStats stats;
+    /* Peer to reader. */
+    uint8_t queue[UART_SIM_QUEUE_SIZE];
+    size_t qhead;
+    size_t qlen;
+    uint64_t rxNextNs;              /**< Arrival of the first queued byte.  */
+    uint64_t idleNs;                /**< Next look at the DMA, 0 if none.   */
+    uint8_t *rxbuf;                 /**< Armed segment, @p NULL if none.    */
+    size_t rxsize;
+    size_t rxn;
+    bool rxdma;                     /**< The DMA receives the segment.      */
+    bool rxmoved;                   /**< The DMA wrote since the last look. */
+    /* Reader to peer. */
+    const uint8_t *txbuf;
+    size_t txlen;
+    uint64_t txDoneNs;              /**< End of the transmit DMA, 0 if idle. */
+    uint8_t sent[UART_SIM_SENT_SIZE];
+    size_t sentlen;
+    bool waiting[2];
+    PlatformTimer timer;
+    uint64_t timerNs;               /**< Next event, 0 if none.             */
+};
+
+extern const LinkTransport uartSimTransport;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void uartSimInit(UartSim *sim, uint32_t bitrate, LinkDriver *link);
+  void uartSimPeerBitrate(UartSim *sim, uint32_t bitrate);
+  size_t uartSimPeerSend(UartSim *sim, const uint8_t *buf, size_t n);
+  size_t uartSimPeerReceive(UartSim *sim, uint8_t *buf, size_t size);
+  void uartSimRun(UartSim *sim);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UART_SIM_H_ */
@@ -0,0 +1,25 @@
+/**
+ * @file    vclock.h
+ * @brief   Virtual clock of the host build.
+ * @details Host builds run against simulated peripherals on a virtual time
+ *          line, so every run is deterministic and independent of the speed
+ *          of the build machine. Time only moves when the firmware sleeps or
+ *          when a simulated peripheral accounts for bus or air time.
+ */
+
+#ifndef _VCLOCK_H_
+#define _VCLOCK_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  uint64_t vclockNow(void);
+  void vclockAdvance(uint64_t ns);
+  uint64_t vclockNext(void);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _VCLOCK_H_ */
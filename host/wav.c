@@ -0,0 +1,159 @@
+/**
+ * @file    wav.c
+ * @brief   16 bit PCM WAV files.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "wav.h"
+
+#define HEADER_SIZE                 44
+
+static void put16(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+    put16(p, v);
+    put16(&p[2], v >> 16);
+}
+
+static uint32_t get16(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8;
+}
+
+static uint32_t get32(const uint8_t *p) {
+    return get16(p) | get16(&p[2]) << 16;
+}
+
+static void header(uint8_t *h, uint32_t rate, uint32_t bytes) {
+    memcpy(h, "RIFF", 4);
+    put32(&h[4], 36 + bytes);
+    memcpy(&h[8], "WAVEfmt ", 8);
+    put32(&h[16], 16);
+    put16(&h[20], 1);               /* PCM */
+    put16(&h[22], 1);               /* mono */
+    put32(&h[24], rate);
+    put32(&h[28], rate * 2);
+    put16(&h[32], 2);
+    put16(&h[34], 16);
+    memcpy(&h[36], "data", 4);
+    put32(&h[40], bytes);
+}
+
+/**
+ * @brief   Creates @p path for samples at @p rate, @p NULL if it cannot.
+ * @details The sizes are written by @p wavClose().
+ */
+FILE *wavCreate(const char *path, uint32_t rate) {
+    uint8_t h[HEADER_SIZE];
+    FILE *f = fopen(path, "w+b");
+
+    if (f == NULL) {
+        return NULL;
+    }
+    header(h, rate, 0);
+    if (fwrite(h, sizeof(h), 1, f) != 1) {
+        fclose(f);
+        return NULL;
+    }
+    return f;
+}
+
+/**
+ * @brief   Appends @p n samples, little endian whatever the host.
+ */
+void wavWrite(FILE *f, const int16_t *samples, size_t n) {
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        uint8_t b[2];
+
+        put16(b, (uint16_t)samples[i]);
+        (void)fwrite(b, sizeof(b), 1, f);
+    }
+}
+
+/**
+ * @brief   Writes the sizes into the header and closes the file.
+ *
+ * @return  Whether the whole file was written.
+ */
+bool wavClose(FILE *f) {
+    uint8_t h[HEADER_SIZE];
+    long end = ftell(f);
+    uint32_t rate;
+    bool ok;
+
+    ok = end >= HEADER_SIZE && fseek(f, 0, SEEK_SET) == 0 &&
+         fread(h, sizeof(h), 1, f) == 1;
+    if (ok) {
+        rate = get32(&h[24]);
+        header(h, rate, (uint32_t)(end - HEADER_SIZE));
+        ok = fseek(f, 0, SEEK_SET) == 0 && fwrite(h, sizeof(h), 1, f) == 1;
+    }
+    return fclose(f) == 0 && ok;
+}
+
+/**
+ * @brief   Reads the samples of a 16 bit PCM file, the channels mixed down
+ *          to one.
+ *
+ * @return  The samples, to be freed, or @p NULL if the file cannot be read
+ *          or is not 16 bit PCM.
+ */
+int16_t *wavRead(const char *path, uint32_t *rate, size_t *n) {
+    FILE *f = fopen(path, "rb");
+    uint8_t h[12], chunk[8], fmt[16];
+    uint32_t channels = 0, size, i, c;
+    int16_t *samples = NULL;
+    uint8_t *data;
+
+    if (f == NULL) {
+        return NULL;
+    }
+    if (fread(h, sizeof(h), 1, f) != 1 || memcmp(h, "RIFF", 4) != 0 ||
+        memcmp(&h[8], "WAVE", 4) != 0) {
+        fclose(f);
+        return NULL;
+    }
+    while (fread(chunk, sizeof(chunk), 1, f) == 1) {
+        size = get32(&chunk[4]);
+        if (memcmp(chunk, "fmt ", 4) == 0 && size >= sizeof(fmt)) {
+            if (fread(fmt, sizeof(fmt), 1, f) != 1 ||
+                get16(fmt) != 1 || get16(&fmt[14]) != 16) {
+                break;
+            }
+            channels = get16(&fmt[2]);
+            *rate = get32(&fmt[4]);
+            size -= sizeof(fmt);
+        } else if (memcmp(chunk, "data", 4) == 0 && channels != 0) {
+            data = malloc(size);
+            *n = size / 2 / channels;
+            samples = malloc(*n * sizeof(*samples) + 1);
+            if (data == NULL || samples == NULL ||
+                fread(data, size, 1, f) != 1) {
+                free(samples);
+                samples = NULL;
+            } else {
+                for (i = 0; i < *n; i++) {
+                    int32_t sum = 0;
+
+                    for (c = 0; c < channels; c++) {
+                        sum += (int16_t)get16(&data[(i * channels + c) * 2]);
+                    }
+                    samples[i] = (int16_t)(sum / (int32_t)channels);
+                }
+            }
+            free(data);
+            break;
+        }
+        if (fseek(f, (long)(size + (size & 1)), SEEK_CUR) != 0) {
+            break;
+        }
+    }
+    fclose(f);
+    return samples;
+}
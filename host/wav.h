@@ -0,0 +1,26 @@
+/**
+ * @file    wav.h
+ * @brief   16 bit PCM WAV files, to listen to what the sound output plays
+ *          and to read sounds from.
+ */
+
+#ifndef _WAV_H_
+#define _WAV_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  FILE *wavCreate(const char *path, uint32_t rate);
+  void wavWrite(FILE *f, const int16_t *samples, size_t n);
+  bool wavClose(FILE *f);
+  int16_t *wavRead(const char *path, uint32_t *rate, size_t *n);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _WAV_H_ */
@@ -0,0 +1,213 @@
+/**
+ * @file    adpcm.c
+ * @brief   IMA ADPCM sounds, decoded while they play.
+ */
+
+#include <string.h>
+
+#include "audio/adpcm.h"
+
+/*===========================================================================*/
+/* Module local variables.                                                   */
+/*===========================================================================*/
+
+static const uint16_t steps[ADPCM_INDEX_MAX + 1] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41,
+    45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190,
+    209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724,
+    796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272,
+    2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132,
+    7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500,
+    20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int8_t indexSteps[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+/*===========================================================================*/
+/* Module local functions.                                                   */
+/*===========================================================================*/
+
+/*
+ * The reference decoding of IMA ADPCM, with shifts rather than a multiply
+ * so the rounding is that of every other decoder.
+ */
+static inline int16_t decode(uint32_t code, int32_t *predictor,
+                             int32_t *index) {
+    uint32_t step = steps[*index];
+    int32_t diff = (int32_t)(step >> 3);
+    int32_t p;
+
+    if ((code & 4) != 0) {
+        diff += (int32_t)step;
+    }
+    if ((code & 2) != 0) {
+        diff += (int32_t)(step >> 1);
+    }
+    if ((code & 1) != 0) {
+        diff += (int32_t)(step >> 2);
+    }
+    p = (code & 8) != 0 ? *predictor - diff : *predictor + diff;
+    if (p > INT16_MAX) {
+        p = INT16_MAX;
+    } else if (p < INT16_MIN) {
+        p = INT16_MIN;
+    }
+    *predictor = p;
+
+    *index += indexSteps[code & 7];
+    if (*index < 0) {
+        *index = 0;
+    } else if (*index > (int32_t)ADPCM_INDEX_MAX) {
+        *index = ADPCM_INDEX_MAX;
+    }
+    return (int16_t)p;
+}
+
+/*
+ * The code whose decoding comes closest to sample.
+ */
+static uint32_t encode(int32_t sample, int32_t predictor, int32_t index) {
+    int32_t diff = sample - predictor;
+    int32_t step = steps[index];
+    uint32_t code = 0;
+
+    if (diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+    if (diff >= step) {
+        code |= 4;
+        diff -= step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        code |= 2;
+        diff -= step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        code |= 1;
+    }
+    return code;
+}
+
+/*===========================================================================*/
+/* Exported functions.                                                       */
+/*===========================================================================*/
+
+/**
+ * @brief   Sets @p dp up to play @p sound from its start.
+ */
+void adpcmDecoderInit(AdpcmDecoder *dp, const AdpcmSound *sound) {
+    memset(dp, 0, sizeof(*dp));
+    dp->sound = sound;
+    dp->next = sound->data;
+    dp->left = sound->samples;
+}
+
+/**
+ * @brief   Decodes the next samples of a sound set up by
+ *          @p adpcmDecoderInit(), a source of @p audioPlay().
+ * @details A step index out of range in a block header is taken as the
+ *          highest, a damaged sound plays as noise but reads nothing
+ *          beyond its blocks.
+ */
+size_t adpcmSource(void *arg, int16_t *samples, size_t n) {
+    AdpcmDecoder *dp = arg;
+    const uint8_t *p = dp->next;
+    int32_t predictor = dp->predictor;
+    int32_t index = dp->index;
+    size_t i = 0, run;
+
+    if (n > dp->left) {
+        n = dp->left;
+    }
+    while (i < n) {
+        if (dp->blockLeft == 0) {
+            predictor = (int16_t)(p[0] | p[1] << 8);
+            index = p[2] <= ADPCM_INDEX_MAX ? p[2] : ADPCM_INDEX_MAX;
+            p += ADPCM_HEADER_SIZE;
+            samples[i++] = (int16_t)predictor;
+            dp->blockLeft = (uint16_t)(ADPCM_BLOCK_SAMPLES(
+                                dp->sound->blockSize) - 1U);
+            dp->high = false;
+            continue;
+        }
+        run = n - i < dp->blockLeft ? n - i : dp->blockLeft;
+        dp->blockLeft = (uint16_t)(dp->blockLeft - run);
+        if (dp->high) {
+            samples[i++] = decode(*p++ >> 4, &predictor, &index);
+            dp->high = false;
+            run--;
+        }
+        for (; run >= 2; run -= 2) {
+            uint32_t b = *p++;
+
+            samples[i++] = decode(b & 0x0F, &predictor, &index);
+            samples[i++] = decode(b >> 4, &predictor, &index);
+        }
+        if (run != 0) {
+            samples[i++] = decode(*p & 0x0F, &predictor, &index);
+            dp->high = true;
+        }
+    }
+    dp->next = p;
+    dp->predictor = (int16_t)predictor;
+    dp->index = (uint8_t)index;
+    dp->left -= (uint32_t)n;
+    return n;
+}
+
+/**
+ * @brief   Bytes of a sound of @p samples in blocks of @p blockSize.
+ */
+size_t adpcmSize(size_t samples, size_t blockSize) {
+    size_t perBlock = ADPCM_BLOCK_SAMPLES(blockSize);
+    size_t rest = samples % perBlock;
+
+    return samples / perBlock * blockSize +
+           (rest != 0 ? ADPCM_HEADER_SIZE + rest / 2 : 0);
+}
+
+/**
+ * @brief   Encodes @p n samples of 16 bit PCM into @p out, in blocks of
+ *          @p blockSize bytes, an even number above the header.
+ * @details Each code is the one the decoder gets closest to the sample
+ *          with, tracking the decoder's state. A block starts on its first
+ *          sample with the step index the previous one ended on.
+ *
+ * @return  Bytes written, see @p adpcmSize().
+ */
+size_t adpcmEncode(const int16_t *pcm, size_t n, size_t blockSize,
+                   uint8_t *out) {
+    size_t perBlock = ADPCM_BLOCK_SAMPLES(blockSize);
+    int32_t predictor = 0, index = 0;
+    uint8_t *p = out;
+    size_t i, j;
+
+    for (i = 0; i < n; i += perBlock) {
+        size_t end = n - i < perBlock ? n : i + perBlock;
+
+        predictor = pcm[i];
+        p[0] = (uint8_t)predictor;
+        p[1] = (uint8_t)((uint16_t)predictor >> 8);
+        p[2] = (uint8_t)index;
+        p[3] = 0;
+        p += ADPCM_HEADER_SIZE;
+        for (j = i + 1; j < end; j++) {
+            uint32_t code = encode(pcm[j], predictor, index);
+
+            (void)decode(code, &predictor, &index);
+            if ((j - i) % 2 != 0) {
+                *p = (uint8_t)code;
+            } else {
+                *p++ |= (uint8_t)(code << 4);
+            }
+        }
+        if ((end - i) % 2 == 0) {
+            /* The high nibble of the last byte is not a sample. */
+            p++;
+        }
+    }
+    return (size_t)(p - out);
+}
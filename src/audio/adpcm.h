@@ -0,0 +1,87 @@
+/**
+ * @file    adpcm.h
+ * @brief   IMA ADPCM sounds, decoded while they play.
+ *
+ * @details A sound is stored in flash at 4 bits a sample, a quarter of its
+ *          16 bit PCM, in the block layout of IMA ADPCM WAV files: each
+ *          block of @p blockSize bytes starts with a 4 byte header, the
+ *          first sample as signed 16 bit little endian and the step index,
+ *          then carries two samples a byte, the first in the low nibble.
+ *          A block is @p ADPCM_BLOCK_SAMPLES() samples, the last one may be
+ *          shorter. Each block decodes on its own, so a damaged byte spoils
+ *          at most the rest of its block.
+ *
+ *          @p adpcmSource() decodes a sound straight into the blocks of the
+ *          sound output (@p audio/audio.h) as it plays, with integer
+ *          additions and shifts only. @p adpcmEncode() builds the sounds,
+ *          on the build machine, see @p host/adpcm_encode.c.
+ */
+
+#ifndef _ADPCM_H_
+#define _ADPCM_H_
+
+#include "audio/audio.h"
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Bytes of the header of a block.
+ */
+#define ADPCM_HEADER_SIZE           4U
+
+/**
+ * @brief   Highest step index.
+ */
+#define ADPCM_INDEX_MAX             88U
+
+/**
+ * @brief   Samples of a block of @p size bytes.
+ */
+#define ADPCM_BLOCK_SAMPLES(size)   (((size) - ADPCM_HEADER_SIZE) * 2U + 1U)
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   A sound in flash.
+ */
+typedef struct {
+    const uint8_t *data;
+    uint32_t samples;
+    uint16_t blockSize;             /**< Bytes, even.                       */
+} AdpcmSound;
+
+/**
+ * @brief   Decoder of a sound playing.
+ */
+typedef struct {
+    const AdpcmSound *sound;
+    const uint8_t *next;            /**< Byte of the next samples.          */
+    uint32_t left;                  /**< Samples of the sound.              */
+    uint16_t blockLeft;             /**< Samples of the block.              */
+    int16_t predictor;
+    uint8_t index;
+    bool high;                      /**< The next sample is in the high
+                                         nibble.                            */
+} AdpcmDecoder;
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void adpcmDecoderInit(AdpcmDecoder *dp, const AdpcmSound *sound);
+  size_t adpcmSource(void *arg, int16_t *samples, size_t n);
+  size_t adpcmSize(size_t samples, size_t blockSize);
+  size_t adpcmEncode(const int16_t *pcm, size_t n, size_t blockSize,
+                     uint8_t *out);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ADPCM_H_ */
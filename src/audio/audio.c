@@ -0,0 +1,146 @@
+/**
+ * @file    audio.c
+ * @brief   Sound output through a double buffer converted by DMA.
+ */
+
+#include <string.h>
+
+#include "audio/audio.h"
+
+/*===========================================================================*/
+/* Exported functions.                                                       */
+/*===========================================================================*/
+
+/**
+ * @brief   Initializes a silent engine.
+ */
+void audioInit(AudioEngine *ap) {
+    memset(ap, 0, sizeof(*ap));
+    ap->silentBlocks = 2;
+}
+
+/**
+ * @brief   Plays @p source from the next block on, instead of the sound
+ *          playing.
+ * @details @p NULL stops the sound playing. To be called with the platform
+ *          lock held, or from an interrupt handler which
+ *          @p audioRefill() cannot preempt.
+ */
+void audioPlayI(AudioEngine *ap, audiosourcecb_t source, void *arg) {
+    ap->next = source;
+    ap->nextArg = arg;
+    ap->pending = true;
+}
+
+/**
+ * @brief   Plays @p source from the next block on, from thread context.
+ */
+void audioPlay(AudioEngine *ap, audiosourcecb_t source, void *arg) {
+    platformLock();
+    audioPlayI(ap, source, arg);
+    platformUnlock();
+}
+
+/**
+ * @brief   Renders the next block into @p block, which the DMA is done
+ *          with.
+ * @details Called by the board driver from the DMA interrupt, with the
+ *          interrupts enabled. The source renders its signed samples in
+ *          place, they are then turned into 12 bit DAC codes.
+ *
+ * @return  @p false once both blocks are silent and nothing is to play,
+ *          the conversions may stop.
+ */
+bool audioRefill(AudioEngine *ap, uint16_t *block) {
+    int16_t *samples = (int16_t *)block;
+    uint32_t start = platformCycles();
+    uint32_t cycles;
+    size_t n = 0, i;
+
+    if (ap->pending) {
+        ap->source = ap->next;
+        ap->arg = ap->nextArg;
+        ap->pending = false;
+        if (ap->source != NULL) {
+            ap->stats.sounds++;
+        }
+    }
+    if (ap->source != NULL) {
+        n = ap->source(ap->arg, samples, AUDIO_BLOCK);
+        if (n < AUDIO_BLOCK) {
+            ap->source = NULL;
+        }
+    }
+    for (i = 0; i < n; i++) {
+        block[i] = (uint16_t)((uint16_t)(samples[i] + 32768) >> 4);
+    }
+    for (; i < AUDIO_BLOCK; i++) {
+        block[i] = AUDIO_DAC_ZERO;
+    }
+
+    if (n == 0) {
+        ap->stats.silent++;
+        if (ap->silentBlocks < 2) {
+            ap->silentBlocks++;
+        }
+    } else {
+        ap->silentBlocks = 0;
+    }
+    cycles = platformElapsedCycles(start);
+    ap->stats.blocks++;
+    ap->stats.cycles += cycles;
+    if (cycles > ap->stats.maxCycles) {
+        ap->stats.maxCycles = cycles;
+    }
+    return ap->silentBlocks < 2 || audioPlaying(ap);
+}
+
+/**
+ * @brief   Share of the CPU spent rendering while converting, in per mille
+ *          of a core clocked at @p cpuHz.
+ */
+uint32_t audioLoad(const AudioEngine *ap, uint32_t cpuHz) {
+    uint64_t budget = (uint64_t)ap->stats.blocks * AUDIO_BLOCK * cpuHz /
+                      AUDIO_RATE;
+
+    return budget != 0 ? (uint32_t)(ap->stats.cycles * 1000U / budget) : 0;
+}
+
+/**
+ * @brief   Sets up a square wave beep of @p hz for @p ms at @p level.
+ */
+void audioBeepInit(AudioBeep *bp, uint32_t hz, uint32_t ms, int16_t level) {
+    bp->phase = 0;
+    bp->step = (uint32_t)(((uint64_t)hz << 32) / AUDIO_RATE);
+    bp->length = ms * AUDIO_RATE / 1000U;
+    bp->left = bp->length;
+    bp->level = level;
+}
+
+/**
+ * @brief   Renders a beep set up by @p audioBeepInit(), a source of
+ *          @p audioPlay().
+ * @details It fades in and out over @p AUDIO_BEEP_RAMP samples.
+ */
+size_t audioBeepSource(void *arg, int16_t *samples, size_t n) {
+    AudioBeep *bp = arg;
+    size_t i;
+
+    if (n > bp->left) {
+        n = bp->left;
+    }
+    for (i = 0; i < n; i++) {
+        uint32_t done = bp->length - bp->left;
+        uint32_t ramp = done < bp->left ? done : bp->left;
+        int32_t level = bp->level;
+
+        if (ramp < AUDIO_BEEP_RAMP) {
+            level = level * (int32_t)ramp / (int32_t)AUDIO_BEEP_RAMP;
+        }
+        samples[i] = (int16_t)((bp->phase & 0x80000000U) != 0 ? -level
+                                                               : level);
+        bp->phase += bp->step;
+        bp->left--;
+    }
+    return n;
+}
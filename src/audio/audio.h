@@ -0,0 +1,147 @@
+/**
+ * @file    audio.h
+ * @brief   Sound output through a double buffer converted by DMA.
+ *
+ * @details Like the link, the engine does not touch the hardware itself.
+ *          The board driver (@p drivers/audio_hw.h) has the DAC convert a
+ *          buffer of two blocks of @p AUDIO_BLOCK samples in a circle, a
+ *          sample per timer period, fed by DMA. Each time the DMA is done
+ *          with a block, its interrupt calls @p audioRefill() on it, which
+ *          renders the next block of the sound playing while the DMA
+ *          converts the other one. Rendering runs in the interrupt, so busy
+ *          threads neither delay nor stretch a sound; it has the time of a
+ *          block, @p AUDIO_BLOCK_US, before the DMA comes back.
+ *
+ *          A sound is a source callback rendering signed 16 bit samples,
+ *          for instance the beep of @p audioBeepSource(). @p audioPlay()
+ *          replaces the sound playing at the next block. Once a sound ends
+ *          and both blocks are silent, the driver may stop the conversions
+ *          until the next one.
+ */
+
+#ifndef _AUDIO_H_
+#define _AUDIO_H_
+
+#include "platform.h"
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Samples per second.
+ */
+#if !defined(AUDIO_RATE) || defined(__DOXYGEN__)
+#define AUDIO_RATE                  16000U
+#endif
+
+/**
+ * @brief   Samples per block, half of the DMA buffer.
+ * @details A sound starts within two blocks of @p audioPlay().
+ */
+#if !defined(AUDIO_BLOCK) || defined(__DOXYGEN__)
+#define AUDIO_BLOCK                 128U
+#endif
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Time the DMA takes to convert a block.
+ */
+#define AUDIO_BLOCK_US              (AUDIO_BLOCK * 1000000U / AUDIO_RATE)
+
+/**
+ * @brief   DAC code of a zero sample, 12 bit right aligned.
+ */
+#define AUDIO_DAC_ZERO              2048U
+
+/**
+ * @brief   Samples a beep fades in and out over, against clicks.
+ */
+#define AUDIO_BEEP_RAMP             32U
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Renders up to @p n samples of a sound.
+ * @details Runs in the DMA interrupt: it must not block nor take the
+ *          platform lock.
+ *
+ * @return  Samples rendered, fewer than @p n once the sound ends.
+ */
+typedef size_t (*audiosourcecb_t)(void *arg, int16_t *samples, size_t n);
+
+/**
+ * @brief   Engine counters.
+ */
+typedef struct {
+    uint32_t sounds;                /**< Started.                           */
+    uint32_t blocks;                /**< Rendered.                          */
+    uint32_t silent;                /**< Blocks without a sound.            */
+    uint32_t late;                  /**< Blocks the DMA reached before they
+                                         were rendered, counted by the board
+                                         driver.                            */
+    uint64_t cycles;                /**< Spent rendering, see
+                                         @p platformCycles().               */
+    uint32_t maxCycles;             /**< Longest block.                     */
+} AudioStats;
+
+/**
+ * @brief   A square wave beep, see @p audioBeepSource().
+ */
+typedef struct {
+    uint32_t phase;
+    uint32_t step;                  /**< Phase increment per sample.        */
+    uint32_t left;                  /**< Samples.                           */
+    uint32_t length;
+    int16_t level;
+} AudioBeep;
+
+/**
+ * @brief   Engine structure.
+ */
+typedef struct {
+    AudioStats stats;
+    audiosourcecb_t source;         /**< Playing, @p NULL for silence.      */
+    void *arg;
+    /* Set by audioPlay(), taken by the next block. */
+    audiosourcecb_t next;
+    void *nextArg;
+    volatile bool pending;
+    uint8_t silentBlocks;           /**< In a row, up to 2.                 */
+} AudioEngine;
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void audioInit(AudioEngine *ap);
+  void audioPlayI(AudioEngine *ap, audiosourcecb_t source, void *arg);
+  void audioPlay(AudioEngine *ap, audiosourcecb_t source, void *arg);
+  bool audioRefill(AudioEngine *ap, uint16_t *block);
+  uint32_t audioLoad(const AudioEngine *ap, uint32_t cpuHz);
+  void audioBeepInit(AudioBeep *bp, uint32_t hz, uint32_t ms, int16_t level);
+  size_t audioBeepSource(void *arg, int16_t *samples, size_t n);
+#ifdef __cplusplus
+}
+#endif
+
+/*===========================================================================*/
+/* Inline functions.                                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Whether a sound is playing or about to.
+ */
+static inline bool audioPlaying(const AudioEngine *ap) {
+    return ap->pending || ap->source != NULL;
+}
+
+#endif /* _AUDIO_H_ */
@@ -0,0 +1,355 @@
+/**
+ * @file    synth.c
+ * @brief   Tones and short tunes from a wavetable.
+ */
+
+#include <string.h>
+
+#include "audio/synth.h"
+
+/*===========================================================================*/
+/* Module local definitions.                                                 */
+/*===========================================================================*/
+
+#define STAGE_NONE                  0
+#define STAGE_ATTACK                1
+#define STAGE_DECAY                 2
+#define STAGE_SUSTAIN               3
+#define STAGE_RELEASE               4
+#define STAGE_REST                  5
+
+#define TICK_SAMPLES                (SYNTH_TICK_MS * AUDIO_RATE / 1000U)
+
+/* Full scale of a voice, 8 fraction bits. */
+#define VOICE_MAX                   ((int32_t)(32767 / SYNTH_VOICES) << 8)
+
+/*
+ * sin(2 pi j / SYNTH_TABLE_SIZE): j folded to within a quarter of a period
+ * of 0 or of the half period, then the Taylor series to the 9th power,
+ * within 4e-6 of the full scale. Constant expressions, so the tables below
+ * are built by the compiler.
+ */
+#define QUARTER                     64      /* Of SYNTH_TABLE_SIZE.         */
+#define FOLD(j)                     ((int32_t)(((j) + QUARTER) % (2 * QUARTER)) \
+                                     - (int32_t)QUARTER)
+#define SIGN(j)                     ((((j) + QUARTER) / (2 * QUARTER)) % 2 != 0 \
+                                     ? -1.0 : 1.0)
+#define TAYLOR(z, zz)                                                       \
+    ((z) * (1.0 - (zz) / 6.0 * (1.0 - (zz) / 20.0 * (1.0 - (zz) / 42.0 *    \
+     (1.0 - (zz) / 72.0)))))
+#define RADIANS                     0.02454369260617026     /* 2 pi / 256. */
+#define SIN_FOLDED(r)               TAYLOR((r) * RADIANS,                   \
+                                           (double)((r) * (r)) * RADIANS *  \
+                                               RADIANS)
+
+/* Harmonic k of sample i. */
+#define HARMONIC(i, k)                                                      \
+    (SIGN((i) * (k)) * SIN_FOLDED(FOLD((i) * (k))) / (k))
+
+#define SAMPLE(v)                   ((int16_t)((int32_t)((v) * 32767.0 +    \
+                                                         32768.5) - 32768))
+
+/* Scaled to peak just under the full scale. */
+#define SINE(i)                     SAMPLE(HARMONIC(i, 1))
+#define SQUARE(i)                                                           \
+    SAMPLE(1.07 * (HARMONIC(i, 1) + HARMONIC(i, 3) + HARMONIC(i, 5) +      \
+                   HARMONIC(i, 7)))
+#define SAW(i)                                                              \
+    SAMPLE(0.61 * (HARMONIC(i, 1) + HARMONIC(i, 2) + HARMONIC(i, 3) +      \
+                   HARMONIC(i, 4) + HARMONIC(i, 5) + HARMONIC(i, 6)))
+
+/* The samples of a table, indexed with hex literals. */
+#define T16(w, h)                                                           \
+    w(0x##h##0), w(0x##h##1), w(0x##h##2), w(0x##h##3), w(0x##h##4),        \
+    w(0x##h##5), w(0x##h##6), w(0x##h##7), w(0x##h##8), w(0x##h##9),        \
+    w(0x##h##a), w(0x##h##b), w(0x##h##c), w(0x##h##d), w(0x##h##e),        \
+    w(0x##h##f)
+#define T256(w)                                                             \
+    T16(w, 0), T16(w, 1), T16(w, 2), T16(w, 3), T16(w, 4), T16(w, 5),       \
+    T16(w, 6), T16(w, 7), T16(w, 8), T16(w, 9), T16(w, a), T16(w, b),       \
+    T16(w, c), T16(w, d), T16(w, e), T16(w, f)
+
+/* Phase increment of MIDI note 120 + semitones, C9 at 8372 Hz. */
+#define NOTE_STEP(ratio)                                                    \
+    ((uint32_t)(8372.018089619156 * (ratio) * 4294967296.0 / AUDIO_RATE +  \
+                0.5))
+
+/*===========================================================================*/
+/* Module exported variables.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   A period of each wave.
+ */
+const int16_t synthTables[SYNTH_WAVES][SYNTH_TABLE_SIZE] = {
+    {T256(SINE)},
+    {T256(SQUARE)},
+    {T256(SAW)},
+};
+
+/*===========================================================================*/
+/* Module local variables.                                                   */
+/*===========================================================================*/
+
+/* The top octave, 2^(k/12); lower ones are shifted down. */
+static const uint32_t octave[12] = {
+    NOTE_STEP(1.0),
+    NOTE_STEP(1.0594630943592953),
+    NOTE_STEP(1.122462048309373),
+    NOTE_STEP(1.189207115002721),
+    NOTE_STEP(1.2599210498948732),
+    NOTE_STEP(1.3348398541700344),
+    NOTE_STEP(1.4142135623730951),
+    NOTE_STEP(1.4983070768766815),
+    NOTE_STEP(1.5874010519681994),
+    NOTE_STEP(1.6817928305074290),
+    NOTE_STEP(1.7817974362806785),
+    NOTE_STEP(1.8877486253633868),
+};
+
+/*===========================================================================*/
+/* Module local functions.                                                   */
+/*===========================================================================*/
+
+/*
+ * Ramps the envelope to target over the stage, or jumps to it if the stage
+ * is empty.
+ */
+static void ramp(SynthVoice *vp, uint8_t stage, uint32_t samples,
+                 int32_t target) {
+    vp->stage = stage;
+    vp->left = samples;
+    if (samples == 0) {
+        vp->env = target;
+        vp->envStep = 0;
+    } else {
+        vp->envStep = (target - vp->env) / (int32_t)samples;
+    }
+}
+
+/*
+ * Sets up the next note, false at the end of the track. A track looping
+ * twice without a sample ends too.
+ */
+static bool start_note(SynthVoice *vp, bool *looped) {
+    const SynthInstrument *ip = vp->track->instrument;
+    uint32_t length, attack;
+
+    while (vp->note->note == SYNTH_LOOP) {
+        if (*looped) {
+            return false;
+        }
+        *looped = true;
+        vp->note = vp->track->notes;
+    }
+    if (vp->note->note == SYNTH_END) {
+        return false;
+    }
+    length = vp->note->ticks * TICK_SAMPLES;
+    if (vp->note->note == SYNTH_REST) {
+        vp->env = 0;
+        ramp(vp, STAGE_REST, length, 0);
+        vp->noteLeft = 0;
+        return true;
+    }
+    vp->step = synthNoteStep(vp->note->note);
+    attack = ip->attack < length ? ip->attack : length;
+    ramp(vp, STAGE_ATTACK, attack, vp->peak);
+    vp->noteLeft = length - attack;
+    return true;
+}
+
+/*
+ * Moves on to the next stage with samples, false at the end of the track.
+ */
+static bool next_stage(SynthVoice *vp) {
+    const SynthInstrument *ip = vp->track->instrument;
+    bool looped = false;
+    uint32_t n;
+
+    do {
+        switch (vp->stage) {
+        case STAGE_ATTACK:
+            vp->env = vp->peak;
+            n = ip->decay < vp->noteLeft ? ip->decay : vp->noteLeft;
+            ramp(vp, STAGE_DECAY, n, vp->hold);
+            vp->noteLeft -= n;
+            break;
+        case STAGE_DECAY:
+            vp->env = vp->hold;
+            n = ip->release < vp->noteLeft ? ip->release : vp->noteLeft;
+            ramp(vp, STAGE_SUSTAIN, vp->noteLeft - n, vp->hold);
+            vp->noteLeft = n;
+            break;
+        case STAGE_SUSTAIN:
+            ramp(vp, STAGE_RELEASE, vp->noteLeft, 0);
+            vp->noteLeft = 0;
+            break;
+        default:
+            if (vp->stage != STAGE_NONE) {
+                vp->env = 0;
+                vp->note++;
+            }
+            if (!start_note(vp, &looped)) {
+                return false;
+            }
+            break;
+        }
+    } while (vp->left == 0);
+    return true;
+}
+
+/*
+ * Adds n samples of the voice at its envelope into out.
+ */
+static void render(SynthVoice *vp, int16_t *out, size_t n) {
+    const int16_t *table = vp->table;
+    uint32_t phase = vp->phase;
+    uint32_t step = vp->step;
+    int32_t env = vp->env;
+    int32_t envStep = vp->envStep;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        int32_t s = table[phase >> (32U - SYNTH_TABLE_BITS)];
+
+        env += envStep;
+        out[i] = (int16_t)(out[i] + ((s * (env >> 8)) >> 15));
+        phase += step;
+    }
+    vp->phase = phase;
+    vp->env = env;
+}
+
+/*
+ * Adds up to n samples of the voice into out, fewer once its track ends.
+ */
+static size_t play(SynthVoice *vp, int16_t *out, size_t n) {
+    size_t i = 0, run;
+
+    while (i < n) {
+        if (vp->left == 0 && !next_stage(vp)) {
+            vp->track = NULL;
+            return i;
+        }
+        run = n - i < vp->left ? n - i : vp->left;
+        if (vp->stage != STAGE_REST) {
+            render(vp, &out[i], run);
+        }
+        vp->left -= (uint32_t)run;
+        i += run;
+    }
+    return n;
+}
+
+/*===========================================================================*/
+/* Exported functions.                                                       */
+/*===========================================================================*/
+
+/**
+ * @brief   Sets @p pp up to play @p tune from its start.
+ */
+void synthInit(SynthPlayer *pp, const SynthTune *tune) {
+    size_t i;
+
+    memset(pp, 0, sizeof(*pp));
+    for (i = 0; i < SYNTH_VOICES; i++) {
+        const SynthTrack *tp = &tune->tracks[i];
+        SynthVoice *vp = &pp->voices[i];
+
+        if (tp->notes == NULL) {
+            continue;
+        }
+        vp->track = tp;
+        vp->note = tp->notes;
+        vp->table = synthTables[tp->instrument->wave];
+        vp->peak = VOICE_MAX / 255 * tp->instrument->level;
+        vp->hold = vp->peak / 255 * tp->instrument->sustain;
+    }
+}
+
+/**
+ * @brief   Renders the next samples of a tune set up by @p synthInit(), a
+ *          source of @p audioPlay().
+ */
+size_t synthSource(void *arg, int16_t *samples, size_t n) {
+    SynthPlayer *pp = arg;
+    size_t longest = 0, i;
+
+    memset(samples, 0, n * sizeof(samples[0]));
+    for (i = 0; i < SYNTH_VOICES; i++) {
+        if (pp->voices[i].track != NULL) {
+            size_t played = play(&pp->voices[i], samples, n);
+
+            if (played > longest) {
+                longest = played;
+            }
+        }
+    }
+    return longest;
+}
+
+/**
+ * @brief   Phase increment per sample of MIDI note @p note.
+ */
+uint32_t synthNoteStep(uint8_t note) {
+    uint32_t shift = 10;
+
+    while (note >= 12 && shift > 0) {
+        note -= 12;
+        shift--;
+    }
+    /* Note 120 and above are in the top octave. */
+    while (note >= 12) {
+        note -= 12;
+    }
+    return octave[note] >> shift;
+}
+
+/*===========================================================================*/
+/* Tunes.                                                                    */
+/*===========================================================================*/
+
+static const SynthInstrument chirp = {
+    SYNTH_WAVE_SINE, 255, 200, SYNTH_MS(2), SYNTH_MS(20), SYNTH_MS(10)
+};
+
+static const SynthInstrument buzz = {
+    SYNTH_WAVE_SQUARE, 255, 230, SYNTH_MS(5), SYNTH_MS(50), SYNTH_MS(40)
+};
+
+static const SynthInstrument siren = {
+    SYNTH_WAVE_SAW, 220, 255, SYNTH_MS(5), 0, SYNTH_MS(5)
+};
+
+/* C6 E6 G6 C7, a third below on the second voice. */
+static const SynthNote grantHigh[] = {
+    {84, 4}, {88, 4}, {91, 4}, {96, 10}, {SYNTH_END, 0}
+};
+
+static const SynthNote grantLow[] = {
+    {SYNTH_REST, 4}, {84, 4}, {88, 4}, {91, 10}, {SYNTH_END, 0}
+};
+
+/* A2 and B flat 2 beating against each other. */
+static const SynthNote denyA[] = {{45, 35}, {SYNTH_END, 0}};
+static const SynthNote denyB[] = {{46, 35}, {SYNTH_END, 0}};
+
+/* A5 and E5 alternating, over an octave below. */
+static const SynthNote alarmHigh[] = {{81, 25}, {76, 25}, {SYNTH_LOOP, 0}};
+static const SynthNote alarmLow[] = {{69, 25}, {64, 25}, {SYNTH_LOOP, 0}};
+
+const SynthTune synthGrant = {{
+    {grantHigh, &chirp},
+    {grantLow, &chirp},
+}};
+
+const SynthTune synthDeny = {{
+    {denyA, &buzz},
+    {denyB, &buzz},
+}};
+
+const SynthTune synthAlarm = {{
+    {alarmHigh, &siren},
+    {alarmLow, &siren},
+}};
@@ -0,0 +1,171 @@
+/**
+ * @file    synth.h
+ * @brief   Tones and short tunes from a wavetable.
+ *
+ * @details A tune is up to @p SYNTH_VOICES tracks played together, each a
+ *          list of notes on an instrument. A voice reads a const table of
+ *          one period of its wave at the phase of a 32 bit accumulator,
+ *          scales it by an attack, decay, sustain and release envelope and
+ *          adds it into the block, all in integers. Each voice peaks at
+ *          @p 1/SYNTH_VOICES of the full scale, so the mix cannot overflow.
+ *
+ *          The tables and the note frequencies are constant expressions,
+ *          computed by the compiler. @p synthSource() renders a tune
+ *          straight into the blocks of the sound output
+ *          (@p audio/audio.h), from the state of a @p SynthPlayer alone.
+ */
+
+#ifndef _SYNTH_H_
+#define _SYNTH_H_
+
+#include "audio/audio.h"
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Tracks of a tune.
+ */
+#if !defined(SYNTH_VOICES) || defined(__DOXYGEN__)
+#define SYNTH_VOICES                3U
+#endif
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Samples of a period of the wavetables, a power of 2.
+ */
+#define SYNTH_TABLE_BITS            8U
+#define SYNTH_TABLE_SIZE            (1U << SYNTH_TABLE_BITS)
+
+/**
+ * @name    Waves
+ * @{
+ */
+#define SYNTH_WAVE_SINE             0U
+#define SYNTH_WAVE_SQUARE           1U      /**< Up to the 7th harmonic.    */
+#define SYNTH_WAVE_SAW              2U      /**< Up to the 6th harmonic.    */
+#define SYNTH_WAVES                 3U
+/** @} */
+
+/**
+ * @brief   Length of a note tick.
+ */
+#define SYNTH_TICK_MS               10U
+
+/**
+ * @name    Notes besides the MIDI note numbers
+ * @{
+ */
+#define SYNTH_REST                  0x00U
+#define SYNTH_LOOP                  0xFEU   /**< Back to the first note.    */
+#define SYNTH_END                   0xFFU
+/** @} */
+
+/**
+ * @brief   Samples of @p ms milliseconds, for the instruments.
+ */
+#define SYNTH_MS(ms)                ((uint16_t)((ms) * AUDIO_RATE / 1000U))
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   A note of a track.
+ */
+typedef struct {
+    uint8_t note;                   /**< MIDI note number, 69 for 440 Hz, or
+                                         @p SYNTH_REST, @p SYNTH_LOOP,
+                                         @p SYNTH_END.                      */
+    uint8_t ticks;                  /**< Length in @p SYNTH_TICK_MS.        */
+} SynthNote;
+
+/**
+ * @brief   How a track sounds.
+ * @details A note rises to @p level over @p attack samples, falls to
+ *          @p sustain of it over @p decay and, at its end, to silence over
+ *          @p release, each cut to what the note leaves of its length.
+ */
+typedef struct {
+    uint8_t wave;                   /**< @p SYNTH_WAVE_SINE...              */
+    uint8_t level;                  /**< Of the voice's share, 255 full.    */
+    uint8_t sustain;                /**< Of @p level, 255 full.             */
+    uint16_t attack;                /**< Samples, see @p SYNTH_MS().        */
+    uint16_t decay;
+    uint16_t release;
+} SynthInstrument;
+
+/**
+ * @brief   A track of a tune.
+ */
+typedef struct {
+    const SynthNote *notes;         /**< Up to @p SYNTH_END, @p NULL for
+                                         none.                              */
+    const SynthInstrument *instrument;
+} SynthTrack;
+
+/**
+ * @brief   A tune, its tracks played together.
+ */
+typedef struct {
+    SynthTrack tracks[SYNTH_VOICES];
+} SynthTune;
+
+/**
+ * @brief   Voice playing a track.
+ */
+typedef struct {
+    const SynthTrack *track;
+    const SynthNote *note;          /**< Playing.                           */
+    const int16_t *table;
+    uint32_t phase;
+    uint32_t step;                  /**< Phase increment per sample.        */
+    int32_t peak;                   /**< Amplitudes of the instrument, 8
+                                         fraction bits.                     */
+    int32_t hold;
+    int32_t env;                    /**< Amplitude.                         */
+    int32_t envStep;                /**< Per sample.                        */
+    uint32_t left;                  /**< Samples of the stage.              */
+    uint32_t noteLeft;              /**< Samples of the note after the
+                                         stage.                             */
+    uint8_t stage;
+} SynthVoice;
+
+/**
+ * @brief   Player of a tune.
+ */
+typedef struct {
+    SynthVoice voices[SYNTH_VOICES];
+} SynthPlayer;
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+/**
+ * @name    Tunes of the reader
+ * @{
+ */
+extern const SynthTune synthGrant;          /**< A rising chirp.            */
+extern const SynthTune synthDeny;           /**< A low buzz.                */
+extern const SynthTune synthAlarm;          /**< A two-tone siren, until
+                                                 stopped.                   */
+/** @} */
+
+extern const int16_t synthTables[SYNTH_WAVES][SYNTH_TABLE_SIZE];
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void synthInit(SynthPlayer *pp, const SynthTune *tune);
+  size_t synthSource(void *arg, int16_t *samples, size_t n);
+  uint32_t synthNoteStep(uint8_t note);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SYNTH_H_ */
@@ -0,0 +1,849 @@
+/**
+ * @file    aes.c
+ * @brief   AES-128 block cipher (FIPS-197) and CBC mode.
+ */
+
+#include <string.h>
+
+#include "crypto/aes.h"
+
+/*===========================================================================*/
+/* Local definitions.                                                        */
+/*===========================================================================*/
+
+#define ROTL(x, n)                  ((uint32_t)((x) << (n)) | ((x) >> (32 - (n))))
+
+/*===========================================================================*/
+/* Local functions.                                                          */
+/*===========================================================================*/
+
+static void xor_block(uint8_t *dst, const uint8_t *a, const uint8_t *b) {
+    size_t i;
+
+    for (i = 0; i < AES_BLOCK_SIZE; i++) {
+        dst[i] = (uint8_t)(a[i] ^ b[i]);
+    }
+}
+
+/* Byte by byte, Cortex-M0 does not load unaligned words. */
+static uint32_t load32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+           (uint32_t)p[3] << 24;
+}
+
+static void store32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+#if AES_BITSLICED
+
+/*
+ * Byte i of a block, row i % 4 and column i / 4, is bit 4 * row + column of
+ * each plane: a row is a nibble, ShiftRows rotates the nibbles and the next
+ * row of a column is 4 bits up.
+ */
+
+#define PLANE_MASK                  0xFFFFU
+
+/**
+ * @brief   S-box without its constant: the inversion in GF(2^8) followed by
+ *          the linear part of the affine map (Boyar and Peralta, 2012).
+ * @details @p q[0] is the least significant bit.
+ */
+static void sbox_linear(uint32_t *q) {
+    uint32_t x0, x1, x2, x3, x4, x5, x6, x7;
+    uint32_t y1, y2, y3, y4, y5, y6, y7, y8, y9;
+    uint32_t y10, y11, y12, y13, y14, y15, y16, y17, y18, y19;
+    uint32_t y20, y21;
+    uint32_t z0, z1, z2, z3, z4, z5, z6, z7, z8, z9;
+    uint32_t z10, z11, z12, z13, z14, z15, z16, z17;
+    uint32_t t0, t1, t2, t3, t4, t5, t6, t7, t8, t9;
+    uint32_t t10, t11, t12, t13, t14, t15, t16, t17, t18, t19;
+    uint32_t t20, t21, t22, t23, t24, t25, t26, t27, t28, t29;
+    uint32_t t30, t31, t32, t33, t34, t35, t36, t37, t38, t39;
+    uint32_t t40, t41, t42, t43, t44, t45, t46, t47, t48, t49;
+    uint32_t t50, t51, t52, t53, t54, t55, t56, t57, t58, t59;
+    uint32_t t60, t61, t62, t63, t64, t65, t66, t67;
+
+    x0 = q[7];
+    x1 = q[6];
+    x2 = q[5];
+    x3 = q[4];
+    x4 = q[3];
+    x5 = q[2];
+    x6 = q[1];
+    x7 = q[0];
+
+    /* Top linear transformation. */
+    y14 = x3 ^ x5;
+    y13 = x0 ^ x6;
+    y9 = x0 ^ x3;
+    y8 = x0 ^ x5;
+    t0 = x1 ^ x2;
+    y1 = t0 ^ x7;
+    y4 = y1 ^ x3;
+    y12 = y13 ^ y14;
+    y2 = y1 ^ x0;
+    y5 = y1 ^ x6;
+    y3 = y5 ^ y8;
+    t1 = x4 ^ y12;
+    y15 = t1 ^ x5;
+    y20 = t1 ^ x1;
+    y6 = y15 ^ x7;
+    y10 = y15 ^ t0;
+    y11 = y20 ^ y9;
+    y7 = x7 ^ y11;
+    y17 = y10 ^ y11;
+    y19 = y10 ^ y8;
+    y16 = t0 ^ y11;
+    y21 = y13 ^ y16;
+    y18 = x0 ^ y16;
+
+    /* Inversion in GF(2^8). */
+    t2 = y12 & y15;
+    t3 = y3 & y6;
+    t4 = t3 ^ t2;
+    t5 = y4 & x7;
+    t6 = t5 ^ t2;
+    t7 = y13 & y16;
+    t8 = y5 & y1;
+    t9 = t8 ^ t7;
+    t10 = y2 & y7;
+    t11 = t10 ^ t7;
+    t12 = y9 & y11;
+    t13 = y14 & y17;
+    t14 = t13 ^ t12;
+    t15 = y8 & y10;
+    t16 = t15 ^ t12;
+    t17 = t4 ^ t14;
+    t18 = t6 ^ t16;
+    t19 = t9 ^ t14;
+    t20 = t11 ^ t16;
+    t21 = t17 ^ y20;
+    t22 = t18 ^ y19;
+    t23 = t19 ^ y21;
+    t24 = t20 ^ y18;
+
+    t25 = t21 ^ t22;
+    t26 = t21 & t23;
+    t27 = t24 ^ t26;
+    t28 = t25 & t27;
+    t29 = t28 ^ t22;
+    t30 = t23 ^ t24;
+    t31 = t22 ^ t26;
+    t32 = t31 & t30;
+    t33 = t32 ^ t24;
+    t34 = t23 ^ t33;
+    t35 = t27 ^ t33;
+    t36 = t24 & t35;
+    t37 = t36 ^ t34;
+    t38 = t27 ^ t36;
+    t39 = t29 & t38;
+    t40 = t25 ^ t39;
+
+    t41 = t40 ^ t37;
+    t42 = t29 ^ t33;
+    t43 = t29 ^ t40;
+    t44 = t33 ^ t37;
+    t45 = t42 ^ t41;
+    z0 = t44 & y15;
+    z1 = t37 & y6;
+    z2 = t33 & x7;
+    z3 = t43 & y16;
+    z4 = t40 & y1;
+    z5 = t29 & y7;
+    z6 = t42 & y11;
+    z7 = t45 & y17;
+    z8 = t41 & y10;
+    z9 = t44 & y12;
+    z10 = t37 & y3;
+    z11 = t33 & y4;
+    z12 = t43 & y13;
+    z13 = t40 & y5;
+    z14 = t29 & y2;
+    z15 = t42 & y9;
+    z16 = t45 & y14;
+    z17 = t41 & y8;
+
+    /* Bottom linear transformation, the constant 0x63 left out. */
+    t46 = z15 ^ z16;
+    t47 = z10 ^ z11;
+    t48 = z5 ^ z13;
+    t49 = z9 ^ z10;
+    t50 = z2 ^ z12;
+    t51 = z2 ^ z5;
+    t52 = z7 ^ z8;
+    t53 = z0 ^ z3;
+    t54 = z6 ^ z7;
+    t55 = z16 ^ z17;
+    t56 = z12 ^ t48;
+    t57 = t50 ^ t53;
+    t58 = z4 ^ t46;
+    t59 = z3 ^ t54;
+    t60 = t46 ^ t57;
+    t61 = z14 ^ t57;
+    t62 = t52 ^ t58;
+    t63 = t49 ^ t58;
+    t64 = z4 ^ t59;
+    t65 = t61 ^ t62;
+    t66 = z1 ^ t63;
+    t67 = t64 ^ t65;
+
+    q[7] = t59 ^ t63;
+    q[6] = t64 ^ t53 ^ t66;
+    q[5] = t55 ^ t67;
+    q[4] = t53 ^ t66;
+    q[3] = t51 ^ t66;
+    q[2] = t47 ^ t65;
+    q[1] = t56 ^ t62;
+    q[0] = t48 ^ t60;
+}
+
+static void sub_bytes(uint32_t *q) {
+    sbox_linear(q);
+    /* 0x63. */
+    q[0] ^= PLANE_MASK;
+    q[1] ^= PLANE_MASK;
+    q[5] ^= PLANE_MASK;
+    q[6] ^= PLANE_MASK;
+}
+
+/**
+ * @brief   Linear part of the inverse affine map, bit i of the result is the
+ *          sum of bits i + 2, i + 5 and i + 7.
+ */
+static void inv_affine_linear(uint32_t *q) {
+    uint32_t x[8];
+    size_t i;
+
+    memcpy(x, q, sizeof(x));
+    for (i = 0; i < 8; i++) {
+        q[i] = x[(i + 2) & 7] ^ x[(i + 5) & 7] ^ x[(i + 7) & 7];
+    }
+}
+
+/**
+ * @brief   Inverse S-box through the S-box circuit.
+ * @details The inversion in GF(2^8) is its own inverse, so the inverse
+ *          S-box is the inverse affine map, the inversion, and the inverse
+ *          of the linear part the circuit ends with.
+ */
+static void inv_sub_bytes(uint32_t *q) {
+    inv_affine_linear(q);
+    /* The constant of the inverse affine map, 0x05. */
+    q[0] ^= PLANE_MASK;
+    q[2] ^= PLANE_MASK;
+    sbox_linear(q);
+    inv_affine_linear(q);
+}
+
+static void shift_rows(uint32_t *q) {
+    size_t i;
+
+    for (i = 0; i < 8; i++) {
+        uint32_t x = q[i];
+
+        q[i] = (x & 0x000F) |
+               ((x >> 1) & 0x0070) | ((x << 3) & 0x0080) |
+               ((x >> 2) & 0x0300) | ((x << 2) & 0x0C00) |
+               ((x >> 3) & 0x1000) | ((x << 1) & 0xE000);
+    }
+}
+
+static void inv_shift_rows(uint32_t *q) {
+    size_t i;
+
+    for (i = 0; i < 8; i++) {
+        uint32_t x = q[i];
+
+        q[i] = (x & 0x000F) |
+               ((x << 1) & 0x00E0) | ((x >> 3) & 0x0010) |
+               ((x >> 2) & 0x0300) | ((x << 2) & 0x0C00) |
+               ((x << 3) & 0x8000) | ((x >> 1) & 0x7000);
+    }
+}
+
+/* The next row of the same column, for every byte. */
+static uint32_t next_row(uint32_t x) {
+    return ((x >> 4) | (x << 12)) & PLANE_MASK;
+}
+
+static uint32_t next_rows2(uint32_t x) {
+    return ((x >> 8) | (x << 8)) & PLANE_MASK;
+}
+
+/**
+ * @brief   Multiplication by x of every byte.
+ */
+static void xtime(const uint32_t *a, uint32_t *out) {
+    uint32_t a7 = a[7];
+
+    out[7] = a[6];
+    out[6] = a[5];
+    out[5] = a[4];
+    out[4] = a[3] ^ a7;
+    out[3] = a[2] ^ a7;
+    out[2] = a[1];
+    out[1] = a[0] ^ a7;
+    out[0] = a7;
+}
+
+/**
+ * @brief   Each byte becomes 2 a ^ 3 b ^ c ^ d, where b, c and d are the
+ *          next rows of the column, as (a ^ b) * 2 ^ b ^ (c ^ d).
+ */
+static void mix_columns(uint32_t *q) {
+    uint32_t t[8], t2[8];
+    size_t i;
+
+    for (i = 0; i < 8; i++) {
+        t[i] = q[i] ^ next_row(q[i]);
+    }
+    xtime(t, t2);
+    for (i = 0; i < 8; i++) {
+        q[i] = t2[i] ^ next_row(q[i]) ^ next_rows2(t[i]);
+    }
+}
+
+/**
+ * @brief   Inverse MixColumns as a multiplication by 4 x^2 + 5 followed by
+ *          MixColumns.
+ */
+static void inv_mix_columns(uint32_t *q) {
+    uint32_t t[8], t2[8];
+    size_t i;
+
+    for (i = 0; i < 8; i++) {
+        t[i] = q[i] ^ next_rows2(q[i]);
+    }
+    xtime(t, t2);
+    xtime(t2, t);
+    for (i = 0; i < 8; i++) {
+        q[i] ^= t[i];
+    }
+    mix_columns(q);
+}
+
+static void add_round_key(uint32_t *q, const uint16_t *rk) {
+    size_t i;
+
+    for (i = 0; i < 8; i++) {
+        q[i] ^= rk[i];
+    }
+}
+
+/**
+ * @brief   Bit planes of a block.
+ * @details Bit b of column c is picked from its four rows at bits b, b + 8,
+ *          b + 16 and b + 24 and gathered four bits apart at bit c.
+ */
+static void slice(const uint8_t *in, uint32_t *q) {
+    uint32_t col[4];
+    size_t b, c;
+
+    for (c = 0; c < 4; c++) {
+        col[c] = load32(&in[4 * c]);
+    }
+    for (b = 0; b < 8; b++) {
+        uint32_t plane = 0;
+
+        for (c = 0; c < 4; c++) {
+            uint32_t t = (col[c] >> b) & 0x01010101U;
+
+            t = (t | (t >> 4)) & 0x00110011U;
+            t = (t | (t >> 8)) & 0x00001111U;
+            plane |= t << c;
+        }
+        q[b] = plane;
+    }
+}
+
+static void unslice(const uint32_t *q, uint8_t *out) {
+    uint32_t col[4] = {0, 0, 0, 0};
+    size_t b, c;
+
+    for (b = 0; b < 8; b++) {
+        for (c = 0; c < 4; c++) {
+            uint32_t t = (q[b] >> c) & 0x00001111U;
+
+            t = (t | (t << 8)) & 0x00110011U;
+            t = (t | (t << 4)) & 0x01010101U;
+            col[c] |= t << b;
+        }
+    }
+    for (c = 0; c < 4; c++) {
+        store32(&out[4 * c], col[c]);
+    }
+}
+
+/**
+ * @brief   S-box of the four bytes of @p w, through the circuit.
+ */
+static uint32_t sub_word(uint32_t w) {
+    uint32_t q[8];
+    uint32_t r = 0;
+    size_t i, b;
+
+    for (b = 0; b < 8; b++) {
+        q[b] = 0;
+        for (i = 0; i < 4; i++) {
+            q[b] |= ((w >> (8 * i + b)) & 1) << i;
+        }
+    }
+    sub_bytes(q);
+    for (b = 0; b < 8; b++) {
+        for (i = 0; i < 4; i++) {
+            r |= ((q[b] >> i) & 1) << (8 * i + b);
+        }
+    }
+    return r;
+}
+
+#else /* !AES_BITSLICED */
+
+/*
+ * Te0[x] is the column S(x) contributes from row 0 after MixColumns,
+ * {02, 01, 01, 03} S(x) from the least significant byte; the other rows
+ * contribute it rotated. Td0[x] is the same for InvMixColumns and the
+ * inverse S-box, {0E, 09, 0D, 0B} S^-1(x).
+ */
+
+static const uint8_t sbox[256] = {
+    0x63, 0x7C, 0x77, 0x7B, 0xF2, 0x6B, 0x6F, 0xC5, 0x30, 0x01, 0x67, 0x2B,
+    0xFE, 0xD7, 0xAB, 0x76, 0xCA, 0x82, 0xC9, 0x7D, 0xFA, 0x59, 0x47, 0xF0,
+    0xAD, 0xD4, 0xA2, 0xAF, 0x9C, 0xA4, 0x72, 0xC0, 0xB7, 0xFD, 0x93, 0x26,
+    0x36, 0x3F, 0xF7, 0xCC, 0x34, 0xA5, 0xE5, 0xF1, 0x71, 0xD8, 0x31, 0x15,
+    0x04, 0xC7, 0x23, 0xC3, 0x18, 0x96, 0x05, 0x9A, 0x07, 0x12, 0x80, 0xE2,
+    0xEB, 0x27, 0xB2, 0x75, 0x09, 0x83, 0x2C, 0x1A, 0x1B, 0x6E, 0x5A, 0xA0,
+    0x52, 0x3B, 0xD6, 0xB3, 0x29, 0xE3, 0x2F, 0x84, 0x53, 0xD1, 0x00, 0xED,
+    0x20, 0xFC, 0xB1, 0x5B, 0x6A, 0xCB, 0xBE, 0x39, 0x4A, 0x4C, 0x58, 0xCF,
+    0xD0, 0xEF, 0xAA, 0xFB, 0x43, 0x4D, 0x33, 0x85, 0x45, 0xF9, 0x02, 0x7F,
+    0x50, 0x3C, 0x9F, 0xA8, 0x51, 0xA3, 0x40, 0x8F, 0x92, 0x9D, 0x38, 0xF5,
+    0xBC, 0xB6, 0xDA, 0x21, 0x10, 0xFF, 0xF3, 0xD2, 0xCD, 0x0C, 0x13, 0xEC,
+    0x5F, 0x97, 0x44, 0x17, 0xC4, 0xA7, 0x7E, 0x3D, 0x64, 0x5D, 0x19, 0x73,
+    0x60, 0x81, 0x4F, 0xDC, 0x22, 0x2A, 0x90, 0x88, 0x46, 0xEE, 0xB8, 0x14,
+    0xDE, 0x5E, 0x0B, 0xDB, 0xE0, 0x32, 0x3A, 0x0A, 0x49, 0x06, 0x24, 0x5C,
+    0xC2, 0xD3, 0xAC, 0x62, 0x91, 0x95, 0xE4, 0x79, 0xE7, 0xC8, 0x37, 0x6D,
+    0x8D, 0xD5, 0x4E, 0xA9, 0x6C, 0x56, 0xF4, 0xEA, 0x65, 0x7A, 0xAE, 0x08,
+    0xBA, 0x78, 0x25, 0x2E, 0x1C, 0xA6, 0xB4, 0xC6, 0xE8, 0xDD, 0x74, 0x1F,
+    0x4B, 0xBD, 0x8B, 0x8A, 0x70, 0x3E, 0xB5, 0x66, 0x48, 0x03, 0xF6, 0x0E,
+    0x61, 0x35, 0x57, 0xB9, 0x86, 0xC1, 0x1D, 0x9E, 0xE1, 0xF8, 0x98, 0x11,
+    0x69, 0xD9, 0x8E, 0x94, 0x9B, 0x1E, 0x87, 0xE9, 0xCE, 0x55, 0x28, 0xDF,
+    0x8C, 0xA1, 0x89, 0x0D, 0xBF, 0xE6, 0x42, 0x68, 0x41, 0x99, 0x2D, 0x0F,
+    0xB0, 0x54, 0xBB, 0x16
+};
+
+static const uint8_t inv_sbox[256] = {
+    0x52, 0x09, 0x6A, 0xD5, 0x30, 0x36, 0xA5, 0x38, 0xBF, 0x40, 0xA3, 0x9E,
+    0x81, 0xF3, 0xD7, 0xFB, 0x7C, 0xE3, 0x39, 0x82, 0x9B, 0x2F, 0xFF, 0x87,
+    0x34, 0x8E, 0x43, 0x44, 0xC4, 0xDE, 0xE9, 0xCB, 0x54, 0x7B, 0x94, 0x32,
+    0xA6, 0xC2, 0x23, 0x3D, 0xEE, 0x4C, 0x95, 0x0B, 0x42, 0xFA, 0xC3, 0x4E,
+    0x08, 0x2E, 0xA1, 0x66, 0x28, 0xD9, 0x24, 0xB2, 0x76, 0x5B, 0xA2, 0x49,
+    0x6D, 0x8B, 0xD1, 0x25, 0x72, 0xF8, 0xF6, 0x64, 0x86, 0x68, 0x98, 0x16,
+    0xD4, 0xA4, 0x5C, 0xCC, 0x5D, 0x65, 0xB6, 0x92, 0x6C, 0x70, 0x48, 0x50,
+    0xFD, 0xED, 0xB9, 0xDA, 0x5E, 0x15, 0x46, 0x57, 0xA7, 0x8D, 0x9D, 0x84,
+    0x90, 0xD8, 0xAB, 0x00, 0x8C, 0xBC, 0xD3, 0x0A, 0xF7, 0xE4, 0x58, 0x05,
+    0xB8, 0xB3, 0x45, 0x06, 0xD0, 0x2C, 0x1E, 0x8F, 0xCA, 0x3F, 0x0F, 0x02,
+    0xC1, 0xAF, 0xBD, 0x03, 0x01, 0x13, 0x8A, 0x6B, 0x3A, 0x91, 0x11, 0x41,
+    0x4F, 0x67, 0xDC, 0xEA, 0x97, 0xF2, 0xCF, 0xCE, 0xF0, 0xB4, 0xE6, 0x73,
+    0x96, 0xAC, 0x74, 0x22, 0xE7, 0xAD, 0x35, 0x85, 0xE2, 0xF9, 0x37, 0xE8,
+    0x1C, 0x75, 0xDF, 0x6E, 0x47, 0xF1, 0x1A, 0x71, 0x1D, 0x29, 0xC5, 0x89,
+    0x6F, 0xB7, 0x62, 0x0E, 0xAA, 0x18, 0xBE, 0x1B, 0xFC, 0x56, 0x3E, 0x4B,
+    0xC6, 0xD2, 0x79, 0x20, 0x9A, 0xDB, 0xC0, 0xFE, 0x78, 0xCD, 0x5A, 0xF4,
+    0x1F, 0xDD, 0xA8, 0x33, 0x88, 0x07, 0xC7, 0x31, 0xB1, 0x12, 0x10, 0x59,
+    0x27, 0x80, 0xEC, 0x5F, 0x60, 0x51, 0x7F, 0xA9, 0x19, 0xB5, 0x4A, 0x0D,
+    0x2D, 0xE5, 0x7A, 0x9F, 0x93, 0xC9, 0x9C, 0xEF, 0xA0, 0xE0, 0x3B, 0x4D,
+    0xAE, 0x2A, 0xF5, 0xB0, 0xC8, 0xEB, 0xBB, 0x3C, 0x83, 0x53, 0x99, 0x61,
+    0x17, 0x2B, 0x04, 0x7E, 0xBA, 0x77, 0xD6, 0x26, 0xE1, 0x69, 0x14, 0x63,
+    0x55, 0x21, 0x0C, 0x7D
+};
+
+static const uint32_t te0[256] = {
+    0xA56363C6U, 0x847C7CF8U, 0x997777EEU, 0x8D7B7BF6U,
+    0x0DF2F2FFU, 0xBD6B6BD6U, 0xB16F6FDEU, 0x54C5C591U,
+    0x50303060U, 0x03010102U, 0xA96767CEU, 0x7D2B2B56U,
+    0x19FEFEE7U, 0x62D7D7B5U, 0xE6ABAB4DU, 0x9A7676ECU,
+    0x45CACA8FU, 0x9D82821FU, 0x40C9C989U, 0x877D7DFAU,
+    0x15FAFAEFU, 0xEB5959B2U, 0xC947478EU, 0x0BF0F0FBU,
+    0xECADAD41U, 0x67D4D4B3U, 0xFDA2A25FU, 0xEAAFAF45U,
+    0xBF9C9C23U, 0xF7A4A453U, 0x967272E4U, 0x5BC0C09BU,
+    0xC2B7B775U, 0x1CFDFDE1U, 0xAE93933DU, 0x6A26264CU,
+    0x5A36366CU, 0x413F3F7EU, 0x02F7F7F5U, 0x4FCCCC83U,
+    0x5C343468U, 0xF4A5A551U, 0x34E5E5D1U, 0x08F1F1F9U,
+    0x937171E2U, 0x73D8D8ABU, 0x53313162U, 0x3F15152AU,
+    0x0C040408U, 0x52C7C795U, 0x65232346U, 0x5EC3C39DU,
+    0x28181830U, 0xA1969637U, 0x0F05050AU, 0xB59A9A2FU,
+    0x0907070EU, 0x36121224U, 0x9B80801BU, 0x3DE2E2DFU,
+    0x26EBEBCDU, 0x6927274EU, 0xCDB2B27FU, 0x9F7575EAU,
+    0x1B090912U, 0x9E83831DU, 0x742C2C58U, 0x2E1A1A34U,
+    0x2D1B1B36U, 0xB26E6EDCU, 0xEE5A5AB4U, 0xFBA0A05BU,
+    0xF65252A4U, 0x4D3B3B76U, 0x61D6D6B7U, 0xCEB3B37DU,
+    0x7B292952U, 0x3EE3E3DDU, 0x712F2F5EU, 0x97848413U,
+    0xF55353A6U, 0x68D1D1B9U, 0x00000000U, 0x2CEDEDC1U,
+    0x60202040U, 0x1FFCFCE3U, 0xC8B1B179U, 0xED5B5BB6U,
+    0xBE6A6AD4U, 0x46CBCB8DU, 0xD9BEBE67U, 0x4B393972U,
+    0xDE4A4A94U, 0xD44C4C98U, 0xE85858B0U, 0x4ACFCF85U,
+    0x6BD0D0BBU, 0x2AEFEFC5U, 0xE5AAAA4FU, 0x16FBFBEDU,
+    0xC5434386U, 0xD74D4D9AU, 0x55333366U, 0x94858511U,
+    0xCF45458AU, 0x10F9F9E9U, 0x06020204U, 0x817F7FFEU,
+    0xF05050A0U, 0x443C3C78U, 0xBA9F9F25U, 0xE3A8A84BU,
+    0xF35151A2U, 0xFEA3A35DU, 0xC0404080U, 0x8A8F8F05U,
+    0xAD92923FU, 0xBC9D9D21U, 0x48383870U, 0x04F5F5F1U,
+    0xDFBCBC63U, 0xC1B6B677U, 0x75DADAAFU, 0x63212142U,
+    0x30101020U, 0x1AFFFFE5U, 0x0EF3F3FDU, 0x6DD2D2BFU,
+    0x4CCDCD81U, 0x140C0C18U, 0x35131326U, 0x2FECECC3U,
+    0xE15F5FBEU, 0xA2979735U, 0xCC444488U, 0x3917172EU,
+    0x57C4C493U, 0xF2A7A755U, 0x827E7EFCU, 0x473D3D7AU,
+    0xAC6464C8U, 0xE75D5DBAU, 0x2B191932U, 0x957373E6U,
+    0xA06060C0U, 0x98818119U, 0xD14F4F9EU, 0x7FDCDCA3U,
+    0x66222244U, 0x7E2A2A54U, 0xAB90903BU, 0x8388880BU,
+    0xCA46468CU, 0x29EEEEC7U, 0xD3B8B86BU, 0x3C141428U,
+    0x79DEDEA7U, 0xE25E5EBCU, 0x1D0B0B16U, 0x76DBDBADU,
+    0x3BE0E0DBU, 0x56323264U, 0x4E3A3A74U, 0x1E0A0A14U,
+    0xDB494992U, 0x0A06060CU, 0x6C242448U, 0xE45C5CB8U,
+    0x5DC2C29FU, 0x6ED3D3BDU, 0xEFACAC43U, 0xA66262C4U,
+    0xA8919139U, 0xA4959531U, 0x37E4E4D3U, 0x8B7979F2U,
+    0x32E7E7D5U, 0x43C8C88BU, 0x5937376EU, 0xB76D6DDAU,
+    0x8C8D8D01U, 0x64D5D5B1U, 0xD24E4E9CU, 0xE0A9A949U,
+    0xB46C6CD8U, 0xFA5656ACU, 0x07F4F4F3U, 0x25EAEACFU,
+    0xAF6565CAU, 0x8E7A7AF4U, 0xE9AEAE47U, 0x18080810U,
+    0xD5BABA6FU, 0x887878F0U, 0x6F25254AU, 0x722E2E5CU,
+    0x241C1C38U, 0xF1A6A657U, 0xC7B4B473U, 0x51C6C697U,
+    0x23E8E8CBU, 0x7CDDDDA1U, 0x9C7474E8U, 0x211F1F3EU,
+    0xDD4B4B96U, 0xDCBDBD61U, 0x868B8B0DU, 0x858A8A0FU,
+    0x907070E0U, 0x423E3E7CU, 0xC4B5B571U, 0xAA6666CCU,
+    0xD8484890U, 0x05030306U, 0x01F6F6F7U, 0x120E0E1CU,
+    0xA36161C2U, 0x5F35356AU, 0xF95757AEU, 0xD0B9B969U,
+    0x91868617U, 0x58C1C199U, 0x271D1D3AU, 0xB99E9E27U,
+    0x38E1E1D9U, 0x13F8F8EBU, 0xB398982BU, 0x33111122U,
+    0xBB6969D2U, 0x70D9D9A9U, 0x898E8E07U, 0xA7949433U,
+    0xB69B9B2DU, 0x221E1E3CU, 0x92878715U, 0x20E9E9C9U,
+    0x49CECE87U, 0xFF5555AAU, 0x78282850U, 0x7ADFDFA5U,
+    0x8F8C8C03U, 0xF8A1A159U, 0x80898909U, 0x170D0D1AU,
+    0xDABFBF65U, 0x31E6E6D7U, 0xC6424284U, 0xB86868D0U,
+    0xC3414182U, 0xB0999929U, 0x772D2D5AU, 0x110F0F1EU,
+    0xCBB0B07BU, 0xFC5454A8U, 0xD6BBBB6DU, 0x3A16162CU
+};
+
+static const uint32_t td0[256] = {
+    0x50A7F451U, 0x5365417EU, 0xC3A4171AU, 0x965E273AU,
+    0xCB6BAB3BU, 0xF1459D1FU, 0xAB58FAACU, 0x9303E34BU,
+    0x55FA3020U, 0xF66D76ADU, 0x9176CC88U, 0x254C02F5U,
+    0xFCD7E54FU, 0xD7CB2AC5U, 0x80443526U, 0x8FA362B5U,
+    0x495AB1DEU, 0x671BBA25U, 0x980EEA45U, 0xE1C0FE5DU,
+    0x02752FC3U, 0x12F04C81U, 0xA397468DU, 0xC6F9D36BU,
+    0xE75F8F03U, 0x959C9215U, 0xEB7A6DBFU, 0xDA595295U,
+    0x2D83BED4U, 0xD3217458U, 0x2969E049U, 0x44C8C98EU,
+    0x6A89C275U, 0x78798EF4U, 0x6B3E5899U, 0xDD71B927U,
+    0xB64FE1BEU, 0x17AD88F0U, 0x66AC20C9U, 0xB43ACE7DU,
+    0x184ADF63U, 0x82311AE5U, 0x60335197U, 0x457F5362U,
+    0xE07764B1U, 0x84AE6BBBU, 0x1CA081FEU, 0x942B08F9U,
+    0x58684870U, 0x19FD458FU, 0x876CDE94U, 0xB7F87B52U,
+    0x23D373ABU, 0xE2024B72U, 0x578F1FE3U, 0x2AAB5566U,
+    0x0728EBB2U, 0x03C2B52FU, 0x9A7BC586U, 0xA50837D3U,
+    0xF2872830U, 0xB2A5BF23U, 0xBA6A0302U, 0x5C8216EDU,
+    0x2B1CCF8AU, 0x92B479A7U, 0xF0F207F3U, 0xA1E2694EU,
+    0xCDF4DA65U, 0xD5BE0506U, 0x1F6234D1U, 0x8AFEA6C4U,
+    0x9D532E34U, 0xA055F3A2U, 0x32E18A05U, 0x75EBF6A4U,
+    0x39EC830BU, 0xAAEF6040U, 0x069F715EU, 0x51106EBDU,
+    0xF98A213EU, 0x3D06DD96U, 0xAE053EDDU, 0x46BDE64DU,
+    0xB58D5491U, 0x055DC471U, 0x6FD40604U, 0xFF155060U,
+    0x24FB9819U, 0x97E9BDD6U, 0xCC434089U, 0x779ED967U,
+    0xBD42E8B0U, 0x888B8907U, 0x385B19E7U, 0xDBEEC879U,
+    0x470A7CA1U, 0xE90F427CU, 0xC91E84F8U, 0x00000000U,
+    0x83868009U, 0x48ED2B32U, 0xAC70111EU, 0x4E725A6CU,
+    0xFBFF0EFDU, 0x5638850FU, 0x1ED5AE3DU, 0x27392D36U,
+    0x64D90F0AU, 0x21A65C68U, 0xD1545B9BU, 0x3A2E3624U,
+    0xB1670A0CU, 0x0FE75793U, 0xD296EEB4U, 0x9E919B1BU,
+    0x4FC5C080U, 0xA220DC61U, 0x694B775AU, 0x161A121CU,
+    0x0ABA93E2U, 0xE52AA0C0U, 0x43E0223CU, 0x1D171B12U,
+    0x0B0D090EU, 0xADC78BF2U, 0xB9A8B62DU, 0xC8A91E14U,
+    0x8519F157U, 0x4C0775AFU, 0xBBDD99EEU, 0xFD607FA3U,
+    0x9F2601F7U, 0xBCF5725CU, 0xC53B6644U, 0x347EFB5BU,
+    0x7629438BU, 0xDCC623CBU, 0x68FCEDB6U, 0x63F1E4B8U,
+    0xCADC31D7U, 0x10856342U, 0x40229713U, 0x2011C684U,
+    0x7D244A85U, 0xF83DBBD2U, 0x1132F9AEU, 0x6DA129C7U,
+    0x4B2F9E1DU, 0xF330B2DCU, 0xEC52860DU, 0xD0E3C177U,
+    0x6C16B32BU, 0x99B970A9U, 0xFA489411U, 0x2264E947U,
+    0xC48CFCA8U, 0x1A3FF0A0U, 0xD82C7D56U, 0xEF903322U,
+    0xC74E4987U, 0xC1D138D9U, 0xFEA2CA8CU, 0x360BD498U,
+    0xCF81F5A6U, 0x28DE7AA5U, 0x268EB7DAU, 0xA4BFAD3FU,
+    0xE49D3A2CU, 0x0D927850U, 0x9BCC5F6AU, 0x62467E54U,
+    0xC2138DF6U, 0xE8B8D890U, 0x5EF7392EU, 0xF5AFC382U,
+    0xBE805D9FU, 0x7C93D069U, 0xA92DD56FU, 0xB31225CFU,
+    0x3B99ACC8U, 0xA77D1810U, 0x6E639CE8U, 0x7BBB3BDBU,
+    0x097826CDU, 0xF418596EU, 0x01B79AECU, 0xA89A4F83U,
+    0x656E95E6U, 0x7EE6FFAAU, 0x08CFBC21U, 0xE6E815EFU,
+    0xD99BE7BAU, 0xCE366F4AU, 0xD4099FEAU, 0xD67CB029U,
+    0xAFB2A431U, 0x31233F2AU, 0x3094A5C6U, 0xC066A235U,
+    0x37BC4E74U, 0xA6CA82FCU, 0xB0D090E0U, 0x15D8A733U,
+    0x4A9804F1U, 0xF7DAEC41U, 0x0E50CD7FU, 0x2FF69117U,
+    0x8DD64D76U, 0x4DB0EF43U, 0x544DAACCU, 0xDF0496E4U,
+    0xE3B5D19EU, 0x1B886A4CU, 0xB81F2CC1U, 0x7F516546U,
+    0x04EA5E9DU, 0x5D358C01U, 0x737487FAU, 0x2E410BFBU,
+    0x5A1D67B3U, 0x52D2DB92U, 0x335610E9U, 0x1347D66DU,
+    0x8C61D79AU, 0x7A0CA137U, 0x8E14F859U, 0x893C13EBU,
+    0xEE27A9CEU, 0x35C961B7U, 0xEDE51CE1U, 0x3CB1477AU,
+    0x59DFD29CU, 0x3F73F255U, 0x79CE1418U, 0xBF37C773U,
+    0xEACDF753U, 0x5BAAFD5FU, 0x146F3DDFU, 0x86DB4478U,
+    0x81F3AFCAU, 0x3EC468B9U, 0x2C342438U, 0x5F40A3C2U,
+    0x72C31D16U, 0x0C25E2BCU, 0x8B493C28U, 0x41950DFFU,
+    0x7101A839U, 0xDEB30C08U, 0x9CE4B4D8U, 0x90C15664U,
+    0x6184CB7BU, 0x70B632D5U, 0x745C6C48U, 0x4257B8D0U
+};
+
+static uint32_t sub_word(uint32_t w) {
+    return (uint32_t)sbox[w & 0xFF] |
+           (uint32_t)sbox[(w >> 8) & 0xFF] << 8 |
+           (uint32_t)sbox[(w >> 16) & 0xFF] << 16 |
+           (uint32_t)sbox[w >> 24] << 24;
+}
+
+/**
+ * @brief   InvMixColumns of a column, through @p td0 and the S-box it
+ *          undoes.
+ */
+static uint32_t inv_mix_column(uint32_t w) {
+    return td0[sbox[w & 0xFF]] ^
+           ROTL(td0[sbox[(w >> 8) & 0xFF]], 8) ^
+           ROTL(td0[sbox[(w >> 16) & 0xFF]], 16) ^
+           ROTL(td0[sbox[w >> 24]], 24);
+}
+
+#endif /* !AES_BITSLICED */
+
+/*===========================================================================*/
+/* Exported functions.                                                       */
+/*===========================================================================*/
+
+/**
+ * @brief   Expands @p key, @p AES_KEY_SIZE bytes.
+ */
+void aesInit(AesKey *kp, const uint8_t *key) {
+    uint32_t w[4 * (AES_ROUNDS + 1)];
+    uint32_t rcon = 0x01;
+    size_t i;
+
+    for (i = 0; i < 4; i++) {
+        w[i] = load32(&key[4 * i]);
+    }
+    for (i = 4; i < 4 * (AES_ROUNDS + 1); i++) {
+        uint32_t t = w[i - 1];
+
+        if (i % 4 == 0) {
+            t = sub_word(ROTL(t, 24)) ^ rcon;
+            rcon = (rcon << 1) ^ (0x11B & -(rcon >> 7));
+        }
+        w[i] = w[i - 4] ^ t;
+    }
+
+#if AES_BITSLICED
+    for (i = 0; i <= AES_ROUNDS; i++) {
+        uint8_t bytes[AES_BLOCK_SIZE];
+        uint32_t q[8];
+        size_t b;
+
+        for (b = 0; b < 4; b++) {
+            store32(&bytes[4 * b], w[4 * i + b]);
+        }
+        slice(bytes, q);
+        for (b = 0; b < 8; b++) {
+            kp->rk[i][b] = (uint16_t)q[b];
+        }
+    }
+#else
+    memcpy(kp->ek, w, sizeof(kp->ek));
+    for (i = 0; i <= AES_ROUNDS; i++) {
+        size_t j;
+
+        for (j = 0; j < 4; j++) {
+            uint32_t k = w[4 * (AES_ROUNDS - i) + j];
+
+            kp->dk[4 * i + j] = i == 0 || i == AES_ROUNDS ? k
+                                                          : inv_mix_column(k);
+        }
+    }
+#endif
+    memset(w, 0, sizeof(w));
+}
+
+/**
+ * @brief   Encrypts one block. @p out may be @p in.
+ */
+void aesEncrypt(const AesKey *kp, const uint8_t *in, uint8_t *out) {
+#if AES_BITSLICED
+    uint32_t q[8];
+    size_t r;
+
+    slice(in, q);
+    add_round_key(q, kp->rk[0]);
+    for (r = 1; r < AES_ROUNDS; r++) {
+        sub_bytes(q);
+        shift_rows(q);
+        mix_columns(q);
+        add_round_key(q, kp->rk[r]);
+    }
+    sub_bytes(q);
+    shift_rows(q);
+    add_round_key(q, kp->rk[AES_ROUNDS]);
+    unslice(q, out);
+#else
+    const uint32_t *rk = kp->ek;
+    uint32_t s0, s1, s2, s3, t0, t1, t2, t3;
+    size_t r;
+
+    s0 = load32(&in[0]) ^ rk[0];
+    s1 = load32(&in[4]) ^ rk[1];
+    s2 = load32(&in[8]) ^ rk[2];
+    s3 = load32(&in[12]) ^ rk[3];
+    for (r = 1; r < AES_ROUNDS; r++) {
+        rk += 4;
+        t0 = te0[s0 & 0xFF] ^ ROTL(te0[(s1 >> 8) & 0xFF], 8) ^
+             ROTL(te0[(s2 >> 16) & 0xFF], 16) ^ ROTL(te0[s3 >> 24], 24) ^
+             rk[0];
+        t1 = te0[s1 & 0xFF] ^ ROTL(te0[(s2 >> 8) & 0xFF], 8) ^
+             ROTL(te0[(s3 >> 16) & 0xFF], 16) ^ ROTL(te0[s0 >> 24], 24) ^
+             rk[1];
+        t2 = te0[s2 & 0xFF] ^ ROTL(te0[(s3 >> 8) & 0xFF], 8) ^
+             ROTL(te0[(s0 >> 16) & 0xFF], 16) ^ ROTL(te0[s1 >> 24], 24) ^
+             rk[2];
+        t3 = te0[s3 & 0xFF] ^ ROTL(te0[(s0 >> 8) & 0xFF], 8) ^
+             ROTL(te0[(s1 >> 16) & 0xFF], 16) ^ ROTL(te0[s2 >> 24], 24) ^
+             rk[3];
+        s0 = t0;
+        s1 = t1;
+        s2 = t2;
+        s3 = t3;
+    }
+    rk += 4;
+    t0 = ((uint32_t)sbox[s0 & 0xFF] | (uint32_t)sbox[(s1 >> 8) & 0xFF] << 8 |
+          (uint32_t)sbox[(s2 >> 16) & 0xFF] << 16 |
+          (uint32_t)sbox[s3 >> 24] << 24) ^ rk[0];
+    t1 = ((uint32_t)sbox[s1 & 0xFF] | (uint32_t)sbox[(s2 >> 8) & 0xFF] << 8 |
+          (uint32_t)sbox[(s3 >> 16) & 0xFF] << 16 |
+          (uint32_t)sbox[s0 >> 24] << 24) ^ rk[1];
+    t2 = ((uint32_t)sbox[s2 & 0xFF] | (uint32_t)sbox[(s3 >> 8) & 0xFF] << 8 |
+          (uint32_t)sbox[(s0 >> 16) & 0xFF] << 16 |
+          (uint32_t)sbox[s1 >> 24] << 24) ^ rk[2];
+    t3 = ((uint32_t)sbox[s3 & 0xFF] | (uint32_t)sbox[(s0 >> 8) & 0xFF] << 8 |
+          (uint32_t)sbox[(s1 >> 16) & 0xFF] << 16 |
+          (uint32_t)sbox[s2 >> 24] << 24) ^ rk[3];
+    store32(&out[0], t0);
+    store32(&out[4], t1);
+    store32(&out[8], t2);
+    store32(&out[12], t3);
+#endif
+}
+
+/**
+ * @brief   Decrypts one block. @p out may be @p in.
+ */
+void aesDecrypt(const AesKey *kp, const uint8_t *in, uint8_t *out) {
+#if AES_BITSLICED
+    uint32_t q[8];
+    size_t r;
+
+    slice(in, q);
+    add_round_key(q, kp->rk[AES_ROUNDS]);
+    for (r = AES_ROUNDS - 1; r > 0; r--) {
+        inv_shift_rows(q);
+        inv_sub_bytes(q);
+        add_round_key(q, kp->rk[r]);
+        inv_mix_columns(q);
+    }
+    inv_shift_rows(q);
+    inv_sub_bytes(q);
+    add_round_key(q, kp->rk[0]);
+    unslice(q, out);
+#else
+    const uint32_t *rk = kp->dk;
+    uint32_t s0, s1, s2, s3, t0, t1, t2, t3;
+    size_t r;
+
+    s0 = load32(&in[0]) ^ rk[0];
+    s1 = load32(&in[4]) ^ rk[1];
+    s2 = load32(&in[8]) ^ rk[2];
+    s3 = load32(&in[12]) ^ rk[3];
+    for (r = 1; r < AES_ROUNDS; r++) {
+        rk += 4;
+        t0 = td0[s0 & 0xFF] ^ ROTL(td0[(s3 >> 8) & 0xFF], 8) ^
+             ROTL(td0[(s2 >> 16) & 0xFF], 16) ^ ROTL(td0[s1 >> 24], 24) ^
+             rk[0];
+        t1 = td0[s1 & 0xFF] ^ ROTL(td0[(s0 >> 8) & 0xFF], 8) ^
+             ROTL(td0[(s3 >> 16) & 0xFF], 16) ^ ROTL(td0[s2 >> 24], 24) ^
+             rk[1];
+        t2 = td0[s2 & 0xFF] ^ ROTL(td0[(s1 >> 8) & 0xFF], 8) ^
+             ROTL(td0[(s0 >> 16) & 0xFF], 16) ^ ROTL(td0[s3 >> 24], 24) ^
+             rk[2];
+        t3 = td0[s3 & 0xFF] ^ ROTL(td0[(s2 >> 8) & 0xFF], 8) ^
+             ROTL(td0[(s1 >> 16) & 0xFF], 16) ^ ROTL(td0[s0 >> 24], 24) ^
+             rk[3];
+        s0 = t0;
+        s1 = t1;
+        s2 = t2;
+        s3 = t3;
+    }
+    rk += 4;
+    t0 = ((uint32_t)inv_sbox[s0 & 0xFF] |
+          (uint32_t)inv_sbox[(s3 >> 8) & 0xFF] << 8 |
+          (uint32_t)inv_sbox[(s2 >> 16) & 0xFF] << 16 |
+          (uint32_t)inv_sbox[s1 >> 24] << 24) ^ rk[0];
+    t1 = ((uint32_t)inv_sbox[s1 & 0xFF] |
+          (uint32_t)inv_sbox[(s0 >> 8) & 0xFF] << 8 |
+          (uint32_t)inv_sbox[(s3 >> 16) & 0xFF] << 16 |
+          (uint32_t)inv_sbox[s2 >> 24] << 24) ^ rk[1];
+    t2 = ((uint32_t)inv_sbox[s2 & 0xFF] |
+          (uint32_t)inv_sbox[(s1 >> 8) & 0xFF] << 8 |
+          (uint32_t)inv_sbox[(s0 >> 16) & 0xFF] << 16 |
+          (uint32_t)inv_sbox[s3 >> 24] << 24) ^ rk[2];
+    t3 = ((uint32_t)inv_sbox[s3 & 0xFF] |
+          (uint32_t)inv_sbox[(s2 >> 8) & 0xFF] << 8 |
+          (uint32_t)inv_sbox[(s1 >> 16) & 0xFF] << 16 |
+          (uint32_t)inv_sbox[s0 >> 24] << 24) ^ rk[3];
+    store32(&out[0], t0);
+    store32(&out[4], t1);
+    store32(&out[8], t2);
+    store32(&out[12], t3);
+#endif
+}
+
+/**
+ * @brief   Encrypts @p len bytes, a multiple of @p AES_BLOCK_SIZE, in CBC
+ *          mode.
+ *
+ * @param[in,out] iv    Left as the last ciphertext block, to chain on.
+ * @param[out] out      May be @p in.
+ */
+void aesCbcEncrypt(const AesKey *kp, uint8_t *iv, const uint8_t *in,
+                   uint8_t *out, size_t len) {
+    size_t off;
+
+    for (off = 0; off + AES_BLOCK_SIZE <= len; off += AES_BLOCK_SIZE) {
+        xor_block(iv, iv, &in[off]);
+        aesEncrypt(kp, iv, iv);
+        memcpy(&out[off], iv, AES_BLOCK_SIZE);
+    }
+}
+
+/**
+ * @brief   Decrypts @p len bytes, a multiple of @p AES_BLOCK_SIZE, in CBC
+ *          mode.
+ *
+ * @param[in,out] iv    Left as the last ciphertext block, to chain on.
+ * @param[out] out      May be @p in.
+ */
+void aesCbcDecrypt(const AesKey *kp, uint8_t *iv, const uint8_t *in,
+                   uint8_t *out, size_t len) {
+    uint8_t block[AES_BLOCK_SIZE];
+    size_t off;
+
+    for (off = 0; off + AES_BLOCK_SIZE <= len; off += AES_BLOCK_SIZE) {
+        memcpy(block, &in[off], AES_BLOCK_SIZE);
+        aesDecrypt(kp, block, &out[off]);
+        xor_block(&out[off], &out[off], iv);
+        memcpy(iv, block, AES_BLOCK_SIZE);
+    }
+}
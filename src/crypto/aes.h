@@ -0,0 +1,66 @@
+/**
+ * @file    aes.h
+ * @brief   AES-128 block cipher (FIPS-197) and CBC mode.
+ *
+ * @details Two implementations, chosen with @p AES_BITSLICED:
+ *
+ *          - Bitsliced: the state is kept as eight 16 bit planes, plane b
+ *            holding bit b of all 16 bytes, and the S-box is computed as a
+ *            Boolean circuit of 113 gates (Boyar and Peralta) over the
+ *            planes. No tables, no secret dependent branches or memory
+ *            accesses, on any CPU. The inverse S-box reuses the circuit
+ *            between two linear layers.
+ *          - T-table: a single 1 kB table per direction, rotated for the
+ *            other rows, and the 256 byte S-boxes for the last round.
+ *            Faster, but the table index is secret: constant time only on
+ *            cores without a data cache, like the Cortex-M0 running from
+ *            flash or SRAM.
+ *
+ *          Both expand the key once in @p aesInit(), for encryption and
+ *          decryption.
+ */
+
+#ifndef _CRYPTO_AES_H_
+#define _CRYPTO_AES_H_
+
+#include "platform.h"
+
+/**
+ * @brief   Bitsliced AES instead of the T-table one.
+ */
+#if !defined(AES_BITSLICED) || defined(__DOXYGEN__)
+#define AES_BITSLICED               TRUE
+#endif
+
+#define AES_KEY_SIZE                16
+#define AES_BLOCK_SIZE              16
+#define AES_ROUNDS                  10
+
+/**
+ * @brief   Expanded key.
+ */
+typedef struct {
+#if AES_BITSLICED || defined(__DOXYGEN__)
+    uint16_t rk[AES_ROUNDS + 1][8]; /**< Round keys as bit planes.          */
+#else
+    uint32_t ek[4 * (AES_ROUNDS + 1)]; /**< Encryption round keys.          */
+    uint32_t dk[4 * (AES_ROUNDS + 1)]; /**< Decryption round keys of the
+                                            equivalent inverse cipher.      */
+#endif
+} AesKey;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void aesInit(AesKey *kp, const uint8_t *key);
+  void aesEncrypt(const AesKey *kp, const uint8_t *in, uint8_t *out);
+  void aesDecrypt(const AesKey *kp, const uint8_t *in, uint8_t *out);
+  void aesCbcEncrypt(const AesKey *kp, uint8_t *iv, const uint8_t *in,
+                     uint8_t *out, size_t len);
+  void aesCbcDecrypt(const AesKey *kp, uint8_t *iv, const uint8_t *in,
+                     uint8_t *out, size_t len);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CRYPTO_AES_H_ */
@@ -0,0 +1,189 @@
+/**
+ * @file    chacha20.c
+ * @brief   ChaCha20 stream cipher (RFC 8439) and HChaCha20.
+ */
+
+#include "crypto/chacha20.h"
+
+/*===========================================================================*/
+/* Local definitions.                                                        */
+/*===========================================================================*/
+
+/* "expand 32-byte k" */
+#define SIGMA0                      0x61707865U
+#define SIGMA1                      0x3320646EU
+#define SIGMA2                      0x79622D32U
+#define SIGMA3                      0x6B206574U
+
+/* A single RORS on Thumb-1. */
+#define ROTL(x, n)                  ((uint32_t)((x) << (n)) | ((x) >> (32 - (n))))
+
+#define QUARTER(a, b, c, d)                                                 \
+    do {                                                                    \
+        a += b; d ^= a; d = ROTL(d, 16);                                    \
+        c += d; b ^= c; b = ROTL(b, 12);                                    \
+        a += b; d ^= a; d = ROTL(d, 8);                                     \
+        c += d; b ^= c; b = ROTL(b, 7);                                     \
+    } while (0)
+
+#define DOUBLE_ROUND()                                                      \
+    do {                                                                    \
+        QUARTER(x0, x4, x8, x12);                                           \
+        QUARTER(x1, x5, x9, x13);                                           \
+        QUARTER(x2, x6, x10, x14);                                          \
+        QUARTER(x3, x7, x11, x15);                                          \
+        QUARTER(x0, x5, x10, x15);                                          \
+        QUARTER(x1, x6, x11, x12);                                          \
+        QUARTER(x2, x7, x8, x13);                                           \
+        QUARTER(x3, x4, x9, x14);                                           \
+    } while (0)
+
+/*===========================================================================*/
+/* Local functions.                                                          */
+/*===========================================================================*/
+
+/* Byte by byte, Cortex-M0 does not load unaligned words. */
+static uint32_t load32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+           (uint32_t)p[3] << 24;
+}
+
+static void store32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+/**
+ * @brief   Sets up the state of @p key, @p counter and @p nonce.
+ */
+static void setup(uint32_t *s, const uint8_t *key, uint32_t counter,
+                  const uint8_t *nonce) {
+    size_t i;
+
+    s[0] = SIGMA0;
+    s[1] = SIGMA1;
+    s[2] = SIGMA2;
+    s[3] = SIGMA3;
+    for (i = 0; i < 8; i++) {
+        s[4 + i] = load32(&key[4 * i]);
+    }
+    s[12] = counter;
+    for (i = 0; i < 3; i++) {
+        s[13 + i] = load32(&nonce[4 * i]);
+    }
+}
+
+/**
+ * @brief   Runs the 20 rounds over @p s, in place.
+ * @details The words live in locals for the compiler to keep as many as it
+ *          can in registers.
+ */
+static void rounds(uint32_t *s) {
+    uint32_t x0 = s[0], x1 = s[1], x2 = s[2], x3 = s[3];
+    uint32_t x4 = s[4], x5 = s[5], x6 = s[6], x7 = s[7];
+    uint32_t x8 = s[8], x9 = s[9], x10 = s[10], x11 = s[11];
+    uint32_t x12 = s[12], x13 = s[13], x14 = s[14], x15 = s[15];
+    size_t i;
+
+    for (i = 0; i < 10; i++) {
+        DOUBLE_ROUND();
+    }
+    s[0] = x0; s[1] = x1; s[2] = x2; s[3] = x3;
+    s[4] = x4; s[5] = x5; s[6] = x6; s[7] = x7;
+    s[8] = x8; s[9] = x9; s[10] = x10; s[11] = x11;
+    s[12] = x12; s[13] = x13; s[14] = x14; s[15] = x15;
+}
+
+/**
+ * @brief   Key stream block as words, in the byte order of the cipher.
+ */
+static void block(const uint8_t *key, const uint8_t *nonce, uint32_t counter,
+                  uint32_t *out) {
+    uint32_t s[16];
+    size_t i;
+
+    setup(s, key, counter, nonce);
+    for (i = 0; i < 16; i++) {
+        out[i] = s[i];
+    }
+    rounds(out);
+    for (i = 0; i < 16; i++) {
+        out[i] += s[i];
+    }
+}
+
+/*===========================================================================*/
+/* Exported functions.                                                       */
+/*===========================================================================*/
+
+/**
+ * @brief   Computes key stream block @p counter of @p key and @p nonce.
+ *
+ * @param[in] key       @p CHACHA20_KEY_SIZE bytes.
+ * @param[in] nonce     @p CHACHA20_NONCE_SIZE bytes.
+ * @param[out] out      @p CHACHA20_BLOCK_SIZE bytes.
+ */
+void chacha20Block(const uint8_t *key, const uint8_t *nonce, uint32_t counter,
+                   uint8_t *out) {
+    uint32_t ks[16];
+    size_t i;
+
+    block(key, nonce, counter, ks);
+    for (i = 0; i < 16; i++) {
+        store32(&out[4 * i], ks[i]);
+    }
+}
+
+/**
+ * @brief   Encrypts or decrypts @p len bytes, starting with key stream
+ *          block @p counter.
+ * @details @p in and @p out may be the same buffer. Word aligned buffers
+ *          are XORed a word at a time on little endian machines.
+ */
+void chacha20Xor(const uint8_t *key, const uint8_t *nonce, uint32_t counter,
+                 const uint8_t *in, uint8_t *out, size_t len) {
+    uint32_t ks[16];
+
+    while (len > 0) {
+        size_t n = len < CHACHA20_BLOCK_SIZE ? len : CHACHA20_BLOCK_SIZE;
+        size_t i = 0;
+
+        block(key, nonce, counter++, ks);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        if ((((uintptr_t)in | (uintptr_t)out) & 3) == 0) {
+            for (; i + 4 <= n; i += 4) {
+                *(uint32_t *)(void *)&out[i] =
+                    *(const uint32_t *)(const void *)&in[i] ^ ks[i / 4];
+            }
+        }
+#endif
+        for (; i < n; i++) {
+            out[i] = in[i] ^ (uint8_t)(ks[i / 4] >> (8 * (i % 4)));
+        }
+        in += n;
+        out += n;
+        len -= n;
+    }
+}
+
+/**
+ * @brief   HChaCha20: derives a key from @p key and a 16 byte @p input.
+ * @details The rounds of a block over the input in place of the counter and
+ *          nonce, without the final addition, keep the first and last row.
+ *
+ * @param[in] input     @p CHACHA20_DERIVE_INPUT_SIZE bytes.
+ * @param[out] out      @p CHACHA20_KEY_SIZE bytes.
+ */
+void chacha20Derive(const uint8_t *key, const uint8_t *input, uint8_t *out) {
+    uint32_t s[16];
+    size_t i;
+
+    setup(s, key, load32(input), &input[4]);
+    rounds(s);
+    for (i = 0; i < 4; i++) {
+        store32(&out[4 * i], s[i]);
+        store32(&out[16 + 4 * i], s[12 + i]);
+    }
+}
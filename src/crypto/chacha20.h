@@ -0,0 +1,37 @@
+/**
+ * @file    chacha20.h
+ * @brief   ChaCha20 stream cipher (RFC 8439) and HChaCha20.
+ *
+ * @details Only 32 bit additions, XORs and rotations: no tables, no
+ *          secret dependent branches or memory accesses. The 16 state
+ *          words do not fit the eight low registers of Thumb-1, the
+ *          compiler spills a few of them for each quarter round.
+ */
+
+#ifndef _CRYPTO_CHACHA20_H_
+#define _CRYPTO_CHACHA20_H_
+
+#include "platform.h"
+
+#define CHACHA20_KEY_SIZE           32
+#define CHACHA20_NONCE_SIZE         12
+#define CHACHA20_BLOCK_SIZE         64
+
+/**
+ * @brief   Input and output of @p chacha20Derive().
+ */
+#define CHACHA20_DERIVE_INPUT_SIZE  16
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void chacha20Block(const uint8_t *key, const uint8_t *nonce,
+                     uint32_t counter, uint8_t *out);
+  void chacha20Xor(const uint8_t *key, const uint8_t *nonce, uint32_t counter,
+                   const uint8_t *in, uint8_t *out, size_t len);
+  void chacha20Derive(const uint8_t *key, const uint8_t *input, uint8_t *out);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CRYPTO_CHACHA20_H_ */
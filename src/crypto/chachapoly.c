@@ -0,0 +1,84 @@
+/**
+ * @file    chachapoly.c
+ * @brief   ChaCha20-Poly1305 authenticated encryption (RFC 8439).
+ */
+
+#include "crypto/chachapoly.h"
+
+static void put64(uint8_t *p, uint64_t v) {
+    size_t i;
+
+    for (i = 0; i < 8; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+/**
+ * @brief   Tag of @p aad and the ciphertext @p ct.
+ * @details The one-time Poly1305 key is the start of key stream block 0.
+ */
+static void mac(const uint8_t *key, const uint8_t *nonce, const uint8_t *aad,
+                size_t aadlen, const uint8_t *ct, size_t len, uint8_t *tag) {
+    uint8_t otk[CHACHA20_BLOCK_SIZE];
+    uint8_t lengths[16];
+    Poly1305 poly;
+
+    chacha20Block(key, nonce, 0, otk);
+    poly1305Init(&poly, otk);
+    poly1305Update(&poly, aad, aadlen);
+    poly1305Align(&poly);
+    poly1305Update(&poly, ct, len);
+    poly1305Align(&poly);
+    put64(&lengths[0], aadlen);
+    put64(&lengths[8], len);
+    poly1305Update(&poly, lengths, sizeof(lengths));
+    poly1305Finish(&poly, tag);
+}
+
+/**
+ * @brief   Encrypts @p len bytes and authenticates them with @p aad.
+ *
+ * @param[in] key       @p CHACHAPOLY_KEY_SIZE bytes.
+ * @param[in] nonce     @p CHACHAPOLY_NONCE_SIZE bytes.
+ * @param[out] out      The ciphertext followed by the tag,
+ *                      @p CHACHAPOLY_TAG_SIZE bytes longer than @p in. May
+ *                      be @p in.
+ */
+void chachaPolySeal(const uint8_t *key, const uint8_t *nonce,
+                    const uint8_t *aad, size_t aadlen, const uint8_t *in,
+                    size_t len, uint8_t *out) {
+    chacha20Xor(key, nonce, 1, in, out, len);
+    mac(key, nonce, aad, aadlen, out, len, &out[len]);
+}
+
+/**
+ * @brief   Checks and decrypts a sealed message of @p len bytes, tag
+ *          included.
+ * @details Nothing is decrypted unless the tag matches. The comparison
+ *          takes the same time wherever the tags differ.
+ *
+ * @param[out] out      @p len less @p CHACHAPOLY_TAG_SIZE bytes. May be
+ *                      @p in.
+ * @return  @p false if the message is forged, corrupted or too short.
+ */
+bool chachaPolyOpen(const uint8_t *key, const uint8_t *nonce,
+                    const uint8_t *aad, size_t aadlen, const uint8_t *in,
+                    size_t len, uint8_t *out) {
+    uint8_t tag[CHACHAPOLY_TAG_SIZE];
+    uint8_t diff = 0;
+    size_t i;
+
+    if (len < CHACHAPOLY_TAG_SIZE) {
+        return false;
+    }
+    len -= CHACHAPOLY_TAG_SIZE;
+    mac(key, nonce, aad, aadlen, in, len, tag);
+    for (i = 0; i < CHACHAPOLY_TAG_SIZE; i++) {
+        diff |= (uint8_t)(tag[i] ^ in[len + i]);
+    }
+    if (diff != 0) {
+        return false;
+    }
+    chacha20Xor(key, nonce, 1, in, out, len);
+    return true;
+}
@@ -0,0 +1,31 @@
+/**
+ * @file    chachapoly.h
+ * @brief   ChaCha20-Poly1305 authenticated encryption (RFC 8439).
+ *
+ * @details A key must never seal two messages with the same nonce.
+ */
+
+#ifndef _CRYPTO_CHACHAPOLY_H_
+#define _CRYPTO_CHACHAPOLY_H_
+
+#include "crypto/chacha20.h"
+#include "crypto/poly1305.h"
+
+#define CHACHAPOLY_KEY_SIZE         CHACHA20_KEY_SIZE
+#define CHACHAPOLY_NONCE_SIZE       CHACHA20_NONCE_SIZE
+#define CHACHAPOLY_TAG_SIZE         POLY1305_TAG_SIZE
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void chachaPolySeal(const uint8_t *key, const uint8_t *nonce,
+                      const uint8_t *aad, size_t aadlen, const uint8_t *in,
+                      size_t len, uint8_t *out);
+  bool chachaPolyOpen(const uint8_t *key, const uint8_t *nonce,
+                      const uint8_t *aad, size_t aadlen, const uint8_t *in,
+                      size_t len, uint8_t *out);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CRYPTO_CHACHAPOLY_H_ */
@@ -0,0 +1,99 @@
+/**
+ * @file    cmac.c
+ * @brief   AES-CMAC message authentication code (NIST SP 800-38B,
+ *          RFC 4493).
+ */
+
+#include <string.h>
+
+#include "crypto/cmac.h"
+
+/**
+ * @brief   Multiplication by x in GF(2^128), without a branch on the key.
+ */
+static void double_block(const uint8_t *in, uint8_t *out) {
+    uint8_t carry = (uint8_t)(0x87 & -(in[0] >> 7));
+    size_t i;
+
+    for (i = 0; i < AES_BLOCK_SIZE - 1; i++) {
+        out[i] = (uint8_t)(in[i] << 1 | in[i + 1] >> 7);
+    }
+    out[AES_BLOCK_SIZE - 1] = (uint8_t)(in[AES_BLOCK_SIZE - 1] << 1) ^ carry;
+}
+
+static void absorb(Cmac *cp, const uint8_t *block) {
+    size_t i;
+
+    for (i = 0; i < AES_BLOCK_SIZE; i++) {
+        cp->x[i] ^= block[i];
+    }
+    aesEncrypt(&cp->key->aes, cp->x, cp->x);
+}
+
+/**
+ * @brief   Expands @p key, @p AES_KEY_SIZE bytes, and derives the subkeys.
+ */
+void cmacKeyInit(CmacKey *ckp, const uint8_t *key) {
+    uint8_t l[AES_BLOCK_SIZE];
+
+    aesInit(&ckp->aes, key);
+    memset(l, 0, sizeof(l));
+    aesEncrypt(&ckp->aes, l, l);
+    double_block(l, ckp->k1);
+    double_block(ckp->k1, ckp->k2);
+    memset(l, 0, sizeof(l));
+}
+
+/**
+ * @brief   Starts a MAC.
+ *
+ * @param[in] iv        Initial chaining value, @p NULL for zero as in the
+ *                      standard.
+ */
+void cmacInit(Cmac *cp, const CmacKey *ckp, const uint8_t *iv) {
+    cp->key = ckp;
+    if (iv != NULL) {
+        memcpy(cp->x, iv, sizeof(cp->x));
+    } else {
+        memset(cp->x, 0, sizeof(cp->x));
+    }
+    cp->used = 0;
+}
+
+void cmacUpdate(Cmac *cp, const uint8_t *data, size_t len) {
+    while (len > 0) {
+        size_t n;
+
+        /* A full buffer is only absorbed once more data follows. */
+        if (cp->used == AES_BLOCK_SIZE) {
+            absorb(cp, cp->buf);
+            cp->used = 0;
+        }
+        n = AES_BLOCK_SIZE - cp->used;
+        n = n < len ? n : len;
+        memcpy(&cp->buf[cp->used], data, n);
+        cp->used += n;
+        data += n;
+        len -= n;
+    }
+}
+
+/**
+ * @brief   Writes the @p CMAC_SIZE byte MAC and wipes the state.
+ */
+void cmacFinish(Cmac *cp, uint8_t *mac) {
+    const uint8_t *subkey = cp->key->k1;
+    size_t i;
+
+    if (cp->used < AES_BLOCK_SIZE) {
+        cp->buf[cp->used] = 0x80;
+        memset(&cp->buf[cp->used + 1], 0, AES_BLOCK_SIZE - cp->used - 1);
+        subkey = cp->key->k2;
+    }
+    for (i = 0; i < AES_BLOCK_SIZE; i++) {
+        cp->buf[i] ^= subkey[i];
+    }
+    absorb(cp, cp->buf);
+    memcpy(mac, cp->x, CMAC_SIZE);
+    memset(cp, 0, sizeof(*cp));
+}
@@ -0,0 +1,48 @@
+/**
+ * @file    cmac.h
+ * @brief   AES-CMAC message authentication code (NIST SP 800-38B,
+ *          RFC 4493).
+ *
+ * @details The chaining value may start from an IV instead of zero: MIFARE
+ *          DESFire EV1 carries the last MAC of a session over to the next
+ *          command.
+ */
+
+#ifndef _CRYPTO_CMAC_H_
+#define _CRYPTO_CMAC_H_
+
+#include "crypto/aes.h"
+
+#define CMAC_SIZE                   AES_BLOCK_SIZE
+
+/**
+ * @brief   Key with its two subkeys.
+ */
+typedef struct {
+    AesKey aes;
+    uint8_t k1[AES_BLOCK_SIZE];     /**< For a complete last block.         */
+    uint8_t k2[AES_BLOCK_SIZE];     /**< For a padded last block.           */
+} CmacKey;
+
+/**
+ * @brief   MAC being computed.
+ */
+typedef struct {
+    const CmacKey *key;
+    uint8_t x[AES_BLOCK_SIZE];      /**< Chaining value.                    */
+    uint8_t buf[AES_BLOCK_SIZE];    /**< Held back, it may be the last.     */
+    size_t used;                    /**< Bytes in @p buf.                   */
+} Cmac;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void cmacKeyInit(CmacKey *ckp, const uint8_t *key);
+  void cmacInit(Cmac *cp, const CmacKey *ckp, const uint8_t *iv);
+  void cmacUpdate(Cmac *cp, const uint8_t *data, size_t len);
+  void cmacFinish(Cmac *cp, uint8_t *mac);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CRYPTO_CMAC_H_ */
@@ -0,0 +1,235 @@
+/**
+ * @file    poly1305.c
+ * @brief   Poly1305 one-time authenticator (RFC 8439).
+ */
+
+#include <string.h>
+
+#include "crypto/poly1305.h"
+
+#define LIMB_MASK                   0x3FFFFFFU
+
+/* Set above the 16 bytes of every full block. */
+#define HIBIT                       (1U << 24)
+
+static uint32_t load32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+           (uint32_t)p[3] << 24;
+}
+
+static void store32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+/**
+ * @brief   64 bit product of @p a and @p b, both below 2^30.
+ * @details On Cortex-M0 the middle partial products of the 16 bit halves
+ *          fit 32 bits together, the limbs being that small.
+ */
+static inline uint64_t mul(uint32_t a, uint32_t b) {
+#if defined(__ARM_ARCH_6M__)
+    uint32_t al = a & 0xFFFF;
+    uint32_t ah = a >> 16;
+    uint32_t bl = b & 0xFFFF;
+    uint32_t bh = b >> 16;
+
+    return ((uint64_t)(ah * bh) << 32) + ((uint64_t)(al * bh + ah * bl) << 16) +
+           al * bl;
+#else
+    return (uint64_t)a * b;
+#endif
+}
+
+/**
+ * @brief   Adds one 16 byte block, @p hibit above it, and multiplies by r.
+ */
+static void block(Poly1305 *pp, const uint8_t *m, uint32_t hibit) {
+    uint32_t r0 = pp->r[0], r1 = pp->r[1], r2 = pp->r[2], r3 = pp->r[3];
+    uint32_t r4 = pp->r[4];
+    uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+    uint32_t h0 = pp->h[0], h1 = pp->h[1], h2 = pp->h[2], h3 = pp->h[3];
+    uint32_t h4 = pp->h[4];
+    uint64_t d0, d1, d2, d3, d4;
+    uint32_t c;
+
+    h0 += load32(&m[0]) & LIMB_MASK;
+    h1 += (load32(&m[3]) >> 2) & LIMB_MASK;
+    h2 += (load32(&m[6]) >> 4) & LIMB_MASK;
+    h3 += (load32(&m[9]) >> 6) & LIMB_MASK;
+    h4 += (load32(&m[12]) >> 8) | hibit;
+
+    d0 = mul(h0, r0) + mul(h1, s4) + mul(h2, s3) + mul(h3, s2) + mul(h4, s1);
+    d1 = mul(h0, r1) + mul(h1, r0) + mul(h2, s4) + mul(h3, s3) + mul(h4, s2);
+    d2 = mul(h0, r2) + mul(h1, r1) + mul(h2, r0) + mul(h3, s4) + mul(h4, s3);
+    d3 = mul(h0, r3) + mul(h1, r2) + mul(h2, r1) + mul(h3, r0) + mul(h4, s4);
+    d4 = mul(h0, r4) + mul(h1, r3) + mul(h2, r2) + mul(h3, r1) + mul(h4, r0);
+
+    c = (uint32_t)(d0 >> 26);
+    h0 = (uint32_t)d0 & LIMB_MASK;
+    d1 += c;
+    c = (uint32_t)(d1 >> 26);
+    h1 = (uint32_t)d1 & LIMB_MASK;
+    d2 += c;
+    c = (uint32_t)(d2 >> 26);
+    h2 = (uint32_t)d2 & LIMB_MASK;
+    d3 += c;
+    c = (uint32_t)(d3 >> 26);
+    h3 = (uint32_t)d3 & LIMB_MASK;
+    d4 += c;
+    c = (uint32_t)(d4 >> 26);
+    h4 = (uint32_t)d4 & LIMB_MASK;
+    h0 += c * 5;
+    c = h0 >> 26;
+    h0 &= LIMB_MASK;
+    h1 += c;
+
+    pp->h[0] = h0;
+    pp->h[1] = h1;
+    pp->h[2] = h2;
+    pp->h[3] = h3;
+    pp->h[4] = h4;
+}
+
+/**
+ * @brief   Starts an authenticator with a one-time @p key.
+ *
+ * @param[in] key       @p POLY1305_KEY_SIZE bytes, r then s.
+ */
+void poly1305Init(Poly1305 *pp, const uint8_t *key) {
+    size_t i;
+
+    memset(pp, 0, sizeof(*pp));
+    /* r is clamped. */
+    pp->r[0] = load32(&key[0]) & 0x3FFFFFF;
+    pp->r[1] = (load32(&key[3]) >> 2) & 0x3FFFF03;
+    pp->r[2] = (load32(&key[6]) >> 4) & 0x3FFC0FF;
+    pp->r[3] = (load32(&key[9]) >> 6) & 0x3F03FFF;
+    pp->r[4] = (load32(&key[12]) >> 8) & 0x00FFFFF;
+    for (i = 0; i < 4; i++) {
+        pp->pad[i] = load32(&key[16 + 4 * i]);
+    }
+}
+
+/**
+ * @brief   Adds @p len bytes of the message.
+ */
+void poly1305Update(Poly1305 *pp, const uint8_t *data, size_t len) {
+    if (pp->used > 0) {
+        size_t n = POLY1305_BLOCK_SIZE - pp->used;
+
+        if (n > len) {
+            n = len;
+        }
+        memcpy(&pp->buf[pp->used], data, n);
+        pp->used += n;
+        data += n;
+        len -= n;
+        if (pp->used < POLY1305_BLOCK_SIZE) {
+            return;
+        }
+        block(pp, pp->buf, HIBIT);
+        pp->used = 0;
+    }
+    while (len >= POLY1305_BLOCK_SIZE) {
+        block(pp, data, HIBIT);
+        data += POLY1305_BLOCK_SIZE;
+        len -= POLY1305_BLOCK_SIZE;
+    }
+    if (len > 0) {
+        memcpy(pp->buf, data, len);
+        pp->used = len;
+    }
+}
+
+/**
+ * @brief   Pads the message with zeros to a whole block.
+ */
+void poly1305Align(Poly1305 *pp) {
+    if (pp->used > 0) {
+        memset(&pp->buf[pp->used], 0, POLY1305_BLOCK_SIZE - pp->used);
+        block(pp, pp->buf, HIBIT);
+        pp->used = 0;
+    }
+}
+
+/**
+ * @brief   Computes the tag of the message added.
+ *
+ * @param[out] tag      @p POLY1305_TAG_SIZE bytes.
+ */
+void poly1305Finish(Poly1305 *pp, uint8_t *tag) {
+    uint32_t h0, h1, h2, h3, h4;
+    uint32_t g0, g1, g2, g3, g4;
+    uint32_t c;
+    uint32_t mask;
+    uint64_t f;
+
+    if (pp->used > 0) {
+        /* The last partial block ends with a one, instead of the bit above
+           it. */
+        pp->buf[pp->used] = 1;
+        memset(&pp->buf[pp->used + 1], 0, POLY1305_BLOCK_SIZE - pp->used - 1);
+        block(pp, pp->buf, 0);
+    }
+
+    h0 = pp->h[0];
+    h1 = pp->h[1];
+    h2 = pp->h[2];
+    h3 = pp->h[3];
+    h4 = pp->h[4];
+    c = h1 >> 26;
+    h1 &= LIMB_MASK;
+    h2 += c;
+    c = h2 >> 26;
+    h2 &= LIMB_MASK;
+    h3 += c;
+    c = h3 >> 26;
+    h3 &= LIMB_MASK;
+    h4 += c;
+    c = h4 >> 26;
+    h4 &= LIMB_MASK;
+    h0 += c * 5;
+    c = h0 >> 26;
+    h0 &= LIMB_MASK;
+    h1 += c;
+
+    /* h - p, taken if not negative, without a branch. */
+    g0 = h0 + 5;
+    c = g0 >> 26;
+    g0 &= LIMB_MASK;
+    g1 = h1 + c;
+    c = g1 >> 26;
+    g1 &= LIMB_MASK;
+    g2 = h2 + c;
+    c = g2 >> 26;
+    g2 &= LIMB_MASK;
+    g3 = h3 + c;
+    c = g3 >> 26;
+    g3 &= LIMB_MASK;
+    g4 = h4 + c - (1U << 26);
+    mask = (g4 >> 31) - 1;
+    h0 = (h0 & ~mask) | (g0 & mask);
+    h1 = (h1 & ~mask) | (g1 & mask);
+    h2 = (h2 & ~mask) | (g2 & mask);
+    h3 = (h3 & ~mask) | (g3 & mask);
+    h4 = (h4 & ~mask) | (g4 & mask);
+
+    /* Modulo 2^128, plus the pad. */
+    h0 = h0 | h1 << 26;
+    h1 = h1 >> 6 | h2 << 20;
+    h2 = h2 >> 12 | h3 << 14;
+    h3 = h3 >> 18 | h4 << 8;
+    f = (uint64_t)h0 + pp->pad[0];
+    store32(&tag[0], (uint32_t)f);
+    f = (uint64_t)h1 + pp->pad[1] + (f >> 32);
+    store32(&tag[4], (uint32_t)f);
+    f = (uint64_t)h2 + pp->pad[2] + (f >> 32);
+    store32(&tag[8], (uint32_t)f);
+    f = (uint64_t)h3 + pp->pad[3] + (f >> 32);
+    store32(&tag[12], (uint32_t)f);
+
+    memset(pp, 0, sizeof(*pp));
+}
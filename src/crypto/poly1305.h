@@ -0,0 +1,43 @@
+/**
+ * @file    poly1305.h
+ * @brief   Poly1305 one-time authenticator (RFC 8439).
+ *
+ * @details The accumulator and the key are kept in five 26 bit limbs, so
+ *          the products of a block fit 64 bits with room for their sums.
+ *          Thumb-1 has no 32x32->64 bit multiply: on Cortex-M0 each product
+ *          is put together from four 16x16 bit @p MULS instead of a call to
+ *          the generic 64 bit multiplication of the compiler's library.
+ */
+
+#ifndef _CRYPTO_POLY1305_H_
+#define _CRYPTO_POLY1305_H_
+
+#include "platform.h"
+
+#define POLY1305_KEY_SIZE           32
+#define POLY1305_TAG_SIZE           16
+#define POLY1305_BLOCK_SIZE         16
+
+/**
+ * @brief   Authenticator state.
+ */
+typedef struct {
+    uint32_t r[5];                  /**< Clamped key, 26 bit limbs.         */
+    uint32_t h[5];                  /**< Accumulator, 26 bit limbs.         */
+    uint32_t pad[4];                /**< Added at the end.                  */
+    uint8_t buf[POLY1305_BLOCK_SIZE];
+    size_t used;                    /**< Bytes in @p buf.                   */
+} Poly1305;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void poly1305Init(Poly1305 *pp, const uint8_t *key);
+  void poly1305Update(Poly1305 *pp, const uint8_t *data, size_t len);
+  void poly1305Align(Poly1305 *pp);
+  void poly1305Finish(Poly1305 *pp, uint8_t *tag);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CRYPTO_POLY1305_H_ */
@@ -0,0 +1,292 @@
+/**
+ * @file    audio_hw.c
+ * @brief   Sound output on the DAC, PA4.
+ * @details The DAC converts what is written to its data register, without
+ *          a trigger of its own: the DMA writes it on every TIM17 update.
+ *          The counter of the DMA tells whether a block was rendered in
+ *          time, after the refill it must still be in the other block.
+ *
+ *          Any thread may play a sound. The one starting the conversions
+ *          renders the first two blocks itself; sounds played meanwhile
+ *          wait for it and replace its sound before the DMA starts.
+ */
+
+#include "ch.h"
+#include "hal.h"
+
+#include "drivers/audio_hw.h"
+
+AudioEngine AUDIOD1;
+
+static uint16_t buffer[2 * AUDIO_BLOCK];
+static bool running;
+/* A thread is rendering the first blocks from the source of filled. */
+static bool filling;
+static const void *filled;
+/* Played while filling, for the filling thread to take. */
+static bool deferred;
+static audiosourcecb_t deferredSource;
+static void *deferredArg;
+/* Set up one while the other may still be playing. */
+static AudioBeep beeps[2];
+static AdpcmDecoder decoders[2];
+static SynthPlayer players[2];
+
+static void stop_i(void);
+static void start(void);
+
+/*
+ * Renders the next block into the one the DMA is done with and stops the
+ * conversions once it is silent, from the transfer interrupt.
+ */
+static void refill(uint16_t *block) {
+    if (!audioRefill(&AUDIOD1, block)) {
+        chSysLockFromISR();
+        stop_i();
+        running = false;
+        chSysUnlockFromISR();
+    }
+}
+
+#if !defined(SIMULATOR)
+
+static const stm32_dma_stream_t *dma;
+
+static void dma_cb(void *arg, uint32_t flags) {
+    size_t left;
+
+    (void)arg;
+
+    if ((flags & STM32_DMA_ISR_HTIF) != 0) {
+        refill(buffer);
+        left = dmaStreamGetTransactionSize(dma);
+        if (running && left > AUDIO_BLOCK) {
+            AUDIOD1.stats.late++;
+        }
+    }
+    if ((flags & STM32_DMA_ISR_TCIF) != 0) {
+        refill(&buffer[AUDIO_BLOCK]);
+        left = dmaStreamGetTransactionSize(dma);
+        if (running && left <= AUDIO_BLOCK) {
+            AUDIOD1.stats.late++;
+        }
+    }
+}
+
+/*
+ * The DMA stops past the last sample of the sound, the DAC goes back to
+ * zero.
+ */
+static void stop_i(void) {
+    TIM17->CR1 = 0;
+    TIM17->DIER = 0;
+    dmaStreamDisable(dma);
+    DAC->DHR12R1 = AUDIO_DAC_ZERO;
+}
+
+static void start(void) {
+    dmaStreamSetMemory0(dma, buffer);
+    dmaStreamSetTransactionSize(dma, 2 * AUDIO_BLOCK);
+    dmaStreamSetMode(dma, STM32_DMA_CR_PL(AUDIO_HW_DMA_PRIORITY) |
+                          STM32_DMA_CR_DIR_M2P | STM32_DMA_CR_MSIZE_HWORD |
+                          STM32_DMA_CR_PSIZE_HWORD | STM32_DMA_CR_MINC |
+                          STM32_DMA_CR_CIRC | STM32_DMA_CR_HTIE |
+                          STM32_DMA_CR_TCIE);
+    dmaStreamEnable(dma);
+    TIM17->CNT = 0;
+    TIM17->DIER = TIM_DIER_UDE;
+    TIM17->CR1 = TIM_CR1_CEN;
+}
+
+static void start_hw(void) {
+    bool b;
+
+    rccEnableAPB1(RCC_APB1ENR_DACEN, FALSE);
+    rccEnableAPB2(RCC_APB2ENR_TIM17EN, FALSE);
+    DAC->DHR12R1 = AUDIO_DAC_ZERO;
+    DAC->CR = DAC_CR_EN1;
+
+    TIM17->CR1 = 0;
+    TIM17->PSC = 0;
+    TIM17->ARR = STM32_TIMCLK1 / AUDIO_RATE - 1;
+
+    dma = STM32_DMA_STREAM(AUDIO_HW_DMA_STREAM);
+    b = dmaStreamAllocate(dma, AUDIO_HW_IRQ_PRIORITY, dma_cb, NULL);
+    osalDbgAssert(!b, "stream already allocated");
+    dmaStreamSetPeripheral(dma, &DAC->DHR12R1);
+}
+
+#else /* defined(SIMULATOR) */
+
+static void end_cb(DACDriver *dacp, const dacsample_t *block, size_t n) {
+    (void)dacp;
+    (void)n;
+
+    refill((uint16_t *)block);
+}
+
+static const DACConfig daccfg = {
+    AUDIO_DAC_ZERO,
+    DAC_DHRM_12BIT_RIGHT
+};
+
+static const DACConversionGroup dacgrp = {
+    1,
+    end_cb,
+    NULL,
+    0
+};
+
+static void stop_i(void) {
+    dacStopConversionI(&DACD1);
+}
+
+static void start(void) {
+    dacStartConversion(&DACD1, &dacgrp, buffer, 2 * AUDIO_BLOCK);
+}
+
+static void start_hw(void) {
+    dacStart(&DACD1, &daccfg);
+}
+
+#endif /* defined(SIMULATOR) */
+
+/**
+ * @brief   Starts the DAC silent.
+ */
+void audioHwInit(void) {
+    audioInit(&AUDIOD1);
+    palSetPadMode(GPIOA, GPIOA_AUDIO_OUT, PAL_MODE_INPUT_ANALOG);
+    start_hw();
+}
+
+/*
+ * Whether the slot @p arg may be rendered from, by the DMA interrupt or by
+ * the thread filling the blocks. With the lock held.
+ */
+static bool rendering(const void *arg) {
+    return filling ? filled == arg : AUDIOD1.arg == arg;
+}
+
+/*
+ * Switches to @p source with the lock held.
+ *
+ * Returns true if the conversions are stopped: the caller then fills the
+ * blocks and starts them.
+ */
+static bool play_i(audiosourcecb_t source, void *arg) {
+    if (filling) {
+        deferred = true;
+        deferredSource = source;
+        deferredArg = arg;
+        return false;
+    }
+    audioPlayI(&AUDIOD1, source, arg);
+    if (running || source == NULL) {
+        return false;
+    }
+    running = true;
+    filling = true;
+    filled = arg;
+    return true;
+}
+
+/*
+ * Renders both blocks, again for a sound played meanwhile, and starts the
+ * conversions. Nothing else renders until they start.
+ */
+static void fill(void) {
+    bool again;
+
+    do {
+        (void)audioRefill(&AUDIOD1, buffer);
+        (void)audioRefill(&AUDIOD1, &buffer[AUDIO_BLOCK]);
+        chSysLock();
+        again = deferred;
+        if (again) {
+            audioPlayI(&AUDIOD1, deferredSource, deferredArg);
+            filled = deferredArg;
+            deferred = false;
+        } else {
+            filling = false;
+        }
+        chSysUnlock();
+    } while (again);
+    start();
+}
+
+/**
+ * @brief   Plays @p source instead of the sound playing, see
+ *          @p audioPlay().
+ * @details Starts the conversions if they are stopped, with both blocks
+ *          rendered first.
+ */
+void audioHwPlay(audiosourcecb_t source, void *arg) {
+    bool idle;
+
+    chSysLock();
+    idle = play_i(source, arg);
+    chSysUnlock();
+    if (idle) {
+        fill();
+    }
+}
+
+/**
+ * @brief   Plays a beep of @p hz for @p ms.
+ */
+void audioHwBeep(uint32_t hz, uint32_t ms) {
+    AudioBeep *bp;
+    bool idle;
+
+    chSysLock();
+    bp = rendering(&beeps[0]) ? &beeps[1] : &beeps[0];
+    audioBeepInit(bp, hz, ms, AUDIO_HW_BEEP_LEVEL);
+    idle = play_i(audioBeepSource, bp);
+    chSysUnlock();
+    if (idle) {
+        fill();
+    }
+}
+
+/**
+ * @brief   Plays a sound of flash, decoded block by block.
+ */
+void audioHwSound(const AdpcmSound *sound) {
+    AdpcmDecoder *dp;
+    bool idle;
+
+    chSysLock();
+    dp = rendering(&decoders[0]) ? &decoders[1] : &decoders[0];
+    adpcmDecoderInit(dp, sound);
+    idle = play_i(adpcmSource, dp);
+    chSysUnlock();
+    if (idle) {
+        fill();
+    }
+}
+
+/**
+ * @brief   Plays a tune of the synthesizer.
+ */
+void audioHwTune(const SynthTune *tune) {
+    SynthPlayer *pp;
+    bool idle;
+
+    chSysLock();
+    pp = rendering(&players[0]) ? &players[1] : &players[0];
+    synthInit(pp, tune);
+    idle = play_i(synthSource, pp);
+    chSysUnlock();
+    if (idle) {
+        fill();
+    }
+}
+
+/**
+ * @brief   Whether the DAC is converting, a sound playing or its last
+ *          block.
+ */
+bool audioHwPlaying(void) {
+    return running || audioPlaying(&AUDIOD1);
+}
@@ -0,0 +1,78 @@
+/**
+ * @file    audio_hw.h
+ * @brief   Sound output on the DAC, PA4.
+ * @details TIM17 runs at the sample rate and each update requests a DMA
+ *          transfer of the next sample of the double buffer of
+ *          @p audio/audio.h to DAC channel 1, in a circle. The channel the
+ *          DAC driver would trigger its DMA on carries the SPI1
+ *          transmissions to the MFRC522, so the DAC is driven here without
+ *          it, on the DMA channel of TIM17, free as the ADC is not used.
+ *          The half and full transfer interrupts refill the block the DMA
+ *          is done with. Their priority is above the link and the platform
+ *          timers, so those never hold a block back.
+ *
+ *          The flash controller stalls the CPU, interrupts included, for
+ *          up to 40 ms per page erase (see @p drivers/flash_hw.h), longer
+ *          than a block. Erases wait while @p audioHwPlaying().
+ *
+ *          The conversions stop once a sound has ended and start again
+ *          with the next, the output holds @p AUDIO_DAC_ZERO meanwhile. The
+ *          simulator converts through its DAC driver and writes the samples
+ *          to @p SIM_DAC1, see @p boards/sim/platform/dac_lld.h.
+ */
+
+#ifndef _AUDIO_HW_H_
+#define _AUDIO_HW_H_
+
+#include "audio/adpcm.h"
+#include "audio/audio.h"
+#include "audio/synth.h"
+
+/**
+ * @brief   DMA stream of the TIM17 update requests.
+ */
+#if !defined(AUDIO_HW_DMA_STREAM) || defined(__DOXYGEN__)
+#define AUDIO_HW_DMA_STREAM         STM32_DMA_STREAM_ID(1, 1)
+#endif
+
+/**
+ * @brief   Arbitration priority of the DMA stream, above the link and the
+ *          SPI.
+ */
+#if !defined(AUDIO_HW_DMA_PRIORITY) || defined(__DOXYGEN__)
+#define AUDIO_HW_DMA_PRIORITY       3
+#endif
+
+/**
+ * @brief   Priority of the half and full transfer interrupts.
+ */
+#if !defined(AUDIO_HW_IRQ_PRIORITY) || defined(__DOXYGEN__)
+#define AUDIO_HW_IRQ_PRIORITY       1
+#endif
+
+/**
+ * @brief   Level of the beeps, of the signed 16 bit full scale.
+ */
+#if !defined(AUDIO_HW_BEEP_LEVEL) || defined(__DOXYGEN__)
+#define AUDIO_HW_BEEP_LEVEL         16000
+#endif
+
+/**
+ * @brief   Sound output of the board.
+ */
+extern AudioEngine AUDIOD1;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void audioHwInit(void);
+  void audioHwPlay(audiosourcecb_t source, void *arg);
+  void audioHwBeep(uint32_t hz, uint32_t ms);
+  void audioHwSound(const AdpcmSound *sound);
+  void audioHwTune(const SynthTune *tune);
+  bool audioHwPlaying(void);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _AUDIO_HW_H_ */
@@ -0,0 +1,111 @@
+/**
+ * @file    flash_hw.c
+ * @brief   Erase and program of the access list flash region.
+ * @details The flash controller is unlocked for each operation and locked
+ *          again after it, so a stray write elsewhere in the firmware cannot
+ *          program the flash. A halfword takes any value once after an erase
+ *          and 0x0000 at any time, the controller refuses anything else with
+ *          a programming error.
+ */
+
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "drivers/flash_hw.h"
+
+static bool erase(void *arg, size_t offset);
+static bool program(void *arg, size_t offset, const void *data, size_t len);
+
+const ReaderAclFlash flashHwAcl = {
+    BOARD_ACL_FLASH,
+    BOARD_ACL_FLASH_SIZE,
+    BOARD_ACL_FLASH_PAGE_SIZE,
+    erase,
+    program,
+    NULL
+};
+
+#if !defined(SIMULATOR)
+
+static void unlock(void) {
+    if ((FLASH->CR & FLASH_CR_LOCK) != 0) {
+        FLASH->KEYR = 0x45670123U;
+        FLASH->KEYR = 0xCDEF89ABU;
+    }
+}
+
+/*
+ * Waits for the operation under way, the CPU only gets here once it is
+ * done as the fetch of the loop stalls.
+ */
+static bool wait(void) {
+    uint32_t sr;
+
+    while ((FLASH->SR & FLASH_SR_BSY) != 0) {
+    }
+    sr = FLASH->SR;
+    FLASH->SR = FLASH_SR_EOP | FLASH_SR_PGERR | FLASH_SR_WRPERR;
+    return (sr & (FLASH_SR_PGERR | FLASH_SR_WRPERR)) == 0;
+}
+
+static bool erase(void *arg, size_t offset) {
+    bool ok;
+
+    (void)arg;
+    unlock();
+    FLASH->CR |= FLASH_CR_PER;
+    FLASH->AR = (uint32_t)BOARD_ACL_FLASH + offset;
+    FLASH->CR |= FLASH_CR_STRT;
+    ok = wait();
+    FLASH->CR &= ~FLASH_CR_PER;
+    FLASH->CR |= FLASH_CR_LOCK;
+    return ok;
+}
+
+static bool program(void *arg, size_t offset, const void *data, size_t len) {
+    volatile uint16_t *to = (volatile uint16_t *)((uint32_t)BOARD_ACL_FLASH +
+                                                  offset);
+    const uint8_t *p = data;
+    bool ok = true;
+    size_t i;
+
+    (void)arg;
+    unlock();
+    FLASH->CR |= FLASH_CR_PG;
+    for (i = 0; i < len / 2 && ok; i++) {
+        to[i] = (uint16_t)(p[2 * i] | p[2 * i + 1] << 8);
+        ok = wait();
+    }
+    FLASH->CR &= ~FLASH_CR_PG;
+    FLASH->CR |= FLASH_CR_LOCK;
+    return ok;
+}
+
+#else /* defined(SIMULATOR) */
+
+static bool erase(void *arg, size_t offset) {
+    (void)arg;
+    memset((uint8_t *)simAclFlash + offset, 0xFF, BOARD_ACL_FLASH_PAGE_SIZE);
+    return true;
+}
+
+static bool program(void *arg, size_t offset, const void *data, size_t len) {
+    uint8_t *to = (uint8_t *)simAclFlash + offset;
+    const uint8_t *p = data;
+    size_t i;
+
+    (void)arg;
+    for (i = 0; i < len; i += 2) {
+        if ((to[i] != 0xFF || to[i + 1] != 0xFF) &&
+            (p[i] != 0 || p[i + 1] != 0)) {
+            return false;
+        }
+        to[i] = p[i];
+        to[i + 1] = p[i + 1];
+    }
+    return true;
+}
+
+#endif /* defined(SIMULATOR) */
@@ -0,0 +1,25 @@
+/**
+ * @file    flash_hw.h
+ * @brief   Erase and program of the access list flash region.
+ * @details The STM32F0 has one flash bank, so the CPU stalls on its next
+ *          instruction fetch until an erase or a program is done: up to
+ *          40 ms for a page erase and 70 us for a halfword. Interrupts wait
+ *          as well, the DMA streams do not. The link keeps receiving into
+ *          its ring, which holds @p LINK_RX_RING_SIZE bytes, 66 ms at
+ *          38400 bit/s; at faster rates a frame arriving during an erase
+ *          may be lost and is sent again by the protocol.
+ *
+ *          The simulator programs the region in RAM with the same rules.
+ */
+
+#ifndef _FLASH_HW_H_
+#define _FLASH_HW_H_
+
+#include "reader/aclstore.h"
+
+/**
+ * @brief   The access list region of the board.
+ */
+extern const ReaderAclFlash flashHwAcl;
+
+#endif /* _FLASH_HW_H_ */
@@ -0,0 +1,309 @@
+/**
+ * @file    link_hw.c
+ * @brief   Controller link transport over USART2 with DMA.
+ * @details Both directions run on the UART driver, which moves the bytes
+ *          with the DMA streams @p STM32_UART_USART2_RX_DMA_STREAM and
+ *          @p STM32_UART_USART2_TX_DMA_STREAM. The UART driver of ChibiOS
+ *          16.1 reports no idle line, so a receive segment is armed on the
+ *          first byte of a burst instead: until then the driver hands each
+ *          byte to the character callback, which stores it and starts the
+ *          DMA on the rest of the segment. A platform timer then looks at
+ *          the DMA counter every @p LINK_HW_IDLE_CHARS character times and
+ *          ends the segment early once it has not moved. A burst costs one
+ *          interrupt for its first byte and one per look, not one per byte.
+ *
+ *          Waiting threads are woken from the UART callbacks, or by a
+ *          platform timer once their timeout passes. The RS-485 driver
+ *          enable, if any, follows the transmissions. A new bit rate
+ *          restarts the UART driver with the new speed. Until the TX pin
+ *          is taken from SWD, see @p LINK_HW_SWD_WINDOW_MS, transmissions
+ *          end at once without touching the line.
+ */
+
+#include "ch.h"
+#include "hal.h"
+
+#include "drivers/link_hw.h"
+
+LinkDriver LINKD1;
+
+/**
+ * @brief   Threads waiting for received bytes and for the transmit DMA.
+ */
+static thread_reference_t waiters[2];
+
+/**
+ * @brief   Receive segment armed by the link, @p NULL if none.
+ */
+static uint8_t *rxbuf;
+static size_t rxsize;
+
+/**
+ * @brief   The DMA receives the segment after its first byte.
+ */
+static bool rxdma;
+
+/**
+ * @brief   Bytes the DMA had left at the last look.
+ */
+static size_t rxleft;
+
+static PlatformTimer idleTimer;
+
+/**
+ * @brief   The TX pin is switched from SWCLK to USART2.
+ */
+static bool txpin;
+
+#if !LINK_HW_KEEP_SWD
+static PlatformTimer swdTimer;
+#endif
+
+static uint32_t idle_us(void);
+static void idle_check(void *arg);
+
+static void txend1_cb(UARTDriver *uartp) {
+    (void)uartp;
+
+    chSysLockFromISR();
+    linkTxEndI(&LINKD1);
+    chSysUnlockFromISR();
+}
+
+#if defined(LINK_HW_DE_PORT)
+/*
+ * The last stop bit is out, the bus is free unless the next frame of the
+ * turn is already going.
+ */
+static void txend2_cb(UARTDriver *uartp) {
+    (void)uartp;
+
+    chSysLockFromISR();
+    if (LINKD1.txbuf == NULL) {
+        palClearPad(LINK_HW_DE_PORT, LINK_HW_DE_PAD);
+    }
+    chSysUnlockFromISR();
+}
+#endif
+
+static void rxend_cb(UARTDriver *uartp) {
+    (void)uartp;
+
+    chSysLockFromISR();
+    platformTimerStopI(&idleTimer);
+    rxbuf = NULL;
+    rxdma = false;
+    linkRxEndI(&LINKD1);
+    chSysUnlockFromISR();
+}
+
+/*
+ * A byte arrived with no DMA receiving, the first of a burst: the DMA takes
+ * the rest of the segment.
+ */
+static void rxchar_cb(UARTDriver *uartp, uint16_t c) {
+    chSysLockFromISR();
+    if (rxbuf == NULL) {
+        linkRxCharI(&LINKD1);
+    } else if (rxsize == 1) {
+        rxbuf[0] = (uint8_t)c;
+        rxbuf = NULL;
+        linkRxEndI(&LINKD1);
+    } else {
+        rxbuf[0] = (uint8_t)c;
+        rxdma = true;
+        rxleft = rxsize - 1;
+        uartStartReceiveI(uartp, rxsize - 1, &rxbuf[1]);
+        platformTimerStartI(&idleTimer, idle_us(), idle_check, NULL);
+    }
+    chSysUnlockFromISR();
+}
+
+static void rxerr_cb(UARTDriver *uartp, uartflags_t e) {
+    (void)uartp;
+    (void)e;
+
+    chSysLockFromISR();
+    linkRxErrorI(&LINKD1);
+    chSysUnlockFromISR();
+}
+
+static void wait_timeout(void *arg) {
+    chThdResumeI((thread_reference_t *)arg, MSG_TIMEOUT);
+}
+
+/*
+ * 8N1, the speed changes with the negotiated bit rate.
+ */
+static UARTConfig uartcfg = {
+    txend1_cb,
+#if defined(LINK_HW_DE_PORT)
+    txend2_cb,
+#else
+    NULL,
+#endif
+    rxend_cb,
+    rxchar_cb,
+    rxerr_cb,
+    LINK_HW_BITRATE,
+    0,
+    0,
+    0
+};
+
+#if !defined(SIMULATOR)
+/*
+ * Bytes the receive DMA has yet to write.
+ */
+static size_t rx_left(void) {
+    return dmaStreamGetTransactionSize(UARTD2.dmarx);
+}
+#else
+static size_t rx_left(void) {
+    return UARTD2.rxbuf != NULL ? UARTD2.rxsize - UARTD2.rxn : 0;
+}
+#endif
+
+static uint32_t idle_us(void) {
+    return LINK_HW_IDLE_CHARS * 10 * 1000000 / uartcfg.speed + 1;
+}
+
+/*
+ * Ends the segment once no byte arrived since the last look, from the
+ * platform timer.
+ */
+static void idle_check(void *arg) {
+    size_t left = rx_left();
+
+    (void)arg;
+
+    if (left != rxleft) {
+        rxleft = left;
+        platformTimerStartI(&idleTimer, idle_us(), idle_check, NULL);
+        return;
+    }
+    linkRxIdleI(&LINKD1);
+}
+
+#if !LINK_HW_KEEP_SWD
+/*
+ * Takes the TX pin from the debugger, from the platform timer.
+ */
+static void take_txpin(void *arg) {
+    (void)arg;
+
+    palSetPadMode(GPIOA, GPIOA_RDR_TXD, PAL_MODE_ALTERNATE(1));
+    txpin = true;
+}
+#endif
+
+static void hw_start_send(void *ctx, const uint8_t *buf, size_t n) {
+    if (!txpin) {
+        linkTxEndI(&LINKD1);
+        return;
+    }
+#if defined(LINK_HW_DE_PORT)
+    palSetPad(LINK_HW_DE_PORT, LINK_HW_DE_PAD);
+#endif
+    uartStartSendI(ctx, n, buf);
+}
+
+/*
+ * The DMA starts on the first byte, see rxchar_cb().
+ */
+static void hw_start_receive(void *ctx, uint8_t *buf, size_t n) {
+    (void)ctx;
+
+    rxbuf = buf;
+    rxsize = n;
+    rxdma = false;
+}
+
+static size_t hw_stop_receive(void *ctx) {
+    size_t left = rxbuf != NULL ? rxsize : 0;
+
+    if (rxdma) {
+        platformTimerStopI(&idleTimer);
+        left = uartStopReceiveI(ctx);
+        rxdma = false;
+    }
+    rxbuf = NULL;
+    return left;
+}
+
+static bool hw_wait(void *ctx, unsigned waiter, uint32_t timeout) {
+    PlatformTimer timer;
+    msg_t msg;
+
+    (void)ctx;
+
+    if (timeout == LINK_WAIT_FOREVER) {
+        return chThdSuspendS(&waiters[waiter]) == MSG_OK;
+    }
+    platformTimerStartI(&timer, timeout, wait_timeout, &waiters[waiter]);
+    msg = chThdSuspendS(&waiters[waiter]);
+    platformTimerStopI(&timer);
+
+    return msg == MSG_OK;
+}
+
+static void hw_wakeup(void *ctx, unsigned waiter) {
+    (void)ctx;
+
+    chThdResumeI(&waiters[waiter], MSG_OK);
+}
+
+/*
+ * The DMA is done with the buffer but the last two characters may still be
+ * in the USART, they go out before it is set up again.
+ */
+static bool hw_set_bitrate(void *ctx, uint32_t bitrate) {
+    size_t i;
+
+    for (i = 0; i < LINK_HW_BITRATE_COUNT; i++) {
+        if (linkHwBitrates[i] == bitrate) {
+            break;
+        }
+    }
+    if (i == LINK_HW_BITRATE_COUNT && bitrate != LINK_HW_BITRATE) {
+        return false;
+    }
+    platformDelayUs(2 * 10 * 1000000 / uartcfg.speed + 1);
+    uartcfg.speed = bitrate;
+    uartStart(ctx, &uartcfg);
+    return true;
+}
+
+static const LinkTransport hw_transport = {
+    hw_start_send,
+    hw_start_receive,
+    hw_stop_receive,
+    hw_wait,
+    hw_wakeup,
+    hw_set_bitrate
+};
+
+const LinkConfig linkHwConfig = {
+    &hw_transport,
+    &UARTD2
+};
+
+const uint32_t linkHwBitrates[] = {LINK_HW_BITRATES};
+
+/**
+ * @brief   Starts USART2 and initializes @p LINKD1.
+ * @note    The TX pin doubles as SWCLK, it is taken from the debugger
+ *          @p LINK_HW_SWD_WINDOW_MS later unless @p LINK_HW_KEEP_SWD is set.
+ */
+void linkHwInit(void) {
+#if defined(LINK_HW_DE_PORT)
+    palClearPad(LINK_HW_DE_PORT, LINK_HW_DE_PAD);
+    palSetPadMode(LINK_HW_DE_PORT, LINK_HW_DE_PAD, PAL_MODE_OUTPUT_PUSHPULL);
+#endif
+#if !LINK_HW_KEEP_SWD
+    platformTimerStart(&swdTimer, LINK_HW_SWD_WINDOW_MS * 1000UL, take_txpin,
+                       NULL);
+#endif
+    uartStart(&UARTD2, &uartcfg);
+    linkObjectInit(&LINKD1);
+}
@@ -0,0 +1,111 @@
+/**
+ * @file    link_hw.h
+ * @brief   Controller link transport over USART2 with DMA.
+ * @details On a multi-drop bus, @p LINK_HW_DE_PORT and @p LINK_HW_DE_PAD
+ *          name the pad driving the driver enable of the RS-485
+ *          transceiver. It goes up right before a transmission and down
+ *          from the transmission complete interrupt, a few microseconds
+ *          after the last stop bit, so the reader frees the line well
+ *          before the controller's guard time ends. The reader answers a
+ *          turn no sooner than the look at the receive DMA which finds the
+ *          line idle, @p LINK_HW_IDLE_CHARS to twice that many character
+ *          times after the controller's last stop bit.
+ */
+
+#ifndef _LINK_HW_H_
+#define _LINK_HW_H_
+
+#include "link/link.h"
+
+/**
+ * @brief   Bit rate the controller link starts at and falls back to.
+ */
+#if !defined(LINK_HW_BITRATE) || defined(__DOXYGEN__)
+#define LINK_HW_BITRATE             SERIAL_DEFAULT_BITRATE
+#endif
+
+/**
+ * @brief   Faster bit rates the controller may negotiate, ascending.
+ * @details USART2 runs on the 48 MHz PCLK with 16 times oversampling: the
+ *          divider of these is off by 0.2 % at most and the fastest one is
+ *          PCLK / 16.
+ */
+#if !defined(LINK_HW_BITRATES) || defined(__DOXYGEN__)
+#define LINK_HW_BITRATES            57600, 115200, 230400, 460800, 921600, \
+                                    1000000, 1500000, 2000000, 3000000
+#endif
+
+/**
+ * @brief   Character times between two looks at the receive DMA.
+ * @details A segment the DMA has not filled ends at the first look which
+ *          finds no new byte. Fewer character times answer a turn sooner
+ *          and cost more timer interrupts during a burst.
+ */
+#if !defined(LINK_HW_IDLE_CHARS) || defined(__DOXYGEN__)
+#define LINK_HW_IDLE_CHARS          4
+#endif
+
+/**
+ * @brief   Leaves PA14 to the debugger as SWCLK.
+ * @details The USART2 TX pin doubles as SWCLK. When set, the pin is never
+ *          switched over and the reader never transmits. @p USE_SWD=yes
+ *          in the Makefile sets it for debug builds.
+ */
+#if !defined(LINK_HW_KEEP_SWD) || defined(__DOXYGEN__)
+#define LINK_HW_KEEP_SWD            FALSE
+#endif
+
+/**
+ * @brief   Milliseconds SWD stays usable after a reset before PA14 becomes
+ *          the USART2 TX pin.
+ * @details Leaves a debugger the time to attach and halt the reader, or to
+ *          flash it. Frames sent meanwhile are dropped as if lost on the
+ *          line.
+ */
+#if !defined(LINK_HW_SWD_WINDOW_MS) || defined(__DOXYGEN__)
+#define LINK_HW_SWD_WINDOW_MS       1000
+#endif
+
+/**
+ * @brief   Number of @p LINK_HW_BITRATES.
+ */
+#define LINK_HW_BITRATE_COUNT                                               \
+    (sizeof((const uint32_t[]){LINK_HW_BITRATES}) / sizeof(uint32_t))
+
+#if defined(__DOXYGEN__)
+/**
+ * @brief   Port of the RS-485 driver enable pad, not defined on a
+ *          point-to-point line.
+ */
+#define LINK_HW_DE_PORT             GPIOB
+
+/**
+ * @brief   RS-485 driver enable pad, active high.
+ */
+#define LINK_HW_DE_PAD              2U
+#endif
+
+/**
+ * @brief   Link to the controller.
+ */
+extern LinkDriver LINKD1;
+
+/**
+ * @brief   Configuration binding @p LINKD1 to the board transport.
+ */
+extern const LinkConfig linkHwConfig;
+
+/**
+ * @brief   @p LINK_HW_BITRATES as an array.
+ */
+extern const uint32_t linkHwBitrates[];
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void linkHwInit(void);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _LINK_HW_H_ */
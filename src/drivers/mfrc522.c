@@ -0,0 +1,635 @@
+/**
+ * @file    mfrc522.c
+ * @brief   NXP MFRC522 contactless reader IC driver.
+ */
+
+#include <string.h>
+
+#include "drivers/mfrc522.h"
+
+/*===========================================================================*/
+/* Driver local definitions.                                                 */
+/*===========================================================================*/
+
+/**
+ * @brief   Maximum time the oscillator needs after the reset is released.
+ */
+#define STARTUP_TIMEOUT_US          5000
+
+/**
+ * @brief   Air time of one byte with parity at 106 kbit/s, rounded up.
+ */
+#define BYTE_AIR_TIME_US            85
+
+/**
+ * @brief   Longest run of the random number generator.
+ */
+#define RANDOM_TIMEOUT_US           1000
+
+/**
+ * @brief   Size of the internal buffer.
+ */
+#define MEM_SIZE                    25
+
+/**
+ * @brief   Interrupt sources signalling the end of a command.
+ */
+#define COMMAND_DONE                (MFRC522_ComIrqReg_RxIRq |              \
+                                     MFRC522_ComIrqReg_IdleIRq |            \
+                                     MFRC522_ComIrqReg_TimerIRq)
+
+/**
+ * @brief   Registers read back after a transceive, ahead of the FIFO data.
+ */
+enum {
+    STATUS_COMIRQ,
+    STATUS_ERROR,
+    STATUS_FIFOLEVEL,
+    STATUS_CONTROL,
+    STATUS_COLL,
+    STATUS_COUNT
+};
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Configuration written after reset, the RF field stays off.
+ */
+static const uint8_t init_sequence[] = {
+    MFRC522_SEQ_WRITE(MFRC522_TxASKReg, MFRC522_TxASKReg_Force100ASK),
+    MFRC522_SEQ_WRITE(MFRC522_ModeReg, MFRC522_ModeReg_TxWaitRF |
+                                       MFRC522_ModeReg_PolMFin |
+                                       MFRC522_ModeReg_CRCPreset_6363),
+    MFRC522_SEQ_WRITE(MFRC522_TxModeReg, 0x00),
+    MFRC522_SEQ_WRITE(MFRC522_RxModeReg, 0x00),
+    MFRC522_SEQ_WRITE(MFRC522_TxControlReg, 0x80),
+    /* Active high push-pull IRQ, the board pulls the line down. */
+    MFRC522_SEQ_WRITE(MFRC522_DivIEnReg, MFRC522_DivIEnReg_IRQPushPull),
+    MFRC522_SEQ_WRITE(MFRC522_ComIEnReg, MFRC522_ComIEnReg_RxIEn |
+                                         MFRC522_ComIEnReg_IdleIEn |
+                                         MFRC522_ComIEnReg_TimerIEn),
+    MFRC522_SEQ_END
+};
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static void exchange(MFRC522Driver *mdp, size_t n, const uint8_t *txbuf,
+                     uint8_t *rxbuf) {
+    mdp->stats.transactions++;
+    mdp->stats.bytes += n;
+    mdp->stats.acquisitions++;
+    mdp->config->transport->exchange(mdp->config->ctx, n, txbuf, rxbuf);
+}
+
+static bool is_shadowed(uint8_t reg) {
+    return reg >= MFRC522_SHADOW_BASE && reg < MFRC522_REGISTER_COUNT;
+}
+
+static void shadow_store(MFRC522Driver *mdp, uint8_t reg, uint8_t value) {
+    if (is_shadowed(reg)) {
+        mdp->shadow[reg - MFRC522_SHADOW_BASE] = value;
+        mdp->shadowValid |= (uint64_t)1 << (reg - MFRC522_SHADOW_BASE);
+    }
+}
+
+static bool shadow_matches(MFRC522Driver *mdp, uint8_t reg, uint8_t value) {
+    return is_shadowed(reg) &&
+           (mdp->shadowValid & ((uint64_t)1 << (reg - MFRC522_SHADOW_BASE))) != 0 &&
+           mdp->shadow[reg - MFRC522_SHADOW_BASE] == value;
+}
+
+/**
+ * @brief   Appends a register write to the sequence being built.
+ */
+static void seq_write(MFRC522Driver *mdp, uint8_t reg, uint8_t value) {
+    uint8_t *p = &mdp->seq[mdp->seqlen];
+
+    p[0] = 2;
+    p[1] = MFRC522_SPI_ADDR(reg);
+    p[2] = value;
+    mdp->seqlen += 3;
+}
+
+/**
+ * @brief   Appends a register write unless the register already holds
+ *          @p value.
+ */
+static void seq_update(MFRC522Driver *mdp, uint8_t reg, uint8_t value) {
+    if (!shadow_matches(mdp, reg, value)) {
+        seq_write(mdp, reg, value);
+    }
+}
+
+static void seq_fifo(MFRC522Driver *mdp, size_t n, const uint8_t *buf) {
+    uint8_t *p = &mdp->seq[mdp->seqlen];
+
+    p[0] = (uint8_t)(n + 1);
+    p[1] = MFRC522_SPI_ADDR(MFRC522_FIFODataReg);
+    memcpy(&p[2], buf, n);
+    mdp->seqlen += n + 2;
+}
+
+static void seq_run(MFRC522Driver *mdp) {
+    if (mdp->seqlen > 0) {
+        mdp->seq[mdp->seqlen] = MFRC522_SEQ_END;
+        mfrc522RunSequence(mdp, mdp->seq);
+        mdp->seqlen = 0;
+    }
+}
+
+/**
+ * @brief   Appends the timer set-up so that it underflows @p us microseconds
+ *          after the end of the transmission.
+ */
+static void seq_timer(MFRC522Driver *mdp, uint32_t us) {
+    /* f_timer = fc / (2 * prescaler + 1) with a 16 bit reload value. */
+    uint32_t cycles = (uint32_t)(((uint64_t)us * MFRC522_FC_KHZ + 999) / 1000);
+    uint32_t prescaler = ((cycles + 0xFFFE) / 0xFFFF) / 2;
+    uint32_t reload;
+
+    if (prescaler > 0xFFF) {
+        prescaler = 0xFFF;
+    }
+    reload = (cycles + 2 * prescaler) / (2 * prescaler + 1);
+    if (reload == 0) {
+        reload = 1;
+    } else if (reload > 0xFFFF) {
+        reload = 0xFFFF;
+    }
+
+    seq_update(mdp, MFRC522_TModeReg,
+               MFRC522_TModeReg_TAuto | (uint8_t)(prescaler >> 8));
+    seq_update(mdp, MFRC522_TPrescalerReg, (uint8_t)prescaler);
+    seq_update(mdp, MFRC522_TReloadRegH, (uint8_t)(reload >> 8));
+    seq_update(mdp, MFRC522_TReloadRegL, (uint8_t)reload);
+}
+
+/**
+ * @brief   Appends the CRC_A settings, keeping the bit rate.
+ */
+static void seq_crc(MFRC522Driver *mdp, bool tx, bool rx) {
+    uint8_t txmode = mdp->shadow[MFRC522_TxModeReg - MFRC522_SHADOW_BASE];
+    uint8_t rxmode = mdp->shadow[MFRC522_RxModeReg - MFRC522_SHADOW_BASE];
+
+    txmode = (uint8_t)((txmode & ~MFRC522_TxModeReg_TxCRCEn) |
+                       (tx ? MFRC522_TxModeReg_TxCRCEn : 0));
+    rxmode = (uint8_t)((rxmode & ~MFRC522_RxModeReg_RxCRCEn) |
+                       (rx ? MFRC522_RxModeReg_RxCRCEn : 0));
+    seq_update(mdp, MFRC522_TxModeReg, txmode);
+    seq_update(mdp, MFRC522_RxModeReg, rxmode);
+}
+
+/**
+ * @brief   Waits until the running command completes.
+ * @details Sleeps on the IRQ line, or busy-polls @p ComIrqReg if
+ *          @p MFRC522_USE_IRQ is disabled.
+ *
+ * @return  @p false if the command did not complete within @p timeout.
+ */
+static bool wait_command(MFRC522Driver *mdp, uint32_t timeout) {
+#if MFRC522_USE_IRQ
+    /* The chip only interrupts on completion. */
+    if (mdp->config->transport->waitIrq(mdp->config->ctx, timeout)) {
+        return true;
+    }
+#else
+    uint32_t start = platformNowUs();
+
+    do {
+        if ((mfrc522ReadRegister(mdp, MFRC522_ComIrqReg) & COMMAND_DONE) != 0) {
+            return true;
+        }
+    } while (platformElapsedUs(start) < timeout);
+#endif
+
+    /* Missed edge or a late completion. */
+    return (mfrc522ReadRegister(mdp, MFRC522_ComIrqReg) & COMMAND_DONE) != 0;
+}
+
+/**
+ * @brief   Reads the completion status and up to @p n bytes of FIFO data in
+ *          a single transfer.
+ * @details FIFO bytes beyond the FIFO level read as garbage and are ignored
+ *          by the caller.
+ */
+static void read_completion(MFRC522Driver *mdp, size_t n, uint8_t *status) {
+    static const uint8_t regs[STATUS_COUNT] = {
+        MFRC522_ComIrqReg, MFRC522_ErrorReg, MFRC522_FIFOLevelReg,
+        MFRC522_ControlReg, MFRC522_CollReg
+    };
+    size_t i;
+
+    for (i = 0; i < STATUS_COUNT; i++) {
+        mdp->buf[i] = MFRC522_SPI_READ | MFRC522_SPI_ADDR(regs[i]);
+    }
+    memset(&mdp->buf[STATUS_COUNT],
+           MFRC522_SPI_READ | MFRC522_SPI_ADDR(MFRC522_FIFODataReg), n);
+    mdp->buf[STATUS_COUNT + n] = 0x00;
+    exchange(mdp, STATUS_COUNT + n + 1, mdp->buf, mdp->buf);
+    memcpy(status, &mdp->buf[1], STATUS_COUNT);
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Initializes the driver structure.
+ */
+void mfrc522ObjectInit(MFRC522Driver *mdp) {
+    memset(mdp, 0, sizeof(*mdp));
+    mdp->state = MFRC522_STOP;
+}
+
+/**
+ * @brief   Resets and configures the chip.
+ * @details The RF field is left off.
+ *
+ * @return  @p MFRC522_NO_DEVICE if the chip does not come out of reset.
+ */
+mfrc522result_t mfrc522Start(MFRC522Driver *mdp, const MFRC522Config *config) {
+    uint32_t start;
+
+    mdp->config = config;
+    mdp->shadowValid = 0;
+    mdp->seqlen = 0;
+
+    config->transport->setReset(config->ctx, true);
+    platformDelayUs(1);
+    config->transport->setReset(config->ctx, false);
+
+    /* PowerDown stays set until the oscillator is running. */
+    start = platformNowUs();
+    while (true) {
+        uint8_t command = mfrc522ReadRegister(mdp, MFRC522_CommandReg);
+
+        if (command != 0xFF && (command & MFRC522_CommandReg_PowerDown) == 0) {
+            break;
+        }
+        if (platformElapsedUs(start) > STARTUP_TIMEOUT_US) {
+            mdp->state = MFRC522_STOP;
+            return MFRC522_NO_DEVICE;
+        }
+        platformDelayUs(10);
+    }
+
+    mdp->version = mfrc522ReadRegister(mdp, MFRC522_VersionReg);
+    if (mdp->version == 0x00 || mdp->version == 0xFF) {
+        mdp->state = MFRC522_STOP;
+        return MFRC522_NO_DEVICE;
+    }
+
+    mfrc522RunSequence(mdp, init_sequence);
+
+    mdp->state = MFRC522_READY;
+    return MFRC522_OK;
+}
+
+/**
+ * @brief   Puts the chip in hard power-down.
+ */
+void mfrc522Stop(MFRC522Driver *mdp) {
+    mdp->config->transport->setReset(mdp->config->ctx, true);
+    mdp->shadowValid = 0;
+    mdp->state = MFRC522_STOP;
+}
+
+/**
+ * @brief   Reads a single register.
+ */
+uint8_t mfrc522ReadRegister(MFRC522Driver *mdp, uint8_t reg) {
+    uint8_t tx[2] = {MFRC522_SPI_READ | MFRC522_SPI_ADDR(reg), 0x00};
+    uint8_t rx[2];
+
+    exchange(mdp, sizeof(tx), tx, rx);
+    return rx[1];
+}
+
+/**
+ * @brief   Reads @p n registers in a single transfer.
+ */
+void mfrc522ReadRegisters(MFRC522Driver *mdp, size_t n, const uint8_t *regs,
+                          uint8_t *values) {
+    size_t i;
+
+    if (n == 0 || n >= sizeof(mdp->buf)) {
+        return;
+    }
+
+    /* Every byte sent is the address to read next, the last one is a dummy. */
+    for (i = 0; i < n; i++) {
+        mdp->buf[i] = MFRC522_SPI_READ | MFRC522_SPI_ADDR(regs[i]);
+    }
+    mdp->buf[n] = 0x00;
+    exchange(mdp, n + 1, mdp->buf, mdp->buf);
+    memcpy(values, &mdp->buf[1], n);
+}
+
+/**
+ * @brief   Writes a single register.
+ */
+void mfrc522WriteRegister(MFRC522Driver *mdp, uint8_t reg, uint8_t value) {
+    uint8_t tx[2] = {MFRC522_SPI_ADDR(reg), value};
+
+    exchange(mdp, sizeof(tx), tx, NULL);
+    shadow_store(mdp, reg, value);
+}
+
+/**
+ * @brief   Performs the register writes of a sequence.
+ * @details The transfers go out back to back under one bus acquisition if
+ *          the transport supports it.
+ */
+void mfrc522RunSequence(MFRC522Driver *mdp, const uint8_t *seq) {
+    const MFRC522Transport *transport = mdp->config->transport;
+    const uint8_t *p;
+
+    for (p = seq; *p != MFRC522_SEQ_END; p += *p + 1) {
+        if (*p == 2) {
+            shadow_store(mdp, MFRC522_SPI_REG(p[1]), p[2]);
+        }
+        mdp->stats.transactions++;
+        mdp->stats.bytes += *p;
+        if (transport->exchangeSequence == NULL) {
+            mdp->stats.acquisitions++;
+            transport->exchange(mdp->config->ctx, *p, p + 1, NULL);
+        }
+    }
+    if (transport->exchangeSequence != NULL) {
+        mdp->stats.acquisitions++;
+        transport->exchangeSequence(mdp->config->ctx, seq);
+    }
+}
+
+/**
+ * @brief   Reads @p n bytes from the FIFO in a single transfer.
+ */
+void mfrc522ReadFifo(MFRC522Driver *mdp, size_t n, uint8_t *buf) {
+    if (n == 0 || n > MFRC522_FIFO_SIZE) {
+        return;
+    }
+
+    memset(mdp->buf, MFRC522_SPI_READ | MFRC522_SPI_ADDR(MFRC522_FIFODataReg), n);
+    mdp->buf[n] = 0x00;
+    exchange(mdp, n + 1, mdp->buf, mdp->buf);
+    memcpy(buf, &mdp->buf[1], n);
+}
+
+/**
+ * @brief   Writes @p n bytes to the FIFO in a single transfer.
+ */
+void mfrc522WriteFifo(MFRC522Driver *mdp, size_t n, const uint8_t *buf) {
+    if (n == 0 || n > MFRC522_FIFO_SIZE) {
+        return;
+    }
+
+    mdp->buf[0] = MFRC522_SPI_ADDR(MFRC522_FIFODataReg);
+    memcpy(&mdp->buf[1], buf, n);
+    exchange(mdp, n + 1, mdp->buf, NULL);
+}
+
+/**
+ * @brief   Switches the RF field on both antenna drivers.
+ */
+void mfrc522SetField(MFRC522Driver *mdp, bool on) {
+    const uint8_t bits = MFRC522_TxControlReg_Tx1RFEn |
+                         MFRC522_TxControlReg_Tx2RFEn;
+    uint8_t value = mdp->shadow[MFRC522_TxControlReg - MFRC522_SHADOW_BASE];
+
+    value = (uint8_t)((value & ~bits) | (on ? bits : 0));
+    seq_update(mdp, MFRC522_TxControlReg, value);
+    seq_run(mdp);
+}
+
+/**
+ * @brief   Enters or leaves the soft power-down.
+ * @details The analog part, the RF field included, is off in soft
+ *          power-down while the registers keep their content. Leaving it
+ *          waits for the oscillator, polling @p CommandReg as sleeping
+ *          would take longer than the start-up itself.
+ *
+ * @return  @p MFRC522_NO_DEVICE if the oscillator did not start.
+ */
+mfrc522result_t mfrc522SetPowerDown(MFRC522Driver *mdp, bool on) {
+    uint32_t start;
+
+    if (on) {
+        mfrc522WriteRegister(mdp, MFRC522_CommandReg,
+                             MFRC522_CommandReg_PowerDown | MFRC522_CMD_IDLE);
+        return MFRC522_OK;
+    }
+
+    mfrc522WriteRegister(mdp, MFRC522_CommandReg, MFRC522_CMD_IDLE);
+    start = platformNowUs();
+    while ((mfrc522ReadRegister(mdp, MFRC522_CommandReg) &
+            MFRC522_CommandReg_PowerDown) != 0) {
+        if (platformElapsedUs(start) > STARTUP_TIMEOUT_US) {
+            return MFRC522_NO_DEVICE;
+        }
+    }
+    return MFRC522_OK;
+}
+
+/**
+ * @brief   Enables the CRC_A generation on transmit and check on receive.
+ */
+void mfrc522SetCrc(MFRC522Driver *mdp, bool tx, bool rx) {
+    seq_crc(mdp, tx, rx);
+    seq_run(mdp);
+}
+
+/**
+ * @brief   Sets the bit rates towards the card and from the card.
+ * @details The modulation width follows the transmit bit rate.
+ *
+ * @param[in] tx        @p MFRC522_BITRATE_106 to @p MFRC522_BITRATE_848.
+ * @param[in] rx        Same for the receiver.
+ */
+void mfrc522SetBitRate(MFRC522Driver *mdp, uint8_t tx, uint8_t rx) {
+    static const uint8_t modwidth[] = {0x26, 0x15, 0x0A, 0x05};
+    uint8_t txmode = mdp->shadow[MFRC522_TxModeReg - MFRC522_SHADOW_BASE];
+    uint8_t rxmode = mdp->shadow[MFRC522_RxModeReg - MFRC522_SHADOW_BASE];
+
+    txmode = (uint8_t)((txmode & ~MFRC522_ModeReg_SpeedMask) |
+                       MFRC522_ModeReg_Speed(tx));
+    rxmode = (uint8_t)((rxmode & ~MFRC522_ModeReg_SpeedMask) |
+                       MFRC522_ModeReg_Speed(rx));
+    seq_update(mdp, MFRC522_TxModeReg, txmode);
+    seq_update(mdp, MFRC522_RxModeReg, rxmode);
+    seq_update(mdp, MFRC522_ModWidthReg, modwidth[tx & 0x03]);
+    seq_run(mdp);
+}
+
+/**
+ * @brief   Transmits a frame and receives the response.
+ * @details The whole set-up goes out as one register sequence, the chip
+ *          timer enforces the frame waiting time in @p xfer->timeout while
+ *          the calling thread sleeps until the chip raises its IRQ line, and
+ *          the status is read back together with the response.
+ *
+ * @return  The received data is stored even if @p MFRC522_COLLISION is
+ *          returned, @p xfer->collpos then holds the first collision.
+ */
+mfrc522result_t mfrc522Transceive(MFRC522Driver *mdp, MFRC522Transfer *xfer) {
+    uint8_t status[STATUS_COUNT];
+    size_t level, want;
+    mfrc522result_t result = MFRC522_OK;
+
+    xfer->rxlen = 0;
+    xfer->rxbits = 0;
+    xfer->collpos = 0;
+    if (xfer->setup == NULL && xfer->txlen > MFRC522_FIFO_SIZE) {
+        return MFRC522_OVERFLOW;
+    }
+    mdp->stats.frames++;
+
+    seq_crc(mdp, xfer->crc, xfer->crc);
+    seq_timer(mdp, xfer->timeout);
+    if (xfer->setup != NULL) {
+        seq_run(mdp);
+        mfrc522RunSequence(mdp, xfer->setup);
+    } else {
+        seq_write(mdp, MFRC522_CommandReg, MFRC522_CMD_IDLE);
+        seq_write(mdp, MFRC522_ComIrqReg, (uint8_t)~MFRC522_ComIrqReg_Set1);
+        seq_write(mdp, MFRC522_FIFOLevelReg, MFRC522_FIFOLevelReg_FlushBuffer);
+        seq_fifo(mdp, xfer->txlen, xfer->txbuf);
+        seq_write(mdp, MFRC522_CommandReg, MFRC522_CMD_TRANSCEIVE);
+        seq_write(mdp, MFRC522_BitFramingReg,
+                  MFRC522_BitFramingReg_StartSend |
+                  MFRC522_BitFramingReg_RxAlign(xfer->rxalign) |
+                  (xfer->txbits & MFRC522_BitFramingReg_TxLastBits));
+        seq_run(mdp);
+    }
+
+    if (!wait_command(mdp, xfer->timeout + MFRC522_IRQ_MARGIN_US +
+                              (uint32_t)xfer->txlen * BYTE_AIR_TIME_US)) {
+        return MFRC522_TIMEOUT;
+    }
+
+    /* The FIFO holds at most MFRC522_FIFO_SIZE bytes, so reading as much as
+       the buffer takes gets the whole response in the same transfer. */
+    want = xfer->rxsize < MFRC522_FIFO_SIZE ? xfer->rxsize : MFRC522_FIFO_SIZE;
+    read_completion(mdp, want, status);
+    if ((status[STATUS_COMIRQ] & MFRC522_ComIrqReg_RxIRq) == 0) {
+        return MFRC522_TIMEOUT;
+    }
+
+    if ((status[STATUS_ERROR] & MFRC522_ErrorReg_BufferOvfl) != 0) {
+        result = MFRC522_OVERFLOW;
+    } else if ((status[STATUS_ERROR] & MFRC522_ErrorReg_CollErr) != 0) {
+        if ((status[STATUS_COLL] & MFRC522_CollReg_CollPosNotValid) == 0) {
+            xfer->collpos = status[STATUS_COLL] & MFRC522_CollReg_CollPos;
+            if (xfer->collpos == 0) {
+                xfer->collpos = 32;
+            }
+        }
+        result = MFRC522_COLLISION;
+    } else if ((status[STATUS_ERROR] & (MFRC522_ErrorReg_ParityErr |
+                                        MFRC522_ErrorReg_ProtocolErr)) != 0) {
+        result = MFRC522_PROTOCOL_ERROR;
+    } else if ((status[STATUS_ERROR] & MFRC522_ErrorReg_CRCErr) != 0) {
+        result = MFRC522_CRC_ERROR;
+    }
+
+    level = status[STATUS_FIFOLEVEL] & MFRC522_FIFOLevelReg_Level;
+    if (level > want) {
+        level = want;
+        result = MFRC522_OVERFLOW;
+    }
+    if (level > 0) {
+        uint8_t mask = (uint8_t)(0xFF << xfer->rxalign);
+        uint8_t first = xfer->rxbuf[0];
+
+        memcpy(xfer->rxbuf, &mdp->buf[1 + STATUS_COUNT], level);
+        /* Bits below the alignment were sent by us, not received. */
+        xfer->rxbuf[0] = (uint8_t)((first & ~mask) | (xfer->rxbuf[0] & mask));
+    }
+    xfer->rxlen = level;
+    xfer->rxbits = status[STATUS_CONTROL] & MFRC522_ControlReg_RxLastBits;
+
+    return result;
+}
+
+/**
+ * @brief   Authenticates to a MIFARE Classic sector.
+ * @details Runs MFAuthent with the key and the first four bytes of the UID
+ *          of the selected card. On success the chip encrypts all further
+ *          traffic with the card, until @p mfrc522StopCrypto().
+ *
+ * @param[in] keycmd    @p MFRC522_MF_AUTH_KEY_A or @p MFRC522_MF_AUTH_KEY_B.
+ * @param[in] block     Any block of the sector.
+ * @param[in] key       Six key bytes.
+ * @param[in] uid       First four UID bytes.
+ * @return  @p MFRC522_AUTH_ERROR if the card did not accept the key.
+ */
+mfrc522result_t mfrc522Authenticate(MFRC522Driver *mdp, uint8_t keycmd,
+                                    uint8_t block, const uint8_t *key,
+                                    const uint8_t *uid) {
+    static const uint8_t regs[] = {MFRC522_ComIrqReg, MFRC522_Status2Reg};
+    uint8_t request[12];
+    uint8_t status[sizeof(regs)];
+
+    request[0] = keycmd;
+    request[1] = block;
+    memcpy(&request[2], key, 6);
+    memcpy(&request[8], uid, 4);
+
+    seq_timer(mdp, MFRC522_AUTH_TIMEOUT_US);
+    seq_write(mdp, MFRC522_CommandReg, MFRC522_CMD_IDLE);
+    seq_write(mdp, MFRC522_ComIrqReg, (uint8_t)~MFRC522_ComIrqReg_Set1);
+    seq_write(mdp, MFRC522_FIFOLevelReg, MFRC522_FIFOLevelReg_FlushBuffer);
+    seq_fifo(mdp, sizeof(request), request);
+    seq_write(mdp, MFRC522_CommandReg, MFRC522_CMD_MF_AUTHENT);
+    seq_run(mdp);
+
+    if (!wait_command(mdp, MFRC522_AUTH_TIMEOUT_US + MFRC522_IRQ_MARGIN_US)) {
+        return MFRC522_TIMEOUT;
+    }
+    mfrc522ReadRegisters(mdp, sizeof(regs), regs, status);
+    if ((status[1] & MFRC522_Status2Reg_MFCrypto1On) != 0) {
+        return MFRC522_OK;
+    }
+    return (status[0] & MFRC522_ComIrqReg_TimerIRq) != 0 ? MFRC522_TIMEOUT
+                                                         : MFRC522_AUTH_ERROR;
+}
+
+/**
+ * @brief   Reads @p MFRC522_RANDOM_SIZE bytes of the chip's random number
+ *          generator.
+ * @details The generator fills the internal buffer, which is copied to the
+ *          FIFO and read from there. The field is not touched.
+ *
+ * @return  @p MFRC522_TIMEOUT if the generator did not complete.
+ */
+mfrc522result_t mfrc522Random(MFRC522Driver *mdp, uint8_t *buf) {
+    seq_write(mdp, MFRC522_CommandReg, MFRC522_CMD_IDLE);
+    seq_write(mdp, MFRC522_ComIrqReg, (uint8_t)~MFRC522_ComIrqReg_Set1);
+    seq_write(mdp, MFRC522_CommandReg, MFRC522_CMD_GENERATE_RANDOM);
+    seq_run(mdp);
+
+    if (!wait_command(mdp, RANDOM_TIMEOUT_US)) {
+        return MFRC522_TIMEOUT;
+    }
+    /* From an empty FIFO, Mem copies the buffer into it. */
+    seq_write(mdp, MFRC522_FIFOLevelReg, MFRC522_FIFOLevelReg_FlushBuffer);
+    seq_write(mdp, MFRC522_CommandReg, MFRC522_CMD_MEM);
+    seq_run(mdp);
+    if (mfrc522ReadRegister(mdp, MFRC522_FIFOLevelReg) != MEM_SIZE) {
+        return MFRC522_TIMEOUT;
+    }
+    mfrc522ReadFifo(mdp, MFRC522_RANDOM_SIZE, buf);
+    mfrc522WriteRegister(mdp, MFRC522_FIFOLevelReg,
+                         MFRC522_FIFOLevelReg_FlushBuffer);
+    return MFRC522_OK;
+}
+
+/**
+ * @brief   Ends the encrypted session with the card.
+ */
+void mfrc522StopCrypto(MFRC522Driver *mdp) {
+    mfrc522WriteRegister(mdp, MFRC522_Status2Reg, 0x00);
+}
@@ -0,0 +1,284 @@
+/**
+ * @file    mfrc522.h
+ * @brief   NXP MFRC522 contactless reader IC driver.
+ *
+ * @details The driver core does not touch the hardware itself. All chip
+ *          accesses go through a @p MFRC522Transport which provides
+ *          chip-select framed SPI transfers, waiting on the IRQ line and
+ *          control of the reset pin. The reader boards use the SPI/EXT based
+ *          transport from @p mfrc522_hw.h, the host build a simulated one.
+ *
+ *          Frame exchanges are interrupt driven: the chip timer is loaded
+ *          with the frame waiting time and the calling thread sleeps on the
+ *          IRQ line until the chip reports a received frame or a timeout.
+ *
+ *          Register writes are grouped into sequences (see
+ *          @p MFRC522_SEQ_WRITE()) which the transport sends back to back
+ *          under a single bus acquisition. Constant sequences, such as the
+ *          initialization table or the REQA set-up, are built at compile
+ *          time and live in flash. Registers which rarely change are
+ *          shadowed, so writing an unchanged value costs nothing.
+ */
+
+#ifndef _MFRC522_H_
+#define _MFRC522_H_
+
+#include "platform.h"
+#include "drivers/mfrc522_regs.h"
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Wait for frame completion on the IRQ line.
+ * @details If set to @p FALSE the driver busy-polls @p ComIrqReg instead,
+ *          which is only useful on boards without the IRQ line wired and for
+ *          comparison benchmarks.
+ */
+#if !defined(MFRC522_USE_IRQ) || defined(__DOXYGEN__)
+#define MFRC522_USE_IRQ             TRUE
+#endif
+
+/**
+ * @brief   Extra time given to the chip on top of the frame waiting time
+ *          before the driver gives up waiting for its interrupt.
+ */
+#if !defined(MFRC522_IRQ_MARGIN_US) || defined(__DOXYGEN__)
+#define MFRC522_IRQ_MARGIN_US       1000
+#endif
+
+/**
+ * @brief   Transfers up to this length are clocked out by the CPU instead of
+ *          by DMA, the DMA set-up costs more than it saves.
+ */
+#if !defined(MFRC522_SHORT_TRANSFER) || defined(__DOXYGEN__)
+#define MFRC522_SHORT_TRANSFER      4
+#endif
+
+/**
+ * @brief   Time a MIFARE card gets to complete the authentication.
+ */
+#if !defined(MFRC522_AUTH_TIMEOUT_US) || defined(__DOXYGEN__)
+#define MFRC522_AUTH_TIMEOUT_US     10000
+#endif
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/**
+ * @name    Bit rates of @p mfrc522SetBitRate()
+ * @{
+ */
+#define MFRC522_BITRATE_106         0
+#define MFRC522_BITRATE_212         1
+#define MFRC522_BITRATE_424         2
+#define MFRC522_BITRATE_848         3
+/** @} */
+
+/**
+ * @name    Key selection of @p mfrc522Authenticate()
+ * @{
+ */
+#define MFRC522_MF_AUTH_KEY_A       0x60
+#define MFRC522_MF_AUTH_KEY_B       0x61
+/** @} */
+
+/**
+ * @brief   Bytes returned by @p mfrc522Random().
+ */
+#define MFRC522_RANDOM_SIZE         10
+
+/**
+ * @name    Sequence encoding
+ * @details A sequence is a list of write transfers, each prefixed by its
+ *          length, terminated by @p MFRC522_SEQ_END.
+ * @{
+ */
+#define MFRC522_SEQ_WRITE(reg, value)   2, MFRC522_SPI_ADDR(reg), (value)
+#define MFRC522_SEQ_FIFO(n, ...)        ((n) + 1), MFRC522_SPI_ADDR(MFRC522_FIFODataReg), __VA_ARGS__
+#define MFRC522_SEQ_END                 0
+/** @} */
+
+/**
+ * @brief   Frames of a transceive set-up sequence: stop the running command,
+ *          clear the interrupts and flush the FIFO.
+ */
+#define MFRC522_SEQ_TRANSCEIVE_PROLOGUE                                     \
+    MFRC522_SEQ_WRITE(MFRC522_CommandReg, MFRC522_CMD_IDLE),                \
+    MFRC522_SEQ_WRITE(MFRC522_ComIrqReg, (uint8_t)~MFRC522_ComIrqReg_Set1), \
+    MFRC522_SEQ_WRITE(MFRC522_FIFOLevelReg, MFRC522_FIFOLevelReg_FlushBuffer)
+
+/**
+ * @brief   Frames of a transceive set-up sequence: start the transceive
+ *          command with @p txbits valid bits in the last byte.
+ */
+#define MFRC522_SEQ_TRANSCEIVE_START(txbits)                                \
+    MFRC522_SEQ_WRITE(MFRC522_CommandReg, MFRC522_CMD_TRANSCEIVE),          \
+    MFRC522_SEQ_WRITE(MFRC522_BitFramingReg,                                \
+                      MFRC522_BitFramingReg_StartSend | (txbits))
+
+/**
+ * @brief   Size of the sequence buffer of the driver.
+ */
+#define MFRC522_SEQ_SIZE            (MFRC522_FIFO_SIZE + 48)
+
+/**
+ * @brief   Registers from this address on are shadowed by the driver.
+ */
+#define MFRC522_SHADOW_BASE         0x10
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Driver state machine possible states.
+ */
+typedef enum {
+    MFRC522_UNINIT = 0,             /**< Not initialized.                   */
+    MFRC522_STOP = 1,               /**< Stopped.                           */
+    MFRC522_READY = 2,              /**< Ready.                             */
+} mfrc522state_t;
+
+/**
+ * @brief   Result of a driver operation.
+ */
+typedef enum {
+    MFRC522_OK = 0,                 /**< Operation completed.               */
+    MFRC522_TIMEOUT = -1,           /**< No frame within the waiting time.  */
+    MFRC522_COLLISION = -2,         /**< Bit collision in the received frame. */
+    MFRC522_CRC_ERROR = -3,         /**< Received frame failed CRC check.   */
+    MFRC522_PROTOCOL_ERROR = -4,    /**< Parity or SOF/framing error.       */
+    MFRC522_OVERFLOW = -5,          /**< Frame does not fit the buffer.     */
+    MFRC522_NO_DEVICE = -6,         /**< Chip does not respond.             */
+    MFRC522_AUTH_ERROR = -7,        /**< Card rejected the key.             */
+} mfrc522result_t;
+
+/**
+ * @brief   Bus and IRQ line access used by the driver.
+ */
+typedef struct {
+    /**
+     * @brief   Performs one chip-select framed full-duplex transfer.
+     */
+    void (*exchange)(void *ctx, size_t n, const uint8_t *txbuf, uint8_t *rxbuf);
+    /**
+     * @brief   Performs the write transfers of a sequence back to back under
+     *          one bus acquisition.
+     * @note    Optional, if @p NULL the driver issues the transfers one by one
+     *          through @p exchange.
+     */
+    void (*exchangeSequence)(void *ctx, const uint8_t *seq);
+    /**
+     * @brief   Sleeps until the IRQ line is asserted.
+     * @return  @p false if @p timeout microseconds elapsed first.
+     */
+    bool (*waitIrq)(void *ctx, uint32_t timeout);
+    /**
+     * @brief   Drives the hard power-down (NRSTPD) line.
+     */
+    void (*setReset)(void *ctx, bool asserted);
+} MFRC522Transport;
+
+/**
+ * @brief   Driver configuration structure.
+ */
+typedef struct {
+    const MFRC522Transport *transport;
+    void *ctx;                      /**< Passed to the transport functions. */
+} MFRC522Config;
+
+/**
+ * @brief   Bus usage counters.
+ */
+typedef struct {
+    uint32_t transactions;          /**< Chip-select framed transfers.      */
+    uint32_t bytes;                 /**< Bytes clocked over the bus.        */
+    uint32_t acquisitions;          /**< Transport calls, each taking the bus. */
+    uint32_t frames;                /**< Frames sent to the cards.          */
+} MFRC522Stats;
+
+/**
+ * @brief   One frame exchange with a PICC.
+ */
+typedef struct {
+    /**
+     * @brief   Pre-built set-up sequence, used instead of @p txbuf.
+     * @details Must load the FIFO and start the command, typically built from
+     *          @p MFRC522_SEQ_TRANSCEIVE_PROLOGUE, @p MFRC522_SEQ_FIFO() and
+     *          @p MFRC522_SEQ_TRANSCEIVE_START().
+     */
+    const uint8_t *setup;
+    const uint8_t *txbuf;           /**< Frame to transmit.                 */
+    size_t txlen;                   /**< Bytes in @p txbuf, including a partial last byte. */
+    uint8_t txbits;                 /**< Valid bits in the last byte, 0 means 8. */
+    uint8_t rxalign;                /**< Bit position of the first received bit. */
+    bool crc;                       /**< Append CRC_A, check and strip it on receive. */
+    uint8_t *rxbuf;                 /**< Buffer for the response.           */
+    size_t rxsize;                  /**< Size of @p rxbuf, read together with the status. */
+    uint32_t timeout;               /**< Frame waiting time in microseconds. */
+    size_t rxlen;                   /**< Out: bytes received, including a partial last byte. */
+    uint8_t rxbits;                 /**< Out: valid bits in the last byte, 0 means 8. */
+    uint8_t collpos;                /**< Out: 1-based position of the first collision,
+                                         counted from bit 0 of @p rxbuf[0]. */
+} MFRC522Transfer;
+
+/**
+ * @brief   Driver structure.
+ */
+typedef struct {
+    mfrc522state_t state;
+    const MFRC522Config *config;
+    uint8_t version;                /**< Content of @p VersionReg.          */
+    MFRC522Stats stats;
+    /**
+     * @brief   Last written values of the registers from
+     *          @p MFRC522_SHADOW_BASE on.
+     */
+    uint8_t shadow[MFRC522_REGISTER_COUNT - MFRC522_SHADOW_BASE];
+    uint64_t shadowValid;
+    size_t seqlen;
+    /**
+     * @brief   Sequence being built.
+     */
+    uint8_t seq[MFRC522_SEQ_SIZE];
+    /**
+     * @brief   Bounce buffer for reads (status registers + FIFO).
+     */
+    uint8_t buf[MFRC522_FIFO_SIZE + 8];
+} MFRC522Driver;
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void mfrc522ObjectInit(MFRC522Driver *mdp);
+  mfrc522result_t mfrc522Start(MFRC522Driver *mdp, const MFRC522Config *config);
+  void mfrc522Stop(MFRC522Driver *mdp);
+  uint8_t mfrc522ReadRegister(MFRC522Driver *mdp, uint8_t reg);
+  void mfrc522WriteRegister(MFRC522Driver *mdp, uint8_t reg, uint8_t value);
+  void mfrc522ReadRegisters(MFRC522Driver *mdp, size_t n, const uint8_t *regs,
+                            uint8_t *values);
+  void mfrc522RunSequence(MFRC522Driver *mdp, const uint8_t *seq);
+  void mfrc522ReadFifo(MFRC522Driver *mdp, size_t n, uint8_t *buf);
+  void mfrc522WriteFifo(MFRC522Driver *mdp, size_t n, const uint8_t *buf);
+  void mfrc522SetField(MFRC522Driver *mdp, bool on);
+  mfrc522result_t mfrc522SetPowerDown(MFRC522Driver *mdp, bool on);
+  void mfrc522SetCrc(MFRC522Driver *mdp, bool tx, bool rx);
+  void mfrc522SetBitRate(MFRC522Driver *mdp, uint8_t tx, uint8_t rx);
+  mfrc522result_t mfrc522Transceive(MFRC522Driver *mdp, MFRC522Transfer *xfer);
+  mfrc522result_t mfrc522Authenticate(MFRC522Driver *mdp, uint8_t keycmd,
+                                      uint8_t block, const uint8_t *key,
+                                      const uint8_t *uid);
+  void mfrc522StopCrypto(MFRC522Driver *mdp);
+  mfrc522result_t mfrc522Random(MFRC522Driver *mdp, uint8_t *buf);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _MFRC522_H_ */
@@ -0,0 +1,150 @@
+/**
+ * @file    mfrc522_hw.c
+ * @brief   MFRC522 transport over SPI1 and the RFID_IRQ EXT line.
+ * @details SPI transfers are done by the SPI driver with DMA, so the calling
+ *          thread sleeps while a transfer is in flight. Transfers of up to
+ *          @p MFRC522_SHORT_TRANSFER bytes (single register accesses) are
+ *          clocked out polled, which is faster than setting up the DMA and
+ *          waking up again. The chip IRQ line wakes the waiting thread from
+ *          the EXT callback, or a platform timer once the timeout passes.
+ */
+
+#include "ch.h"
+#include "hal.h"
+
+#include "drivers/mfrc522_hw.h"
+
+MFRC522Driver MFRC522D1;
+
+/**
+ * @brief   Thread waiting for the rising edge of the IRQ line.
+ */
+static thread_reference_t irq_thread;
+
+static void irq_cb(EXTDriver *extp, expchannel_t channel) {
+    (void)extp;
+    (void)channel;
+
+    chSysLockFromISR();
+    chThdResumeI(&irq_thread, MSG_OK);
+    chSysUnlockFromISR();
+}
+
+static void irq_timeout(void *arg) {
+    (void)arg;
+
+    chThdResumeI(&irq_thread, MSG_TIMEOUT);
+}
+
+/*
+ * SPI mode 0, 8 bit frames, 48 MHz / 8 = 6 MHz (the chip allows 10 MHz).
+ */
+static const SPIConfig spicfg = {
+    NULL,
+    GPIOA,
+    GPIOA_RFID_SS,
+    SPI_CR1_BR_1,
+    SPI_CR2_DS_2 | SPI_CR2_DS_1 | SPI_CR2_DS_0
+};
+
+static const EXTConfig extcfg = {
+    {
+        [GPIOA_RFID_IRQ] = {EXT_CH_MODE_RISING_EDGE | EXT_CH_MODE_AUTOSTART |
+                            EXT_MODE_GPIOA, irq_cb},
+    }
+};
+
+/**
+ * @brief   One chip-select framed transfer, the bus must be acquired.
+ */
+static void transfer(SPIDriver *spip, size_t n, const uint8_t *txbuf,
+                     uint8_t *rxbuf) {
+    spiSelect(spip);
+    if (n <= MFRC522_SHORT_TRANSFER) {
+        size_t i;
+
+        for (i = 0; i < n; i++) {
+            uint8_t data = (uint8_t)spiPolledExchange(spip, txbuf[i]);
+
+            if (rxbuf != NULL) {
+                rxbuf[i] = data;
+            }
+        }
+    } else if (rxbuf != NULL) {
+        spiExchange(spip, n, txbuf, rxbuf);
+    } else {
+        spiSend(spip, n, txbuf);
+    }
+    spiUnselect(spip);
+}
+
+static void hw_exchange(void *ctx, size_t n, const uint8_t *txbuf,
+                        uint8_t *rxbuf) {
+    SPIDriver *spip = ctx;
+
+    spiAcquireBus(spip);
+    transfer(spip, n, txbuf, rxbuf);
+    spiReleaseBus(spip);
+}
+
+static void hw_exchange_sequence(void *ctx, const uint8_t *seq) {
+    SPIDriver *spip = ctx;
+
+    spiAcquireBus(spip);
+    for (; *seq != MFRC522_SEQ_END; seq += *seq + 1) {
+        transfer(spip, *seq, seq + 1, NULL);
+    }
+    spiReleaseBus(spip);
+}
+
+static bool hw_wait_irq(void *ctx, uint32_t timeout) {
+    PlatformTimer timer;
+    msg_t msg;
+
+    (void)ctx;
+
+    chSysLock();
+    /* Edges seen before this call are stale, the level is what counts. */
+    if (palReadPad(GPIOA, GPIOA_RFID_IRQ) == PAL_HIGH) {
+        chSysUnlock();
+        return true;
+    }
+    platformTimerStartI(&timer, timeout, irq_timeout, NULL);
+    msg = chThdSuspendS(&irq_thread);
+    platformTimerStopI(&timer);
+    chSysUnlock();
+
+    return msg == MSG_OK;
+}
+
+static void hw_set_reset(void *ctx, bool asserted) {
+    (void)ctx;
+
+    if (asserted) {
+        palClearPad(GPIOA, GPIOA_RFID_RST);
+    } else {
+        palSetPad(GPIOA, GPIOA_RFID_RST);
+    }
+}
+
+static const MFRC522Transport hw_transport = {
+    hw_exchange,
+    hw_exchange_sequence,
+    hw_wait_irq,
+    hw_set_reset
+};
+
+const MFRC522Config mfrc522HwConfig = {
+    &hw_transport,
+    &SPID1
+};
+
+/**
+ * @brief   Starts SPI1 and the IRQ line and initializes @p MFRC522D1.
+ * @note    The EXT driver is owned by this module.
+ */
+void mfrc522HwInit(void) {
+    spiStart(&SPID1, &spicfg);
+    extStart(&EXTD1, &extcfg);
+    mfrc522ObjectInit(&MFRC522D1);
+}
@@ -0,0 +1,29 @@
+/**
+ * @file    mfrc522_hw.h
+ * @brief   MFRC522 transport over SPI1 and the RFID_IRQ EXT line.
+ */
+
+#ifndef _MFRC522_HW_H_
+#define _MFRC522_HW_H_
+
+#include "drivers/mfrc522.h"
+
+/**
+ * @brief   RFID front-end of the board.
+ */
+extern MFRC522Driver MFRC522D1;
+
+/**
+ * @brief   Configuration binding @p MFRC522D1 to the board transport.
+ */
+extern const MFRC522Config mfrc522HwConfig;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void mfrc522HwInit(void);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _MFRC522_HW_H_ */
@@ -0,0 +1,194 @@
+/**
+ * @file    mfrc522_regs.h
+ * @brief   NXP MFRC522 register map, bit definitions and command set.
+ * @details Names follow the MFRC522 datasheet (Rev. 3.9), section 9.
+ */
+
+#ifndef _MFRC522_REGS_H_
+#define _MFRC522_REGS_H_
+
+/**
+ * @name    Register addresses
+ * @{
+ */
+/* Page 0: command and status */
+#define MFRC522_CommandReg          0x01
+#define MFRC522_ComIEnReg           0x02
+#define MFRC522_DivIEnReg           0x03
+#define MFRC522_ComIrqReg           0x04
+#define MFRC522_DivIrqReg           0x05
+#define MFRC522_ErrorReg            0x06
+#define MFRC522_Status1Reg          0x07
+#define MFRC522_Status2Reg          0x08
+#define MFRC522_FIFODataReg         0x09
+#define MFRC522_FIFOLevelReg        0x0A
+#define MFRC522_WaterLevelReg       0x0B
+#define MFRC522_ControlReg          0x0C
+#define MFRC522_BitFramingReg       0x0D
+#define MFRC522_CollReg             0x0E
+/* Page 1: command */
+#define MFRC522_ModeReg             0x11
+#define MFRC522_TxModeReg           0x12
+#define MFRC522_RxModeReg           0x13
+#define MFRC522_TxControlReg        0x14
+#define MFRC522_TxASKReg            0x15
+#define MFRC522_TxSelReg            0x16
+#define MFRC522_RxSelReg            0x17
+#define MFRC522_RxThresholdReg      0x18
+#define MFRC522_DemodReg            0x19
+#define MFRC522_MfTxReg             0x1C
+#define MFRC522_MfRxReg             0x1D
+#define MFRC522_SerialSpeedReg      0x1F
+/* Page 2: configuration */
+#define MFRC522_CRCResultRegH       0x21
+#define MFRC522_CRCResultRegL       0x22
+#define MFRC522_ModWidthReg         0x24
+#define MFRC522_RFCfgReg            0x26
+#define MFRC522_GsNReg              0x27
+#define MFRC522_CWGsPReg            0x28
+#define MFRC522_ModGsPReg           0x29
+#define MFRC522_TModeReg            0x2A
+#define MFRC522_TPrescalerReg       0x2B
+#define MFRC522_TReloadRegH         0x2C
+#define MFRC522_TReloadRegL         0x2D
+#define MFRC522_TCounterValRegH     0x2E
+#define MFRC522_TCounterValRegL     0x2F
+/* Page 3: test */
+#define MFRC522_TestSel1Reg         0x31
+#define MFRC522_TestSel2Reg         0x32
+#define MFRC522_TestPinEnReg        0x33
+#define MFRC522_TestPinValueReg     0x34
+#define MFRC522_TestBusReg          0x35
+#define MFRC522_AutoTestReg         0x36
+#define MFRC522_VersionReg          0x37
+#define MFRC522_AnalogTestReg       0x38
+#define MFRC522_TestDAC1Reg         0x39
+#define MFRC522_TestDAC2Reg         0x3A
+#define MFRC522_TestADCReg          0x3B
+
+#define MFRC522_REGISTER_COUNT      0x40
+/** @} */
+
+/**
+ * @name    SPI address byte
+ * @{
+ */
+#define MFRC522_SPI_READ            0x80
+#define MFRC522_SPI_ADDR(reg)       ((uint8_t)(((reg) << 1) & 0x7E))
+#define MFRC522_SPI_REG(addr)       ((uint8_t)(((addr) & 0x7E) >> 1))
+/** @} */
+
+/**
+ * @name    Commands (CommandReg[3:0])
+ * @{
+ */
+#define MFRC522_CMD_IDLE            0x00
+#define MFRC522_CMD_MEM             0x01
+#define MFRC522_CMD_GENERATE_RANDOM 0x02
+#define MFRC522_CMD_CALC_CRC        0x03
+#define MFRC522_CMD_TRANSMIT        0x04
+#define MFRC522_CMD_NO_CMD_CHANGE   0x07
+#define MFRC522_CMD_RECEIVE         0x08
+#define MFRC522_CMD_TRANSCEIVE      0x0C
+#define MFRC522_CMD_MF_AUTHENT      0x0E
+#define MFRC522_CMD_SOFT_RESET      0x0F
+#define MFRC522_CMD_MASK            0x0F
+/** @} */
+
+/**
+ * @name    Register bits
+ * @{
+ */
+#define MFRC522_CommandReg_RcvOff       0x20
+#define MFRC522_CommandReg_PowerDown    0x10
+
+#define MFRC522_ComIEnReg_IRqInv        0x80
+#define MFRC522_ComIEnReg_TxIEn         0x40
+#define MFRC522_ComIEnReg_RxIEn         0x20
+#define MFRC522_ComIEnReg_IdleIEn       0x10
+#define MFRC522_ComIEnReg_HiAlertIEn    0x08
+#define MFRC522_ComIEnReg_LoAlertIEn    0x04
+#define MFRC522_ComIEnReg_ErrIEn        0x02
+#define MFRC522_ComIEnReg_TimerIEn      0x01
+
+#define MFRC522_DivIEnReg_IRQPushPull   0x80
+#define MFRC522_DivIEnReg_MfinActIEn    0x10
+#define MFRC522_DivIEnReg_CRCIEn        0x04
+
+#define MFRC522_ComIrqReg_Set1          0x80
+#define MFRC522_ComIrqReg_TxIRq         0x40
+#define MFRC522_ComIrqReg_RxIRq         0x20
+#define MFRC522_ComIrqReg_IdleIRq       0x10
+#define MFRC522_ComIrqReg_HiAlertIRq    0x08
+#define MFRC522_ComIrqReg_LoAlertIRq    0x04
+#define MFRC522_ComIrqReg_ErrIRq        0x02
+#define MFRC522_ComIrqReg_TimerIRq      0x01
+
+#define MFRC522_DivIrqReg_Set2          0x80
+#define MFRC522_DivIrqReg_MfinActIRq    0x10
+#define MFRC522_DivIrqReg_CRCIRq        0x04
+
+#define MFRC522_ErrorReg_WrErr          0x80
+#define MFRC522_ErrorReg_TempErr        0x40
+#define MFRC522_ErrorReg_BufferOvfl     0x10
+#define MFRC522_ErrorReg_CollErr        0x08
+#define MFRC522_ErrorReg_CRCErr         0x04
+#define MFRC522_ErrorReg_ParityErr      0x02
+#define MFRC522_ErrorReg_ProtocolErr    0x01
+
+#define MFRC522_Status1Reg_CRCOk        0x40
+#define MFRC522_Status1Reg_CRCReady     0x20
+#define MFRC522_Status1Reg_IRq          0x10
+#define MFRC522_Status1Reg_TRunning     0x08
+#define MFRC522_Status1Reg_HiAlert      0x02
+#define MFRC522_Status1Reg_LoAlert      0x01
+
+#define MFRC522_Status2Reg_MFCrypto1On  0x08
+#define MFRC522_Status2Reg_ModemState   0x07
+
+#define MFRC522_FIFOLevelReg_FlushBuffer 0x80
+#define MFRC522_FIFOLevelReg_Level      0x7F
+
+#define MFRC522_ControlReg_TStopNow     0x80
+#define MFRC522_ControlReg_TStartNow    0x40
+#define MFRC522_ControlReg_RxLastBits   0x07
+
+#define MFRC522_BitFramingReg_StartSend 0x80
+#define MFRC522_BitFramingReg_RxAlign(n) ((uint8_t)(((n) & 0x07) << 4))
+#define MFRC522_BitFramingReg_TxLastBits 0x07
+
+#define MFRC522_CollReg_ValuesAfterColl 0x80
+#define MFRC522_CollReg_CollPosNotValid 0x20
+#define MFRC522_CollReg_CollPos         0x1F
+
+#define MFRC522_ModeReg_MSBFirst        0x80
+#define MFRC522_ModeReg_TxWaitRF        0x20
+#define MFRC522_ModeReg_PolMFin         0x08
+#define MFRC522_ModeReg_CRCPreset_6363  0x01
+
+#define MFRC522_TxModeReg_TxCRCEn       0x80
+#define MFRC522_RxModeReg_RxCRCEn       0x80
+#define MFRC522_ModeReg_Speed(n)        ((uint8_t)(((n) & 0x07) << 4))
+#define MFRC522_ModeReg_SpeedMask       0x70
+
+#define MFRC522_TxControlReg_Tx2RFEn    0x02
+#define MFRC522_TxControlReg_Tx1RFEn    0x01
+
+#define MFRC522_TxASKReg_Force100ASK    0x40
+
+#define MFRC522_TModeReg_TAuto          0x80
+#define MFRC522_TModeReg_TAutoRestart   0x10
+#define MFRC522_TModeReg_TPrescalerHi   0x0F
+/** @} */
+
+/**
+ * @brief   FIFO buffer size in bytes.
+ */
+#define MFRC522_FIFO_SIZE           64
+
+/**
+ * @brief   Carrier frequency in kHz.
+ */
+#define MFRC522_FC_KHZ              13560U
+
+#endif /* _MFRC522_REGS_H_ */
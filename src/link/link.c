@@ -0,0 +1,300 @@
+/**
+ * @file    link.c
+ * @brief   Byte stream link to the controller.
+ */
+
+#include <string.h>
+
+#include "link/link.h"
+
+/*===========================================================================*/
+/* Local functions.                                                          */
+/*===========================================================================*/
+
+/**
+ * @brief   Arms the receive DMA on the free room after the received bytes,
+ *          up to the end of the ring.
+ * @details Nothing is armed if the ring is full, the bytes arriving then
+ *          are dropped in @p linkRxCharI().
+ */
+static void arm_receive(LinkDriver *lp) {
+    const LinkConfig *config = lp->config;
+    size_t n = LINK_RX_RING_SIZE - lp->rxcount;
+
+    if (n > LINK_RX_RING_SIZE - lp->rxhead) {
+        n = LINK_RX_RING_SIZE - lp->rxhead;
+    }
+    if (n > LINK_RX_SEGMENT_MAX) {
+        n = LINK_RX_SEGMENT_MAX;
+    }
+    lp->rxsegment = n;
+    if (n > 0) {
+        config->transport->startReceiveI(config->ctx, &lp->rxring[lp->rxhead],
+                                         n);
+    }
+}
+
+/**
+ * @brief   Hands @p n bytes of the segment over to the reading thread.
+ */
+static void receive_done(LinkDriver *lp, size_t n) {
+    const LinkConfig *config = lp->config;
+
+    lp->rxsegment = 0;
+    if (n == 0) {
+        return;
+    }
+    lp->rxhead = (lp->rxhead + n) % LINK_RX_RING_SIZE;
+    lp->rxcount += n;
+    lp->stats.rxBytes += n;
+    lp->stats.segments++;
+    config->transport->wakeupI(config->ctx, LINK_WAITER_RX);
+}
+
+/**
+ * @brief   Waits until the transmit DMA is done with its buffer.
+ * @note    Called with the lock held.
+ */
+static void wait_send(LinkDriver *lp) {
+    const LinkConfig *config = lp->config;
+
+    while (lp->txbuf != NULL) {
+        config->transport->waitS(config->ctx, LINK_WAITER_TX,
+                                 LINK_WAIT_FOREVER);
+    }
+}
+
+/*===========================================================================*/
+/* Exported functions.                                                       */
+/*===========================================================================*/
+
+/**
+ * @brief   Initializes the driver structure.
+ */
+void linkObjectInit(LinkDriver *lp) {
+    memset(lp, 0, sizeof(*lp));
+    lp->state = LINK_STOP;
+}
+
+/**
+ * @brief   Starts receiving into an empty ring.
+ * @note    The transport must be set up, e.g. the UART started.
+ */
+void linkStart(LinkDriver *lp, const LinkConfig *config) {
+    lp->config = config;
+    lp->rxhead = 0;
+    lp->rxtail = 0;
+    lp->rxcount = 0;
+    lp->txbuf = NULL;
+
+    platformLock();
+    lp->state = LINK_READY;
+    arm_receive(lp);
+    platformUnlock();
+}
+
+/**
+ * @brief   Waits for the transmission in flight and stops receiving.
+ */
+void linkStop(LinkDriver *lp) {
+    const LinkConfig *config = lp->config;
+
+    platformLock();
+    wait_send(lp);
+    if (lp->rxsegment > 0) {
+        config->transport->stopReceiveI(config->ctx);
+        lp->rxsegment = 0;
+    }
+    lp->state = LINK_STOP;
+    platformUnlock();
+}
+
+/**
+ * @brief   Starts transmitting @p n bytes straight from @p buf.
+ * @details Waits for the previous transmission to release its buffer
+ *          first. @p buf is read by the DMA and must stay unchanged until
+ *          @p linkWaitSend() or the next @p linkStartSend() returns.
+ */
+void linkStartSend(LinkDriver *lp, const uint8_t *buf, size_t n) {
+    const LinkConfig *config = lp->config;
+
+    platformLock();
+    wait_send(lp);
+    if (n > 0) {
+        lp->txbuf = buf;
+        lp->stats.txBytes += n;
+        config->transport->startSendI(config->ctx, buf, n);
+    }
+    platformUnlock();
+}
+
+/**
+ * @brief   Waits until the transmit DMA is done with the buffer of the last
+ *          @p linkStartSend().
+ * @note    The last bytes may still be on the line.
+ */
+void linkWaitSend(LinkDriver *lp) {
+    platformLock();
+    wait_send(lp);
+    platformUnlock();
+}
+
+/**
+ * @brief   Transmits @p n bytes from @p buf and waits until the DMA is done
+ *          with them.
+ */
+void linkSend(LinkDriver *lp, const uint8_t *buf, size_t n) {
+    linkStartSend(lp, buf, n);
+    linkWaitSend(lp);
+}
+
+/**
+ * @brief   Waits for received bytes and points @p data at them in the ring.
+ * @details The bytes stay valid until released with @p linkRelease(). Only
+ *          the bytes up to the end of the ring are returned, the rest comes
+ *          with the next call.
+ *
+ * @param[in] timeout   microseconds to wait if nothing was received,
+ *                      @p LINK_IMMEDIATE or @p LINK_WAIT_FOREVER
+ * @return              Number of bytes at @p data, 0 on timeout.
+ */
+size_t linkReceive(LinkDriver *lp, const uint8_t **data, uint32_t timeout) {
+    const LinkConfig *config = lp->config;
+    size_t n;
+
+    platformLock();
+    if (lp->rxcount == 0 && timeout != LINK_IMMEDIATE && !lp->wakeup) {
+        config->transport->waitS(config->ctx, LINK_WAITER_RX, timeout);
+    }
+    lp->wakeup = false;
+    n = lp->rxcount;
+    if (n > LINK_RX_RING_SIZE - lp->rxtail) {
+        n = LINK_RX_RING_SIZE - lp->rxtail;
+    }
+    *data = &lp->rxring[lp->rxtail];
+    platformUnlock();
+    return n;
+}
+
+/**
+ * @brief   Gives the room of @p n bytes returned by @p linkReceive() back
+ *          to the DMA.
+ */
+void linkRelease(LinkDriver *lp, size_t n) {
+    platformLock();
+    lp->rxtail = (lp->rxtail + n) % LINK_RX_RING_SIZE;
+    lp->rxcount -= n;
+    if (lp->rxsegment == 0 && lp->state == LINK_READY) {
+        arm_receive(lp);
+    }
+    platformUnlock();
+}
+
+/**
+ * @brief   Gets the thread waiting in @p linkReceive() to return at once,
+ *          or the next call if none is waiting, e.g. to send something
+ *          queued by another thread.
+ */
+void linkWakeup(LinkDriver *lp) {
+    const LinkConfig *config = lp->config;
+
+    platformLock();
+    lp->wakeup = true;
+    config->transport->wakeupI(config->ctx, LINK_WAITER_RX);
+    platformUnlock();
+}
+
+/**
+ * @brief   Changes the bit rate of the line.
+ * @details Waits for the transmission in flight to leave and stops
+ *          receiving meanwhile: bytes arriving during the change are lost,
+ *          the ones received before stay in the ring.
+ *
+ * @return  @p false if the transport cannot run at @p bitrate, the line
+ *          keeps its rate then.
+ */
+bool linkSetBitrate(LinkDriver *lp, uint32_t bitrate) {
+    const LinkConfig *config = lp->config;
+    bool ok;
+
+    platformLock();
+    wait_send(lp);
+    if (lp->rxsegment > 0) {
+        receive_done(lp, lp->rxsegment -
+                         config->transport->stopReceiveI(config->ctx));
+    }
+    /* Keeps linkRelease() from arming a segment meanwhile. */
+    lp->state = LINK_STOP;
+    platformUnlock();
+
+    ok = config->transport->setBitrate(config->ctx, bitrate);
+
+    platformLock();
+    lp->state = LINK_READY;
+    if (lp->rxsegment == 0) {
+        arm_receive(lp);
+    }
+    platformUnlock();
+    return ok;
+}
+
+/**
+ * @brief   The receive segment is full.
+ *
+ * @iclass
+ */
+void linkRxEndI(LinkDriver *lp) {
+    if (lp->rxsegment == 0) {
+        return;
+    }
+    receive_done(lp, lp->rxsegment);
+    arm_receive(lp);
+}
+
+/**
+ * @brief   The line went idle after a reception, the received part of the
+ *          segment is handed over.
+ *
+ * @iclass
+ */
+void linkRxIdleI(LinkDriver *lp) {
+    const LinkConfig *config = lp->config;
+    size_t n;
+
+    if (lp->rxsegment == 0) {
+        return;
+    }
+    n = lp->rxsegment - config->transport->stopReceiveI(config->ctx);
+    receive_done(lp, n);
+    arm_receive(lp);
+}
+
+/**
+ * @brief   A byte arrived with no receive segment armed, it is lost.
+ *
+ * @iclass
+ */
+void linkRxCharI(LinkDriver *lp) {
+    lp->stats.overruns++;
+}
+
+/**
+ * @brief   The receiver reported a framing, noise or parity error.
+ *
+ * @iclass
+ */
+void linkRxErrorI(LinkDriver *lp) {
+    lp->stats.errors++;
+}
+
+/**
+ * @brief   The transmit DMA is done with its buffer.
+ *
+ * @iclass
+ */
+void linkTxEndI(LinkDriver *lp) {
+    const LinkConfig *config = lp->config;
+
+    lp->txbuf = NULL;
+    config->transport->wakeupI(config->ctx, LINK_WAITER_TX);
+}
@@ -0,0 +1,186 @@
+/**
+ * @file    link.h
+ * @brief   Byte stream link to the controller.
+ *
+ * @details Like the MFRC522 driver, the link does not touch the hardware
+ *          itself: a @p LinkTransport moves the bytes by DMA and reports
+ *          back from its interrupts. The reader boards use the USART2
+ *          transport from @p link_hw.h, the host build a simulated one.
+ *
+ *          Received bytes are written by DMA straight into a ring, in
+ *          segments of at most half of it. A segment is handed over to the
+ *          reading thread when it is full or when the line goes idle after a
+ *          burst, so a frame costs a few interrupts however long it is.
+ *          The thread reads the bytes in place with @p linkReceive() and
+ *          gives the room back with @p linkRelease(). Bytes arriving while
+ *          the ring is full are counted and dropped.
+ *
+ *          Transmissions are not copied either: @p linkStartSend() hands the
+ *          caller's buffer to the DMA, which reads it until
+ *          @p linkWaitSend() returns.
+ */
+
+#ifndef _LINK_H_
+#define _LINK_H_
+
+#include "platform.h"
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Size of the receive ring.
+ * @details Must hold what arrives while the reading thread is busy: 256
+ *          bytes last 67 ms at 38400 bit/s and 2.8 ms at 921600 bit/s.
+ */
+#if !defined(LINK_RX_RING_SIZE) || defined(__DOXYGEN__)
+#define LINK_RX_RING_SIZE           256
+#endif
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Longest receive segment, the thread reads one half of the ring
+ *          while the DMA fills the other.
+ */
+#define LINK_RX_SEGMENT_MAX         (LINK_RX_RING_SIZE / 2)
+
+/**
+ * @name    Special timeouts
+ * @{
+ */
+#define LINK_IMMEDIATE              0U
+#define LINK_WAIT_FOREVER           0xFFFFFFFFU
+/** @} */
+
+/**
+ * @name    Waiting threads of the transport
+ * @{
+ */
+#define LINK_WAITER_RX              0U
+#define LINK_WAITER_TX              1U
+/** @} */
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Driver state machine possible states.
+ */
+typedef enum {
+    LINK_UNINIT = 0,                /**< Not initialized.                   */
+    LINK_STOP = 1,                  /**< Stopped.                           */
+    LINK_READY = 2,                 /**< Ready.                             */
+} linkstate_t;
+
+/**
+ * @brief   UART and DMA access used by the driver.
+ * @details All functions but @p setBitrate() are called with the platform
+ *          lock held, see @p platformLock(). The transport reports back by
+ *          calling the I-class functions of the driver from its interrupts,
+ *          with the lock held as well.
+ */
+typedef struct {
+    /**
+     * @brief   Starts transmitting @p n bytes from @p buf by DMA.
+     * @details Reports the end with @p linkTxEndI().
+     */
+    void (*startSendI)(void *ctx, const uint8_t *buf, size_t n);
+    /**
+     * @brief   Starts receiving @p n bytes into @p buf by DMA.
+     * @details Reports a full buffer with @p linkRxEndI() and an idle line
+     *          after a reception with @p linkRxIdleI().
+     */
+    void (*startReceiveI)(void *ctx, uint8_t *buf, size_t n);
+    /**
+     * @brief   Stops the reception.
+     * @return  Bytes of the buffer not received.
+     */
+    size_t (*stopReceiveI)(void *ctx);
+    /**
+     * @brief   Suspends the calling thread, releasing the lock meanwhile,
+     *          until @p wakeupI() is called for @p waiter.
+     * @return  @p false if @p timeout microseconds elapsed first.
+     */
+    bool (*waitS)(void *ctx, unsigned waiter, uint32_t timeout);
+    /**
+     * @brief   Resumes the thread waiting as @p waiter, if any.
+     */
+    void (*wakeupI)(void *ctx, unsigned waiter);
+    /**
+     * @brief   Changes the bit rate, without the lock.
+     * @details Called with the transmit DMA done and no reception armed,
+     *          the characters still in the UART leave at the old rate.
+     * @return  @p false if the UART cannot run at @p bitrate.
+     */
+    bool (*setBitrate)(void *ctx, uint32_t bitrate);
+} LinkTransport;
+
+/**
+ * @brief   Driver configuration structure.
+ */
+typedef struct {
+    const LinkTransport *transport;
+    void *ctx;                      /**< Passed to the transport functions. */
+} LinkConfig;
+
+/**
+ * @brief   Link counters.
+ */
+typedef struct {
+    uint32_t rxBytes;               /**< Bytes received into the ring.      */
+    uint32_t txBytes;               /**< Bytes handed to the transmit DMA.  */
+    uint32_t segments;              /**< Receive segments handed over.      */
+    uint32_t overruns;              /**< Bytes dropped, the ring was full.  */
+    uint32_t errors;                /**< Framing, noise or parity errors.   */
+} LinkStats;
+
+/**
+ * @brief   Driver structure.
+ */
+typedef struct {
+    linkstate_t state;
+    const LinkConfig *config;
+    LinkStats stats;
+    size_t rxhead;                  /**< Start of the receive segment.      */
+    size_t rxtail;                  /**< First byte not released.           */
+    size_t rxcount;                 /**< Bytes received, not released.      */
+    size_t rxsegment;               /**< Length of the receive segment, 0 if
+                                         none is armed.                     */
+    const uint8_t *txbuf;           /**< Buffer read by the DMA, @p NULL
+                                         when idle.                         */
+    bool wakeup;                    /**< See @p linkWakeup().               */
+    uint8_t rxring[LINK_RX_RING_SIZE];
+} LinkDriver;
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void linkObjectInit(LinkDriver *lp);
+  void linkStart(LinkDriver *lp, const LinkConfig *config);
+  void linkStop(LinkDriver *lp);
+  void linkStartSend(LinkDriver *lp, const uint8_t *buf, size_t n);
+  void linkWaitSend(LinkDriver *lp);
+  void linkSend(LinkDriver *lp, const uint8_t *buf, size_t n);
+  size_t linkReceive(LinkDriver *lp, const uint8_t **data, uint32_t timeout);
+  void linkRelease(LinkDriver *lp, size_t n);
+  void linkWakeup(LinkDriver *lp);
+  bool linkSetBitrate(LinkDriver *lp, uint32_t bitrate);
+  void linkRxEndI(LinkDriver *lp);
+  void linkRxIdleI(LinkDriver *lp);
+  void linkRxCharI(LinkDriver *lp);
+  void linkRxErrorI(LinkDriver *lp);
+  void linkTxEndI(LinkDriver *lp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _LINK_H_ */
@@ -0,0 +1,701 @@
+/**
+ * @file    proto.c
+ * @brief   Reader-controller protocol: framing, checksums and a sliding
+ *          window of unacknowledged messages.
+ */
+
+#include <string.h>
+
+#include "link/proto.h"
+#include "link/session.h"
+
+/*===========================================================================*/
+/* Local definitions.                                                        */
+/*===========================================================================*/
+
+#define HDR_ADDRESS                 0
+#define HDR_SEQ                     1
+#define HDR_ACK                     2
+#define HDR_TYPE                    3
+#define HDR_SIZE                    4
+
+/* Address byte: set on the frames of the reader. */
+#define ADDRESS_FROM_READER         0x80
+/* Type byte: the last frame of a turn on a bus. */
+#define TYPE_TOKEN                  0x80
+
+#define COBS_BLOCK_MAX              0xFF
+
+#define SLOTS                       (PROTO_WINDOW_MAX + 1)
+
+/* Payload of PROTO_MSG_RESET and PROTO_MSG_RESET_ANSWER: flags, the epoch of
+   the reset and the sender's acknowledgement in the old count. */
+#define RESET_FLAGS                 0
+#define RESET_EPOCH                 1
+#define RESET_ACK                   2
+#define RESET_SIZE                  3
+
+/* Flags: the sender heard from the peer before, its acknowledgement
+   counts. */
+#define RESET_KEPT                  0x01
+
+/*===========================================================================*/
+/* Local variables and types.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   CRC-16/CCITT (polynomial 0x1021) of every 4 bit value.
+ */
+static const uint16_t crc_nibbles[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+/*===========================================================================*/
+/* Local functions.                                                          */
+/*===========================================================================*/
+
+/**
+ * @brief   CRC-16/CCITT-FALSE, initial value 0xFFFF.
+ */
+static uint16_t crc16(const uint8_t *data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        crc = (uint16_t)(crc << 4) ^ crc_nibbles[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (uint16_t)(crc << 4) ^ crc_nibbles[(crc >> 12) ^ (data[i] & 0x0F)];
+    }
+    return crc;
+}
+
+/**
+ * @brief   COBS encodes @p len bytes and appends the delimiter.
+ *
+ * @return  Length of the encoded frame, with the delimiter.
+ */
+static size_t cobs_encode(const uint8_t *src, size_t len, uint8_t *dst) {
+    size_t out = 1;
+    size_t codepos = 0;
+    uint8_t code = 1;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        if (src[i] != 0) {
+            dst[out++] = src[i];
+            code++;
+        }
+        if (src[i] == 0 || code == COBS_BLOCK_MAX) {
+            dst[codepos] = code;
+            codepos = out++;
+            code = 1;
+        }
+    }
+    dst[codepos] = code;
+    dst[out++] = 0;
+    return out;
+}
+
+/**
+ * @brief   Builds and encodes a frame into @p frame.
+ */
+static size_t build(Proto *pp, uint8_t seq, uint8_t type,
+                    const uint8_t *payload, size_t len, uint8_t *frame) {
+    const ProtoConfig *config = pp->config;
+    uint8_t raw[PROTO_OVERHEAD + PROTO_TAG_SIZE + PROTO_PAYLOAD_MAX];
+    uint16_t crc;
+
+    raw[HDR_ADDRESS] = config->address |
+                       (config->primary ? 0 : ADDRESS_FROM_READER);
+    raw[HDR_SEQ] = seq;
+    raw[HDR_ACK] = pp->rxNext;
+    raw[HDR_TYPE] = type;
+    if (len > 0) {
+        memcpy(&raw[HDR_SIZE], payload, len);
+    }
+    crc = crc16(raw, HDR_SIZE + len);
+    raw[HDR_SIZE + len] = (uint8_t)(crc >> 8);
+    raw[HDR_SIZE + len + 1] = (uint8_t)crc;
+    pp->ackPending = false;
+    return cobs_encode(raw, HDR_SIZE + len + 2, frame);
+}
+
+static bool on_bus(const Proto *pp) {
+    return pp->config->address != PROTO_ADDRESS_P2P;
+}
+
+/**
+ * @brief   The session handshake, which goes in the clear.
+ */
+static bool handshake(uint8_t type) {
+    return type == PROTO_MSG_HELLO || type == PROTO_MSG_HELLO_ANSWER ||
+           type == PROTO_MSG_HELLO_DONE;
+}
+
+static ProtoSlot *slot(Proto *pp, size_t i) {
+    return &pp->slots[(pp->slotBase + i) % SLOTS];
+}
+
+/**
+ * @brief   Seals the @p i th message in flight for its first transmission.
+ *
+ * @return  @p false if it waits for the session.
+ */
+static bool seal(Proto *pp, size_t i) {
+    ProtoSlot *sp = slot(pp, i);
+
+    if (pp->session == NULL || sp->sealed || handshake(sp->type)) {
+        return true;
+    }
+    if (!linkSessionSeal(pp->session, sp->type, sp->payload, sp->len,
+                         sp->payload)) {
+        return false;
+    }
+    sp->len += PROTO_TAG_SIZE;
+    sp->sealed = true;
+    return true;
+}
+
+/**
+ * @brief   Messages in flight which may go out, up to the first the session
+ *          holds back.
+ */
+static size_t ready(Proto *pp) {
+    size_t inflight = protoInFlight(pp);
+    size_t n = pp->txSent;
+
+    while (n < inflight && seal(pp, n)) {
+        n++;
+    }
+    return n;
+}
+
+/**
+ * @brief   Takes the messages in flight back from the session for a reset.
+ * @details The sealed ones are decrypted, the newest under the last number
+ *          sealed, the handshake is dropped and the session closed. They
+ *          are sealed again once there is a new one.
+ */
+static void take_back(Proto *pp) {
+    size_t inflight = protoInFlight(pp);
+    size_t kept = 0;
+    uint32_t back = 0;
+    size_t i;
+
+    if (pp->session == NULL) {
+        return;
+    }
+    for (i = inflight; i-- > 0;) {
+        ProtoSlot *sp = slot(pp, i);
+
+        if (sp->sealed) {
+            sp->len -= PROTO_TAG_SIZE;
+            linkSessionUnseal(pp->session, sp->payload, sp->len, back++);
+            sp->sealed = false;
+        }
+    }
+    for (i = 0; i < inflight; i++) {
+        if (!handshake(slot(pp, i)->type)) {
+            if (kept != i) {
+                *slot(pp, kept) = *slot(pp, i);
+            }
+            kept++;
+        }
+    }
+    /* The count starts over next, see renumber(). */
+    pp->txNext = (uint8_t)(pp->txBase + kept);
+    linkSessionReset(pp->session);
+}
+
+/**
+ * @brief   Sends the @p i th message in flight.
+ */
+static void transmit(Proto *pp, size_t i, uint8_t flags) {
+    const ProtoConfig *config = pp->config;
+    ProtoSlot *sp = slot(pp, i);
+    size_t len = build(pp, (uint8_t)(pp->txBase + i), sp->type | flags,
+                       sp->payload, sp->len, pp->tx);
+
+    sp->sentAt = platformNowUs();
+    config->send(config->arg, pp->tx, len);
+}
+
+/**
+ * @brief   Sends a bare acknowledgement.
+ */
+static void transmit_ack(Proto *pp, uint8_t flags) {
+    const ProtoConfig *config = pp->config;
+    size_t len = build(pp, pp->txNext, PROTO_MSG_ACK | flags, NULL, 0,
+                       pp->tx);
+
+    pp->stats.acks++;
+    config->send(config->arg, pp->tx, len);
+}
+
+/**
+ * @brief   Sends the own reset, or the answer to the peer's.
+ */
+static void transmit_reset(Proto *pp, uint8_t type, uint8_t flags) {
+    const ProtoConfig *config = pp->config;
+    uint8_t payload[RESET_SIZE];
+    bool ackPending = pp->ackPending;
+    size_t len;
+
+    if (type == PROTO_MSG_RESET) {
+        payload[RESET_FLAGS] = pp->resetFlags;
+        payload[RESET_EPOCH] = pp->epoch;
+        payload[RESET_ACK] = pp->rxNext;
+        pp->resetAt = platformNowUs();
+    } else {
+        payload[RESET_FLAGS] = pp->answerFlags;
+        payload[RESET_EPOCH] = pp->peerEpoch;
+        payload[RESET_ACK] = pp->answerAck;
+        pp->answerPending = false;
+    }
+    len = build(pp, 0, type | flags, payload, RESET_SIZE, pp->tx);
+    /* Acknowledges nothing in the new count. */
+    pp->ackPending = ackPending;
+    config->send(config->arg, pp->tx, len);
+}
+
+/**
+ * @brief   Frees the slots of the messages acknowledged by @p ack.
+ */
+static void acknowledged(Proto *pp, uint8_t ack) {
+    uint8_t n = (uint8_t)(ack - pp->txBase);
+
+    /* An older acknowledgement, from a frame sent again, wraps around. */
+    if (n > pp->txSent) {
+        return;
+    }
+    pp->txBase = ack;
+    pp->txSent = (uint8_t)(pp->txSent - n);
+    pp->slotBase = (uint8_t)((pp->slotBase + n) % SLOTS);
+}
+
+/**
+ * @brief   Starts both sequences over, the messages in flight go again
+ *          from 0.
+ */
+static void renumber(Proto *pp) {
+    pp->txNext = (uint8_t)protoInFlight(pp);
+    pp->txBase = 0;
+    pp->txSent = 0;
+    pp->rxNext = 0;
+    pp->ackPending = false;
+    pp->stats.resets++;
+}
+
+/**
+ * @brief   Handles a reset of the peer, or its answer to the own one.
+ */
+static void reset_received(Proto *pp, uint8_t type, const uint8_t *payload) {
+    bool kept = (payload[RESET_FLAGS] & RESET_KEPT) != 0;
+
+    if (type == PROTO_MSG_RESET_ANSWER) {
+        /* An answer to an older reset, or sent again. */
+        if (!pp->resetting || payload[RESET_EPOCH] != pp->epoch) {
+            return;
+        }
+        if (kept && (pp->resetFlags & RESET_KEPT) != 0) {
+            acknowledged(pp, payload[RESET_ACK]);
+        }
+        renumber(pp);
+        pp->resetting = false;
+        pp->fresh = false;
+        /* A frame in the new count tells the peer the reset is done. */
+        pp->ackPending = true;
+        return;
+    }
+    /* Sent again before the answer arrived, only the answer is. */
+    if (pp->peerQuiet && payload[RESET_EPOCH] == pp->peerEpoch) {
+        pp->answerPending = true;
+        return;
+    }
+    pp->answerFlags = pp->fresh ? 0 : RESET_KEPT;
+    pp->answerAck = pp->rxNext;
+    if (kept && !pp->fresh) {
+        acknowledged(pp, payload[RESET_ACK]);
+    }
+    if (pp->resetting) {
+        /* The peer's answer comes in the count taken here. */
+        pp->resetFlags &= (uint8_t)~RESET_KEPT;
+    }
+    pp->peerEpoch = payload[RESET_EPOCH];
+    pp->peerQuiet = true;
+    pp->answerPending = true;
+    take_back(pp);
+    renumber(pp);
+}
+
+/**
+ * @brief   Checks and handles a decoded frame.
+ */
+static void frame_done(Proto *pp) {
+    const ProtoConfig *config = pp->config;
+    size_t len = pp->rxlen;
+    uint8_t *rx = pp->rx;
+    uint8_t type;
+
+    if (len < PROTO_OVERHEAD) {
+        pp->stats.framingErrors++;
+        return;
+    }
+    if (crc16(rx, len - 2) != (uint16_t)(rx[len - 2] << 8 | rx[len - 1])) {
+        pp->stats.crcErrors++;
+        return;
+    }
+    /* Another reader's, or an echo of the own frame. */
+    if (rx[HDR_ADDRESS] != (config->address |
+                            (config->primary ? ADDRESS_FROM_READER : 0))) {
+        return;
+    }
+    pp->stats.frames++;
+    if ((rx[HDR_TYPE] & TYPE_TOKEN) != 0 && on_bus(pp)) {
+        pp->token = true;
+    }
+    type = rx[HDR_TYPE] & ~TYPE_TOKEN;
+    len -= PROTO_OVERHEAD;
+    if (type == PROTO_MSG_RESET || type == PROTO_MSG_RESET_ANSWER) {
+        if (len != RESET_SIZE) {
+            pp->stats.framingErrors++;
+            return;
+        }
+        reset_received(pp, type, &rx[HDR_SIZE]);
+        return;
+    }
+    /* In the count the reset gives up. */
+    if (pp->resetting) {
+        return;
+    }
+    pp->fresh = false;
+    pp->peerQuiet = false;
+    acknowledged(pp, rx[HDR_ACK]);
+    if (type == PROTO_MSG_ACK) {
+        return;
+    }
+    /* Whatever the frame, the peer learns where this end is. */
+    pp->ackPending = true;
+    if (rx[HDR_SEQ] != pp->rxNext) {
+        pp->stats.duplicates++;
+        return;
+    }
+    if (pp->session != NULL && handshake(type)) {
+        pp->rxNext++;
+        pp->stats.received++;
+        linkSessionReceive(pp->session, type, &rx[HDR_SIZE], len);
+        return;
+    }
+    if (pp->session != NULL) {
+        /* Left unacknowledged, to be sent again if only corrupted. */
+        if (!linkSessionOpen(pp->session, type, &rx[HDR_SIZE], len)) {
+            return;
+        }
+        len -= PROTO_TAG_SIZE;
+    }
+    pp->rxNext++;
+    pp->stats.received++;
+    config->receive(config->arg, type, &rx[HDR_SIZE], len);
+}
+
+static void decode_reset(Proto *pp) {
+    pp->code = 0;
+    pp->left = 0;
+    pp->discard = false;
+    pp->rxlen = 0;
+}
+
+static void decode_append(Proto *pp, uint8_t b) {
+    if (pp->rxlen == sizeof(pp->rx)) {
+        pp->stats.framingErrors++;
+        pp->discard = true;
+        return;
+    }
+    pp->rx[pp->rxlen++] = b;
+}
+
+/*===========================================================================*/
+/* Exported functions.                                                       */
+/*===========================================================================*/
+
+/**
+ * @brief   Initializes the state of one end.
+ * @details Both ends start at sequence 0, on a bus the controller starts
+ *          with the token. An end which may come up while the peer keeps
+ *          running resets the connection right after, see @p protoReset().
+ */
+void protoInit(Proto *pp, const ProtoConfig *config) {
+    memset(pp, 0, sizeof(*pp));
+    pp->config = config;
+    pp->token = config->primary;
+    pp->fresh = true;
+}
+
+/**
+ * @brief   Starts the sequences of both ends over.
+ * @details Sends @p PROTO_MSG_RESET until the peer answers, again after
+ *          every retransmission timeout, on a bus in every turn. Until then
+ *          frames from the peer are dropped and messages wait, those in
+ *          flight and new ones; then they go from sequence 0, less those
+ *          the peer reports received.
+ *
+ *          The peer takes a reset at any time, also while resetting itself.
+ *          Its answer and the epoch of the reset tell a reset sent again
+ *          from a new one, so the count is only started over once.
+ *
+ *          With a session attached, both ends take their messages back from
+ *          it, see @p linkSessionReset().
+ */
+void protoReset(Proto *pp) {
+    take_back(pp);
+    pp->resetting = true;
+    pp->resetFlags = pp->fresh ? 0 : RESET_KEPT;
+    pp->epoch = (uint8_t)(pp->epoch + 1 != 0 ? pp->epoch + 1 : 1);
+    if (!on_bus(pp)) {
+        transmit_reset(pp, PROTO_MSG_RESET, 0);
+    }
+}
+
+/**
+ * @brief   Sends a message if the window has room for it.
+ * @details On a bus the message waits for the next turn. With a session
+ *          attached, messages other than the handshake are sealed when they
+ *          are first sent, the handshake goes ahead of those not sent yet.
+ * @note    Acknowledges the messages received so far as well.
+ */
+protoresult_t protoSend(Proto *pp, uint8_t type, const uint8_t *payload,
+                        size_t len) {
+    ProtoSlot *sp;
+    size_t inflight = protoInFlight(pp);
+    size_t at = inflight;
+    size_t i;
+
+    if (len > PROTO_PAYLOAD_MAX) {
+        return PROTO_TOO_LONG;
+    }
+    if (pp->session != NULL && handshake(type)) {
+        /* May take the spare slot. */
+        if (inflight > pp->config->window) {
+            return PROTO_BUSY;
+        }
+        /* Ahead of the messages not sent yet, which wait for the session
+           it sets up. */
+        at = pp->txSent;
+        while (at < inflight && handshake(slot(pp, at)->type)) {
+            at++;
+        }
+        for (i = inflight; i > at; i--) {
+            *slot(pp, i) = *slot(pp, i - 1);
+        }
+    } else {
+        if (inflight >= pp->config->window) {
+            return PROTO_BUSY;
+        }
+        if (pp->session != NULL &&
+            pp->session->state != LINK_SESSION_READY) {
+            return PROTO_CLOSED;
+        }
+    }
+    sp = slot(pp, at);
+    if (len > 0) {
+        memcpy(sp->payload, payload, len);
+    }
+    sp->type = type;
+    sp->len = (uint8_t)len;
+    sp->sealed = false;
+    pp->txNext++;
+    pp->stats.sent++;
+    if (!on_bus(pp) && !pp->resetting) {
+        size_t n = ready(pp);
+
+        while (pp->txSent < n) {
+            transmit(pp, pp->txSent, 0);
+            pp->txSent++;
+        }
+    }
+    return PROTO_OK;
+}
+
+/**
+ * @brief   Decodes received bytes, delivering the complete messages.
+ */
+void protoInput(Proto *pp, const uint8_t *data, size_t n) {
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        uint8_t b = data[i];
+
+        if (b == 0) {
+            if (!pp->discard && pp->code != 0) {
+                if (pp->left == 0) {
+                    frame_done(pp);
+                } else {
+                    pp->stats.framingErrors++;
+                }
+            }
+            decode_reset(pp);
+        } else if (pp->discard) {
+            continue;
+        } else if (pp->left == 0) {
+            /* A block which is not the last ends with an implied zero. */
+            if (pp->code != 0 && pp->code != COBS_BLOCK_MAX) {
+                decode_append(pp, 0);
+            }
+            pp->code = b;
+            pp->left = (uint8_t)(b - 1);
+        } else {
+            decode_append(pp, b);
+            pp->left--;
+        }
+    }
+}
+
+/**
+ * @brief   Sends the unacknowledged frames again once the retransmission
+ *          timeout passed, and a pending acknowledgement.
+ * @details On a bus, a reader holding the token takes its turn here, see
+ *          @p protoPassToken(). The controller's turns are up to the
+ *          controller.
+ *
+ * @return  Microseconds until the next call is due, @p LINK_WAIT_FOREVER
+ *          if nothing sent waits for its acknowledgement, or on a bus.
+ */
+uint32_t protoPoll(Proto *pp) {
+    const ProtoConfig *config = pp->config;
+    uint32_t elapsed;
+    size_t n;
+
+    if (on_bus(pp)) {
+        if (pp->token && !config->primary) {
+            protoPassToken(pp);
+        }
+        return LINK_WAIT_FOREVER;
+    }
+    if (pp->answerPending) {
+        transmit_reset(pp, PROTO_MSG_RESET_ANSWER, 0);
+    }
+    if (pp->resetting) {
+        elapsed = platformElapsedUs(pp->resetAt);
+        if (elapsed >= config->retransmit) {
+            transmit_reset(pp, PROTO_MSG_RESET, 0);
+            elapsed = 0;
+        }
+        return config->retransmit - elapsed;
+    }
+    if (pp->txSent > 0 &&
+        platformElapsedUs(slot(pp, 0)->sentAt) >= config->retransmit) {
+        size_t i;
+
+        for (i = 0; i < pp->txSent; i++) {
+            transmit(pp, i, 0);
+        }
+        pp->stats.retransmissions += pp->txSent;
+        pp->stats.timeouts++;
+    }
+    /* Held back by a reset, or waiting for the session. */
+    n = ready(pp);
+    while (pp->txSent < n) {
+        transmit(pp, pp->txSent, 0);
+        pp->txSent++;
+    }
+    if (pp->ackPending) {
+        transmit_ack(pp, 0);
+    }
+    if (pp->txSent == 0) {
+        return LINK_WAIT_FOREVER;
+    }
+    elapsed = platformElapsedUs(slot(pp, 0)->sentAt);
+    return elapsed < config->retransmit ? config->retransmit - elapsed : 0;
+}
+
+/**
+ * @brief   Messages sent and not acknowledged yet.
+ */
+size_t protoInFlight(const Proto *pp) {
+    return (uint8_t)(pp->txNext - pp->txBase);
+}
+
+/**
+ * @brief   Takes a turn on a bus and passes the token to the other end.
+ * @details Sends every message in flight, the ones sent in an earlier turn
+ *          again, as the other end acknowledged what it got before passing
+ *          the token. The last frame carries the token, a bare
+ *          acknowledgement does if nothing is in flight. A reset, or the
+ *          answer to the peer's, goes first. Messages waiting for the
+ *          session wait for a later turn.
+ *
+ *          The controller calls it to give a reader its turn, once the
+ *          line is free. A reader calls it through @p protoPoll().
+ */
+void protoPassToken(Proto *pp) {
+    size_t inflight = pp->resetting ? 0 : ready(pp);
+    size_t i;
+
+    pp->token = false;
+    pp->stats.turns++;
+    if (pp->answerPending) {
+        bool last = !pp->resetting && inflight == 0;
+
+        transmit_reset(pp, PROTO_MSG_RESET_ANSWER, last ? TYPE_TOKEN : 0);
+        if (last) {
+            return;
+        }
+    }
+    if (pp->resetting) {
+        transmit_reset(pp, PROTO_MSG_RESET, TYPE_TOKEN);
+        return;
+    }
+    if (inflight == 0) {
+        transmit_ack(pp, TYPE_TOKEN);
+        return;
+    }
+    for (i = 0; i < inflight; i++) {
+        transmit(pp, i, i + 1 == inflight ? TYPE_TOKEN : 0);
+    }
+    pp->stats.retransmissions += pp->txSent;
+    pp->txSent = (uint8_t)inflight;
+}
+
+/**
+ * @brief   Runs the protocol over @p lp for @p timeout microseconds.
+ * @details Received messages are delivered from here, frames are sent
+ *          straight from the protocol buffers with @p linkSend(): the
+ *          configuration's send function must call it on @p lp. The
+ *          service function runs before every wait, @p linkWakeup() gets it
+ *          to run at once.
+ */
+void protoRun(Proto *pp, LinkDriver *lp, uint32_t timeout) {
+    const ProtoConfig *config = pp->config;
+    uint32_t start = platformNowUs();
+
+    while (true) {
+        uint32_t wait;
+        uint32_t poll;
+        uint32_t elapsed;
+        const uint8_t *data;
+        size_t n;
+
+        wait = LINK_WAIT_FOREVER;
+        if (config->service != NULL) {
+            wait = config->service(config->arg);
+        }
+        poll = protoPoll(pp);
+        if (poll < wait) {
+            wait = poll;
+        }
+        elapsed = platformElapsedUs(start);
+        if (timeout != LINK_WAIT_FOREVER) {
+            if (elapsed >= timeout) {
+                break;
+            }
+            if (wait > timeout - elapsed) {
+                wait = timeout - elapsed;
+            }
+        }
+        n = linkReceive(lp, &data, wait);
+        if (n > 0) {
+            protoInput(pp, data, n);
+            linkRelease(lp, n);
+        }
+    }
+}
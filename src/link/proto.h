@@ -0,0 +1,328 @@
+/**
+ * @file    proto.h
+ * @brief   Reader-controller protocol: framing, checksums and a sliding
+ *          window of unacknowledged messages.
+ *
+ * @details Every message goes in one frame of the bus address, the sequence
+ *          number, the cumulative acknowledgement, the message type, the
+ *          payload and a CRC-16/CCITT of all that. Frames are COBS encoded
+ *          and end with a zero byte, so a receiver starting mid-stream or
+ *          after a corrupted frame picks up at the next frame.
+ *
+ *          Up to a window of messages may be in flight before the first of
+ *          them is acknowledged, so a card event, a feedback command and a
+ *          status poll crossing on the wire do not wait for each other's
+ *          round trips. Acknowledgements ride on the frames going the other
+ *          way, a frame of type @p PROTO_MSG_ACK carries one when there is
+ *          nothing to send. Frames received out of order are dropped and the
+ *          sender goes back to the oldest unacknowledged frame once its
+ *          retransmission timeout passes (go-back-N).
+ *
+ *          On a multi-drop bus every reader has an address and the
+ *          controller, the primary end, decides who talks: it passes a
+ *          token to one reader at a time with the last frame of its turn.
+ *          The reader then sends its unacknowledged messages and hands the
+ *          token back with its last frame, a bare acknowledgement if it has
+ *          nothing to say. Both ends have seen the other's acknowledgements
+ *          by their next turn, so a turn sends whatever is still
+ *          unacknowledged again instead of running a timer. The frames of
+ *          other readers, and the own ones echoed by the transceiver, are
+ *          dropped by the address and the direction bit.
+ *
+ *          An end starting afresh, or giving up a session, resets the
+ *          connection with @p protoReset(): it sends @p PROTO_MSG_RESET
+ *          until the peer answers @p PROTO_MSG_RESET_ANSWER, then both
+ *          count their sequences from 0 again. The messages in flight are
+ *          sent again in the new count, those the other end reports
+ *          received are dropped. A reader resets at start-up, so a peer
+ *          still holding the old count does not drop its frames as
+ *          duplicates.
+ *
+ *          A session of @p link/session.h attached to an end encrypts and
+ *          authenticates its messages. A reset takes the messages in flight
+ *          back from the session, a new handshake goes ahead of them and
+ *          they are sealed again under the new key.
+ *
+ *          The core does no I/O itself: received bytes are fed to
+ *          @p protoInput(), frames leave through the send function of the
+ *          configuration and @p protoPoll() runs the timers. This way the
+ *          same code runs on the reader over the DMA link, see
+ *          @p protoRun(), and in the host controller stand-in.
+ */
+
+#ifndef _PROTO_H_
+#define _PROTO_H_
+
+#include "link/link.h"
+
+/*===========================================================================*/
+/* Pre-compile time settings.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Longest message payload.
+ */
+#if !defined(PROTO_PAYLOAD_MAX) || defined(__DOXYGEN__)
+#define PROTO_PAYLOAD_MAX           64
+#endif
+
+/**
+ * @brief   Most messages in flight, the window of a configuration may be
+ *          smaller.
+ */
+#if !defined(PROTO_WINDOW_MAX) || defined(__DOXYGEN__)
+#define PROTO_WINDOW_MAX            4
+#endif
+
+/**
+ * @brief   Default time after which the unacknowledged frames are sent
+ *          again.
+ * @details Covers the oldest frame, the frames the controller may send
+ *          before its acknowledgement and the controller's turnaround.
+ */
+#if !defined(PROTO_RETRANSMIT_US) || defined(__DOXYGEN__)
+#define PROTO_RETRANSMIT_US         100000
+#endif
+
+#if PROTO_PAYLOAD_MAX > 255
+#error "PROTO_PAYLOAD_MAX must be at most 255"
+#endif
+
+#if PROTO_WINDOW_MAX < 1 || PROTO_WINDOW_MAX > 127
+#error "PROTO_WINDOW_MAX must be 1 to 127"
+#endif
+
+/*===========================================================================*/
+/* Constants.                                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Address, sequence number, acknowledgement, type and CRC.
+ */
+#define PROTO_OVERHEAD              6
+
+/**
+ * @brief   Authentication tag added to the payload of the messages sealed
+ *          by a session.
+ */
+#define PROTO_TAG_SIZE              16
+
+/**
+ * @name    Addresses
+ * @{
+ */
+#define PROTO_ADDRESS_P2P           0       /**< Point-to-point line, both
+                                                 ends send at will.         */
+#define PROTO_ADDRESS_MAX           127     /**< Highest reader address on a
+                                                 bus.                       */
+/** @} */
+
+/**
+ * @brief   Longest encoded frame: the COBS code bytes and the delimiter on
+ *          top of the longest message.
+ */
+#define PROTO_FRAME_MAX                                                     \
+    (PROTO_OVERHEAD + PROTO_TAG_SIZE + PROTO_PAYLOAD_MAX +                  \
+     (PROTO_OVERHEAD + PROTO_TAG_SIZE + PROTO_PAYLOAD_MAX) / 254 + 2)
+
+/**
+ * @name    Message types
+ * @{
+ */
+#define PROTO_MSG_ACK               0x00    /**< Only acknowledges, never
+                                                 acknowledged itself.       */
+#define PROTO_MSG_EVENT             0x01    /**< Reader: a card event, see
+                                                 @p readerEventEncode().    */
+#define PROTO_MSG_FEEDBACK          0x02    /**< Controller: the decision on
+                                                 an event, to be signalled,
+                                                 see @p reader/feedback.h.  */
+#define PROTO_MSG_STATUS_REQUEST    0x03    /**< Controller: status poll.   */
+#define PROTO_MSG_STATUS            0x04    /**< Reader: status, answers a
+                                                 poll.                      */
+#define PROTO_MSG_EVENTS            0x05    /**< Reader: several events,
+                                                 each after its length.     */
+#define PROTO_MSG_RATE              0x06    /**< Controller: try a bit rate,
+                                                 see @p link/rate.h.        */
+#define PROTO_MSG_RATE_ANSWER       0x07    /**< Reader: bit rate accepted
+                                                 or refused.                */
+#define PROTO_MSG_PROBE             0x08    /**< Test pattern, echoed by the
+                                                 reader.                    */
+#define PROTO_MSG_RATE_COMMIT       0x09    /**< Controller: keep the bit
+                                                 rate tried.                */
+#define PROTO_MSG_HELLO             0x0A    /**< Controller: start a
+                                                 session, see
+                                                 @p link/session.h.         */
+#define PROTO_MSG_HELLO_ANSWER      0x0B    /**< Reader: nonce and key
+                                                 confirmation.              */
+#define PROTO_MSG_HELLO_DONE        0x0C    /**< Controller: key
+                                                 confirmation.              */
+#define PROTO_MSG_ACL_DELTA         0x0D    /**< Controller: changes of the
+                                                 access list, see
+                                                 @p readerAclStoreApply().  */
+#define PROTO_MSG_ACL_STATUS        0x0E    /**< Reader: access list status,
+                                                 see
+                                                 @p readerAclStoreStatus(),
+                                                 answers a query or a delta
+                                                 not applied.               */
+#define PROTO_MSG_ACL_QUERY         0x0F    /**< Controller: access list
+                                                 status poll.               */
+#define PROTO_MSG_RESET             0x10    /**< Either end: start the
+                                                 sequences over, see
+                                                 @p protoReset(). Not
+                                                 sequenced.                 */
+#define PROTO_MSG_RESET_ANSWER      0x11    /**< Reset taken.               */
+/** @} */
+
+/*===========================================================================*/
+/* Data structures and types.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Result of @p protoSend().
+ */
+typedef enum {
+    PROTO_OK = 0,                   /**< Message sent.                      */
+    PROTO_BUSY = -1,                /**< Window full, try again later.      */
+    PROTO_TOO_LONG = -2,            /**< Payload over @p PROTO_PAYLOAD_MAX. */
+    PROTO_CLOSED = -3,              /**< Session not up yet, try again
+                                         later.                             */
+} protoresult_t;
+
+/**
+ * @brief   Transmits an encoded frame.
+ * @details @p frame must be fully read when the function returns, the
+ *          protocol may change it afterwards.
+ */
+typedef void (*protosendcb_t)(void *arg, const uint8_t *frame, size_t len);
+
+/**
+ * @brief   Delivers a message, in order and once.
+ */
+typedef void (*protoreceivecb_t)(void *arg, uint8_t type,
+                                 const uint8_t *payload, size_t len);
+
+/**
+ * @brief   Called by @p protoRun() before it waits for the link, e.g. to
+ *          send the messages queued by other threads.
+ *
+ * @return  Microseconds until it wants to be called again,
+ *          @p LINK_WAIT_FOREVER if only after the link wakes up.
+ */
+typedef uint32_t (*protoservicecb_t)(void *arg);
+
+/**
+ * @brief   Protocol configuration.
+ */
+typedef struct {
+    protosendcb_t send;
+    protoreceivecb_t receive;
+    protoservicecb_t service;       /**< Optional.                          */
+    void *arg;                      /**< Passed to the callbacks.           */
+    uint8_t window;                 /**< Messages in flight, 1 is stop-and-
+                                         wait, up to @p PROTO_WINDOW_MAX.   */
+    uint32_t retransmit;            /**< Retransmission timeout in us, not
+                                         used on a bus.                     */
+    uint8_t address;                /**< Reader address on a bus, or
+                                         @p PROTO_ADDRESS_P2P.              */
+    bool primary;                   /**< The controller end.                */
+} ProtoConfig;
+
+/**
+ * @brief   Protocol counters.
+ */
+typedef struct {
+    uint32_t sent;                  /**< Messages sent, once each.          */
+    uint32_t received;              /**< Messages delivered.                */
+    uint32_t frames;                /**< Frames received intact, for this
+                                         end.                               */
+    uint32_t acks;                  /**< @p PROTO_MSG_ACK frames sent.      */
+    uint32_t turns;                 /**< Tokens passed on a bus.            */
+    uint32_t retransmissions;       /**< Frames sent again.                 */
+    uint32_t timeouts;              /**< Retransmissions of the window for
+                                         want of an acknowledgement.        */
+    uint32_t duplicates;            /**< Frames received twice or out of
+                                         order, dropped.                    */
+    uint32_t crcErrors;
+    uint32_t framingErrors;         /**< Bad COBS, too long or too short.   */
+    uint32_t resets;                /**< Sequences started over, by either
+                                         end.                               */
+} ProtoStats;
+
+/**
+ * @brief   A message kept until acknowledged.
+ * @details It is encoded each time it is sent, with the latest
+ *          acknowledgement. With a session attached it is sealed when it is
+ *          first sent, so messages are sealed in their order on the wire.
+ */
+typedef struct {
+    uint32_t sentAt;
+    uint8_t type;
+    uint8_t len;
+    bool sealed;
+    uint8_t payload[PROTO_PAYLOAD_MAX + PROTO_TAG_SIZE];
+} ProtoSlot;
+
+/**
+ * @brief   Protocol state of one end.
+ */
+typedef struct {
+    const ProtoConfig *config;
+    struct link_session *session;   /**< Seals the messages, optional, see
+                                         @p linkSessionInit().              */
+    ProtoStats stats;
+    uint8_t slotBase;               /**< Slot of @p txBase.                 */
+    uint8_t txBase;                 /**< Oldest unacknowledged sequence.    */
+    uint8_t txNext;                 /**< Sequence of the next message.      */
+    uint8_t rxNext;                 /**< Sequence expected from the peer.   */
+    uint8_t txSent;                 /**< Messages in flight sent at least
+                                         once, on a bus some wait for the
+                                         token.                             */
+    bool ackPending;
+    bool token;                     /**< Bus: a reader may talk, the
+                                         controller got the token back.     */
+    /* Reset, see protoReset(). */
+    bool fresh;                     /**< Nothing heard from the peer since
+                                         the start.                         */
+    bool resetting;                 /**< Waiting for the peer's answer.     */
+    uint8_t epoch;                  /**< Of the own last reset.             */
+    uint8_t resetFlags;
+    uint32_t resetAt;
+    bool answerPending;
+    bool peerQuiet;                 /**< Nothing heard from the peer since
+                                         its last reset was taken.          */
+    uint8_t peerEpoch;              /**< Of the peer's last reset taken.    */
+    uint8_t answerFlags;
+    uint8_t answerAck;
+    /* COBS decoder. */
+    uint8_t code;                   /**< Code of the block being decoded.   */
+    uint8_t left;                   /**< Bytes left in the block.           */
+    bool discard;                   /**< Skipping to the next delimiter.    */
+    size_t rxlen;
+    uint8_t rx[PROTO_OVERHEAD + PROTO_TAG_SIZE + PROTO_PAYLOAD_MAX];
+    uint8_t tx[PROTO_FRAME_MAX];    /**< Frame being sent.                  */
+    /* One more for a handshake message going ahead of a full window the
+       session holds back. */
+    ProtoSlot slots[PROTO_WINDOW_MAX + 1];
+} Proto;
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void protoInit(Proto *pp, const ProtoConfig *config);
+  void protoReset(Proto *pp);
+  protoresult_t protoSend(Proto *pp, uint8_t type, const uint8_t *payload,
+                          size_t len);
+  void protoInput(Proto *pp, const uint8_t *data, size_t n);
+  uint32_t protoPoll(Proto *pp);
+  size_t protoInFlight(const Proto *pp);
+  void protoPassToken(Proto *pp);
+  void protoRun(Proto *pp, LinkDriver *lp, uint32_t timeout);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _PROTO_H_ */
@@ -0,0 +1,433 @@
+/**
+ * @file    rate.c
+ * @brief   Bit rate negotiation of the controller link.
+ */
+
+#include <string.h>
+
+#include "link/rate.h"
+
+/*
+ * Payloads: the rate message holds the attempt and the rate, the answer the
+ * attempt and 1 if accepted, the commit the attempt and the throughput. All
+ * numbers are most significant byte first.
+ */
+#define RATE_SIZE                   5
+#define ANSWER_SIZE                 2
+#define COMMIT_SIZE                 5
+
+/*===========================================================================*/
+/* Local functions.                                                          */
+/*===========================================================================*/
+
+static void put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static uint32_t get32(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+           (uint32_t)p[2] << 8 | p[3];
+}
+
+static bool primary(const LinkRate *lrp) {
+    return lrp->proto->config->primary;
+}
+
+static bool on_bus(const LinkRate *lrp) {
+    return lrp->proto->config->address != PROTO_ADDRESS_P2P;
+}
+
+static uint32_t until(uint32_t at) {
+    int32_t left = (int32_t)(at - platformNowUs());
+
+    return left > 0 ? (uint32_t)left : 0;
+}
+
+/**
+ * @brief   Frames lost or corrupted so far, as this end sees them.
+ * @details Frames to the peer only show as timeouts, each counts once however
+ *          many frames were sent again.
+ */
+static uint32_t errors(const Proto *pp) {
+    return pp->stats.crcErrors + pp->stats.framingErrors + pp->stats.timeouts;
+}
+
+/**
+ * @brief   Test frame @p probe of the current attempt.
+ * @details Every byte value shows up, zeros included, so the COBS framing
+ *          gets its share.
+ */
+static void pattern(const LinkRate *lrp, uint8_t probe, uint8_t *buf) {
+    size_t i;
+
+    for (i = 0; i < PROTO_PAYLOAD_MAX; i++) {
+        buf[i] = (uint8_t)(lrp->attempt * 31 + probe * PROTO_PAYLOAD_MAX + i);
+    }
+}
+
+static bool supported(const LinkRate *lrp, uint32_t bitrate) {
+    const LinkRateConfig *config = lrp->config;
+    size_t i;
+
+    for (i = 0; i < config->count; i++) {
+        if (config->rates[i] == bitrate) {
+            return true;
+        }
+    }
+    return bitrate == config->base;
+}
+
+static bool set(LinkRate *lrp, uint32_t bitrate) {
+    if (!lrp->config->set(lrp->config->arg, bitrate)) {
+        return false;
+    }
+    lrp->stats.bitrate = bitrate;
+    return true;
+}
+
+/**
+ * @brief   Notes the frames received and drops back to the base rate after
+ *          a silence.
+ */
+static void listen(LinkRate *lrp) {
+    const LinkRateConfig *config = lrp->config;
+
+    if (lrp->proto->stats.frames != lrp->frames) {
+        lrp->frames = lrp->proto->stats.frames;
+        lrp->heardAt = platformNowUs();
+    }
+    if (lrp->stats.bitrate != config->base &&
+        platformElapsedUs(lrp->heardAt) >= LINK_RATE_SILENCE_US) {
+        (void)set(lrp, config->base);
+        lrp->stats.throughput = 0;
+        lrp->stats.silences++;
+        lrp->state = LINK_RATE_IDLE;
+        lrp->heardAt = platformNowUs();
+    }
+}
+
+/**
+ * @brief   Controller: asks for the next faster rate, if any.
+ */
+static void ask_next(LinkRate *lrp) {
+    const LinkRateConfig *config = lrp->config;
+
+    while (lrp->next < config->count &&
+           config->rates[lrp->next] <= lrp->stats.bitrate) {
+        lrp->next++;
+    }
+    if (lrp->next == config->count) {
+        lrp->state = LINK_RATE_IDLE;
+        return;
+    }
+    lrp->trial = config->rates[lrp->next++];
+    lrp->attempt++;
+    lrp->accepted = false;
+    lrp->state = LINK_RATE_ASK;
+    lrp->deadline = platformNowUs() + LINK_RATE_TRIAL_US;
+}
+
+/**
+ * @brief   Controller: the rate on trial failed, back to the last good one.
+ */
+static void fail(LinkRate *lrp) {
+    (void)set(lrp, lrp->previous);
+    lrp->stats.failed++;
+    lrp->state = LINK_RATE_REVERT;
+    lrp->deadline = platformNowUs() + LINK_RATE_TRIAL_US;
+}
+
+/**
+ * @brief   Controller: takes an echoed probe.
+ */
+static void echoed(LinkRate *lrp, const uint8_t *payload, size_t len) {
+    uint8_t expected[PROTO_PAYLOAD_MAX];
+    uint32_t elapsed;
+
+    if (lrp->state != LINK_RATE_TRIAL || len == 0) {
+        /* Late or a keep-alive. */
+        return;
+    }
+    pattern(lrp, lrp->probesEchoed, expected);
+    if (len != PROTO_PAYLOAD_MAX || memcmp(payload, expected, len) != 0) {
+        fail(lrp);
+        return;
+    }
+    if (++lrp->probesEchoed < LINK_RATE_PROBES) {
+        return;
+    }
+    if (errors(lrp->proto) - lrp->errors > LINK_RATE_ERRORS) {
+        fail(lrp);
+        return;
+    }
+    elapsed = platformElapsedUs(lrp->probeStart);
+    lrp->stats.throughput = (uint32_t)(2ULL * LINK_RATE_PROBES *
+                                       PROTO_PAYLOAD_MAX * 1000000 /
+                                       (elapsed > 0 ? elapsed : 1));
+    lrp->state = LINK_RATE_COMMIT;
+    lrp->accepted = false;
+    lrp->deadline = platformNowUs() + LINK_RATE_TRIAL_US;
+}
+
+static uint32_t service_primary(LinkRate *lrp) {
+    uint8_t payload[PROTO_PAYLOAD_MAX];
+
+    switch (lrp->state) {
+    case LINK_RATE_ASK:
+        /* accepted tells whether the rate message went out. */
+        if (!lrp->accepted) {
+            payload[0] = lrp->attempt;
+            put32(&payload[1], lrp->trial);
+            if (protoSend(lrp->proto, PROTO_MSG_RATE, payload, RATE_SIZE) !=
+                    PROTO_OK) {
+                return LINK_WAIT_FOREVER;
+            }
+            lrp->accepted = true;
+        }
+        if (until(lrp->deadline) == 0) {
+            /* No answer, the reader falls back on its own if it switched. */
+            lrp->stats.failed++;
+            lrp->state = LINK_RATE_REVERT;
+            lrp->deadline = platformNowUs() + LINK_RATE_TRIAL_US;
+        }
+        return until(lrp->deadline);
+    case LINK_RATE_GUARD:
+        if (until(lrp->deadline) > 0) {
+            return until(lrp->deadline);
+        }
+        lrp->state = LINK_RATE_TRIAL;
+        lrp->probeStart = platformNowUs();
+        lrp->deadline += LINK_RATE_TRIAL_US - LINK_RATE_GUARD_US;
+        /* Falls through. */
+    case LINK_RATE_TRIAL:
+        while (lrp->probesSent < LINK_RATE_PROBES) {
+            pattern(lrp, lrp->probesSent, payload);
+            if (protoSend(lrp->proto, PROTO_MSG_PROBE, payload,
+                          PROTO_PAYLOAD_MAX) != PROTO_OK) {
+                break;
+            }
+            lrp->probesSent++;
+        }
+        if (until(lrp->deadline) == 0) {
+            fail(lrp);
+        }
+        return until(lrp->deadline);
+    case LINK_RATE_COMMIT:
+        if (!lrp->accepted) {
+            payload[0] = lrp->attempt;
+            put32(&payload[1], lrp->stats.throughput);
+            if (protoSend(lrp->proto, PROTO_MSG_RATE_COMMIT, payload,
+                          COMMIT_SIZE) == PROTO_OK) {
+                lrp->accepted = true;
+            }
+        }
+        if (lrp->accepted && protoInFlight(lrp->proto) == 0) {
+            ask_next(lrp);
+            return 0;
+        }
+        if (until(lrp->deadline) == 0) {
+            fail(lrp);
+        }
+        return until(lrp->deadline);
+    case LINK_RATE_REVERT:
+        if (until(lrp->deadline) > 0) {
+            return until(lrp->deadline);
+        }
+        lrp->state = LINK_RATE_IDLE;
+        /* Falls through. */
+    case LINK_RATE_IDLE:
+    default:
+        break;
+    }
+
+    if (lrp->stats.bitrate == lrp->config->base) {
+        return LINK_WAIT_FOREVER;
+    }
+    if (platformElapsedUs(lrp->heardAt) >= LINK_RATE_SILENCE_US / 4 &&
+        platformElapsedUs(lrp->keptAliveAt) >= LINK_RATE_SILENCE_US / 4 &&
+        protoSend(lrp->proto, PROTO_MSG_PROBE, NULL, 0) == PROTO_OK) {
+        lrp->keptAliveAt = platformNowUs();
+    }
+    return LINK_RATE_SILENCE_US / 4;
+}
+
+static uint32_t service_secondary(LinkRate *lrp) {
+    uint8_t payload[PROTO_PAYLOAD_MAX];
+
+    switch (lrp->state) {
+    case LINK_RATE_ASK:
+        payload[0] = lrp->attempt;
+        payload[1] = lrp->accepted ? 1 : 0;
+        if (protoSend(lrp->proto, PROTO_MSG_RATE_ANSWER, payload,
+                      ANSWER_SIZE) != PROTO_OK) {
+            return LINK_WAIT_FOREVER;
+        }
+        if (!lrp->accepted) {
+            lrp->state = LINK_RATE_IDLE;
+            return LINK_WAIT_FOREVER;
+        }
+        lrp->state = LINK_RATE_SWITCH;
+        /* Falls through. */
+    case LINK_RATE_SWITCH:
+        /* The answer is out at the old rate by now. */
+        if (!set(lrp, lrp->trial)) {
+            lrp->state = LINK_RATE_IDLE;
+            return LINK_WAIT_FOREVER;
+        }
+        lrp->stats.trials++;
+        lrp->state = LINK_RATE_TRIAL;
+        lrp->deadline = platformNowUs() + LINK_RATE_TRIAL_US;
+        lrp->probesSent = 0;
+        lrp->probesEchoed = 0;
+        /* Falls through. */
+    case LINK_RATE_TRIAL:
+        /* probesSent counts the probes received, probesEchoed the echoes. */
+        while (lrp->probesEchoed < lrp->probesSent) {
+            pattern(lrp, lrp->probesEchoed, payload);
+            if (protoSend(lrp->proto, PROTO_MSG_PROBE, payload,
+                          PROTO_PAYLOAD_MAX) != PROTO_OK) {
+                break;
+            }
+            lrp->probesEchoed++;
+        }
+        if (until(lrp->deadline) == 0) {
+            (void)set(lrp, lrp->previous);
+            lrp->stats.failed++;
+            lrp->state = LINK_RATE_IDLE;
+            return LINK_WAIT_FOREVER;
+        }
+        return until(lrp->deadline);
+    default:
+        return LINK_WAIT_FOREVER;
+    }
+}
+
+static bool receive_primary(LinkRate *lrp, uint8_t type,
+                            const uint8_t *payload, size_t len) {
+    switch (type) {
+    case PROTO_MSG_RATE_ANSWER:
+        if (lrp->state != LINK_RATE_ASK || len != ANSWER_SIZE ||
+            payload[0] != lrp->attempt) {
+            return true;
+        }
+        if (payload[1] == 0) {
+            lrp->stats.refused++;
+            ask_next(lrp);
+            return true;
+        }
+        lrp->previous = lrp->stats.bitrate;
+        if (!set(lrp, lrp->trial)) {
+            fail(lrp);
+            return true;
+        }
+        lrp->stats.trials++;
+        lrp->errors = errors(lrp->proto);
+        lrp->probesSent = 0;
+        lrp->probesEchoed = 0;
+        lrp->state = LINK_RATE_GUARD;
+        lrp->deadline = platformNowUs() + LINK_RATE_GUARD_US;
+        return true;
+    case PROTO_MSG_PROBE:
+        echoed(lrp, payload, len);
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool receive_secondary(LinkRate *lrp, uint8_t type,
+                              const uint8_t *payload, size_t len) {
+    switch (type) {
+    case PROTO_MSG_RATE:
+        if (len != RATE_SIZE) {
+            return true;
+        }
+        if (lrp->state != LINK_RATE_SWITCH && lrp->state != LINK_RATE_TRIAL) {
+            lrp->previous = lrp->stats.bitrate;
+        }
+        lrp->attempt = payload[0];
+        lrp->trial = get32(&payload[1]);
+        lrp->accepted = !on_bus(lrp) && supported(lrp, lrp->trial);
+        lrp->state = LINK_RATE_ASK;
+        return true;
+    case PROTO_MSG_PROBE:
+        /* Keep-alives are answered by the acknowledgement. */
+        if (lrp->state == LINK_RATE_TRIAL && len > 0) {
+            lrp->probesSent++;
+        }
+        return true;
+    case PROTO_MSG_RATE_COMMIT:
+        if (lrp->state == LINK_RATE_TRIAL && len == COMMIT_SIZE &&
+            payload[0] == lrp->attempt) {
+            lrp->stats.throughput = get32(&payload[1]);
+            lrp->state = LINK_RATE_IDLE;
+        }
+        return true;
+    default:
+        return false;
+    }
+}
+
+/*===========================================================================*/
+/* Exported functions.                                                       */
+/*===========================================================================*/
+
+/**
+ * @brief   Initializes the negotiation of the end running @p pp, with its
+ *          UART at the base rate.
+ */
+void linkRateInit(LinkRate *lrp, const LinkRateConfig *config, Proto *pp) {
+    memset(lrp, 0, sizeof(*lrp));
+    lrp->config = config;
+    lrp->proto = pp;
+    lrp->stats.bitrate = config->base;
+    lrp->frames = pp->stats.frames;
+    lrp->heardAt = platformNowUs();
+    lrp->keptAliveAt = platformNowUs();
+}
+
+/**
+ * @brief   Controller: tries the rates faster than the current one.
+ * @details Does nothing on a bus or while a negotiation runs.
+ */
+void linkRateStart(LinkRate *lrp) {
+    if (!primary(lrp) || on_bus(lrp) || lrp->state != LINK_RATE_IDLE) {
+        return;
+    }
+    lrp->next = 0;
+    ask_next(lrp);
+}
+
+/**
+ * @brief   Takes a message received by the protocol.
+ *
+ * @return  @p false if it is not a negotiation message, to be handled by
+ *          the caller.
+ */
+bool linkRateReceive(LinkRate *lrp, uint8_t type, const uint8_t *payload,
+                     size_t len) {
+    if (primary(lrp)) {
+        return receive_primary(lrp, type, payload, len);
+    }
+    return receive_secondary(lrp, type, payload, len);
+}
+
+/**
+ * @brief   Sends what the negotiation has to send, switches the rate and
+ *          runs the timeouts.
+ * @details Call it from the thread running the protocol, e.g. from the
+ *          service function of @p protoRun().
+ *
+ * @return  Microseconds until it wants to run again, @p LINK_WAIT_FOREVER
+ *          if only after a message.
+ */
+uint32_t linkRateService(LinkRate *lrp) {
+    listen(lrp);
+    if (primary(lrp)) {
+        return service_primary(lrp);
+    }
+    return service_secondary(lrp);
+}
@@ -0,0 +1,179 @@
+/**
+ * @file    rate.h
+ * @brief   Bit rate negotiation of the controller link.
+ *
+ * @details Both ends start at a base rate which every reader and cable
+ *          carries. The controller then tries faster rates one by one,
+ *          slowest first, over the protocol of @p link/proto.h:
+ *
+ *          - It sends @p PROTO_MSG_RATE with the rate to try. The reader
+ *            answers with @p PROTO_MSG_RATE_ANSWER, refusing rates missing
+ *            from its own list, and switches once the answer is out. The
+ *            controller switches when the answer comes in.
+ *          - After a guard time the controller sends @p LINK_RATE_PROBES
+ *            test frames of the longest payload, which the reader echoes.
+ *            If all come back intact with at most @p LINK_RATE_ERRORS
+ *            frames lost or corrupted in either direction, the controller
+ *            sends @p PROTO_MSG_RATE_COMMIT with the payload throughput the
+ *            probes reached, and both ends keep the rate.
+ *          - Otherwise the controller goes back to the last good rate and
+ *            stops. The reader does the same once @p LINK_RATE_TRIAL_US
+ *            pass without a commit, so neither end needs to hear the other
+ *            to fall back.
+ *
+ *          Either end which hears no intact frame for
+ *          @p LINK_RATE_SILENCE_US at a negotiated rate returns to the base
+ *          rate, e.g. after a commit the controller never saw
+ *          acknowledged. The controller sends an empty probe after a
+ *          quarter of that silence to keep a quiet link up.
+ *
+ *          Only point-to-point lines are negotiated, all readers of a bus
+ *          keep the base rate.
+ */
+
+#ifndef _LINK_RATE_H_
+#define _LINK_RATE_H_
+
+#include "link/proto.h"
+
+/*===========================================================================*/
+/* Pre-compile time settings.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Test frames sent at every rate tried.
+ */
+#if !defined(LINK_RATE_PROBES) || defined(__DOXYGEN__)
+#define LINK_RATE_PROBES            8
+#endif
+
+/**
+ * @brief   Frames lost or corrupted, in either direction, a trial still
+ *          passes with.
+ * @details Above the rate a cable carries nearly every frame suffers, one
+ *          tolerated error keeps a noisy line from stopping short of it.
+ */
+#if !defined(LINK_RATE_ERRORS) || defined(__DOXYGEN__)
+#define LINK_RATE_ERRORS            1
+#endif
+
+/**
+ * @brief   Time a rate has to prove itself, from the switch to the commit.
+ * @details Covers the probes and their echoes at the slowest rate tried.
+ */
+#if !defined(LINK_RATE_TRIAL_US) || defined(__DOXYGEN__)
+#define LINK_RATE_TRIAL_US          300000
+#endif
+
+/**
+ * @brief   Wait of the controller between its switch and the first probe,
+ *          for the reader to switch as well.
+ */
+#if !defined(LINK_RATE_GUARD_US) || defined(__DOXYGEN__)
+#define LINK_RATE_GUARD_US          2000
+#endif
+
+/**
+ * @brief   Silence after which an end drops back to the base rate.
+ */
+#if !defined(LINK_RATE_SILENCE_US) || defined(__DOXYGEN__)
+#define LINK_RATE_SILENCE_US        2000000
+#endif
+
+/*===========================================================================*/
+/* Data structures and types.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Switches the own UART to @p bitrate.
+ * @details Called from the thread running the protocol, once the frames
+ *          sent before are out.
+ */
+typedef bool (*linkratesetcb_t)(void *arg, uint32_t bitrate);
+
+/**
+ * @brief   Negotiation configuration.
+ */
+typedef struct {
+    const uint32_t *rates;          /**< Rates above @p base this end can
+                                         run at, ascending.                 */
+    size_t count;
+    uint32_t base;                  /**< Starting and fallback rate.        */
+    linkratesetcb_t set;
+    void *arg;                      /**< Passed to @p set.                  */
+} LinkRateConfig;
+
+/**
+ * @brief   Negotiation counters and results.
+ */
+typedef struct {
+    uint32_t bitrate;               /**< Current rate.                      */
+    uint32_t throughput;            /**< Payload bytes per second, both ways
+                                         together, the probes reached at
+                                         @p bitrate, 0 if not measured.     */
+    uint32_t trials;                /**< Rates switched to on trial.        */
+    uint32_t refused;               /**< Rates the reader does not run at.  */
+    uint32_t failed;                /**< Trials which fell back.            */
+    uint32_t silences;              /**< Returns to the base rate.          */
+} LinkRateStats;
+
+/**
+ * @brief   Negotiation states.
+ */
+typedef enum {
+    LINK_RATE_IDLE = 0,             /**< Not negotiating.                   */
+    LINK_RATE_ASK = 1,              /**< Controller: rate sent, waiting for
+                                         the answer. Reader: answer to
+                                         send.                              */
+    LINK_RATE_SWITCH = 2,           /**< Reader: answer sent, to switch.    */
+    LINK_RATE_GUARD = 3,            /**< Controller: switched, the reader
+                                         may not have yet.                  */
+    LINK_RATE_TRIAL = 4,            /**< Probing the rate.                  */
+    LINK_RATE_COMMIT = 5,           /**< Controller: commit sent, waiting
+                                         for its acknowledgement.           */
+    LINK_RATE_REVERT = 6,           /**< Controller: fell back, waiting for
+                                         the reader's trial to end.         */
+} linkratestate_t;
+
+/**
+ * @brief   Negotiation state of one end.
+ */
+typedef struct {
+    const LinkRateConfig *config;
+    Proto *proto;
+    LinkRateStats stats;
+    linkratestate_t state;
+    uint8_t attempt;                /**< Tells the answers of old trials
+                                         apart.                             */
+    bool accepted;                  /**< Reader: the answer. Controller: the
+                                         message of the state is out.       */
+    size_t next;                    /**< Controller: rate to try next.      */
+    uint32_t trial;                 /**< Rate on trial.                     */
+    uint32_t previous;              /**< Rate to fall back to.              */
+    uint32_t deadline;              /**< End of the state.                  */
+    uint32_t probeStart;
+    uint8_t probesSent;
+    uint8_t probesEchoed;
+    uint32_t errors;                /**< Protocol errors at the switch.     */
+    uint32_t frames;                /**< Frames received, last seen.        */
+    uint32_t heardAt;               /**< Last intact frame received.        */
+    uint32_t keptAliveAt;           /**< Controller: last empty probe.      */
+} LinkRate;
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void linkRateInit(LinkRate *lrp, const LinkRateConfig *config, Proto *pp);
+  void linkRateStart(LinkRate *lrp);
+  bool linkRateReceive(LinkRate *lrp, uint8_t type, const uint8_t *payload,
+                       size_t len);
+  uint32_t linkRateService(LinkRate *lrp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _LINK_RATE_H_ */
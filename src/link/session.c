@@ -0,0 +1,351 @@
+/**
+ * @file    session.c
+ * @brief   Authenticated encryption of the controller link.
+ */
+
+#include <string.h>
+
+#include "link/session.h"
+
+/*===========================================================================*/
+/* Local definitions.                                                        */
+/*===========================================================================*/
+
+#define ANSWER_SIZE                 (LINK_SESSION_NONCE_SIZE + PROTO_TAG_SIZE)
+
+/* Additional data of a message: address and type. */
+#define AAD_ADDRESS                 0
+#define AAD_TYPE                    1
+#define AAD_NONCES                  2
+#define AAD_SIZE                    (AAD_NONCES + 2 * LINK_SESSION_NONCE_SIZE)
+
+/*===========================================================================*/
+/* Local functions.                                                          */
+/*===========================================================================*/
+
+static bool primary(const LinkSession *lsp) {
+    return lsp->proto->config->primary;
+}
+
+/**
+ * @brief   Nonce of message @p number in the direction from the controller,
+ *          or from the reader.
+ * @details Message 0 of either direction is its handshake tag.
+ */
+static void message_nonce(uint8_t *nonce, bool fromReader, uint32_t number) {
+    memset(nonce, 0, CHACHAPOLY_NONCE_SIZE);
+    nonce[0] = fromReader ? 1 : 0;
+    nonce[4] = (uint8_t)number;
+    nonce[5] = (uint8_t)(number >> 8);
+    nonce[6] = (uint8_t)(number >> 16);
+    nonce[7] = (uint8_t)(number >> 24);
+}
+
+/**
+ * @brief   Additional data: the reader's address, @p type and, for the
+ *          handshake tags, the nonces.
+ */
+static size_t aad(const LinkSession *lsp, uint8_t type, bool nonces,
+                  uint8_t *out) {
+    out[AAD_ADDRESS] = lsp->proto->config->address;
+    out[AAD_TYPE] = type;
+    if (!nonces) {
+        return AAD_NONCES;
+    }
+    memcpy(&out[AAD_NONCES], lsp->nonces, sizeof(lsp->nonces));
+    return AAD_SIZE;
+}
+
+/**
+ * @brief   Draws the own nonce of a handshake.
+ * @details The block is computed on a copy of the seed, outside the lock.
+ *
+ * @return  @p false without entropy yet.
+ */
+static bool draw(LinkSession *lsp, uint8_t *out) {
+    uint8_t seed[CHACHA20_KEY_SIZE];
+    uint8_t nonce[CHACHA20_NONCE_SIZE];
+    uint8_t block[CHACHA20_BLOCK_SIZE];
+
+    platformLock();
+    if (!lsp->seeded) {
+        platformUnlock();
+        return false;
+    }
+    memcpy(seed, lsp->seed, sizeof(seed));
+    message_nonce(nonce, false, lsp->draws++);
+    platformUnlock();
+    chacha20Block(seed, nonce, 0, block);
+    memcpy(out, block, LINK_SESSION_NONCE_SIZE);
+    return true;
+}
+
+/**
+ * @brief   Tag of message 0 of the own direction, over the nonces.
+ */
+static void handshake_tag(LinkSession *lsp, uint8_t type, bool fromReader,
+                          uint8_t *tag) {
+    uint8_t nonce[CHACHAPOLY_NONCE_SIZE];
+    uint8_t data[AAD_SIZE];
+
+    message_nonce(nonce, fromReader, 0);
+    chachaPolySeal(lsp->sessionKey, nonce, data,
+                   aad(lsp, type, true, data), NULL, 0, tag);
+}
+
+static bool handshake_check(LinkSession *lsp, uint8_t type, bool fromReader,
+                            const uint8_t *tag) {
+    uint8_t nonce[CHACHAPOLY_NONCE_SIZE];
+    uint8_t data[AAD_SIZE];
+
+    message_nonce(nonce, fromReader, 0);
+    return chachaPolyOpen(lsp->sessionKey, nonce, data,
+                          aad(lsp, type, true, data), tag, PROTO_TAG_SIZE,
+                          NULL);
+}
+
+static void derive(LinkSession *lsp) {
+    chacha20Derive(lsp->key, lsp->nonces, lsp->sessionKey);
+    lsp->sent = 0;
+    lsp->received = 0;
+}
+
+/**
+ * @brief   Sends the handshake message of the state, if any is due and the
+ *          protocol takes it.
+ */
+static void send_due(LinkSession *lsp) {
+    uint8_t payload[ANSWER_SIZE];
+    uint8_t *own = &lsp->nonces[primary(lsp) ? 0 : LINK_SESSION_NONCE_SIZE];
+
+    switch (lsp->state) {
+    case LINK_SESSION_HELLO:
+        /* The nonce is only drawn once the protocol has room, the
+           handshake may take a slot over the window. */
+        if (protoInFlight(lsp->proto) > lsp->proto->config->window ||
+            !draw(lsp, own)) {
+            return;
+        }
+        if (primary(lsp)) {
+            (void)protoSend(lsp->proto, PROTO_MSG_HELLO, own,
+                            LINK_SESSION_NONCE_SIZE);
+        } else {
+            derive(lsp);
+            memcpy(payload, own, LINK_SESSION_NONCE_SIZE);
+            handshake_tag(lsp, PROTO_MSG_HELLO_ANSWER, true,
+                          &payload[LINK_SESSION_NONCE_SIZE]);
+            (void)protoSend(lsp->proto, PROTO_MSG_HELLO_ANSWER, payload,
+                            ANSWER_SIZE);
+        }
+        lsp->state = LINK_SESSION_WAIT;
+        return;
+    case LINK_SESSION_CONFIRM:
+        handshake_tag(lsp, PROTO_MSG_HELLO_DONE, false, payload);
+        if (protoSend(lsp->proto, PROTO_MSG_HELLO_DONE, payload,
+                      PROTO_TAG_SIZE) == PROTO_OK) {
+            lsp->state = LINK_SESSION_READY;
+            lsp->stats.handshakes++;
+        }
+        return;
+    default:
+        return;
+    }
+}
+
+/*===========================================================================*/
+/* Exported functions.                                                       */
+/*===========================================================================*/
+
+/**
+ * @brief   Attaches a closed session to @p pp, which then seals its
+ *          messages.
+ *
+ * @param[in] key       @p LINK_SESSION_KEY_SIZE bytes shared with the peer,
+ *                      must stay valid.
+ */
+void linkSessionInit(LinkSession *lsp, Proto *pp, const uint8_t *key) {
+    memset(lsp, 0, sizeof(*lsp));
+    lsp->proto = pp;
+    lsp->key = key;
+    pp->session = lsp;
+}
+
+/**
+ * @brief   Stirs @p entropy into the seed of the nonces.
+ * @details Takes 16 bytes at a time through HChaCha20 keyed with the seed so
+ *          far. The lock is only held to copy the seed and to put the new
+ *          one in place, which is done over if another thread stirred in
+ *          between. May be called from any thread, more than once.
+ */
+void linkSessionSeed(LinkSession *lsp, const uint8_t *entropy, size_t len) {
+    uint8_t input[CHACHA20_DERIVE_INPUT_SIZE];
+    uint8_t seed[CHACHA20_KEY_SIZE];
+
+    while (len > 0) {
+        size_t n = len < sizeof(input) ? len : sizeof(input);
+        uint32_t stirs;
+        bool stirred;
+
+        memset(input, 0, sizeof(input));
+        memcpy(input, entropy, n);
+        do {
+            platformLock();
+            memcpy(seed, lsp->seed, sizeof(seed));
+            stirs = lsp->stirs;
+            platformUnlock();
+            chacha20Derive(seed, input, seed);
+            platformLock();
+            stirred = lsp->stirs == stirs;
+            if (stirred) {
+                memcpy(lsp->seed, seed, sizeof(seed));
+                lsp->stirs++;
+                lsp->seeded = true;
+            }
+            platformUnlock();
+        } while (!stirred);
+        entropy += n;
+        len -= n;
+    }
+}
+
+/**
+ * @brief   Controller: starts a handshake, dropping any session.
+ * @details Over a session, or a handshake, the protocol resets first: the
+ *          messages in flight either way were sealed under the old key, the
+ *          peer would drop them unacknowledged and the handshake could not
+ *          pass them. They go again after the handshake, see
+ *          @p protoReset().
+ */
+void linkSessionStart(LinkSession *lsp) {
+    if (lsp->state != LINK_SESSION_CLOSED) {
+        protoReset(lsp->proto);
+    }
+    lsp->state = LINK_SESSION_HELLO;
+    send_due(lsp);
+}
+
+/**
+ * @brief   The protocol reset, for the protocol.
+ * @details The peer restarted or gives up the session: the controller starts
+ *          a handshake, the reader waits for one.
+ */
+void linkSessionReset(LinkSession *lsp) {
+    lsp->state = primary(lsp) ? LINK_SESSION_HELLO : LINK_SESSION_CLOSED;
+}
+
+/**
+ * @brief   Sends the handshake message due, once there is entropy and room
+ *          in the protocol window.
+ * @details Call it from the thread running the protocol, e.g. from the
+ *          service function of @p protoRun().
+ *
+ * @return  @p LINK_WAIT_FOREVER, it has nothing to wait for.
+ */
+uint32_t linkSessionService(LinkSession *lsp) {
+    send_due(lsp);
+    return LINK_WAIT_FOREVER;
+}
+
+/**
+ * @brief   Seals the next message to the peer, for the protocol.
+ *
+ * @param[out] out      @p len plus @p PROTO_TAG_SIZE bytes.
+ * @return  @p false if the session is not up yet.
+ */
+bool linkSessionSeal(LinkSession *lsp, uint8_t type, const uint8_t *in,
+                     size_t len, uint8_t *out) {
+    uint8_t nonce[CHACHAPOLY_NONCE_SIZE];
+    uint8_t data[AAD_SIZE];
+    uint32_t start = platformCycles();
+
+    if (lsp->state != LINK_SESSION_READY) {
+        return false;
+    }
+    message_nonce(nonce, !primary(lsp), ++lsp->sent);
+    chachaPolySeal(lsp->sessionKey, nonce, data, aad(lsp, type, false, data),
+                   in, len, out);
+    lsp->stats.sealed++;
+    lsp->stats.cycles += platformElapsedCycles(start);
+    return true;
+}
+
+/**
+ * @brief   Decrypts a message sealed and not acknowledged in place, for the
+ *          protocol taking it back on a reset.
+ *
+ * @param[in] back      Messages sealed after it.
+ */
+void linkSessionUnseal(LinkSession *lsp, uint8_t *buf, size_t len,
+                       uint32_t back) {
+    uint8_t nonce[CHACHAPOLY_NONCE_SIZE];
+
+    message_nonce(nonce, !primary(lsp), lsp->sent - back);
+    chacha20Xor(lsp->sessionKey, nonce, 1, buf, buf, len);
+}
+
+/**
+ * @brief   Checks and decrypts the next message from the peer in place, for
+ *          the protocol.
+ *
+ * @return  @p false if it failed its tag or the session is not up.
+ */
+bool linkSessionOpen(LinkSession *lsp, uint8_t type, uint8_t *buf,
+                     size_t len) {
+    uint8_t nonce[CHACHAPOLY_NONCE_SIZE];
+    uint8_t data[AAD_SIZE];
+    uint32_t start = platformCycles();
+    bool ok;
+
+    if (lsp->state != LINK_SESSION_READY) {
+        lsp->stats.rejected++;
+        return false;
+    }
+    message_nonce(nonce, primary(lsp), lsp->received + 1);
+    ok = chachaPolyOpen(lsp->sessionKey, nonce, data,
+                        aad(lsp, type, false, data), buf, len, buf);
+    lsp->stats.cycles += platformElapsedCycles(start);
+    if (!ok) {
+        lsp->stats.rejected++;
+        return false;
+    }
+    lsp->received++;
+    lsp->stats.opened++;
+    return true;
+}
+
+/**
+ * @brief   Takes a handshake message, delivered by the protocol.
+ */
+void linkSessionReceive(LinkSession *lsp, uint8_t type,
+                        const uint8_t *payload, size_t len) {
+    uint8_t *peer = &lsp->nonces[primary(lsp) ? LINK_SESSION_NONCE_SIZE : 0];
+
+    if (!primary(lsp) && type == PROTO_MSG_HELLO &&
+        len == LINK_SESSION_NONCE_SIZE) {
+        /* A new session, even over a running one. */
+        memcpy(peer, payload, LINK_SESSION_NONCE_SIZE);
+        lsp->state = LINK_SESSION_HELLO;
+        send_due(lsp);
+    } else if (primary(lsp) && type == PROTO_MSG_HELLO_ANSWER &&
+               len == ANSWER_SIZE && lsp->state == LINK_SESSION_WAIT) {
+        memcpy(peer, payload, LINK_SESSION_NONCE_SIZE);
+        derive(lsp);
+        if (!handshake_check(lsp, type, true,
+                             &payload[LINK_SESSION_NONCE_SIZE])) {
+            lsp->stats.rejected++;
+            lsp->state = LINK_SESSION_CLOSED;
+            return;
+        }
+        lsp->state = LINK_SESSION_CONFIRM;
+        send_due(lsp);
+    } else if (!primary(lsp) && type == PROTO_MSG_HELLO_DONE &&
+               len == PROTO_TAG_SIZE && lsp->state == LINK_SESSION_WAIT) {
+        if (!handshake_check(lsp, type, false, payload)) {
+            lsp->stats.rejected++;
+            lsp->state = LINK_SESSION_CLOSED;
+            return;
+        }
+        lsp->state = LINK_SESSION_READY;
+        lsp->stats.handshakes++;
+    }
+}
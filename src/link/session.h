@@ -0,0 +1,129 @@
+/**
+ * @file    session.h
+ * @brief   Authenticated encryption of the controller link.
+ *
+ * @details Every reader shares a key with the controller. At link-up the
+ *          two derive a session key from it and a fresh nonce of each:
+ *
+ *          - The controller sends @p PROTO_MSG_HELLO with its nonce.
+ *          - The reader answers @p PROTO_MSG_HELLO_ANSWER with its nonce
+ *            and a tag under the session key over both nonces, proving it
+ *            holds the shared key.
+ *          - The controller checks the tag and confirms with
+ *            @p PROTO_MSG_HELLO_DONE, a tag of its own.
+ *
+ *          The session key is HChaCha20 of the shared key and the two
+ *          nonces. From then on the protocol seals every other message with
+ *          ChaCha20-Poly1305 under the session key: the payload is
+ *          encrypted, the payload, the type and the reader's bus address
+ *          are authenticated, and @p PROTO_TAG_SIZE bytes of tag are added.
+ *          The nonce is the direction and the number of the message, which
+ *          both ends count as the protocol delivers every message once and
+ *          in order, so it never goes on the wire. A message failing its
+ *          tag is dropped unacknowledged, as if corrupted.
+ *
+ *          A new handshake resets the protocol, see @p protoReset(): the
+ *          messages in flight are taken back, decrypted, and sealed again
+ *          under the new key after the handshake, which goes ahead of them.
+ *
+ *          Each end draws its nonces from a seed stirred with entropy, see
+ *          @p linkSessionSeed(); before the first entropy the handshake
+ *          waits for some. Messages other than the handshake wait until the
+ *          session is up, @p protoSend() returns @p PROTO_CLOSED until then.
+ */
+
+#ifndef _LINK_SESSION_H_
+#define _LINK_SESSION_H_
+
+#include "crypto/chachapoly.h"
+#include "link/proto.h"
+
+#if CHACHAPOLY_TAG_SIZE != PROTO_TAG_SIZE
+#error "PROTO_TAG_SIZE must be the tag size of ChaCha20-Poly1305"
+#endif
+
+/*===========================================================================*/
+/* Constants.                                                                */
+/*===========================================================================*/
+
+#define LINK_SESSION_KEY_SIZE       CHACHAPOLY_KEY_SIZE
+
+/**
+ * @brief   Nonce of each end in the handshake.
+ */
+#define LINK_SESSION_NONCE_SIZE     8
+
+/*===========================================================================*/
+/* Data structures and types.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Session counters.
+ */
+typedef struct {
+    uint32_t handshakes;            /**< Sessions set up.                   */
+    uint32_t rejected;              /**< Messages and handshakes failing
+                                         their tag.                         */
+    uint32_t sealed;
+    uint32_t opened;
+    uint32_t cycles;                /**< Spent sealing and opening, see
+                                         @p platformCycles().               */
+} LinkSessionStats;
+
+/**
+ * @brief   Session states.
+ */
+typedef enum {
+    LINK_SESSION_CLOSED = 0,        /**< No session, nothing to send.       */
+    LINK_SESSION_HELLO = 1,         /**< Controller: hello to send.
+                                         Reader: answer to send.            */
+    LINK_SESSION_WAIT = 2,          /**< Waiting for the answer, or for the
+                                         controller's confirmation.         */
+    LINK_SESSION_CONFIRM = 3,       /**< Controller: confirmation to send.  */
+    LINK_SESSION_READY = 4,         /**< Messages are sealed.               */
+} linksessionstate_t;
+
+/**
+ * @brief   Session state of one end.
+ */
+typedef struct link_session {
+    Proto *proto;
+    const uint8_t *key;             /**< Shared with the peer.              */
+    LinkSessionStats stats;
+    linksessionstate_t state;
+    bool seeded;                    /**< Some entropy arrived.              */
+    uint8_t seed[CHACHA20_KEY_SIZE];
+    uint32_t draws;                 /**< Nonces drawn from @p seed.         */
+    uint32_t stirs;                 /**< Entropy stirred into @p seed.      */
+    /* The controller's nonce, then the reader's. */
+    uint8_t nonces[2 * LINK_SESSION_NONCE_SIZE];
+    uint8_t sessionKey[LINK_SESSION_KEY_SIZE];
+    uint32_t sent;                  /**< Messages sealed with the key.      */
+    uint32_t received;              /**< Messages opened with the key.      */
+} LinkSession;
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void linkSessionInit(LinkSession *lsp, Proto *pp, const uint8_t *key);
+  void linkSessionSeed(LinkSession *lsp, const uint8_t *entropy, size_t len);
+  void linkSessionStart(LinkSession *lsp);
+  uint32_t linkSessionService(LinkSession *lsp);
+  void linkSessionReset(LinkSession *lsp);
+  bool linkSessionSeal(LinkSession *lsp, uint8_t type, const uint8_t *in,
+                       size_t len, uint8_t *out);
+  void linkSessionUnseal(LinkSession *lsp, uint8_t *buf, size_t len,
+                         uint32_t back);
+  bool linkSessionOpen(LinkSession *lsp, uint8_t type, uint8_t *buf,
+                       size_t len);
+  void linkSessionReceive(LinkSession *lsp, uint8_t type,
+                          const uint8_t *payload, size_t len);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _LINK_SESSION_H_ */
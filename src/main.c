@@ -1,6 +1,453 @@
+#include <string.h>
+
 #include "ch.h"
 #include "hal.h"
 
+#include "drivers/audio_hw.h"
+#include "drivers/flash_hw.h"
+#include "drivers/link_hw.h"
+#include "drivers/mfrc522_hw.h"
+#include "link/proto.h"
+#include "link/rate.h"
+#include "link/session.h"
+#include "reader/aclstore.h"
+#include "reader/event.h"
+#include "reader/feedback.h"
+#include "reader/outbox.h"
+#include "reader/poll.h"
+
+// Address on a multi-drop controller bus, PROTO_ADDRESS_P2P on a
+// point-to-point line.
+#if !defined(READER_BUS_ADDRESS)
+#define READER_BUS_ADDRESS          PROTO_ADDRESS_P2P
+#endif
+
+// Key shared with the controller, LINK_SESSION_KEY_SIZE comma-separated
+// bytes. The link is encrypted and authenticated if it is set, see
+// link/session.h.
+#if defined(READER_LINK_KEY)
+static const uint8_t linkKey[LINK_SESSION_KEY_SIZE] = {READER_LINK_KEY};
+static LinkSession session;
+
+// Random numbers of the MFRC522 stirred into the session nonces at start-up.
+#define READER_ENTROPY_DRAWS        4
+#endif
+
+// Decide on the cards with the access list in flash even while the
+// controller is there, it still gets the events. Without the controller the
+// reader always decides.
+#if !defined(READER_ACL_FAST_PATH)
+#define READER_ACL_FAST_PATH        FALSE
+#endif
+
+// Show the decision from the access list as soon as a card arrives while
+// the controller is there, and reconcile it with the controller's feedback
+// (see reader/feedback.h). READER_FEEDBACK_FOLLOW shows the controller's
+// decision where they differ, READER_FEEDBACK_REVOKE only takes wrong grants
+// back, READER_FEEDBACK_KEEP leaves the guess.
+#if !defined(READER_SPECULATE)
+#define READER_SPECULATE            FALSE
+#endif
+#if !defined(READER_SPECULATE_CORRECTION)
+#define READER_SPECULATE_CORRECTION READER_FEEDBACK_FOLLOW
+#endif
+
+// The controller is taken as gone once a message has waited this long for
+// its acknowledgement.
+#if !defined(READER_OFFLINE_US)
+#define READER_OFFLINE_US           2000000
+#endif
+
+// How long the LEDs show a decision.
+#define READER_LOCAL_FEEDBACK_US    1500000
+
+// Access list deltas the link thread holds for the rfid thread, which owns
+// the store. A delta arriving with the queue full is refused as busy.
+#define READER_ACL_QUEUE            4
+
+// A front-end which does not start is tried again after this long, then
+// twice as long each time up to READER_RFID_RETRY_MAX_US.
+#define READER_RFID_RETRY_US        10000
+#define READER_RFID_RETRY_MAX_US    5000000
+
+// Longest wait between two compaction steps of the access list. A step
+// stalls the CPU for up to 40 ms, see drivers/flash_hw.h.
+#define READER_ACL_STEP_US          20000
+
+typedef struct {
+    uint8_t len;
+    uint8_t data[PROTO_PAYLOAD_MAX];
+} AclDelta;
+
+static void link_send(void *arg, const uint8_t *frame, size_t len);
+static void controller_receive(void *arg, uint8_t type,
+                               const uint8_t *payload, size_t len);
+static uint32_t link_service(void *arg);
+static void link_wakeup(void *arg);
+static bool link_set_bitrate(void *arg, uint32_t bitrate);
+static void signal_feedback(const uint8_t *payload, size_t len);
+
+static ReaderPresence presence;
+static ReaderPoll scheduler;
+static Proto proto;
+static const ProtoConfig protoConfig = {
+    link_send, controller_receive, link_service, &LINKD1, PROTO_WINDOW_MAX,
+    PROTO_RETRANSMIT_US, READER_BUS_ADDRESS, false
+};
+static bool statusRequested;
+static ReaderOutbox outbox;
+static LinkRate linkRate;
+static ReaderAclStore acl;
+static volatile bool offline;
+static ReaderFeedback feedback;
+static PlatformTimer feedbackTimer;
+// Under platformLock(), between the link and the rfid thread.
+static AclDelta aclQueue[READER_ACL_QUEUE];
+static uint8_t aclHead;
+static uint8_t aclCount;
+static bool aclOverrun;
+static bool aclQueried;
+static uint8_t aclStatus[READER_ACL_STATUS_SIZE];
+static bool aclStatusReady;
+static const LinkRateConfig linkRateConfig = {
+    linkHwBitrates, LINK_HW_BITRATE_COUNT, LINK_HW_BITRATE, link_set_bitrate,
+    &LINKD1
+};
+
+static void link_send(void *arg, const uint8_t *frame, size_t len) {
+    linkSend(arg, frame, len);
+}
+
+static bool link_set_bitrate(void *arg, uint32_t bitrate) {
+    return linkSetBitrate(arg, bitrate);
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+// The cards on the reader, the link bit rate and the throughput measured
+// when it was negotiated.
+static void send_status(void) {
+    uint8_t status[9];
+
+    if (!statusRequested) {
+        return;
+    }
+    // Read without the rfid thread's consent, a count off by one is fine.
+    status[0] = (uint8_t)readerPresenceCount(&presence);
+    put32(&status[1], linkRate.stats.bitrate);
+    put32(&status[5], linkRate.stats.throughput);
+    if (protoSend(&proto, PROTO_MSG_STATUS, status, sizeof(status)) ==
+            PROTO_OK) {
+        statusRequested = false;
+    }
+}
+
+// The access list status the rfid thread left, sent again later if the
+// window is full unless a newer one replaces it meanwhile.
+static void send_acl_status(void) {
+    uint8_t status[READER_ACL_STATUS_SIZE];
+    bool ready;
+
+    platformLock();
+    ready = aclStatusReady;
+    aclStatusReady = false;
+    memcpy(status, aclStatus, sizeof(status));
+    platformUnlock();
+    if (ready && protoSend(&proto, PROTO_MSG_ACL_STATUS, status,
+                           sizeof(status)) != PROTO_OK) {
+        platformLock();
+        aclStatusReady = true;
+        platformUnlock();
+    }
+}
+
+// Hands a delta of the access list to the rfid thread, from the link thread.
+static void queue_acl_delta(const uint8_t *payload, size_t len) {
+    platformLock();
+    if (aclCount < READER_ACL_QUEUE) {
+        AclDelta *delta = &aclQueue[(aclHead + aclCount) % READER_ACL_QUEUE];
+
+        delta->len = (uint8_t)len;
+        memcpy(delta->data, payload, len);
+        aclCount++;
+    } else {
+        aclOverrun = true;
+    }
+    platformUnlock();
+}
+
+static void controller_receive(void *arg, uint8_t type,
+                               const uint8_t *payload, size_t len) {
+    (void)arg;
+
+    if (linkRateReceive(&linkRate, type, payload, len)) {
+        return;
+    }
+    if (type == PROTO_MSG_STATUS_REQUEST) {
+        // Answered as soon as the window has room.
+        statusRequested = true;
+    } else if (type == PROTO_MSG_ACL_DELTA) {
+        queue_acl_delta(payload, len);
+    } else if (type == PROTO_MSG_ACL_QUERY) {
+        platformLock();
+        aclQueried = true;
+        platformUnlock();
+    } else if (type == PROTO_MSG_FEEDBACK) {
+        signal_feedback(payload, len);
+    }
+}
+
+// Notices the controller going away: messages wait for acknowledgements and
+// no frame comes back. The retransmissions keep the link thread running
+// meanwhile.
+static void track_controller(void) {
+    static uint32_t frames;
+    static uint32_t heardAt;
+
+    if (proto.stats.frames != frames || protoInFlight(&proto) == 0) {
+        frames = proto.stats.frames;
+        heardAt = platformNowUs();
+        offline = false;
+    } else if (platformElapsedUs(heardAt) >= READER_OFFLINE_US) {
+        offline = true;
+    }
+}
+
+// Moves the queued events into the protocol window, from the link thread.
+static uint32_t link_service(void *arg) {
+    uint32_t wait;
+    uint32_t rate;
+
+    (void)arg;
+
+    track_controller();
+    send_status();
+    send_acl_status();
+    wait = readerOutboxService(&outbox);
+    rate = linkRateService(&linkRate);
+#if defined(READER_LINK_KEY)
+    (void)linkSessionService(&session);
+#endif
+    return rate < wait ? rate : wait;
+}
+
+static void link_wakeup(void *arg) {
+    linkWakeup(arg);
+}
+
+static void feedback_off(void *arg) {
+    (void)arg;
+
+    palClearPad(GPIOB, GPIOB_LED_G1);
+    palClearPad(GPIOB, GPIOB_LED_R1);
+}
+
+// Shows a decision, the reader's or the controller's, on the green or the
+// red LED and plays its tune, a rising chirp or a low buzz.
+static void local_feedback(bool granted) {
+    feedback_off(NULL);
+    palSetPad(GPIOB, granted ? GPIOB_LED_G1 : GPIOB_LED_R1);
+    audioHwTune(granted ? &synthGrant : &synthDeny);
+    platformTimerStart(&feedbackTimer, READER_LOCAL_FEEDBACK_US, feedback_off,
+                       NULL);
+}
+
+// Shows the controller's decision unless the reader's guess already shows it
+// or the correction policy keeps the guess. With READER_ACL_FAST_PATH the
+// reader's own decisions stand.
+static void signal_feedback(const uint8_t *payload, size_t len) {
+    Iso14443aCard card;
+    bool granted;
+
+    if (READER_ACL_FAST_PATH ||
+        !readerFeedbackDecode(payload, len, &card, &granted)) {
+        return;
+    }
+    switch (readerFeedbackConfirm(&feedback, &card, granted)) {
+    case READER_FEEDBACK_SHOW:
+    case READER_FEEDBACK_CORRECT:
+        local_feedback(granted);
+        break;
+    default:
+        break;
+    }
+}
+
+// Queues a card event for the link thread, from the rfid thread. Arrivals go
+// out at once, departures may wait to share a frame. Without the controller,
+// or with READER_ACL_FAST_PATH, the reader decides on an arrival itself and
+// the event tells the controller what it decided. With READER_SPECULATE it
+// shows its guess and the controller's feedback still counts.
+static void card_event(void *ctx, const Iso14443aCard *card, bool arrived) {
+    ReaderEvent event;
+    uint8_t payload[READER_EVENT_MAX_SIZE];
+    size_t len;
+
+    (void)ctx;
+
+    event.type = arrived ? READER_EVENT_CARD : READER_EVENT_CARD_GONE;
+    event.card = *card;
+    event.flags = 0;
+    event.value = 0;
+    if (arrived && (READER_ACL_FAST_PATH || READER_SPECULATE || offline)) {
+        bool granted = readerAclStoreLookup(&acl, card);
+
+        event.flags |= READER_EVENT_FLAG_LOCAL;
+        if (granted) {
+            event.flags |= READER_EVENT_FLAG_GRANTED;
+        }
+        if (!READER_ACL_FAST_PATH && !offline) {
+            event.flags |= READER_EVENT_FLAG_GUESS;
+            readerFeedbackGuess(&feedback, card, granted);
+        }
+        local_feedback(granted);
+    }
+    len = readerEventEncode(&event, payload, sizeof(payload));
+    (void)readerOutboxPut(&outbox, payload, len,
+                          readerOutboxPriority(event.type));
+}
+
+// Tells the controller that the RF front-end did not start, from the rfid
+// thread.
+static void rfid_fault(uint16_t failures) {
+    ReaderEvent event;
+    uint8_t payload[READER_EVENT_MAX_SIZE];
+    size_t len;
+
+    memset(&event, 0, sizeof(event));
+    event.type = READER_EVENT_RFID_FAULT;
+    event.value = failures;
+    len = readerEventEncode(&event, payload, sizeof(payload));
+    (void)readerOutboxPut(&outbox, payload, len,
+                          readerOutboxPriority(event.type));
+}
+
+// Applies a queued delta of the access list and runs a compaction step, from
+// the rfid thread. The controller hears back after a query and after a delta
+// not applied. Compaction waits while a sound plays, a page erase would stall
+// the DMA interrupts past a block. Returns whether there is more to do.
+static bool acl_service(void) {
+    readeraclresult_t result = READER_ACL_OK;
+    bool queued, queried;
+    AclDelta delta;
+
+    platformLock();
+    queued = aclCount > 0;
+    if (queued) {
+        delta = aclQueue[aclHead];
+        aclHead = (uint8_t)((aclHead + 1) % READER_ACL_QUEUE);
+        aclCount--;
+    }
+    if (aclOverrun) {
+        result = READER_ACL_BUSY;
+    }
+    queried = aclQueried;
+    aclOverrun = false;
+    aclQueried = false;
+    platformUnlock();
+
+    if (queued) {
+        readeraclresult_t applied = readerAclStoreApply(&acl, delta.data,
+                                                        delta.len);
+
+        if (applied != READER_ACL_OK) {
+            result = applied;
+        }
+    }
+    if (queried || result != READER_ACL_OK) {
+        platformLock();
+        (void)readerAclStoreStatus(&acl, result, aclStatus);
+        aclStatusReady = true;
+        platformUnlock();
+        linkWakeup(&LINKD1);
+    }
+    if (audioHwPlaying()) {
+        // Comes back once the sound is over.
+        return true;
+    }
+    return readerAclStoreService(&acl) || queued;
+}
+
+// Sized from the frames gcc reports on the host (-fcallgraph-info=su), not
+// measured on the board: an acknowledgement completing the handshake seals
+// a message, up to 1.2 kB deep. Frames on the M0 are smaller. The stacks are
+// filled and checked (chconf.h), look at the high-water mark before cutting.
+static THD_WORKING_AREA(waLink, 1280);
+
+// Serves the controller on its own, so a turn on the bus is answered right
+// away even while the rfid thread talks to a card.
+static THD_FUNCTION(linkThread, arg) {
+    (void)arg;
+    chRegSetThreadName("link");
+
+    protoInit(&proto, &protoConfig);
+#if defined(READER_LINK_KEY)
+    linkSessionInit(&session, &proto, linkKey);
+#endif
+    // The controller may still count from before a reset of the reader.
+    protoReset(&proto);
+    linkRateInit(&linkRate, &linkRateConfig, &proto);
+    while (true) {
+        protoRun(&proto, &LINKD1, LINK_WAIT_FOREVER);
+    }
+}
+
+// Selecting a card through the SPI transport, or a card event starting a
+// tune, up to 1 kB deep on the host.
+static THD_WORKING_AREA(waRfid, 1024);
+
+static THD_FUNCTION(rfidThread, arg) {
+    uint32_t backoff = READER_RFID_RETRY_US;
+    uint16_t failures = 0;
+
+    (void)arg;
+    chRegSetThreadName("rfid");
+
+    // The main thread is the idle thread, so anything that may sleep (such as
+    // bringing up the RFID front-end) has to run here. A slow power-up or a
+    // glitch on the SPI must not end the card reading for good: the start is
+    // tried again, further and further apart, and the controller hears of
+    // every failure meanwhile.
+    while (mfrc522Start(&MFRC522D1, &mfrc522HwConfig) != MFRC522_OK) {
+        if (failures < UINT16_MAX) {
+            failures++;
+        }
+        rfid_fault(failures);
+        platformDelayUs(backoff);
+        backoff = backoff < READER_RFID_RETRY_MAX_US / 2
+                      ? 2 * backoff
+                      : READER_RFID_RETRY_MAX_US;
+    }
+#if defined(READER_LINK_KEY)
+    // The F072 has no random number generator, the MFRC522 has one. The
+    // handshake waits for the first draw.
+    for (int i = 0; i < READER_ENTROPY_DRAWS; i++) {
+        uint8_t random[MFRC522_RANDOM_SIZE];
+
+        if (mfrc522Random(&MFRC522D1, random) == MFRC522_OK) {
+            linkSessionSeed(&session, random, sizeof(random));
+        }
+    }
+    linkWakeup(&LINKD1);
+#endif
+
+    readerPresenceInit(&presence, card_event, NULL);
+    readerPollInit(&scheduler, &MFRC522D1, &presence);
+    while (true) {
+        uint32_t wait = readerPollRun(&scheduler);
+
+        if (acl_service() && wait > READER_ACL_STEP_US) {
+            wait = READER_ACL_STEP_US;
+        }
+        platformDelayUs(wait);
+    }
+}
+
 int main(void) {
     /*
      * System initializations.
@@ -13,11 +460,27 @@ int main(void) {
     halInit();
     chSysInit();
 
+    platformInit();
+    audioHwInit();
+    readerFeedbackInit(&feedback, READER_SPECULATE_CORRECTION);
+    // An erased region holds no list, the reader then turns every card away
+    // while offline. Mounting may erase a page a reset left half written.
+    (void)readerAclStoreInit(&acl, &flashHwAcl);
+    mfrc522HwInit();
+    linkHwInit();
+    linkStart(&LINKD1, &linkHwConfig);
+    readerOutboxInit(&outbox, &proto, link_wakeup, &LINKD1);
+    chThdCreateStatic(waLink, sizeof(waLink), NORMALPRIO + 2, linkThread, NULL);
+    chThdCreateStatic(waRfid, sizeof(waRfid), NORMALPRIO + 1, rfidThread, NULL);
+
     // This function is now the Idle thread. It must never exit and it must implement
     // an infinite loop.
     while(true) {
-        // To prevent compiler from optimizing-out the empty loop
+        // Does nothing on the boards (unless CORTEX_ENABLE_WFI_IDLE is set),
+        // the sim board runs the simulated peripherals from here.
         // TODO implement switching MCU to a low-power mode.
+        port_wait_for_interrupt();
+        // To prevent compiler from optimizing-out the empty loop
         __asm__ __volatile__("");
     }
 }
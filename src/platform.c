@@ -0,0 +1,273 @@
+/**
+ * @file    platform.c
+ * @brief   ChibiOS implementation of the platform services.
+ * @details Time is kept in microseconds by two 16 bit GPTs at 1 MHz:
+ *          @p PLATFORM_GPT_CLOCK runs freely and is extended to 32 bits in
+ *          software, @p PLATFORM_GPT_TIMER runs one shot up to the first
+ *          armed one-shot timer. Deadlines are absolute, so a shot which
+ *          ends early, or an interrupt left pending by a shot stopped to be
+ *          shortened, only costs a look at the timer list.
+ *
+ *          The system tick runs on TIM2, so SysTick is free to count core
+ *          clock cycles.
+ */
+
+#include "ch.h"
+#include "hal.h"
+
+#include "platform.h"
+
+#if !HAL_USE_GPT
+#error "the platform services need HAL_USE_GPT"
+#endif
+
+#define US_PER_TICK                 (1000000U / CH_CFG_ST_FREQUENCY)
+
+/**
+ * @brief   Free running microsecond counter.
+ */
+#if !defined(PLATFORM_GPT_CLOCK) || defined(__DOXYGEN__)
+#define PLATFORM_GPT_CLOCK          GPTD3
+#endif
+
+/**
+ * @brief   One-shot timer expiry.
+ */
+#if !defined(PLATFORM_GPT_TIMER) || defined(__DOXYGEN__)
+#define PLATFORM_GPT_TIMER          GPTD14
+#endif
+
+/**
+ * @brief   Delays from this long on sleep on the system tick, where a tick
+ *          of rounding does not matter.
+ */
+#if !defined(PLATFORM_TICK_DELAY_US) || defined(__DOXYGEN__)
+#define PLATFORM_TICK_DELAY_US      20000
+#endif
+
+/* Counts per period of the clock GPT, also the longest shot. */
+#define GPT_PERIOD                  0xFFFFU
+
+/* Shortest shot: the GPT driver loads ARR with the interval less one, and
+   the counter does not run while ARR is 0. */
+#define GPT_SHORTEST                2
+
+static void clock_cb(GPTDriver *gptp);
+static void timer_cb(GPTDriver *gptp);
+
+static const GPTConfig clockcfg = {
+    1000000,
+    clock_cb,
+    0,
+    0
+};
+
+static const GPTConfig timercfg = {
+    1000000,
+    timer_cb,
+    0,
+    0
+};
+
+static uint32_t clock_us;
+static uint32_t clock_count;
+
+/**
+ * @brief   Armed timers, the first one expires first.
+ */
+static PlatformTimer *armed;
+
+/**
+ * @brief   Extends the clock counter, at least once per period.
+ */
+static uint32_t now_us(void) {
+    uint32_t count = gptGetCounterX(&PLATFORM_GPT_CLOCK);
+
+    clock_us += (count + GPT_PERIOD - clock_count) % GPT_PERIOD;
+    clock_count = count;
+    return clock_us;
+}
+
+static void clock_cb(GPTDriver *gptp) {
+    (void)gptp;
+
+    chSysLockFromISR();
+    now_us();
+    chSysUnlockFromISR();
+}
+
+static void start_shot(uint32_t now) {
+    int32_t left = (int32_t)(armed->deadline - now);
+
+    gptStopTimerI(&PLATFORM_GPT_TIMER);
+    gptStartOneShotI(&PLATFORM_GPT_TIMER,
+                     left <= GPT_SHORTEST ? GPT_SHORTEST
+                     : left < GPT_PERIOD ? (gptcnt_t)left : GPT_PERIOD);
+}
+
+static void timer_cb(GPTDriver *gptp) {
+    uint32_t now;
+
+    (void)gptp;
+
+    chSysLockFromISR();
+    now = now_us();
+    while (armed != NULL && (int32_t)(armed->deadline - now) <= 0) {
+        PlatformTimer *tp = armed;
+
+        armed = tp->next;
+        tp->next = NULL;
+        tp->callback(tp->arg);
+    }
+    if (armed != NULL) {
+        start_shot(now);
+    }
+    chSysUnlockFromISR();
+}
+
+static void wakeup(void *arg) {
+    chThdResumeI((thread_reference_t *)arg, MSG_OK);
+}
+
+/**
+ * @brief   Starts the microsecond clock and timers.
+ * @note    Called once after @p chSysInit().
+ */
+void platformInit(void) {
+    gptStart(&PLATFORM_GPT_CLOCK, &clockcfg);
+    gptStart(&PLATFORM_GPT_TIMER, &timercfg);
+    gptStartContinuous(&PLATFORM_GPT_CLOCK, GPT_PERIOD);
+#if !defined(SIMULATOR)
+    SysTick->LOAD = PLATFORM_CYCLES_MASK;
+    SysTick->VAL = 0;
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+#endif
+}
+
+/**
+ * @brief   Enters a critical zone from thread context.
+ * @details Interrupt handlers which call I-class functions of the portable
+ *          modules are held off until @p platformUnlock().
+ */
+void platformLock(void) {
+    chSysLock();
+}
+
+/**
+ * @brief   Leaves the critical zone entered by @p platformLock().
+ */
+void platformUnlock(void) {
+    chSysUnlock();
+}
+
+/**
+ * @brief   Returns a free-running microsecond counter.
+ * @details The counter wraps at 2^32 us.
+ */
+uint32_t platformNowUs(void) {
+    syssts_t sts = chSysGetStatusAndLockX();
+    uint32_t now = now_us();
+
+    chSysRestoreStatusX(sts);
+    return now;
+}
+
+/**
+ * @brief   Returns a free-running core clock cycle counter.
+ * @details Only the bits of @p PLATFORM_CYCLES_MASK count, about 0.35 s at
+ *          48 MHz, see @p platformElapsedCycles(). The simulator counts the
+ *          cycles of the machine it runs on.
+ */
+uint32_t platformCycles(void) {
+#if defined(SIMULATOR)
+    return (uint32_t)__builtin_ia32_rdtsc() & PLATFORM_CYCLES_MASK;
+#else
+    /* SysTick counts down. */
+    return PLATFORM_CYCLES_MASK - SysTick->VAL;
+#endif
+}
+
+/**
+ * @brief   Suspends the calling thread for at least @p us microseconds.
+ * @details Delays shorter than @p PLATFORM_TICK_DELAY_US end on the
+ *          microsecond, longer ones on a system tick.
+ * @note    Must not be called from the main (idle) thread.
+ */
+void platformDelayUs(uint32_t us) {
+    PlatformTimer timer;
+    thread_reference_t thread = NULL;
+
+    if (us == 0) {
+        return;
+    }
+    if (us >= PLATFORM_TICK_DELAY_US) {
+        chThdSleep((systime_t)((us + US_PER_TICK - 1) / US_PER_TICK));
+        return;
+    }
+    chSysLock();
+    platformTimerStartI(&timer, us, wakeup, &thread);
+    chThdSuspendS(&thread);
+    chSysUnlock();
+}
+
+/**
+ * @brief   Arms a one-shot timer, which is stopped first if armed.
+ * @details @p callback is called from interrupt context once @p us
+ *          microseconds have passed, @p us must be below 2^31.
+ *
+ * @iclass
+ */
+void platformTimerStartI(PlatformTimer *tp, uint32_t us,
+                         platformtimercb_t callback, void *arg) {
+    uint32_t now = now_us();
+    PlatformTimer **pp = &armed;
+
+    platformTimerStopI(tp);
+    tp->deadline = now + us;
+    tp->callback = callback;
+    tp->arg = arg;
+    while (*pp != NULL && (int32_t)((*pp)->deadline - now) <= (int32_t)us) {
+        pp = &(*pp)->next;
+    }
+    tp->next = *pp;
+    *pp = tp;
+    if (armed == tp) {
+        start_shot(now);
+    }
+}
+
+/**
+ * @brief   Arms a one-shot timer, see @p platformTimerStartI().
+ */
+void platformTimerStart(PlatformTimer *tp, uint32_t us,
+                        platformtimercb_t callback, void *arg) {
+    chSysLock();
+    platformTimerStartI(tp, us, callback, arg);
+    chSysUnlock();
+}
+
+/**
+ * @brief   Disarms a timer, nothing happens if it is not armed.
+ *
+ * @iclass
+ */
+void platformTimerStopI(PlatformTimer *tp) {
+    PlatformTimer **pp = &armed;
+
+    while (*pp != NULL && *pp != tp) {
+        pp = &(*pp)->next;
+    }
+    if (*pp != NULL) {
+        *pp = tp->next;
+        tp->next = NULL;
+    }
+}
+
+/**
+ * @brief   Disarms a timer, see @p platformTimerStopI().
+ */
+void platformTimerStop(PlatformTimer *tp) {
+    chSysLock();
+    platformTimerStopI(tp);
+    chSysUnlock();
+}
@@ -0,0 +1,84 @@
+/**
+ * @file    platform.h
+ * @brief   Minimal platform services used by the portable firmware modules.
+ *
+ * @details Modules which do not touch the hardware directly (drivers talking
+ *          through a transport, protocol layers, ...) only depend on this
+ *          header instead of ChibiOS, so that they can also be built for the
+ *          host (see @p host/). The firmware implementation lives in
+ *          @p platform.c, the host one in @p host/platform.c.
+ */
+
+#ifndef _PLATFORM_H_
+#define _PLATFORM_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if !defined(FALSE)
+#define FALSE                       0
+#endif
+
+#if !defined(TRUE)
+#define TRUE                        (!FALSE)
+#endif
+
+/**
+ * @brief   Counting bits of @p platformCycles().
+ */
+#define PLATFORM_CYCLES_MASK        0xFFFFFFU
+
+/**
+ * @brief   Called when a one-shot timer expires.
+ * @details Runs in interrupt context on the firmware, with the kernel
+ *          locked: only I-class functions may be used.
+ */
+typedef void (*platformtimercb_t)(void *arg);
+
+/**
+ * @brief   One-shot timer with microsecond resolution.
+ * @note    The fields are private to the platform implementation.
+ */
+typedef struct platform_timer {
+    struct platform_timer *next;
+    uint32_t deadline;              /**< Expiry, see @p platformNowUs().    */
+    platformtimercb_t callback;
+    void *arg;
+} PlatformTimer;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void platformInit(void);
+  void platformLock(void);
+  void platformUnlock(void);
+  uint32_t platformNowUs(void);
+  uint32_t platformCycles(void);
+  void platformDelayUs(uint32_t us);
+  void platformTimerStart(PlatformTimer *tp, uint32_t us,
+                          platformtimercb_t callback, void *arg);
+  void platformTimerStartI(PlatformTimer *tp, uint32_t us,
+                           platformtimercb_t callback, void *arg);
+  void platformTimerStop(PlatformTimer *tp);
+  void platformTimerStopI(PlatformTimer *tp);
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @brief   Microseconds elapsed since @p start.
+ * @note    Correct across a wrap of the microsecond counter.
+ */
+static inline uint32_t platformElapsedUs(uint32_t start) {
+    return platformNowUs() - start;
+}
+
+/**
+ * @brief   CPU cycles elapsed since @p start, see @p platformCycles().
+ */
+static inline uint32_t platformElapsedCycles(uint32_t start) {
+    return (platformCycles() - start) & PLATFORM_CYCLES_MASK;
+}
+
+#endif /* _PLATFORM_H_ */
@@ -0,0 +1,619 @@
+/**
+ * @file    acl.c
+ * @brief   Access list kept in flash.
+ */
+
+#include <string.h>
+
+#include "reader/acl.h"
+
+/* Longest filter, keeps the size computations in 32 bits. */
+#define BLOOM_WORDS_MAX             (1U << 24)
+
+/* Longest unary quotient of a gap, 16 ones are the escape. */
+#define RICE_ESCAPE                 16
+
+/* Largest Rice parameter, the code of a gap stays within 72 bits. */
+#define RICE_K_MAX                  56
+
+/*===========================================================================*/
+/* Local functions.                                                          */
+/*===========================================================================*/
+
+/**
+ * @brief   CRC-32 (IEEE 802.3) with a table of 16 entries.
+ */
+static uint32_t crc32(uint32_t crc, const uint8_t *p, size_t n) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+        0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+        0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+
+    crc = ~crc;
+    while (n-- > 0) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+/**
+ * @brief   Final mix of MurmurHash3.
+ */
+static uint32_t mix(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85EBCA6BU;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35U;
+    h ^= h >> 16;
+    return h;
+}
+
+/**
+ * @brief   The two hashes of a key, the filter tests bits h1 + i * h2.
+ */
+static void bloom_hashes(uint32_t lo, uint32_t hi, uint32_t *h1,
+                         uint32_t *h2) {
+    *h1 = mix(lo ^ mix(hi));
+    *h2 = mix(*h1 + 0x9E3779B9U) | 1;
+}
+
+static bool bloom_test(const uint32_t *bloom, uint32_t words, uint8_t tests,
+                       uint32_t lo, uint32_t hi) {
+    uint32_t mask = words * 32 - 1;
+    uint32_t h1, h2;
+    uint8_t i;
+
+    bloom_hashes(lo, hi, &h1, &h2);
+    for (i = 0; i < tests; i++) {
+        uint32_t bit = h1 & mask;
+
+        if ((bloom[bit >> 5] & (1U << (bit & 31))) == 0) {
+            return false;
+        }
+        h1 += h2;
+    }
+    return true;
+}
+
+static unsigned bit_length(uint64_t v) {
+    unsigned n = 0;
+
+    while (v != 0) {
+        v >>= 1;
+        n++;
+    }
+    return n;
+}
+
+/**
+ * @brief   Writes the @p n low bits of @p v, least significant first.
+ */
+static void put_bits(uint8_t *p, uint16_t *pos, uint64_t v, unsigned n) {
+    while (n > 0) {
+        unsigned shift = *pos & 7;
+        unsigned take = 8 - shift < n ? 8 - shift : n;
+
+        p[*pos >> 3] |= (uint8_t)((v & ((1U << take) - 1)) << shift);
+        v >>= take;
+        n -= take;
+        *pos = (uint16_t)(*pos + take);
+    }
+}
+
+static uint64_t get_bits(const uint8_t *p, uint16_t *pos, unsigned n) {
+    uint64_t v = 0;
+    unsigned got = 0;
+
+    while (got < n) {
+        unsigned shift = *pos & 7;
+        unsigned take = 8 - shift < n - got ? 8 - shift : n - got;
+
+        v |= (uint64_t)((p[*pos >> 3] >> shift) & ((1U << take) - 1)) << got;
+        got += take;
+        *pos = (uint16_t)(*pos + take);
+    }
+    return v;
+}
+
+/**
+ * @brief   Bits of the code of gap - 1 = @p v.
+ */
+static unsigned code_bits(uint64_t v, uint8_t k) {
+    uint64_t q = v >> k;
+
+    return q < RICE_ESCAPE ? (unsigned)q + 1 + k
+                           : RICE_ESCAPE + 6 + bit_length(v);
+}
+
+/**
+ * @brief   Reads the code of a gap, returns gap - 1.
+ */
+static uint64_t get_gap(const uint8_t *p, uint16_t *pos, uint8_t k) {
+    unsigned q = 0;
+
+    while (q < RICE_ESCAPE && get_bits(p, pos, 1) != 0) {
+        q++;
+    }
+    if (q == RICE_ESCAPE) {
+        return get_bits(p, pos, (unsigned)get_bits(p, pos, 6) + 1);
+    }
+    return (uint64_t)q << k | get_bits(p, pos, k);
+}
+
+static uint64_t block_first(const uint8_t *block) {
+    const uint32_t *w = (const uint32_t *)block;
+
+    return (uint64_t)w[1] << 32 | w[0];
+}
+
+/**
+ * @brief   Bisects the first keys of the blocks and decodes the one
+ *          @p key would be in.
+ */
+static bool find_in_blocks(ReaderAcl *ap, uint64_t key) {
+    const uint8_t *blocks = (const uint8_t *)ap->keys;
+    uint16_t size = ap->header->blockSize;
+    uint32_t first = 0, last = ap->header->blocks;
+    const uint8_t *block;
+    uint64_t current;
+    uint16_t pos;
+    uint8_t i;
+
+    /* Blocks first to last - 1 are left, the one before first starts at or
+       below key. */
+    while (first < last) {
+        uint32_t middle = first + (last - first) / 2;
+
+        ap->stats.probes++;
+        if (block_first(&blocks[(size_t)middle * size]) <= key) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    if (first == 0) {
+        return false;
+    }
+    block = &blocks[(size_t)(first - 1) * size];
+    current = block_first(block);
+    pos = 8 * READER_ACL_BLOCK_HEADER;
+    for (i = 1; current < key && i < block[8]; i++) {
+        current += get_gap(block, &pos, block[9]) + 1;
+        ap->stats.decoded++;
+    }
+    return current == key;
+}
+
+static size_t image_size(const ReaderAclHeader *header) {
+    if (header->blockSize == 0) {
+        return READER_ACL_IMAGE_SIZE(header->count, header->bloomWords);
+    }
+    return READER_ACL_BLOCK_IMAGE_SIZE(header->blocks, header->blockSize,
+                                       header->bloomWords);
+}
+
+/*===========================================================================*/
+/* Exported functions.                                                       */
+/*===========================================================================*/
+
+/**
+ * @brief   Finds the list in a flash region.
+ * @details The image stays where it is, it must be aligned on 4 bytes.
+ *
+ * @return  @p false if the region holds no valid image, every lookup then
+ *          fails.
+ */
+bool readerAclInit(ReaderAcl *ap, const void *image, size_t size) {
+    const ReaderAclHeader *header = image;
+
+    memset(ap, 0, sizeof(*ap));
+    if (size < sizeof(*header) || header->magic != READER_ACL_MAGIC ||
+        (header->blockSize == 0 &&
+         header->count > (size - sizeof(*header)) / 8) ||
+        header->bloomWords > BLOOM_WORDS_MAX ||
+        (header->bloomWords & (header->bloomWords - 1)) != 0 ||
+        (header->bloomWords != 0 && header->bloomTests == 0)) {
+        return false;
+    }
+    if (header->blockSize != 0 &&
+        (header->blockSize < 32 || header->blockSize > READER_ACL_BLOCK_MAX ||
+         header->blockSize % 4 != 0 ||
+         header->blocks > (size - sizeof(*header)) / header->blockSize ||
+         header->blocks > header->count ||
+         header->count > 255 * header->blocks)) {
+        return false;
+    }
+    if (image_size(header) > size ||
+        readerAclImageCrc(header, &header[1],
+                          image_size(header) - sizeof(*header)) !=
+            header->crc) {
+        return false;
+    }
+    ap->header = header;
+    ap->bloom = (const uint32_t *)&header[1];
+    ap->keys = &ap->bloom[header->bloomWords];
+    return true;
+}
+
+/**
+ * @brief   Whether @p card is on the list.
+ */
+bool readerAclLookup(ReaderAcl *ap, const Iso14443aCard *card) {
+    return readerAclFind(ap, readerAclKey(card));
+}
+
+/**
+ * @brief   Whether @p key is on the list.
+ * @details A filter test of a few words of flash, then a binary search of
+ *          the keys.
+ */
+bool readerAclFind(ReaderAcl *ap, uint64_t key) {
+    uint32_t start = platformCycles();
+    uint32_t lo = (uint32_t)key;
+    uint32_t hi = (uint32_t)(key >> 32);
+    uint32_t first, last;
+    bool found = false;
+
+    ap->stats.lookups++;
+    if (ap->header == NULL) {
+        return false;
+    }
+    if (ap->header->bloomWords != 0 &&
+        !bloom_test(ap->bloom, ap->header->bloomWords, ap->header->bloomTests,
+                    lo, hi)) {
+        ap->stats.filtered++;
+        ap->stats.cycles += platformElapsedCycles(start);
+        return false;
+    }
+
+    if (ap->header->blockSize != 0) {
+        found = find_in_blocks(ap, key);
+        if (found) {
+            ap->stats.found++;
+        }
+        ap->stats.cycles += platformElapsedCycles(start);
+        return found;
+    }
+
+    /* Keys first to last - 1 are left. */
+    first = 0;
+    last = ap->header->count;
+    while (first < last) {
+        uint32_t middle = first + (last - first) / 2;
+        const uint32_t *p = &ap->keys[2 * middle];
+
+        ap->stats.probes++;
+        if (p[1] == hi && p[0] == lo) {
+            found = true;
+            break;
+        }
+        if (p[1] < hi || (p[1] == hi && p[0] < lo)) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    if (found) {
+        ap->stats.found++;
+    }
+    ap->stats.cycles += platformElapsedCycles(start);
+    return found;
+}
+
+/**
+ * @brief   Key of a card on the list.
+ * @details The UID length in the top byte, then single and double size
+ *          UIDs as they are, most significant byte first. A triple size UID
+ *          does not fit and is replaced by its 56 bit FNV-1a hash.
+ */
+uint64_t readerAclKey(const Iso14443aCard *card) {
+    uint64_t key = 0;
+    uint8_t i;
+
+    if (card->uidlen <= 7) {
+        for (i = 0; i < card->uidlen; i++) {
+            key |= (uint64_t)card->uid[i] << (8 * (6 - i));
+        }
+    } else {
+        key = 0xCBF29CE484222325ULL;
+        for (i = 0; i < card->uidlen; i++) {
+            key = (key ^ card->uid[i]) * 0x100000001B3ULL;
+        }
+        key &= 0x00FFFFFFFFFFFFFFULL;
+    }
+    return key | (uint64_t)card->uidlen << 56;
+}
+
+/**
+ * @brief   Checksum of a key and the chunk it falls into.
+ * @details The list checksum of a chunk is the sum of the checksums of its
+ *          keys, modulo 2^32.
+ */
+uint32_t readerAclChecksum(uint64_t key, unsigned *chunk) {
+    uint32_t h1, h2;
+
+    bloom_hashes((uint32_t)key, (uint32_t)(key >> 32), &h1, &h2);
+    *chunk = h1 >> 29;
+    return h2;
+}
+
+/**
+ * @brief   Words of the Bloom filter of @p count keys, at least @p bits per
+ *          key rounded up to a power of two words.
+ */
+uint32_t readerAclBloomWords(size_t count, unsigned bits) {
+    uint32_t need, words;
+
+    if (count == 0 || bits == 0) {
+        return 0;
+    }
+    need = (uint32_t)(((uint64_t)count * bits + 31) / 32);
+    for (words = 1; words < need && words < BLOOM_WORDS_MAX; words <<= 1) {
+    }
+    return words;
+}
+
+/**
+ * @brief   Bits tested per key with a filter of @p bits per key.
+ */
+uint8_t readerAclBloomTests(unsigned bits) {
+    unsigned tests = (bits * 69 + 50) / 100;
+
+    return (uint8_t)(tests < 1 ? 1 : tests > 16 ? 16 : tests);
+}
+
+/**
+ * @brief   Sets the filter bits of @p key in words @p first to
+ *          @p first + @p n - 1 of a filter of @p words.
+ * @details The filter may be built a window at a time, @p window holds the
+ *          words of the window.
+ */
+void readerAclBloomAdd(uint32_t *window, uint32_t first, uint32_t n,
+                       uint32_t words, uint8_t tests, uint64_t key) {
+    uint32_t mask = words * 32 - 1;
+    uint32_t h1, h2;
+    uint8_t i;
+
+    bloom_hashes((uint32_t)key, (uint32_t)(key >> 32), &h1, &h2);
+    for (i = 0; i < tests; i++) {
+        uint32_t word = (h1 & mask) >> 5;
+
+        if (word - first < n) {
+            window[word - first] |= 1U << (h1 & 31);
+        }
+        h1 += h2;
+    }
+}
+
+/**
+ * @brief   CRC-32 of an image, the header with its @p crc field taken as
+ *          zero and then the @p len bytes of the filter and the keys.
+ */
+uint32_t readerAclImageCrc(const ReaderAclHeader *header, const void *body,
+                           size_t len) {
+    static const uint8_t zero[4] = {0};
+    const uint8_t *p = (const uint8_t *)header;
+    size_t at = offsetof(ReaderAclHeader, crc);
+    uint32_t crc;
+
+    crc = crc32(0, p, at);
+    crc = crc32(crc, zero, sizeof(zero));
+    crc = crc32(crc, &p[at + 4], sizeof(*header) - at - 4);
+    return crc32(crc, body, len);
+}
+
+/**
+ * @brief   Starts the encoding of key blocks.
+ *
+ * @param[out] block    First block, aligned on 4 bytes.
+ * @param[in] size      Block size, see @p READER_ACL_BLOCK_SIZE.
+ * @param[in] k         Rice parameter of the first block.
+ */
+void readerAclEncoderInit(ReaderAclEncoder *ep, uint8_t *block, size_t size,
+                          uint8_t k) {
+    memset(ep, 0, sizeof(*ep));
+    ep->block = block;
+    ep->size = (uint16_t)size;
+    ep->k = k > RICE_K_MAX ? RICE_K_MAX : k;
+}
+
+/**
+ * @brief   Adds the next key, greater than the one before.
+ *
+ * @return  @p false if the block is full. The key is not added: write the
+ *          block out, go to the next one with @p readerAclEncoderNext() and
+ *          add the key again.
+ */
+bool readerAclEncode(ReaderAclEncoder *ep, uint64_t key) {
+    uint32_t *first = (uint32_t *)ep->block;
+    uint64_t v;
+    unsigned n;
+
+    if (!ep->open) {
+        memset(ep->block, 0, ep->size);
+        first[0] = (uint32_t)key;
+        first[1] = (uint32_t)(key >> 32);
+        ep->block[8] = 1;
+        ep->block[9] = ep->k;
+        ep->bits = 8 * READER_ACL_BLOCK_HEADER;
+        ep->count = 1;
+        ep->gaps = 0;
+        ep->last = key;
+        ep->open = true;
+        return true;
+    }
+    v = key - ep->last - 1;
+    n = code_bits(v, ep->k);
+    if (ep->count == 255 || ep->bits + n > 8U * ep->size) {
+        return false;
+    }
+    if ((v >> ep->k) < RICE_ESCAPE) {
+        put_bits(ep->block, &ep->bits, (1U << (v >> ep->k)) - 1,
+                 (unsigned)(v >> ep->k) + 1);
+        put_bits(ep->block, &ep->bits, v, ep->k);
+    } else {
+        put_bits(ep->block, &ep->bits, (1U << RICE_ESCAPE) - 1, RICE_ESCAPE);
+        put_bits(ep->block, &ep->bits, bit_length(v) - 1, 6);
+        put_bits(ep->block, &ep->bits, v, bit_length(v));
+    }
+    ep->block[8] = ++ep->count;
+    ep->gaps += v;
+    ep->last = key;
+    return true;
+}
+
+/**
+ * @brief   Goes on in the next block, with a Rice parameter fitting the
+ *          gaps of the block just written.
+ */
+void readerAclEncoderNext(ReaderAclEncoder *ep, uint8_t *block) {
+    if (ep->count > 1) {
+        ep->k = readerAclRiceParameter(ep->gaps, ep->count - 1U);
+    }
+    ep->block = block;
+    ep->open = false;
+}
+
+/**
+ * @brief   Rice parameter of @p n gaps adding up to @p gaps + @p n.
+ * @details About the mean times ln 2, which is best for gaps drawn
+ *          uniformly at random.
+ */
+uint8_t readerAclRiceParameter(uint64_t gaps, uint32_t n) {
+    uint64_t mean = n != 0 ? gaps / n : 0;
+    unsigned k = bit_length(mean - (mean >> 2) - (mean >> 4));
+
+    k = k > 0 ? k - 1 : 0;
+    return (uint8_t)(k > RICE_K_MAX ? RICE_K_MAX : k);
+}
+
+/**
+ * @brief   Starts reading @p count keys, plain or in blocks of
+ *          @p blockSize bytes.
+ */
+void readerAclIteratorInit(ReaderAclIterator *ip, const void *keys,
+                           uint32_t count, unsigned blockSize) {
+    memset(ip, 0, sizeof(*ip));
+    ip->next = keys;
+    ip->blockSize = (uint16_t)blockSize;
+    ip->left = count;
+}
+
+/**
+ * @brief   Reads the next key.
+ *
+ * @return  @p false after the last one.
+ */
+bool readerAclIteratorNext(ReaderAclIterator *ip, uint64_t *key) {
+    if (ip->left == 0) {
+        return false;
+    }
+    ip->left--;
+    if (ip->blockSize == 0) {
+        ip->key = block_first(ip->next);
+        ip->next += 8;
+    } else if (ip->blockLeft == 0) {
+        ip->block = ip->next;
+        ip->next += ip->blockSize;
+        ip->key = block_first(ip->block);
+        ip->blockLeft = (uint8_t)(ip->block[8] - 1);
+        ip->k = ip->block[9];
+        ip->pos = 8 * READER_ACL_BLOCK_HEADER;
+    } else {
+        ip->key += get_gap(ip->block, &ip->pos, ip->k) + 1;
+        ip->blockLeft--;
+    }
+    *key = ip->key;
+    return true;
+}
+
+/**
+ * @brief   Writes the image of a list.
+ *
+ * @param[out] image    Aligned on 4 bytes.
+ * @param[in] keys      Sorted, each once, see @p readerAclKey().
+ * @param[in] bits      Bloom filter bits per key, 0 for no filter.
+ * @param[in] blockSize Key blocks, 0 for plain keys.
+ * @return  Size of the image, 0 if it does not fit in @p size bytes or if
+ *          the keys are out of order.
+ */
+size_t readerAclBuild(void *image, size_t size, const uint64_t *keys,
+                      size_t count, unsigned bits, unsigned blockSize,
+                      uint32_t generation) {
+    ReaderAclHeader *header = image;
+    uint32_t words = readerAclBloomWords(count, bits);
+    uint32_t *bloom = (uint32_t *)&header[1];
+    uint32_t *out = &bloom[words];
+    size_t len, i;
+
+    if (count > (SIZE_MAX - sizeof(*header)) / 16 ||
+        READER_ACL_IMAGE_SIZE(0, words) > size ||
+        (blockSize == 0 && READER_ACL_IMAGE_SIZE(count, words) > size) ||
+        (blockSize != 0 && (blockSize < 32 || blockSize % 4 != 0 ||
+                            blockSize > READER_ACL_BLOCK_MAX))) {
+        return 0;
+    }
+    for (i = 1; i < count; i++) {
+        if (keys[i] <= keys[i - 1]) {
+            return 0;
+        }
+    }
+    len = READER_ACL_IMAGE_SIZE(0, words);
+    memset(header, 0, len);
+    header->magic = READER_ACL_MAGIC;
+    header->generation = generation;
+    header->count = (uint32_t)count;
+    header->bloomWords = words;
+    header->bloomTests = readerAclBloomTests(bits);
+    header->blockSize = (uint16_t)blockSize;
+
+    if (blockSize == 0) {
+        len = READER_ACL_IMAGE_SIZE(count, words);
+        for (i = 0; i < count; i++) {
+            out[2 * i] = (uint32_t)keys[i];
+            out[2 * i + 1] = (uint32_t)(keys[i] >> 32);
+        }
+    } else if (count > 0) {
+        size_t room = (size - len) / blockSize;
+        uint8_t *blocks = (uint8_t *)out;
+        ReaderAclEncoder encoder;
+
+        if (room == 0) {
+            return 0;
+        }
+        readerAclEncoderInit(&encoder, blocks, blockSize,
+                             readerAclRiceParameter(keys[count - 1] - keys[0] -
+                                                        (count - 1),
+                                                    (uint32_t)count - 1));
+        header->blocks = 1;
+        for (i = 0; i < count; i++) {
+            if (!readerAclEncode(&encoder, keys[i])) {
+                if (header->blocks == room) {
+                    return 0;
+                }
+                readerAclEncoderNext(&encoder,
+                                     &blocks[header->blocks++ * blockSize]);
+                (void)readerAclEncode(&encoder, keys[i]);
+            }
+        }
+        len = READER_ACL_BLOCK_IMAGE_SIZE(header->blocks, blockSize, words);
+    }
+
+    for (i = 0; i < count; i++) {
+        unsigned chunk;
+        uint32_t sum;
+
+        sum = readerAclChecksum(keys[i], &chunk);
+        header->sums[chunk] += sum;
+        if (words != 0) {
+            readerAclBloomAdd(bloom, 0, words, words, header->bloomTests,
+                              keys[i]);
+        }
+    }
+    header->crc = readerAclImageCrc(header, &header[1], len - sizeof(*header));
+    return len;
+}
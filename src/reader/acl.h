@@ -0,0 +1,214 @@
+/**
+ * @file    acl.h
+ * @brief   Access list kept in flash, for decisions without the controller.
+ * @details The list is an image in a reserved flash region and is read in
+ *          place, never copied to RAM. It holds the cards let in as sorted
+ *          64 bit keys (see @p readerAclKey()), found by binary search in
+ *          log2(n) probes. A Bloom filter in front of the keys turns most
+ *          cards not on the list away after a few bit tests, without the
+ *          search.
+ *
+ *          The image is a @p ReaderAclHeader, the Bloom filter words and
+ *          the keys, in the byte order of the MCU (little endian). A CRC-32
+ *          of the whole image is checked once by @p readerAclInit(), a
+ *          region which is erased or half written holds no list and every
+ *          lookup fails. @p readerAclBuild() writes an image, the host tool
+ *          @p host/acl_image.c builds one from a list of UIDs.
+ *
+ *          The keys are stored plain, 8 bytes each, or in blocks of
+ *          @p blockSize bytes. With random double size UIDs in blocks of
+ *          128 bytes and no filter, acl-bench measures a whole image of
+ *          5.6, 5.0 and 4.7 bytes a card for 1000, 10000 and 50000 cards;
+ *          a 10 bit filter brings it to 6.1 to 7.6. A block starts with
+ *          its first key in full, then the key count, the Rice parameter k
+ *          and the gaps to the keys after the first, Rice coded: the
+ *          quotient of gap - 1 by 2^k in unary, at most 15 ones and a zero,
+ *          and the k low bits. 16 ones escape a gap too long for that, 6
+ *          bits of its length less one and the gap follow. The search
+ *          bisects the first keys of the blocks, which are the index of the
+ *          list, and decodes a single block. An encoder picks k of a block
+ *          from the mean gap of the block before, so it writes one block at
+ *          a time, in order.
+ *
+ *          The keys fall into @p READER_ACL_CHUNKS chunks by hash, and the
+ *          header holds the sum of the checksums of the keys of each chunk
+ *          (see @p readerAclChecksum()). The sums do not depend on the order
+ *          of the keys, so they follow adds and removes without a pass over
+ *          the list, and a controller comparing them with its own finds the
+ *          chunks where the lists differ.
+ */
+
+#ifndef _READER_ACL_H_
+#define _READER_ACL_H_
+
+#include "rfid/iso14443a.h"
+
+/**
+ * @brief   Bloom filter bits per key of the images built by default.
+ * @details 10 bits and 7 tests let about 1% of the cards not on the list
+ *          through to the search. 0 builds images without a filter.
+ */
+#if !defined(READER_ACL_BLOOM_BITS) || defined(__DOXYGEN__)
+#define READER_ACL_BLOOM_BITS       10
+#endif
+
+/**
+ * @brief   Block size of the images built by default, 0 for plain keys.
+ * @details Larger blocks hold more cards, smaller ones decode faster. At
+ *          most @p READER_ACL_BLOCK_MAX.
+ */
+#if !defined(READER_ACL_BLOCK_SIZE) || defined(__DOXYGEN__)
+#define READER_ACL_BLOCK_SIZE       128
+#endif
+
+/**
+ * @brief   Largest block an image may have.
+ */
+#define READER_ACL_BLOCK_MAX        1024
+
+#if READER_ACL_BLOCK_SIZE != 0 &&                                           \
+    (READER_ACL_BLOCK_SIZE < 32 ||                                          \
+     READER_ACL_BLOCK_SIZE > READER_ACL_BLOCK_MAX ||                        \
+     READER_ACL_BLOCK_SIZE % 4 != 0)
+#error "READER_ACL_BLOCK_SIZE must be 0 or a multiple of 4 from 32 to 1024"
+#endif
+
+/**
+ * @brief   Chunks of the list checksums.
+ */
+#define READER_ACL_CHUNKS           8
+
+/**
+ * @brief   "ACL1", first word of an image.
+ */
+#define READER_ACL_MAGIC            0x314C4341U
+
+/**
+ * @brief   Bytes of an image of @p count plain keys and a filter of
+ *          @p words.
+ */
+#define READER_ACL_IMAGE_SIZE(count, words)                                 \
+    (sizeof(ReaderAclHeader) + 4 * (size_t)(words) + 8 * (size_t)(count))
+
+/**
+ * @brief   Bytes of an image of @p blocks key blocks of @p blockSize bytes
+ *          and a filter of @p words.
+ */
+#define READER_ACL_BLOCK_IMAGE_SIZE(blocks, blockSize, words)               \
+    (sizeof(ReaderAclHeader) + 4 * (size_t)(words) +                        \
+     (size_t)(blocks) * (blockSize))
+
+/**
+ * @brief   Bytes at the start of a block: the first key, the count and k.
+ */
+#define READER_ACL_BLOCK_HEADER     10
+
+/**
+ * @brief   Start of an image.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t generation;            /**< Version of the list, set by the
+                                         controller.                        */
+    uint32_t count;                 /**< Keys.                              */
+    uint32_t bloomWords;            /**< Filter size, a power of two, 0 for
+                                         no filter.                         */
+    uint8_t bloomTests;             /**< Bits tested per key.               */
+    uint8_t reserved1;
+    uint16_t blockSize;             /**< 0 for plain keys.                  */
+    uint32_t blocks;                /**< Key blocks.                        */
+    uint32_t reserved2;
+    uint32_t crc;                   /**< CRC-32 of the image, this field
+                                         taken as zero.                     */
+    uint32_t sums[READER_ACL_CHUNKS]; /**< Checksums of the chunks.         */
+} ReaderAclHeader;
+
+/**
+ * @brief   Lookup counters.
+ */
+typedef struct {
+    uint32_t lookups;
+    uint32_t found;
+    uint32_t filtered;              /**< Turned away by the Bloom filter.   */
+    uint32_t probes;                /**< Keys compared by the searches.     */
+    uint32_t decoded;               /**< Keys decoded from the blocks.      */
+    uint32_t cycles;                /**< Spent looking up, see
+                                         @p platformCycles().               */
+} ReaderAclStats;
+
+/**
+ * @brief   Access list structure.
+ */
+typedef struct {
+    ReaderAclStats stats;
+    const ReaderAclHeader *header;  /**< @p NULL without a valid image.     */
+    const uint32_t *bloom;
+    const uint32_t *keys;           /**< Low and high word of each key, or
+                                         the first block.                   */
+} ReaderAcl;
+
+/**
+ * @brief   Writes key blocks one after the other.
+ */
+typedef struct {
+    uint8_t *block;                 /**< Being written.                     */
+    uint16_t size;
+    uint16_t bits;                  /**< Written of the block.              */
+    uint8_t count;
+    uint8_t k;
+    bool open;                      /**< The block has a key.               */
+    uint64_t last;
+    uint64_t gaps;                  /**< Sum of the gaps of the block.      */
+} ReaderAclEncoder;
+
+/**
+ * @brief   Reads the keys of an image in order.
+ */
+typedef struct {
+    const uint8_t *next;            /**< Plain key or block next.           */
+    const uint8_t *block;           /**< Being decoded.                     */
+    uint16_t blockSize;
+    uint32_t left;                  /**< Keys.                              */
+    uint16_t pos;                   /**< Bit of the next gap.               */
+    uint8_t blockLeft;              /**< Keys left in the block.            */
+    uint8_t k;
+    uint64_t key;
+} ReaderAclIterator;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  bool readerAclInit(ReaderAcl *ap, const void *image, size_t size);
+  bool readerAclLookup(ReaderAcl *ap, const Iso14443aCard *card);
+  bool readerAclFind(ReaderAcl *ap, uint64_t key);
+  uint64_t readerAclKey(const Iso14443aCard *card);
+  uint32_t readerAclChecksum(uint64_t key, unsigned *chunk);
+  uint32_t readerAclBloomWords(size_t count, unsigned bits);
+  uint8_t readerAclBloomTests(unsigned bits);
+  void readerAclBloomAdd(uint32_t *window, uint32_t first, uint32_t n,
+                         uint32_t words, uint8_t tests, uint64_t key);
+  uint32_t readerAclImageCrc(const ReaderAclHeader *header, const void *body,
+                             size_t len);
+  size_t readerAclBuild(void *image, size_t size, const uint64_t *keys,
+                        size_t count, unsigned bits, unsigned blockSize,
+                        uint32_t generation);
+  void readerAclEncoderInit(ReaderAclEncoder *ep, uint8_t *block,
+                            size_t size, uint8_t k);
+  bool readerAclEncode(ReaderAclEncoder *ep, uint64_t key);
+  void readerAclEncoderNext(ReaderAclEncoder *ep, uint8_t *block);
+  uint8_t readerAclRiceParameter(uint64_t gaps, uint32_t n);
+  void readerAclIteratorInit(ReaderAclIterator *ip, const void *keys,
+                             uint32_t count, unsigned blockSize);
+  bool readerAclIteratorNext(ReaderAclIterator *ip, uint64_t *key);
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @brief   Whether a list was found.
+ */
+static inline bool readerAclValid(const ReaderAcl *ap) {
+    return ap->header != NULL;
+}
+
+#endif /* _READER_ACL_H_ */
@@ -0,0 +1,941 @@
+/**
+ * @file    aclstore.c
+ * @brief   Access list in flash kept in step with the controller.
+ * @details The region holds bank 0, bank 1 and the log pages, the banks
+ *          taking what the log leaves, in whole pages. Bank 0 is where
+ *          @p make @p flash-acl puts an image.
+ *
+ *          The first record of a log page holds the page's sequence number,
+ *          the pages are replayed in that order. Records are appended in
+ *          the order of the deltas, so the generations only grow along the
+ *          log and a scan newest first stops at the first record the image
+ *          already covers.
+ */
+
+#include <string.h>
+
+#include "reader/aclstore.h"
+
+/* Record operations besides the delta ones. */
+#define OP_VOID                     0x00    /* Unfinished delta or torn
+                                               write.                       */
+#define OP_PAGE                     0x10    /* First record of a page, the
+                                               generation field holds its
+                                               sequence number.             */
+#define OP_COMMIT                   0x11    /* Ends a delta.                */
+#define OP_ERASED                   0xFF
+
+#define RECORD_SIZE                 sizeof(ReaderAclRecord)
+
+/* Generation bound of the lookups outside of a compaction. */
+#define NEWEST                      UINT32_MAX
+
+/* Compaction phases. */
+#define PHASE_IDLE                  0
+#define PHASE_ERASE                 1       /* Erases the other bank.       */
+#define PHASE_KEYS                  2       /* Merges image and log.        */
+#define PHASE_BLOOM                 3       /* Filter, a window a step.     */
+#define PHASE_COMMIT                4       /* Header, the switch.          */
+#define PHASE_CLEAN                 5       /* Erases covered log pages.    */
+
+/* State of the next key of the log in a compaction. */
+#define NEXT_UNKNOWN                0
+#define NEXT_FOUND                  1
+#define NEXT_NONE                   2
+
+/*===========================================================================*/
+/* Local functions.                                                          */
+/*===========================================================================*/
+
+static uint32_t get32(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+           (uint32_t)p[2] << 8 | p[3];
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static uint16_t record_check(const ReaderAclRecord *r) {
+    uint32_t x = r->generation ^ (r->lo * 3) ^ (r->hi * 5) ^
+                 ((uint32_t)r->op << 24);
+
+    return (uint16_t)((x ^ (x >> 16)) ^ 0x5A5A);
+}
+
+static bool record_erased(const ReaderAclRecord *r) {
+    return r->generation == UINT32_MAX && r->lo == UINT32_MAX &&
+           r->hi == UINT32_MAX && r->op == OP_ERASED && r->check == 0xFFFF;
+}
+
+static bool region_erased(const uint8_t *p, size_t len) {
+    const uint32_t *w = (const uint32_t *)p;
+    size_t i;
+
+    for (i = 0; i < len / 4; i++) {
+        if (w[i] != UINT32_MAX) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static size_t records_per_page(const ReaderAclStore *sp) {
+    return sp->flash->pageSize / RECORD_SIZE;
+}
+
+static size_t log_offset(const ReaderAclStore *sp, uint8_t page) {
+    return 2 * sp->bankSize + page * sp->flash->pageSize;
+}
+
+static const ReaderAclRecord *record(const ReaderAclStore *sp, uint8_t page,
+                                     size_t i) {
+    return (const ReaderAclRecord *)&sp->flash->base[log_offset(sp, page) +
+                                                     i * RECORD_SIZE];
+}
+
+static uint32_t image_generation(const ReaderAclStore *sp) {
+    return readerAclValid(&sp->image) ? sp->image.header->generation : 0;
+}
+
+static uint16_t compact_records(const ReaderAclStore *sp) {
+    if (READER_ACL_COMPACT_RECORDS != 0) {
+        return READER_ACL_COMPACT_RECORDS;
+    }
+    return (uint16_t)(READER_ACL_LOG_PAGES * (records_per_page(sp) - 1) / 2);
+}
+
+static bool erase_page(ReaderAclStore *sp, size_t offset) {
+    sp->stats.erases++;
+    return sp->flash->erase(sp->flash->arg, offset);
+}
+
+static bool program(ReaderAclStore *sp, size_t offset, const void *data,
+                    size_t len) {
+    sp->stats.programmed += len;
+    return sp->flash->program(sp->flash->arg, offset, data, len);
+}
+
+/**
+ * @brief   Zeroes the operation of a record, which then no longer counts.
+ */
+static void void_record(ReaderAclStore *sp, uint8_t page, size_t i) {
+    static const uint8_t zero[2] = {0};
+
+    (void)program(sp, log_offset(sp, page) + i * RECORD_SIZE +
+                      offsetof(ReaderAclRecord, op), zero, sizeof(zero));
+    sp->stats.voided++;
+}
+
+static void count_key(ReaderAclStore *sp, uint32_t lo, uint32_t hi, int dir) {
+    unsigned chunk;
+    uint32_t sum = readerAclChecksum((uint64_t)hi << 32 | lo, &chunk);
+
+    if (dir > 0) {
+        sp->count++;
+        sp->sums[chunk] += sum;
+    } else {
+        sp->count--;
+        sp->sums[chunk] -= sum;
+    }
+}
+
+/**
+ * @brief   The newest operation on a key in the log, up to generation
+ *          @p upto, 0 if there is none.
+ * @details Only records newer than the image count. A clear counts for
+ *          every key.
+ */
+static uint8_t log_find(ReaderAclStore *sp, uint32_t lo, uint32_t hi,
+                        uint32_t upto) {
+    uint32_t after = image_generation(sp);
+    uint8_t k;
+
+    for (k = sp->pages; k-- > 0;) {
+        uint8_t page = sp->order[k];
+        size_t i;
+
+        for (i = sp->used[page]; i-- > 1;) {
+            const ReaderAclRecord *r = record(sp, page, i);
+
+            if (r->op == OP_VOID || r->op == OP_COMMIT) {
+                continue;
+            }
+            if (r->generation <= after) {
+                return 0;
+            }
+            if (r->generation > upto) {
+                continue;
+            }
+            sp->stats.scanned++;
+            if (r->op == READER_ACL_OP_CLEAR ||
+                (r->lo == lo && r->hi == hi)) {
+                return r->op;
+            }
+        }
+    }
+    return 0;
+}
+
+static bool member(ReaderAclStore *sp, uint64_t key, uint32_t upto) {
+    uint8_t op = log_find(sp, (uint32_t)key, (uint32_t)(key >> 32), upto);
+
+    if (op != 0) {
+        return op == READER_ACL_OP_ADD;
+    }
+    return readerAclFind(&sp->image, key);
+}
+
+/**
+ * @brief   Records the log still takes, page records left out.
+ */
+static size_t room(const ReaderAclStore *sp) {
+    size_t rpp = records_per_page(sp);
+    size_t n = (READER_ACL_LOG_PAGES - sp->pages) * (rpp - 1);
+
+    if (sp->pages > 0) {
+        n += rpp - sp->used[sp->order[sp->pages - 1]];
+    }
+    return n;
+}
+
+static bool append(ReaderAclStore *sp, uint32_t generation, uint32_t lo,
+                   uint32_t hi, uint8_t op) {
+    ReaderAclRecord r;
+    uint8_t page;
+
+    if (sp->pages == 0 ||
+        sp->used[sp->order[sp->pages - 1]] == records_per_page(sp)) {
+        /* Opens an erased page. */
+        for (page = 0; page < READER_ACL_LOG_PAGES && sp->seq[page] != 0;
+             page++) {
+        }
+        if (page == READER_ACL_LOG_PAGES) {
+            return false;
+        }
+        memset(&r, 0, sizeof(r));
+        r.generation = sp->nextSeq;
+        r.op = OP_PAGE;
+        r.check = record_check(&r);
+        if (!program(sp, log_offset(sp, page), &r, sizeof(r))) {
+            return false;
+        }
+        sp->seq[page] = sp->nextSeq++;
+        sp->used[page] = 1;
+        sp->order[sp->pages++] = page;
+    }
+
+    page = sp->order[sp->pages - 1];
+    memset(&r, 0, sizeof(r));
+    r.generation = generation;
+    r.lo = lo;
+    r.hi = hi;
+    r.op = op;
+    r.check = record_check(&r);
+    if (!program(sp, log_offset(sp, page) + sp->used[page] * RECORD_SIZE, &r,
+                 sizeof(r))) {
+        return false;
+    }
+    sp->used[page]++;
+    sp->live++;
+    return true;
+}
+
+/**
+ * @brief   Reads the log back, voiding the records of an unfinished delta.
+ */
+static void replay(ReaderAclStore *sp) {
+    uint32_t after = image_generation(sp);
+    uint8_t lastPage = 0, k;
+    size_t lastRecord = 0;
+    bool committed = false;
+
+    /* The last commit, every record after it is unfinished. */
+    for (k = 0; k < sp->pages; k++) {
+        uint8_t page = sp->order[k];
+        size_t i;
+
+        for (i = 1; i < sp->used[page]; i++) {
+            const ReaderAclRecord *r = record(sp, page, i);
+
+            if (r->op == OP_COMMIT && r->check == record_check(r)) {
+                lastPage = k;
+                lastRecord = i;
+                committed = true;
+            }
+        }
+    }
+
+    sp->generation = after;
+    for (k = 0; k < sp->pages; k++) {
+        uint8_t page = sp->order[k];
+        size_t i;
+
+        for (i = 1; i < sp->used[page]; i++) {
+            const ReaderAclRecord *r = record(sp, page, i);
+            bool late = !committed || k > lastPage ||
+                        (k == lastPage && i > lastRecord);
+
+            if (r->op == OP_VOID) {
+                continue;
+            }
+            if (late || r->check != record_check(r)) {
+                void_record(sp, page, i);
+                continue;
+            }
+            if (r->generation <= after) {
+                continue;
+            }
+            sp->live++;
+            switch (r->op) {
+            case READER_ACL_OP_ADD:
+                count_key(sp, r->lo, r->hi, 1);
+                break;
+            case READER_ACL_OP_REMOVE:
+                count_key(sp, r->lo, r->hi, -1);
+                break;
+            case READER_ACL_OP_CLEAR:
+                sp->count = 0;
+                memset(sp->sums, 0, sizeof(sp->sums));
+                break;
+            case OP_COMMIT:
+                sp->generation = r->generation;
+                break;
+            default:
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief   Finds the pages of the log and puts them in order.
+ */
+static void mount_log(ReaderAclStore *sp) {
+    size_t rpp = records_per_page(sp);
+    uint8_t page, k;
+
+    sp->nextSeq = 1;
+    for (page = 0; page < READER_ACL_LOG_PAGES; page++) {
+        const ReaderAclRecord *first = record(sp, page, 0);
+        size_t i;
+
+        if (first->op != OP_PAGE || first->check != record_check(first)) {
+            if (!region_erased((const uint8_t *)first, sp->flash->pageSize)) {
+                (void)erase_page(sp, log_offset(sp, page));
+            }
+            continue;
+        }
+        for (i = 1; i < rpp && !record_erased(record(sp, page, i)); i++) {
+        }
+        sp->seq[page] = first->generation;
+        sp->used[page] = (uint16_t)i;
+        if (first->generation >= sp->nextSeq) {
+            sp->nextSeq = first->generation + 1;
+        }
+
+        /* Insertion by sequence number. */
+        for (k = sp->pages; k > 0 && sp->seq[sp->order[k - 1]] > sp->seq[page];
+             k--) {
+            sp->order[k] = sp->order[k - 1];
+        }
+        sp->order[k] = page;
+        sp->pages++;
+    }
+}
+
+/*===========================================================================*/
+/* Compaction.                                                               */
+/*===========================================================================*/
+
+static size_t target_offset(const ReaderAclStore *sp) {
+    return (size_t)(1 - sp->bank) * sp->bankSize;
+}
+
+static size_t keys_offset(const ReaderAclStore *sp) {
+    return target_offset(sp) + sizeof(ReaderAclHeader) + 4 * sp->cWords;
+}
+
+/**
+ * @brief   Starts a compaction unless the list is known not to fit.
+ * @details The size of an image of plain keys is known beforehand, the
+ *          filter is halved until it fits. Blocks are only known to fit once
+ *          written: if they run past the bank, the compaction starts over
+ *          with half the filter, see @p overflow().
+ */
+static void start_compaction(ReaderAclStore *sp) {
+    uint32_t words = readerAclBloomWords(sp->count, READER_ACL_BLOOM_BITS);
+
+    words = sp->shrink < 32 ? words >> sp->shrink : 0;
+    if (READER_ACL_BLOCK_SIZE == 0) {
+        while (words > 0 &&
+               READER_ACL_IMAGE_SIZE(sp->count, words) > sp->bankSize) {
+            words >>= 1;
+        }
+        sp->full = READER_ACL_IMAGE_SIZE(sp->count, 0) > sp->bankSize;
+    } else {
+        while (words > 0 && READER_ACL_BLOCK_IMAGE_SIZE(1, READER_ACL_BLOCK_SIZE,
+                                                        words) > sp->bankSize) {
+            words >>= 1;
+        }
+        sp->full = sp->overflow != 0 && sp->count >= sp->overflow;
+    }
+    if (sp->full) {
+        return;
+    }
+    sp->cGeneration = sp->generation;
+    sp->cCount = sp->count;
+    memcpy(sp->cSums, sp->sums, sizeof(sp->sums));
+    sp->cWords = words;
+    sp->cCursor = 0;
+    sp->cBlocks = 0;
+    sp->cNext = NEXT_UNKNOWN;
+    sp->cAddedAny = false;
+    sp->cBaseHave = false;
+    sp->cBaseAlive = readerAclValid(&sp->image) &&
+                     log_find(sp, 0, 0, sp->cGeneration) !=
+                         READER_ACL_OP_CLEAR;
+    if (sp->cBaseAlive) {
+        readerAclIteratorInit(&sp->cBase, sp->image.keys,
+                              sp->image.header->count,
+                              sp->image.header->blockSize);
+    }
+    /* The first block as if the keys were spread over the double size UIDs
+       of one manufacturer, the next ones follow the gaps found. */
+    readerAclEncoderInit(&sp->cEncoder, (uint8_t *)sp->buf,
+                         READER_ACL_BLOCK_SIZE,
+                         readerAclRiceParameter(1ULL << 48, sp->count + 1));
+    sp->phase = PHASE_ERASE;
+    sp->stats.compactions++;
+}
+
+/**
+ * @brief   The blocks of the list ran past the bank, starts over with half
+ *          the filter.
+ */
+static void overflow(ReaderAclStore *sp) {
+    if (sp->cWords == 0) {
+        sp->overflow = sp->cCount;
+    } else {
+        sp->shrink++;
+    }
+    sp->phase = PHASE_IDLE;
+    start_compaction(sp);
+}
+
+/**
+ * @brief   The smallest key added by the log after the last one taken which
+ *          is on the new list but not in the old image.
+ */
+static bool next_added(ReaderAclStore *sp, uint64_t *key) {
+    uint32_t after = image_generation(sp);
+
+    while (true) {
+        bool found = false;
+        uint64_t best = 0;
+        uint8_t k;
+
+        for (k = 0; k < sp->pages; k++) {
+            uint8_t page = sp->order[k];
+            size_t i;
+
+            for (i = 1; i < sp->used[page]; i++) {
+                const ReaderAclRecord *r = record(sp, page, i);
+                uint64_t candidate = (uint64_t)r->hi << 32 | r->lo;
+
+                if (r->op != READER_ACL_OP_ADD || r->generation <= after ||
+                    r->generation > sp->cGeneration) {
+                    continue;
+                }
+                if ((!sp->cAddedAny || candidate > sp->cAdded) &&
+                    (!found || candidate < best)) {
+                    best = candidate;
+                    found = true;
+                }
+            }
+        }
+        if (!found) {
+            return false;
+        }
+        sp->cAdded = best;
+        sp->cAddedAny = true;
+        if (log_find(sp, (uint32_t)best, (uint32_t)(best >> 32),
+                     sp->cGeneration) == READER_ACL_OP_ADD &&
+            !(sp->cBaseAlive && readerAclFind(&sp->image, best))) {
+            *key = best;
+            return true;
+        }
+    }
+}
+
+/**
+ * @brief   The next key of the old image still on the new list.
+ */
+static bool next_base(ReaderAclStore *sp, uint64_t *key) {
+    uint64_t candidate;
+
+    while (!sp->cBaseHave) {
+        if (!sp->cBaseAlive || !readerAclIteratorNext(&sp->cBase, &candidate)) {
+            return false;
+        }
+        if (log_find(sp, (uint32_t)candidate, (uint32_t)(candidate >> 32),
+                     sp->cGeneration) != READER_ACL_OP_REMOVE) {
+            sp->cBaseKey = candidate;
+            sp->cBaseHave = true;
+        }
+    }
+    *key = sp->cBaseKey;
+    return true;
+}
+
+/**
+ * @brief   The next key of the new image.
+ *
+ * @return  @p false after the last one.
+ */
+static bool next_key(ReaderAclStore *sp, uint64_t *key) {
+    bool haveBase = next_base(sp, key);
+
+    if (sp->cNext == NEXT_UNKNOWN) {
+        sp->cNext = next_added(sp, &sp->cNextKey) ? NEXT_FOUND : NEXT_NONE;
+    }
+    if (haveBase && (sp->cNext == NEXT_NONE || *key < sp->cNextKey)) {
+        sp->cBaseHave = false;
+        return true;
+    }
+    if (sp->cNext == NEXT_FOUND) {
+        *key = sp->cNextKey;
+        sp->cNext = NEXT_UNKNOWN;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief   Programs the block the encoder filled.
+ *
+ * @return  @p false if it runs past the bank or on a flash error.
+ */
+static bool write_block(ReaderAclStore *sp, bool *overflowed) {
+    size_t offset = keys_offset(sp) + sp->cBlocks * READER_ACL_BLOCK_SIZE;
+
+    if (offset + READER_ACL_BLOCK_SIZE > target_offset(sp) + sp->bankSize) {
+        *overflowed = true;
+        return false;
+    }
+    sp->cBlocks++;
+    return program(sp, offset, sp->buf, READER_ACL_BLOCK_SIZE);
+}
+
+/**
+ * @brief   Merges the next keys into the new image, as many as fill the
+ *          step or one block.
+ *
+ * @param[out] done         All keys are written.
+ * @param[out] overflowed   The blocks run past the bank.
+ * @return  @p false on a flash error or an overflow.
+ */
+static bool keys_step(ReaderAclStore *sp, bool *done, bool *overflowed) {
+    size_t max = READER_ACL_STEP_SIZE / 8, n = 0;
+    uint64_t key;
+
+    *done = false;
+    *overflowed = false;
+    while (n < max) {
+        if (!next_key(sp, &key)) {
+            *done = true;
+            break;
+        }
+        if (sp->cCursor + n >= sp->cCount) {
+            return false;
+        }
+        if (READER_ACL_BLOCK_SIZE == 0) {
+            sp->buf[2 * n] = (uint32_t)key;
+            sp->buf[2 * n + 1] = (uint32_t)(key >> 32);
+            n++;
+        } else {
+            n++;
+            if (!readerAclEncode(&sp->cEncoder, key)) {
+                if (!write_block(sp, overflowed)) {
+                    return false;
+                }
+                readerAclEncoderNext(&sp->cEncoder, (uint8_t *)sp->buf);
+                (void)readerAclEncode(&sp->cEncoder, key);
+                break;
+            }
+        }
+    }
+    if (READER_ACL_BLOCK_SIZE == 0 && n > 0 &&
+        !program(sp, keys_offset(sp) + 8 * sp->cCursor, sp->buf, 8 * n)) {
+        return false;
+    }
+    sp->cCursor += (uint32_t)n;
+    if (*done && READER_ACL_BLOCK_SIZE != 0 && sp->cEncoder.open &&
+        !write_block(sp, overflowed)) {
+        return false;
+    }
+    return !*done || sp->cCursor == sp->cCount;
+}
+
+/**
+ * @brief   Erases the log pages covered by the image, one a step.
+ *
+ * @return  @p false if none is left.
+ */
+static bool clean_step(ReaderAclStore *sp) {
+    uint32_t after = image_generation(sp);
+    uint8_t k;
+
+    for (k = 0; k < sp->pages; k++) {
+        uint8_t page = sp->order[k];
+        bool covered = true;
+        size_t i;
+
+        for (i = 1; i < sp->used[page] && covered; i++) {
+            const ReaderAclRecord *r = record(sp, page, i);
+
+            covered = r->op == OP_VOID || r->generation <= after;
+        }
+        if (covered) {
+            if (!erase_page(sp, log_offset(sp, page))) {
+                return false;
+            }
+            sp->seq[page] = 0;
+            sp->used[page] = 0;
+            sp->pages--;
+            memmove(&sp->order[k], &sp->order[k + 1], sp->pages - k);
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool commit_step(ReaderAclStore *sp) {
+    ReaderAclHeader *header = (ReaderAclHeader *)sp->buf;
+    const uint8_t *target = &sp->flash->base[target_offset(sp)];
+    size_t len = READER_ACL_BLOCK_SIZE == 0
+                     ? READER_ACL_IMAGE_SIZE(sp->cCount, sp->cWords)
+                     : READER_ACL_BLOCK_IMAGE_SIZE(sp->cBlocks,
+                                                   READER_ACL_BLOCK_SIZE,
+                                                   sp->cWords);
+    ReaderAcl image;
+    uint32_t after;
+    uint8_t k;
+
+    memset(header, 0, sizeof(*header));
+    header->magic = READER_ACL_MAGIC;
+    header->generation = sp->cGeneration;
+    header->count = sp->cCount;
+    header->bloomWords = sp->cWords;
+    header->bloomTests = readerAclBloomTests(READER_ACL_BLOOM_BITS);
+    header->blockSize = READER_ACL_BLOCK_SIZE;
+    header->blocks = sp->cBlocks;
+    memcpy(header->sums, sp->cSums, sizeof(header->sums));
+    header->crc = readerAclImageCrc(header, &target[sizeof(*header)],
+                                    len - sizeof(*header));
+    if (!program(sp, target_offset(sp), header, sizeof(*header)) ||
+        !readerAclInit(&image, target, sp->bankSize)) {
+        return false;
+    }
+
+    /* The switch. */
+    sp->image = image;
+    sp->bank = (uint8_t)(1 - sp->bank);
+    after = image_generation(sp);
+    sp->live = 0;
+    for (k = 0; k < sp->pages; k++) {
+        uint8_t page = sp->order[k];
+        size_t i;
+
+        for (i = 1; i < sp->used[page]; i++) {
+            const ReaderAclRecord *r = record(sp, page, i);
+
+            if (r->op != OP_VOID && r->generation > after) {
+                sp->live++;
+            }
+        }
+    }
+    return true;
+}
+
+/*===========================================================================*/
+/* Exported functions.                                                       */
+/*===========================================================================*/
+
+/**
+ * @brief   Mounts the store.
+ * @details Takes the bank with the newest valid image, replays the log on
+ *          top of it and voids the records of a delta cut short. Erases
+ *          log pages left half written.
+ *
+ * @return  @p false if the region is too small for two banks and the log,
+ *          the store then holds an empty list and takes no delta.
+ */
+bool readerAclStoreInit(ReaderAclStore *sp, const ReaderAclFlash *flash) {
+    size_t pages = flash->size / flash->pageSize;
+    ReaderAcl other;
+
+    memset(sp, 0, sizeof(*sp));
+    sp->flash = flash;
+    if (pages < READER_ACL_LOG_PAGES + 2 ||
+        flash->pageSize % RECORD_SIZE != 0) {
+        return false;
+    }
+    sp->bankSize = (pages - READER_ACL_LOG_PAGES) / 2 * flash->pageSize;
+
+    (void)readerAclInit(&sp->image, flash->base, sp->bankSize);
+    if (readerAclInit(&other, &flash->base[sp->bankSize], sp->bankSize) &&
+        (!readerAclValid(&sp->image) ||
+         other.header->generation > sp->image.header->generation)) {
+        sp->image = other;
+        sp->bank = 1;
+    }
+    if (readerAclValid(&sp->image)) {
+        sp->count = sp->image.header->count;
+        memcpy(sp->sums, sp->image.header->sums, sizeof(sp->sums));
+    }
+
+    mount_log(sp);
+    replay(sp);
+    if (sp->live >= compact_records(sp)) {
+        start_compaction(sp);
+    }
+    return true;
+}
+
+/**
+ * @brief   Whether @p card is on the list.
+ */
+bool readerAclStoreLookup(ReaderAclStore *sp, const Iso14443aCard *card) {
+    return readerAclStoreFind(sp, readerAclKey(card));
+}
+
+/**
+ * @brief   Whether @p key is on the list.
+ */
+bool readerAclStoreFind(ReaderAclStore *sp, uint64_t key) {
+    uint32_t start = platformCycles();
+    bool found = member(sp, key, NEWEST);
+
+    sp->stats.lookups++;
+    if (found) {
+        sp->stats.found++;
+    }
+    sp->stats.cycles += platformElapsedCycles(start);
+    return found;
+}
+
+/**
+ * @brief   Applies a delta of the controller.
+ * @details The delta is the generation it is based on and the generation
+ *          it leads to, 4 bytes each most significant first, and the
+ *          operations: @p READER_ACL_OP_ADD and @p READER_ACL_OP_REMOVE
+ *          followed by the UID length and the UID, @p READER_ACL_OP_CLEAR
+ *          alone. It is applied whole or not at all, also across a reset.
+ */
+readeraclresult_t readerAclStoreApply(ReaderAclStore *sp,
+                                      const uint8_t *delta, size_t len) {
+    uint32_t from, to;
+    size_t ops = 0, p;
+
+    if (sp->bankSize == 0 || len < 8) {
+        return READER_ACL_MALFORMED;
+    }
+    for (p = 8; p < len; ops++) {
+        if (delta[p] == READER_ACL_OP_CLEAR) {
+            p++;
+        } else if ((delta[p] == READER_ACL_OP_ADD ||
+                    delta[p] == READER_ACL_OP_REMOVE) && p + 2 <= len &&
+                   (delta[p + 1] == 4 || delta[p + 1] == 7 ||
+                    delta[p + 1] == 10) && p + 2 + delta[p + 1] <= len) {
+            p += 2 + delta[p + 1];
+        } else {
+            sp->stats.refused++;
+            return READER_ACL_MALFORMED;
+        }
+    }
+
+    from = get32(delta);
+    to = get32(&delta[4]);
+    if (from != sp->generation || to <= from) {
+        sp->stats.refused++;
+        return READER_ACL_OUT_OF_STEP;
+    }
+    if (room(sp) < ops + 1) {
+        if (sp->phase == PHASE_IDLE) {
+            start_compaction(sp);
+        }
+        sp->stats.refused++;
+        return sp->full ? READER_ACL_FULL : READER_ACL_BUSY;
+    }
+
+    for (p = 8; p < len;) {
+        uint8_t op = delta[p];
+        Iso14443aCard card;
+        uint64_t key;
+        bool ok = true;
+
+        if (op == READER_ACL_OP_CLEAR) {
+            p++;
+            if (sp->count == 0) {
+                sp->stats.unchanged++;
+                continue;
+            }
+            ok = append(sp, to, 0, 0, op);
+            sp->count = 0;
+            memset(sp->sums, 0, sizeof(sp->sums));
+        } else {
+            memset(&card, 0, sizeof(card));
+            card.uidlen = delta[p + 1];
+            memcpy(card.uid, &delta[p + 2], card.uidlen);
+            p += 2 + card.uidlen;
+            key = readerAclKey(&card);
+            if (member(sp, key, NEWEST) == (op == READER_ACL_OP_ADD)) {
+                sp->stats.unchanged++;
+                continue;
+            }
+            ok = append(sp, to, (uint32_t)key, (uint32_t)(key >> 32), op);
+            count_key(sp, (uint32_t)key, (uint32_t)(key >> 32),
+                      op == READER_ACL_OP_ADD ? 1 : -1);
+        }
+        if (!ok) {
+            break;
+        }
+        sp->stats.records++;
+    }
+    if (p < len || !append(sp, to, 0, 0, OP_COMMIT)) {
+        /* Mounting again voids what was written of the delta. */
+        (void)readerAclStoreInit(sp, sp->flash);
+        return READER_ACL_FLASH_ERROR;
+    }
+    sp->generation = to;
+    sp->stats.deltas++;
+    if (sp->phase == PHASE_IDLE && sp->live >= compact_records(sp)) {
+        start_compaction(sp);
+    }
+    return READER_ACL_OK;
+}
+
+/**
+ * @brief   Runs a step of the compaction under way.
+ * @details A step erases one flash page or programs up to
+ *          @p READER_ACL_STEP_SIZE bytes, after a scan of the log per key
+ *          written. A flash error abandons the compaction, the next one
+ *          starts over.
+ *
+ * @return  @p true while there are steps left.
+ */
+bool readerAclStoreService(ReaderAclStore *sp) {
+    size_t pageSize = sp->flash != NULL ? sp->flash->pageSize : 0;
+    size_t n;
+
+    switch (sp->phase) {
+    case PHASE_ERASE:
+        if (sp->cCursor < sp->bankSize / pageSize) {
+            size_t offset = target_offset(sp) + sp->cCursor * pageSize;
+
+            sp->cCursor++;
+            if (!region_erased(&sp->flash->base[offset], pageSize) &&
+                !erase_page(sp, offset)) {
+                break;
+            }
+            return true;
+        }
+        sp->cCursor = 0;
+        sp->phase = PHASE_KEYS;
+        return true;
+
+    case PHASE_KEYS: {
+        bool done, overflowed;
+
+        if (!keys_step(sp, &done, &overflowed)) {
+            if (overflowed) {
+                overflow(sp);
+                return sp->phase != PHASE_IDLE;
+            }
+            break;
+        }
+        if (done) {
+            sp->cCursor = 0;
+            sp->phase = PHASE_BLOOM;
+        }
+        return true;
+    }
+
+    case PHASE_BLOOM:
+        if (sp->cCursor < sp->cWords) {
+            uint8_t tests = readerAclBloomTests(READER_ACL_BLOOM_BITS);
+            uint32_t first = sp->cCursor;
+            ReaderAclIterator keys;
+            uint64_t key;
+
+            n = sp->cWords - first;
+            if (n > READER_ACL_STEP_SIZE / 4) {
+                n = READER_ACL_STEP_SIZE / 4;
+            }
+            memset(sp->buf, 0, sizeof(sp->buf));
+            readerAclIteratorInit(&keys, &sp->flash->base[keys_offset(sp)],
+                                  sp->cCount, READER_ACL_BLOCK_SIZE);
+            while (readerAclIteratorNext(&keys, &key)) {
+                readerAclBloomAdd(sp->buf, first, (uint32_t)n, sp->cWords,
+                                  tests, key);
+            }
+            if (!program(sp, target_offset(sp) + sizeof(ReaderAclHeader) +
+                             4 * first, sp->buf, 4 * n)) {
+                break;
+            }
+            sp->cCursor += (uint32_t)n;
+            return true;
+        }
+        sp->phase = PHASE_COMMIT;
+        return true;
+
+    case PHASE_COMMIT:
+        if (!commit_step(sp)) {
+            break;
+        }
+        sp->phase = PHASE_CLEAN;
+        return true;
+
+    case PHASE_CLEAN:
+        if (clean_step(sp)) {
+            return true;
+        }
+        sp->phase = PHASE_IDLE;
+        if (sp->live >= compact_records(sp)) {
+            start_compaction(sp);
+        }
+        return sp->phase != PHASE_IDLE;
+
+    default:
+        return false;
+    }
+
+    /* Flash error, the other bank is left as it is. */
+    sp->phase = PHASE_IDLE;
+    return false;
+}
+
+/**
+ * @brief   Encodes the status sent after a delta and on request.
+ * @details The result of the last delta, the generation, the card count
+ *          and the checksums of the @p READER_ACL_CHUNKS chunks, 4 bytes
+ *          each most significant first.
+ *
+ * @return  @p READER_ACL_STATUS_SIZE.
+ */
+size_t readerAclStoreStatus(const ReaderAclStore *sp,
+                            readeraclresult_t result, uint8_t *buf) {
+    unsigned i;
+
+    buf[0] = (uint8_t)result;
+    put32(&buf[1], sp->generation);
+    put32(&buf[5], sp->count);
+    for (i = 0; i < READER_ACL_CHUNKS; i++) {
+        put32(&buf[9 + 4 * i], sp->sums[i]);
+    }
+    return READER_ACL_STATUS_SIZE;
+}
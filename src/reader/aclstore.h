@@ -0,0 +1,222 @@
+/**
+ * @file    aclstore.h
+ * @brief   Access list in flash kept in step with the controller.
+ * @details The controller sends the changes of its list as deltas: adds
+ *          and removes of cards taking the list from one generation to the
+ *          next. The store keeps the list in a flash region of two image
+ *          banks (see @p reader/acl.h) and a log:
+ *
+ *          - A delta is appended to the log as one record per card which
+ *            actually changes, then a commit record. A delta cut short by a
+ *            reset has no commit and is voided when the store is mounted
+ *            again, so the list is always at a generation the controller
+ *            sent. Deltas which do not follow the current generation are
+ *            refused, the controller learns the generation from the status.
+ *          - A lookup scans the records newer than the image, newest first,
+ *            and searches the image only if none names the card.
+ *          - Once the log fills up, the store compacts it in the background:
+ *            it merges the image and the log into a new image in the other
+ *            bank, its header written last, and then erases the log pages
+ *            the new image covers. The list stays readable throughout, new
+ *            deltas go to the log meanwhile.
+ *            The new image has its keys in blocks of
+ *            @p READER_ACL_BLOCK_SIZE, their size only known once written:
+ *            if they do not fit, the compaction starts over with half the
+ *            filter.
+ *
+ *          The store keeps the card count and the chunk checksums of the
+ *          list (see @p readerAclChecksum()) up to date with every record.
+ *          The controller compares them with its own to find the chunks
+ *          where the lists diverge.
+ *
+ *          Flash is written through the erase and program functions of the
+ *          @p ReaderAclFlash, in whole pages and in halfwords, and read in
+ *          place. A halfword is only programmed once after an erase, except
+ *          to zero it.
+ *
+ *          Not locked: call all the functions from one thread, the one
+ *          reading the cards.
+ */
+
+#ifndef _READER_ACLSTORE_H_
+#define _READER_ACLSTORE_H_
+
+#include "reader/acl.h"
+
+/**
+ * @brief   Flash pages of the log, at the end of the region.
+ */
+#if !defined(READER_ACL_LOG_PAGES) || defined(__DOXYGEN__)
+#define READER_ACL_LOG_PAGES        4
+#endif
+
+/**
+ * @brief   Records in the log from which it is compacted.
+ * @details A lookup scans them all, 0 compacts at half the log.
+ */
+#if !defined(READER_ACL_COMPACT_RECORDS) || defined(__DOXYGEN__)
+#define READER_ACL_COMPACT_RECORDS  0
+#endif
+
+/**
+ * @brief   Bytes written per step of a compaction.
+ */
+#define READER_ACL_STEP_SIZE        256
+
+#if READER_ACL_BLOCK_SIZE > READER_ACL_STEP_SIZE
+#error "READER_ACL_BLOCK_SIZE must be at most READER_ACL_STEP_SIZE"
+#endif
+
+/**
+ * @name    Delta operations
+ * @{
+ */
+#define READER_ACL_OP_ADD           0x01    /**< Card let in.               */
+#define READER_ACL_OP_REMOVE        0x02    /**< Card no longer let in.     */
+#define READER_ACL_OP_CLEAR         0x03    /**< All cards removed, starts a
+                                                 full load.                 */
+/** @} */
+
+/**
+ * @brief   Longest encoded status, see @p readerAclStoreStatus().
+ */
+#define READER_ACL_STATUS_SIZE      (1 + 4 + 4 + 4 * READER_ACL_CHUNKS)
+
+/**
+ * @brief   Result of a delta.
+ */
+typedef enum {
+    READER_ACL_OK = 0,              /**< Applied.                           */
+    READER_ACL_OUT_OF_STEP = 1,     /**< Not based on the current
+                                         generation, ignored.               */
+    READER_ACL_BUSY = 2,            /**< The log is full until the
+                                         compaction ends, try again later.  */
+    READER_ACL_FULL = 3,            /**< The list no longer fits in a bank,
+                                         the log cannot be compacted.       */
+    READER_ACL_MALFORMED = 4,
+    READER_ACL_FLASH_ERROR = 5,
+} readeraclresult_t;
+
+/**
+ * @brief   Erases the page at @p offset in the region.
+ */
+typedef bool (*readeraclerasecb_t)(void *arg, size_t offset);
+
+/**
+ * @brief   Programs @p len bytes at @p offset in the region, both even.
+ */
+typedef bool (*readeraclprogramcb_t)(void *arg, size_t offset,
+                                     const void *data, size_t len);
+
+/**
+ * @brief   Flash region of the store.
+ */
+typedef struct {
+    const uint8_t *base;            /**< Memory mapped, aligned on 4.       */
+    size_t size;
+    size_t pageSize;
+    readeraclerasecb_t erase;
+    readeraclprogramcb_t program;
+    void *arg;
+} ReaderAclFlash;
+
+/**
+ * @brief   Store counters.
+ */
+typedef struct {
+    uint32_t lookups;
+    uint32_t found;
+    uint32_t scanned;               /**< Log records looked at by the
+                                         lookups.                           */
+    uint32_t cycles;                /**< Spent looking up, see
+                                         @p platformCycles().               */
+    uint32_t deltas;                /**< Applied.                           */
+    uint32_t refused;               /**< Deltas not applied.                */
+    uint32_t records;               /**< Changes written to the log.        */
+    uint32_t unchanged;             /**< Adds of cards on the list and
+                                         removes of cards not on it.        */
+    uint32_t compactions;
+    uint32_t erases;                /**< Flash pages.                       */
+    uint32_t programmed;            /**< Flash bytes.                       */
+    uint32_t voided;                /**< Records of unfinished deltas.      */
+} ReaderAclStoreStats;
+
+/**
+ * @brief   A log record.
+ */
+typedef struct {
+    uint32_t generation;            /**< The delta's.                       */
+    uint32_t lo;                    /**< Key, see @p readerAclKey().        */
+    uint32_t hi;
+    uint8_t op;
+    uint8_t reserved;
+    uint16_t check;                 /**< Against torn writes.               */
+} ReaderAclRecord;
+
+/**
+ * @brief   Store structure.
+ */
+typedef struct {
+    const ReaderAclFlash *flash;
+    ReaderAclStoreStats stats;
+    size_t bankSize;
+    uint8_t bank;                   /**< Of @p image.                       */
+    ReaderAcl image;                /**< May be invalid, an empty list.     */
+    uint32_t generation;            /**< Of the last delta committed.       */
+    uint32_t count;                 /**< Cards on the list.                 */
+    uint32_t sums[READER_ACL_CHUNKS];
+    /* Log. */
+    uint32_t seq[READER_ACL_LOG_PAGES]; /**< Page sequence numbers, 0 for an
+                                             erased page.                   */
+    uint16_t used[READER_ACL_LOG_PAGES]; /**< Records written per page.     */
+    uint8_t order[READER_ACL_LOG_PAGES]; /**< Pages in use, oldest first.   */
+    uint8_t pages;                  /**< In use.                            */
+    uint32_t nextSeq;
+    uint16_t live;                  /**< Records newer than the image.      */
+    bool full;                      /**< The list does not fit in a bank.   */
+    uint8_t shrink;                 /**< Filter halvings to fit the blocks. */
+    uint32_t overflow;              /**< Cards whose blocks did not fit
+                                         without a filter, 0 if none.       */
+    /* Compaction. */
+    uint8_t phase;
+    uint32_t cGeneration;           /**< Generation of the new image.       */
+    uint32_t cCount;
+    uint32_t cSums[READER_ACL_CHUNKS];
+    uint32_t cWords;                /**< Filter of the new image.           */
+    uint32_t cCursor;               /**< Page, key or filter word next.     */
+    uint32_t cBlocks;               /**< Written.                           */
+    ReaderAclEncoder cEncoder;
+    ReaderAclIterator cBase;        /**< Keys of the old image.             */
+    uint64_t cBaseKey;
+    bool cBaseHave;                 /**< @p cBaseKey is the next one.       */
+    uint64_t cAdded;                /**< Last key looked at in the log.     */
+    bool cAddedAny;
+    uint8_t cNext;                  /**< Whether @p cNextKey is known.      */
+    uint64_t cNextKey;              /**< Next key of the log to write.      */
+    bool cBaseAlive;                /**< Not cleared in the log.            */
+    uint32_t buf[READER_ACL_STEP_SIZE / 4];
+} ReaderAclStore;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  bool readerAclStoreInit(ReaderAclStore *sp, const ReaderAclFlash *flash);
+  bool readerAclStoreLookup(ReaderAclStore *sp, const Iso14443aCard *card);
+  bool readerAclStoreFind(ReaderAclStore *sp, uint64_t key);
+  readeraclresult_t readerAclStoreApply(ReaderAclStore *sp,
+                                        const uint8_t *delta, size_t len);
+  bool readerAclStoreService(ReaderAclStore *sp);
+  size_t readerAclStoreStatus(const ReaderAclStore *sp,
+                              readeraclresult_t result, uint8_t *buf);
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @brief   Whether a compaction is under way.
+ */
+static inline bool readerAclStoreBusy(const ReaderAclStore *sp) {
+    return sp->phase != 0;
+}
+
+#endif /* _READER_ACLSTORE_H_ */
@@ -0,0 +1,43 @@
+/**
+ * @file    event.c
+ * @brief   Reader events reported to the controller.
+ */
+
+#include <string.h>
+
+#include "reader/event.h"
+
+/**
+ * @brief   Encodes an event.
+ *
+ * @return  Length of the encoded event, 0 if it does not fit in @p size
+ *          bytes.
+ */
+size_t readerEventEncode(const ReaderEvent *event, uint8_t *buf, size_t size) {
+    const Iso14443aCard *card = &event->card;
+    size_t len = 3 + card->uidlen + 3;
+
+    if (event->type == READER_EVENT_TAMPER ||
+        event->type == READER_EVENT_SUPPLY ||
+        event->type == READER_EVENT_RFID_FAULT) {
+        if (size < 4) {
+            return 0;
+        }
+        buf[0] = event->type;
+        buf[1] = event->flags;
+        buf[2] = (uint8_t)(event->value >> 8);
+        buf[3] = (uint8_t)event->value;
+        return 4;
+    }
+    if (len > size || card->uidlen > ISO14443A_UID_MAX) {
+        return 0;
+    }
+    buf[0] = event->type;
+    buf[1] = event->flags;
+    buf[2] = card->uidlen;
+    memcpy(&buf[3], card->uid, card->uidlen);
+    buf[3 + card->uidlen] = card->sak;
+    buf[4 + card->uidlen] = card->atqa[0];
+    buf[5 + card->uidlen] = card->atqa[1];
+    return len;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file    event.h
+ * @brief   Reader events reported to the controller.
+ * @details A card event is encoded as the event type, the flags, the UID
+ *          length, the UID, the SAK and the two ATQA bytes. Tamper and
+ *          supply warnings and faults carry a 16 bit value after the type
+ *          and the flags, most significant byte first.
+ */
+
+#ifndef _READER_EVENT_H_
+#define _READER_EVENT_H_
+
+#include "rfid/iso14443a.h"
+
+/**
+ * @brief   Longest encoded event.
+ */
+#define READER_EVENT_MAX_SIZE       (3 + ISO14443A_UID_MAX + 3)
+
+/**
+ * @name    Event types
+ * @{
+ */
+#define READER_EVENT_CARD           0x01    /**< Card presented.    */
+#define READER_EVENT_CARD_GONE      0x02    /**< Card left the field. */
+#define READER_EVENT_TAMPER         0x03    /**< Enclosure opened (value 1)
+                                                 or closed (value 0).       */
+#define READER_EVENT_SUPPLY         0x04    /**< Supply voltage out of
+                                                 range, value in mV.        */
+#define READER_EVENT_FEEDBACK_DONE  0x05    /**< Feedback on the card
+                                                 signalled.                 */
+#define READER_EVENT_RFID_FAULT     0x06    /**< RF front-end did not start,
+                                                 value the failed starts in
+                                                 a row.                     */
+/** @} */
+
+/**
+ * @name    Event flags
+ * @{
+ */
+#define READER_EVENT_FLAG_AUTH      0x01    /**< Card passed authentication. */
+#define READER_EVENT_FLAG_LOCAL     0x02    /**< Decided by the reader from
+                                                 its access list.           */
+#define READER_EVENT_FLAG_GRANTED   0x04    /**< On the access list.        */
+#define READER_EVENT_FLAG_GUESS     0x08    /**< With @p LOCAL: shown ahead
+                                                 of the controller, whose
+                                                 feedback still counts.     */
+/** @} */
+
+/**
+ * @brief   A card presented to or taken away from the reader, or a
+ *          warning.
+ */
+typedef struct {
+    uint8_t type;
+    Iso14443aCard card;             /**< Card events.                       */
+    uint8_t flags;
+    uint16_t value;                 /**< Warnings and faults.               */
+} ReaderEvent;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  size_t readerEventEncode(const ReaderEvent *event, uint8_t *buf, size_t size);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _READER_EVENT_H_ */
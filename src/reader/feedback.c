@@ -0,0 +1,151 @@
+/**
+ * @file    feedback.c
+ * @brief   Feedback commands of the controller and the guesses of the
+ *          reader ahead of them.
+ */
+
+#include <string.h>
+
+#include "reader/acl.h"
+#include "reader/feedback.h"
+
+/*===========================================================================*/
+/* Local functions.                                                          */
+/*===========================================================================*/
+
+/**
+ * @brief   Drops the oldest guess.
+ */
+static void drop_oldest(ReaderFeedback *rfp) {
+    rfp->head = (uint8_t)((rfp->head + 1) % READER_FEEDBACK_PENDING);
+    rfp->count--;
+}
+
+/**
+ * @brief   Drops the guesses the controller did not answer in time.
+ */
+static void expire(ReaderFeedback *rfp) {
+    while (rfp->count > 0 &&
+           platformElapsedUs(rfp->guesses[rfp->head].shownAt) >=
+               READER_FEEDBACK_TIMEOUT_US) {
+        drop_oldest(rfp);
+        rfp->stats.unanswered++;
+    }
+}
+
+/*===========================================================================*/
+/* Exported functions.                                                       */
+/*===========================================================================*/
+
+/**
+ * @brief   Decodes a feedback command.
+ *
+ * @return  @p false if malformed.
+ */
+bool readerFeedbackDecode(const uint8_t *payload, size_t len,
+                          Iso14443aCard *card, bool *granted) {
+    size_t uidlen;
+
+    if (len < 1) {
+        return false;
+    }
+    uidlen = payload[0];
+    if (uidlen == 0 || uidlen > ISO14443A_UID_MAX ||
+        (len != 1 + uidlen && len != 2 + uidlen)) {
+        return false;
+    }
+    memset(card, 0, sizeof(*card));
+    card->uidlen = (uint8_t)uidlen;
+    memcpy(card->uid, &payload[1], uidlen);
+    *granted = len == 1 + uidlen ||
+               (payload[1 + uidlen] & READER_FEEDBACK_GRANTED) != 0;
+    return true;
+}
+
+/**
+ * @brief   Initializes with no guess waiting.
+ */
+void readerFeedbackInit(ReaderFeedback *rfp,
+                        readerfeedbackcorrection_t correction) {
+    memset(rfp, 0, sizeof(*rfp));
+    rfp->correction = correction;
+}
+
+/**
+ * @brief   Notes the decision shown on @p card ahead of the controller.
+ */
+void readerFeedbackGuess(ReaderFeedback *rfp, const Iso14443aCard *card,
+                         bool granted) {
+    ReaderFeedbackGuess *guess;
+
+    platformLock();
+    expire(rfp);
+    if (rfp->count == READER_FEEDBACK_PENDING) {
+        drop_oldest(rfp);
+        rfp->stats.unanswered++;
+    }
+    guess = &rfp->guesses[(rfp->head + rfp->count) % READER_FEEDBACK_PENDING];
+    guess->key = readerAclKey(card);
+    guess->shownAt = platformNowUs();
+    guess->granted = granted;
+    rfp->count++;
+    rfp->stats.guesses++;
+    platformUnlock();
+}
+
+/**
+ * @brief   Reconciles the controller's decision on @p card with the oldest
+ *          guess on it.
+ * @details Guesses older than the one answered stay, the controller may
+ *          answer the cards in another order.
+ */
+readerfeedbackresult_t readerFeedbackConfirm(ReaderFeedback *rfp,
+                                             const Iso14443aCard *card,
+                                             bool granted) {
+    readerfeedbackresult_t result = READER_FEEDBACK_SHOW;
+    uint64_t key = readerAclKey(card);
+    size_t i, j;
+
+    platformLock();
+    expire(rfp);
+    for (i = 0; i < rfp->count; i++) {
+        ReaderFeedbackGuess *guess =
+            &rfp->guesses[(rfp->head + i) % READER_FEEDBACK_PENDING];
+        uint32_t elapsed;
+
+        if (guess->key != key) {
+            continue;
+        }
+        elapsed = platformElapsedUs(guess->shownAt);
+        if (guess->granted == granted) {
+            rfp->stats.right++;
+            rfp->stats.savedUs += elapsed;
+            result = READER_FEEDBACK_AGREED;
+        } else {
+            if (guess->granted) {
+                rfp->stats.falseGrants++;
+            } else {
+                rfp->stats.falseDenies++;
+            }
+            rfp->stats.wrongUs += elapsed;
+            if (rfp->correction == READER_FEEDBACK_FOLLOW ||
+                (rfp->correction == READER_FEEDBACK_REVOKE && !granted)) {
+                rfp->stats.corrected++;
+                result = READER_FEEDBACK_CORRECT;
+            } else {
+                result = READER_FEEDBACK_KEPT;
+            }
+        }
+        /* Closes the gap, the newer guesses move down. */
+        for (j = i; j + 1 < rfp->count; j++) {
+            rfp->guesses[(rfp->head + j) % READER_FEEDBACK_PENDING] =
+                rfp->guesses[(rfp->head + j + 1) % READER_FEEDBACK_PENDING];
+        }
+        rfp->count--;
+        platformUnlock();
+        return result;
+    }
+    rfp->stats.unexpected++;
+    platformUnlock();
+    return result;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file    feedback.h
+ * @brief   Feedback commands of the controller and the guesses of the
+ *          reader ahead of them.
+ * @details A feedback command (@p PROTO_MSG_FEEDBACK) carries the UID
+ *          length, the UID and the decision flags, see
+ *          @p READER_FEEDBACK_GRANTED. Controllers which send no flags only
+ *          signal grants.
+ *
+ *          With speculation, the reader shows its own decision from the
+ *          access list as soon as a card arrives and still sends the event.
+ *          The guess waits here for the controller's feedback on the same
+ *          card, oldest first. If they agree, the feedback is already shown
+ *          and the controller's round trip was saved; if not, the
+ *          correction policy tells whether to show the controller's
+ *          decision instead. A guess the controller does not answer within
+ *          @p READER_FEEDBACK_TIMEOUT_US is dropped.
+ *
+ *          Guesses and feedback come from any thread.
+ */
+
+#ifndef _READER_FEEDBACK_H_
+#define _READER_FEEDBACK_H_
+
+#include "rfid/iso14443a.h"
+
+/**
+ * @brief   Guesses waiting for the controller.
+ * @details The oldest one is dropped for a new one.
+ */
+#if !defined(READER_FEEDBACK_PENDING) || defined(__DOXYGEN__)
+#define READER_FEEDBACK_PENDING     4
+#endif
+
+/**
+ * @brief   How long a guess waits for the controller.
+ */
+#if !defined(READER_FEEDBACK_TIMEOUT_US) || defined(__DOXYGEN__)
+#define READER_FEEDBACK_TIMEOUT_US  2000000
+#endif
+
+/**
+ * @name    Feedback flags
+ * @{
+ */
+#define READER_FEEDBACK_GRANTED     0x01    /**< Let the card in.           */
+/** @} */
+
+/**
+ * @brief   What to do when the controller decides otherwise.
+ */
+typedef enum {
+    READER_FEEDBACK_KEEP = 0,       /**< Leave the guess shown.             */
+    READER_FEEDBACK_REVOKE = 1,     /**< Correct grants the controller
+                                         denies, leave the denials.         */
+    READER_FEEDBACK_FOLLOW = 2,     /**< Show the controller's decision.    */
+} readerfeedbackcorrection_t;
+
+/**
+ * @brief   What a feedback command asks for.
+ */
+typedef enum {
+    READER_FEEDBACK_SHOW = 0,       /**< No guess on the card, show the
+                                         decision.                          */
+    READER_FEEDBACK_AGREED = 1,     /**< Already shown.                     */
+    READER_FEEDBACK_KEPT = 2,       /**< Differs from the guess shown, left
+                                         as it is.                          */
+    READER_FEEDBACK_CORRECT = 3,    /**< Differs from the guess shown, show
+                                         the decision instead.              */
+} readerfeedbackresult_t;
+
+/**
+ * @brief   Speculation counters.
+ */
+typedef struct {
+    uint32_t guesses;
+    uint32_t right;
+    uint32_t falseGrants;           /**< Guessed granted, denied.           */
+    uint32_t falseDenies;           /**< Guessed denied, granted.           */
+    uint32_t corrected;             /**< Wrong guesses replaced.            */
+    uint32_t unanswered;            /**< Guesses dropped without feedback.  */
+    uint32_t unexpected;            /**< Feedback without a guess.          */
+    uint64_t savedUs;               /**< Sum of the waits for the
+                                         controller spared by right
+                                         guesses.                           */
+    uint64_t wrongUs;               /**< Sum of the times wrong guesses
+                                         showed until the feedback.         */
+} ReaderFeedbackStats;
+
+/**
+ * @brief   A guess waiting for the controller.
+ */
+typedef struct {
+    uint64_t key;                   /**< See @p readerAclKey().             */
+    uint32_t shownAt;
+    bool granted;
+} ReaderFeedbackGuess;
+
+/**
+ * @brief   Speculation structure.
+ * @note    @p correction may be changed at any time.
+ */
+typedef struct {
+    readerfeedbackcorrection_t correction;
+    ReaderFeedbackStats stats;
+    uint8_t head;                   /**< Oldest guess.                      */
+    uint8_t count;
+    ReaderFeedbackGuess guesses[READER_FEEDBACK_PENDING];
+} ReaderFeedback;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  bool readerFeedbackDecode(const uint8_t *payload, size_t len,
+                            Iso14443aCard *card, bool *granted);
+  void readerFeedbackInit(ReaderFeedback *rfp,
+                          readerfeedbackcorrection_t correction);
+  void readerFeedbackGuess(ReaderFeedback *rfp, const Iso14443aCard *card,
+                           bool granted);
+  readerfeedbackresult_t readerFeedbackConfirm(ReaderFeedback *rfp,
+                                               const Iso14443aCard *card,
+                                               bool granted);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _READER_FEEDBACK_H_ */
@@ -0,0 +1,179 @@
+/**
+ * @file    keycache.c
+ * @brief   Cache of the diversified card keys.
+ */
+
+#include <string.h>
+
+#include "reader/keycache.h"
+
+/*===========================================================================*/
+/* Local functions.                                                          */
+/*===========================================================================*/
+
+static ReaderKeyMaster *find_master(ReaderKeyCache *rkp, const uint8_t *aid,
+                                    uint8_t keyno) {
+    size_t i;
+
+    for (i = 0; i < READER_KEY_CACHE_MASTERS; i++) {
+        ReaderKeyMaster *master = &rkp->masters[i];
+
+        if (master->valid && master->keyno == keyno &&
+            memcmp(master->aid, aid, DESFIRE_AID_SIZE) == 0) {
+            return master;
+        }
+    }
+    return NULL;
+}
+
+static void drop(ReaderKeyCacheEntry *entry) {
+    memset(entry, 0, sizeof(*entry));
+}
+
+/**
+ * @brief   The free entry, or else the least recently used one.
+ */
+static ReaderKeyCacheEntry *victim(ReaderKeyCache *rkp) {
+    ReaderKeyCacheEntry *oldest = &rkp->entries[0];
+    size_t i;
+
+    for (i = 0; i < READER_KEY_CACHE_SIZE; i++) {
+        ReaderKeyCacheEntry *entry = &rkp->entries[i];
+
+        if (entry->usedAt == 0) {
+            return entry;
+        }
+        if (entry->usedAt < oldest->usedAt) {
+            oldest = entry;
+        }
+    }
+    rkp->stats.evictions++;
+    return oldest;
+}
+
+/*===========================================================================*/
+/* Exported functions.                                                       */
+/*===========================================================================*/
+
+/**
+ * @brief   Empties the cache and forgets the master keys.
+ *
+ * @param[in] system    System identifier added to the diversification
+ *                      input, at most @p READER_KEY_SYSTEM_MAX bytes are
+ *                      used.
+ */
+void readerKeyCacheInit(ReaderKeyCache *rkp, const uint8_t *system,
+                        size_t len) {
+    memset(rkp, 0, sizeof(*rkp));
+    if (len > READER_KEY_SYSTEM_MAX) {
+        len = READER_KEY_SYSTEM_MAX;
+    }
+    memcpy(rkp->system, system, len);
+    rkp->systemlen = (uint8_t)len;
+}
+
+/**
+ * @brief   Installs the master key @p keyno of application @p aid, or
+ *          rotates it, dropping the keys derived from the old one.
+ *
+ * @return  @p false if all master slots hold other keys.
+ */
+bool readerKeyCacheSetMaster(ReaderKeyCache *rkp, const uint8_t *aid,
+                             uint8_t keyno, const uint8_t *key) {
+    ReaderKeyMaster *master = find_master(rkp, aid, keyno);
+    size_t i;
+
+    if (master == NULL) {
+        for (i = 0; i < READER_KEY_CACHE_MASTERS; i++) {
+            if (!rkp->masters[i].valid) {
+                master = &rkp->masters[i];
+                break;
+            }
+        }
+        if (master == NULL) {
+            return false;
+        }
+    }
+    for (i = 0; i < READER_KEY_CACHE_SIZE; i++) {
+        ReaderKeyCacheEntry *entry = &rkp->entries[i];
+
+        if (entry->usedAt != 0 && &rkp->masters[entry->master] == master) {
+            drop(entry);
+            rkp->stats.invalidations++;
+        }
+    }
+    memcpy(master->aid, aid, DESFIRE_AID_SIZE);
+    master->keyno = keyno;
+    cmacKeyInit(&master->key, key);
+    master->valid = true;
+    return true;
+}
+
+/**
+ * @brief   Looks up the key @p keyno of application @p aid on @p card,
+ *          deriving it on a miss.
+ *
+ * @param[out] key      @p DESFIRE_KEY_SIZE bytes.
+ * @return  @p false if the master key is not installed.
+ */
+bool readerKeyCacheGet(ReaderKeyCache *rkp, const Iso14443aCard *card,
+                       const uint8_t *aid, uint8_t keyno, uint8_t *key) {
+    ReaderKeyMaster *master = find_master(rkp, aid, keyno);
+    ReaderKeyCacheEntry *entry;
+    uint8_t input[DESFIRE_DIVERSIFY_MAX];
+    uint8_t index;
+    uint32_t start;
+    size_t i, n;
+
+    if (master == NULL) {
+        return false;
+    }
+    index = (uint8_t)(master - rkp->masters);
+    if (++rkp->clock == 0) {
+        /* Wrapped after four billion taps, start over. */
+        readerKeyCacheFlush(rkp);
+        rkp->clock = 1;
+    }
+    for (i = 0; i < READER_KEY_CACHE_SIZE; i++) {
+        entry = &rkp->entries[i];
+        if (entry->usedAt != 0 && entry->master == index &&
+            entry->uidlen == card->uidlen &&
+            memcmp(entry->uid, card->uid, card->uidlen) == 0) {
+            entry->usedAt = rkp->clock;
+            memcpy(key, entry->key, DESFIRE_KEY_SIZE);
+            rkp->stats.hits++;
+            return true;
+        }
+    }
+
+    /* UID, AID and system identifier. */
+    start = platformCycles();
+    n = card->uidlen;
+    memcpy(input, card->uid, n);
+    memcpy(&input[n], aid, DESFIRE_AID_SIZE);
+    n += DESFIRE_AID_SIZE;
+    memcpy(&input[n], rkp->system, rkp->systemlen);
+    n += rkp->systemlen;
+    desfireDiversifyKey(&master->key, input, n, key);
+    rkp->stats.misses++;
+    rkp->stats.cycles += platformElapsedCycles(start);
+
+    entry = victim(rkp);
+    entry->usedAt = rkp->clock;
+    entry->master = index;
+    entry->uidlen = card->uidlen;
+    memcpy(entry->uid, card->uid, card->uidlen);
+    memcpy(entry->key, key, DESFIRE_KEY_SIZE);
+    return true;
+}
+
+/**
+ * @brief   Drops all keys, keeping the master keys.
+ */
+void readerKeyCacheFlush(ReaderKeyCache *rkp) {
+    size_t i;
+
+    for (i = 0; i < READER_KEY_CACHE_SIZE; i++) {
+        drop(&rkp->entries[i]);
+    }
+}
@@ -0,0 +1,103 @@
+/**
+ * @file    keycache.h
+ * @brief   Cache of the diversified card keys.
+ * @details Each card holds its own keys, diversified from an application
+ *          master key and the card's UID (see @p desfireDiversifyKey()).
+ *          Deriving one costs three AES blocks before the card handshake
+ *          can even start. The cache keeps the keys of the cards seen last,
+ *          by UID and master, and evicts the least recently used one.
+ *
+ *          The master keys are installed with @p readerKeyCacheSetMaster()
+ *          by application and key number. Installing a new version of a
+ *          master drops the keys derived from the old one.
+ *
+ *          Not locked: call it from the thread reading the cards, a key
+ *          rotation from the controller is handed over to that thread.
+ */
+
+#ifndef _READER_KEYCACHE_H_
+#define _READER_KEYCACHE_H_
+
+#include "rfid/desfire.h"
+
+/**
+ * @brief   Diversified keys kept, 32 bytes each.
+ */
+#if !defined(READER_KEY_CACHE_SIZE) || defined(__DOXYGEN__)
+#define READER_KEY_CACHE_SIZE       32
+#endif
+
+/**
+ * @brief   Master keys, one per application and key number used.
+ */
+#if !defined(READER_KEY_CACHE_MASTERS) || defined(__DOXYGEN__)
+#define READER_KEY_CACHE_MASTERS    2
+#endif
+
+/**
+ * @brief   Longest system identifier in the diversification input, after
+ *          the UID and the AID.
+ */
+#define READER_KEY_SYSTEM_MAX       (DESFIRE_DIVERSIFY_MAX -                \
+                                     ISO14443A_UID_MAX - DESFIRE_AID_SIZE)
+
+/**
+ * @brief   Cache counters.
+ */
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;                /**< Keys derived.                      */
+    uint32_t evictions;             /**< Keys dropped to make room.         */
+    uint32_t invalidations;         /**< Keys dropped with their master.    */
+    uint32_t cycles;                /**< Spent deriving, see
+                                         @p platformCycles().               */
+} ReaderKeyCacheStats;
+
+/**
+ * @brief   An application master key.
+ */
+typedef struct {
+    bool valid;
+    uint8_t aid[DESFIRE_AID_SIZE];
+    uint8_t keyno;
+    CmacKey key;
+} ReaderKeyMaster;
+
+/**
+ * @brief   A diversified key.
+ */
+typedef struct {
+    uint32_t usedAt;                /**< Last lookup, 0 if free.            */
+    uint8_t master;                 /**< Index in @p masters.               */
+    uint8_t uidlen;
+    uint8_t uid[ISO14443A_UID_MAX];
+    uint8_t key[DESFIRE_KEY_SIZE];
+} ReaderKeyCacheEntry;
+
+/**
+ * @brief   Cache structure.
+ */
+typedef struct {
+    ReaderKeyCacheStats stats;
+    uint32_t clock;                 /**< Lookups so far.                    */
+    uint8_t system[READER_KEY_SYSTEM_MAX];
+    uint8_t systemlen;
+    ReaderKeyMaster masters[READER_KEY_CACHE_MASTERS];
+    ReaderKeyCacheEntry entries[READER_KEY_CACHE_SIZE];
+} ReaderKeyCache;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void readerKeyCacheInit(ReaderKeyCache *rkp, const uint8_t *system,
+                          size_t len);
+  bool readerKeyCacheSetMaster(ReaderKeyCache *rkp, const uint8_t *aid,
+                               uint8_t keyno, const uint8_t *key);
+  bool readerKeyCacheGet(ReaderKeyCache *rkp, const Iso14443aCard *card,
+                         const uint8_t *aid, uint8_t keyno, uint8_t *key);
+  void readerKeyCacheFlush(ReaderKeyCache *rkp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _READER_KEYCACHE_H_ */
@@ -0,0 +1,171 @@
+/**
+ * @file    outbox.c
+ * @brief   Outbound event queue combining events into shared frames.
+ */
+
+#include <string.h>
+
+#include "reader/event.h"
+#include "reader/outbox.h"
+
+/**
+ * @brief   Initializes an empty outbox feeding @p pp, with the default
+ *          coalescing window.
+ */
+void readerOutboxInit(ReaderOutbox *rop, Proto *pp, readeroutboxcb_t wakeup,
+                      void *arg) {
+    memset(rop, 0, sizeof(*rop));
+    rop->proto = pp;
+    rop->coalesce = READER_OUTBOX_COALESCE_US;
+    rop->wakeup = wakeup;
+    rop->arg = arg;
+}
+
+/**
+ * @brief   Queues an encoded event.
+ * @details Adds it to the frame being collected, or starts a new one. An
+ *          urgent event gets a frame of its own ahead of the one being
+ *          collected, unless that one holds an ordered event. An urgent
+ *          event joining a frame, or any with no coalescing window, closes
+ *          it.
+ *
+ * @return  @p false if the event was dropped.
+ */
+bool readerOutboxPut(ReaderOutbox *rop, const uint8_t *event, size_t len,
+                     readeroutboxprio_t prio) {
+    ReaderOutboxFrame *frame;
+    size_t last;
+    bool overtake;
+    bool wakeup = false;
+
+    if (len == 0 || len + 1 > PROTO_PAYLOAD_MAX) {
+        return false;
+    }
+
+    platformLock();
+    last = (rop->head + rop->count + READER_OUTBOX_FRAMES - 1) %
+           READER_OUTBOX_FRAMES;
+    frame = &rop->frames[last];
+    overtake = prio == READER_OUTBOX_URGENT && rop->open && !frame->ordered;
+    if (rop->open && !overtake && frame->len + 1 + len > PROTO_PAYLOAD_MAX) {
+        rop->open = false;
+        wakeup = true;
+    }
+    if (overtake || !rop->open) {
+        if (rop->count == READER_OUTBOX_FRAMES) {
+            rop->stats.dropped++;
+            platformUnlock();
+            return false;
+        }
+        frame = &rop->frames[(rop->head + rop->count) % READER_OUTBOX_FRAMES];
+        if (overtake) {
+            /* Takes the place of the frame being collected, which moves up
+               and stays open. */
+            *frame = rop->frames[last];
+            frame = &rop->frames[last];
+            rop->stats.overtaken++;
+        }
+        frame->openedAt = platformNowUs();
+        frame->events = 0;
+        frame->len = 0;
+        frame->ordered = false;
+        rop->count++;
+        rop->open = true;
+        wakeup = true;
+    }
+    frame->data[frame->len] = (uint8_t)len;
+    memcpy(&frame->data[frame->len + 1], event, len);
+    frame->len += (uint8_t)(1 + len);
+    frame->events++;
+    rop->stats.events++;
+    if (prio == READER_OUTBOX_ORDERED) {
+        frame->ordered = true;
+    }
+    if (prio == READER_OUTBOX_URGENT) {
+        rop->stats.urgent++;
+        if (!overtake) {
+            rop->open = false;
+        }
+        wakeup = true;
+    }
+    if (rop->coalesce == 0) {
+        rop->open = false;
+        wakeup = true;
+    }
+    platformUnlock();
+
+    if (wakeup && rop->wakeup != NULL) {
+        rop->wakeup(rop->arg);
+    }
+    return true;
+}
+
+/**
+ * @brief   Hands the frames due to the protocol, as far as its window
+ *          allows.
+ * @details A frame is due once closed or once its coalescing window has
+ *          passed. Call it from the thread running the protocol, e.g. from
+ *          the service function of @p protoRun().
+ *
+ * @return  Microseconds until the frame being collected is due,
+ *          @p LINK_WAIT_FOREVER if there is none or the window is full.
+ */
+uint32_t readerOutboxService(ReaderOutbox *rop) {
+    while (true) {
+        ReaderOutboxFrame *frame = &rop->frames[rop->head];
+        protoresult_t result;
+
+        platformLock();
+        if (rop->count == 0) {
+            platformUnlock();
+            return LINK_WAIT_FOREVER;
+        }
+        if (rop->count == 1 && rop->open) {
+            uint32_t elapsed = platformElapsedUs(frame->openedAt);
+
+            if (elapsed < rop->coalesce) {
+                platformUnlock();
+                return rop->coalesce - elapsed;
+            }
+            rop->open = false;
+        }
+        platformUnlock();
+
+        /* Closed frames are not touched by the producers any more. */
+        if (frame->events == 1) {
+            result = protoSend(rop->proto, PROTO_MSG_EVENT, &frame->data[1],
+                               frame->len - 1U);
+        } else {
+            result = protoSend(rop->proto, PROTO_MSG_EVENTS, frame->data,
+                               frame->len);
+        }
+        if (result != PROTO_OK) {
+            /* Retried once an acknowledgement makes room, or the
+             * session is up. */
+            return LINK_WAIT_FOREVER;
+        }
+        rop->stats.frames++;
+
+        platformLock();
+        rop->head = (uint8_t)((rop->head + 1) % READER_OUTBOX_FRAMES);
+        rop->count--;
+        platformUnlock();
+    }
+}
+
+/**
+ * @brief   Tells how an event of @p type is held back.
+ * @details An access decision waits for card arrivals. Departures must not
+ *          be overtaken by the arrival of the same card, the warnings and
+ *          feedback acknowledgements are telemetry.
+ */
+readeroutboxprio_t readerOutboxPriority(uint8_t type) {
+    switch (type) {
+    case READER_EVENT_CARD:
+        return READER_OUTBOX_URGENT;
+    case READER_EVENT_CARD_GONE:
+        return READER_OUTBOX_ORDERED;
+    default:
+        return READER_OUTBOX_LOW;
+    }
+}
@@ -0,0 +1,115 @@
+/**
+ * @file    outbox.h
+ * @brief   Outbound event queue combining events into shared frames.
+ * @details Every frame to the controller costs the protocol overhead, the
+ *          COBS framing and, on a bus, a turn. The outbox collects the
+ *          events produced within @p coalesce of the first one into one
+ *          message of type @p PROTO_MSG_EVENTS, each event after its length
+ *          byte. A frame holding a single event goes out as a plain
+ *          @p PROTO_MSG_EVENT.
+ *
+ *          Urgent events, those an access decision waits for, go out at the
+ *          next service in a frame ahead of the one being collected, so
+ *          they never wait for telemetry. They do not overtake ordered
+ *          events, e.g. the departure of a card which may come right back:
+ *          then they close the frame and leave with it. Otherwise events
+ *          keep their order. @p readerOutboxPriority() tells how each
+ *          reader event is treated.
+ *
+ *          Events are put from any thread, the frames are handed to the
+ *          protocol by @p readerOutboxService(), from the thread running
+ *          it.
+ */
+
+#ifndef _READER_OUTBOX_H_
+#define _READER_OUTBOX_H_
+
+#include "link/proto.h"
+
+/**
+ * @brief   Frames waiting for room in the protocol window, including the
+ *          one being collected.
+ * @details Events which fit in none of them are dropped.
+ */
+#if !defined(READER_OUTBOX_FRAMES) || defined(__DOXYGEN__)
+#define READER_OUTBOX_FRAMES        8
+#endif
+
+/**
+ * @brief   Default coalescing window.
+ */
+#if !defined(READER_OUTBOX_COALESCE_US) || defined(__DOXYGEN__)
+#define READER_OUTBOX_COALESCE_US   20000
+#endif
+
+/**
+ * @brief   How an event may be held back.
+ */
+typedef enum {
+    READER_OUTBOX_LOW = 0,          /**< Waits for the coalescing window,
+                                         may be overtaken.                  */
+    READER_OUTBOX_ORDERED = 1,      /**< Waits for the coalescing window,
+                                         never overtaken.                   */
+    READER_OUTBOX_URGENT = 2,       /**< Goes out at the next service.      */
+} readeroutboxprio_t;
+
+/**
+ * @brief   Called after an event is put which the sending thread must look
+ *          at, i.e. it started a frame or closed one.
+ */
+typedef void (*readeroutboxcb_t)(void *arg);
+
+/**
+ * @brief   Outbox counters.
+ */
+typedef struct {
+    uint32_t events;                /**< Events put.                        */
+    uint32_t urgent;                /**< Urgent events put.                 */
+    uint32_t overtaken;             /**< Frames overtaken by an urgent
+                                         event.                             */
+    uint32_t frames;                /**< Messages handed to the protocol.   */
+    uint32_t dropped;               /**< Events with all frames in use.     */
+} ReaderOutboxStats;
+
+/**
+ * @brief   A frame being collected or waiting to be sent.
+ */
+typedef struct {
+    uint32_t openedAt;              /**< First event.                       */
+    uint8_t events;
+    uint8_t len;
+    bool ordered;                   /**< Holds an ordered event.            */
+    uint8_t data[PROTO_PAYLOAD_MAX];
+} ReaderOutboxFrame;
+
+/**
+ * @brief   Outbox structure.
+ * @note    @p coalesce may be changed at any time, 0 sends every event in
+ *          its own frame.
+ */
+typedef struct {
+    Proto *proto;
+    uint32_t coalesce;              /**< Microseconds.                      */
+    readeroutboxcb_t wakeup;        /**< Optional.                          */
+    void *arg;
+    ReaderOutboxStats stats;
+    uint8_t head;                   /**< Oldest frame.                      */
+    uint8_t count;                  /**< Frames in use.                     */
+    bool open;                      /**< The newest frame takes events.     */
+    ReaderOutboxFrame frames[READER_OUTBOX_FRAMES];
+} ReaderOutbox;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void readerOutboxInit(ReaderOutbox *rop, Proto *pp, readeroutboxcb_t wakeup,
+                        void *arg);
+  bool readerOutboxPut(ReaderOutbox *rop, const uint8_t *event, size_t len,
+                       readeroutboxprio_t prio);
+  uint32_t readerOutboxService(ReaderOutbox *rop);
+  readeroutboxprio_t readerOutboxPriority(uint8_t type);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _READER_OUTBOX_H_ */
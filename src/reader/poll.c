@@ -0,0 +1,125 @@
+/**
+ * @file    poll.c
+ * @brief   Adaptive RF poll scheduler.
+ */
+
+#include <string.h>
+
+#include "reader/poll.h"
+
+const ReaderPollPolicy readerPollDefaultPolicy = {
+    20000,
+    500000,
+    2000000,
+    ISO14443A_POWER_UP_US
+};
+
+/**
+ * @brief   Adds the field on time up to @p now to the statistics.
+ */
+static void account_field(ReaderPoll *rpp, uint32_t now) {
+    if (rpp->field) {
+        rpp->stats.fieldOnUs += now - rpp->fieldSince;
+        rpp->fieldSince = now;
+    }
+}
+
+static mfrc522result_t field_on(ReaderPoll *rpp) {
+    mfrc522result_t result = mfrc522SetPowerDown(rpp->mdp, false);
+
+    if (result != MFRC522_OK) {
+        return result;
+    }
+    mfrc522SetField(rpp->mdp, true);
+    rpp->field = true;
+    rpp->fieldSince = platformNowUs();
+    rpp->stats.fieldCycles++;
+    platformDelayUs(rpp->policy.fieldGuard);
+    return MFRC522_OK;
+}
+
+static void field_off(ReaderPoll *rpp) {
+    account_field(rpp, platformNowUs());
+    mfrc522SetField(rpp->mdp, false);
+    mfrc522SetPowerDown(rpp->mdp, true);
+    rpp->field = false;
+}
+
+/**
+ * @brief   Initializes the scheduler with the default policy.
+ * @details The chip must be started, the field is switched on by the first
+ *          poll.
+ */
+void readerPollInit(ReaderPoll *rpp, MFRC522Driver *mdp,
+                    ReaderPresence *presence) {
+    memset(rpp, 0, sizeof(*rpp));
+    rpp->mdp = mdp;
+    rpp->presence = presence;
+    rpp->policy = readerPollDefaultPolicy;
+    rpp->interval = rpp->policy.fastInterval;
+    rpp->lastPoll = platformNowUs();
+    rpp->lastActivity = rpp->lastPoll;
+}
+
+/**
+ * @brief   Changes the policy, effective from the next poll.
+ */
+void readerPollSetPolicy(ReaderPoll *rpp, const ReaderPollPolicy *policy) {
+    rpp->policy = *policy;
+    if (rpp->interval < policy->fastInterval) {
+        rpp->interval = policy->fastInterval;
+    } else if (rpp->interval > policy->slowInterval) {
+        rpp->interval = policy->slowInterval;
+    }
+}
+
+/**
+ * @brief   Runs one poll.
+ *
+ * @return  Microseconds to sleep before the next poll.
+ */
+uint32_t readerPollRun(ReaderPoll *rpp) {
+    const ReaderPollPolicy *policy = &rpp->policy;
+    uint32_t start = platformNowUs();
+    uint32_t since = start - rpp->lastPoll;
+    uint32_t arrivals = rpp->presence->stats.arrivals;
+    uint32_t now, busy, sleep;
+
+    rpp->stats.polls++;
+    rpp->stats.elapsedUs += since;
+    rpp->lastPoll = start;
+    account_field(rpp, start);
+
+    if (rpp->field || field_on(rpp) == MFRC522_OK) {
+        readerPresencePoll(rpp->presence, rpp->mdp);
+    }
+    now = platformNowUs();
+
+    arrivals = rpp->presence->stats.arrivals - arrivals;
+    if (arrivals > 0) {
+        rpp->stats.detections += arrivals;
+        rpp->stats.detectIntervalUs += (uint64_t)since * arrivals;
+        if (since > rpp->stats.detectIntervalMaxUs) {
+            rpp->stats.detectIntervalMaxUs = since;
+        }
+    }
+    if (arrivals > 0 || readerPresenceCount(rpp->presence) > 0) {
+        rpp->lastActivity = now;
+    }
+
+    if (now - rpp->lastActivity < policy->activeHold) {
+        rpp->interval = policy->fastInterval;
+    } else if (rpp->interval < policy->slowInterval / 2) {
+        rpp->interval *= 2;
+    } else {
+        rpp->interval = policy->slowInterval;
+    }
+
+    busy = now - start;
+    sleep = busy < rpp->interval ? rpp->interval - busy : 0;
+    if (rpp->field && readerPresenceCount(rpp->presence) == 0 &&
+        sleep >= ISO14443A_RESET_US) {
+        field_off(rpp);
+    }
+    return sleep;
+}
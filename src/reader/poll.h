@@ -0,0 +1,83 @@
+/**
+ * @file    poll.h
+ * @brief   Adaptive RF poll scheduler.
+ * @details Decides when the RF field goes on to look for cards and for how
+ *          long. Without cards on the reader each poll switches the field
+ *          on, gives the cards @p fieldGuard to power up, runs the presence
+ *          tracker and puts the front-end back in soft power-down. The poll
+ *          interval stays at @p fastInterval for @p activeHold after the
+ *          last card was seen and then doubles on every empty poll up to
+ *          @p slowInterval.
+ *
+ *          While cards rest on the reader the field stays on, so that they
+ *          stay halted and the tracker only confirms them. The field is also
+ *          kept on when it would be off for less than
+ *          @p ISO14443A_RESET_US, too short to reset the cards.
+ */
+
+#ifndef _READER_POLL_H_
+#define _READER_POLL_H_
+
+#include "reader/presence.h"
+
+/**
+ * @brief   Scheduling policy, all times in microseconds.
+ */
+typedef struct {
+    uint32_t fastInterval;          /**< Poll interval after activity.      */
+    uint32_t slowInterval;          /**< Longest interval when idle.        */
+    uint32_t activeHold;            /**< Time at @p fastInterval after the
+                                         last card was seen.                */
+    uint32_t fieldGuard;            /**< Card power-up before the REQA.     */
+} ReaderPollPolicy;
+
+/**
+ * @brief   Counters of the scheduler.
+ * @details The duty cycle is @p fieldOnUs over @p elapsedUs. A card is
+ *          detected at most @p intervalUs plus the field guard after it
+ *          arrived, the interval before each detection is summed up in
+ *          @p detectIntervalUs.
+ */
+typedef struct {
+    uint32_t polls;
+    uint32_t fieldCycles;           /**< Field switched on from off.        */
+    uint64_t fieldOnUs;
+    uint64_t elapsedUs;
+    uint32_t detections;
+    uint64_t detectIntervalUs;
+    uint32_t detectIntervalMaxUs;
+} ReaderPollStats;
+
+/**
+ * @brief   Scheduler structure.
+ */
+typedef struct {
+    MFRC522Driver *mdp;
+    ReaderPresence *presence;
+    ReaderPollPolicy policy;
+    ReaderPollStats stats;
+    uint32_t interval;              /**< Current poll interval.             */
+    uint32_t lastPoll;
+    uint32_t lastActivity;
+    uint32_t fieldSince;
+    bool field;
+} ReaderPoll;
+
+/**
+ * @brief   Default policy: 50 polls per second for two seconds after a
+ *          card, backing off to two per second.
+ */
+extern const ReaderPollPolicy readerPollDefaultPolicy;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void readerPollInit(ReaderPoll *rpp, MFRC522Driver *mdp,
+                      ReaderPresence *presence);
+  void readerPollSetPolicy(ReaderPoll *rpp, const ReaderPollPolicy *policy);
+  uint32_t readerPollRun(ReaderPoll *rpp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _READER_POLL_H_ */
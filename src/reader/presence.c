@@ -0,0 +1,126 @@
+/**
+ * @file    presence.c
+ * @brief   Tracking of the cards resting on the reader.
+ */
+
+#include <string.h>
+
+#include "reader/presence.h"
+
+static ReaderPresenceSlot *find(ReaderPresence *rpp, const Iso14443aCard *card) {
+    size_t i;
+
+    for (i = 0; i < READER_PRESENCE_SLOTS; i++) {
+        ReaderPresenceSlot *slot = &rpp->slots[i];
+
+        if (slot->used && slot->card.uidlen == card->uidlen &&
+            memcmp(slot->card.uid, card->uid, card->uidlen) == 0) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+static ReaderPresenceSlot *find_free(ReaderPresence *rpp) {
+    size_t i;
+
+    for (i = 0; i < READER_PRESENCE_SLOTS; i++) {
+        if (!rpp->slots[i].used) {
+            return &rpp->slots[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief   Initializes the tracker with the default hold-off and check
+ *          interval and no known cards.
+ */
+void readerPresenceInit(ReaderPresence *rpp, readerpresencecb_t callback,
+                        void *ctx) {
+    memset(rpp, 0, sizeof(*rpp));
+    rpp->holdoff = READER_PRESENCE_HOLDOFF_US;
+    rpp->checkInterval = READER_PRESENCE_CHECK_US;
+    rpp->callback = callback;
+    rpp->ctx = ctx;
+    rpp->checkedAt = platformNowUs() - rpp->checkInterval;
+}
+
+/**
+ * @brief   Polls the field once, with the RF field already on.
+ * @details Confirms the known cards if @p checkInterval has elapsed, reads
+ *          the new ones and reports the arrivals and departures through the
+ *          callback.
+ *
+ * @return  Result of the inventory of the new cards.
+ */
+mfrc522result_t readerPresencePoll(ReaderPresence *rpp, MFRC522Driver *mdp) {
+    Iso14443aCard found[READER_PRESENCE_SLOTS];
+    Iso14443aInventory inv = {found, READER_PRESENCE_SLOTS, 0, 0, 0, 0, 0};
+    uint32_t now = platformNowUs();
+    mfrc522result_t result;
+    size_t i;
+
+    rpp->stats.polls++;
+    if (now - rpp->checkedAt >= rpp->checkInterval) {
+        rpp->checkedAt = now;
+        for (i = 0; i < READER_PRESENCE_SLOTS; i++) {
+            ReaderPresenceSlot *slot = &rpp->slots[i];
+
+            if (slot->used) {
+                rpp->stats.checks++;
+                if (iso14443aReselect(mdp, &slot->card) == MFRC522_OK) {
+                    slot->seenAt = now;
+                }
+            }
+        }
+    }
+
+    result = iso14443aInventory(mdp, &inv);
+    for (i = 0; i < inv.count; i++) {
+        ReaderPresenceSlot *slot = find(rpp, &found[i]);
+
+        if (slot == NULL) {
+            slot = find_free(rpp);
+            rpp->stats.arrivals++;
+            if (slot != NULL) {
+                slot->card = found[i];
+                slot->used = true;
+            } else {
+                rpp->stats.untracked++;
+            }
+            if (rpp->callback != NULL) {
+                rpp->callback(rpp->ctx, &found[i], true);
+            }
+        }
+        if (slot != NULL) {
+            /* Also a known card put back: it is IDLE again. */
+            slot->seenAt = now;
+        }
+    }
+
+    for (i = 0; i < READER_PRESENCE_SLOTS; i++) {
+        ReaderPresenceSlot *slot = &rpp->slots[i];
+
+        if (slot->used && now - slot->seenAt >= rpp->holdoff) {
+            slot->used = false;
+            rpp->stats.departures++;
+            if (rpp->callback != NULL) {
+                rpp->callback(rpp->ctx, &slot->card, false);
+            }
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief   Number of cards currently on the reader.
+ */
+size_t readerPresenceCount(const ReaderPresence *rpp) {
+    size_t i, n = 0;
+
+    for (i = 0; i < READER_PRESENCE_SLOTS; i++) {
+        n += rpp->slots[i].used ? 1 : 0;
+    }
+    return n;
+}
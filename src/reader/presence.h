@@ -0,0 +1,94 @@
+/**
+ * @file    presence.h
+ * @brief   Tracking of the cards resting on the reader.
+ * @details The tracker remembers the cards it has read and reports a card
+ *          only when it arrives and when it leaves, instead of on every
+ *          poll. Cards are halted as soon as they are read, so the REQA
+ *          inventory of the next polls only finds new cards. The known cards
+ *          are confirmed every @p checkInterval with a WUPA and a select by
+ *          UID (see @p iso14443aReselect()), and reported gone once they
+ *          have not been seen for @p holdoff. A card taken away and put back
+ *          within @p holdoff is not reported again.
+ */
+
+#ifndef _READER_PRESENCE_H_
+#define _READER_PRESENCE_H_
+
+#include "rfid/iso14443a.h"
+
+/**
+ * @brief   Cards tracked at the same time.
+ * @details A card arriving while all slots are in use is reported but not
+ *          tracked, it is not reported gone and not reported again as long
+ *          as it stays halted on the reader.
+ */
+#if !defined(READER_PRESENCE_SLOTS) || defined(__DOXYGEN__)
+#define READER_PRESENCE_SLOTS       4
+#endif
+
+/**
+ * @brief   Default time a card must be absent to be reported gone.
+ */
+#if !defined(READER_PRESENCE_HOLDOFF_US) || defined(__DOXYGEN__)
+#define READER_PRESENCE_HOLDOFF_US  300000
+#endif
+
+/**
+ * @brief   Default interval of the presence checks of the known cards.
+ */
+#if !defined(READER_PRESENCE_CHECK_US) || defined(__DOXYGEN__)
+#define READER_PRESENCE_CHECK_US    100000
+#endif
+
+/**
+ * @brief   Called when a card arrives (@p arrived set) or leaves.
+ */
+typedef void (*readerpresencecb_t)(void *ctx, const Iso14443aCard *card,
+                                   bool arrived);
+
+/**
+ * @brief   Counters of the tracker.
+ */
+typedef struct {
+    uint32_t polls;
+    uint32_t checks;                /**< Presence checks of known cards.    */
+    uint32_t arrivals;
+    uint32_t departures;
+    uint32_t untracked;             /**< Arrivals with all slots in use.    */
+} ReaderPresenceStats;
+
+/**
+ * @brief   A known card.
+ */
+typedef struct {
+    Iso14443aCard card;
+    uint32_t seenAt;                /**< Last time the card answered.       */
+    bool used;
+} ReaderPresenceSlot;
+
+/**
+ * @brief   Tracker structure.
+ * @note    @p holdoff and @p checkInterval may be changed at any time.
+ */
+typedef struct {
+    uint32_t holdoff;               /**< Microseconds.                      */
+    uint32_t checkInterval;         /**< Microseconds.                      */
+    readerpresencecb_t callback;
+    void *ctx;
+    ReaderPresenceStats stats;
+    uint32_t checkedAt;
+    ReaderPresenceSlot slots[READER_PRESENCE_SLOTS];
+} ReaderPresence;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void readerPresenceInit(ReaderPresence *rpp, readerpresencecb_t callback,
+                          void *ctx);
+  mfrc522result_t readerPresencePoll(ReaderPresence *rpp, MFRC522Driver *mdp);
+  size_t readerPresenceCount(const ReaderPresence *rpp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _READER_PRESENCE_H_ */
@@ -0,0 +1,291 @@
+/**
+ * @file    desfire.c
+ * @brief   MIFARE DESFire EV1 AES authentication and MACed commands.
+ */
+
+#include <string.h>
+
+#include "rfid/desfire.h"
+
+/*===========================================================================*/
+/* Local definitions.                                                        */
+/*===========================================================================*/
+
+#define CLA_NATIVE                  0x90
+#define SW1_NATIVE                  0x91
+
+/* CLA, INS, P1, P2, Lc and Le around the data. */
+#define APDU_OVERHEAD               6
+
+/*===========================================================================*/
+/* Local functions.                                                          */
+/*===========================================================================*/
+
+/**
+ * @brief   Sends a native command wrapped in an APDU.
+ * @details The response data is left in @p dfp->apdu, the status in
+ *          @p dfp->status.
+ */
+static mfrc522result_t transceive(Desfire *dfp, uint8_t cmd,
+                                  const uint8_t *data, size_t len,
+                                  size_t *rlen) {
+    size_t n = 0;
+    mfrc522result_t result;
+
+    dfp->apdu[n++] = CLA_NATIVE;
+    dfp->apdu[n++] = cmd;
+    dfp->apdu[n++] = 0x00;
+    dfp->apdu[n++] = 0x00;
+    if (len > 0) {
+        dfp->apdu[n++] = (uint8_t)len;
+        memcpy(&dfp->apdu[n], data, len);
+        n += len;
+    }
+    dfp->apdu[n++] = 0x00;
+
+    /* The whole command is sent before the response arrives. */
+    result = isoDepExchange(dfp->isodep, dfp->apdu, n, dfp->apdu,
+                            sizeof(dfp->apdu), &n);
+    if (result != MFRC522_OK) {
+        return result;
+    }
+    if (n < 2 || dfp->apdu[n - 2] != SW1_NATIVE) {
+        return MFRC522_PROTOCOL_ERROR;
+    }
+    dfp->status = dfp->apdu[n - 1];
+    *rlen = n - 2;
+    return MFRC522_OK;
+}
+
+/**
+ * @brief   Blocks a CMAC of @p len bytes takes.
+ */
+static uint32_t cmac_blocks(size_t len) {
+    return len == 0 ? 1 : (uint32_t)((len + AES_BLOCK_SIZE - 1) /
+                                     AES_BLOCK_SIZE);
+}
+
+/**
+ * @brief   Runs @p a followed by @p b through the CMAC chain.
+ */
+static void chain(Desfire *dfp, const uint8_t *a, size_t alen,
+                  const uint8_t *b, size_t blen) {
+    uint32_t start = platformCycles();
+    Cmac cmac;
+
+    cmacInit(&cmac, &dfp->session, dfp->iv);
+    cmacUpdate(&cmac, a, alen);
+    cmacUpdate(&cmac, b, blen);
+    cmacFinish(&cmac, dfp->iv);
+    dfp->stats.blocks += cmac_blocks(alen + blen);
+    dfp->stats.cycles += platformElapsedCycles(start);
+}
+
+static void close_session(Desfire *dfp) {
+    dfp->authenticated = false;
+    memset(&dfp->session, 0, sizeof(dfp->session));
+    memset(dfp->iv, 0, sizeof(dfp->iv));
+}
+
+/*===========================================================================*/
+/* Exported functions.                                                       */
+/*===========================================================================*/
+
+/**
+ * @brief   Talks to the card activated on @p idp.
+ */
+void desfireInit(Desfire *dfp, IsoDep *idp) {
+    memset(dfp, 0, sizeof(*dfp));
+    dfp->isodep = idp;
+}
+
+/**
+ * @brief   Selects the application @p aid, ending the session.
+ */
+mfrc522result_t desfireSelectApplication(Desfire *dfp, const uint8_t *aid) {
+    mfrc522result_t result;
+    size_t n;
+
+    close_session(dfp);
+    result = transceive(dfp, DESFIRE_CMD_SELECT_APPLICATION, aid,
+                        DESFIRE_AID_SIZE, &n);
+    if (result != MFRC522_OK) {
+        return result;
+    }
+    return dfp->status == DESFIRE_OPERATION_OK ? MFRC522_OK
+                                               : MFRC522_PROTOCOL_ERROR;
+}
+
+/**
+ * @brief   Authenticates with key @p keyno of the selected application and
+ *          starts a session.
+ *
+ * @param[in] key       @p DESFIRE_KEY_SIZE bytes.
+ * @param[in] rnda      @p DESFIRE_RANDOM_SIZE fresh random bytes.
+ * @return  @p MFRC522_AUTH_ERROR if either end has the wrong key.
+ */
+mfrc522result_t desfireAuthenticate(Desfire *dfp, uint8_t keyno,
+                                    const uint8_t *key,
+                                    const uint8_t *rnda) {
+    uint8_t rndb[DESFIRE_RANDOM_SIZE];
+    uint8_t msg[2 * DESFIRE_RANDOM_SIZE];
+    uint8_t diff = 0;
+    uint32_t start;
+    mfrc522result_t result;
+    size_t n, i;
+
+    close_session(dfp);
+    result = transceive(dfp, DESFIRE_CMD_AUTHENTICATE_AES, &keyno, 1, &n);
+    if (result != MFRC522_OK) {
+        return result;
+    }
+    if (dfp->status != DESFIRE_ADDITIONAL_FRAME || n != AES_BLOCK_SIZE) {
+        return MFRC522_PROTOCOL_ERROR;
+    }
+
+    /* RndB, then RndA and RndB rotated. */
+    start = platformCycles();
+    aesInit(&dfp->session.aes, key);
+    aesCbcDecrypt(&dfp->session.aes, dfp->iv, dfp->apdu, rndb,
+                  DESFIRE_RANDOM_SIZE);
+    memcpy(msg, rnda, DESFIRE_RANDOM_SIZE);
+    memcpy(&msg[DESFIRE_RANDOM_SIZE], &rndb[1], DESFIRE_RANDOM_SIZE - 1);
+    msg[sizeof(msg) - 1] = rndb[0];
+    aesCbcEncrypt(&dfp->session.aes, dfp->iv, msg, msg, sizeof(msg));
+    dfp->stats.blocks += 4;
+    dfp->stats.cycles += platformElapsedCycles(start);
+
+    result = transceive(dfp, DESFIRE_CMD_ADDITIONAL_FRAME, msg, sizeof(msg),
+                        &n);
+    if (result != MFRC522_OK) {
+        goto done;
+    }
+    if (dfp->status == DESFIRE_AUTHENTICATION_ERROR) {
+        dfp->stats.rejected++;
+        result = MFRC522_AUTH_ERROR;
+        goto done;
+    }
+    if (dfp->status != DESFIRE_OPERATION_OK || n != AES_BLOCK_SIZE) {
+        result = MFRC522_PROTOCOL_ERROR;
+        goto done;
+    }
+
+    /* RndA rotated, compared in constant time. */
+    start = platformCycles();
+    aesCbcDecrypt(&dfp->session.aes, dfp->iv, dfp->apdu, msg,
+                  DESFIRE_RANDOM_SIZE);
+    for (i = 0; i < DESFIRE_RANDOM_SIZE; i++) {
+        diff |= (uint8_t)(msg[i] ^ rnda[(i + 1) % DESFIRE_RANDOM_SIZE]);
+    }
+    if (diff != 0) {
+        dfp->stats.rejected++;
+        result = MFRC522_AUTH_ERROR;
+        goto done;
+    }
+    memcpy(&msg[0], &rnda[0], 4);
+    memcpy(&msg[4], &rndb[0], 4);
+    memcpy(&msg[8], &rnda[12], 4);
+    memcpy(&msg[12], &rndb[12], 4);
+    cmacKeyInit(&dfp->session, msg);
+    dfp->stats.blocks += 3;
+    dfp->stats.cycles += platformElapsedCycles(start);
+    memset(dfp->iv, 0, sizeof(dfp->iv));
+    dfp->authenticated = true;
+    dfp->stats.authentications++;
+
+done:
+    if (!dfp->authenticated) {
+        close_session(dfp);
+    }
+    memset(rndb, 0, sizeof(rndb));
+    memset(msg, 0, sizeof(msg));
+    return result;
+}
+
+/**
+ * @brief   Sends a native command and returns the data of its one frame
+ *          response.
+ * @details In a session the command goes through the CMAC chain and the
+ *          MAC of the response is checked and removed.
+ *
+ * @return  @p MFRC522_PROTOCOL_ERROR for an error status, see
+ *          @p dfp->status, @p MFRC522_AUTH_ERROR for a wrong MAC.
+ */
+mfrc522result_t desfireCommand(Desfire *dfp, uint8_t cmd,
+                               const uint8_t *data, size_t len,
+                               uint8_t *response, size_t size,
+                               size_t *rlen) {
+    mfrc522result_t result;
+    uint8_t diff = 0;
+    size_t n, i;
+
+    *rlen = 0;
+    if (len > DESFIRE_DATA_MAX) {
+        return MFRC522_OVERFLOW;
+    }
+    if (dfp->authenticated) {
+        chain(dfp, &cmd, 1, data, len);
+    }
+    result = transceive(dfp, cmd, data, len, &n);
+    if (result == MFRC522_OK && dfp->status != DESFIRE_OPERATION_OK) {
+        result = MFRC522_PROTOCOL_ERROR;
+    }
+    if (result != MFRC522_OK) {
+        close_session(dfp);
+        return result;
+    }
+
+    if (dfp->authenticated) {
+        if (n < DESFIRE_MAC_SIZE) {
+            close_session(dfp);
+            return MFRC522_PROTOCOL_ERROR;
+        }
+        n -= DESFIRE_MAC_SIZE;
+        chain(dfp, dfp->apdu, n, &dfp->status, 1);
+        for (i = 0; i < DESFIRE_MAC_SIZE; i++) {
+            diff |= (uint8_t)(dfp->iv[i] ^ dfp->apdu[n + i]);
+        }
+        if (diff != 0) {
+            dfp->stats.rejected++;
+            close_session(dfp);
+            return MFRC522_AUTH_ERROR;
+        }
+    }
+    if (n > size) {
+        return MFRC522_OVERFLOW;
+    }
+    memcpy(response, dfp->apdu, n);
+    *rlen = n;
+    return MFRC522_OK;
+}
+
+/**
+ * @brief   Derives the AES key of one card from @p master, after NXP AN10922.
+ * @details The key is the CMAC of 0x01 and @p input, e.g. the UID, the AID
+ *          and a system identifier. Unlike RFC 4493 the message is always
+ *          padded to two blocks. Takes three AES blocks on top of the
+ *          subkeys of @p master, computed once.
+ *
+ * @param[in] input     At most @p DESFIRE_DIVERSIFY_MAX bytes.
+ * @param[out] key      @p DESFIRE_KEY_SIZE bytes.
+ */
+void desfireDiversifyKey(const CmacKey *master, const uint8_t *input,
+                         size_t len, uint8_t *key) {
+    uint8_t m[2 * AES_BLOCK_SIZE];
+    const uint8_t *subkey = master->k1;
+    size_t i;
+
+    m[0] = 0x01;
+    memcpy(&m[1], input, len);
+    if (1 + len < sizeof(m)) {
+        m[1 + len] = 0x80;
+        memset(&m[2 + len], 0, sizeof(m) - 2 - len);
+        subkey = master->k2;
+    }
+    aesEncrypt(&master->aes, m, key);
+    for (i = 0; i < AES_BLOCK_SIZE; i++) {
+        key[i] ^= m[AES_BLOCK_SIZE + i] ^ subkey[i];
+    }
+    aesEncrypt(&master->aes, key, key);
+    memset(m, 0, sizeof(m));
+}
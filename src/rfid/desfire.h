@@ -0,0 +1,133 @@
+/**
+ * @file    desfire.h
+ * @brief   MIFARE DESFire EV1 AES authentication and MACed commands.
+ * @details Native DESFire commands go wrapped in ISO/IEC 7816-4 APDUs
+ *          (CLA 0x90) to a card activated with @p isoDepActivate().
+ *
+ *          @p desfireAuthenticate() runs the three pass mutual
+ *          authentication with an AES key of the selected application:
+ *
+ *          - The card sends its random number RndB, encrypted.
+ *          - The reader answers with its own RndA and RndB rotated by one
+ *            byte, encrypted, proving it holds the key.
+ *          - The card returns RndA rotated by one byte, encrypted, proving
+ *            the same.
+ *
+ *          All three are AES-128 in CBC mode, each chaining on the last
+ *          ciphertext block of the previous one. The session key is made of
+ *          the first and last four bytes of RndA and RndB.
+ *
+ *          After it every command is MACed: the reader runs the command
+ *          through the CMAC chain and the card appends the first
+ *          @p DESFIRE_MAC_SIZE bytes of the CMAC of its response and status,
+ *          which @p desfireCommand() checks. Any error status ends the
+ *          session.
+ *
+ *          Card keys are usually diversified from a master key and the UID
+ *          with @p desfireDiversifyKey(), after NXP AN10922.
+ *
+ *          The key expansions and the AES blocks are counted in
+ *          @p DesfireStats, with the cycles they take on the target.
+ */
+
+#ifndef _DESFIRE_H_
+#define _DESFIRE_H_
+
+#include "crypto/cmac.h"
+#include "rfid/isodep.h"
+
+/*===========================================================================*/
+/* Constants.                                                                */
+/*===========================================================================*/
+
+#define DESFIRE_KEY_SIZE            AES_KEY_SIZE
+#define DESFIRE_AID_SIZE            3
+
+/**
+ * @brief   RndA, RndB.
+ */
+#define DESFIRE_RANDOM_SIZE         AES_BLOCK_SIZE
+
+/**
+ * @brief   MAC appended to the responses of an authenticated session.
+ */
+#define DESFIRE_MAC_SIZE            8
+
+/**
+ * @brief   Longest diversification input of @p desfireDiversifyKey().
+ */
+#define DESFIRE_DIVERSIFY_MAX       31
+
+/**
+ * @brief   Longest data of a command or response.
+ */
+#define DESFIRE_DATA_MAX            (ISODEP_FRAME_MAX - 8)
+
+/**
+ * @name    Native commands
+ * @{
+ */
+#define DESFIRE_CMD_AUTHENTICATE_AES    0xAA
+#define DESFIRE_CMD_SELECT_APPLICATION  0x5A
+#define DESFIRE_CMD_READ_DATA           0xBD
+#define DESFIRE_CMD_ADDITIONAL_FRAME    0xAF
+/** @} */
+
+/**
+ * @name    Status codes
+ * @{
+ */
+#define DESFIRE_OPERATION_OK            0x00
+#define DESFIRE_PERMISSION_DENIED       0x9D
+#define DESFIRE_LENGTH_ERROR            0x7E
+#define DESFIRE_AUTHENTICATION_ERROR    0xAE
+#define DESFIRE_ADDITIONAL_FRAME        0xAF
+/** @} */
+
+/*===========================================================================*/
+/* Data structures and types.                                                */
+/*===========================================================================*/
+
+typedef struct {
+    uint32_t authentications;       /**< Sessions set up.                   */
+    uint32_t rejected;              /**< Keys or MACs not matching.         */
+    uint32_t blocks;                /**< AES blocks and key expansions.     */
+    uint32_t cycles;                /**< Spent in AES and CMAC, see
+                                         @p platformCycles().               */
+} DesfireStats;
+
+typedef struct {
+    IsoDep *isodep;
+    DesfireStats stats;
+    uint8_t status;                 /**< Of the last response.              */
+    bool authenticated;
+    CmacKey session;                /**< Session key and its subkeys, the
+                                         application key while
+                                         authenticating.                    */
+    uint8_t iv[AES_BLOCK_SIZE];     /**< CBC and CMAC chaining value.       */
+    uint8_t apdu[ISODEP_FRAME_MAX];
+} Desfire;
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void desfireInit(Desfire *dfp, IsoDep *idp);
+  mfrc522result_t desfireSelectApplication(Desfire *dfp, const uint8_t *aid);
+  mfrc522result_t desfireAuthenticate(Desfire *dfp, uint8_t keyno,
+                                      const uint8_t *key,
+                                      const uint8_t *rnda);
+  mfrc522result_t desfireCommand(Desfire *dfp, uint8_t cmd,
+                                 const uint8_t *data, size_t len,
+                                 uint8_t *response, size_t size,
+                                 size_t *rlen);
+  void desfireDiversifyKey(const CmacKey *master, const uint8_t *input,
+                           size_t len, uint8_t *key);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DESFIRE_H_ */
@@ -0,0 +1,380 @@
+/**
+ * @file    iso14443a.c
+ * @brief   ISO/IEC 14443-3 type A card activation on top of the MFRC522.
+ */
+
+#include <string.h>
+
+#include "rfid/iso14443a.h"
+
+/*===========================================================================*/
+/* Local definitions.                                                        */
+/*===========================================================================*/
+
+#define CMD_REQA                    0x26
+#define CMD_WUPA                    0x52
+#define CMD_HLTA                    0x50
+#define CASCADE_TAG                 0x88
+#define NVB_SELECT                  0x70
+
+/**
+ * @brief   A HLTA is acknowledged by the card staying silent for 1 ms.
+ */
+#define HLTA_TIMEOUT_US             1000
+
+/**
+ * @brief   Bits in a cascade level: 4 UID bytes and the BCC.
+ */
+#define LEVEL_BITS                  40
+
+/*===========================================================================*/
+/* Local variables and types.                                                */
+/*===========================================================================*/
+
+static const uint8_t sel_codes[] = {0x93, 0x95, 0x97};
+
+static const uint8_t reqa_setup[] = {
+    MFRC522_SEQ_TRANSCEIVE_PROLOGUE,
+    MFRC522_SEQ_FIFO(1, CMD_REQA),
+    MFRC522_SEQ_TRANSCEIVE_START(7),
+    MFRC522_SEQ_END
+};
+
+static const uint8_t wupa_setup[] = {
+    MFRC522_SEQ_TRANSCEIVE_PROLOGUE,
+    MFRC522_SEQ_FIFO(1, CMD_WUPA),
+    MFRC522_SEQ_TRANSCEIVE_START(7),
+    MFRC522_SEQ_END
+};
+
+static const uint8_t hlta_setup[] = {
+    MFRC522_SEQ_TRANSCEIVE_PROLOGUE,
+    MFRC522_SEQ_FIFO(2, CMD_HLTA, 0x00),
+    MFRC522_SEQ_TRANSCEIVE_START(0),
+    MFRC522_SEQ_END
+};
+
+/*===========================================================================*/
+/* Local functions.                                                          */
+/*===========================================================================*/
+
+/**
+ * @brief   Halts the selected card during an inventory.
+ * @details A card only answers HLTA, with a NAK, within its frame delay time,
+ *          so the next REQA can follow after the activation FWT instead of
+ *          the full 1 ms of @p iso14443aHalt(). A NAK is ignored, the card is
+ *          caught as a duplicate if it answers again.
+ */
+static void halt_pipelined(MFRC522Driver *mdp) {
+    MFRC522Transfer xfer = {0};
+    uint8_t response[1];
+
+    xfer.setup = hlta_setup;
+    xfer.txlen = 2;
+    xfer.crc = true;
+    xfer.rxbuf = response;
+    xfer.rxsize = sizeof(response);
+    xfer.timeout = ISO14443A_FWT_US;
+    (void)mfrc522Transceive(mdp, &xfer);
+}
+
+static bool is_listed(const Iso14443aInventory *inv, const Iso14443aCard *card) {
+    size_t i;
+
+    for (i = 0; i < inv->count; i++) {
+        if (inv->cards[i].uidlen == card->uidlen &&
+            memcmp(inv->cards[i].uid, card->uid, card->uidlen) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief   Selects the card with the given UID bytes and BCC in a cascade
+ *          level.
+ */
+static mfrc522result_t select_known(MFRC522Driver *mdp, uint8_t sel,
+                                    const uint8_t *level, uint8_t *sak) {
+    uint8_t frame[2 + 5];
+    MFRC522Transfer xfer = {0};
+    mfrc522result_t result;
+
+    frame[0] = sel;
+    frame[1] = NVB_SELECT;
+    memcpy(&frame[2], level, 5);
+    xfer.txbuf = frame;
+    xfer.txlen = sizeof(frame);
+    xfer.rxbuf = sak;
+    xfer.rxsize = 1;
+    xfer.crc = true;
+    xfer.timeout = ISO14443A_FWT_US;
+    result = mfrc522Transceive(mdp, &xfer);
+    if (result == MFRC522_OK && xfer.rxlen != 1) {
+        result = MFRC522_PROTOCOL_ERROR;
+    }
+    return result;
+}
+
+/**
+ * @brief   Resolves and selects one cascade level.
+ *
+ * @param[in] sel       SEL code of the level.
+ * @param[out] level    UID bytes of the level followed by the BCC.
+ * @param[out] sak      SAK returned by the card.
+ */
+static mfrc522result_t select_level(MFRC522Driver *mdp, uint8_t sel,
+                                    uint8_t *level, uint8_t *sak) {
+    uint8_t frame[2 + 5];
+    unsigned known = 0;
+    mfrc522result_t result;
+    MFRC522Transfer xfer = {0};
+
+    memset(frame, 0, sizeof(frame));
+    frame[0] = sel;
+    xfer.txbuf = frame;
+    xfer.timeout = ISO14443A_FWT_US;
+
+    /* Anticollision: send the bits known so far, the card(s) answer the
+       rest. On a collision take the 1 branch and ask again. */
+    while (known < LEVEL_BITS) {
+        unsigned bytes = known / 8;
+        unsigned bits = known % 8;
+
+        frame[1] = (uint8_t)(((2 + bytes) << 4) | bits);
+        xfer.txlen = 2 + bytes + (bits != 0 ? 1 : 0);
+        xfer.txbits = (uint8_t)bits;
+        xfer.rxalign = (uint8_t)bits;
+        xfer.rxbuf = &frame[2 + bytes];
+        xfer.rxsize = 5 - bytes;
+        result = mfrc522Transceive(mdp, &xfer);
+        if (result == MFRC522_COLLISION) {
+            unsigned bit = bytes * 8 + xfer.collpos - 1;
+
+            if (xfer.collpos == 0 || bit < known || bit >= LEVEL_BITS) {
+                return MFRC522_PROTOCOL_ERROR;
+            }
+            frame[2 + bit / 8] |= (uint8_t)(1 << (bit % 8));
+            known = bit + 1;
+            continue;
+        }
+        if (result != MFRC522_OK) {
+            return result;
+        }
+        if (bytes + xfer.rxlen != 5 || xfer.rxbits != 0) {
+            return MFRC522_PROTOCOL_ERROR;
+        }
+        known = LEVEL_BITS;
+    }
+    if ((frame[2] ^ frame[3] ^ frame[4] ^ frame[5]) != frame[6]) {
+        return MFRC522_PROTOCOL_ERROR;
+    }
+
+    memcpy(level, &frame[2], 5);
+    return select_known(mdp, sel, level, sak);
+}
+
+/*===========================================================================*/
+/* Exported functions.                                                       */
+/*===========================================================================*/
+
+/**
+ * @brief   Sends REQA, or WUPA which also wakes halted cards.
+ *
+ * @param[out] atqa     Two bytes of ATQA.
+ * @return  @p MFRC522_COLLISION means several cards answered.
+ */
+mfrc522result_t iso14443aRequest(MFRC522Driver *mdp, bool wakeup,
+                                 uint8_t *atqa) {
+    MFRC522Transfer xfer = {0};
+    mfrc522result_t result;
+
+    /* Free unless a card was left at a higher bit rate. */
+    mfrc522SetBitRate(mdp, MFRC522_BITRATE_106, MFRC522_BITRATE_106);
+    xfer.setup = wakeup ? wupa_setup : reqa_setup;
+    xfer.txlen = 1;
+    xfer.rxbuf = atqa;
+    xfer.rxsize = 2;
+    xfer.timeout = ISO14443A_FWT_US;
+    result = mfrc522Transceive(mdp, &xfer);
+    if (result == MFRC522_OK && (xfer.rxlen != 2 || xfer.rxbits != 0)) {
+        result = MFRC522_PROTOCOL_ERROR;
+    }
+    return result;
+}
+
+/**
+ * @brief   Runs the anticollision and selects a card in the READY state.
+ * @details Walks all cascade levels, @p card receives the complete UID and
+ *          the final SAK.
+ */
+mfrc522result_t iso14443aSelect(MFRC522Driver *mdp, Iso14443aCard *card) {
+    uint8_t level[5];
+    size_t i;
+
+    card->uidlen = 0;
+    for (i = 0; i < sizeof(sel_codes); i++) {
+        mfrc522result_t result = select_level(mdp, sel_codes[i], level,
+                                              &card->sak);
+
+        if (result != MFRC522_OK) {
+            return result;
+        }
+        if ((card->sak & ISO14443A_SAK_CASCADE) == 0) {
+            memcpy(&card->uid[card->uidlen], level, 4);
+            card->uidlen += 4;
+            return MFRC522_OK;
+        }
+        if (level[0] != CASCADE_TAG) {
+            return MFRC522_PROTOCOL_ERROR;
+        }
+        memcpy(&card->uid[card->uidlen], &level[1], 3);
+        card->uidlen += 3;
+    }
+    return MFRC522_PROTOCOL_ERROR;
+}
+
+/**
+ * @brief   Puts the selected card in the HALT state.
+ */
+mfrc522result_t iso14443aHalt(MFRC522Driver *mdp) {
+    MFRC522Transfer xfer = {0};
+    uint8_t response[1];
+    mfrc522result_t result;
+
+    xfer.setup = hlta_setup;
+    xfer.txlen = 2;
+    xfer.crc = true;
+    xfer.rxbuf = response;
+    xfer.rxsize = sizeof(response);
+    xfer.timeout = HLTA_TIMEOUT_US;
+    result = mfrc522Transceive(mdp, &xfer);
+    if (result == MFRC522_TIMEOUT) {
+        return MFRC522_OK;
+    }
+    return result == MFRC522_OK ? MFRC522_PROTOCOL_ERROR : result;
+}
+
+/**
+ * @brief   Activates a card in the field: REQA followed by the selection.
+ */
+mfrc522result_t iso14443aActivate(MFRC522Driver *mdp, Iso14443aCard *card) {
+    mfrc522result_t result = iso14443aRequest(mdp, false, card->atqa);
+
+    if (result != MFRC522_OK && result != MFRC522_COLLISION) {
+        return result;
+    }
+    return iso14443aSelect(mdp, card);
+}
+
+/**
+ * @brief   Checks that a card read before is still in the field.
+ * @details Wakes the card with WUPA and selects it by its UID, without
+ *          anticollision, then halts it again. Other halted cards woken up
+ *          by the WUPA return to HALT with the HLTA, cards which have just
+ *          entered the field return to IDLE.
+ *
+ * @return  @p MFRC522_TIMEOUT if the card did not answer.
+ */
+mfrc522result_t iso14443aReselect(MFRC522Driver *mdp, const Iso14443aCard *card) {
+    uint8_t atqa[2];
+    uint8_t level[5];
+    uint8_t sak;
+    size_t levels = card->uidlen == 4 ? 1 : card->uidlen == 7 ? 2 : 3;
+    size_t i;
+    mfrc522result_t result = iso14443aRequest(mdp, true, atqa);
+
+    if (result != MFRC522_OK && result != MFRC522_COLLISION) {
+        return result;
+    }
+    for (i = 0; i < levels; i++) {
+        if (i + 1 < levels) {
+            level[0] = CASCADE_TAG;
+            memcpy(&level[1], &card->uid[i * 3], 3);
+        } else {
+            memcpy(level, &card->uid[i * 3], 4);
+        }
+        level[4] = level[0] ^ level[1] ^ level[2] ^ level[3];
+        result = select_known(mdp, sel_codes[i], level, &sak);
+        if (result != MFRC522_OK) {
+            return result;
+        }
+        if (((sak & ISO14443A_SAK_CASCADE) != 0) != (i + 1 < levels)) {
+            return MFRC522_PROTOCOL_ERROR;
+        }
+    }
+    halt_pipelined(mdp);
+    return MFRC522_OK;
+}
+
+/**
+ * @brief   Reads the UIDs of all cards in the field.
+ * @details Selects the cards answering REQA one after the other and halts
+ *          each one as soon as it is selected, so that the next REQA finds
+ *          the rest. The front-end keeps its configuration across the
+ *          rounds. Halted cards are not woken up.
+ *
+ *          Without RF errors the inventory takes at most
+ *          @p ISO14443A_INVENTORY_FRAMES() frames. A failed round costs one
+ *          more REQA, as the cards it left in READY or ACTIVE only return to
+ *          IDLE on it, and at most @p ISO14443A_INVENTORY_ERRORS rounds may
+ *          fail.
+ *
+ * @param[in,out] inv   Buffer and limits in, cards found and cost out.
+ * @return  @p MFRC522_OK once the field is quiet, @p MFRC522_OVERFLOW if
+ *          @p inv->cards is full, @p MFRC522_TIMEOUT if @p inv->budget ran
+ *          out, otherwise the error of the last failed round.
+ */
+mfrc522result_t iso14443aInventory(MFRC522Driver *mdp,
+                                   Iso14443aInventory *inv) {
+    uint32_t start = platformNowUs();
+    uint32_t frames = mdp->stats.frames;
+    bool recovering = false;
+    mfrc522result_t result;
+
+    inv->count = 0;
+    inv->errors = 0;
+    for (;;) {
+        Iso14443aCard *card;
+
+        if (inv->count == inv->size) {
+            result = MFRC522_OVERFLOW;
+            break;
+        }
+        if (inv->budget != 0 && platformElapsedUs(start) >= inv->budget) {
+            result = MFRC522_TIMEOUT;
+            break;
+        }
+
+        card = &inv->cards[inv->count];
+        result = iso14443aRequest(mdp, false, card->atqa);
+        if (result == MFRC522_TIMEOUT) {
+            if (!recovering) {
+                result = MFRC522_OK;
+                break;
+            }
+            recovering = false;
+            continue;
+        }
+        recovering = false;
+        if (result == MFRC522_OK || result == MFRC522_COLLISION) {
+            result = iso14443aSelect(mdp, card);
+        }
+        if (result == MFRC522_OK) {
+            halt_pipelined(mdp);
+            if (!is_listed(inv, card)) {
+                inv->count++;
+                continue;
+            }
+            result = MFRC522_PROTOCOL_ERROR;
+        }
+        if (++inv->errors > ISO14443A_INVENTORY_ERRORS) {
+            break;
+        }
+        recovering = true;
+    }
+
+    inv->duration = platformElapsedUs(start);
+    inv->frames = mdp->stats.frames - frames;
+    return result;
+}
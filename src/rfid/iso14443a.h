@@ -0,0 +1,108 @@
+/**
+ * @file    iso14443a.h
+ * @brief   ISO/IEC 14443-3 type A card activation on top of the MFRC522.
+ */
+
+#ifndef _ISO14443A_H_
+#define _ISO14443A_H_
+
+#include "drivers/mfrc522.h"
+
+/**
+ * @brief   Frame waiting time for the activation commands.
+ * @details Cards answer 86 or 91 us after the end of the command and the
+ *          chip timer stops at the first received bit.
+ */
+#if !defined(ISO14443A_FWT_US) || defined(__DOXYGEN__)
+#define ISO14443A_FWT_US            300
+#endif
+
+/**
+ * @brief   Time a card may take to power up once the field is on.
+ * @details ISO/IEC 14443-3 allows up to 5 ms, common cards are ready much
+ *          sooner.
+ */
+#if !defined(ISO14443A_POWER_UP_US) || defined(__DOXYGEN__)
+#define ISO14443A_POWER_UP_US       5000
+#endif
+
+/**
+ * @brief   Shortest field off time which resets the cards in the field
+ *          (t_RESET of ISO/IEC 14443-3).
+ */
+#define ISO14443A_RESET_US          5100
+
+/**
+ * @brief   Selection rounds of an inventory which may fail on RF errors
+ *          before it gives up.
+ */
+#if !defined(ISO14443A_INVENTORY_ERRORS) || defined(__DOXYGEN__)
+#define ISO14443A_INVENTORY_ERRORS  3
+#endif
+
+/**
+ * @brief   Longest UID (triple size).
+ */
+#define ISO14443A_UID_MAX           10
+
+/**
+ * @name    SAK bits
+ * @{
+ */
+#define ISO14443A_SAK_CASCADE       0x04
+#define ISO14443A_SAK_ISO14443_4    0x20
+/** @} */
+
+/**
+ * @brief   Most frames an inventory of @p n cards with UIDs of up to
+ *          @p levels cascade levels takes without RF errors.
+ * @details Each card costs a REQA, an anticollision and a select frame per
+ *          cascade level and a HLTA, plus one anticollision frame per bit
+ *          collision. A collision drops at least one card from the selection,
+ *          so reading a card while @p m cards are left costs at most
+ *          @p m - 1 collisions. One more REQA finds the field empty.
+ */
+#define ISO14443A_INVENTORY_FRAMES(n, levels)                               \
+    ((n) * (2 + 2 * (levels)) + (n) * ((n) - 1) / 2 + 1)
+
+/**
+ * @brief   An activated card.
+ */
+typedef struct {
+    uint8_t uid[ISO14443A_UID_MAX];
+    uint8_t uidlen;                 /**< 4, 7 or 10 bytes.                  */
+    uint8_t atqa[2];
+    uint8_t sak;                    /**< SAK of the last cascade level.     */
+} Iso14443aCard;
+
+/**
+ * @brief   All cards in the field, see @p iso14443aInventory().
+ */
+typedef struct {
+    Iso14443aCard *cards;           /**< Receives the cards found.          */
+    size_t size;                    /**< Capacity of @p cards.              */
+    uint32_t budget;                /**< Time limit in microseconds, 0 for
+                                         none.                              */
+    size_t count;                   /**< Out: cards found.                  */
+    uint32_t duration;              /**< Out: microseconds taken.           */
+    uint32_t frames;                /**< Out: frames sent.                  */
+    uint8_t errors;                 /**< Out: rounds lost to RF errors.     */
+} Iso14443aInventory;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  mfrc522result_t iso14443aRequest(MFRC522Driver *mdp, bool wakeup,
+                                   uint8_t *atqa);
+  mfrc522result_t iso14443aSelect(MFRC522Driver *mdp, Iso14443aCard *card);
+  mfrc522result_t iso14443aHalt(MFRC522Driver *mdp);
+  mfrc522result_t iso14443aActivate(MFRC522Driver *mdp, Iso14443aCard *card);
+  mfrc522result_t iso14443aReselect(MFRC522Driver *mdp,
+                                    const Iso14443aCard *card);
+  mfrc522result_t iso14443aInventory(MFRC522Driver *mdp,
+                                     Iso14443aInventory *inv);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ISO14443A_H_ */
@@ -0,0 +1,350 @@
+/**
+ * @file    isodep.c
+ * @brief   ISO/IEC 14443-4 (ISO-DEP, T=CL) half-duplex block transmission.
+ */
+
+#include <string.h>
+
+#include "rfid/isodep.h"
+
+/*===========================================================================*/
+/* Local definitions.                                                        */
+/*===========================================================================*/
+
+#define CMD_RATS                    0xE0
+#define PPSS                        0xD0
+#define PPS0_PPS1                   0x11
+
+#define PCB_I                       0x02
+#define PCB_R                       0xA2
+#define PCB_CHAIN                   0x10
+#define PCB_NAK                     0x10
+#define PCB_BN                      0x01
+#define S_DESELECT                  0xC2
+#define S_WTX                       0xF2
+
+#define T0_TA                       0x10
+#define T0_TB                       0x20
+#define T0_TC                       0x40
+#define TA_SAME_D                   0x80
+
+/**
+ * @brief   Frame waiting time of RATS, 65536 / fc.
+ */
+#define FWT_ACTIVATION_US           4833
+
+/**
+ * @brief   Frame waiting time for FWI = 0, 256 * 16 / fc.
+ */
+#define FWT_UNIT_US                 302
+
+#define FWI_MAX                     14
+#define WTXM_MAX                    59
+
+/*===========================================================================*/
+/* Local variables and types.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Frame sizes coded by FSDI and FSCI.
+ */
+static const uint16_t frame_sizes[] = {16, 24, 32, 40, 48, 64, 96, 128, 256};
+
+/*===========================================================================*/
+/* Local functions.                                                          */
+/*===========================================================================*/
+
+static bool is_i_block(uint8_t pcb) {
+    /* No CID, no NAD. */
+    return (pcb & 0xEE) == PCB_I;
+}
+
+static bool is_ack(uint8_t pcb) {
+    return (pcb & 0xFE) == PCB_R;
+}
+
+/**
+ * @brief   Sends a frame with CRC and receives the answer.
+ */
+static mfrc522result_t send(IsoDep *idp, const uint8_t *out, size_t outlen,
+                            uint8_t *rx, size_t rxsize, uint32_t timeout,
+                            size_t *rxlen) {
+    MFRC522Transfer xfer = {0};
+    mfrc522result_t result;
+
+    xfer.txbuf = out;
+    xfer.txlen = outlen;
+    xfer.crc = true;
+    xfer.rxbuf = rx;
+    xfer.rxsize = rxsize;
+    xfer.timeout = timeout;
+    idp->stats.frames++;
+    result = mfrc522Transceive(idp->mdp, &xfer);
+    if (result == MFRC522_OK && (xfer.rxlen == 0 || xfer.rxbits != 0)) {
+        result = MFRC522_PROTOCOL_ERROR;
+    }
+    *rxlen = xfer.rxlen;
+    return result;
+}
+
+/**
+ * @brief   Sends a block and receives the answer, granting the waiting time
+ *          extensions the card asks for meanwhile.
+ */
+static mfrc522result_t frame(IsoDep *idp, const uint8_t *out, size_t outlen,
+                             size_t *rxlen) {
+    uint8_t wtx[2];
+    uint32_t fwt = idp->fwt;
+
+    for (;;) {
+        mfrc522result_t result = send(idp, out, outlen, idp->rx,
+                                      idp->fsd - 2, fwt, rxlen);
+        uint8_t wtxm;
+
+        if (result != MFRC522_OK || idp->rx[0] != S_WTX) {
+            return result;
+        }
+        wtxm = idp->rx[1] & 0x3F;
+        if (*rxlen != 2 || wtxm == 0 || wtxm > WTXM_MAX) {
+            return MFRC522_PROTOCOL_ERROR;
+        }
+        idp->stats.wtx++;
+        wtx[0] = S_WTX;
+        wtx[1] = wtxm;
+        out = wtx;
+        outlen = sizeof(wtx);
+        fwt = idp->fwt * wtxm;
+        if (fwt > (FWT_UNIT_US << FWI_MAX)) {
+            fwt = FWT_UNIT_US << FWI_MAX;
+        }
+    }
+}
+
+/**
+ * @brief   Sends the block in @p idp->tx and receives the answer to it.
+ * @details On a timeout or a corrupted answer the reader sends R(NAK), or
+ *          repeats the R(ACK) while the card chains its response. An R(ACK)
+ *          with another block number means the card missed the I-block,
+ *          which is sent again.
+ *
+ * @return  @p MFRC522_OK with an I-block or an R(ACK) carrying the current
+ *          block number in @p idp->rx.
+ */
+static mfrc522result_t transact(IsoDep *idp, size_t len, size_t *rxlen) {
+    uint8_t nak = PCB_R | PCB_NAK | idp->bn;
+    bool acking = is_ack(idp->tx[0]);
+    const uint8_t *out = idp->tx;
+    size_t outlen = len;
+    unsigned tries = 0;
+
+    for (;;) {
+        mfrc522result_t result = frame(idp, out, outlen, rxlen);
+
+        if (result == MFRC522_OK) {
+            uint8_t pcb = idp->rx[0];
+
+            if ((pcb & PCB_BN) == idp->bn && (is_i_block(pcb) || is_ack(pcb))) {
+                return MFRC522_OK;
+            }
+            if (is_ack(pcb) && !acking) {
+                out = idp->tx;
+                outlen = len;
+            } else {
+                result = MFRC522_PROTOCOL_ERROR;
+            }
+        }
+        if (++tries > ISODEP_RETRIES) {
+            return result == MFRC522_OK ? MFRC522_PROTOCOL_ERROR : result;
+        }
+        idp->stats.retransmissions++;
+        if (result != MFRC522_OK && !acking) {
+            out = &nak;
+            outlen = 1;
+        } else if (result != MFRC522_OK) {
+            out = idp->tx;
+            outlen = len;
+        }
+    }
+}
+
+/*===========================================================================*/
+/* Exported functions.                                                       */
+/*===========================================================================*/
+
+/**
+ * @brief   Activates the selected card.
+ * @details Sends RATS, waits the start-up frame guard time the card asks
+ *          for and switches to the highest bit rates both sides support with
+ *          PPS.
+ *
+ * @param[in] fsdi      FSDI to announce, at most @p ISODEP_FSDI.
+ * @param[in] bitrate   Highest bit rate to negotiate, at most
+ *                      @p ISODEP_BITRATE_MAX.
+ */
+mfrc522result_t isoDepActivate(IsoDep *idp, MFRC522Driver *mdp,
+                               uint8_t fsdi, uint8_t bitrate) {
+    uint8_t rats[2];
+    uint8_t fsci = 2, ta = 0, fwi = 4, sfgi = 0;
+    uint8_t ds = MFRC522_BITRATE_106, dr = MFRC522_BITRATE_106;
+    uint8_t rate;
+    mfrc522result_t result;
+
+    memset(idp, 0, sizeof(*idp));
+    idp->mdp = mdp;
+    fsdi = fsdi < ISODEP_FSDI ? fsdi : ISODEP_FSDI;
+    bitrate = bitrate < ISODEP_BITRATE_MAX ? bitrate : ISODEP_BITRATE_MAX;
+    idp->fsd = frame_sizes[fsdi];
+
+    rats[0] = CMD_RATS;
+    rats[1] = (uint8_t)(fsdi << 4);
+    result = send(idp, rats, sizeof(rats), idp->ats, sizeof(idp->ats),
+                  FWT_ACTIVATION_US, &idp->atslen);
+    if (result != MFRC522_OK) {
+        return result;
+    }
+    if (idp->ats[0] != idp->atslen) {
+        return MFRC522_PROTOCOL_ERROR;
+    }
+    if (idp->atslen > 1) {
+        uint8_t t0 = idp->ats[1];
+        size_t p = 2;
+
+        fsci = t0 & 0x0F;
+        if ((t0 & T0_TA) != 0) {
+            ta = idp->ats[p++];
+        }
+        if ((t0 & T0_TB) != 0) {
+            fwi = idp->ats[p] >> 4;
+            sfgi = idp->ats[p++] & 0x0F;
+        }
+        if ((t0 & T0_TC) != 0) {
+            p++;
+        }
+        if (p > idp->atslen) {
+            return MFRC522_PROTOCOL_ERROR;
+        }
+    }
+    /* Reserved values mean the defaults. */
+    idp->fsc = frame_sizes[fsci < 8 ? fsci : 8];
+    idp->fwt = FWT_UNIT_US << (fwi <= FWI_MAX ? fwi : 4);
+    if (sfgi > 0 && sfgi <= FWI_MAX) {
+        platformDelayUs(FWT_UNIT_US << sfgi);
+    }
+
+    /* TA: DS = 2, 4 and 8 in bits 5 to 7, DR in bits 1 to 3. */
+    for (rate = bitrate; rate > MFRC522_BITRATE_106; rate--) {
+        if (ds == MFRC522_BITRATE_106 && (ta & (0x08 << rate)) != 0) {
+            ds = rate;
+        }
+        if (dr == MFRC522_BITRATE_106 && (ta & (0x01 << (rate - 1))) != 0) {
+            dr = rate;
+        }
+    }
+    if ((ta & TA_SAME_D) != 0) {
+        ds = dr = ds < dr ? ds : dr;
+    }
+    if (ds != MFRC522_BITRATE_106 || dr != MFRC522_BITRATE_106) {
+        uint8_t pps[3] = {PPSS, PPS0_PPS1, (uint8_t)((ds << 2) | dr)};
+        size_t rxlen;
+
+        result = send(idp, pps, sizeof(pps), idp->rx, sizeof(idp->rx),
+                      idp->fwt, &rxlen);
+        if (result != MFRC522_OK) {
+            return result;
+        }
+        if (rxlen != 1 || idp->rx[0] != PPSS) {
+            return MFRC522_PROTOCOL_ERROR;
+        }
+        mfrc522SetBitRate(mdp, dr, ds);
+    }
+    idp->ds = ds;
+    idp->dr = dr;
+    return MFRC522_OK;
+}
+
+/**
+ * @brief   Sends a command APDU and receives the response APDU.
+ * @details Both are chained over as many blocks as needed.
+ *
+ * @param[out] rlen     Length of the response.
+ * @return  @p MFRC522_OVERFLOW if the response does not fit in @p size
+ *          bytes, the card then has to be deselected.
+ */
+mfrc522result_t isoDepExchange(IsoDep *idp, const uint8_t *command,
+                               size_t len, uint8_t *response, size_t size,
+                               size_t *rlen) {
+    size_t fsc = idp->fsc - 2u < ISODEP_FRAME_MAX ? idp->fsc - 2u
+                                                  : ISODEP_FRAME_MAX;
+    size_t off = 0, rxlen;
+    mfrc522result_t result;
+
+    *rlen = 0;
+    for (;;) {
+        size_t n = len - off < fsc - 1 ? len - off : fsc - 1;
+        bool chain = off + n < len;
+
+        idp->tx[0] = (uint8_t)(PCB_I | idp->bn | (chain ? PCB_CHAIN : 0));
+        memcpy(&idp->tx[1], &command[off], n);
+        result = transact(idp, n + 1, &rxlen);
+        if (result != MFRC522_OK) {
+            return result;
+        }
+        if (!chain) {
+            break;
+        }
+        if (!is_ack(idp->rx[0])) {
+            return MFRC522_PROTOCOL_ERROR;
+        }
+        idp->stats.chained++;
+        idp->bn ^= PCB_BN;
+        off += n;
+    }
+
+    for (;;) {
+        uint8_t pcb = idp->rx[0];
+
+        if (!is_i_block(pcb)) {
+            return MFRC522_PROTOCOL_ERROR;
+        }
+        idp->bn ^= PCB_BN;
+        if (*rlen + rxlen - 1 > size) {
+            return MFRC522_OVERFLOW;
+        }
+        memcpy(&response[*rlen], &idp->rx[1], rxlen - 1);
+        *rlen += rxlen - 1;
+        if ((pcb & PCB_CHAIN) == 0) {
+            return MFRC522_OK;
+        }
+        idp->stats.chained++;
+        idp->tx[0] = PCB_R | idp->bn;
+        result = transact(idp, 1, &rxlen);
+        if (result != MFRC522_OK) {
+            return result;
+        }
+    }
+}
+
+/**
+ * @brief   Deactivates the card, which enters HALT, and returns to
+ *          106 kbit/s.
+ */
+mfrc522result_t isoDepDeselect(IsoDep *idp) {
+    static const uint8_t deselect[] = {S_DESELECT};
+    mfrc522result_t result = MFRC522_TIMEOUT;
+    unsigned tries;
+
+    for (tries = 0; tries <= ISODEP_RETRIES; tries++) {
+        size_t rxlen;
+
+        result = send(idp, deselect, sizeof(deselect), idp->rx,
+                      sizeof(idp->rx), idp->fwt, &rxlen);
+        if (result == MFRC522_OK) {
+            if (rxlen == 1 && idp->rx[0] == S_DESELECT) {
+                break;
+            }
+            result = MFRC522_PROTOCOL_ERROR;
+        }
+    }
+    mfrc522SetBitRate(idp->mdp, MFRC522_BITRATE_106, MFRC522_BITRATE_106);
+    return result;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file    isodep.h
+ * @brief   ISO/IEC 14443-4 (ISO-DEP, T=CL) half-duplex block transmission.
+ * @details Activates a selected ISO/IEC 14443-4 card with RATS and PPS and
+ *          exchanges APDUs with it. The activation negotiates the highest
+ *          bit rate both the card and the MFRC522 support and the largest
+ *          frames: the reader announces @p ISODEP_FSDI and sends frames up
+ *          to the card's FSC.
+ *
+ *          Commands and responses longer than a frame are chained. Waiting
+ *          time extensions requested by the card are granted, lost or
+ *          corrupted blocks are recovered with R(NAK) and R(ACK) following
+ *          the block numbering rules of ISO/IEC 14443-4 7.5.4.
+ *
+ *          Neither CID nor NAD is used, a single card is active at a time.
+ */
+
+#ifndef _ISODEP_H_
+#define _ISODEP_H_
+
+#include "rfid/iso14443a.h"
+
+/**
+ * @brief   FSDI sent in RATS.
+ * @details The driver reads a frame from the FIFO in one go, so the frames
+ *          the reader receives must fit in it: 5 stands for 64 bytes.
+ */
+#if !defined(ISODEP_FSDI) || defined(__DOXYGEN__)
+#define ISODEP_FSDI                 5
+#endif
+
+/**
+ * @brief   Highest bit rate negotiated with PPS.
+ */
+#if !defined(ISODEP_BITRATE_MAX) || defined(__DOXYGEN__)
+#define ISODEP_BITRATE_MAX          MFRC522_BITRATE_848
+#endif
+
+/**
+ * @brief   Times a block is retransmitted or a lost response asked for
+ *          before the exchange fails.
+ */
+#if !defined(ISODEP_RETRIES) || defined(__DOXYGEN__)
+#define ISODEP_RETRIES              3
+#endif
+
+/**
+ * @brief   Longest frame, without the CRC, the reader sends or receives.
+ */
+#define ISODEP_FRAME_MAX            MFRC522_FIFO_SIZE
+
+/**
+ * @brief   Longest ATS.
+ */
+#define ISODEP_ATS_MAX              20
+
+/**
+ * @brief   Counters of the block transmission.
+ */
+typedef struct {
+    uint32_t frames;                /**< Blocks sent.                       */
+    uint32_t chained;               /**< Chained I-blocks, either way.      */
+    uint32_t retransmissions;       /**< R(NAK) sent or I-blocks repeated.  */
+    uint32_t wtx;                   /**< Waiting time extensions granted.   */
+} IsoDepStats;
+
+/**
+ * @brief   An activated card.
+ */
+typedef struct {
+    MFRC522Driver *mdp;
+    uint16_t fsc;                   /**< Longest frame the card accepts.    */
+    uint16_t fsd;                   /**< Longest frame the reader accepts.  */
+    uint32_t fwt;                   /**< Frame waiting time in microseconds. */
+    uint8_t dr;                     /**< Bit rate towards the card.         */
+    uint8_t ds;                     /**< Bit rate from the card.            */
+    uint8_t bn;                     /**< Current block number.              */
+    uint8_t ats[ISODEP_ATS_MAX];
+    size_t atslen;
+    IsoDepStats stats;
+    uint8_t tx[ISODEP_FRAME_MAX];
+    uint8_t rx[ISODEP_FRAME_MAX];
+} IsoDep;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  mfrc522result_t isoDepActivate(IsoDep *idp, MFRC522Driver *mdp,
+                                 uint8_t fsdi, uint8_t bitrate);
+  mfrc522result_t isoDepExchange(IsoDep *idp, const uint8_t *command,
+                                 size_t len, uint8_t *response, size_t size,
+                                 size_t *rlen);
+  mfrc522result_t isoDepDeselect(IsoDep *idp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ISODEP_H_ */